@@ -10,6 +10,8 @@ res/%.ogg: assets/%.ogg
 ROOMS_SRC+=$(wildcard assets/rooms/*/mesh.blend)
 TARGETS+=$(ROOMS_SRC:assets/%.blend=res/%.mesh)
 TARGETS+=$(ROOMS_SRC:assets/%.blend=res/%.render)
+TARGETS+=$(ROOMS_SRC:assets/%.blend=res/%.collision)
+TARGETS+=$(ROOMS_SRC:assets/%.blend=res/%.pvs)
 
 SPRITES_SRC+=$(wildcard assets/sprites/*.blend)
 TARGETS+=$(SPRITES_SRC:assets/%.blend=res/%.render)
@@ -24,6 +26,55 @@ res/%.render: res/%.mesh $(BIN_HOST)/meshcooker.exe
 	@mkdir -p $(dir $@)
 	$(BIN_HOST)/meshcooker.exe "$<" "$(dir assets/$*)" "res/$*.render"
 
+# The meshcooker skips the meshes whose inputs didn't change (contents
+# and cooker version), see its 'COOKER_VERSION'. It writes the textures
+# a mesh depends on in 'res/%.render.d'.
+-include $(patsubst %,%.d,$(filter %.render,$(TARGETS)))
+
+# rooms also get their collision data cooked, and their visibility precomputed
+res/rooms/%.render res/rooms/%.collision res/rooms/%.pvs: res/rooms/%.mesh $(BIN_HOST)/meshcooker.exe
+	@mkdir -p $(dir $@)
+	$(BIN_HOST)/meshcooker.exe "$<" "$(dir assets/rooms/$*)" "res/rooms/$*.render" "res/rooms/$*.collision"
+
+# the small textures of the sprites, packed in a few pages: see 'cookAtlas'
+TARGETS+=res/sprites/atlas.txt
+
+res/sprites/atlas.txt: $(SPRITES_SRC:assets/%.blend=res/%.render) $(BIN_HOST)/meshcooker.exe
+	$(BIN_HOST)/meshcooker.exe --atlas "$@" $(SPRITES_SRC:assets/%.blend=res/%.render)
+
+# everything in 'res', in a single file: see 'File::mount'.
+# The meshcooker outputs more files than its targets (textures, lightmaps),
+# hence the 'find'. Its dependency files stay out.
+RES_TARGETS:=$(filter res/%,$(TARGETS))
+
+res.pack: $(RES_TARGETS) $(BIN_HOST)/packer.exe
+	$(BIN_HOST)/packer.exe "$@" $$(find res -type f -not -name "*.d" -not -name bundles.txt | sort)
+
+TARGETS+=res.pack
+
+# The web version only downloads the rooms it enters: one archive per room
+# (with its music), listed in 'res/bundles.txt', see 'File::mountOnDemand'.
+# 'web/res.pack', preloaded with the page, has everything else.
+ROOM_NAMES:=$(patsubst assets/rooms/%/mesh.blend,%,$(ROOMS_SRC))
+WEB_BUNDLES:=$(ROOM_NAMES:%=web/rooms-%.pack)
+
+web/rooms-%.pack: $(RES_TARGETS) $(BIN_HOST)/packer.exe
+	@mkdir -p $(dir $@)
+	$(BIN_HOST)/packer.exe "$@" $$(find res/rooms/$* res/music -type f -not -name "*.d" \( -path "res/rooms/*" -o -name "music-$*.ogg" \) | sort)
+
+res/bundles.txt: $(MAKEFILE_LIST)
+	@mkdir -p $(dir $@)
+	@rm -f "$@"
+	@$(foreach room,$(ROOM_NAMES),echo "rooms-$(room).pack res/rooms/$(room)/ res/music/music-$(room).ogg" >> "$@";)
+
+web/res.pack: $(RES_TARGETS) res/bundles.txt $(BIN_HOST)/packer.exe
+	@mkdir -p $(dir $@)
+	$(BIN_HOST)/packer.exe "$@" $$(find res -type f -not -name "*.d" -not -path "res/rooms/*" -not -name "music-*.ogg" | sort)
+
+web: web/res.pack $(WEB_BUNDLES)
+
+.PHONY: web
+
 res/%: assets/%
 	@mkdir -p $(dir $@)
 	@cp "$<" "$@"
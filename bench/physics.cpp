@@ -0,0 +1,169 @@
+#include "engine/bench/bench.h"
+#include "src/body.h"
+#include "src/entities/move.h" // slideMove
+#include "src/physics.h"
+#include "src/static_world.h"
+#include <cmath>
+#include <memory>
+
+using namespace std;
+
+namespace
+{
+// deterministic pseudo-random numbers, in [0;1[
+struct Random
+{
+  uint32_t state = 12345;
+
+  float next()
+  {
+    state = state * 1664525 + 1013904223;
+    return (state >> 8) * (1.0f / (1 << 24));
+  }
+};
+
+// Synthetic room: a floor, with pillars and bodies scattered on it.
+// The room grows with the number of brushes, so their density stays the same.
+struct Room
+{
+  Room(int brushCount, int bodyCount)
+  {
+    side = 8.0f * sqrt((float)brushCount + 1);
+
+    vector<Convex> brushes;
+    brushes.push_back(makeBoxConvex(Box(0, 0, -1, side, side, 1)));
+
+    for(int i = 0; i < brushCount; ++i)
+    {
+      auto const x = random.next() * side;
+      auto const y = random.next() * side;
+      brushes.push_back(makeBoxConvex(Box(x, y, 0, 1 + random.next() * 3, 1 + random.next() * 3, 2 + random.next() * 4)));
+    }
+
+    physics = createPhysics();
+    physics->setStaticWorld(make_unique<StaticWorld>(brushes));
+
+    bodies.resize(bodyCount);
+
+    for(auto& body : bodies)
+    {
+      body.pos = randomPos();
+      body.size = Size(0.8, 0.8, 1.5);
+      body.solid = true;
+      physics->addBody(&body);
+    }
+  }
+
+  Vector randomPos()
+  {
+    return Vector(random.next() * side, random.next() * side, random.next() * 4);
+  }
+
+  Vector randomDelta()
+  {
+    return Vector(random.next() - 0.5, random.next() - 0.5, random.next() - 0.5);
+  }
+
+  Random random;
+  float side;
+  unique_ptr<IPhysics> physics;
+  vector<Body> bodies;
+};
+
+// keeps the compiler from optimizing the measured work away
+volatile float g_sink;
+
+vector<int> brushCounts()
+{
+  return benchParam("brushes", { 16, 64, 256, 1024, 4096 });
+}
+
+vector<int> bodyCounts()
+{
+  return benchParam("bodies", { 16, 64, 256, 1024 });
+}
+}
+
+benchmark("Physics: traceBox")
+{
+  for(auto brushCount : brushCounts())
+  {
+    Room room(brushCount, 64);
+
+    auto run = [&] (int n)
+      {
+        float sum = 0;
+
+        for(int i = 0; i < n; ++i)
+        {
+          Box box;
+          box.pos = room.randomPos();
+          box.size = Size(0.8, 0.8, 1.5);
+          sum += room.physics->traceBox(box, room.randomDelta() * 4, nullptr).fraction;
+        }
+
+        g_sink = sum;
+      };
+
+    reportBench("traceBox", "brushes", brushCount, measureNsPerOp(run));
+  }
+}
+
+benchmark("Physics: moveBody")
+{
+  for(auto bodyCount : bodyCounts())
+  {
+    Room room(256, bodyCount);
+
+    auto run = [&] (int n)
+      {
+        for(int i = 0; i < n; ++i)
+        {
+          auto& body = room.bodies[i % room.bodies.size()];
+          room.physics->moveBody(&body, room.randomDelta());
+        }
+      };
+
+    reportBench("moveBody", "bodies", bodyCount, measureNsPerOp(run));
+  }
+}
+
+benchmark("Physics: slideMove")
+{
+  for(auto brushCount : brushCounts())
+  {
+    Room room(brushCount, 64);
+
+    auto run = [&] (int n)
+      {
+        for(int i = 0; i < n; ++i)
+        {
+          auto& body = room.bodies[i % room.bodies.size()];
+          slideMove(room.physics.get(), &body, room.randomDelta() * 2);
+        }
+      };
+
+    reportBench("slideMove", "brushes", brushCount, measureNsPerOp(run));
+  }
+}
+
+benchmark("Physics: checkForOverlaps")
+{
+  for(auto bodyCount : bodyCounts())
+  {
+    Room room(256, bodyCount);
+
+    // keep some bodies awake, as they would be in a game
+    auto run = [&] (int n)
+      {
+        for(int i = 0; i < n; ++i)
+        {
+          auto& body = room.bodies[i % room.bodies.size()];
+          room.physics->moveBody(&body, room.randomDelta() * 0.1);
+          room.physics->checkForOverlaps();
+        }
+      };
+
+    reportBench("checkForOverlaps", "bodies", bodyCount, measureNsPerOp(run));
+  }
+}
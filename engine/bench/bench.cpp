@@ -0,0 +1,196 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Benchmark framework: runner and measurements
+
+#include "bench.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // atoi, malloc
+#include <cstring> // strstr, strcmp
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+///////////////////////////////////////////////////////////////////////////////
+// every heap allocation of the benchmark binary is counted
+
+static atomic<int64_t> g_allocations { 0 };
+
+void* operator new(size_t size)
+{
+  g_allocations.fetch_add(1, memory_order_relaxed);
+
+  if(auto p = malloc(size ? size : 1))
+    return p;
+
+  throw bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+  free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+// a measurement must last at least this long to be trusted
+auto const MIN_DURATION = chrono::milliseconds(100);
+
+Benchmark* g_first;
+map<string, vector<int>> g_params;
+
+vector<int> parseList(char const* s)
+{
+  vector<int> r;
+
+  while(*s)
+  {
+    r.push_back(atoi(s));
+
+    while(*s && *s != ',')
+      ++s;
+
+    if(*s == ',')
+      ++s;
+  }
+
+  return r;
+}
+}
+
+BenchRegistration RegisterBenchmark(Benchmark& bench)
+{
+  bench.next = g_first;
+  g_first = &bench;
+  return {};
+}
+
+double measureNsPerOp(function<void(int)> run)
+{
+  int n = 1;
+
+  while(1)
+  {
+    auto const start = chrono::steady_clock::now();
+    run(n);
+    auto const elapsed = chrono::steady_clock::now() - start;
+
+    if(elapsed >= MIN_DURATION || n >= (1 << 28))
+      return chrono::duration<double, nano>(elapsed).count() / n;
+
+    n *= 2;
+  }
+}
+
+BenchResult measure(function<void(int)> run)
+{
+  int n = 1;
+
+  while(1)
+  {
+    auto const allocations = g_allocations.load();
+    auto const start = chrono::steady_clock::now();
+    run(n);
+    auto const elapsed = chrono::steady_clock::now() - start;
+
+    if(elapsed >= MIN_DURATION || n >= (1 << 28))
+    {
+      BenchResult r;
+      r.nsPerOp = chrono::duration<double, nano>(elapsed).count() / n;
+      r.allocsPerOp = double(g_allocations.load() - allocations) / n;
+      return r;
+    }
+
+    n *= 2;
+  }
+}
+
+void reportThroughput(char const* what, char const* input, int64_t bytes, BenchResult result)
+{
+  auto const mbPerSecond = bytes / result.nsPerOp * 1e9 / (1024 * 1024);
+  printf("  %-24s %-20s %10.1f MB/s %10.1f allocs/op\n", what, input, mbPerSecond, result.allocsPerOp);
+  fflush(stdout);
+}
+
+void reportBench(char const* what, char const* param, int value, double nsPerOp)
+{
+  printf("  %-24s %s=%-6d %12.1f ns/op\n", what, param, value, nsPerOp);
+  fflush(stdout);
+}
+
+vector<int> benchParam(char const* param, vector<int> defaults)
+{
+  auto i = g_params.find(param);
+
+  if(i == g_params.end())
+    return defaults;
+
+  return i->second;
+}
+
+void RunBenchmarks(int argc, char const* argv[])
+{
+  char const* filter = "";
+
+  for(int i = 1; i < argc; ++i)
+  {
+    if(!strncmp(argv[i], "--", 2))
+    {
+      if(i + 1 >= argc)
+        throw runtime_error(string("Missing value for '") + argv[i] + "'");
+
+      g_params[argv[i] + 2] = parseList(argv[i + 1]);
+      ++i;
+    }
+    else
+    {
+      filter = argv[i];
+    }
+  }
+
+  // registration order is reversed
+  vector<Benchmark*> all;
+
+  for(auto bench = g_first; bench; bench = bench->next)
+    all.insert(all.begin(), bench);
+
+  for(auto bench : all)
+  {
+    if(!strstr(bench->name, filter))
+      continue;
+
+    printf("%s\n", bench->name);
+    fflush(stdout);
+    bench->func();
+  }
+}
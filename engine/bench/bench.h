@@ -0,0 +1,67 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#pragma once
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmark framework: API
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define benchmark(name) \
+  benchmarkWithCounter(__COUNTER__, name)
+
+// Calls 'run(n)' with a growing 'n' until it runs long enough to be measured.
+// 'run(n)' must perform 'n' operations.
+// Returns the time taken by one operation, in nanoseconds.
+double measureNsPerOp(std::function<void(int)> run);
+
+struct BenchResult
+{
+  double nsPerOp;
+  double allocsPerOp; // heap allocations
+};
+
+// Same as 'measureNsPerOp', also counting the heap allocations
+BenchResult measure(std::function<void(int)> run);
+
+// Prints the throughput of an operation on 'bytes' of input, e.g:
+// reportThroughput("decodePng", "font.png", 65536, result)
+void reportThroughput(char const* what, char const* input, int64_t bytes, BenchResult result);
+
+// Prints one point of a scaling curve, e.g:
+// reportBench("traceBox", "brushes", 256, 41.5)
+void reportBench(char const* what, char const* param, int value, double nsPerOp);
+
+// Returns the values given on the command line for 'param'
+// (e.g "--brushes 16,256"), or 'defaults' if there's none.
+std::vector<int> benchParam(char const* param, std::vector<int> defaults);
+
+void RunBenchmarks(int argc, char const* argv[]);
+
+///////////////////////////////////////////////////////////////////////////////
+// implementation details
+
+struct Benchmark
+{
+  void (* func)();
+  const char* name;
+  Benchmark* next = nullptr;
+};
+
+#define benchmarkWithCounter(counter, name) \
+  benchmark2(counter, name)
+
+#define benchmark2(counter, name) \
+  static void g_myBench ## counter(); \
+  static Benchmark g_myBenchInfo ## counter = { &g_myBench ## counter, name }; \
+  static auto g_registration ## counter = RegisterBenchmark(g_myBenchInfo ## counter); \
+  static void g_myBench ## counter()
+
+struct BenchRegistration {};
+BenchRegistration RegisterBenchmark(Benchmark& bench);
@@ -0,0 +1,27 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Benchmark framework: entry point
+// Usage: bench.exe [filter] [--param values]
+// (e.g: bench.exe "Physics" --brushes 64,1024)
+
+#include "bench.h"
+#include <cstdio>
+#include <stdexcept>
+
+int main(int argc, char const* argv[])
+{
+  try
+  {
+    RunBenchmarks(argc, argv);
+    return 0;
+  }
+  catch(std::exception const& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    return 1;
+  }
+}
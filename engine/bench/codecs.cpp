@@ -0,0 +1,315 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Benchmarks of the engine's decoders, on the repository's own assets.
+// To be run from the root of the repository.
+
+#include "bench.h"
+
+#include "base/mesh.h" // importMesh
+#include "engine/src/audio/audio_channel.h"
+#include "engine/src/misc/base64.h"
+#include "engine/src/misc/decompress.h"
+#include "engine/src/misc/file.h"
+#include "engine/src/misc/json.h"
+#include "engine/src/render/png.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+char const* const PNG_CORPUS[] =
+{
+  "assets/font.png",
+  "assets/rooms/01/wall.png",
+  "assets/rooms/01/skybox.png",
+  "assets/rooms/00/mesh.png",
+};
+
+char const* const OGG_CORPUS[] =
+{
+  "assets/sounds/jump.ogg",
+  "assets/sounds/die.ogg",
+  "assets/music/music-00.ogg",
+};
+
+char const* const JSON_CORPUS[] =
+{
+  "assets/rooms/00/mesh.json",
+  "assets/rooms/01/mesh.json",
+};
+
+// keeps the compiler from optimizing the measured work away
+volatile int g_sink;
+
+Span<const uint8_t> toSpan(string const& s)
+{
+  return { (uint8_t const*)s.data(), (int)s.size() };
+}
+
+// Empty if 'path' is missing: its benchmarks are skipped
+string readCorpus(char const* path)
+{
+  if(!File::exists(path))
+  {
+    printf("  (skipped: '%s' not found)\n", path);
+    return {};
+  }
+
+  return File::read(path);
+}
+
+char const* baseName(char const* path)
+{
+  auto r = path;
+
+  for(auto p = path; *p; ++p)
+    if(*p == '/')
+      r = p + 1;
+
+  return r;
+}
+
+uint32_t readBigEndian32(uint8_t const* p)
+{
+  return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// The zlib stream of a PNG: its IDAT chunks, concatenated
+string extractZlibStream(string const& png)
+{
+  string r;
+  size_t pos = 8; // signature
+
+  while(pos + 12 <= png.size())
+  {
+    auto const p = (uint8_t const*)png.data() + pos;
+    auto const len = readBigEndian32(p);
+
+    if(!png.compare(pos + 4, 4, "IDAT"))
+      r.append(png, pos + 8, len);
+
+    pos += 12 + len;
+  }
+
+  return r;
+}
+
+string encodeBase64(string const& data)
+{
+  static char const digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  string r;
+
+  for(size_t i = 0; i < data.size(); i += 3)
+  {
+    uint32_t triple = uint8_t(data[i]) << 16;
+
+    if(i + 1 < data.size())
+      triple |= uint8_t(data[i + 1]) << 8;
+
+    if(i + 2 < data.size())
+      triple |= uint8_t(data[i + 2]);
+
+    r += digits[(triple >> 18) & 63];
+    r += digits[(triple >> 12) & 63];
+    r += i + 1 < data.size() ? digits[(triple >> 6) & 63] : '=';
+    r += i + 2 < data.size() ? digits[triple & 63] : '=';
+  }
+
+  return r;
+}
+
+// No mesh is committed (they're exported from the .blend files), so this
+// one is generated: a grid of 'side' x 'side' quads, in the exported format.
+string makeMeshText(int side)
+{
+  string r = "material: \"Stone\"\ndiffuse: \"stone.png\"\n\nobj: \"Grid\"\nmaterial: \"Stone\"\n";
+  char line[256];
+
+  for(int y = 0; y < side; ++y)
+  {
+    for(int x = 0; x < side; ++x)
+    {
+      int const corners[6][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+
+      for(auto& c : corners)
+      {
+        auto const vx = x + c[0];
+        auto const vy = y + c[1];
+        snprintf(line, sizeof line, "%.4f %.4f %.4f - 0.0 0.0 1.0 - %.5f %.5f\n",
+                 vx * 0.5, vy * 0.5, (vx * vy % 7) * 0.125, vx / double(side), vy / double(side));
+        r += line;
+      }
+    }
+  }
+
+  return r;
+}
+}
+
+benchmark("Codecs: decompress")
+{
+  for(auto path : PNG_CORPUS)
+  {
+    auto const zlib = extractZlibStream(readCorpus(path));
+
+    if(zlib.empty())
+      continue;
+
+    auto run = [&] (int n)
+      {
+        for(int i = 0; i < n; ++i)
+          g_sink = (int)decompress(toSpan(zlib)).size();
+      };
+
+    reportThroughput("decompress", baseName(path), zlib.size(), measure(run));
+  }
+}
+
+benchmark("Codecs: decodePng")
+{
+  for(auto path : PNG_CORPUS)
+  {
+    auto const png = readCorpus(path);
+
+    if(png.empty())
+      continue;
+
+    auto run = [&] (int n)
+      {
+        int width, height;
+
+        for(int i = 0; i < n; ++i)
+          g_sink = (int)decodePng(toSpan(png), width, height).size();
+      };
+
+    reportThroughput("decodePng", baseName(path), png.size(), measure(run));
+  }
+}
+
+benchmark("Codecs: json::parse")
+{
+  for(auto path : JSON_CORPUS)
+  {
+    auto const text = readCorpus(path);
+
+    if(text.empty())
+      continue;
+
+    // the room descriptions are tiny: also as a larger document
+    string large = "{ \"rooms\": [";
+
+    for(int i = 0; i < 1000; ++i)
+      large += (i ? "," : "") + text;
+
+    large += "] }";
+
+    string const* inputs[] = { &text, &large };
+
+    for(auto input : inputs)
+    {
+      auto run = [&] (int n)
+        {
+          for(int i = 0; i < n; ++i)
+            g_sink = (int)json::parse(input->data(), input->size()).type;
+        };
+
+      reportThroughput("json::parse", input == &text ? baseName(path) : "x1000", input->size(), measure(run));
+    }
+  }
+}
+
+benchmark("Codecs: decodeBase64")
+{
+  for(auto path : PNG_CORPUS)
+  {
+    auto const data = readCorpus(path);
+
+    if(data.empty())
+      continue;
+
+    auto const text = encodeBase64(data);
+
+    auto run = [&] (int n)
+      {
+        for(int i = 0; i < n; ++i)
+          g_sink = (int)decodeBase64(text).size();
+      };
+
+    reportThroughput("decodeBase64", baseName(path), text.size(), measure(run));
+  }
+}
+
+benchmark("Codecs: importMesh")
+{
+  for(auto side : benchParam("side", { 16, 128 }))
+  {
+    auto const path = "bench_mesh.txt";
+    auto const text = makeMeshText(side);
+    File::write(path, toSpan(text));
+
+    auto run = [&] (int n)
+      {
+        for(int i = 0; i < n; ++i)
+          g_sink = (int)importMesh(path)[0].vertices.size();
+      };
+
+    char input[64];
+    snprintf(input, sizeof input, "grid %dx%d", side, side);
+    reportThroughput("importMesh", input, text.size(), measure(run));
+
+    remove(path);
+  }
+}
+
+benchmark("Audio: mix")
+{
+  // the size of an audio callback
+  auto const BUFFER_SAMPLES = 1024;
+
+  for(auto path : OGG_CORPUS)
+  {
+    if(!File::exists(path))
+    {
+      printf("  (skipped: '%s' not found)\n", path);
+      continue;
+    }
+
+    auto sound = loadSoundFile(path);
+
+    for(auto channelCount : benchParam("channels", { 1, 8 }))
+    {
+      vector<AudioChannel> channels(channelCount);
+      vector<float> output(BUFFER_SAMPLES);
+
+      for(auto& channel : channels)
+      {
+        channel.setOutputRate(48000);
+        channel.play(sound.get(), 0, true);
+      }
+
+      auto run = [&] (int n)
+        {
+          for(int i = 0; i < n; ++i)
+          {
+            for(auto& channel : channels)
+              channel.mix({ output.data(), (int)output.size() });
+          }
+
+          g_sink = (int)output[0];
+        };
+
+      // the bytes of the mixed output, for all the channels
+      char input[64];
+      snprintf(input, sizeof input, "%s x%d", baseName(path), channelCount);
+      reportThroughput("AudioChannel::mix", input, int64_t(BUFFER_SAMPLES * sizeof(float)) * channelCount, measure(run));
+    }
+  }
+}
@@ -599,9 +599,12 @@ struct Quaternion
     return *this * (1.0 / magnitude());
   }
 
+  // Same as '(*this * Quaternion { v, 0 } * conjugate()).v', expanded:
+  // about half the multiplications.
   Vector3f rotate(Vector3f v) const
   {
-    return (*this * Quaternion { v, 0 } *this->conjugate()).v;
+    auto const& u = this->v;
+    return (s * s - dotProduct(u, u)) * v + (2 * dotProduct(u, v)) * u + (2 * s) * crossProduct(u, v);
   }
 };
 
@@ -0,0 +1,70 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Bump allocator, for the transient data of a frame or a tick (e.g the
+// debug texts, the payloads of deferred events): allocating moves a
+// pointer, and 'reset' frees everything at once.
+// The memory is kept from one reset to the next: once the frames reach
+// their usual size, they don't touch the heap anymore.
+// No destructor is called: only for trivially destructible data.
+
+#pragma once
+
+#include <cstddef> // max_align_t
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+#include "base/memory.h"
+
+struct LinearAllocator
+{
+  // 'chunkSize': of the first chunk, the next ones get bigger
+  explicit LinearAllocator(int chunkSize = 4096);
+
+  // valid until the next 'reset'
+  void* allocate(int size, int align = alignof(max_align_t));
+
+  template<typename T>
+  T* allocate(int count)
+  {
+    return (T*)allocate(count * (int)sizeof(T), alignof(T));
+  }
+
+  // zero-terminated copies
+  char const* copy(char const* s);
+  char const* copy(char const* s, int len);
+
+  // printf-like
+  char const* format(char const* fmt, ...)
+#ifdef __GNUC__
+  __attribute__((format(printf, 2, 3)))
+#endif
+  ;
+
+  // Frees all the allocations. The chunks filled since the previous reset
+  // are merged into one, big enough for all of them.
+  void reset();
+
+  // bytes kept, allocated or not
+  int64_t getCapacity() const { return m_capacity.get(); }
+
+private:
+  struct Chunk
+  {
+    unique_ptr<uint8_t[]> data;
+    int size;
+  };
+
+  void addChunk(int minSize);
+
+  int m_chunkSize;
+  vector<Chunk> m_chunks;
+  int m_used = 0; // in the last chunk
+  TrackedMemory m_capacity { MemoryTag::Transient };
+};
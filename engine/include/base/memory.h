@@ -0,0 +1,68 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Memory accounting, per subsystem.
+// The subsystems report what they keep (e.g the samples of a sound), from
+// any thread: nothing is intercepted. The GPU bytes are estimates, from
+// the sizes and formats given to the driver.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+enum class MemoryTag
+{
+  Meshes,
+  Textures,
+  Sounds,
+  Entities,
+  Physics,
+  Transient, // see 'LinearAllocator'
+  GpuTextures,
+  GpuBuffers,
+  GpuTargets, // the framebuffers of the post-processing
+  Count,
+};
+
+// Accounts 'bytes' more to 'tag' (less, if negative)
+void trackMemory(MemoryTag tag, int64_t bytes);
+
+struct MemoryUsage
+{
+  int64_t bytes = 0;
+  int64_t peak = 0; // since the start
+};
+
+MemoryUsage getMemoryUsage(MemoryTag tag);
+
+char const* getMemoryTagName(MemoryTag tag);
+
+// Human-readable, one line per tag, then the CPU and GPU totals
+string dumpMemoryUsage();
+
+// Accounts the bytes it's given to 'tag', as long as it lives
+// (e.g a member, next to the memory it stands for).
+// A copy accounts them again, a move takes them along.
+struct TrackedMemory
+{
+  explicit TrackedMemory(MemoryTag tag, int64_t bytes = 0);
+  TrackedMemory(TrackedMemory const& other);
+  TrackedMemory(TrackedMemory&& other);
+  ~TrackedMemory();
+
+  TrackedMemory& operator = (TrackedMemory const& other);
+  TrackedMemory& operator = (TrackedMemory&& other);
+
+  void set(int64_t bytes);
+  int64_t get() const { return m_bytes; }
+
+private:
+  MemoryTag m_tag;
+  int64_t m_bytes = 0;
+};
@@ -0,0 +1,46 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Named profiling scopes, written as a Chrome trace (chrome://tracing,
+// or https://ui.perfetto.dev), to see the threads, the nesting, and the hitches.
+// The scopes compile to nothing, unless ENABLE_PROFILER is defined
+// (make ENABLE_PROFILER=1).
+
+#pragma once
+
+#include <string>
+
+using namespace std;
+
+// 'name' must outlive the capture (e.g a string literal)
+struct ProfileScope
+{
+  explicit ProfileScope(char const* name);
+  ~ProfileScope();
+
+private:
+  char const* const m_name;
+  double const m_begin; // -1: not capturing
+};
+
+// names the calling thread, in the traces
+void setProfilerThreadName(char const* name);
+
+// Records the scopes, from all the threads, until 'stopProfiling'.
+void startProfiling();
+
+// Returns the trace of what was recorded since 'startProfiling', as JSON.
+string stopProfiling();
+
+bool isProfiling();
+
+#ifdef ENABLE_PROFILER
+#define PROFILE_CONCAT2(a, b) a ## b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) do {} while(0)
+#endif
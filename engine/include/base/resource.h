@@ -17,5 +17,8 @@ struct Resource
   ResourceType type;
   int id;
   char const* path;
+
+  // sounds: the higher, the less likely to be cut off by other sounds
+  int priority = 0;
 };
 
@@ -0,0 +1,72 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Pool of worker threads, with work-stealing.
+// Each worker has its own queue of jobs. Idle workers steal jobs from the
+// other queues. A thread waiting for jobs to complete runs some of them,
+// but only those it waits for.
+// Each job is a profiling scope, on the thread which runs it.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+// The tasks started with it, not completed yet: see 'ThreadPool::wait'.
+// A task depending on others waits for their counter.
+struct JobCounter
+{
+  atomic<int> pending { 0 };
+};
+
+struct ThreadPool
+{
+  // 'threadCount': number of worker threads.
+  // -1 means one less than the number of cores,
+  // the thread calling 'parallelFor' being the missing one.
+  // With zero workers, 'parallelFor' does all the work itself.
+  explicit ThreadPool(int threadCount = -1);
+  ~ThreadPool();
+
+  // Calls 'f(i)' for each 'i' in [0;count[, spread over the workers.
+  // Returns once all calls returned.
+  // The calling thread takes part in the work.
+  void parallelFor(int count, function<void(int)> const& f);
+
+  // Runs 'task' on a worker, without waiting for it.
+  // With zero workers, runs it right away.
+  // The destructor waits for the pending tasks.
+  // Only the workers, or a thread waiting for 'counter', run it: long tasks
+  // don't stall the 'parallelFor' of a tick.
+  // 'counter', if any, counts it until it completes.
+  // 'name' must outlive the pool (e.g a string literal).
+  void run(function<void()> task, JobCounter* counter = nullptr, char const* name = "ThreadPool::run");
+
+  // Same as 'run', but 'task' only runs on the thread calling 'waitPinned'
+  // (e.g the one holding the GL context), whatever the count of workers.
+  void runPinned(function<void()> task, JobCounter* counter = nullptr, char const* name = "ThreadPool::runPinned");
+
+  // Returns once 'counter' drops to zero.
+  // The calling thread takes part in the work.
+  void wait(JobCounter& counter);
+
+  // Same as 'wait', also running the tasks given to 'runPinned'.
+  void waitPinned(JobCounter& counter);
+
+  int getThreadCount() const;
+
+  struct Impl;
+
+private:
+  unique_ptr<Impl> m_impl;
+};
+
+// The pool of the engine, created on first use: one worker per core, but
+// one. Sharing it keeps the threads from outnumbering the cores.
+ThreadPool& getSharedThreadPool();
@@ -10,6 +10,7 @@
 
 #include "geom.h"
 #include "resource.h"
+#include "span.h"
 
 enum class Effect
 {
@@ -34,6 +35,18 @@ struct Actor
   Size3f scale = Size3f(1, 1, 1); // sprite size
   Effect effect = Effect::Normal;
   bool focus = false; // is it the camera?
+
+  // Move since the previous tick: the actor was at 'pos - motion'.
+  // Lets the display draw it in-between ticks.
+  Vector3f motion = Vector3f(0, 0, 0);
+};
+
+// A small, short-lived copy of a model (e.g a spark), see 'View::sendParticles'
+struct Particle
+{
+  Vector3f pos; // of its center, in logical units
+  float size = 1;
+  Vector3f motion = Vector3f(0, 0, 0); // see 'Actor::motion'
 };
 
 // This interface should act as a message sink.
@@ -44,14 +57,59 @@ struct View
 
   virtual void setTitle(char const* gameTitle) = 0;
   virtual void preload(Resource res) = 0;
+
+  // Same as 'preload' on each resource, though the view might load them
+  // in parallel.
+  virtual void preloadAll(Span<const Resource> resources)
+  {
+    for(auto res : resources)
+      preload(res);
+  }
+
+  // Same as 'preload', though the view might read and decode the resource
+  // in the background. Returns true once it's loaded: call it again until
+  // then (e.g once per tick).
+  virtual bool preloadInBackground(Resource res)
+  {
+    preload(res);
+    return true;
+  }
+
   virtual void textBox(char const* msg) = 0;
   virtual void playMusic(int id) = 0;
   virtual void stopMusic() = 0;
   virtual void playSound(int id) = 0;
-  virtual void setCameraPos(Vector3f pos, Quaternion orientation) = 0;
+  // 'motion': the move since the previous tick (see 'Actor::motion')
+  virtual void setCameraPos(Vector3f pos, Quaternion orientation, Vector3f motion) = 0;
   virtual void setAmbientLight(float amount) = 0;
 
   // adds a displayable object to the current frame
   virtual void sendActor(Actor const& actor) = 0;
+
+  // Adds many copies of 'model' to the current frame: no orientation, no
+  // effect, no occlusion query each. The view might draw them in one call.
+  virtual void sendParticles(int model, Span<const Particle> particles)
+  {
+    for(auto& p : particles)
+    {
+      Actor actor(p.pos - Vector3f(p.size, p.size, p.size) * 0.5, model);
+      actor.scale = Size3f(p.size, p.size, p.size);
+      actor.motion = p.motion;
+      sendActor(actor);
+    }
+  }
+
+  // Retained displayable objects: drawn on every frame, until removed.
+  // Cheaper than 'sendActor', for what doesn't change on every frame.
+  virtual int addProxy(Actor const& actor) = 0;
+  virtual void updateProxy(int proxy, Actor const& actor) = 0;
+  virtual void removeProxy(int proxy) = 0;
+
+  // adds a line to the debug overlay of the current frame
+  virtual void sendDebugText(char const* text) = 0;
+
+  // Reports what the last tick cost (e.g "traces"), for the performance
+  // harness. Most views ignore it.
+  virtual void sendCounter(char const* /*name*/, int /*value*/) {}
 };
 
@@ -1,6 +1,8 @@
 SRCS_ENGINE:=\
 	$(BIN)/$(ENGINE_ROOT)/src/render/shaders/mesh/fragment.glsl.cpp\
 	$(BIN)/$(ENGINE_ROOT)/src/render/shaders/mesh/vertex.glsl.cpp\
+	$(BIN)/$(ENGINE_ROOT)/src/render/shaders/depth/fragment.glsl.cpp\
+	$(BIN)/$(ENGINE_ROOT)/src/render/shaders/depth/vertex.glsl.cpp\
 	$(BIN)/$(ENGINE_ROOT)/src/render/shaders/hdr/fragment.glsl.cpp\
 	$(BIN)/$(ENGINE_ROOT)/src/render/shaders/hdr/vertex.glsl.cpp\
 	$(BIN)/$(ENGINE_ROOT)/src/render/shaders/bloom/fragment.glsl.cpp\
@@ -8,22 +10,44 @@ SRCS_ENGINE:=\
 	$(ENGINE_ROOT)/src/app.cpp\
 	$(ENGINE_ROOT)/src/main.cpp\
 	$(ENGINE_ROOT)/src/audio/audio.cpp\
+	$(ENGINE_ROOT)/src/audio/audio_channel.cpp\
+	$(ENGINE_ROOT)/src/audio/audio_null.cpp\
 	$(ENGINE_ROOT)/src/audio/audio_sdl.cpp\
+	$(ENGINE_ROOT)/src/audio/resampler.cpp\
 	$(ENGINE_ROOT)/src/audio/sound_ogg.cpp\
+	$(ENGINE_ROOT)/src/audio/sound_stream.cpp\
+	$(ENGINE_ROOT)/src/audio/voice_manager.cpp\
+	$(ENGINE_ROOT)/src/misc/archive.cpp\
 	$(ENGINE_ROOT)/src/misc/base64.cpp\
+	$(ENGINE_ROOT)/src/misc/control_stream.cpp\
 	$(ENGINE_ROOT)/src/misc/decompress.cpp\
 	$(ENGINE_ROOT)/src/misc/file.cpp\
+	$(ENGINE_ROOT)/src/misc/frame_timings.cpp\
+	$(ENGINE_ROOT)/src/misc/frame_writer.cpp\
 	$(ENGINE_ROOT)/src/misc/json.cpp\
+	$(ENGINE_ROOT)/src/misc/linear_allocator.cpp\
+	$(ENGINE_ROOT)/src/misc/memory.cpp\
+	$(ENGINE_ROOT)/src/misc/profiler.cpp\
+	$(ENGINE_ROOT)/src/misc/thread_pool.cpp\
+	$(ENGINE_ROOT)/src/render/atlas.cpp\
+	$(ENGINE_ROOT)/src/render/display_capture.cpp\
+	$(ENGINE_ROOT)/src/render/display_null.cpp\
 	$(ENGINE_ROOT)/src/render/display_ogl.cpp\
 	$(ENGINE_ROOT)/src/render/glad.cpp\
+	$(ENGINE_ROOT)/src/render/lightmap.cpp\
 	$(ENGINE_ROOT)/src/render/rendermesh.cpp\
 	$(ENGINE_ROOT)/src/render/picture.cpp\
 	$(ENGINE_ROOT)/src/render/png.cpp\
+	$(ENGINE_ROOT)/src/render/render_thread.cpp\
 	$(ENGINE_ROOT)/src/render/mesh_import.cpp\
+	$(ENGINE_ROOT)/src/render/texture.cpp\
 
 $(BIN)/$(ENGINE_ROOT)/src/render/shaders/mesh/vertex.glsl.cpp: NAME=MeshVertexShaderCode
 $(BIN)/$(ENGINE_ROOT)/src/render/shaders/mesh/fragment.glsl.cpp: NAME=MeshFragmentShaderCode
 
+$(BIN)/$(ENGINE_ROOT)/src/render/shaders/depth/vertex.glsl.cpp: NAME=DepthVertexShaderCode
+$(BIN)/$(ENGINE_ROOT)/src/render/shaders/depth/fragment.glsl.cpp: NAME=DepthFragmentShaderCode
+
 $(BIN)/$(ENGINE_ROOT)/src/render/shaders/hdr/vertex.glsl.cpp: NAME=HdrVertexShaderCode
 $(BIN)/$(ENGINE_ROOT)/src/render/shaders/hdr/fragment.glsl.cpp: NAME=HdrFragmentShaderCode
 
@@ -36,10 +60,28 @@ $(BIN)/%.glsl.cpp: %.glsl
 
 $(BIN)/$(ENGINE_ROOT)/src/%: CXXFLAGS+=-I$(ENGINE_ROOT)/src
 
+# MESHCOOKER_GAME_SRCS: provided by the game (e.g cookRoom)
 SRCS_MESHCOOKER:=\
 	$(ENGINE_ROOT)/src/main_meshcooker.cpp\
+	$(ENGINE_ROOT)/src/misc/archive.cpp\
+	$(ENGINE_ROOT)/src/misc/decompress.cpp\
 	$(ENGINE_ROOT)/src/misc/file.cpp\
+	$(ENGINE_ROOT)/src/misc/memory.cpp\
+	$(ENGINE_ROOT)/src/misc/profiler.cpp\
+	$(ENGINE_ROOT)/src/misc/thread_pool.cpp\
+	$(ENGINE_ROOT)/src/render/atlas.cpp\
+	$(ENGINE_ROOT)/src/render/lightmap.cpp\
 	$(ENGINE_ROOT)/src/render/mesh_import.cpp\
+	$(ENGINE_ROOT)/src/render/picture.cpp\
+	$(ENGINE_ROOT)/src/render/png.cpp\
+	$(ENGINE_ROOT)/src/render/rendermesh.cpp\
+	$(ENGINE_ROOT)/src/render/texture.cpp\
+	$(MESHCOOKER_GAME_SRCS)\
+
+SRCS_PACKER:=\
+	$(ENGINE_ROOT)/src/main_packer.cpp\
+	$(ENGINE_ROOT)/src/misc/archive.cpp\
+	$(ENGINE_ROOT)/src/misc/file.cpp\
 
 #-----------------------------------
 $(BIN_HOST):
@@ -48,9 +90,13 @@ $(BIN_HOST):
 $(BIN_HOST)/%.cpp.o: %.cpp
 	@mkdir -p $(dir $@)
 	@echo [HOST] compile "$@"
-	g++ -Iengine/include -Iengine/src -c "$^" -o "$@"
+	g++ -std=c++14 -O2 -pthread -Iengine/include -Iengine/src -c "$^" -o "$@"
 
 $(BIN_HOST)/meshcooker.exe: $(SRCS_MESHCOOKER:%=$(BIN_HOST)/%.o)
 	@mkdir -p $(dir $@)
-	g++ $^ -o '$@'
+	g++ -pthread $^ -o '$@'
+
+$(BIN_HOST)/packer.exe: $(SRCS_PACKER:%=$(BIN_HOST)/%.o)
+	@mkdir -p $(dir $@)
+	g++ -pthread $^ -o '$@'
 
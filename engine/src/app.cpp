@@ -10,7 +10,14 @@
 
 #include "app.h"
 
+#include <algorithm> // remove_if
+#include <cmath> // ceil
+#include <cstdlib> // atoi, atof
+#include <cstring> // strcmp
+#include <map>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -18,22 +25,40 @@
 
 #include "audio/audio.h"
 #include "base/geom.h"
+#include "base/linear_allocator.h"
+#include "base/memory.h"
+#include "base/profiler.h"
 #include "base/resource.h"
 #include "base/scene.h"
+#include "base/thread_pool.h"
 #include "base/util.h" // clamp
 #include "base/view.h"
+#include "misc/control_stream.h"
 #include "misc/file.h"
+#include "misc/frame_timings.h"
+#include "misc/frame_writer.h"
 #include "render/display.h"
+#include "render/display_capture.h"
+#include "render/render_thread.h"
 
 #include "ratecounter.h"
+#include "tick_scheduler.h"
 
 using namespace std;
 
 auto const TIMESTEP = 10;
 auto const RESOLUTION = Size2i(1280, 720);
 
+// when running as fast as possible, draw a frame at least this often (ms)
+auto const FAST_DRAW_PERIOD = 100;
+
+// when vsynced, the display is assumed to refresh at 60Hz (ms)
+auto const VSYNC_FRAME_PERIOD = 1000.0 / 60;
+
 Display* createDisplay(Size2i resolution);
-Audio* createAudio();
+Display* createNullDisplay();
+Audio* createAudio(AudioConfig config);
+Audio* createNullAudio();
 
 Scene* createGame(View* view, vector<string> argv);
 
@@ -41,36 +66,170 @@ class App : View, public IApp
 {
 public:
   App(Span<char*> args)
-    : m_args({ args.data, args.data + args.len })
   {
     SDL_Init(0);
+    setProfilerThreadName("game");
+
+    bool nullDisplay = false;
+    bool nullAudio = false;
+    int gpuBudgetMb = 0; // no limit
+    float gpuTargetMs = 14; // leaves room for the rest, at 60Hz
+    float minResolutionScale = 0.5;
+    float maxResolutionScale = 1;
+    bool renderThread = true;
+    bool depthPrepass = true;
+    bool occlusionCulling = true;
+    string packPath = "res.pack"; // mounted if it exists
+    string displayCapturePath;
+    AudioConfig audioConfig;
+
+    // engine options are not forwarded to the game
+    for(int i = 0; i < args.len; ++i)
+    {
+      auto arg = args[i];
+
+      auto value = [&] ()
+        {
+          if(i + 1 >= args.len)
+            throw runtime_error(string("Missing value for '") + arg + "'");
+
+          return args[++i];
+        };
+
+      if(!strcmp(arg, "--headless"))
+      {
+        nullDisplay = true;
+        nullAudio = true;
+      }
+      else if(!strcmp(arg, "--null-display"))
+        nullDisplay = true;
+      else if(!strcmp(arg, "--null-audio"))
+        nullAudio = true;
+      else if(!strcmp(arg, "--fast"))
+        m_fast = true;
+      else if(!strcmp(arg, "--record"))
+        startRecording(value());
+      else if(!strcmp(arg, "--replay"))
+        startReplay(value());
+      else if(!strcmp(arg, "--gpu-budget"))
+        gpuBudgetMb = atoi(value());
+      else if(!strcmp(arg, "--dynamic-resolution"))
+        gpuTargetMs = atof(value());
+      else if(!strcmp(arg, "--min-resolution-scale"))
+        minResolutionScale = atof(value());
+      else if(!strcmp(arg, "--max-resolution-scale"))
+        maxResolutionScale = atof(value());
+      else if(!strcmp(arg, "--capture-command"))
+        m_captureCommand = value();
+      else if(!strcmp(arg, "--record-display"))
+        displayCapturePath = value();
+      else if(!strcmp(arg, "--no-render-thread"))
+        renderThread = false;
+      else if(!strcmp(arg, "--no-depth-prepass"))
+        depthPrepass = false;
+      else if(!strcmp(arg, "--no-occlusion-culling"))
+        occlusionCulling = false;
+      else if(!strcmp(arg, "--pack"))
+        packPath = value();
+      else if(!strcmp(arg, "--low-latency-audio"))
+        audioConfig = LOW_LATENCY_AUDIO;
+      else if(!strcmp(arg, "--audio-rate"))
+        audioConfig.sampleRate = atoi(value());
+      else if(!strcmp(arg, "--audio-buffer"))
+        audioConfig.bufferFrames = atoi(value());
+      else if(!strcmp(arg, "--trace"))
+        startTrace(value());
+      else
+        m_args.push_back(arg);
+    }
 
-    m_display.reset(createDisplay(RESOLUTION));
-    m_audio.reset(createAudio());
+    // tick for tick: the level loads mustn't depend on the speed of the machine
+    if(m_recordFile || m_replaying)
+      m_args.push_back("--sync-load");
+
+    // before anything gets loaded
+    if(!packPath.empty() && File::exists(packPath))
+      File::mount(packPath);
+
+    mountBundles("res/bundles.txt");
+
+    m_display.reset(nullDisplay ? createNullDisplay() : createDisplay(RESOLUTION));
+
+    if(!displayCapturePath.empty())
+      startDisplayCapture(displayCapturePath);
+    m_audio.reset(nullAudio ? createNullAudio() : createAudio(audioConfig));
+
+    m_display->setMemoryBudget(int64_t(gpuBudgetMb) * 1024 * 1024);
+    m_display->setDynamicResolution(gpuTargetMs, minResolutionScale, maxResolutionScale);
+    m_display->setDepthPrepass(depthPrepass);
+    m_display->setOcclusionCulling(occlusionCulling);
 
     m_scene.reset(createGame(this, m_args));
 
     m_display->enableGrab(m_doGrab);
 
-    m_lastTime = SDL_GetTicks();
-    m_lastDisplayFrameTime = SDL_GetTicks();
+    m_clockStart = SDL_GetPerformanceCounter();
+    m_ticks.start(getTime());
+    m_lastDisplayFrameTime = getTime();
+    m_lastFrameEnd = getTime();
 
     m_fullscreen = true;
     m_display->setFullscreen(true);
+
+    m_vsync = m_display->isVsynced();
+
+    // from now on, the display is only used through 'useDisplay'
+    m_renderThread = make_unique<RenderThread>(m_display.get(), [this] () { draw(m_drawnFrame); }, renderThread);
   }
 
   virtual ~App()
   {
+    m_scene.reset(); // might still talk to the view
+
+    if(m_recordFile)
+      fclose(m_recordFile);
+
+    if(m_captureWriter)
+      stopVideoCapture();
+
+    if(isProfiling())
+      stopTrace();
+
+    m_renderThread.reset();
+
+    if(m_displayCaptureFile)
+    {
+      m_display.reset(); // writes the calls after the last frame
+      fclose(m_displayCaptureFile);
+    }
+
     SDL_Quit();
   }
 
   bool tick() override
   {
+    auto const inputStart = getTime();
     processInput();
 
-    auto const now = (int)SDL_GetTicks();
+    auto const now = getTime();
+    m_timing.ms[FrameTimings::Input] += now - inputStart;
 
-    if(m_fixedDisplayFramePeriod)
+    if(m_fast)
+    {
+      // run the game as fast as possible, ignoring the clock
+      if(!m_paused)
+      {
+        do
+        {
+          tickGameplay();
+        }
+        while(m_running && getTime() - now < FAST_DRAW_PERIOD);
+      }
+
+      m_frame.tickFraction = 1;
+      drawFrame(now);
+    }
+    else if(m_fixedDisplayFramePeriod)
     {
       while(m_lastDisplayFrameTime + m_fixedDisplayFramePeriod < now)
       {
@@ -87,52 +246,278 @@ public:
     return m_running;
   }
 
+  void waitForNextFrame() override
+  {
+    if(m_fast)
+      return;
+
+    double deadline;
+
+    if(m_fixedDisplayFramePeriod)
+      deadline = m_lastDisplayFrameTime + m_fixedDisplayFramePeriod;
+    else if(m_vsync)
+      return; // each frame waits for the previous one to be displayed
+    else
+      deadline = m_ticks.getNextTickTime();
+
+    auto const remaining = deadline - getTime();
+
+    // waking up a bit late is fine: the frame is interpolated
+    if(remaining > 0)
+      SDL_Delay((Uint32)ceil(remaining));
+  }
+
 private:
-  void tickOneDisplayFrame(int now)
+  // in ms, with sub-millisecond precision
+  double getTime() const
   {
-    auto timestep = m_slowMotion ? TIMESTEP * 10 : TIMESTEP;
+    return (SDL_GetPerformanceCounter() - m_clockStart) * 1000.0 / SDL_GetPerformanceFrequency();
+  }
+
+  // Everything needed to draw a frame, sent by the game thread
+  struct Frame
+  {
+    vector<Actor> actors;
+    vector<char const*> debugTexts; // in 'texts'
+
+    // the strings of this frame, freed when the next one gets built
+    LinearAllocator texts;
 
-    while(m_lastTime + timestep < now)
+    // see 'sendParticles'
+    struct ParticleBatch
     {
-      m_lastTime += timestep;
+      int model;
+      int first;
+      int count;
+    };
+
+    vector<Particle> particles;
+    vector<ParticleBatch> particleBatches;
+
+    // since the previous frame, in order
+    struct ProxyChange
+    {
+      int proxy;
+      Actor actor;
+      bool removed;
+    };
+
+    vector<ProxyChange> proxyChanges;
+
+    Vector3f cameraPos;
+    Quaternion cameraOrientation;
+    Vector3f cameraMotion;
+    bool hasCamera = false;
+
+    // time since the last tick, in ticks, in [0 .. 1]
+    float tickFraction = 1;
+
+    float ambientLight = 0;
+    bool hasAmbientLight = false;
+
+    char const* textbox = nullptr; // in 'texts'
+    bool paused = false;
+    bool slowMotion = false;
+    bool debugMode = false;
+    int fps = 0;
+    int lateTicks = 0;
+    int droppedTicks = 0;
+
+    bool screenshot = false;
+    bool capture = false;
 
+    File::FetchProgress fetch; // of the on-demand archives
+  };
+
+  void tickOneDisplayFrame(double now)
+  {
+    m_ticks.timestep = m_slowMotion ? TIMESTEP * 10 : TIMESTEP;
+    m_ticks.framePeriod = m_fixedDisplayFramePeriod ? m_fixedDisplayFramePeriod : m_vsync ? VSYNC_FRAME_PERIOD : 0;
+    m_ticks.beginFrame(now);
+
+    // video capture: every frame must get all its ticks
+    auto clock = [&] () { return m_fixedDisplayFramePeriod ? now : getTime(); };
+
+    while(m_ticks.nextTick(clock()))
+    {
       if(!m_paused)
         tickGameplay();
     }
 
-    // draw the frame
-    m_actors.clear();
-    m_scene->draw();
-    draw();
+    // draw the world as it was in-between the last two ticks
+    m_frame.tickFraction = m_paused ? 1 : m_ticks.getTickFraction();
 
-    m_fps.tick(now);
-
-    captureDisplayFrameIfNeeded();
+    drawFrame(now);
   }
 
-  void captureDisplayFrameIfNeeded()
+  // Builds the frame, and hands it over to the render thread.
+  // The next one is simulated while it's drawn.
+  void drawFrame(double now)
   {
-    if(m_captureFile || m_mustScreenshot)
+    auto const drawStart = getTime();
+
+    m_frame.actors.clear();
+    m_frame.debugTexts.clear();
+    m_frame.texts.reset();
+    m_frame.particles.clear();
+    m_frame.particleBatches.clear();
+
     {
-      vector<uint8_t> pixels(RESOLUTION.width * RESOLUTION.height * 4);
-      m_display->readPixels({ pixels.data(), (int)pixels.size() });
+      PROFILE_SCOPE("Scene::draw");
+      m_scene->draw();
+    }
 
-      if(m_captureFile)
-        fwrite(pixels.data(), 1, pixels.size(), m_captureFile);
+    m_timing.ms[FrameTimings::SceneDraw] = getTime() - drawStart;
 
-      if(m_mustScreenshot)
+    if(m_debugMode)
+    {
+      if(m_memoryPage)
+        sendMemoryUsage();
+      else
+        sendFrameTimings();
+    }
+
+    m_frame.cameraPos = m_camera.pos;
+    m_frame.cameraOrientation = m_camera.orientation;
+    m_frame.cameraMotion = m_camera.motion;
+    m_frame.hasCamera = m_camera.valid;
+
+    m_frame.paused = m_paused;
+    m_frame.slowMotion = m_slowMotion;
+    m_frame.debugMode = m_debugMode;
+    m_frame.fps = m_fps.slope();
+    m_frame.lateTicks = m_ticks.lateTicks;
+    m_frame.droppedTicks = m_ticks.droppedTicks;
+    m_frame.textbox = m_textboxDelay > 0 && !m_textbox.empty() ? m_frame.texts.copy(m_textbox.c_str()) : nullptr;
+    m_frame.screenshot = m_mustScreenshot;
+    m_frame.capture = m_captureWriter != nullptr;
+    m_frame.fetch = File::getFetchProgress();
+
+    if(m_textboxDelay > 0)
+      m_textboxDelay--;
+
+    m_mustScreenshot = false;
+
+    auto const submitStart = getTime();
+
+    m_renderThread->submit([this] ()
       {
-        File::write("screenshot.rgba", pixels);
-        fprintf(stderr, "Saved screenshot to 'screenshot.rgba'\n");
+        swap(m_frame, m_drawnFrame);
 
-        m_mustScreenshot = false;
-      }
+        // the previous frame is done
+        m_timing.ms[FrameTimings::Swap] = m_swapTime;
+      });
+
+    auto const frameEnd = getTime();
+    m_timing.ms[FrameTimings::Submit] = frameEnd - submitStart;
+    m_timing.ms[FrameTimings::Total] = frameEnd - m_lastFrameEnd;
+    m_lastFrameEnd = frameEnd;
+
+    m_frameTimings.push(m_timing);
+    m_timing = {};
+
+    // only sent when they change
+    m_frame.hasAmbientLight = false;
+    m_frame.proxyChanges.clear();
+
+    m_fps.tick((int)now);
+  }
+
+  void sendFrameTimings()
+  {
+    for(int stage = 0; stage < FrameTimings::StageCount; ++stage)
+    {
+      auto const stats = m_frameTimings.getStats(stage);
+
+      m_frame.debugTexts.push_back(m_frame.texts.format("%s ms: p50 %.2f p95 %.2f p99 %.2f max %.2f",
+                                                         FrameTimings::getStageName(stage), stats.p50, stats.p95, stats.p99, stats.max));
     }
+
+    auto const audio = m_audio->getStats();
+
+    if(audio.sampleRate > 0)
+    {
+      m_frame.debugTexts.push_back(m_frame.texts.format("Audio: %d Hz, %d frames (%.1f ms): mix max %.2f ms, %d missed, %d late",
+                                                         audio.sampleRate, audio.bufferFrames, audio.budgetMs, audio.maxMixMs, audio.missedDeadlines, audio.lateCallbacks));
+    }
+  }
+
+  void sendMemoryUsage()
+  {
+    auto const dump = dumpMemoryUsage();
+    size_t start = 0;
+
+    while(start < dump.size())
+    {
+      auto const end = dump.find('\n', start);
+      m_frame.debugTexts.push_back(m_frame.texts.copy(dump.c_str() + start, int(end - start)));
+      start = end + 1;
+    }
+  }
+
+  // Executes 'f' on the display, from the game thread.
+  void useDisplay(function<void()> const& f)
+  {
+    m_renderThread ? m_renderThread->exclusive(f) : f();
+  }
+
+  // render thread
+  void captureDisplayFrameIfNeeded(Frame const& frame)
+  {
+    // the frames come back a few frames later: the pipeline doesn't stall
+    if(frame.capture)
+      m_display->captureFrame(writeCapturedFrame());
+
+    if(frame.screenshot)
+    {
+      vector<uint8_t> pixels(RESOLUTION.width * RESOLUTION.height * 4);
+      m_display->readPixels({ pixels.data(), (int)pixels.size() });
+
+      File::write("screenshot.rgba", pixels);
+      fprintf(stderr, "Saved screenshot to 'screenshot.rgba'\n");
+    }
+  }
+
+  Display::CaptureCallback writeCapturedFrame()
+  {
+    return [this] (Span<const uint8_t> pixels, Size2i size)
+           {
+             if(!m_captureWriter->push(pixels, size.width) && m_captureWriter->getDroppedCount() == 1)
+               fprintf(stderr, "Video capture can't keep up: dropping frames\n");
+           };
   }
 
   void tickGameplay()
   {
+    if(m_replaying)
+    {
+      if(m_replayPos >= (int)m_replay.size())
+      {
+        stopReplay();
+        return;
+      }
+
+      // don't measure the loading time
+      if(m_replayPos == 0)
+        m_replayStartTime = SDL_GetTicks();
+
+      m_control = m_replay[m_replayPos++];
+    }
+
+    if(m_recordFile)
+    {
+      m_recordBuffer.clear();
+      writeControl(m_recordBuffer, m_control);
+      fwrite(m_recordBuffer.data(), 1, m_recordBuffer.size(), m_recordFile);
+    }
+
+    if(!m_fetchingModels.empty())
+      loadFetchedModels();
+
+    auto const tickStart = getTime();
+    PROFILE_SCOPE("Scene::tick");
     auto next = m_scene->tick(m_control);
+    m_timing.ms[FrameTimings::Simulation] += getTime() - tickStart;
     m_control.look_horz = 0;
     m_control.look_vert = 0;
 
@@ -140,6 +525,76 @@ private:
       m_scene.reset(next);
   }
 
+  void startTrace(string path)
+  {
+#ifdef ENABLE_PROFILER
+    m_tracePath = path;
+    startProfiling();
+    fprintf(stderr, "Profiling to '%s'...\n", path.c_str());
+#else
+    fprintf(stderr, "Can't profile to '%s': built without ENABLE_PROFILER\n", path.c_str());
+#endif
+  }
+
+  void stopTrace()
+  {
+    auto const trace = stopProfiling();
+    File::write(m_tracePath, { (uint8_t const*)trace.data(), (int)trace.size() });
+    fprintf(stderr, "Saved the trace to '%s'\n", m_tracePath.c_str());
+  }
+
+  void startRecording(string path)
+  {
+    m_recordFile = fopen(path.c_str(), "wb");
+
+    if(!m_recordFile)
+      throw runtime_error("Can't open '" + path + "' for writing");
+
+    m_recordBuffer.clear();
+    writeControlStreamHeader(m_recordBuffer);
+    fwrite(m_recordBuffer.data(), 1, m_recordBuffer.size(), m_recordFile);
+
+    fprintf(stderr, "Recording input to '%s'\n", path.c_str());
+  }
+
+  // From now on, the display calls are recorded, for 'gpu_replay.exe'
+  void startDisplayCapture(string path)
+  {
+    m_displayCaptureFile = fopen(path.c_str(), "wb");
+
+    if(!m_displayCaptureFile)
+      throw runtime_error("Can't open '" + path + "' for writing");
+
+    auto write = [this] (Span<const uint8_t> data)
+      {
+        fwrite(data.data, 1, data.len, m_displayCaptureFile);
+      };
+
+    m_display.reset(createCaptureDisplay(move(m_display), RESOLUTION, write));
+
+    fprintf(stderr, "Recording the display to '%s'\n", path.c_str());
+  }
+
+  void startReplay(string path)
+  {
+    auto const data = File::read(path);
+    m_replay = readControlStream({ (uint8_t const*)data.data(), (int)data.size() });
+    m_replayPos = 0;
+    m_replaying = true;
+
+    fprintf(stderr, "Replaying %d ticks from '%s'\n", (int)m_replay.size(), path.c_str());
+  }
+
+  void stopReplay()
+  {
+    auto const elapsed = max(1, (int)SDL_GetTicks() - m_replayStartTime);
+    fprintf(stderr, "Replayed %d ticks in %d ms: %.1f ticks/s\n",
+            m_replayPos, elapsed, m_replayPos * 1000.0 / elapsed);
+
+    m_replaying = false;
+    onQuit();
+  }
+
   void processInput()
   {
     SDL_Event event;
@@ -150,7 +605,7 @@ private:
       {
       case SDL_MOUSEBUTTONDOWN:
         m_doGrab = true;
-        m_display->enableGrab(m_doGrab);
+        useDisplay([&] () { m_display->enableGrab(m_doGrab); });
         break;
       case SDL_MOUSEMOTION:
 
@@ -185,37 +640,115 @@ private:
     m_control.debug = m_debugMode;
   }
 
-  void draw()
+  // Where something moving by 'motion' each tick is, 'tickFraction' into
+  // the last tick.
+  static Vector3f interpolate(Vector3f pos, Vector3f motion, float tickFraction)
+  {
+    // teleported: don't fly all the way
+    if(dotProduct(motion, motion) > 10)
+      return pos;
+
+    return pos - motion * (1 - tickFraction);
+  }
+
+  // render thread
+  void drawActor(Actor const& actor, float tickFraction)
   {
+    auto const pos = interpolate(actor.pos, actor.motion, tickFraction);
+    auto where = Rect3f(
+      pos.x, pos.y, pos.z,
+      actor.scale.cx, actor.scale.cy, actor.scale.cz);
+    m_display->drawActor(where, actor.orientation, (int)actor.model, actor.effect == Effect::Blinking, actor.action, actor.ratio);
+  }
+
+  // render thread
+  void draw(Frame const& frame)
+  {
+    if(frame.hasCamera)
+      m_display->setCamera(interpolate(frame.cameraPos, frame.cameraMotion, frame.tickFraction), frame.cameraOrientation);
+
+    if(frame.hasAmbientLight)
+      m_display->setAmbientLight(frame.ambientLight);
+
+    for(auto& change : frame.proxyChanges)
+    {
+      if(change.proxy >= (int)m_proxies.size())
+        m_proxies.resize(change.proxy + 1);
+
+      m_proxies[change.proxy].actor = change.actor;
+      m_proxies[change.proxy].alive = !change.removed;
+    }
+
     m_display->beginDraw();
 
-    for(auto& actor : m_actors)
+    for(auto& proxy : m_proxies)
+      if(proxy.alive)
+        drawActor(proxy.actor, frame.tickFraction);
+
+    for(auto& actor : frame.actors)
+      drawActor(actor, frame.tickFraction);
+
+    for(auto& batch : frame.particleBatches)
     {
-      auto where = Rect3f(
-        actor.pos.x, actor.pos.y, actor.pos.z,
-        actor.scale.cx, actor.scale.cy, actor.scale.cz);
-      m_display->drawActor(where, actor.orientation, (int)actor.model, actor.effect == Effect::Blinking, actor.action, actor.ratio);
+      m_particleRects.clear();
+
+      for(int i = batch.first; i < batch.first + batch.count; ++i)
+      {
+        auto& p = frame.particles[i];
+        auto const pos = interpolate(p.pos, p.motion, frame.tickFraction) - Vector3f(p.size, p.size, p.size) * 0.5;
+        m_particleRects.push_back(Rect3f(pos.x, pos.y, pos.z, p.size, p.size, p.size));
+      }
+
+      m_display->drawParticles(batch.model, m_particleRects);
     }
 
-    if(m_paused)
+    if(frame.paused)
       m_display->drawText(Vector2f(0, 2), "PAUSE");
-    else if(m_slowMotion)
+    else if(frame.slowMotion)
       m_display->drawText(Vector2f(0, 0), "SLOW-MOTION MODE");
 
-    if(m_debugMode)
+    if(frame.debugMode)
     {
       char debugText[256];
-      sprintf(debugText, "FPS: %d", m_fps.slope());
+      sprintf(debugText, "FPS: %d", frame.fps);
       m_display->drawText(Vector2f(0, -4), debugText);
+
+      int line = -5;
+
+      sprintf(debugText, "Ticks: %d late, %d dropped", frame.lateTicks, frame.droppedTicks);
+      m_display->drawText(Vector2f(0, line--), debugText);
+
+      auto const timings = m_display->getGpuTimings();
+
+      if(timings.len > 0)
+      {
+        int n = sprintf(debugText, "GPU ms:");
+
+        for(auto& timing : timings)
+          n += snprintf(debugText + n, sizeof(debugText) - n, " %s %.2f", timing.name, timing.ms);
+
+        m_display->drawText(Vector2f(0, line--), debugText);
+      }
+
+      for(auto text : frame.debugTexts)
+        m_display->drawText(Vector2f(0, line--), text);
     }
 
-    if(m_textboxDelay > 0)
+    if(frame.textbox)
+      m_display->drawText(Vector2f(0, 0), frame.textbox);
+
+    if(frame.fetch.total > 0)
     {
-      m_display->drawText(Vector2f(0, 0), m_textbox.c_str());
-      m_textboxDelay--;
+      char text[64];
+      snprintf(text, sizeof text, "DOWNLOADING %d%%", int(frame.fetch.received * 100 / frame.fetch.total));
+      m_display->drawText(Vector2f(0, -2), text);
     }
 
+    auto const swapStart = getTime();
     m_display->endDraw();
+    m_swapTime = getTime() - swapStart;
+
+    captureDisplayFrameIfNeeded(frame);
   }
 
   void onQuit()
@@ -225,7 +758,7 @@ private:
 
   void toggleVideoCapture()
   {
-    if(!m_captureFile)
+    if(!m_captureWriter)
     {
       if(m_fullscreen)
       {
@@ -233,36 +766,51 @@ private:
         return;
       }
 
-      m_captureFile = fopen("capture.rgba", "wb");
-
-      if(!m_captureFile)
+      try
       {
-        fprintf(stderr, "Can't start video capture!\n");
+        if(m_captureCommand.empty())
+          m_captureWriter = make_unique<FrameWriter>("capture.rgba");
+        else
+          m_captureWriter = make_unique<FrameWriter>(m_captureCommand, true);
+      }
+      catch(exception const& e)
+      {
+        fprintf(stderr, "Can't start video capture: %s\n", e.what());
         return;
       }
 
+      // a steady frame rate in the file, whatever the display's
       m_fixedDisplayFramePeriod = 40;
       fprintf(stderr, "Capturing video at %d Hz...\n", 1000 / m_fixedDisplayFramePeriod);
     }
     else
     {
-      fprintf(stderr, "Stopped video capture\n");
-      fclose(m_captureFile);
-      m_captureFile = nullptr;
-      m_fixedDisplayFramePeriod = 0;
+      stopVideoCapture();
     }
   }
 
+  // Writes the frames still being read back, then the ones still queued.
+  void stopVideoCapture()
+  {
+    useDisplay([&] () { m_display->flushCaptures(writeCapturedFrame()); });
+
+    auto const dropped = m_captureWriter->getDroppedCount();
+    m_captureWriter.reset();
+    m_fixedDisplayFramePeriod = 0;
+
+    fprintf(stderr, "Stopped video capture (%d frames dropped)\n", dropped);
+  }
+
   void toggleFullScreen()
   {
-    if(m_captureFile)
+    if(m_captureWriter)
     {
       fprintf(stderr, "Can't toggle full-screen during video capture\n");
       return;
     }
 
     m_fullscreen = !m_fullscreen;
-    m_display->setFullscreen(m_fullscreen);
+    useDisplay([&] () { m_display->setFullscreen(m_fullscreen); });
   }
 
   void onMouseMotion(SDL_Event* evt)
@@ -326,17 +874,47 @@ private:
         if(evt->key.keysym.mod & KMOD_LALT)
         {
           m_enableFsaa = !m_enableFsaa;
-          m_display->setFsaa(m_enableFsaa);
+          useDisplay([&] () { m_display->setFsaa(m_enableFsaa); });
         }
         else
         {
           m_enableHdr = !m_enableHdr;
-          m_display->setHdr(m_enableHdr);
+          useDisplay([&] () { m_display->setHdr(m_enableHdr); });
         }
 
         break;
       }
 
+    case SDLK_F3:
+      {
+        auto const csv = m_frameTimings.toCsv();
+        File::write("frame_times.csv", { (uint8_t const*)csv.data(), (int)csv.size() });
+        fprintf(stderr, "Saved the last %d frame timings to 'frame_times.csv'\n", m_frameTimings.size());
+        break;
+      }
+
+    case SDLK_F4:
+      {
+        if(isProfiling())
+          stopTrace();
+        else
+          startTrace("trace.json");
+
+        break;
+      }
+
+    case SDLK_F5:
+      {
+        fprintf(stderr, "Memory usage:\n%s", dumpMemoryUsage().c_str());
+        break;
+      }
+
+    case SDLK_F6:
+      {
+        m_memoryPage = !m_memoryPage;
+        break;
+      }
+
     case SDLK_SCROLLLOCK:
       {
         m_debugMode = !m_debugMode;
@@ -354,7 +932,7 @@ private:
     case SDLK_RCTRL:
       {
         m_doGrab = !m_doGrab;
-        m_display->enableGrab(m_doGrab);
+        useDisplay([&] () { m_display->enableGrab(m_doGrab); });
         break;
       }
     }
@@ -368,22 +946,139 @@ private:
   // View implementation
   void setTitle(char const* gameTitle) override
   {
-    m_display->setCaption(gameTitle);
+    useDisplay([&] () { m_display->setCaption(gameTitle); });
   }
 
   void preload(Resource res) override
   {
+    if(!markLoaded(res))
+      return;
+
     switch(res.type)
     {
     case ResourceType::Sound:
-      m_audio->loadSound(res.id, res.path);
+      m_audio->loadSound(res);
       break;
     case ResourceType::Model:
-      m_display->loadModel(res.id, res.path);
-      break;
+      {
+        // replaces the one not fetched yet, if any
+        auto sameId = [&] (Resource const& other) { return other.id == res.id; };
+        m_fetchingModels.erase(remove_if(m_fetchingModels.begin(), m_fetchingModels.end(), sameId), m_fetchingModels.end());
+
+        if(!File::prefetch(res.path))
+        {
+          m_fetchingModels.push_back(res);
+          break;
+        }
+
+        useDisplay([&] () { m_display->loadModel(res.id, res.path); });
+        break;
+      }
     }
   }
 
+  // The models whose archive was being fetched, once it's there.
+  // Before each tick: the scene can't use them before.
+  void loadFetchedModels()
+  {
+    for(int i = 0; i < (int)m_fetchingModels.size(); ++i)
+    {
+      auto const res = m_fetchingModels[i];
+
+      if(!File::prefetch(res.path))
+        continue;
+
+      useDisplay([&] () { m_display->loadModel(res.id, res.path); });
+      m_fetchingModels.erase(m_fetchingModels.begin() + i--);
+    }
+  }
+
+  // The web version fetches the rooms when they're needed: each line of
+  // 'manifestPath' is an archive, then the path prefixes of its files.
+  static void mountBundles(string manifestPath)
+  {
+    if(!File::exists(manifestPath))
+      return;
+
+    istringstream lines(File::read(manifestPath));
+    string line;
+
+    while(getline(lines, line))
+    {
+      istringstream words(line);
+      string archive;
+      vector<string> prefixes;
+
+      words >> archive;
+
+      for(string prefix; words >> prefix;)
+        prefixes.push_back(prefix);
+
+      if(!archive.empty())
+        File::mountOnDemand(archive, prefixes);
+    }
+  }
+
+  void preloadAll(Span<const Resource> resources) override
+  {
+    vector<Resource> sounds;
+    vector<Resource> models;
+
+    for(auto res : resources)
+    {
+      if(markLoaded(res))
+        (res.type == ResourceType::Sound ? sounds : models).push_back(res);
+    }
+
+    if(sounds.empty() && models.empty())
+      return;
+
+    auto& pool = getSharedThreadPool();
+
+    m_audio->loadSounds(sounds, pool);
+    useDisplay([&] () { m_display->loadModels(models, pool); });
+  }
+
+  // Only the models load in the background, the GPU upload stays here.
+  bool preloadInBackground(Resource res) override
+  {
+    if(res.type != ResourceType::Model)
+    {
+      preload(res);
+      return true;
+    }
+
+    auto i = m_loaded.find({ (int)res.type, res.id });
+
+    if(i != m_loaded.end() && i->second == res.path)
+      return true;
+
+    // the web version fetches its archive first
+    if(!File::prefetch(res.path))
+      return false;
+
+    bool loaded = false;
+    useDisplay([&] () { loaded = m_display->loadModelInBackground(res.id, res.path, getSharedThreadPool()); });
+
+    if(loaded)
+      markLoaded(res);
+
+    return loaded;
+  }
+
+  // Game resets preload the same resources again: only load what changed.
+  // Returns false if 'res' is already loaded, from the same path.
+  bool markLoaded(Resource res)
+  {
+    auto& path = m_loaded[{ (int)res.type, res.id }];
+
+    if(path == res.path)
+      return false;
+
+    path = res.path;
+    return true;
+  }
+
   void textBox(char const* msg) override
   {
     m_textbox = msg;
@@ -405,34 +1100,100 @@ private:
     m_audio->playSound(sound);
   }
 
-  void setCameraPos(Vector3f pos, Quaternion orientation) override
+  // kept until the next call: the scene might not send it on every frame
+  void setCameraPos(Vector3f pos, Quaternion orientation, Vector3f motion) override
   {
-    m_display->setCamera(pos, orientation);
+    m_camera.pos = pos;
+    m_camera.orientation = orientation;
+    m_camera.motion = motion;
+    m_camera.valid = true;
   }
 
   void setAmbientLight(float amount) override
   {
-    m_display->setAmbientLight(amount);
+    m_frame.ambientLight = amount;
+    m_frame.hasAmbientLight = true;
   }
 
   void sendActor(Actor const& actor) override
   {
-    m_actors.push_back(actor);
+    m_frame.actors.push_back(actor);
+  }
+
+  void sendParticles(int model, Span<const Particle> particles) override
+  {
+    m_frame.particleBatches.push_back({ model, (int)m_frame.particles.size(), particles.len });
+    m_frame.particles.insert(m_frame.particles.end(), particles.begin(), particles.end());
+  }
+
+  int addProxy(Actor const& actor) override
+  {
+    int proxy;
+
+    if(m_freeProxies.empty())
+    {
+      proxy = m_proxyCount++;
+    }
+    else
+    {
+      proxy = m_freeProxies.back();
+      m_freeProxies.pop_back();
+    }
+
+    m_frame.proxyChanges.push_back({ proxy, actor, false });
+    return proxy;
+  }
+
+  void updateProxy(int proxy, Actor const& actor) override
+  {
+    m_frame.proxyChanges.push_back({ proxy, actor, false });
+  }
+
+  void removeProxy(int proxy) override
+  {
+    m_frame.proxyChanges.push_back({ proxy, Actor(), true });
+    m_freeProxies.push_back(proxy);
+  }
+
+  void sendDebugText(char const* text) override
+  {
+    m_frame.debugTexts.push_back(m_frame.texts.copy(text));
   }
 
   int keys[SDL_NUM_SCANCODES] {};
   int m_running = 1;
   int m_fixedDisplayFramePeriod = 0;
-  FILE* m_captureFile = nullptr;
+  unique_ptr<FrameWriter> m_captureWriter;
+  string m_captureCommand; // empty: raw frames to 'capture.rgba'
+  bool m_fast = false; // don't wait for the clock
+
+  string m_tracePath;
+
+  // input recording/replay
+  FILE* m_recordFile = nullptr;
+  vector<uint8_t> m_recordBuffer;
+  vector<Control> m_replay;
+  int m_replayPos = 0;
+  int m_replayStartTime = 0;
+  bool m_replaying = false;
   bool m_mustScreenshot = false;
 
+  FILE* m_displayCaptureFile = nullptr; // see '--record-display'
+
   bool m_debugMode = false;
+  bool m_memoryPage = false; // of the debug overlay, instead of the timings
   bool m_enableHdr = true;
   bool m_enableFsaa = false;
 
-  int m_lastTime;
-  int m_lastDisplayFrameTime;
+  TickScheduler m_ticks;
+  Uint64 m_clockStart;
+  double m_lastDisplayFrameTime;
+  bool m_vsync = false;
   RateCounter m_fps;
+  FrameTimings m_frameTimings;
+  FrameTimings::Sample m_timing; // of the frame being built
+  double m_lastFrameEnd = 0;
+  float m_swapTime = 0; // of the last frame drawn (render thread)
   Control m_control {};
   vector<string> m_args;
   unique_ptr<Scene> m_scene;
@@ -442,10 +1203,37 @@ private:
   bool m_doGrab = true;
   unique_ptr<Audio> m_audio;
   unique_ptr<Display> m_display;
-  vector<Actor> m_actors;
+  map<pair<int, int>, string> m_loaded; // (type, id) -> path
+  vector<Resource> m_fetchingModels; // preloaded, their archive not fetched yet
 
   string m_textbox;
   int m_textboxDelay = 0;
+
+  struct
+  {
+    Vector3f pos;
+    Quaternion orientation;
+    Vector3f motion;
+    bool valid = false;
+  } m_camera;
+
+  // retained actors, see 'addProxy'
+  vector<int> m_freeProxies;
+  int m_proxyCount = 0;
+
+  struct Proxy
+  {
+    Actor actor;
+    bool alive = false;
+  };
+
+  vector<Proxy> m_proxies; // render thread
+  vector<Rect3f> m_particleRects; // render thread, see 'draw'
+
+  Frame m_frame; // being built by the game thread
+  Frame m_drawnFrame; // being drawn by the render thread
+
+  unique_ptr<RenderThread> m_renderThread;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
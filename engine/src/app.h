@@ -15,6 +15,10 @@ struct IApp
 {
   virtual ~IApp() = default;
   virtual bool tick() = 0;
+
+  // Sleeps until there's something to do: the next tick, or frame.
+  // Not used in the browser, where the frames are driven by the page.
+  virtual void waitForNextFrame() = 0;
 };
 
 unique_ptr<IApp> createApp(Span<char*> args);
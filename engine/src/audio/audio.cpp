@@ -10,6 +10,7 @@
 #include "audio_backend.h"
 #include "sound.h"
 
+#include "base/thread_pool.h"
 #include "misc/file.h" // exists
 
 #include <cmath> // sin
@@ -53,23 +54,42 @@ struct HighLevelAudio : Audio
   {
   }
 
-  void loadSound(int id, const char* path) override
+  void loadSound(Resource res) override
   {
-    sounds.resize(max(id + 1, (int)sounds.size()));
+    sounds.resize(max(res.id + 1, (int)sounds.size()));
+    priorities.resize(sounds.size());
+    sounds[res.id] = readSound(res.path);
+    priorities[res.id] = res.priority;
+  }
+
+  void loadSounds(Span<const Resource> toLoad, ThreadPool& pool) override
+  {
+    // each job writes to its own slot
+    for(auto res : toLoad)
+      sounds.resize(max(res.id + 1, (int)sounds.size()));
+
+    priorities.resize(sounds.size());
 
+    for(auto res : toLoad)
+      priorities[res.id] = res.priority;
+
+    pool.parallelFor(toLoad.len, [&] (int i) { sounds[toLoad[i].id] = readSound(toLoad[i].path); });
+  }
+
+  static unique_ptr<Sound> readSound(const char* path)
+  {
     if(!File::exists(path))
     {
       printf("[audio] sound '%s' was not found, fallback on default sound\n", path);
-      sounds[id] = make_unique<BleepSound>();
-      return;
+      return make_unique<BleepSound>();
     }
 
-    sounds[id] = loadSoundFile(path);
+    return loadSoundFile(path);
   }
 
   void playSound(int id) override
   {
-    m_backend->playSound(sounds[id].get());
+    m_backend->playSound(sounds[id].get(), priorities[id]);
   }
 
   void playMusic(int id) override
@@ -90,7 +110,7 @@ struct HighLevelAudio : Audio
     currMusic = id;
     printf("[audio] playing music: %s\n", path);
 
-    musicChannel = m_backend->playLoop(loadSoundFile(path).release());
+    musicChannel = m_backend->playLoop(streamSoundFile(path).release());
   }
 
   void stopMusic() override
@@ -98,18 +118,30 @@ struct HighLevelAudio : Audio
     m_backend->stopLoop(musicChannel);
   }
 
+  AudioStats getStats() override
+  {
+    return m_backend->getStats();
+  }
+
   int currMusic = -1;
   int musicChannel = -1;
   const unique_ptr<IAudioBackend> m_backend;
   vector<unique_ptr<Sound>> sounds;
+  vector<int> priorities; // by sound id
 };
 
 ///////////////////////////////////////////////////////////////////////////////
 
-IAudioBackend* createAudioBackend();
+IAudioBackend* createAudioBackend(AudioConfig config);
+IAudioBackend* createNullAudioBackend();
+
+Audio* createAudio(AudioConfig config)
+{
+  return new HighLevelAudio(std::unique_ptr<IAudioBackend>(createAudioBackend(config)));
+}
 
-Audio* createAudio()
+Audio* createNullAudio()
 {
-  return new HighLevelAudio(std::unique_ptr<IAudioBackend>(createAudioBackend()));
+  return new HighLevelAudio(std::unique_ptr<IAudioBackend>(createNullAudioBackend()));
 }
 
@@ -6,13 +6,45 @@
 
 #pragma once
 
+#include "base/resource.h"
+#include "base/span.h"
+
+struct ThreadPool;
+
+struct AudioConfig
+{
+  int sampleRate = 48000; // a request: the device might use another one
+  int bufferFrames = 512; // the latency: ~11ms at 48000 Hz
+};
+
+// More callbacks, each with less time: might underrun on slow devices
+static auto const LOW_LATENCY_AUDIO = AudioConfig { 48000, 128 };
+
+// Measured on the audio thread, for the debug overlay
+struct AudioStats
+{
+  int sampleRate = 0; // zero: no audio device
+  int bufferFrames = 0;
+  float budgetMs = 0; // what a buffer lasts: what a mix should take at most
+  float maxMixMs = 0; // since the previous call to 'getStats'
+  int callbacks = 0;
+  int missedDeadlines = 0; // mixes longer than 'budgetMs': the device starved
+  int lateCallbacks = 0; // after a gap longer than two buffers
+};
+
 struct Audio
 {
   virtual ~Audio() = default;
 
-  virtual void loadSound(int id, const char* path) = 0;
+  virtual void loadSound(Resource sound) = 0;
+
+  // Same as 'loadSound' for each sound, decoding them on 'pool'.
+  virtual void loadSounds(Span<const Resource> sounds, ThreadPool& pool) = 0;
+
   virtual void playSound(int id) = 0;
   virtual void playMusic(int id) = 0;
   virtual void stopMusic() = 0;
+
+  virtual AudioStats getStats() = 0;
 };
 
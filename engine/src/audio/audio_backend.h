@@ -6,16 +6,21 @@
 
 #pragma once
 
+#include "audio.h" // AudioStats
+
 struct Sound;
 
 struct IAudioBackend
 {
   virtual ~IAudioBackend() = default;
 
-  virtual void playSound(Sound* sound) = 0;
+  // The higher 'priority', the less likely to be cut off by other sounds
+  virtual void playSound(Sound* sound, int priority) = 0;
 
   // takes ownership of 'sound'!
   virtual int playLoop(Sound* sound) = 0;
   virtual void stopLoop(int channel) = 0;
+
+  virtual AudioStats getStats() { return {}; }
 };
 
@@ -0,0 +1,53 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Mixing of the audio channels
+
+#include "audio_channel.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define AUDIO_MIX_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define AUDIO_MIX_NEON 1
+#endif
+
+void mixRamp(float* output, float const* input, int count, float startVolume, float endVolume)
+{
+  // per frame: both channels of a frame get the same volume
+  auto const step = count >= 2 ? (endVolume - startVolume) / (count / 2) : 0.0f;
+  int i = 0;
+
+#if AUDIO_MIX_SSE
+  // two frames at once
+  auto volume = _mm_setr_ps(startVolume, startVolume, startVolume + step, startVolume + step);
+  auto const increment = _mm_set1_ps(step * 2);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    auto const mixed = _mm_add_ps(_mm_loadu_ps(output + i), _mm_mul_ps(_mm_loadu_ps(input + i), volume));
+    _mm_storeu_ps(output + i, mixed);
+    volume = _mm_add_ps(volume, increment);
+  }
+
+#elif AUDIO_MIX_NEON
+  float const first[4] = { startVolume, startVolume, startVolume + step, startVolume + step };
+  auto volume = vld1q_f32(first);
+  auto const increment = vdupq_n_f32(step * 2);
+
+  for(; i + 4 <= count; i += 4)
+  {
+    vst1q_f32(output + i, vmlaq_f32(vld1q_f32(output + i), vld1q_f32(input + i), volume));
+    volume = vaddq_f32(volume, increment);
+  }
+
+#endif
+
+  for(; i < count; ++i)
+    output[i] += input[i] * (startVolume + step * (i / 2));
+}
+
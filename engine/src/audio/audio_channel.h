@@ -9,13 +9,20 @@
 #pragma once
 
 #include "sound.h"
+#include "resampler.h"
 #include <cassert>
+#include <algorithm> // min
 #include <memory>
+#include <vector>
 
 using namespace std;
 
 auto const CHUNK_PERIOD = 32; // sample count between audio param updates
 
+// output[i] += input[i] * volume, the volume going linearly from
+// 'startVolume' to 'endVolume' over the 'count' samples (interleaved stereo).
+void mixRamp(float* output, float const* input, int count, float startVolume, float endVolume);
+
 struct LoopingSource : IAudioSource
 {
   LoopingSource(Sound* sound_) : sound(sound_) {}
@@ -39,6 +46,25 @@ struct LoopingSource : IAudioSource
     return dst.len;
   }
 
+  int skip(int count) override
+  {
+    auto remaining = count;
+
+    while(remaining > 0)
+    {
+      if(!src)
+        src = sound->createSource();
+
+      auto const N = src->skip(remaining);
+      remaining -= N;
+
+      if(N == 0)
+        src.reset();
+    }
+
+    return count;
+  }
+
 private:
   Sound* sound;
   unique_ptr<IAudioSource> src;
@@ -60,41 +86,99 @@ struct AudioChannel
     else
       m_source = sound->createSource();
 
+    if(m_outputRate > 0)
+      m_source = make_unique<ResamplingSource>(sound, move(m_source), m_outputRate);
+
+    m_fadingOut = false;
     m_volume = 0;
     m_targetVolume = 1;
-    m_volumeIncrement = (m_targetVolume - m_volume) / (200 * fadeInInertia);
+
+    if(fadeInInertia > 0)
+      m_volumeIncrement = (m_targetVolume - m_volume) / (200 * fadeInInertia);
+    else
+    {
+      m_volume = m_targetVolume;
+      m_volumeIncrement = 0;
+    }
   }
 
+  // Adds the next samples of the sound to 'output', of any length
   void mix(Span<float> output)
   {
-    assert(output.len <= CHUNK_PERIOD);
-    startChunk();
+    if(!m_source)
+    {
+      m_isDead = true;
+      return;
+    }
 
-    while(output.len > 0)
+    // the whole buffer at once: one virtual call per channel, in general
+    if((int)m_buffer.size() < output.len)
+      m_buffer.resize(output.len);
+
+    auto input = Span<float>(m_buffer.data(), output.len);
+
+    while(input.len > 0)
     {
-      if(!m_source)
+      auto const N = m_source->read(input);
+      input += N;
+
+      // finished playing?
+      if(N == 0)
+      {
+        m_source.reset();
         break;
+      }
+    }
 
-      float chunkData[CHUNK_PERIOD] = { 0 };
-      auto chunk = Span<float>(chunkData);
-      chunk.len = output.len;
+    auto const count = output.len - input.len;
 
-      auto const N = m_source->read(chunk);
+    for(int i = 0; i < count && !m_isDead; i += CHUNK_PERIOD)
+    {
+      auto const n = min(CHUNK_PERIOD, count - i);
+      auto const startVolume = m_volume;
+      startChunk();
+      mixRamp(output.data + i, m_buffer.data() + i, n, startVolume, m_volume);
+    }
 
-      for(int i = 0; i < chunk.len; ++i)
-        output.data[i] += chunk.data[i] * m_volume;
+    if(!m_source)
+      m_isDead = true;
+  }
 
-      output += N;
+  // Same as 'mix', without the output: the sound goes on, inaudible
+  void skip(int count)
+  {
+    if(!m_source)
+    {
+      m_isDead = true;
+      return;
+    }
+
+    int skipped = 0;
+
+    while(skipped < count)
+    {
+      auto const N = m_source->skip(count - skipped);
+      skipped += N;
 
-      // finished playing?
       if(N == 0)
+      {
         m_source.reset();
+        break;
+      }
     }
 
+    for(int i = 0; i < skipped && !m_isDead; i += CHUNK_PERIOD)
+      startChunk();
+
     if(!m_source)
       m_isDead = true;
   }
 
+  float getVolume() const
+  {
+    return m_volume;
+  }
+
   void startChunk()
   {
     m_volume += m_volumeIncrement;
@@ -114,6 +198,12 @@ struct AudioChannel
       m_isDead = true;
   }
 
+  // In Hz. The sounds get converted to it, zero leaves them as they are.
+  void setOutputRate(int rate)
+  {
+    m_outputRate = rate;
+  }
+
   void fadeOut()
   {
     auto const fadeOutInertia = 4;
@@ -128,6 +218,8 @@ private:
   float m_targetVolume = 1.0;
   bool m_fadingOut = false;
   bool m_isDead = true;
+  int m_outputRate = 0;
   unique_ptr<IAudioSource> m_source;
+  vector<float> m_buffer; // what the source read, before the volume
 };
 
@@ -0,0 +1,35 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Headless audio output: sounds are accepted, but never mixed.
+
+#include "audio_backend.h"
+#include "sound.h"
+
+namespace
+{
+struct NullAudioBackend : IAudioBackend
+{
+  void playSound(Sound*, int) override
+  {
+  }
+
+  int playLoop(Sound* sound) override
+  {
+    delete sound;
+    return 0;
+  }
+
+  void stopLoop(int) override
+  {
+  }
+};
+}
+
+IAudioBackend* createNullAudioBackend()
+{
+  return new NullAudioBackend;
+}
@@ -8,13 +8,17 @@
 
 #include "audio_backend.h"
 #include "audio_channel.h"
+#include "audio_telemetry.h"
+#include "ring_buffer.h"
 #include "sound.h"
+#include "voice_manager.h"
 
 #include <memory>
 #include <stdexcept>
 #include <SDL.h>
 #include <vector>
 
+#include "base/profiler.h"
 #include "base/span.h"
 #include "base/util.h"
 
@@ -22,12 +26,28 @@ using namespace std;
 
 namespace
 {
-auto const MAX_CHANNELS = 16;
+auto const MAX_AUDIBLE_VOICES = 15; // the music is mixed too
+auto const MAX_VOICES = 64;
 auto const LOOP_CHANNEL = 0;
 
+// From the game thread to the audio thread, see 'SdlAudioBackend::m_commands'
+struct AudioCommand
+{
+  enum Type
+  {
+    PlaySound,
+    PlayLoop, // 'sound' is owned by the command
+    StopLoop,
+  };
+
+  Type type;
+  Sound* sound;
+  int priority;
+};
+
 struct SdlAudioBackend : IAudioBackend
 {
-  SdlAudioBackend()
+  SdlAudioBackend(AudioConfig config)
   {
     auto ret = SDL_InitSubSystem(SDL_INIT_AUDIO);
 
@@ -35,10 +55,10 @@ struct SdlAudioBackend : IAudioBackend
       throw runtime_error("Can't init audio subsystem");
 
     SDL_AudioSpec desired {};
-    desired.freq = 22050;
+    desired.freq = config.sampleRate;
     desired.format = AUDIO_F32SYS;
     desired.channels = 2;
-    desired.samples = 512;
+    desired.samples = config.bufferFrames;
     desired.callback = &staticMixAudio;
     desired.userdata = this;
 
@@ -50,13 +70,15 @@ struct SdlAudioBackend : IAudioBackend
       throw runtime_error("Can't open audio");
     }
 
-    printf("[audio] %d Hz %d channels\n",
+    printf("[audio] %d Hz %d channels, %d frames per buffer\n",
            audiospec.freq,
-           audiospec.channels);
+           audiospec.channels,
+           audiospec.samples);
 
-    m_channels.resize(MAX_CHANNELS);
+    m_telemetry = make_unique<AudioTelemetry>(audiospec.freq, audiospec.samples);
 
-    mixBuffer.resize(audiospec.samples * audiospec.channels);
+    m_musicChannel.setOutputRate(audiospec.freq);
+    m_voices.setOutputRate(audiospec.freq);
 
     SDL_PauseAudioDevice(audioDevice, 0);
     printf("[audio] init OK\n");
@@ -67,34 +89,27 @@ struct SdlAudioBackend : IAudioBackend
     SDL_PauseAudioDevice(audioDevice, 1);
 
     SDL_CloseAudioDevice(audioDevice);
+
+    // the loops never started
+    AudioCommand cmd;
+
+    while(m_commands.read({ &cmd, 1 }) == 1)
+      if(cmd.type == AudioCommand::PlayLoop)
+        delete cmd.sound;
+
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
     printf("[audio] shutdown OK\n");
   }
 
-  void playSound(Sound* sound) override
+  void playSound(Sound* sound, int priority) override
   {
-    SDL_LockAudioDevice(audioDevice);
-    auto channel = allocChannel();
-    SDL_UnlockAudioDevice(audioDevice);
-
-    if(!channel)
-    {
-      printf("[audio] no channel available\n");
-      return;
-    }
-
-    channel->play(sound);
+    push({ AudioCommand::PlaySound, sound, priority });
   }
 
   int playLoop(Sound* sound) override
   {
-    SDL_LockAudioDevice(audioDevice);
-
-    if(!m_channels[LOOP_CHANNEL].isDead())
-      m_channels[LOOP_CHANNEL].fadeOut();
-
-    m_nextMusic.reset(sound);
-    SDL_UnlockAudioDevice(audioDevice);
+    if(!push({ AudioCommand::PlayLoop, sound, 0 }))
+      delete sound;
 
     return LOOP_CHANNEL;
   }
@@ -102,77 +117,106 @@ struct SdlAudioBackend : IAudioBackend
   void stopLoop(int channel) override
   {
     assert(channel == LOOP_CHANNEL);
-    SDL_LockAudioDevice(audioDevice);
-    m_channels[channel].fadeOut();
-    SDL_UnlockAudioDevice(audioDevice);
+    push({ AudioCommand::StopLoop, nullptr, 0 });
+  }
+
+  AudioStats getStats() override
+  {
+    return m_telemetry->read();
+  }
+
+  // Never waits for the audio thread. Returns false if the queue is full.
+  bool push(AudioCommand cmd)
+  {
+    if(m_commands.write({ &cmd, 1 }) == 1)
+      return true;
+
+    printf("[audio] command queue full\n");
+    return false;
+  }
+
+  // on the audio thread, before each mix
+  void executeCommands()
+  {
+    AudioCommand cmd;
+
+    while(m_commands.read({ &cmd, 1 }) == 1)
+    {
+      switch(cmd.type)
+      {
+      case AudioCommand::PlaySound:
+
+        if(!m_voices.play(cmd.sound, cmd.priority))
+          printf("[audio] too many sounds: dropped one\n");
+
+        break;
+      case AudioCommand::PlayLoop:
+
+        if(!m_musicChannel.isDead())
+          m_musicChannel.fadeOut();
+
+        m_nextMusic.reset(cmd.sound);
+        break;
+      case AudioCommand::StopLoop:
+        m_musicChannel.fadeOut();
+        break;
+      }
+    }
   }
 
   SDL_AudioDeviceID audioDevice;
 
-  // accessed by the audio thread
+  // The game thread only pushes commands here: everything below belongs
+  // to the audio thread, no locking.
+  RingBuffer<AudioCommand> m_commands { 256 };
+
   SDL_AudioSpec audiospec;
-  vector<AudioChannel> m_channels;
+  AudioChannel m_musicChannel;
+  VoiceManager m_voices { MAX_AUDIBLE_VOICES, MAX_VOICES };
   unique_ptr<Sound> m_music;
   unique_ptr<Sound> m_nextMusic;
-  vector<float> mixBuffer;
+  unique_ptr<AudioTelemetry> m_telemetry;
+  Uint64 m_lastCallback = 0;
 
   static void staticMixAudio(void* userData, Uint8* stream, int iNumBytes)
   {
+    PROFILE_SCOPE("Audio::mix");
     auto pThis = (SdlAudioBackend*)userData;
+
+    auto const start = SDL_GetPerformanceCounter();
     memset(stream, 0, iNumBytes);
     pThis->mixAudio((float*)stream, iNumBytes / sizeof(float));
+    auto const end = SDL_GetPerformanceCounter();
+
+    auto const toMs = 1000.0 / SDL_GetPerformanceFrequency();
+    auto const sinceLast = pThis->m_lastCallback ? (start - pThis->m_lastCallback) * toMs : -1.0;
+    pThis->m_telemetry->record((end - start) * toMs, sinceLast);
+    pThis->m_lastCallback = start;
   }
 
   void mixAudio(float* stream, int sampleCount)
   {
-    if(m_nextMusic && m_channels[LOOP_CHANNEL].isDead())
-    {
-      m_music = move(m_nextMusic);
-      m_channels[LOOP_CHANNEL].play(m_music.get(), 2, true);
-    }
-
-    int shift = 0;
-
-    // HACK: poor man's resampling
-    if(audiospec.freq > 22050)
-      shift = 1;
-
-    for(auto& val : mixBuffer)
-      val = 0;
-
-    Span<float> buff(
-      mixBuffer.data(), sampleCount >> shift
-      );
+    executeCommands();
 
-    while(buff.len > 0)
+    if(m_nextMusic && m_musicChannel.isDead())
     {
-      auto chunk = buff;
-      chunk.len = min(CHUNK_PERIOD, chunk.len);
-
-      for(auto& channel : m_channels)
-        if(!channel.isDead())
-          channel.mix(chunk);
-
-      buff += chunk.len;
+      m_music = move(m_nextMusic);
+      m_musicChannel.play(m_music.get(), 2, true);
     }
 
-    for(int i = 0; i < sampleCount; ++i)
-      stream[i] = mixBuffer[i >> shift];
-  }
+    // at the rate of the device: the channels convert their sounds to it
+    auto const output = Span<float>(stream, sampleCount);
 
-  AudioChannel* allocChannel()
-  {
-    for(int k = 1; k < MAX_CHANNELS; ++k)
-      if(m_channels[k].isDead())
-        return &m_channels[k];
+    if(!m_musicChannel.isDead())
+      m_musicChannel.mix(output);
 
-    return nullptr;
+    m_voices.mix(output);
   }
 };
 }
 
-IAudioBackend* createAudioBackend()
+IAudioBackend* createAudioBackend(AudioConfig config)
 {
-  return new SdlAudioBackend;
+  return new SdlAudioBackend(config);
 }
 
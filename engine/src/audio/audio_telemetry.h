@@ -0,0 +1,72 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Timings of the audio callbacks: written by the audio thread, read by
+// the game thread. Lock-free, the audio thread never waits.
+
+#pragma once
+
+#include "audio.h" // AudioStats
+
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+struct AudioTelemetry
+{
+  AudioTelemetry(int sampleRate, int bufferFrames) :
+    m_sampleRate(sampleRate),
+    m_bufferFrames(bufferFrames),
+    m_budgetMs(sampleRate > 0 ? bufferFrames * 1000.0f / sampleRate : 0)
+  {
+  }
+
+  // Audio thread, after each mix.
+  // 'sinceLastMs': since the previous callback started, negative for the first one.
+  void record(double mixMs, double sinceLastMs)
+  {
+    m_callbacks.fetch_add(1, memory_order_relaxed);
+
+    if(mixMs > m_budgetMs)
+      m_missedDeadlines.fetch_add(1, memory_order_relaxed);
+
+    if(sinceLastMs > m_budgetMs * 2)
+      m_lateCallbacks.fetch_add(1, memory_order_relaxed);
+
+    auto const us = uint32_t(mixMs * 1000);
+    auto prev = m_maxMixUs.load(memory_order_relaxed);
+
+    while(us > prev && !m_maxMixUs.compare_exchange_weak(prev, us, memory_order_relaxed))
+    {
+    }
+  }
+
+  // Any thread
+  AudioStats read()
+  {
+    AudioStats r;
+    r.sampleRate = m_sampleRate;
+    r.bufferFrames = m_bufferFrames;
+    r.budgetMs = m_budgetMs;
+    r.maxMixMs = m_maxMixUs.exchange(0, memory_order_relaxed) / 1000.0f;
+    r.callbacks = m_callbacks.load(memory_order_relaxed);
+    r.missedDeadlines = m_missedDeadlines.load(memory_order_relaxed);
+    r.lateCallbacks = m_lateCallbacks.load(memory_order_relaxed);
+    return r;
+  }
+
+private:
+  int const m_sampleRate;
+  int const m_bufferFrames;
+  float const m_budgetMs;
+
+  atomic<uint32_t> m_maxMixUs { 0 };
+  atomic<int> m_callbacks { 0 };
+  atomic<int> m_missedDeadlines { 0 };
+  atomic<int> m_lateCallbacks { 0 };
+};
+
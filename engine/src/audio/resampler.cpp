@@ -0,0 +1,270 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Sample rate conversion: windowed-sinc, polyphase.
+// Each output frame is a weighted sum of the TAPS input frames around it.
+// The weights depend on where it falls between two input frames: they're
+// precomputed for PHASES positions.
+
+#include "resampler.h"
+
+#include <algorithm> // min
+#include <cmath> // sin, cos
+#include <map>
+#include <mutex>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define RESAMPLER_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESAMPLER_NEON 1
+#endif
+
+namespace
+{
+auto const TAPS = 16;
+auto const PHASES = 256;
+auto const FILL_FRAMES = 256; // read from the source at once
+auto const HISTORY = TAPS / 2 - 1; // input frames before the output frame
+
+double sinc(double x)
+{
+  if(fabs(x) < 1e-9)
+    return 1;
+
+  return sin(M_PI * x) / (M_PI * x);
+}
+
+// 'u' in [-1;1]
+double blackman(double u)
+{
+  return 0.42 + 0.5 * cos(M_PI * u) + 0.08 * cos(2 * M_PI * u);
+}
+
+// the weights of an output frame, applied to the interleaved stereo frames around it
+void convolve(float const* input, float const* weights, float* output)
+{
+#if RESAMPLER_SSE
+  auto sum = _mm_setzero_ps();
+
+  for(int i = 0; i < TAPS * 2; i += 4)
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input + i), _mm_loadu_ps(weights + i)));
+
+  float lanes[4];
+  _mm_storeu_ps(lanes, sum); // left, right, left, right
+  output[0] = lanes[0] + lanes[2];
+  output[1] = lanes[1] + lanes[3];
+#elif RESAMPLER_NEON
+  auto sum = vdupq_n_f32(0);
+
+  for(int i = 0; i < TAPS * 2; i += 4)
+    sum = vmlaq_f32(sum, vld1q_f32(input + i), vld1q_f32(weights + i));
+
+  float lanes[4];
+  vst1q_f32(lanes, sum);
+  output[0] = lanes[0] + lanes[2];
+  output[1] = lanes[1] + lanes[3];
+#else
+  float left = 0;
+  float right = 0;
+
+  for(int i = 0; i < TAPS * 2; i += 2)
+  {
+    left += input[i] * weights[i];
+    right += input[i + 1] * weights[i + 1];
+  }
+
+  output[0] = left;
+  output[1] = right;
+#endif
+}
+}
+
+struct ResamplerKernel
+{
+  // [phase][tap][channel]: each weight twice, for interleaved stereo
+  vector<float> weights;
+};
+
+namespace
+{
+shared_ptr<ResamplerKernel const> createKernel(int inputRate, int outputRate)
+{
+  auto r = make_shared<ResamplerKernel>();
+  r->weights.resize(PHASES * TAPS * 2);
+
+  // downsampling: the cutoff goes down to the Nyquist frequency of the output
+  auto const cutoff = min(1.0, double(outputRate) / inputRate) * 0.95;
+
+  for(int phase = 0; phase < PHASES; ++phase)
+  {
+    auto const frac = double(phase) / PHASES;
+
+    double weights[TAPS];
+    double sum = 0;
+
+    for(int tap = 0; tap < TAPS; ++tap)
+    {
+      auto const x = tap - HISTORY - frac; // in input frames, from the output frame
+      weights[tap] = cutoff * sinc(cutoff * x) * blackman(x / (TAPS / 2));
+      sum += weights[tap];
+    }
+
+    // unity gain: a constant stays the same
+    for(int tap = 0; tap < TAPS; ++tap)
+    {
+      auto const w = float(weights[tap] / sum);
+      r->weights[(phase * TAPS + tap) * 2 + 0] = w;
+      r->weights[(phase * TAPS + tap) * 2 + 1] = w;
+    }
+  }
+
+  return r;
+}
+
+// Shared by the sources of the same rates
+shared_ptr<ResamplerKernel const> getKernel(int inputRate, int outputRate)
+{
+  static mutex m;
+  static map<pair<int, int>, shared_ptr<ResamplerKernel const>> kernels;
+
+  lock_guard<mutex> lock(m);
+  auto& kernel = kernels[{ inputRate, outputRate }];
+
+  if(!kernel)
+    kernel = createKernel(inputRate, outputRate);
+
+  return kernel;
+}
+}
+
+ResamplingSource::ResamplingSource(Sound const* sound, unique_ptr<IAudioSource> source, int outputRate)
+  : m_sound(sound), m_source(move(source)), m_outputRate(outputRate)
+{
+}
+
+ResamplingSource::~ResamplingSource() = default;
+
+// Returns false if the sound plays as is
+bool ResamplingSource::start()
+{
+  if(m_kernel)
+    return true;
+
+  // e.g a streamed sound, until its file is read
+  auto const rate = m_sound->getSampleRate();
+
+  if(rate <= 0 || rate == m_outputRate)
+    return false;
+
+  m_inputRate = rate;
+  m_kernel = getKernel(rate, m_outputRate);
+  m_step = (uint64_t(rate) << 32) / m_outputRate;
+
+  // silence before the first frame
+  m_input.assign(HISTORY * 2, 0.0f);
+  m_pos = uint64_t(HISTORY) << 32;
+
+  return true;
+}
+
+int ResamplingSource::read(Span<float> output)
+{
+  if(!start())
+    return m_source->read(output);
+
+  auto const frames = output.len / 2;
+  int produced = 0;
+
+  while(produced < frames)
+  {
+    auto const i = int64_t(m_pos >> 32);
+
+    if(m_ended && i >= m_end)
+      break;
+
+    if(i + TAPS / 2 >= int64_t(m_input.size() / 2))
+    {
+      fill();
+      continue;
+    }
+
+    auto const phase = int((m_pos & 0xffffffff) >> 24);
+    static_assert(PHASES == 256, "the phase is the top byte of the fraction");
+
+    convolve(&m_input[(i - HISTORY) * 2], &m_kernel->weights[phase * TAPS * 2], output.data + produced * 2);
+
+    m_pos += m_step;
+    ++produced;
+  }
+
+  compact();
+
+  return produced * 2;
+}
+
+// Same as 'read', without the convolutions
+int ResamplingSource::skip(int count)
+{
+  if(!start())
+    return m_source->skip(count);
+
+  auto const frames = count / 2;
+  int skipped = 0;
+
+  while(skipped < frames)
+  {
+    auto const i = int64_t(m_pos >> 32);
+
+    if(m_ended && i >= m_end)
+      break;
+
+    if(i + TAPS / 2 >= int64_t(m_input.size() / 2))
+    {
+      fill();
+      continue;
+    }
+
+    m_pos += m_step;
+    ++skipped;
+  }
+
+  compact();
+
+  return skipped * 2;
+}
+
+// forget the frames no output frame will use
+void ResamplingSource::compact()
+{
+  auto const unused = int64_t(m_pos >> 32) - HISTORY;
+
+  if(unused < FILL_FRAMES * 4)
+    return;
+
+  m_input.erase(m_input.begin(), m_input.begin() + unused * 2);
+  m_pos -= uint64_t(unused) << 32;
+  m_end -= unused;
+}
+
+void ResamplingSource::fill()
+{
+  float block[FILL_FRAMES * 2];
+  auto const n = m_source->read(block);
+
+  if(n == 0)
+  {
+    // silence after the last frame
+    m_ended = true;
+    m_end = m_input.size() / 2;
+    m_input.resize(m_input.size() + (TAPS / 2 + 1) * 2, 0.0f);
+    return;
+  }
+
+  m_input.insert(m_input.end(), block, block + n);
+}
+
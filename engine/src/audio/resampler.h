@@ -0,0 +1,51 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Sample rate conversion: windowed-sinc, polyphase.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "sound.h"
+
+using namespace std;
+
+struct ResamplerKernel;
+
+// Plays 'sound' at 'outputRate': reads its samples through 'source'
+// (interleaved stereo), at the rate of the sound.
+// A sound of unknown rate (zero) plays as is, so does one at 'outputRate'.
+struct ResamplingSource : IAudioSource
+{
+  ResamplingSource(Sound const* sound, unique_ptr<IAudioSource> source, int outputRate);
+  ~ResamplingSource();
+
+  int read(Span<float> output) override;
+  int skip(int count) override;
+
+private:
+  bool start();
+  void fill();
+  void compact();
+
+  Sound const* const m_sound;
+  unique_ptr<IAudioSource> const m_source;
+  int const m_outputRate;
+
+  int m_inputRate = 0;
+  shared_ptr<ResamplerKernel const> m_kernel;
+  uint64_t m_step = 0; // in input frames per output frame, 32.32 fixed point
+
+  // the input frames not used yet, interleaved
+  vector<float> m_input;
+  uint64_t m_pos = 0; // of the next output frame in 'm_input', 32.32 fixed point
+  bool m_ended = false;
+  int64_t m_end = 0; // frames in 'm_input', once ended
+};
+
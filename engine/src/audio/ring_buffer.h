@@ -0,0 +1,108 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Lock-free FIFO, for one producer thread and one consumer thread
+// (e.g the audio callback). Neither side ever waits for the other.
+
+#pragma once
+
+#include <algorithm> // min
+#include <atomic>
+#include <cstdint>
+#include <cstring> // memcpy
+#include <vector>
+
+#include "base/span.h"
+
+using namespace std;
+
+template<typename T>
+struct RingBuffer
+{
+  // 'capacity': rounded up to a power of two
+  explicit RingBuffer(int capacity)
+  {
+    int size = 1;
+
+    while(size < capacity)
+      size *= 2;
+
+    m_data.resize(size);
+    m_mask = size - 1;
+  }
+
+  int capacity() const { return m_mask + 1; }
+
+  // Consumer side: what's ready to be read
+  int readable() const
+  {
+    return int(m_head.load(memory_order_acquire) - m_tail.load(memory_order_relaxed));
+  }
+
+  // Producer side: what can be written without overwriting unread data
+  int writable() const
+  {
+    return capacity() - int(m_head.load(memory_order_relaxed) - m_tail.load(memory_order_acquire));
+  }
+
+  // Producer side. Returns the count written, less than 'data.len' if full.
+  int write(Span<const T> data)
+  {
+    auto const head = m_head.load(memory_order_relaxed);
+    auto const n = min(data.len, writable());
+
+    copyIn(data.data, n, head);
+    m_head.store(head + n, memory_order_release);
+    return n;
+  }
+
+  // Consumer side. Returns the count read, less than 'out.len' if empty.
+  int read(Span<T> out)
+  {
+    auto const tail = m_tail.load(memory_order_relaxed);
+    auto const n = min(out.len, readable());
+
+    copyOut(out.data, n, tail);
+    m_tail.store(tail + n, memory_order_release);
+    return n;
+  }
+
+private:
+  // in two parts, when the range wraps
+  void copyIn(T const* elements, int n, uint32_t pos)
+  {
+    auto const start = int(pos & m_mask);
+    auto const first = min(n, capacity() - start);
+
+    if(n == 0)
+      return;
+
+    memcpy(&m_data[start], elements, first * sizeof(T));
+    memcpy(&m_data[0], elements + first, (n - first) * sizeof(T));
+  }
+
+  void copyOut(T* elements, int n, uint32_t pos) const
+  {
+    auto const start = int(pos & m_mask);
+    auto const first = min(n, capacity() - start);
+
+    if(n == 0)
+      return;
+
+    memcpy(elements, &m_data[start], first * sizeof(T));
+    memcpy(elements + first, &m_data[0], (n - first) * sizeof(T));
+  }
+
+  vector<T> m_data;
+  int m_mask;
+
+  // Free-running: only their difference makes sense.
+  // On separate cache lines, each one written by one side.
+  atomic<uint32_t> m_head { 0 }; // written by the producer
+  char m_padding[64];
+  atomic<uint32_t> m_tail { 0 }; // written by the consumer
+};
+
@@ -8,12 +8,33 @@
 
 #include "base/span.h"
 #include <memory>
+#include <string>
 
 // A sound being played (holds the current sound position)
 struct IAudioSource
 {
   virtual ~IAudioSource() = default;
   virtual int read(Span<float> output) = 0;
+
+  // Advances by 'count' samples, without producing them (e.g an inaudible
+  // voice). Returns the count skipped: less than 'count' at the end.
+  virtual int skip(int count)
+  {
+    float block[256];
+    int skipped = 0;
+
+    while(skipped < count)
+    {
+      auto const n = read({ block, count - skipped < 256 ? count - skipped : 256 });
+
+      if(n == 0)
+        break;
+
+      skipped += n;
+    }
+
+    return skipped;
+  }
 };
 
 // A chunk of audio
@@ -21,7 +42,15 @@ struct Sound
 {
   virtual ~Sound() = default;
   virtual std::unique_ptr<IAudioSource> createSource() = 0;
+
+  // In Hz. Zero if unknown (yet): plays at the rate of the output.
+  virtual int getSampleRate() const { return 0; }
 };
 
 std::unique_ptr<Sound> loadSoundFile(std::string filename);
 
+// Reads and decodes 'filename' ahead, looping, on a thread of its own.
+// Only one source at a time: it never ends, and plays silence if the
+// decoding is late.
+std::unique_ptr<Sound> streamSoundFile(std::string filename);
+
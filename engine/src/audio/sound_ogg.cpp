@@ -9,18 +9,21 @@
 
 #include "sound.h"
 
-#include "misc/file.h" // read
+#include "base/memory.h"
+#include "misc/file.h" // map
 
 #include "stb_vorbis.c"
+#include <algorithm> // min
 #include <cassert>
 #include <stdexcept>
 #include <string.h> // memcpy
+#include <vector>
 
 using namespace std;
 
 struct OggSoundPlayer : IAudioSource
 {
-  OggSoundPlayer(Span<uint8_t> data) : m_data(data)
+  OggSoundPlayer(Span<const uint8_t> data) : m_data(data)
   {
     m_decoder = stb_vorbis_open_memory(m_data.data, m_data.len, nullptr, nullptr);
     assert(m_decoder);
@@ -37,30 +40,120 @@ struct OggSoundPlayer : IAudioSource
   }
 
   stb_vorbis* m_decoder;
-  const Span<uint8_t> m_data;
+  const Span<const uint8_t> m_data;
+};
+
+// Decoded once, played from memory
+struct PcmSoundPlayer : IAudioSource
+{
+  PcmSoundPlayer(Span<const float> samples) : m_samples(samples)
+  {
+  }
+
+  int read(Span<float> output)
+  {
+    auto const n = min(output.len, m_samples.len - m_pos);
+    memcpy(output.data, m_samples.data + m_pos, n * sizeof(float));
+    m_pos += n;
+    return n;
+  }
+
+  int skip(int count)
+  {
+    auto const n = min(count, m_samples.len - m_pos);
+    m_pos += n;
+    return n;
+  }
+
+  const Span<const float> m_samples;
+  int m_pos = 0;
 };
 
 struct OggSound : Sound
 {
+  // Shorter sounds (e.g the effects) are decoded at load time: playing
+  // them is a copy. The longer ones (e.g the music) are decoded while
+  // they play.
+  // The length isn't in the header: the larger files aren't even tried.
+  static auto constexpr MAX_PCM_SECONDS = 6;
+  static auto constexpr MAX_PCM_FILE_SIZE = 128 * 1024;
+
   OggSound(string filename)
   {
     if(!File::exists(filename))
       throw runtime_error("OggSound: file doesn't exist: '" + filename + "'");
 
-    m_data = File::read(filename);
+    m_file = File::map(filename);
+
+    if(auto decoder = stb_vorbis_open_memory(m_file->data.data, m_file->data.len, nullptr, nullptr))
+    {
+      m_sampleRate = stb_vorbis_get_info(decoder).sample_rate;
+      stb_vorbis_close(decoder);
+    }
+
+    if(m_file->data.len <= MAX_PCM_FILE_SIZE)
+      tryDecode();
+
+    m_memory.set(int64_t(m_file ? m_file->data.len : 0) + int64_t(m_pcm.capacity() * sizeof(float)));
+  }
+
+  // Decodes the whole file to 'm_pcm', unless it's longer than MAX_PCM_SECONDS
+  void tryDecode()
+  {
+    auto decoder = stb_vorbis_open_memory(m_file->data.data, m_file->data.len, nullptr, nullptr);
+
+    if(!decoder)
+      return;
+
+    // stereo, interleaved. One more frame: tells if the sound goes on.
+    m_pcm.resize((MAX_PCM_SECONDS * m_sampleRate + 1) * 2);
+
+    int len = 0;
+
+    while(len < (int)m_pcm.size())
+    {
+      auto const n = stb_vorbis_get_samples_float_interleaved(decoder, 2, m_pcm.data() + len, m_pcm.size() - len) * 2;
+
+      if(n <= 0)
+        break;
+
+      len += n;
+    }
+
+    stb_vorbis_close(decoder);
+
+    if(len < (int)m_pcm.size())
+    {
+      m_pcm.resize(len);
+      m_pcm.shrink_to_fit();
+      m_file.reset();
+    }
+    else
+    {
+      m_pcm = {};
+    }
   }
 
   unique_ptr<IAudioSource> createSource()
   {
-    auto data = Span<uint8_t> { (uint8_t*)m_data.data(), (int)m_data.size() };
-    return make_unique<OggSoundPlayer>(data);
+    if(!m_file)
+      return make_unique<PcmSoundPlayer>(m_pcm);
+
+    return make_unique<OggSoundPlayer>(m_file->data);
+  }
+
+  int getSampleRate() const
+  {
+    return m_sampleRate;
   }
 
-  string m_data;
+  int m_sampleRate = 0;
+  unique_ptr<MappedFile> m_file; // null once decoded to 'm_pcm'
+  vector<float> m_pcm;
+  TrackedMemory m_memory { MemoryTag::Sounds };
 };
 
 unique_ptr<Sound> loadSoundFile(string filename)
 {
   return make_unique<OggSound>(filename);
 }
-
@@ -0,0 +1,167 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Sounds decoded ahead on a thread of their own (e.g the music): the audio
+// callback only copies what's already decoded.
+
+#include "sound.h"
+
+#include "ring_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio> // printf
+#include <cstring> // memset
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "base/memory.h"
+#include "base/profiler.h"
+
+using namespace std;
+
+namespace
+{
+// of interleaved stereo samples: 1.5s at 22050 Hz
+auto const BUFFER_SAMPLES = 65536;
+auto const DECODE_BLOCK = 2048;
+
+// Shared by the decoding thread, the sound, and its sources: a source
+// can outlive the sound.
+struct StreamState
+{
+  RingBuffer<float> ring { BUFFER_SAMPLES };
+  atomic<bool> stop { false };
+  mutex stopLock;
+  condition_variable stopped; // wakes the decoder up early
+  atomic<int> sampleRate { 0 }; // known once the file is read
+  TrackedMemory memory { MemoryTag::Sounds, int64_t(ring.capacity() * sizeof(float)) };
+};
+
+void decodeAhead(shared_ptr<StreamState> state, string filename)
+{
+  setProfilerThreadName("sound stream");
+
+  unique_ptr<Sound> sound;
+
+  try
+  {
+    // the file, too, is read here: not on the game thread
+    sound = loadSoundFile(filename);
+  }
+  catch(exception const& e)
+  {
+    printf("[audio] can't stream '%s': %s\n", filename.c_str(), e.what());
+    return;
+  }
+
+  state->sampleRate = sound->getSampleRate();
+
+  unique_ptr<IAudioSource> source;
+  bool fresh = false;
+  float block[DECODE_BLOCK];
+
+  while(!state->stop)
+  {
+    if(state->ring.writable() < DECODE_BLOCK)
+    {
+      unique_lock<mutex> lock(state->stopLock);
+      state->stopped.wait_for(lock, chrono::milliseconds(10), [&] () { return state->stop.load(); });
+      continue;
+    }
+
+    if(!source)
+    {
+      source = sound->createSource();
+      fresh = true;
+    }
+
+    auto const n = source->read(block);
+
+    if(n == 0)
+    {
+      // an empty sound: nothing to loop
+      if(fresh)
+        return;
+
+      source.reset();
+      continue;
+    }
+
+    fresh = false;
+    state->ring.write({ block, n });
+  }
+}
+
+struct StreamedSource : IAudioSource
+{
+  StreamedSource(shared_ptr<StreamState> state) : m_state(move(state))
+  {
+  }
+
+  int read(Span<float> output) override
+  {
+    auto const n = m_state->ring.read(output);
+
+    // the decoder is late: silence, rather than the end of the sound
+    memset(output.data + n, 0, (output.len - n) * sizeof(float));
+
+    return output.len;
+  }
+
+  shared_ptr<StreamState> const m_state;
+};
+
+struct StreamedSound : Sound
+{
+  StreamedSound(string filename) : m_state(make_shared<StreamState>())
+  {
+    m_thread = thread(decodeAhead, m_state, filename);
+  }
+
+  // Can run on the audio thread (e.g the music changes): the decoder stops
+  // after the block it's decoding. Only a file still being read can make
+  // this wait longer.
+  ~StreamedSound()
+  {
+    {
+      lock_guard<mutex> lock(m_state->stopLock);
+      m_state->stop = true;
+    }
+
+    m_state->stopped.notify_one();
+    m_thread.join();
+  }
+
+  unique_ptr<IAudioSource> createSource() override
+  {
+    return make_unique<StreamedSource>(m_state);
+  }
+
+  int getSampleRate() const override
+  {
+    return m_state->sampleRate;
+  }
+
+  shared_ptr<StreamState> const m_state;
+  thread m_thread;
+};
+}
+
+unique_ptr<Sound> streamSoundFile(string filename)
+{
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+  // no threads in the browser: decoded by the audio callback
+  return loadSoundFile(filename);
+#else
+  return make_unique<StreamedSound>(filename);
+#endif
+}
+
@@ -0,0 +1,119 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Voice management: priorities, stealing, virtual voices
+
+#include "voice_manager.h"
+
+#include <algorithm> // sort
+
+VoiceManager::VoiceManager(int audibleCount, int voiceCount) :
+  m_audibleCount(audibleCount),
+  m_voices(voiceCount)
+{
+  m_ranking.reserve(voiceCount);
+}
+
+void VoiceManager::setOutputRate(int rate)
+{
+  for(auto& voice : m_voices)
+    voice.channel.setOutputRate(rate);
+}
+
+bool VoiceManager::play(Sound* sound, int priority)
+{
+  Voice* chosen = nullptr;
+
+  for(auto& voice : m_voices)
+  {
+    if(voice.channel.isDead())
+    {
+      chosen = &voice;
+      break;
+    }
+
+    // steal the least important voice: lower priority, quieter, older
+    if(!chosen || isBefore(*chosen, voice))
+      chosen = &voice;
+  }
+
+  if(!chosen->channel.isDead() && chosen->priority > priority)
+    return false;
+
+  chosen->channel.play(sound);
+  chosen->sound = sound;
+  chosen->priority = priority;
+  chosen->startTime = m_time++;
+  chosen->audible = false;
+  return true;
+}
+
+void VoiceManager::mix(Span<float> output)
+{
+  m_ranking.clear();
+
+  for(auto& voice : m_voices)
+  {
+    voice.audible = false;
+
+    if(!voice.channel.isDead())
+      m_ranking.push_back(&voice);
+  }
+
+  auto const audible = min(m_audibleCount, (int)m_ranking.size());
+  partial_sort(m_ranking.begin(), m_ranking.begin() + audible, m_ranking.end(),
+               [] (Voice const* a, Voice const* b) { return isBefore(*a, *b); });
+
+  for(int i = 0; i < (int)m_ranking.size(); ++i)
+  {
+    auto& voice = *m_ranking[i];
+
+    if(i < audible)
+    {
+      voice.audible = true;
+      voice.channel.mix(output);
+    }
+    else
+    {
+      voice.channel.skip(output.len);
+    }
+
+    if(voice.channel.isDead())
+      voice.sound = nullptr;
+  }
+}
+
+int VoiceManager::playingCount() const
+{
+  int r = 0;
+
+  for(auto& voice : m_voices)
+    if(!voice.channel.isDead())
+      ++r;
+
+  return r;
+}
+
+bool VoiceManager::isAudible(Sound const* sound) const
+{
+  for(auto& voice : m_voices)
+    if(voice.sound == sound && voice.audible)
+      return true;
+
+  return false;
+}
+
+bool VoiceManager::isBefore(Voice const& a, Voice const& b)
+{
+  if(a.priority != b.priority)
+    return a.priority > b.priority;
+
+  if(a.channel.getVolume() != b.channel.getVolume())
+    return a.channel.getVolume() > b.channel.getVolume();
+
+  return a.startTime > b.startTime;
+}
+
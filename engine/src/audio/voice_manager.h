@@ -0,0 +1,58 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// The sound effects being played: a fixed count of them is mixed,
+// the others go on silently (virtual voices) until there's room again.
+
+#pragma once
+
+#include "audio_channel.h"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+struct VoiceManager
+{
+  // 'audibleCount': the most voices mixed at once (the CPU budget).
+  // 'voiceCount': the most voices playing at once, audible or not.
+  VoiceManager(int audibleCount, int voiceCount);
+
+  void setOutputRate(int rate);
+
+  // The higher the priority, the less likely to be inaudible.
+  // When all the voices are busy, replaces the least important one,
+  // unless it's more important than 'sound'.
+  // Returns false if 'sound' was dropped.
+  bool play(Sound* sound, int priority);
+
+  // Mixes the most important voices to 'output', the others only advance
+  void mix(Span<float> output);
+
+  // for the tests and the stats
+  int playingCount() const;
+  int audibleCount() const { return m_audibleCount; }
+  bool isAudible(Sound const* sound) const;
+
+private:
+  struct Voice
+  {
+    AudioChannel channel;
+    Sound* sound = nullptr;
+    int priority = 0;
+    uint64_t startTime = 0; // order of the 'play' calls
+    bool audible = false;
+  };
+
+  // Among the voices to mix first: more important, louder, then newer
+  static bool isBefore(Voice const& a, Voice const& b);
+
+  int const m_audibleCount;
+  vector<Voice> m_voices;
+  vector<Voice*> m_ranking; // scratch, no allocation while mixing
+  uint64_t m_time = 0;
+};
+
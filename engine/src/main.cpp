@@ -41,7 +41,7 @@ void runMainLoop(IApp* app)
 void runMainLoop(IApp* app)
 {
   while(app->tick())
-    SDL_Delay(1);
+    app->waitForNextFrame();
 }
 
 #endif
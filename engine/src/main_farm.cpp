@@ -0,0 +1,176 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Entry point for the simulation farm.
+// Runs many independent game sessions in parallel, without display nor audio
+// (e.g automated level validation).
+//
+// Usage: farm.exe [--worlds N] [--threads N] [--ticks N] [--replay FILE] [game args]
+//
+// Each world is a full game, created with 'createGame', seeing its own
+// headless view. Worlds share nothing mutable: they can be ticked from any
+// thread. A world is always ticked from a single thread at a time.
+
+#include <algorithm> // max
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // atoi
+#include <cstring> // strcmp
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/scene.h"
+#include "base/thread_pool.h"
+#include "base/view.h"
+#include "misc/control_stream.h"
+#include "misc/file.h"
+
+using namespace std;
+
+Scene* createGame(View* view, vector<string> argv);
+
+namespace
+{
+// Outside world of a simulated session: swallows everything.
+struct HeadlessView : View
+{
+  void setTitle(char const*) override {}
+  void preload(Resource) override {}
+  void textBox(char const*) override {}
+  void playMusic(int) override {}
+  void stopMusic() override {}
+  void playSound(int) override {}
+  void setCameraPos(Vector3f, Quaternion, Vector3f) override {}
+  void setAmbientLight(float) override {}
+  void sendActor(Actor const&) override {}
+  int addProxy(Actor const&) override { return 0; }
+  void updateProxy(int, Actor const&) override {}
+  void removeProxy(int) override {}
+  void sendDebugText(char const*) override {}
+};
+
+struct World
+{
+  HeadlessView view;
+  unique_ptr<Scene> scene;
+  int ticks = 0;
+  double seconds = 0;
+  string error;
+};
+
+void runWorld(World& world, vector<string> const& gameArgs, vector<Control> const& controls, int tickCount)
+{
+  auto const start = chrono::steady_clock::now();
+
+  try
+  {
+    world.scene.reset(createGame(&world.view, gameArgs));
+
+    for(int i = 0; i < tickCount; ++i)
+    {
+      auto const control = controls.empty() ? Control {} : controls[i % controls.size()];
+      auto next = world.scene->tick(control);
+
+      if(next != world.scene.get())
+        world.scene.reset(next);
+
+      world.ticks++;
+    }
+  }
+  catch(exception const& e)
+  {
+    world.error = e.what();
+  }
+
+  world.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    int worldCount = 8;
+    int threadCount = max(1, (int)thread::hardware_concurrency());
+    int tickCount = 1000;
+    vector<Control> controls;
+    vector<string> gameArgs;
+
+    for(int i = 1; i < argc; ++i)
+    {
+      auto arg = argv[i];
+
+      auto value = [&] ()
+        {
+          if(i + 1 >= argc)
+            throw runtime_error(string("Missing value for '") + arg + "'");
+
+          return argv[++i];
+        };
+
+      if(!strcmp(arg, "--worlds"))
+        worldCount = atoi(value());
+      else if(!strcmp(arg, "--threads"))
+        threadCount = max(1, atoi(value()));
+      else if(!strcmp(arg, "--ticks"))
+        tickCount = atoi(value());
+      else if(!strcmp(arg, "--replay"))
+      {
+        auto const data = File::read(value());
+        controls = readControlStream({ (uint8_t const*)data.data(), (int)data.size() });
+      }
+      else
+        gameArgs.push_back(arg);
+    }
+
+    // tick for tick: the level loads mustn't depend on the speed of the machine
+    if(!controls.empty())
+      gameArgs.push_back("--sync-load");
+
+    vector<World> worlds(worldCount);
+
+    // the calling thread takes part in the work
+    ThreadPool pool(threadCount - 1);
+
+    auto const start = chrono::steady_clock::now();
+
+    pool.parallelFor(worldCount, [&] (int i) { runWorld(worlds[i], gameArgs, controls, tickCount); });
+
+    auto const seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int failures = 0;
+    int totalTicks = 0;
+
+    for(int i = 0; i < worldCount; ++i)
+    {
+      auto& world = worlds[i];
+      totalTicks += world.ticks;
+
+      if(world.error.empty())
+      {
+        printf("[world %d] %d ticks, %.1f ticks/s\n", i, world.ticks, world.ticks / max(world.seconds, 1e-9));
+      }
+      else
+      {
+        printf("[world %d] FAILED after %d ticks: %s\n", i, world.ticks, world.error.c_str());
+        ++failures;
+      }
+    }
+
+    printf("%d worlds, %d threads: %.1f ticks/s\n", worldCount, threadCount, totalTicks / max(seconds, 1e-9));
+
+    return failures ? 1 : 0;
+  }
+  catch(exception const& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,174 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Entry point for the rendering benchmark.
+// Plays a display capture (see '--record-display') on the real display,
+// without the game, and reports the frame time percentiles, and the GPU
+// time of each render pass.
+//
+// Usage: gpu_replay.exe <capture> [--loops N] [--pack FILE]
+//
+// The capture is played once to warm up (models, shaders, caches), then
+// 'N' times, measured.
+
+#include <algorithm> // sort, min, max
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // atoi
+#include <cstring> // strcmp
+#include <exception>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SDL.h"
+
+#include "misc/file.h"
+#include "render/display.h"
+#include "render/display_capture.h"
+
+using namespace std;
+
+Display* createDisplay(Size2i resolution);
+
+namespace
+{
+double percentile(vector<double> const& sorted, double p)
+{
+  if(sorted.empty())
+    return 0;
+
+  auto const i = min(int(sorted.size() * p), (int)sorted.size() - 1);
+  return sorted[i];
+}
+
+struct PassTotal
+{
+  double ms = 0;
+  int frames = 0;
+};
+
+// Plays the whole capture, once. Returns the count of frames.
+int playCapture(DisplayCaptureReader& capture, Display* display, vector<double>* frameTimes, map<string, PassTotal>* passes)
+{
+  int frames = 0;
+
+  capture.rewind();
+
+  while(1)
+  {
+    // keeps the window responsive
+    SDL_Event event;
+
+    while(SDL_PollEvent(&event))
+    {
+    }
+
+    auto const start = chrono::steady_clock::now();
+
+    if(!capture.playFrame(display))
+      break;
+
+    auto const elapsed = chrono::steady_clock::now() - start;
+
+    ++frames;
+
+    if(frameTimes)
+      frameTimes->push_back(chrono::duration<double, milli>(elapsed).count());
+
+    if(passes)
+    {
+      for(auto& timing : display->getGpuTimings())
+      {
+        auto& total = (*passes)[timing.name];
+        total.ms += timing.ms;
+        total.frames++;
+      }
+    }
+  }
+
+  return frames;
+}
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    string capturePath;
+    string packPath = "res.pack"; // mounted if it exists
+    int loopCount = 3;
+
+    for(int i = 1; i < argc; ++i)
+    {
+      auto arg = argv[i];
+
+      auto value = [&] ()
+        {
+          if(i + 1 >= argc)
+            throw runtime_error(string("Missing value for '") + arg + "'");
+
+          return argv[++i];
+        };
+
+      if(!strcmp(arg, "--loops"))
+        loopCount = max(1, atoi(value()));
+      else if(!strcmp(arg, "--pack"))
+        packPath = value();
+      else if(capturePath.empty())
+        capturePath = arg;
+      else
+        throw runtime_error(string("Unexpected argument '") + arg + "'");
+    }
+
+    if(capturePath.empty())
+      throw runtime_error("Usage: gpu_replay.exe <capture> [--loops N] [--pack FILE]");
+
+    if(!packPath.empty() && File::exists(packPath))
+      File::mount(packPath);
+
+    auto const data = File::read(capturePath);
+    DisplayCaptureReader capture(vector<uint8_t>(data.begin(), data.end()));
+
+    SDL_Init(0);
+
+    {
+      unique_ptr<Display> display(createDisplay(capture.resolution));
+      display->setCaption("GPU replay");
+
+      auto const frameCount = playCapture(capture, display.get(), nullptr, nullptr);
+
+      if(frameCount == 0)
+        throw runtime_error("No frames in '" + capturePath + "'");
+
+      vector<double> frameTimes;
+      map<string, PassTotal> passes;
+
+      for(int i = 0; i < loopCount; ++i)
+        playCapture(capture, display.get(), &frameTimes, &passes);
+
+      sort(frameTimes.begin(), frameTimes.end());
+
+      printf("%d frames x %d loops, %dx%d%s: p50 %.2f ms, p90 %.2f ms, p99 %.2f ms\n",
+             frameCount, loopCount, capture.resolution.width, capture.resolution.height,
+             display->isVsynced() ? " (vsynced)" : "",
+             percentile(frameTimes, 0.50), percentile(frameTimes, 0.90), percentile(frameTimes, 0.99));
+
+      for(auto& pass : passes)
+        printf("  GPU %s: %.2f ms\n", pass.first.c_str(), pass.second.ms / max(1, pass.second.frames));
+    }
+
+    SDL_Quit();
+    return 0;
+  }
+  catch(exception const& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    return 1;
+  }
+}
@@ -1,14 +1,34 @@
+#include <algorithm> // sort, copy, rotate
+#include <array>
+#include <cinttypes> // PRIx64
+#include <cmath> // cbrt, ceil
+#include <functional>
 #include <map>
+#include <set>
 #include <stdio.h>
+#include <unordered_map>
 
 #include "base/mesh.h"
 #include "base/span.h"
+#include "base/thread_pool.h"
 #include "base/util.h" // setExtension
 #include "misc/file.h" // exists
+#include "render/atlas.h"
+#include "render/lightmap.h"
+#include "render/picture.h"
 #include "render/rendermesh.h"
+#include "render/texture.h"
+
+// Implemented by the game: writes the cooked collision data of a room.
+// Returns whether nothing opaque stands between two points of the room.
+function<bool(Vector3f a, Vector3f b)> cookRoom(vector<Mesh> const& meshes, string path);
 
 namespace
 {
+// Part of the hash of the inputs: bump it when the same inputs cook to
+// something else, so everything gets cooked again.
+auto const COOKER_VERSION = 2;
+
 bool startsWith(string s, string prefix)
 {
   return s.substr(0, prefix.size()) == prefix;
@@ -29,7 +49,9 @@ RenderMesh convertToRenderMesh(vector<Mesh> const& meshes, vector<string>& textu
       r.nz = src.nz;
       r.diffuse_u = src.u;
       r.diffuse_v = src.v;
-      return r;
+      r.lightmap_u = 0;
+      r.lightmap_v = 0;
+      return packVertex(r);
     };
 
   std::map<std::string, SingleRenderMesh> singlesByMaterial;
@@ -65,26 +87,697 @@ RenderMesh convertToRenderMesh(vector<Mesh> const& meshes, vector<string>& textu
   return r;
 }
 
+// Atlas of the props, see 'cookAtlas'
+auto const ATLAS_MAX_SIZE = 1024; // of a page: the half float UVs still address each texel
+auto const ATLAS_MAX_TILE_SIZE = 256;
+
+// Lightmap atlas of a room
+auto const LIGHTMAP_TEXELS_PER_UNIT = 4.0f;
+auto const LIGHTMAP_MAX_SIZE = 512;
+auto const LIGHTMAP_AO_RANGE = 3.0f;
+
+// Potentially visible set: the grid is kept under this many cells
+auto const MAX_CELLS = 1024;
+auto const MIN_CELL_SIZE = 4.0f;
+
+Vector3f getPos(SingleRenderMesh::PackedVertex const& v)
+{
+  return Vector3f(v.x, v.y, v.z);
+}
+
+// Sorts the triangles of each single mesh by cell, setting their ranges.
+// Returns the sample points of each non-empty cell: its triangle centers,
+// moved away from the surface.
+map<int, vector<Vector3f>> splitIntoCells(RenderMesh& mesh)
+{
+  static auto const MAX_SAMPLES = 8;
+
+  auto& vis = mesh.visibility;
+  map<int, vector<Vector3f>> samples;
+
+  for(auto& single : mesh.singleMeshes)
+  {
+    struct Triangle
+    {
+      int cell;
+      int first;
+    };
+
+    vector<Triangle> triangles;
+
+    for(int i = 0; i + 2 < (int)single.vertices.size(); i += 3)
+    {
+      auto& v = single.vertices[i];
+      auto const center = (getPos(v) + getPos(single.vertices[i + 1]) + getPos(single.vertices[i + 2])) * (1.0f / 3.0f);
+      auto const cell = vis.getCell(center);
+
+      auto& cellSamples = samples[cell];
+
+      if((int)cellSamples.size() < MAX_SAMPLES)
+      {
+        auto const n = unpackVertex(v);
+        cellSamples.push_back(center + Vector3f(n.nx, n.ny, n.nz) * 0.05);
+      }
+
+      triangles.push_back({ cell, i });
+    }
+
+    stable_sort(triangles.begin(), triangles.end(), [] (Triangle a, Triangle b) { return a.cell < b.cell; });
+
+    vector<SingleRenderMesh::PackedVertex> vertices;
+
+    for(auto& t : triangles)
+    {
+      if(single.ranges.empty() || single.ranges.back().cell != t.cell)
+        single.ranges.push_back({ t.cell, (int)vertices.size(), 0 });
+
+      for(int k = 0; k < 3; ++k)
+        vertices.push_back(single.vertices[t.first + k]);
+
+      single.ranges.back().count += 3;
+    }
+
+    single.vertices = move(vertices);
+  }
+
+  return samples;
+}
+
+// Precomputes which cells can see which others, by casting rays between
+// sample points: some points in the volume of the viewer cell, the
+// triangle centers of the seen cell. Neighbor cells always see each other.
+void computeVisibility(RenderMesh& mesh, function<bool(Vector3f, Vector3f)> const& lineOfSight)
+{
+  auto& vis = mesh.visibility;
+
+  Vector3f boundsMin(1e9, 1e9, 1e9);
+  Vector3f boundsMax(-1e9, -1e9, -1e9);
+
+  for(auto& single : mesh.singleMeshes)
+  {
+    for(auto& v : single.vertices)
+    {
+      boundsMin = Vector3f(min(boundsMin.x, v.x), min(boundsMin.y, v.y), min(boundsMin.z, v.z));
+      boundsMax = Vector3f(max(boundsMax.x, v.x), max(boundsMax.y, v.y), max(boundsMax.z, v.z));
+    }
+  }
+
+  if(boundsMin.x > boundsMax.x)
+    return;
+
+  // a margin, so the grid covers the whole mesh
+  boundsMin = boundsMin - Vector3f(1, 1, 1);
+  boundsMax = boundsMax + Vector3f(1, 1, 1);
+
+  auto const extent = boundsMax - boundsMin;
+  vis.origin = boundsMin;
+  vis.cellSize = max(MIN_CELL_SIZE, (float)cbrt(extent.x * extent.y * extent.z / MAX_CELLS));
+
+  while(true)
+  {
+    vis.dims[0] = (int)ceil(extent.x / vis.cellSize);
+    vis.dims[1] = (int)ceil(extent.y / vis.cellSize);
+    vis.dims[2] = (int)ceil(extent.z / vis.cellSize);
+
+    if(vis.dims[0] * vis.dims[1] * vis.dims[2] <= MAX_CELLS)
+      break;
+
+    vis.cellSize *= 1.1f;
+  }
+
+  auto const samples = splitIntoCells(mesh);
+
+  auto getCoords = [&] (int cell, int coords[3])
+    {
+      coords[0] = cell % vis.dims[0];
+      coords[1] = (cell / vis.dims[0]) % vis.dims[1];
+      coords[2] = cell / (vis.dims[0] * vis.dims[1]);
+    };
+
+  auto const cellCount = vis.dims[0] * vis.dims[1] * vis.dims[2];
+  vis.visibleCells.resize(cellCount);
+
+  for(int viewer = 0; viewer < cellCount; ++viewer)
+  {
+    int coords[3];
+    getCoords(viewer, coords);
+
+    auto const corner = vis.origin + Vector3f(coords[0], coords[1], coords[2]) * vis.cellSize;
+
+    vector<Vector3f> eyes;
+
+    for(auto rel : { Vector3f(0.5, 0.5, 0.5),
+                     Vector3f(0.25, 0.25, 0.25), Vector3f(0.75, 0.25, 0.25), Vector3f(0.25, 0.75, 0.25), Vector3f(0.75, 0.75, 0.25),
+                     Vector3f(0.25, 0.25, 0.75), Vector3f(0.75, 0.25, 0.75), Vector3f(0.25, 0.75, 0.75), Vector3f(0.75, 0.75, 0.75) })
+      eyes.push_back(corner + rel * vis.cellSize);
+
+    auto& visible = vis.visibleCells[viewer];
+
+    for(auto& seen : samples)
+    {
+      int seenCoords[3];
+      getCoords(seen.first, seenCoords);
+
+      auto isNeighbor = true;
+
+      for(int i = 0; i < 3; ++i)
+        isNeighbor &= abs(seenCoords[i] - coords[i]) <= 1;
+
+      auto isVisible = [&] ()
+        {
+          for(auto& eye : eyes)
+            for(auto& target : seen.second)
+              if(lineOfSight(eye, target))
+                return true;
+
+          return false;
+        };
+
+      if(isNeighbor || isVisible())
+        visible.push_back(seen.first);
+    }
+  }
+}
+
+// Merges the identical vertices of a triangle soup, creating its indices.
+// The triangles keep their order, so do the ranges.
+void weldVertices(SingleRenderMesh& single)
+{
+  unordered_map<string, uint32_t> indexOfVertex;
+  vector<SingleRenderMesh::PackedVertex> vertices;
+
+  single.indices.clear();
+
+  for(auto& v : single.vertices)
+  {
+    auto const key = string((char const*)&v, sizeof v);
+    auto i = indexOfVertex.find(key);
+
+    if(i == indexOfVertex.end())
+    {
+      i = indexOfVertex.insert({ key, (uint32_t)vertices.size() }).first;
+      vertices.push_back(v);
+    }
+
+    single.indices.push_back(i->second);
+  }
+
+  single.vertices = move(vertices);
+}
+
+// Post-transform vertex cache optimization of the indices [first; first + count[.
+// 'Tipsify' (Sander, Nehab, Barczak 2007): fans around a vertex, going
+// next to the vertex of the fan likely to still be in the cache.
+void optimizeVertexCache(SingleRenderMesh& single, int first, int count)
+{
+  static auto const CACHE_SIZE = 16;
+
+  auto const triangleCount = count / 3;
+  auto const vertexCount = (int)single.vertices.size();
+  auto tri = [&] (int t, int k) { return (int)single.indices[first + t * 3 + k]; };
+
+  // triangles of each vertex
+  vector<int> liveCount(vertexCount);
+
+  for(int t = 0; t < triangleCount; ++t)
+    for(int k = 0; k < 3; ++k)
+      liveCount[tri(t, k)]++;
+
+  vector<int> adjacencyStart(vertexCount + 1);
+
+  for(int v = 0; v < vertexCount; ++v)
+    adjacencyStart[v + 1] = adjacencyStart[v] + liveCount[v];
+
+  vector<int> adjacency(adjacencyStart.back());
+
+  {
+    auto fill = adjacencyStart;
+
+    for(int t = 0; t < triangleCount; ++t)
+      for(int k = 0; k < 3; ++k)
+        adjacency[fill[tri(t, k)]++] = t;
+  }
+
+  vector<int> cacheTime(vertexCount);
+  vector<bool> emitted(triangleCount);
+  vector<int> deadEnds;
+  vector<uint32_t> result;
+  int time = CACHE_SIZE + 1;
+  int cursor = 0; // next triangle to try, when stuck
+
+  auto nextVertex = [&] (vector<int> const& candidates)
+    {
+      int best = -1;
+      int bestPriority = -1;
+
+      for(auto v : candidates)
+      {
+        if(liveCount[v] <= 0)
+          continue;
+
+        // 'v' is still in the cache once its fan is emitted: prefer the oldest
+        auto priority = 0;
+
+        if(time - cacheTime[v] + 2 * liveCount[v] <= CACHE_SIZE)
+          priority = time - cacheTime[v];
+
+        if(priority > bestPriority)
+        {
+          bestPriority = priority;
+          best = v;
+        }
+      }
+
+      if(best >= 0)
+        return best;
+
+      while(!deadEnds.empty())
+      {
+        auto const v = deadEnds.back();
+        deadEnds.pop_back();
+
+        if(liveCount[v] > 0)
+          return v;
+      }
+
+      while(cursor < triangleCount && emitted[cursor])
+        ++cursor;
+
+      return cursor < triangleCount ? tri(cursor, 0) : -1;
+    };
+
+  auto fanVertex = triangleCount > 0 ? tri(0, 0) : -1;
+
+  while(fanVertex >= 0)
+  {
+    vector<int> candidates;
+
+    for(int a = adjacencyStart[fanVertex]; a < adjacencyStart[fanVertex + 1]; ++a)
+    {
+      auto const t = adjacency[a];
+
+      if(emitted[t])
+        continue;
+
+      for(int k = 0; k < 3; ++k)
+      {
+        auto const v = tri(t, k);
+        result.push_back(v);
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        liveCount[v]--;
+
+        if(time - cacheTime[v] > CACHE_SIZE)
+          cacheTime[v] = time++;
+      }
+
+      emitted[t] = true;
+    }
+
+    fanVertex = nextVertex(candidates);
+  }
+
+  copy(result.begin(), result.end(), single.indices.begin() + first);
+}
+
+// Renumbers the vertices in their order of first use, for the vertex fetch.
+void sortVerticesByFirstUse(SingleRenderMesh& single)
+{
+  vector<int> newIndex(single.vertices.size(), -1);
+  vector<SingleRenderMesh::PackedVertex> vertices;
+
+  for(auto& i : single.indices)
+  {
+    if(newIndex[i] < 0)
+    {
+      newIndex[i] = vertices.size();
+      vertices.push_back(single.vertices[i]);
+    }
+
+    i = newIndex[i];
+  }
+
+  single.vertices = move(vertices);
+}
+
+// Levels of detail of the models without visibility data (the sprites):
+// each level has a grid twice coarser than the previous one.
+auto const LOD_LEVELS = 3; // besides the full detail
+auto const LOD_GRID_CELLS = 32; // along the largest side of the model, for the first level
+auto const LOD_MIN_TRIANGLES = 64; // below, a model keeps its full detail only
+auto const LOD_MIN_REDUCTION = 0.75f; // a level keeps at most this ratio of the triangles of the previous one
+
+// Vertex clustering (Rossignac, Borrel 1993): the vertices in the same cell
+// of the grid become one, the triangles left flat disappear. The vertices
+// are kept, a level is only made of indices: the ones of 'single', from
+// its full detail triangles, are appended to 'indices'.
+// Returns the farthest a vertex moved.
+float simplify(SingleRenderMesh const& single, int indexCount, Vector3f origin, float cellSize, vector<uint32_t>& indices)
+{
+  auto getCell = [&] (SingleRenderMesh::PackedVertex const& v)
+    {
+      auto const rel = (getPos(v) - origin) * (1.0f / cellSize);
+      return (int64_t(rel.x) << 42) | (int64_t(rel.y) << 21) | int64_t(rel.z);
+    };
+
+  auto getCenter = [&] (SingleRenderMesh::PackedVertex const& v)
+    {
+      auto const rel = (getPos(v) - origin) * (1.0f / cellSize);
+      return origin + Vector3f(floor(rel.x) + 0.5f, floor(rel.y) + 0.5f, floor(rel.z) + 0.5f) * cellSize;
+    };
+
+  // each cell is represented by its vertex nearest to its center
+  unordered_map<int64_t, uint32_t> representatives;
+
+  for(int i = 0; i < indexCount; ++i)
+  {
+    auto const v = single.indices[i];
+    auto const cell = getCell(single.vertices[v]);
+    auto const center = getCenter(single.vertices[v]);
+    auto j = representatives.insert({ cell, v }).first;
+
+    auto const delta = getPos(single.vertices[v]) - center;
+    auto const bestDelta = getPos(single.vertices[j->second]) - center;
+
+    if(dotProduct(delta, delta) < dotProduct(bestDelta, bestDelta))
+      j->second = v;
+  }
+
+  float error = 0;
+  set<array<uint32_t, 3>> triangles;
+
+  for(int i = 0; i + 2 < indexCount; i += 3)
+  {
+    array<uint32_t, 3> t;
+
+    for(int k = 0; k < 3; ++k)
+    {
+      auto const v = single.indices[i + k];
+      t[k] = representatives[getCell(single.vertices[v])];
+
+      auto const moved = magnitude(getPos(single.vertices[t[k]]) - getPos(single.vertices[v]));
+      error = max(error, moved);
+    }
+
+    if(t[0] == t[1] || t[1] == t[2] || t[2] == t[0])
+      continue;
+
+    // the same triangle, from several ones of the full detail
+    auto key = t;
+    rotate(key.begin(), min_element(key.begin(), key.end()), key.end());
+
+    if(!triangles.insert(key).second)
+      continue;
+
+    indices.insert(indices.end(), t.begin(), t.end());
+  }
+
+  return error;
+}
+
+// Appends the levels of detail to the indices of each single mesh. The
+// grid is the same for all: their seams move the same way.
+void buildLods(RenderMesh& mesh)
+{
+  Vector3f boundsMin(1e9, 1e9, 1e9);
+  Vector3f boundsMax(-1e9, -1e9, -1e9);
+  int triangleCount = 0;
+
+  for(auto& single : mesh.singleMeshes)
+  {
+    for(auto& v : single.vertices)
+    {
+      boundsMin = Vector3f(min(boundsMin.x, v.x), min(boundsMin.y, v.y), min(boundsMin.z, v.z));
+      boundsMax = Vector3f(max(boundsMax.x, v.x), max(boundsMax.y, v.y), max(boundsMax.z, v.z));
+    }
+
+    triangleCount += single.indices.size() / 3;
+  }
+
+  if(triangleCount < LOD_MIN_TRIANGLES)
+    return;
+
+  auto const extent = boundsMax - boundsMin;
+  auto cellSize = max(extent.x, max(extent.y, extent.z)) / LOD_GRID_CELLS;
+
+  if(cellSize <= 0)
+    return;
+
+  // a margin, so no vertex is on the border of the grid
+  auto const origin = boundsMin - Vector3f(cellSize, cellSize, cellSize) * 0.5f;
+
+  mesh.lodErrors = { 0 };
+
+  for(auto& single : mesh.singleMeshes)
+    single.lods = { { -1, 0, (int)single.indices.size() } };
+
+  for(int level = 1; level <= LOD_LEVELS; ++level, cellSize *= 2)
+  {
+    vector<vector<uint32_t>> indices(mesh.singleMeshes.size());
+    float error = 0;
+    int levelTriangleCount = 0;
+
+    for(int i = 0; i < (int)mesh.singleMeshes.size(); ++i)
+    {
+      auto& single = mesh.singleMeshes[i];
+      error = max(error, simplify(single, single.lods[0].count, origin, cellSize, indices[i]));
+      levelTriangleCount += indices[i].size() / 3;
+    }
+
+    // not worth its memory
+    if(levelTriangleCount > triangleCount * LOD_MIN_REDUCTION)
+      continue;
+
+    for(int i = 0; i < (int)mesh.singleMeshes.size(); ++i)
+    {
+      auto& single = mesh.singleMeshes[i];
+      single.lods.push_back({ -1, (int)single.indices.size(), (int)indices[i].size() });
+      single.indices.insert(single.indices.end(), indices[i].begin(), indices[i].end());
+    }
+
+    mesh.lodErrors.push_back(error);
+    triangleCount = levelTriangleCount;
+
+    if(triangleCount == 0)
+      break;
+  }
+
+  if(mesh.lodErrors.size() > 1)
+    return;
+
+  mesh.lodErrors.clear();
+
+  for(auto& single : mesh.singleMeshes)
+    single.lods.clear();
+}
+
+// Each range, or level of detail, is optimized on its own, so they survive.
+void indexMesh(RenderMesh& mesh, bool withLods)
+{
+  for(auto& single : mesh.singleMeshes)
+    weldVertices(single);
+
+  if(withLods)
+    buildLods(mesh);
+
+  for(auto& single : mesh.singleMeshes)
+  {
+    if(single.ranges.empty() && single.lods.empty())
+      optimizeVertexCache(single, 0, single.indices.size());
+
+    for(auto& range : single.ranges)
+      optimizeVertexCache(single, range.first, range.count);
+
+    for(auto& lod : single.lods)
+      optimizeVertexCache(single, lod.first, lod.count);
+
+    sortVerticesByFirstUse(single);
+  }
+}
+
 void writeRenderMesh(string path, const RenderMesh& renderMesh)
 {
-  FILE* fp = fopen(path.c_str(), "wb");
+  auto const data = serializeRenderMesh(renderMesh);
+  File::write(path, { (uint8_t*)data.data(), (int)data.size() });
+}
+
+// Writes the PNG, along with its GPU ready versions, mipmaps included:
+// "bc.tex" for desktop GPUs, "etc.tex" for mobile ones, and "rgba.tex",
+// uncompressed, for the others.
+// 'srgb': false for linear data, e.g lightmaps.
+void writeTexture(string path, Span<const uint8_t> pngData, bool srgb)
+{
+  File::write(path, pngData);
+
+  auto pic = decodePicture(pngData);
+  auto const alpha = hasAlpha(pic);
+
+  auto write = [&] (string ext, TextureFormat format)
+    {
+      auto const data = serializeTexture(compressTexture(pic, format, srgb));
+      File::write(setExtension(path, ext), { (uint8_t*)data.data(), (int)data.size() });
+    };
+
+  write("bc.tex", alpha ? TextureFormat::Bc3 : TextureFormat::Bc1);
+  write("etc.tex", alpha ? TextureFormat::Etc2Rgba : TextureFormat::Etc2Rgb);
+  write("rgba.tex", TextureFormat::Rgba8);
+}
+
+// FNV-1a
+void hashBytes(uint64_t& hash, Span<const uint8_t> data)
+{
+  for(auto c : data)
+    hash = (hash ^ c) * 0x100000001b3ull;
+}
+
+void hashString(uint64_t& hash, string const& s)
+{
+  hashBytes(hash, { (const uint8_t*)s.c_str(), (int)s.size() + 1 });
+}
+
+// The stamp of the last cook of 'render' is the first line of its
+// dependency file, for make: "# cookhash <hash of the inputs>".
+// Zero if there's none.
+uint64_t readStamp(string const& render)
+{
+  auto const path = render + ".d";
+
+  if(!File::exists(path))
+    return 0;
+
+  uint64_t r = 0;
+
+  if(sscanf(File::read(path).c_str(), "# cookhash %" SCNx64, &r) != 1)
+    return 0;
+
+  return r;
+}
+
+// The textures aren't known to make: they're named by the materials
+// of the mesh. They become prerequisites of 'render' from here.
+void writeStamp(string const& render, uint64_t hash, vector<string> const& inputs)
+{
+  char header[64];
+  snprintf(header, sizeof header, "# cookhash %016" PRIx64 "\n", hash);
+
+  string deps = header + render + ":";
+
+  for(auto& input : inputs)
+    deps += " " + input;
+
+  deps += "\n";
+
+  // like 'gcc -MP': a deleted texture isn't an error for make
+  for(auto& input : inputs)
+    deps += "\n" + input + ":\n";
+
+  File::write(render + ".d", { (const uint8_t*)deps.data(), (int)deps.size() });
+}
+
+
+// Atlas of the props: the small textures of the single meshes
+// of 'renders', packed into pages next to 'output' (e.g "atlas.txt").
+// Three pages at most: the opaque diffuses, the translucent ones (drawn
+// blended), and the lightmaps (linear). The textures which don't fit,
+// and the diffuses of wrapping UVs, stay out.
+void cookAtlas(string output, vector<string> const& renders)
+{
+  struct Candidate
+  {
+    string path;
+    Picture pic;
+  };
+
+  enum { Opaque, Translucent, Linear, PageCount };
+  vector<Candidate> candidates[PageCount];
+  set<string> seen;
+
+  auto addCandidate = [&] (string const& path, int page)
+    {
+      if(!File::exists(path) || !seen.insert(path).second)
+        return;
+
+      auto pic = decodePicture(File::map(path)->data);
 
-  for(auto& single : renderMesh.singleMeshes)
+      if(pic.dim.width > ATLAS_MAX_TILE_SIZE || pic.dim.height > ATLAS_MAX_TILE_SIZE)
+        return;
+
+      if(page == Opaque && hasAlpha(pic))
+        page = Translucent;
+
+      candidates[page].push_back({ path, move(pic) });
+    };
+
+  for(auto& render : renders)
   {
-    const int num = (int)single.vertices.size();
-    fwrite(&num, 1, 4, fp);
+    auto const mesh = deserializeRenderMesh(File::map(render)->data);
+
+    for(int i = 0; i < (int)mesh.singleMeshes.size(); ++i)
+      if(hasDiffuseInTile(mesh.singleMeshes[i]))
+        addCandidate(setExtension(render, to_string(i) + ".diffuse.png"), Opaque);
 
-    for(auto& vertex : single.vertices)
-      fwrite(&vertex, 1, sizeof vertex, fp);
+    addCandidate(setExtension(render, "lightmap.png"), Linear);
   }
 
-  fclose(fp);
+  static char const* const PAGE_NAMES[] = { "atlas-opaque.png", "atlas-translucent.png", "atlas-linear.png" };
+
+  TextureAtlas atlas;
+
+  for(int k = 0; k < PageCount; ++k)
+  {
+    auto& pictures = candidates[k];
+
+    // the largest ones leave first
+    stable_sort(pictures.begin(), pictures.end(), [] (Candidate const& a, Candidate const& b) { return a.pic.dim.width * a.pic.dim.height < b.pic.dim.width * b.pic.dim.height; });
+
+    Picture page;
+    vector<Vector2i> positions;
+
+    while(!pictures.empty())
+    {
+      vector<PictureView> views;
+
+      for(auto& c : pictures)
+        views.push_back(c.pic);
+
+      if(packAtlasPage(views, ATLAS_MAX_SIZE, page, positions))
+        break;
+
+      printf("[meshcooker] '%s' doesn't fit in the atlas\n", pictures.back().path.c_str());
+      pictures.pop_back();
+    }
+
+    if(pictures.empty())
+      continue;
+
+    auto const pagePath = dirName(output) + "/" + PAGE_NAMES[k];
+    auto const png = encodePicture(page);
+    writeTexture(pagePath, { png.data(), (int)png.size() }, k != Linear);
+
+    atlas.pages.push_back({ pagePath, page.dim });
+
+    for(int i = 0; i < (int)pictures.size(); ++i)
+      atlas.tiles.push_back({ pictures[i].path, (int)atlas.pages.size() - 1, positions[i], pictures[i].pic.dim });
+  }
+
+  auto const data = serializeAtlas(atlas);
+  File::write(output, { (uint8_t const*)data.data(), (int)data.size() });
 }
 }
 
+// Usage: meshcooker.exe <input.mesh> <textureDir> <output.render> [output.collision]
+//    or: meshcooker.exe --atlas <output.txt> <input.render>...
+// Nothing is written if the inputs, and the cooker version, are the same
+// as in the last cook of the same outputs.
 int main(int argc, const char* argv[])
 {
-  if(argc != 4)
+  if(argc >= 3 && string(argv[1]) == "--atlas")
+  {
+    cookAtlas(argv[2], vector<string>(argv + 3, argv + argc));
+    return 0;
+  }
+
+  if(argc != 4 && argc != 5)
     return 1;
 
   const auto input = argv[1];
@@ -95,41 +788,136 @@ int main(int argc, const char* argv[])
 
   std::vector<string> textureFiles;
   auto renderMesh = convertToRenderMesh(mesh, textureFiles);
-  writeRenderMesh(outputPathMesh, renderMesh);
+  auto const singleCount = (int)renderMesh.singleMeshes.size();
 
-  int meshIndex = 0;
+  vector<string> inputPathsDiffuse;
 
-  for(auto& single : renderMesh.singleMeshes)
+  for(int meshIndex = 0; meshIndex < singleCount; ++meshIndex)
   {
-    static uint8_t gray_png[] = { 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x08, 0x08, 0x06, 0x00, 0x00, 0x00, 0xc4, 0x0f, 0xbe, 0x8b, 0x00, 0x00, 0x00, 0x16, 0x49, 0x44, 0x41, 0x54, 0x18, 0xd3, 0x63, 0x6c, 0x68, 0x68, 0xf8, 0xcf, 0x80, 0x07, 0x30, 0x31, 0x10, 0x00, 0xc3, 0x43, 0x01, 0x00, 0x95, 0x62, 0x02, 0x8f, 0x72, 0x61, 0x0a, 0x14, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82 };
+    if(textureFiles[meshIndex] == "")
+      textureFiles[meshIndex] = "mesh.png";
+
+    inputPathsDiffuse.push_back(string(textureDir) + "/" + textureFiles[meshIndex]);
+  }
+
+  // everything the outputs depend on
+  vector<string> inputs;
+  vector<string> outputs = { outputPathMesh, setExtension(outputPathMesh, "lightmap.png") };
+  uint64_t hash = 0xcbf29ce484222325ull;
+
+  {
+    hashString(hash, to_string(COOKER_VERSION));
+
+    for(int i = 1; i < argc; ++i)
+      hashString(hash, argv[i]);
+
+    hashBytes(hash, File::map(input)->data);
 
+    for(auto& path : inputPathsDiffuse)
     {
-      auto outputPathLightmap = setExtension(outputPathMesh, to_string(meshIndex) + ".lightmap.png");
-      File::write(outputPathLightmap, gray_png);
+      hashString(hash, path);
+
+      if(!File::exists(path))
+        continue;
+
+      hashBytes(hash, File::map(path)->data);
+      inputs.push_back(path);
     }
 
+    if(argc == 5)
     {
-      auto const outputPathDiffuse = setExtension(outputPathMesh, to_string(meshIndex) + ".diffuse.png");
-
-      if(textureFiles[meshIndex] == "")
-        textureFiles[meshIndex] = "mesh.png";
+      outputs.push_back(argv[4]);
+      outputs.push_back(setExtension(outputPathMesh, "pvs"));
+    }
 
-      auto const inputPathDiffuse = string(textureDir) + "/" + textureFiles[meshIndex];
+    for(int meshIndex = 0; meshIndex < singleCount; ++meshIndex)
+      outputs.push_back(setExtension(outputPathMesh, to_string(meshIndex) + ".diffuse.png"));
 
-      if(File::exists(inputPathDiffuse.c_str()))
-      {
-        auto diffusePngData = File::read(inputPathDiffuse);
-        File::write(outputPathDiffuse, { (uint8_t*)diffusePngData.data(), (int)diffusePngData.size() });
-      }
-      else
+    auto const cooked = [&] ()
       {
-        File::write(outputPathDiffuse, gray_png);
-      }
+        for(auto& output : outputs)
+          if(!File::exists(output))
+            return false;
+
+        return readStamp(outputPathMesh) == hash;
+      };
+
+    if(cooked())
+    {
+      printf("[meshcooker] '%s' is up to date\n", outputPathMesh);
+      return 0;
+    }
+
+    // a cook interrupted halfway must not pass for the previous one
+    writeStamp(outputPathMesh, 0, inputs);
+  }
+
+  // optional: collision data, and visibility
+  function<bool(Vector3f, Vector3f)> lineOfSight;
+
+  if(argc == 5)
+    lineOfSight = cookRoom(mesh, argv[4]);
+
+  // the triangles are sorted by cell before being indexed
+  if(lineOfSight)
+    computeVisibility(renderMesh, lineOfSight);
+
+  // the textures are independent from each other: one job each
+  vector<function<void()>> textureJobs;
+
+  // One lightmap for all the single meshes: rooms get their ambient
+  // occlusion baked, the others a white one.
+  {
+    Picture lightmap;
+
+    if(lineOfSight)
+    {
+      auto const atlas = packLightmap(renderMesh, LIGHTMAP_TEXELS_PER_UNIT, LIGHTMAP_MAX_SIZE);
+      lightmap = bakeLightmap(renderMesh, atlas, lineOfSight, LIGHTMAP_AO_RANGE);
+    }
+    else
+    {
+      lightmap.dim = Size2i(8, 8);
+      lightmap.stride = lightmap.dim.width;
+      lightmap.pixels.assign(lightmap.dim.width * lightmap.dim.height * 4, 0xff);
     }
 
-    ++meshIndex;
+    auto const png = encodePicture(lightmap);
+    textureJobs.push_back([=] () { writeTexture(setExtension(outputPathMesh, "lightmap.png"), { png.data(), (int)png.size() }, false); });
+  }
+
+  for(int meshIndex = 0; meshIndex < singleCount; ++meshIndex)
+  {
+    static uint8_t gray_png[] = { 0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d, 0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x08, 0x08, 0x06, 0x00, 0x00, 0x00, 0xc4, 0x0f, 0xbe, 0x8b, 0x00, 0x00, 0x00, 0x16, 0x49, 0x44, 0x41, 0x54, 0x18, 0xd3, 0x63, 0x6c, 0x68, 0x68, 0xf8, 0xcf, 0x80, 0x07, 0x30, 0x31, 0x10, 0x00, 0xc3, 0x43, 0x01, 0x00, 0x95, 0x62, 0x02, 0x8f, 0x72, 0x61, 0x0a, 0x14, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82 };
+
+    auto const outputPathDiffuse = setExtension(outputPathMesh, to_string(meshIndex) + ".diffuse.png");
+    auto const inputPathDiffuse = inputPathsDiffuse[meshIndex];
+
+    textureJobs.push_back([=] ()
+      {
+        if(File::exists(inputPathDiffuse.c_str()))
+          writeTexture(outputPathDiffuse, File::map(inputPathDiffuse)->data, true);
+        else
+          writeTexture(outputPathDiffuse, gray_png, true);
+      });
+  }
+
+  {
+    ThreadPool pool;
+    pool.parallelFor(textureJobs.size(), [&] (int i) { textureJobs[i](); });
+  }
+
+  // the rooms have their visibility instead
+  indexMesh(renderMesh, !lineOfSight);
+  writeRenderMesh(outputPathMesh, renderMesh);
+
+  if(lineOfSight)
+  {
+    auto const pvs = serializeVisibility(renderMesh);
+    File::write(setExtension(outputPathMesh, "pvs"), { (uint8_t*)pvs.data(), (int)pvs.size() });
   }
 
+  writeStamp(outputPathMesh, hash, inputs);
+
   return 0;
 }
-
@@ -0,0 +1,50 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Packs resource files into a single archive, mounted by the game at startup.
+// Usage: packer.exe <output.pack> <files...>
+// The files are stored under the paths given on the command line
+// (e.g "res/font.png").
+
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include "misc/archive.h"
+#include "misc/file.h"
+
+int main(int argc, const char* argv[])
+{
+  if(argc < 2)
+  {
+    fprintf(stderr, "Usage: %s <output.pack> <files...>\n", argv[0]);
+    return 1;
+  }
+
+  try
+  {
+    vector<unique_ptr<MappedFile>> mappings;
+    vector<ArchiveInput> inputs;
+
+    for(int i = 2; i < argc; ++i)
+    {
+      mappings.push_back(File::map(argv[i]));
+      inputs.push_back({ argv[i], mappings.back()->data });
+    }
+
+    auto const data = serializeArchive(inputs);
+    File::write(argv[1], { (uint8_t const*)data.data(), (int)data.size() });
+
+    printf("Packed %d files into '%s' (%d bytes)\n", argc - 2, argv[1], (int)data.size());
+    return 0;
+  }
+  catch(exception const& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,393 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Entry point for the performance regression harness.
+// Plays each room headless for a fixed number of ticks, and reports the
+// tick time percentiles, the counters sent by the game (e.g traces), and
+// the heap allocations per tick. Then compares them against a baseline.
+//
+// Usage: perf.exe [--rooms 0,1] [--ticks N] [--warmup N] [--replays DIR]
+//                 [--baseline FILE] [--write-baseline FILE] [--tolerance PERCENT]
+//                 [game args]
+//
+// A room plays 'DIR/<room>.ctrl' (see '--record'), over and over, when
+// there's one: otherwise, a scripted walk.
+// Exits with 1 when a metric is worse than its baseline, by more than the
+// tolerance.
+
+#include <algorithm> // sort, max
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib> // atoi, atof, malloc
+#include <cstring> // strcmp
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "base/scene.h"
+#include "base/view.h"
+#include "misc/control_stream.h"
+#include "misc/file.h"
+
+using namespace std;
+
+Scene* createGame(View* view, vector<string> argv);
+
+///////////////////////////////////////////////////////////////////////////////
+// every heap allocation of the harness is counted
+
+static atomic<int64_t> g_allocations { 0 };
+
+void* operator new(size_t size)
+{
+  g_allocations.fetch_add(1, memory_order_relaxed);
+
+  if(auto p = malloc(size ? size : 1))
+    return p;
+
+  throw bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+  free(p);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+// Outside world of the measured session: only keeps the counters.
+struct CountingView : View
+{
+  void setTitle(char const*) override {}
+  void preload(Resource) override {}
+  void textBox(char const*) override {}
+  void playMusic(int) override {}
+  void stopMusic() override {}
+  void playSound(int) override {}
+  void setCameraPos(Vector3f, Quaternion, Vector3f) override {}
+  void setAmbientLight(float) override {}
+  void sendActor(Actor const&) override {}
+  int addProxy(Actor const&) override { return 0; }
+  void updateProxy(int, Actor const&) override {}
+  void removeProxy(int) override {}
+  void sendDebugText(char const*) override {}
+
+  void sendCounter(char const* name, int value) override
+  {
+    if(counting)
+      counters[name] += value;
+  }
+
+  bool counting = false;
+  map<string, int64_t> counters; // summed over the measured ticks
+};
+
+// name -> value, e.g "p99_us" -> 412.5
+using Metrics = map<string, double>;
+
+// Without a replay: walks around, turning, and jumps from time to time
+Control scriptedControl(int tick)
+{
+  Control c {};
+  c.forward = true;
+  c.run = (tick / 200) % 2;
+  c.look_horz = 0.01f;
+  c.jump = tick % 60 == 0;
+  return c;
+}
+
+double percentile(vector<double> const& sorted, double p)
+{
+  if(sorted.empty())
+    return 0;
+
+  auto const i = min(int(sorted.size() * p), (int)sorted.size() - 1);
+  return sorted[i];
+}
+
+Metrics runRoom(int room, vector<Control> const& controls, vector<string> gameArgs, int tickCount, int warmupCount)
+{
+  CountingView view;
+
+  // the room is loaded by the first tick: not measured
+  gameArgs.insert(gameArgs.begin(), { to_string(room), "--sync-load" });
+  unique_ptr<Scene> scene(createGame(&view, gameArgs));
+
+  vector<double> tickTimes;
+  int64_t allocations = 0;
+
+  for(int i = 0; i < warmupCount + tickCount; ++i)
+  {
+    auto const control = controls.empty() ? scriptedControl(i) : controls[i % controls.size()];
+
+    view.counting = i >= warmupCount;
+
+    auto const allocationsBefore = g_allocations.load();
+    auto const start = chrono::steady_clock::now();
+
+    auto next = scene->tick(control);
+
+    auto const elapsed = chrono::steady_clock::now() - start;
+
+    if(view.counting)
+    {
+      tickTimes.push_back(chrono::duration<double, micro>(elapsed).count());
+      allocations += g_allocations.load() - allocationsBefore;
+    }
+
+    if(next != scene.get())
+      scene.reset(next);
+  }
+
+  sort(tickTimes.begin(), tickTimes.end());
+
+  Metrics r;
+  r["p50_us"] = percentile(tickTimes, 0.50);
+  r["p90_us"] = percentile(tickTimes, 0.90);
+  r["p99_us"] = percentile(tickTimes, 0.99);
+  r["allocs"] = double(allocations) / max(1, tickCount);
+
+  for(auto& counter : view.counters)
+    r[counter.first] = double(counter.second) / max(1, tickCount);
+
+  return r;
+}
+
+// The rooms the game comes with: 'res/rooms/NN'
+vector<int> findRooms()
+{
+  vector<int> r;
+
+  while(1)
+  {
+    char path[256];
+    snprintf(path, sizeof path, "res/rooms/%02d/mesh.mesh", (int)r.size());
+
+    if(!File::exists(path))
+      break;
+
+    r.push_back((int)r.size());
+  }
+
+  return r;
+}
+
+vector<int> parseList(char const* s)
+{
+  vector<int> r;
+  istringstream ss(s);
+  string item;
+
+  while(getline(ss, item, ','))
+    r.push_back(atoi(item.c_str()));
+
+  return r;
+}
+
+// One line per metric: "<room> <name> <value>"
+map<int, Metrics> readBaseline(string path)
+{
+  ifstream fp(path);
+
+  if(!fp.is_open())
+    throw runtime_error("Can't open baseline '" + path + "'");
+
+  map<int, Metrics> r;
+  int room;
+  string name;
+  double value;
+
+  while(fp >> room >> name >> value)
+    r[room][name] = value;
+
+  return r;
+}
+
+void writeBaseline(string path, map<int, Metrics> const& results)
+{
+  ofstream fp(path);
+
+  if(!fp.is_open())
+    throw runtime_error("Can't write baseline '" + path + "'");
+
+  for(auto& room : results)
+    for(auto& metric : room.second)
+      fp << room.first << " " << metric.first << " " << metric.second << "\n";
+}
+
+// Returns the count of regressions
+int compare(map<int, Metrics> const& results, map<int, Metrics> const& baseline, double tolerance)
+{
+  int regressions = 0;
+
+  for(auto& room : results)
+  {
+    auto i = baseline.find(room.first);
+
+    if(i == baseline.end())
+    {
+      printf("[room %02d] not in the baseline\n", room.first);
+      continue;
+    }
+
+    for(auto& metric : room.second)
+    {
+      auto j = i->second.find(metric.first);
+
+      if(j == i->second.end())
+        continue;
+
+      auto const expected = j->second;
+      auto const actual = metric.second;
+
+      // zero stays zero: e.g no allocations
+      auto const limit = expected * (1 + tolerance);
+
+      if(actual <= limit)
+        continue;
+
+      auto const change = expected > 0 ? (actual / expected - 1) * 100 : 100;
+      printf("[room %02d] REGRESSION: %s %.2f, baseline %.2f (+%.0f%%)\n",
+             room.first, metric.first.c_str(), actual, expected, change);
+      ++regressions;
+    }
+  }
+
+  return regressions;
+}
+}
+
+int main(int argc, char* argv[])
+{
+  try
+  {
+    vector<int> rooms;
+    int tickCount = 2000;
+    int warmupCount = 100;
+    double tolerance = 0.1;
+    string replayDir;
+    string baselinePath;
+    string newBaselinePath;
+    vector<string> gameArgs;
+
+    for(int i = 1; i < argc; ++i)
+    {
+      auto arg = argv[i];
+
+      auto value = [&] ()
+        {
+          if(i + 1 >= argc)
+            throw runtime_error(string("Missing value for '") + arg + "'");
+
+          return argv[++i];
+        };
+
+      if(!strcmp(arg, "--rooms"))
+        rooms = parseList(value());
+      else if(!strcmp(arg, "--ticks"))
+        tickCount = max(1, atoi(value()));
+      else if(!strcmp(arg, "--warmup"))
+        warmupCount = max(1, atoi(value()));
+      else if(!strcmp(arg, "--replays"))
+        replayDir = value();
+      else if(!strcmp(arg, "--baseline"))
+        baselinePath = value();
+      else if(!strcmp(arg, "--write-baseline"))
+        newBaselinePath = value();
+      else if(!strcmp(arg, "--tolerance"))
+        tolerance = atof(value()) / 100.0;
+      else
+        gameArgs.push_back(arg);
+    }
+
+    if(rooms.empty())
+      rooms = findRooms();
+
+    if(rooms.empty())
+      throw runtime_error("No rooms to play: is 'res' built?");
+
+    map<int, Metrics> results;
+
+    for(auto room : rooms)
+    {
+      vector<Control> controls;
+
+      char replayPath[256];
+      snprintf(replayPath, sizeof replayPath, "%s/%02d.ctrl", replayDir.c_str(), room);
+
+      if(!replayDir.empty() && File::exists(replayPath))
+      {
+        auto const data = File::read(replayPath);
+        controls = readControlStream({ (uint8_t const*)data.data(), (int)data.size() });
+      }
+
+      auto& r = results[room] = runRoom(room, controls, gameArgs, tickCount, warmupCount);
+
+      printf("[room %02d] %s, %d ticks: p50 %.1f us, p90 %.1f us, p99 %.1f us, %.2f allocs/tick",
+             room, controls.empty() ? "scripted" : "replay", tickCount, r["p50_us"], r["p90_us"], r["p99_us"], r["allocs"]);
+
+      for(auto& metric : r)
+        if(metric.first != "allocs" && metric.first.find("_us") == string::npos)
+          printf(", %.1f %s/tick", metric.second, metric.first.c_str());
+
+      printf("\n");
+    }
+
+    if(!newBaselinePath.empty())
+    {
+      writeBaseline(newBaselinePath, results);
+      printf("Baseline written to '%s'\n", newBaselinePath.c_str());
+    }
+
+    if(baselinePath.empty())
+      return 0;
+
+    auto const regressions = compare(results, readBaseline(baselinePath), tolerance);
+
+    if(regressions)
+    {
+      printf("%d regressions (tolerance: %.0f%%)\n", regressions, tolerance * 100);
+      return 1;
+    }
+
+    printf("No regressions (tolerance: %.0f%%)\n", tolerance * 100);
+    return 0;
+  }
+  catch(exception const& e)
+  {
+    fprintf(stderr, "Fatal: %s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,142 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "archive.h"
+
+#include <algorithm> // sort, lower_bound
+#include <cstring> // memcpy, memcmp
+#include <stdexcept>
+
+namespace
+{
+auto const MAGIC = "PACK";
+uint32_t const VERSION = 1;
+auto const ALIGNMENT = 16;
+
+template<typename T>
+T readPod(Span<const uint8_t> data, int pos)
+{
+  T value;
+  memcpy(&value, data.data + pos, sizeof value);
+  return value;
+}
+
+template<typename T>
+void writePod(string& data, T const& value)
+{
+  data.append((char const*)&value, sizeof value);
+}
+}
+
+uint64_t hashArchivePath(string const& path)
+{
+  uint64_t hash = 0xcbf29ce484222325ull;
+
+  for(auto c : path)
+    hash = (hash ^ (uint8_t)c) * 0x100000001b3ull;
+
+  return hash;
+}
+
+string serializeArchive(vector<ArchiveInput> const& files)
+{
+  vector<ArchiveEntry> index;
+
+  for(auto& file : files)
+    index.push_back({ hashArchivePath(file.path), 0, (uint64_t)file.data.len, ARCHIVE_STORED, 0 });
+
+  vector<int> order(files.size());
+
+  for(int i = 0; i < (int)order.size(); ++i)
+    order[i] = i;
+
+  sort(order.begin(), order.end(), [&] (int a, int b) { return index[a].hash < index[b].hash; });
+
+  for(int i = 1; i < (int)order.size(); ++i)
+    if(index[order[i - 1]].hash == index[order[i]].hash)
+      throw runtime_error("Archive: same hash for '" + files[order[i - 1]].path + "' and '" + files[order[i]].path + "'");
+
+  uint64_t offset = ARCHIVE_HEADER_SIZE + index.size() * sizeof(ArchiveEntry);
+
+  for(auto i : order)
+  {
+    offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    index[i].offset = offset;
+    offset += index[i].size;
+  }
+
+  string r;
+  r.append(MAGIC, 4);
+  writePod(r, VERSION);
+  writePod(r, (uint32_t)index.size());
+
+  for(auto i : order)
+    writePod(r, index[i]);
+
+  for(auto i : order)
+  {
+    r.resize(index[i].offset, 0);
+    r.append((char const*)files[i].data.data, files[i].data.len);
+  }
+
+  return r;
+}
+
+int parseArchiveHeader(Span<const uint8_t> header)
+{
+  if(header.len < ARCHIVE_HEADER_SIZE || memcmp(header.data, MAGIC, 4))
+    throw runtime_error("Not an archive");
+
+  if(readPod<uint32_t>(header, 4) != VERSION)
+    throw runtime_error("Unsupported archive version");
+
+  auto const count = readPod<uint32_t>(header, 8);
+
+  if(count > (1u << 24))
+    throw runtime_error("Invalid archive entry count");
+
+  return (int)count;
+}
+
+vector<ArchiveEntry> parseArchiveIndex(Span<const uint8_t> data, uint64_t archiveSize)
+{
+  auto const count = parseArchiveHeader(data);
+
+  if(count > (data.len - ARCHIVE_HEADER_SIZE) / (int)sizeof(ArchiveEntry))
+    throw runtime_error("Truncated archive index");
+
+  vector<ArchiveEntry> index(count);
+
+  if(count > 0)
+    memcpy(index.data(), data.data + ARCHIVE_HEADER_SIZE, count * sizeof(ArchiveEntry));
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto& entry = index[i];
+
+    if(i > 0 && index[i - 1].hash >= entry.hash)
+      throw runtime_error("Unsorted archive index");
+
+    if(entry.offset > archiveSize || entry.size > archiveSize - entry.offset)
+      throw runtime_error("Archive entry out of the archive");
+
+    if(entry.compression != ARCHIVE_STORED)
+      throw runtime_error("Unsupported archive compression");
+  }
+
+  return index;
+}
+
+ArchiveEntry const* findArchiveEntry(vector<ArchiveEntry> const& index, string const& path)
+{
+  auto const hash = hashArchivePath(path);
+  auto i = lower_bound(index.begin(), index.end(), hash, [] (ArchiveEntry const& entry, uint64_t h) { return entry.hash < h; });
+
+  if(i == index.end() || i->hash != hash)
+    return nullptr;
+
+  return &*i;
+}
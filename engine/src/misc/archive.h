@@ -0,0 +1,58 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Archive: many files in a single one, mounted with 'File::mount'.
+// Native byte order, like the other cooked files.
+//
+// header: "PACK", version, entry count
+// index: the entries, sorted by hash
+// then the contents of the entries, 16-byte aligned
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "base/span.h"
+
+struct ArchiveEntry
+{
+  uint64_t hash; // of the path, see 'hashArchivePath'
+  uint64_t offset; // from the start of the archive
+  uint64_t size;
+  uint32_t compression; // only 'ARCHIVE_STORED' so far
+  uint32_t reserved;
+};
+
+static_assert(sizeof(ArchiveEntry) == 32, "ArchiveEntry must stay tightly packed");
+
+auto const ARCHIVE_STORED = 0u;
+auto const ARCHIVE_HEADER_SIZE = 12;
+
+// FNV-1a. The paths are used as given, e.g "res/font.png".
+uint64_t hashArchivePath(string const& path);
+
+struct ArchiveInput
+{
+  string path;
+  Span<const uint8_t> data;
+};
+
+// Throws if two paths have the same hash.
+string serializeArchive(vector<ArchiveInput> const& files);
+
+// The number of entries in the index that follows 'header'.
+// Throws if it's not an archive.
+int parseArchiveHeader(Span<const uint8_t> header);
+
+// 'data': the header and the index, at least.
+// Throws if an entry is out of the 'archiveSize' bytes of the archive.
+vector<ArchiveEntry> parseArchiveIndex(Span<const uint8_t> data, uint64_t archiveSize);
+
+// nullptr if 'path' isn't in 'index'
+ArchiveEntry const* findArchiveEntry(vector<ArchiveEntry> const& index, string const& path);
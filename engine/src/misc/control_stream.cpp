@@ -0,0 +1,125 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Control stream format:
+// header: "CTRL", version (1 byte)
+// then for each tick: 16-bit flags (little endian),
+// followed by look_horz and look_vert (2 x float32) if LOOK is set.
+
+#include "control_stream.h"
+#include <cstring> // memcpy, memcmp
+#include <stdexcept>
+
+namespace
+{
+auto const MAGIC = "CTRL";
+uint8_t const VERSION = 1;
+
+auto const LOOK = 1 << 15;
+
+// the order of this list is part of the file format
+bool Control::* const BUTTONS[] =
+{
+  &Control::forward,
+  &Control::backward,
+  &Control::left,
+  &Control::right,
+  &Control::run,
+  &Control::use,
+  &Control::fire,
+  &Control::jump,
+  &Control::dash,
+  &Control::start,
+  &Control::restart,
+  &Control::debug,
+};
+
+void writeFloat(vector<uint8_t>& dst, float value)
+{
+  uint8_t bytes[4];
+  memcpy(bytes, &value, 4);
+  dst.insert(dst.end(), bytes, bytes + 4);
+}
+}
+
+void writeControlStreamHeader(vector<uint8_t>& dst)
+{
+  dst.insert(dst.end(), MAGIC, MAGIC + 4);
+  dst.push_back(VERSION);
+}
+
+void writeControl(vector<uint8_t>& dst, Control const& c)
+{
+  int flags = 0;
+
+  for(int i = 0; i < (int)(sizeof BUTTONS / sizeof *BUTTONS); ++i)
+    if(c.*BUTTONS[i])
+      flags |= 1 << i;
+
+  auto const look = c.look_horz != 0 || c.look_vert != 0;
+
+  if(look)
+    flags |= LOOK;
+
+  dst.push_back(flags & 0xFF);
+  dst.push_back(flags >> 8);
+
+  if(look)
+  {
+    writeFloat(dst, c.look_horz);
+    writeFloat(dst, c.look_vert);
+  }
+}
+
+vector<Control> readControlStream(Span<const uint8_t> data)
+{
+  int pos = 0;
+
+  auto read = [&] (void* dst, int len)
+    {
+      if(len > data.len - pos)
+        throw runtime_error("Truncated control stream");
+
+      memcpy(dst, data.data + pos, len);
+      pos += len;
+    };
+
+  char magic[4];
+  read(magic, 4);
+
+  if(memcmp(magic, MAGIC, 4))
+    throw runtime_error("Not a control stream");
+
+  uint8_t version;
+  read(&version, 1);
+
+  if(version != VERSION)
+    throw runtime_error("Unsupported control stream version");
+
+  vector<Control> r;
+
+  while(pos < data.len)
+  {
+    uint8_t bytes[2];
+    read(bytes, 2);
+    int const flags = bytes[0] | (bytes[1] << 8);
+
+    Control c {};
+
+    for(int i = 0; i < (int)(sizeof BUTTONS / sizeof *BUTTONS); ++i)
+      c.*BUTTONS[i] = flags & (1 << i);
+
+    if(flags & LOOK)
+    {
+      read(&c.look_horz, 4);
+      read(&c.look_vert, 4);
+    }
+
+    r.push_back(c);
+  }
+
+  return r;
+}
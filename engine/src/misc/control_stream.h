@@ -0,0 +1,24 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Compact binary encoding of a stream of 'Control', one per tick.
+// Used to record a play session, and to replay it.
+
+#pragma once
+
+#include "base/scene.h"
+#include "base/span.h"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// the header must be written once, before the first control
+void writeControlStreamHeader(vector<uint8_t>& dst);
+void writeControl(vector<uint8_t>& dst, Control const& c);
+
+// throws if 'data' isn't a valid stream
+vector<Control> readControlStream(Span<const uint8_t> data);
@@ -5,7 +5,10 @@
 // License, or (at your option) any later version.
 
 #include "decompress.h"
+#include <algorithm> // max
+#include <cstring> // memcpy, memset
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 // Copyright (c) 2005-2010 Lode Vandevenne
@@ -27,444 +30,489 @@
 // 3. This notice may not be removed or altered from any source distribution.
 
 // *This is a modified version of picoPNG*
+// The decoding is table driven: see 'HuffmanTable'.
 namespace
 {
-const unsigned long LENBASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
-const unsigned long LENEXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
-const unsigned long DISTBASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
-const unsigned long DISTEXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
-const unsigned long CLCL[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 }; // code length code lengths
+const uint16_t LENBASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t LENEXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DISTBASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t DISTEXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const uint8_t CLCL[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 }; // code length code lengths
 
-int readBit(size_t& bitp, const uint8_t* bits)
-{
-  int r = (bits[bitp / 8] >> (bitp % 8)) & 1;
-  bitp++;
-  return r;
-}
+auto const MAX_CODE_BITS = 15;
 
-int readBits(size_t& bitp, const uint8_t* bits, int nbits)
+void fail(const char* msg)
 {
-  int r = 0;
-
-  for(int i = 0; i < nbits; i++)
-    r += (readBit(bitp, bits)) << i;
-
-  return r;
+  throw runtime_error(string("decompress: ") + msg);
 }
 
-struct HuffmanTree
+// LSB first, 64 bits at a time
+struct BitReader
 {
-  int makeFromLengths(const std::vector<unsigned long>& bitlen, unsigned long maxbitlen)
+  BitReader(Span<const uint8_t> in) : m_pos(in.data), m_end(in.data + in.len)
   {
-    // make tree given the lengths
-    unsigned long numcodes = (unsigned long)(bitlen.size()), treepos = 0, nodefilled = 0;
-    std::vector<unsigned long> tree1d(numcodes), blcount(maxbitlen + 1, 0), nextcode(maxbitlen + 1, 0);
-
-    for(unsigned long bits = 0; bits < numcodes; bits++)
-      blcount[bitlen[bits]]++; // count number of instances of each code length
-
-    for(unsigned long bits = 1; bits <= maxbitlen; bits++)
-      nextcode[bits] = (nextcode[bits - 1] + blcount[bits - 1]) << 1;
+  }
 
-    for(unsigned long n = 0; n < numcodes; n++)
-      if(bitlen[n] != 0)
-        tree1d[n] = nextcode[bitlen[n]]++;
+  // At least 56 bits in 'bits' afterwards.
+  // Past the end, zeros come in: see 'checkOverrun'.
+  void refill()
+  {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if(m_end - m_pos >= 8)
+    {
+      uint64_t word;
+      memcpy(&word, m_pos, 8);
+      bits |= word << count;
+      m_pos += (63 - count) >> 3;
+      count |= 56;
+      return;
+    }
+#endif
 
-    // generate all the codes
+    while(count <= 56)
+    {
+      if(m_pos < m_end)
+        bits |= (uint64_t)*m_pos++ << count;
+      else
+        m_zeroBits += 8;
 
-    tree2d.clear();
-    tree2d.resize(numcodes * 2, 32767); // 32767 here means the tree2d isn't filled there yet
+      count += 8;
+    }
+  }
 
-    for(unsigned long n = 0; n < numcodes; n++) // the codes
-      for(unsigned long i = 0; i < bitlen[n]; i++) // the bits for this code
-      {
-        unsigned long bit = (tree1d[n] >> (bitlen[n] - i - 1)) & 1;
+  uint32_t peek(int n) const
+  {
+    return (uint32_t)(bits & ((1ull << n) - 1));
+  }
 
-        if(treepos > numcodes - 2)
-          return 55;
+  void consume(int n)
+  {
+    bits >>= n;
+    count -= n;
+  }
 
-        if(tree2d[2 * treepos + bit] == 32767) // not yet filled in
-        {
-          if(i + 1 == bitlen[n])
-          {
-            tree2d[2 * treepos + bit] = n;
-            treepos = 0;
-          } // last bit
-          else
-          {
-            tree2d[2 * treepos + bit] = ++nodefilled + numcodes;
-            treepos = nodefilled;
-          } // addresses are encoded as values > numcodes
-        }
-        else
-          treepos = tree2d[2 * treepos + bit] - numcodes; // subtract numcodes from address to get address value
-      }
+  // at most 56 bits, after a refill
+  uint32_t read(int n)
+  {
+    auto const r = peek(n);
+    consume(n);
+    return r;
+  }
 
-    return 0;
+  void checkOverrun() const
+  {
+    if(count < m_zeroBits)
+      fail("truncated data");
   }
 
-  int decode(bool& decoded, unsigned long& result, size_t& treepos, unsigned long bit) const
+  // Next byte boundary: the bytes still in 'bits' go back to the input.
+  void alignToByte()
   {
-    // Decodes a symbol from the tree
-    unsigned long numcodes = (unsigned long)tree2d.size() / 2;
+    checkOverrun();
+    consume(count % 8);
+
+    auto const buffered = (count - m_zeroBits) / 8;
+    m_pos -= buffered;
+    bits = 0;
+    count = 0;
+    m_zeroBits = 0;
+  }
 
-    if(treepos >= numcodes)
-      return 11; // error: you appeared outside the codetree
+  // after 'alignToByte'
+  Span<const uint8_t> takeBytes(size_t n)
+  {
+    if(n > (size_t)(m_end - m_pos))
+      fail("truncated stored block");
 
-    result = tree2d[2 * treepos + bit];
-    decoded = (result < numcodes);
-    treepos = decoded ? 0 : result - numcodes;
-    return 0;
+    Span<const uint8_t> r(m_pos, (int)n);
+    m_pos += n;
+    return r;
   }
 
-  // 2D representation of a huffman tree: The one dimension is "0" or "1", the other contains all nodes and leaves of the tree.
-  std::vector<unsigned long> tree2d;
+  uint64_t bits = 0;
+  int count = 0;
+
+private:
+  uint8_t const* m_pos;
+  uint8_t const* const m_end;
+  int m_zeroBits = 0; // the padding at the end, in 'bits'
 };
 
-struct Inflator
+// Two levels: the first ROOT_BITS bits of the input index the root table.
+// Longer codes go on in a sub-table, indexed by the bits that follow.
+// Entries: 'symbol << 8 | length' for a leaf.
+// 'offset << 8 | LINK | bits' for a sub-table. Zero for an invalid code.
+struct HuffmanTable
 {
-  int error;
+  static auto constexpr LINK = 0x80;
 
-  void inflate(std::vector<uint8_t>& out, const std::vector<uint8_t>& in, size_t inpos = 0)
+  void build(uint8_t const* lengths, int count, int rootBits)
   {
-    size_t bp = 0, pos = 0; // bit pointer and byte pointer
-    error = 0;
-    unsigned long BFINAL = 0;
+    m_rootBits = rootBits;
 
-    while(!BFINAL && !error)
-    {
-      if(bp >> 3 >= in.size())
-      {
-        error = 52;
-        return;
-      } // error, bit pointer will jump past memory
+    int lengthCounts[MAX_CODE_BITS + 1] {};
 
-      BFINAL = readBit(bp, &in[inpos]);
-      unsigned long BTYPE = readBit(bp, &in[inpos]);
-      BTYPE += 2 * readBit(bp, &in[inpos]);
+    for(int i = 0; i < count; ++i)
+      lengthCounts[lengths[i]]++;
 
-      if(BTYPE == 3)
-      {
-        error = 20;
-        return;
-      } // error: invalid BTYPE
-      else if(BTYPE == 0)
-        inflateNoCompression(out, &in[inpos], bp, pos, in.size());
-      else
-        inflateHuffmanBlock(out, &in[inpos], bp, pos, in.size(), BTYPE);
-    }
+    lengthCounts[0] = 0;
 
-    if(!error)
-      out.resize(pos); // Only now we know the true size of out, resize it to that
-  }
+    // over-subscribed codes are invalid. Incomplete ones are allowed
+    // (e.g a single distance code), their missing codes are left invalid.
+    int left = 1;
 
-  void generateFixedTrees(HuffmanTree& tree, HuffmanTree& treeD) // get the tree of a deflated block with fixed tree
-  {
-    std::vector<unsigned long> bitlen(288, 8), bitlenD(32, 5);
+    for(int len = 1; len <= MAX_CODE_BITS; ++len)
+    {
+      left = left * 2 - lengthCounts[len];
 
-    for(size_t i = 144; i <= 255; i++)
-      bitlen[i] = 9;
+      if(left < 0)
+        fail("over-subscribed Huffman code");
+    }
 
-    for(size_t i = 256; i <= 279; i++)
-      bitlen[i] = 7;
+    uint32_t nextCode[MAX_CODE_BITS + 2] {};
 
-    tree.makeFromLengths(bitlen, 15);
-    treeD.makeFromLengths(bitlenD, 15);
-  }
+    for(int len = 1; len <= MAX_CODE_BITS; ++len)
+      nextCode[len + 1] = (nextCode[len] + lengthCounts[len]) << 1;
 
-  // the code tree for Huffman codes, dist codes, and code length codes
-  HuffmanTree codetree, codetreeD, codelengthcodetree;
+    auto const rootSize = 1 << rootBits;
+    auto const rootMask = rootSize - 1;
 
-  unsigned long huffmanDecodeSymbol(const uint8_t* in, size_t& bp, const HuffmanTree& codetree, size_t inlength)
-  { // decode a single symbol from given list of bits with given code tree. return value is the symbol
-    bool decoded;
-    unsigned long ct;
+    // the bits of each sub-table: enough for its longest code
+    vector<int> subBits(rootSize);
 
-    for(size_t treepos = 0;;)
     {
-      if((bp & 0x07) == 0 && (bp >> 3) > inlength)
+      uint32_t code[MAX_CODE_BITS + 2];
+      memcpy(code, nextCode, sizeof code);
+
+      for(int i = 0; i < count; ++i)
       {
-        error = 10;
-        return 0;
-      } // error: end reached without endcode
+        auto const len = lengths[i];
 
-      error = codetree.decode(decoded, ct, treepos, readBit(bp, in));
+        if(len <= rootBits)
+        {
+          if(len)
+            code[len]++;
 
-      if(error)
-        return 0; // stop, an error happened
+          continue;
+        }
 
-      if(decoded)
-        return ct;
+        auto const prefix = reverse(code[len]++, len) & rootMask;
+        subBits[prefix] = max(subBits[prefix], len - rootBits);
+      }
     }
-  }
 
-  void getTreeInflateDynamic(HuffmanTree& tree, HuffmanTree& treeD, const uint8_t* in, size_t& bp, size_t inlength)
-  { // get the tree of a deflated block with dynamic tree, the tree itself is also Huffman compressed with a known tree
-    std::vector<unsigned long> bitlen(288, 0), bitlenD(32, 0);
+    entries.assign(rootSize, 0);
 
-    if(bp >> 3 >= inlength - 2)
+    for(int prefix = 0; prefix < rootSize; ++prefix)
     {
-      error = 49;
-      return;
-    } // the bit pointer is or will go past the memory
+      if(subBits[prefix] == 0)
+        continue;
 
-    size_t HLIT = readBits(bp, in, 5) + 257; // number of literal/length codes + 257
-    size_t HDIST = readBits(bp, in, 5) + 1; // number of dist codes + 1
-    size_t HCLEN = readBits(bp, in, 4) + 4; // number of code length codes + 4
-    std::vector<unsigned long> codelengthcode(19); // lengths of tree to decode the lengths of the dynamic tree
+      entries[prefix] = (uint32_t)entries.size() << 8 | LINK | subBits[prefix];
+      entries.resize(entries.size() + (1 << subBits[prefix]), 0);
+    }
 
-    for(size_t i = 0; i < 19; i++)
-      codelengthcode[CLCL[i]] = (i < HCLEN) ? readBits(bp, in, 3) : 0;
+    for(int symbol = 0; symbol < count; ++symbol)
+    {
+      auto const len = lengths[symbol];
 
-    error = codelengthcodetree.makeFromLengths(codelengthcode, 7);
+      if(len == 0)
+        continue;
 
-    if(error)
-      return;
+      auto const reversed = reverse(nextCode[len]++, len);
+      auto const leaf = (uint32_t)symbol << 8 | len;
 
-    size_t i = 0, replength;
+      if(len <= rootBits)
+      {
+        for(int i = reversed; i < rootSize; i += 1 << len)
+          entries[i] = leaf;
+      }
+      else
+      {
+        auto const link = entries[reversed & rootMask];
+        auto const offset = link >> 8;
+        auto const size = 1 << (link & 0xf);
 
-    while(i < HLIT + HDIST)
-    {
-      unsigned long code = huffmanDecodeSymbol(in, bp, codelengthcodetree, inlength);
+        for(int i = reversed >> rootBits; i < size; i += 1 << (len - rootBits))
+          entries[offset + i] = leaf;
+      }
+    }
+  }
 
-      if(error)
-        return;
+  // 'in' must hold at least MAX_CODE_BITS bits
+  int decode(BitReader& in) const
+  {
+    auto e = entries[in.peek(m_rootBits)];
 
-      if(code <= 15)
-      {
-        if(i < HLIT)
-          bitlen[i++] = code;
-        else
-          bitlenD[i++ - HLIT] = code;
-      } // a length code
-      else if(code == 16) // repeat previous
-      {
-        if(bp >> 3 >= inlength)
-        {
-          error = 50;
-          return;
-        } // error, bit pointer jumps past memory
+    if(e & LINK)
+      e = entries[(e >> 8) + ((in.bits >> m_rootBits) & ((1u << (e & 0xf)) - 1))];
 
-        replength = 3 + readBits(bp, in, 2);
-        unsigned long value; // set value to the previous code
+    auto const len = e & 0xf;
 
-        if((i - 1) < HLIT)
-          value = bitlen[i - 1];
-        else
-          value = bitlenD[i - HLIT - 1];
+    if(len == 0)
+      fail("invalid Huffman code");
 
-        for(size_t n = 0; n < replength; n++) // repeat this value in the next lengths
-        {
-          if(i >= HLIT + HDIST)
-          {
-            error = 13;
-            return;
-          } // error: i is larger than the amount of codes
-
-          if(i < HLIT)
-            bitlen[i++] = value;
-          else
-            bitlenD[i++ - HLIT] = value;
-        }
-      }
-      else if(code == 17) // repeat "0" 3-10 times
-      {
-        if(bp >> 3 >= inlength)
-        {
-          error = 50;
-          return;
-        } // error, bit pointer jumps past memory
+    in.consume(len);
+    return e >> 8;
+  }
 
-        replength = 3 + readBits(bp, in, 3);
+  vector<uint32_t> entries;
 
-        for(size_t n = 0; n < replength; n++) // repeat this value in the next lengths
-        {
-          if(i >= HLIT + HDIST)
-          {
-            error = 14;
-            return;
-          } // error: i is larger than the amount of codes
-
-          if(i < HLIT)
-            bitlen[i++] = 0;
-          else
-            bitlenD[i++ - HLIT] = 0;
-        }
-      }
-      else if(code == 18) // repeat "0" 11-138 times
-      {
-        if(bp >> 3 >= inlength)
-        {
-          error = 50;
-          return;
-        } // error, bit pointer jumps past memory
+private:
+  static int reverse(uint32_t code, int len)
+  {
+    uint32_t r = 0;
 
-        replength = 11 + readBits(bp, in, 7);
+    for(int i = 0; i < len; ++i)
+    {
+      r = (r << 1) | (code & 1);
+      code >>= 1;
+    }
 
-        for(size_t n = 0; n < replength; n++) // repeat this value in the next lengths
-        {
-          if(i >= HLIT + HDIST)
-          {
-            error = 15;
-            return;
-          } // error: i is larger than the amount of codes
-
-          if(i < HLIT)
-            bitlen[i++] = 0;
-          else
-            bitlenD[i++ - HLIT] = 0;
-        }
+    return r;
+  }
+
+  int m_rootBits = 0;
+};
+
+struct Inflator
+{
+  Inflator(vector<uint8_t>& out) : m_out(out)
+  {
+  }
+
+  void inflate(Span<const uint8_t> in)
+  {
+    BitReader bits(in);
+
+    for(bool final = false; !final;)
+    {
+      bits.refill();
+      final = bits.read(1);
+      auto const type = bits.read(2);
+
+      if(type == 0)
+        inflateStored(bits);
+      else if(type == 1)
+      {
+        buildFixedTables();
+        inflateHuffmanBlock(bits);
       }
-      else
+      else if(type == 2)
       {
-        error = 16;
-        return;
-      } // error: somehow an unexisting code appeared. This can never happen.
+        readDynamicTables(bits);
+        inflateHuffmanBlock(bits);
+      }
+      else
+        fail("invalid block type");
+
+      bits.checkOverrun();
     }
 
-    if(bitlen[256] == 0)
+    m_out.resize(m_pos);
+  }
+
+private:
+  static auto constexpr LITLEN_ROOT_BITS = 10;
+  static auto constexpr DIST_ROOT_BITS = 8;
+
+  void buildFixedTables()
+  {
+    if(m_fixedBuilt)
     {
-      error = 64;
+      m_litlen = m_fixedLitlen;
+      m_dist = m_fixedDist;
       return;
-    } // the length of the end code 256 must be larger than 0
-
-    error = tree.makeFromLengths(bitlen, 15);
+    }
 
-    if(error)
-      return; // now we've finally got HLIT and HDIST, so generate the code trees, and the function is done
+    uint8_t lengths[288];
+    memset(lengths + 0, 8, 144);
+    memset(lengths + 144, 9, 112);
+    memset(lengths + 256, 7, 24);
+    memset(lengths + 280, 8, 8);
+    m_fixedLitlen.build(lengths, 288, LITLEN_ROOT_BITS);
 
-    error = treeD.makeFromLengths(bitlenD, 15);
+    uint8_t distLengths[32];
+    memset(distLengths, 5, 32);
+    m_fixedDist.build(distLengths, 32, DIST_ROOT_BITS);
 
-    if(error)
-      return;
+    m_fixedBuilt = true;
+    m_litlen = m_fixedLitlen;
+    m_dist = m_fixedDist;
   }
 
-  void inflateHuffmanBlock(std::vector<uint8_t>& out, const uint8_t* in, size_t& bp, size_t& pos, size_t inlength, unsigned long btype)
+  void readDynamicTables(BitReader& bits)
   {
-    if(btype == 1)
+    bits.refill();
+    auto const HLIT = bits.read(5) + 257; // number of literal/length codes
+    auto const HDIST = bits.read(5) + 1; // number of dist codes
+    auto const HCLEN = bits.read(4) + 4; // number of code length codes
+
+    if(HLIT > 286 || HDIST > 30)
+      fail("invalid code counts");
+
+    uint8_t codeLengthLengths[19] {};
+
+    for(int i = 0; i < (int)HCLEN; ++i)
     {
-      generateFixedTrees(codetree, codetreeD);
+      bits.refill();
+      codeLengthLengths[CLCL[i]] = bits.read(3);
     }
-    else if(btype == 2)
-    {
-      getTreeInflateDynamic(codetree, codetreeD, in, bp, inlength);
 
-      if(error)
-        return;
-    }
+    HuffmanTable codeLengths;
+    codeLengths.build(codeLengthLengths, 19, 7);
 
-    for(;;)
-    {
-      unsigned long code = huffmanDecodeSymbol(in, bp, codetree, inlength);
+    // literal/length and distance lengths, in a row: the repeats can cross
+    uint8_t lengths[286 + 30] {};
+    int n = 0;
 
-      if(error)
-        return;
+    while(n < (int)(HLIT + HDIST))
+    {
+      bits.refill();
+      auto const code = codeLengths.decode(bits);
 
-      if(code == 256)
-        return; // end code
-      else if(code <= 255) // literal symbol
+      if(code <= 15)
       {
-        if(pos >= out.size())
-          out.resize((pos + 1) * 2); // reserve more room
-
-        out[pos++] = (uint8_t)(code);
+        lengths[n++] = code;
+        continue;
       }
-      else if(code >= 257 && code <= 285) // length code
+
+      int repeat;
+      uint8_t value = 0;
+
+      if(code == 16) // repeat previous
       {
-        size_t length = LENBASE[code - 257], numextrabits = LENEXTRA[code - 257];
+        if(n == 0)
+          fail("repeat without a previous length");
 
-        if((bp >> 3) >= inlength)
-        {
-          error = 51;
-          return;
-        } // error, bit pointer will jump past memory
+        value = lengths[n - 1];
+        repeat = 3 + bits.read(2);
+      }
+      else if(code == 17) // repeat "0" 3-10 times
+        repeat = 3 + bits.read(3);
+      else // code 18: repeat "0" 11-138 times
+        repeat = 11 + bits.read(7);
 
-        length += readBits(bp, in, numextrabits);
-        unsigned long codeD = huffmanDecodeSymbol(in, bp, codetreeD, inlength);
+      if(n + repeat > (int)(HLIT + HDIST))
+        fail("too many code lengths");
 
-        if(error)
-          return;
+      memset(lengths + n, value, repeat);
+      n += repeat;
+    }
 
-        if(codeD > 29)
-        {
-          error = 18;
-          return;
-        } // error: invalid dist code (30-31 are never used)
+    bits.checkOverrun();
 
-        unsigned long dist = DISTBASE[codeD], numextrabitsD = DISTEXTRA[codeD];
+    if(lengths[256] == 0)
+      fail("missing end code");
 
-        if((bp >> 3) >= inlength)
-        {
-          error = 51;
-          return;
-        } // error, bit pointer will jump past memory
+    m_litlen.build(lengths, HLIT, LITLEN_ROOT_BITS);
+    m_dist.build(lengths + HLIT, HDIST, DIST_ROOT_BITS);
+  }
 
-        dist += readBits(bp, in, numextrabitsD);
-        size_t start = pos, back = start - dist; // backwards
+  void reserve(size_t bytes)
+  {
+    // the match copies may write up to 8 bytes too far, see 'copyMatch'.
+    // Whatever was reserved beforehand is used first.
+    if(m_pos + bytes + 8 > m_out.size())
+      m_out.resize(max({ m_out.capacity(), m_out.size() * 2, m_pos + bytes + 8 }));
+  }
 
-        if(pos + length >= out.size())
-          out.resize((pos + length) * 2); // reserve more room
+  void inflateHuffmanBlock(BitReader& bits)
+  {
+    for(;;)
+    {
+      // enough for a length, its extra bits, a distance and its extra bits
+      bits.refill();
 
-        for(size_t i = 0; i < length; i++)
-        {
-          out[pos++] = out[back++];
+      auto const code = m_litlen.decode(bits);
 
-          if(back >= start)
-            back = start - dist;
-        }
+      if(code < 256)
+      {
+        reserve(1);
+        m_out[m_pos++] = (uint8_t)code;
+        continue;
       }
+
+      if(code == 256)
+        return;
+
+      if(code > 285)
+        fail("invalid length code");
+
+      auto const length = LENBASE[code - 257] + bits.read(LENEXTRA[code - 257]);
+      auto const codeD = m_dist.decode(bits);
+
+      if(codeD > 29)
+        fail("invalid distance code");
+
+      auto const dist = DISTBASE[codeD] + bits.read(DISTEXTRA[codeD]);
+
+      if(dist > m_pos)
+        fail("distance too far back");
+
+      bits.checkOverrun();
+      reserve(length);
+      copyMatch(length, dist);
     }
   }
 
-  void inflateNoCompression(std::vector<uint8_t>& out, const uint8_t* in, size_t& bp, size_t& pos, size_t inlength)
+  void copyMatch(size_t length, size_t dist)
   {
-    while((bp & 0x7) != 0)
-      bp++; // go to first boundary of byte
+    auto dst = m_out.data() + m_pos;
+    auto src = dst - dist;
+    m_pos += length;
 
-    size_t p = bp / 8;
-
-    if(p >= inlength - 4)
+    if(dist == 1)
     {
-      error = 52;
-      return;
-    } // error, bit pointer will jump past memory
-
-    unsigned long LEN = in[p] + 256 * in[p + 1], NLEN = in[p + 2] + 256 * in[p + 3];
-    p += 4;
-
-    if(LEN + NLEN != 65535)
+      memset(dst, *src, length);
+    }
+    else if(dist >= 8)
     {
-      error = 21;
-      return;
-    } // error: NLEN is not one's complement of LEN
+      // 8 bytes at a time: never overlapping, as they're 'dist' apart
+      for(size_t i = 0; i < length; i += 8)
+        memcpy(dst + i, src + i, 8);
+    }
+    else
+    {
+      for(size_t i = 0; i < length; ++i)
+        dst[i] = src[i];
+    }
+  }
 
-    if(pos + LEN >= out.size())
-      out.resize(pos + LEN);
+  void inflateStored(BitReader& bits)
+  {
+    bits.alignToByte();
 
-    if(p + LEN > inlength)
-    {
-      error = 23;
-      return;
-    } // error: reading outside of in buffer
+    auto const header = bits.takeBytes(4);
+    auto const LEN = header.data[0] + 256 * header.data[1];
+    auto const NLEN = header.data[2] + 256 * header.data[3];
 
-    for(unsigned long n = 0; n < LEN; n++)
-      out[pos++] = in[p++]; // read LEN bytes of literal data
+    if(LEN + NLEN != 65535)
+      fail("NLEN is not the one's complement of LEN");
 
-    bp = p * 8;
+    auto const data = bits.takeBytes(LEN);
+    reserve(LEN);
+    memcpy(m_out.data() + m_pos, data.data, LEN);
+    m_pos += LEN;
   }
+
+  vector<uint8_t>& m_out;
+  size_t m_pos = 0;
+
+  HuffmanTable m_litlen, m_dist;
+  HuffmanTable m_fixedLitlen, m_fixedDist;
+  bool m_fixedBuilt = false;
 };
 
-int Zlib_decompress(std::vector<uint8_t>& out, Span<const uint8_t> in_span) // returns error value
+void Zlib_decompress(vector<uint8_t>& out, Span<const uint8_t> in)
 {
-  auto in = std::vector<uint8_t>(in_span.data, in_span.data + in_span.len);
-
-  if(in.size() < 2)
+  if(in.len < 2)
     throw runtime_error("decompress: size of zlib data too small");
 
-  if((in[0] * 256 + in[1]) % 31 != 0)
+  if((in.data[0] * 256 + in.data[1]) % 31 != 0)
     throw runtime_error("decompress: invalid header");
 
-  unsigned long CM = in[0] & 15, CINFO = (in[0] >> 4) & 15, FDICT = (in[1] >> 5) & 1;
+  unsigned long CM = in.data[0] & 15, CINFO = (in.data[0] >> 4) & 15, FDICT = (in.data[1] >> 5) & 1;
 
   if(CM != 8 || CINFO > 7)
     throw runtime_error("decompress: unsupported compression method");
@@ -472,17 +520,20 @@ int Zlib_decompress(std::vector<uint8_t>& out, Span<const uint8_t> in_span) // r
   if(FDICT != 0)
     throw runtime_error("decompress: unsupported preset directory");
 
-  Inflator inflator;
-  inflator.inflate(out, in, 2);
-  return inflator.error; // note: adler32 checksum was skipped and ignored
+  in += 2;
+
+  // note: the adler32 checksum is skipped and ignored
+  Inflator inflator(out);
+  inflator.inflate(in);
 }
 }
 
-using namespace std;
-vector<uint8_t> decompress(Span<const uint8_t> buffer)
+vector<uint8_t> decompress(Span<const uint8_t> buffer, size_t sizeHint)
 {
   vector<uint8_t> r;
+
+  // the slack of 'Inflator::reserve'
+  r.reserve(sizeHint ? sizeHint + 8 : buffer.len * 4);
   Zlib_decompress(r, buffer);
   return r;
 }
-
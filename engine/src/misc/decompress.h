@@ -12,5 +12,7 @@ using namespace std;
 
 #include "base/span.h"
 
-vector<uint8_t> decompress(Span<const uint8_t> buffer);
+// 'sizeHint': the expected size of the output, if known. Saves the
+// reallocations while it grows.
+vector<uint8_t> decompress(Span<const uint8_t> buffer, size_t sizeHint = 0);
 
@@ -6,15 +6,335 @@
 
 #include "file.h"
 
+#include <condition_variable>
 #include <cstdio>
+#include <deque>
+#include <mutex>
 #include <stdexcept>
+#include <vector>
+
+#include "archive.h"
+
+#if defined(__unix__) && !defined(__EMSCRIPTEN__) || defined(__APPLE__)
+#define FILE_HAS_MMAP
+#include <fcntl.h> // open
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+#endif
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/fetch.h>
+#include <emscripten/threading.h>
+#include <cstring> // strcpy
+#endif
 
 using namespace std;
 
+namespace
+{
+#ifdef FILE_HAS_MMAP
+struct SystemMappedFile : MappedFile
+{
+  SystemMappedFile(string const& path)
+  {
+    auto const fd = open(path.c_str(), O_RDONLY);
+
+    if(fd < 0)
+      throw runtime_error("Can't open file '" + path + "' for reading");
+
+    struct stat st;
+
+    if(fstat(fd, &st) != 0)
+    {
+      close(fd);
+      throw runtime_error("Can't get the size of file '" + path + "'");
+    }
+
+    // mmap rejects empty mappings
+    if(st.st_size > 0)
+    {
+      m_address = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      if(m_address == MAP_FAILED)
+      {
+        close(fd);
+        throw runtime_error("Can't map file '" + path + "'");
+      }
+
+      data = { (uint8_t const*)m_address, (int)st.st_size };
+    }
+
+    // the mapping keeps the file open
+    close(fd);
+  }
+
+  ~SystemMappedFile()
+  {
+    if(data.len > 0)
+      munmap(m_address, data.len);
+  }
+
+  void* m_address = nullptr;
+};
+
+// An entry of a mapped archive
+struct SubMappedFile : MappedFile
+{
+  SubMappedFile(shared_ptr<MappedFile> parent, Span<const uint8_t> range)
+    : m_parent(move(parent))
+  {
+    data = range;
+  }
+
+  shared_ptr<MappedFile> const m_parent;
+};
+#endif
+
+// 'size': negative means up to the end
+struct BufferedMappedFile : MappedFile
+{
+  BufferedMappedFile(string const& path, int64_t offset = 0, int64_t size = -1)
+  {
+    FILE* fp = fopen(path.c_str(), "rb");
+
+    if(!fp)
+      throw runtime_error("Can't open file '" + path + "' for reading");
+
+    fseek(fp, 0, SEEK_END);
+    fileSize = ftell(fp);
+
+    if(size < 0)
+      size = fileSize - offset;
+
+    fseek(fp, offset, SEEK_SET);
+    m_buffer.resize(max<int64_t>(0, size));
+
+    auto const read = fread(m_buffer.data(), 1, m_buffer.size(), fp);
+    fclose(fp);
+
+    data = { m_buffer.data(), (int)read };
+  }
+
+  int64_t fileSize = 0;
+  vector<uint8_t> m_buffer;
+};
+
+struct MountedArchive
+{
+  string path;
+  vector<ArchiveEntry> index;
+
+  // null if the platform can't map files: the entries are read one by one
+  shared_ptr<MappedFile> mapping;
+};
+
+struct OnDemandArchive
+{
+  enum State
+  {
+    Remote,
+    Fetching,
+    Local, // fetched, not mounted yet
+    Mounted,
+    Failed,
+  };
+
+  string path;
+  vector<string> prefixes;
+  State state = Remote;
+  int64_t received = 0;
+  int64_t total = 0;
+};
+
+// The archives are mounted on any thread: the pointers to them must stay
+// valid, hence the deque.
+mutex g_lock;
+condition_variable g_fetched;
+deque<MountedArchive> g_archives;
+vector<unique_ptr<OnDemandArchive>> g_onDemand;
+
+ArchiveEntry const* findInMounted(string const& path, MountedArchive const*& archive)
+{
+  for(auto& a : g_archives)
+  {
+    if(auto entry = findArchiveEntry(a.index, path))
+    {
+      archive = &a;
+      return entry;
+    }
+  }
+
+  return nullptr;
+}
+
+OnDemandArchive* findOnDemand(string const& path)
+{
+  for(auto& a : g_onDemand)
+    for(auto& prefix : a->prefixes)
+      if(path.compare(0, prefix.size(), prefix) == 0)
+        return a.get();
+
+  return nullptr;
+}
+
+bool existsOnDisk(string const& path)
+{
+  FILE* fp = fopen(path.c_str(), "rb");
+
+  if(!fp)
+    return false;
+
+  fclose(fp);
+  return true;
+}
+
+void mountLocked(string archivePath);
+
+#ifdef __EMSCRIPTEN__
+// main thread: the callbacks come from its event loop
+void startFetch(OnDemandArchive* archive)
+{
+  emscripten_fetch_attr_t attr;
+  emscripten_fetch_attr_init(&attr);
+  strcpy(attr.requestMethod, "GET");
+  attr.attributes = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY;
+  attr.userData = archive;
+
+  attr.onprogress = [] (emscripten_fetch_t* fetch)
+    {
+      auto a = (OnDemandArchive*)fetch->userData;
+      lock_guard<mutex> guard(g_lock);
+      a->received = fetch->dataOffset + fetch->numBytes;
+      a->total = fetch->totalBytes;
+    };
+
+  attr.onsuccess = [] (emscripten_fetch_t* fetch)
+    {
+      auto a = (OnDemandArchive*)fetch->userData;
+      File::write(a->path, { (uint8_t const*)fetch->data, (int)fetch->numBytes });
+      emscripten_fetch_close(fetch);
+
+      lock_guard<mutex> guard(g_lock);
+      a->state = OnDemandArchive::Local;
+      g_fetched.notify_all();
+    };
+
+  attr.onerror = [] (emscripten_fetch_t* fetch)
+    {
+      auto a = (OnDemandArchive*)fetch->userData;
+      printf("[file] can't fetch '%s': HTTP %d\n", a->path.c_str(), fetch->status);
+      emscripten_fetch_close(fetch);
+
+      lock_guard<mutex> guard(g_lock);
+      a->state = OnDemandArchive::Failed;
+      g_fetched.notify_all();
+    };
+
+  emscripten_fetch(&attr, archive->path.c_str());
+}
+#endif
+
+// Starts fetching 'archive', if it's not already on its way.
+// Called with 'g_lock' held.
+void startFetchLocked(OnDemandArchive& archive)
+{
+  if(archive.state != OnDemandArchive::Remote)
+    return;
+
+#ifdef __EMSCRIPTEN__
+  archive.state = OnDemandArchive::Fetching;
+  archive.received = 0;
+  archive.total = 0;
+
+#ifdef __EMSCRIPTEN_PTHREADS__
+
+  if(!emscripten_is_main_runtime_thread())
+  {
+    emscripten_async_run_in_main_runtime_thread(EM_FUNC_SIG_VI, (void*)&startFetch, &archive);
+    return;
+  }
+
+#endif
+
+  startFetch(&archive);
+#else
+  // nowhere to fetch it from
+  archive.state = existsOnDisk(archive.path) ? OnDemandArchive::Local : OnDemandArchive::Failed;
+#endif
+}
+
+// Returns false if 'archive' can't be mounted
+bool waitForArchive(OnDemandArchive& archive)
+{
+  unique_lock<mutex> lock(g_lock);
+
+  startFetchLocked(archive);
+
+  if(archive.state == OnDemandArchive::Fetching)
+  {
+#ifdef __EMSCRIPTEN__
+
+    if(emscripten_is_main_runtime_thread())
+      throw runtime_error("'" + archive.path + "' isn't fetched yet");
+
+#endif
+
+    g_fetched.wait(lock, [&] () { return archive.state != OnDemandArchive::Fetching; });
+  }
+
+  if(archive.state == OnDemandArchive::Local)
+  {
+    mountLocked(archive.path);
+    archive.state = OnDemandArchive::Mounted;
+  }
+
+  return archive.state == OnDemandArchive::Mounted;
+}
+
+// nullptr if 'path' isn't in any mounted archive, nor on-demand one
+ArchiveEntry const* findInArchives(string const& path, MountedArchive const*& archive)
+{
+  OnDemandArchive* onDemand;
+
+  {
+    lock_guard<mutex> guard(g_lock);
+
+    if(auto entry = findInMounted(path, archive))
+      return entry;
+
+    onDemand = findOnDemand(path);
+  }
+
+  if(!onDemand || !waitForArchive(*onDemand))
+    return nullptr;
+
+  lock_guard<mutex> guard(g_lock);
+  return findInMounted(path, archive);
+}
+
+unique_ptr<MappedFile> mapLooseFile(string const& path)
+{
+#ifdef FILE_HAS_MMAP
+  return make_unique<SystemMappedFile>(path);
+#else
+  return make_unique<BufferedMappedFile>(path);
+#endif
+}
+}
+
 namespace File
 {
 string read(string path)
 {
+  MountedArchive const* archive;
+
+  if(findInArchives(path, archive))
+  {
+    auto const file = map(path);
+    return string((char const*)file->data.data, file->data.len);
+  }
+
   FILE* fp = fopen(path.c_str(), "rb");
 
   if(!fp)
@@ -47,13 +367,105 @@ void write(string path, Span<const uint8_t> data)
 
 bool exists(string path)
 {
-  FILE* fp = fopen(path.c_str(), "rb");
+  MountedArchive const* archive;
 
-  if(!fp)
-    return false;
+  if(findInArchives(path, archive))
+    return true;
 
-  fclose(fp);
-  return true;
+  return existsOnDisk(path);
 }
+
+unique_ptr<MappedFile> map(string path)
+{
+  MountedArchive const* archive;
+
+  if(auto entry = findInArchives(path, archive))
+  {
+#ifdef FILE_HAS_MMAP
+    auto const& all = archive->mapping->data;
+    return make_unique<SubMappedFile>(archive->mapping, Span<const uint8_t>(all.data + entry->offset, (int)entry->size));
+#else
+    return make_unique<BufferedMappedFile>(archive->path, entry->offset, entry->size);
+#endif
+  }
+
+  return mapLooseFile(path);
 }
 
+void mount(string archivePath)
+{
+  lock_guard<mutex> guard(g_lock);
+  mountLocked(archivePath);
+}
+
+void unmountAll()
+{
+  lock_guard<mutex> guard(g_lock);
+  g_archives.clear();
+  g_onDemand.clear();
+}
+
+void mountOnDemand(string archivePath, vector<string> prefixes)
+{
+  auto archive = make_unique<OnDemandArchive>();
+  archive->path = archivePath;
+  archive->prefixes = move(prefixes);
+
+  lock_guard<mutex> guard(g_lock);
+  g_onDemand.push_back(move(archive));
+}
+
+bool prefetch(string path)
+{
+  lock_guard<mutex> guard(g_lock);
+
+  auto archive = findOnDemand(path);
+
+  if(!archive)
+    return true;
+
+  startFetchLocked(*archive);
+
+  return archive->state != OnDemandArchive::Fetching;
+}
+
+FetchProgress getFetchProgress()
+{
+  lock_guard<mutex> guard(g_lock);
+
+  FetchProgress r;
+
+  for(auto& a : g_onDemand)
+  {
+    if(a->state != OnDemandArchive::Fetching)
+      continue;
+
+    r.received += a->received;
+    r.total += a->total;
+  }
+
+  return r;
+}
+}
+
+namespace
+{
+// Called with 'g_lock' held
+void mountLocked(string archivePath)
+{
+  MountedArchive archive;
+  archive.path = archivePath;
+
+#ifdef FILE_HAS_MMAP
+  archive.mapping = mapLooseFile(archivePath);
+  archive.index = parseArchiveIndex(archive.mapping->data, archive.mapping->data.len);
+#else
+  // only the index is read now
+  auto const count = parseArchiveHeader(BufferedMappedFile(archivePath, 0, ARCHIVE_HEADER_SIZE).data);
+  BufferedMappedFile indexFile(archivePath, 0, ARCHIVE_HEADER_SIZE + count * sizeof(ArchiveEntry));
+  archive.index = parseArchiveIndex(indexFile.data, indexFile.fileSize);
+#endif
+
+  g_archives.push_back(move(archive));
+}
+}
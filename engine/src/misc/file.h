@@ -7,13 +7,56 @@
 #pragma once
 
 #include "base/span.h"
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 using namespace std;
 
+// The contents of a file, read-only. 'data' stays valid as long as the
+// mapping lives.
+struct MappedFile
+{
+  virtual ~MappedFile() = default;
+  Span<const uint8_t> data;
+};
+
+// The files are looked up in the mounted archives first (see 'archive.h'),
+// then on disk: loose files still work during development.
 namespace File
 {
 string read(string path);
 void write(string path, Span<const uint8_t> data);
 bool exists(string path);
+
+// Without copying the file into memory, where the platform allows it.
+// Else, it's read at once.
+unique_ptr<MappedFile> map(string path);
+
+// To be called before any loading starts.
+// Throws if 'archivePath' isn't a valid archive.
+void mount(string archivePath);
+void unmountAll();
+
+// An archive mounted the first time a file under one of 'prefixes' is
+// needed (e.g a room of the web version). It's fetched first, on the web.
+// Natively, it's only mounted if it exists.
+// Its files must not be in the other archives.
+void mountOnDemand(string archivePath, vector<string> prefixes);
+
+// Starts fetching the on-demand archive 'path' belongs to, if needed.
+// Returns true if 'path' can be read without waiting.
+// Else, reading it waits for the fetch, and throws on the main thread of
+// the web version (it can't wait there).
+bool prefetch(string path);
+
+struct FetchProgress
+{
+  int64_t received = 0;
+  int64_t total = 0; // zero: nothing being fetched
+};
+
+// Over the on-demand archives being fetched
+FetchProgress getFetchProgress();
 }
 
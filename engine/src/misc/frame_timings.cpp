@@ -0,0 +1,115 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Frame timings ring buffer
+
+#include "frame_timings.h"
+
+#include <algorithm>
+#include <cmath> // ceil
+#include <cstdio> // snprintf
+#include <stdexcept>
+
+char const* FrameTimings::getStageName(int stage)
+{
+  static char const* const names[StageCount] =
+  {
+    "input",
+    "simulation",
+    "scene_draw",
+    "submit",
+    "swap",
+    "total",
+  };
+
+  if(stage < 0 || stage >= StageCount)
+    throw runtime_error("Invalid frame stage");
+
+  return names[stage];
+}
+
+FrameTimings::FrameTimings(int capacity)
+{
+  if(capacity <= 0)
+    throw runtime_error("Invalid frame timings capacity");
+
+  m_samples.resize(capacity);
+}
+
+void FrameTimings::push(Sample const& sample)
+{
+  m_samples[m_next] = sample;
+  m_next = (m_next + 1) % (int)m_samples.size();
+  m_count = min(m_count + 1, (int)m_samples.size());
+}
+
+int FrameTimings::size() const
+{
+  return m_count;
+}
+
+FrameTimings::Sample const& FrameTimings::get(int i) const
+{
+  auto const N = (int)m_samples.size();
+  return m_samples[(m_next - m_count + i + N) % N];
+}
+
+FrameTimings::Stats FrameTimings::getStats(int stage) const
+{
+  Stats r;
+
+  if(m_count == 0)
+    return r;
+
+  vector<float> values(m_count);
+
+  for(int i = 0; i < m_count; ++i)
+    values[i] = get(i).ms[stage];
+
+  sort(values.begin(), values.end());
+
+  // nearest rank
+  auto percentile = [&] (double p)
+    {
+      auto const rank = (int)ceil(p * m_count);
+      return values[max(0, rank - 1)];
+    };
+
+  r.p50 = percentile(0.50);
+  r.p95 = percentile(0.95);
+  r.p99 = percentile(0.99);
+  r.max = values.back();
+  return r;
+}
+
+string FrameTimings::toCsv() const
+{
+  string r;
+
+  for(int stage = 0; stage < StageCount; ++stage)
+  {
+    r += stage ? "," : "";
+    r += getStageName(stage);
+  }
+
+  r += "\n";
+
+  for(int i = 0; i < m_count; ++i)
+  {
+    auto& sample = get(i);
+
+    for(int stage = 0; stage < StageCount; ++stage)
+    {
+      char buf[32];
+      snprintf(buf, sizeof buf, "%s%.3f", stage ? "," : "", sample.ms[stage]);
+      r += buf;
+    }
+
+    r += "\n";
+  }
+
+  return r;
+}
@@ -0,0 +1,64 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Durations of the stages of the last frames, and their percentiles.
+// (the stutters an average frame rate hides)
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct FrameTimings
+{
+  enum Stage
+  {
+    Input,
+    Simulation,
+    SceneDraw,
+    Submit, // includes waiting for the render thread
+    Swap,
+    Total, // from the start of the previous frame
+    StageCount,
+  };
+
+  static char const* getStageName(int stage);
+
+  // in ms
+  struct Sample
+  {
+    float ms[StageCount] {};
+  };
+
+  struct Stats
+  {
+    float p50 = 0;
+    float p95 = 0;
+    float p99 = 0;
+    float max = 0;
+  };
+
+  // keeps the last 'capacity' frames
+  explicit FrameTimings(int capacity = 1000);
+
+  void push(Sample const& sample);
+
+  int size() const;
+  Stats getStats(int stage) const;
+
+  // one line per frame, oldest first, with a header line
+  string toCsv() const;
+
+private:
+  vector<Sample> m_samples; // ring buffer
+  int m_next = 0;
+  int m_count = 0;
+
+  // oldest first
+  Sample const& get(int i) const;
+};
@@ -0,0 +1,222 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Video frame writer thread
+
+#include "frame_writer.h"
+
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring> // memcpy
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+auto const PIPE_MODE = "wb";
+#else
+auto const PIPE_MODE = "w"; // always binary
+#endif
+
+namespace
+{
+// frames waiting to be written: beyond, the disk (or the encoder) can't
+// keep up, and the new frames are dropped
+auto const MAX_PENDING = 8;
+
+struct Frame
+{
+  vector<uint8_t> pixels;
+  int width;
+};
+
+// returns false on failure
+bool writeFlipped(FILE* fp, Frame const& frame)
+{
+  auto const rowSize = (size_t)frame.width * 4;
+
+  if(rowSize == 0)
+    return true;
+
+  auto const height = frame.pixels.size() / rowSize;
+
+  for(auto row = height; row > 0; --row)
+    if(fwrite(frame.pixels.data() + (row - 1) * rowSize, 1, rowSize, fp) != rowSize)
+      return false;
+
+  return true;
+}
+}
+
+struct FrameWriter::Impl
+{
+  Impl(string target, bool pipeToCommand) : isPipe(pipeToCommand)
+  {
+    if(isPipe)
+    {
+#ifdef SIGPIPE
+      // an encoder quitting early must not kill us: fwrite fails instead
+      signal(SIGPIPE, SIG_IGN);
+#endif
+      fp = popen(target.c_str(), PIPE_MODE);
+    }
+    else
+    {
+      fp = fopen(target.c_str(), "wb");
+    }
+
+    if(!fp)
+      throw runtime_error("Can't open '" + target + "' for writing");
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+    writer = thread([this] () { writerMain(); });
+#endif
+  }
+
+  ~Impl()
+  {
+    {
+      lock_guard<mutex> guard(lock);
+      quit = true;
+    }
+
+    changed.notify_all();
+
+    if(writer.joinable())
+      writer.join();
+
+    if(isPipe)
+      pclose(fp);
+    else
+      fclose(fp);
+  }
+
+  bool push(Span<const uint8_t> pixels, int width)
+  {
+    Frame frame;
+
+    {
+      lock_guard<mutex> guard(lock);
+
+      if(failed || (int)pending.size() >= MAX_PENDING)
+      {
+        dropped++;
+        return false;
+      }
+
+      // reuse the buffer of an already written frame
+      if(!recycled.empty())
+      {
+        frame.pixels = move(recycled.back());
+        recycled.pop_back();
+      }
+    }
+
+    frame.pixels.resize(pixels.len);
+    memcpy(frame.pixels.data(), pixels.data, pixels.len);
+    frame.width = width;
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    // no threads in the browser
+    write(frame);
+#else
+    {
+      lock_guard<mutex> guard(lock);
+      pending.push_back(move(frame));
+    }
+
+    changed.notify_all();
+#endif
+
+    return true;
+  }
+
+  void writerMain()
+  {
+    while(1)
+    {
+      Frame frame;
+
+      {
+        unique_lock<mutex> guard(lock);
+        changed.wait(guard, [&] () { return quit || !pending.empty(); });
+
+        // the pending frames are written before quitting
+        if(pending.empty())
+          return;
+
+        frame = move(pending.front());
+        pending.pop_front();
+      }
+
+      write(frame);
+
+      {
+        lock_guard<mutex> guard(lock);
+        recycled.push_back(move(frame.pixels));
+      }
+    }
+  }
+
+  void write(Frame const& frame)
+  {
+    // only this thread sets 'failed'
+    auto const ok = !failed && writeFlipped(fp, frame);
+
+    lock_guard<mutex> guard(lock);
+
+    if(ok)
+    {
+      written++;
+    }
+    else
+    {
+      failed = true;
+      dropped++;
+    }
+  }
+
+  FILE* fp = nullptr;
+  bool const isPipe;
+  thread writer;
+
+  mutable mutex lock;
+  condition_variable changed; // 'pending' or 'quit'
+  deque<Frame> pending;
+  vector<vector<uint8_t>> recycled;
+  bool quit = false;
+  bool failed = false; // no more frames are written
+  int written = 0;
+  int dropped = 0;
+};
+
+FrameWriter::FrameWriter(string target, bool pipeToCommand) : m_impl(new Impl(target, pipeToCommand))
+{
+}
+
+FrameWriter::~FrameWriter() = default;
+
+bool FrameWriter::push(Span<const uint8_t> pixels, int width)
+{
+  return m_impl->push(pixels, width);
+}
+
+int FrameWriter::getWrittenCount() const
+{
+  lock_guard<mutex> guard(m_impl->lock);
+  return m_impl->written;
+}
+
+int FrameWriter::getDroppedCount() const
+{
+  lock_guard<mutex> guard(m_impl->lock);
+  return m_impl->dropped;
+}
@@ -0,0 +1,44 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Raw RGBA video stream, written from a thread of its own: to a file, or
+// to the standard input of an encoder process (e.g ffmpeg).
+// The frames come as read back from the GPU, bottom row first: they're
+// written top row first.
+
+#pragma once
+
+#include "base/span.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+struct FrameWriter
+{
+  // With 'pipeToCommand', 'target' is a shell command line, run with the
+  // frames as standard input. Otherwise it's the path of the file.
+  // Throws if it can't be opened.
+  explicit FrameWriter(string target, bool pipeToCommand = false);
+
+  // Writes the pending frames, then closes the file.
+  // (waits for the command to exit)
+  ~FrameWriter();
+
+  // Queues a copy of 'pixels'. Never blocks: the frame is dropped if too
+  // many are already waiting, or if writing failed (e.g the encoder quit).
+  // Returns false if dropped.
+  bool push(Span<const uint8_t> pixels, int width);
+
+  int getWrittenCount() const;
+  int getDroppedCount() const;
+
+  struct Impl;
+
+private:
+  unique_ptr<Impl> m_impl;
+};
@@ -7,22 +7,87 @@
 // Simplistic standalone JSON-parser
 
 #include "json.h"
+#include <algorithm> // stable_sort, lower_bound
+#include <cstring> // memcmp, memcpy
+#include <ostream>
 #include <stdexcept>
 
 namespace json
 {
+bool operator == (String a, String b)
+{
+  return a.len == b.len && (a.len == 0 || memcmp(a.data, b.data, a.len) == 0);
+}
+
+bool operator == (String a, const char* b)
+{
+  return a == String { b, strlen(b) };
+}
+
+bool operator == (const char* a, String b)
+{
+  return b == a;
+}
+
+bool operator < (String a, String b)
+{
+  auto const cmp = min(a.len, b.len) ? memcmp(a.data, b.data, min(a.len, b.len)) : 0;
+  return cmp < 0 || (cmp == 0 && a.len < b.len);
+}
+
+ostream& operator << (ostream& o, String s)
+{
+  return o.write(s.data, s.len);
+}
+
+const Value* Members::find(String name) const
+{
+  auto it = lower_bound(begin(), end(), name, [] (Member const& m, String n) { return m.name < n; });
+
+  if(it == end() || !(it->name == name))
+    return nullptr;
+
+  return &it->value;
+}
+
+Value const& Members::operator [] (const char* name) const
+{
+  auto value = find({ name, strlen(name) });
+
+  if(!value)
+    throw runtime_error("Member '" + string(name) + "' was not found");
+
+  return *value;
+}
+
 Value const& Value::operator [] (const char* name) const
 {
   enforceType(Type::Object);
-  auto it = members.find(name);
+  return members[name];
+}
 
-  if(it == members.end())
-    throw runtime_error("Member '" + string(name) + "' was not found");
+void* Arena::allocate(size_t bytes)
+{
+  bytes = (bytes + 7) & ~size_t(7);
 
-  return it->second;
+  if(m_blocks.empty() || m_used + bytes > m_blockSize)
+  {
+    // each block twice as big as the previous one: few of them
+    m_blockSize = max(max(m_blockSize * 2, size_t(4096)), bytes);
+    m_blocks.push_back(unique_ptr<uint8_t[]>(new uint8_t[m_blockSize]));
+    m_used = 0;
+  }
+
+  auto r = m_blocks.back().get() + m_used;
+  m_used += bytes;
+  return r;
 }
 }
 
+using namespace json;
+
+namespace
+{
 struct Token
 {
   enum Type
@@ -39,8 +104,9 @@ struct Token
     COMMA,
   };
 
-  string lexem;
+  String lexem; // into the text. Without the quotes, for strings.
   Type type;
+  bool escaped = false; // a string with backslashes in it
 };
 
 class Tokenizer
@@ -63,60 +129,61 @@ private:
     while(whitespace(frontChar()))
       ++text;
 
-    curr.lexem = "";
+    auto const start = text;
+    curr.escaped = false;
+
     switch(frontChar())
     {
     case '\0':
       curr.type = Token::EOF_;
       break;
     case '[':
-      accept();
+      ++text;
       curr.type = Token::LBRACKET;
       break;
     case ']':
-      accept();
+      ++text;
       curr.type = Token::RBRACKET;
       break;
     case '{':
-      accept();
+      ++text;
       curr.type = Token::LBRACE;
       break;
     case '}':
-      accept();
+      ++text;
       curr.type = Token::RBRACE;
       break;
     case ':':
-      accept();
+      ++text;
       curr.type = Token::COLON;
       break;
     case ',':
-      accept();
+      ++text;
       curr.type = Token::COMMA;
       break;
     case '"':
-      accept();
+      ++text;
 
       while(frontChar() != '"' && frontChar() != '\0')
       {
         if(frontChar() == '\\')
         {
-          accept();
-          curr.lexem.pop_back();
-
           // escape sequence
-          accept();
-        }
-        else
-        {
-          accept();
+          curr.escaped = true;
+          ++text;
         }
+
+        if(frontChar() != '\0')
+          ++text;
       }
 
-      accept();
+      if(frontChar() != '"')
+        throw runtime_error("Unterminated string");
 
       curr.type = Token::STRING;
-      curr.lexem = curr.lexem.substr(1, curr.lexem.size() - 2);
-      break;
+      curr.lexem = { start + 1, size_t(text - start - 1) };
+      ++text;
+      return;
     case 't':
       curr.type = Token::BOOLEAN;
       expect('t');
@@ -149,10 +216,10 @@ private:
         curr.type = Token::NUMBER;
 
         if(frontChar() == '-')
-          accept();
+          ++text;
 
         while(isdigit(frontChar()))
-          accept();
+          ++text;
 
         break;
       }
@@ -164,6 +231,8 @@ private:
         throw runtime_error(msg);
       }
     }
+
+    curr.lexem = { start, size_t(text - start) };
   }
 
   void expect(char c)
@@ -171,12 +240,6 @@ private:
     if(frontChar() != c)
       throw runtime_error("Unexpected character");
 
-    accept();
-  }
-
-  void accept()
-  {
-    curr.lexem += frontChar();
     ++text;
   }
 
@@ -198,96 +261,168 @@ private:
   Token curr;
 };
 
-using namespace json;
+// The members and elements of the objects and arrays being parsed pile up
+// here, then move to the arena once their container is complete:
+// the arena only gets arrays of their final size.
+struct Parser
+{
+  Tokenizer tk;
+  Arena& arena;
+  vector<Member> members;
+  vector<Value> elements;
+
+  Value parseObject();
+  Value parseValue();
+  Value parseArray();
+  String parseString();
+  Token expect(Token::Type type);
+
+  template<typename T>
+  T* copyToArena(T const* first, size_t count)
+  {
+    if(count == 0)
+      return nullptr;
 
-static Value parseObject(Tokenizer& tk);
-static Value parseValue(Tokenizer& tk);
-static Value parseArray(Tokenizer& tk);
-static string expect(Tokenizer& tk, Token::Type type);
+    auto r = (T*)arena.allocate(count * sizeof(T));
+    memcpy(r, first, count * sizeof(T));
+    return r;
+  }
+};
 
-Value json::parse(const char* text, size_t len)
+Value makeValue(Value::Type type)
 {
-  Tokenizer tokenizer(text, len);
-  return parseObject(tokenizer);
+  Value r;
+  r.type = type;
+  return r;
 }
 
-Value parseObject(Tokenizer& tk)
+Value Parser::parseObject()
 {
-  Value r;
-  r.type = Value::Type::Object;
-  expect(tk, Token::LBRACE);
-  int idx = 0;
+  auto r = makeValue(Value::Type::Object);
+  expect(Token::LBRACE);
+  auto const first = members.size();
 
   while(tk.front().type != Token::RBRACE)
   {
-    if(idx > 0)
-      expect(tk, Token::COMMA);
+    if(members.size() > first)
+      expect(Token::COMMA);
+
+    Member m;
+    m.name = parseString();
+    expect(Token::COLON);
+    m.value = parseValue();
+    members.push_back(m);
+  }
+
+  expect(Token::RBRACE);
+
+  auto const begin = members.begin() + first;
+  stable_sort(begin, members.end(), [] (Member const& a, Member const& b) { return a.name < b.name; });
 
-    auto const name = expect(tk, Token::STRING);
-    expect(tk, Token::COLON);
-    r.members[name] = parseValue(tk);
-    ++idx;
+  // the last of the duplicates wins
+  auto last = begin;
+
+  for(auto it = begin; it != members.end(); ++it)
+  {
+    if(it + 1 != members.end() && it->name == (it + 1)->name)
+      continue;
+
+    *last++ = *it;
   }
 
-  expect(tk, Token::RBRACE);
+  members.erase(last, members.end());
+
+  r.members.count = members.size() - first;
+  r.members.data = copyToArena(members.data() + first, r.members.count);
+  members.resize(first);
   return r;
 }
 
-Value parseValue(Tokenizer& tk)
+Value Parser::parseValue()
 {
   if(tk.front().type == Token::LBRACKET)
   {
-    return parseArray(tk);
+    return parseArray();
   }
   else if(tk.front().type == Token::LBRACE)
   {
-    return parseObject(tk);
+    return parseObject();
   }
   else if(tk.front().type == Token::BOOLEAN)
   {
-    Value r;
-    r.type = Value::Type::Boolean;
-    r.boolValue = expect(tk, Token::BOOLEAN) == "true";
+    auto r = makeValue(Value::Type::Boolean);
+    r.boolValue = expect(Token::BOOLEAN).lexem == "true";
     return r;
   }
   else if(tk.front().type == Token::NUMBER)
   {
-    Value r;
-    r.type = Value::Type::Integer;
-    r.intValue = atoi(expect(tk, Token::NUMBER).c_str());
+    auto r = makeValue(Value::Type::Integer);
+    auto const lexem = expect(Token::NUMBER).lexem;
+    auto const negative = lexem.data[0] == '-';
+
+    for(size_t i = negative ? 1 : 0; i < lexem.len; ++i)
+      r.intValue = r.intValue * 10 + (lexem.data[i] - '0');
+
+    if(negative)
+      r.intValue = -r.intValue;
+
     return r;
   }
   else
   {
-    Value r;
-    r.type = Value::Type::String;
-    r.stringValue = expect(tk, Token::STRING);
+    auto r = makeValue(Value::Type::String);
+    r.stringValue = parseString();
     return r;
   }
 }
 
-Value parseArray(Tokenizer& tk)
+Value Parser::parseArray()
 {
-  Value r;
-  r.type = Value::Type::Array;
-  expect(tk, Token::LBRACKET);
-  int idx = 0;
+  auto r = makeValue(Value::Type::Array);
+  expect(Token::LBRACKET);
+  auto const first = elements.size();
 
   while(tk.front().type != Token::RBRACKET)
   {
-    if(idx > 0)
-      expect(tk, Token::COMMA);
+    if(elements.size() > first)
+      expect(Token::COMMA);
 
-    r.elements.push_back(parseValue(tk));
-    ++idx;
+    auto value = parseValue();
+    elements.push_back(value);
   }
 
-  expect(tk, Token::RBRACKET);
+  expect(Token::RBRACKET);
+
+  r.elements.count = elements.size() - first;
+  r.elements.data = copyToArena(elements.data() + first, r.elements.count);
+  elements.resize(first);
   return r;
 }
 
-static
-string expect(Tokenizer& tk, Token::Type type)
+// Points into the text, unless there are escape sequences: those strings
+// are copied to the arena without their backslashes.
+String Parser::parseString()
+{
+  auto const token = expect(Token::STRING);
+
+  if(!token.escaped)
+    return token.lexem;
+
+  auto const dst = (char*)arena.allocate(token.lexem.len);
+  size_t len = 0;
+
+  for(size_t i = 0; i < token.lexem.len; ++i)
+  {
+    if(token.lexem.data[i] == '\\')
+      ++i;
+
+    dst[len++] = token.lexem.data[i];
+  }
+
+  return { dst, len };
+}
+
+Token Parser::expect(Token::Type type)
 {
   auto front = tk.front();
 
@@ -299,7 +434,7 @@ string expect(Tokenizer& tk, Token::Type type)
       msg += "Unexpected end of file found";
     else
     {
-      msg += "Unexpected token '" + front.lexem + "'";
+      msg += "Unexpected token '" + string(front.lexem) + "'";
       msg += " of type " + to_string(front.type);
       msg += " instead of " + to_string(type);
     }
@@ -307,8 +442,15 @@ string expect(Tokenizer& tk, Token::Type type)
     throw runtime_error(msg);
   }
 
-  string r = front.lexem;
   tk.popFront();
-  return r;
+  return front;
+}
 }
 
+Document json::parse(const char* text, size_t len)
+{
+  Document r;
+  Parser parser { Tokenizer(text, len), r.arena, {}, {} };
+  static_cast<Value&>(r) = parser.parseObject();
+  return r;
+}
@@ -4,11 +4,16 @@
 // published by the Free Software Foundation, either version 3 of the
 // License, or (at your option) any later version.
 
-// Simplistic standalone JSON-parser
+// Simplistic standalone JSON-parser.
+// In situ: the strings point into the parsed text, the values live in
+// the arena of their document.
 
 #pragma once
 
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -16,6 +21,51 @@ using namespace std;
 
 namespace json
 {
+// Not NUL-terminated
+struct String
+{
+  const char* data = nullptr;
+  size_t len = 0;
+
+  operator string () const { return string(data, len); }
+};
+
+bool operator == (String a, String b);
+bool operator == (String a, const char* b);
+bool operator == (const char* a, String b);
+bool operator < (String a, String b);
+ostream& operator << (ostream& o, String s);
+
+struct Value;
+struct Member;
+
+// Sorted by name
+struct Members
+{
+  const Member* data = nullptr;
+  size_t count = 0;
+
+  size_t size() const { return count; }
+  const Member* begin() const { return data; }
+  const Member* end() const;
+
+  // null if there's no member 'name'
+  const Value* find(String name) const;
+
+  Value const& operator [] (const char* name) const;
+};
+
+struct Elements
+{
+  const Value* data = nullptr;
+  size_t count = 0;
+
+  size_t size() const { return count; }
+  const Value* begin() const { return data; }
+  const Value* end() const;
+  Value const& operator [] (size_t i) const;
+};
+
 struct Value
 {
   enum class Type
@@ -31,7 +81,7 @@ struct Value
 
   ////////////////////////////////////////
   // type == Type::String
-  string stringValue;
+  String stringValue;
 
   operator string () const
   {
@@ -41,19 +91,15 @@ struct Value
 
   ////////////////////////////////////////
   // type == Type::Object
-  map<string, Value> members;
+  Members members;
 
   Value const& operator [] (const char* name) const;
 
   ////////////////////////////////////////
   // type == Type::Array
-  vector<Value> elements;
+  Elements elements;
 
-  Value const& operator [] (int i)
-  {
-    enforceType(Type::Array);
-    return elements[i];
-  }
+  Value const& operator [] (int i) const;
 
   ////////////////////////////////////////
   // type == Type::Boolean
@@ -77,6 +123,40 @@ private:
   }
 };
 
-Value parse(const char* text, size_t len);
+struct Member
+{
+  String name;
+  Value value;
+};
+
+inline const Member* Members::end() const { return data + count; }
+inline const Value* Elements::end() const { return data + count; }
+inline Value const& Elements::operator [] (size_t i) const { return data[i]; }
+
+inline Value const& Value::operator [] (int i) const
+{
+  enforceType(Type::Array);
+  return elements[i];
+}
+
+// Bump allocator: the memory of a document, freed all at once
+struct Arena
+{
+  void* allocate(size_t bytes);
+
+private:
+  vector<unique_ptr<uint8_t[]>> m_blocks;
+  size_t m_used = 0;
+  size_t m_blockSize = 0;
+};
+
+// The root object, and the memory of the values below it.
+// Its strings point into the parsed text, which must outlive it.
+struct Document : Value
+{
+  Arena arena;
+};
+
+Document parse(const char* text, size_t len);
 }
 
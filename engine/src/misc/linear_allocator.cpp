@@ -0,0 +1,103 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Bump allocator, over a few chunks
+
+#include "base/linear_allocator.h"
+
+#include <algorithm> // max
+#include <cstdarg>
+#include <cstdio> // vsnprintf
+#include <cstring> // memcpy, strlen
+
+LinearAllocator::LinearAllocator(int chunkSize) : m_chunkSize(chunkSize)
+{
+}
+
+void* LinearAllocator::allocate(int size, int align)
+{
+  if(!m_chunks.empty())
+  {
+    auto& chunk = m_chunks.back();
+    auto const pos = (m_used + align - 1) / align * align;
+
+    if(pos + size <= chunk.size)
+    {
+      m_used = pos + size;
+      return chunk.data.get() + pos;
+    }
+  }
+
+  // 'new' aligns on 'max_align_t'
+  addChunk(size);
+  m_used = size;
+  return m_chunks.back().data.get();
+}
+
+char const* LinearAllocator::copy(char const* s)
+{
+  return copy(s, (int)strlen(s));
+}
+
+char const* LinearAllocator::copy(char const* s, int len)
+{
+  auto r = allocate<char>(len + 1);
+  memcpy(r, s, len);
+  r[len] = 0;
+  return r;
+}
+
+char const* LinearAllocator::format(char const* fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+
+  va_list measured;
+  va_copy(measured, args);
+  auto const len = vsnprintf(nullptr, 0, fmt, measured);
+  va_end(measured);
+
+  auto r = allocate<char>(max(0, len) + 1);
+  vsnprintf(r, max(0, len) + 1, fmt, args);
+  va_end(args);
+
+  return r;
+}
+
+void LinearAllocator::reset()
+{
+  if(m_chunks.size() > 1)
+  {
+    int total = 0;
+
+    for(auto& chunk : m_chunks)
+      total += chunk.size;
+
+    m_chunks.clear();
+    addChunk(total);
+  }
+
+  m_used = 0;
+}
+
+void LinearAllocator::addChunk(int minSize)
+{
+  auto size = m_chunkSize;
+
+  if(!m_chunks.empty())
+    size = m_chunks.back().size * 2;
+
+  size = max(size, minSize);
+
+  m_chunks.push_back({ unique_ptr<uint8_t[]>(new uint8_t[size]), size });
+
+  int64_t capacity = 0;
+
+  for(auto& chunk : m_chunks)
+    capacity += chunk.size;
+
+  m_capacity.set(capacity);
+}
@@ -0,0 +1,165 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Memory accounting, per subsystem: one pair of counters per tag.
+
+#include "base/memory.h"
+
+#include <atomic>
+#include <cstdio> // snprintf
+
+#ifdef __EMSCRIPTEN__
+#include <emscripten/heap.h>
+#include <malloc.h> // mallinfo
+#endif
+
+namespace
+{
+auto const TAG_COUNT = (int)MemoryTag::Count;
+
+struct Counter
+{
+  atomic<int64_t> bytes { 0 };
+  atomic<int64_t> peak { 0 };
+};
+
+Counter g_counters[TAG_COUNT];
+
+bool isGpu(MemoryTag tag)
+{
+  return tag >= MemoryTag::GpuTextures;
+}
+
+double toMegabytes(int64_t bytes)
+{
+  return bytes / (1024.0 * 1024.0);
+}
+}
+
+void trackMemory(MemoryTag tag, int64_t bytes)
+{
+  auto& counter = g_counters[(int)tag];
+  auto const now = counter.bytes.fetch_add(bytes, memory_order_relaxed) + bytes;
+
+  auto peak = counter.peak.load(memory_order_relaxed);
+
+  while(now > peak && !counter.peak.compare_exchange_weak(peak, now, memory_order_relaxed))
+  {
+  }
+}
+
+MemoryUsage getMemoryUsage(MemoryTag tag)
+{
+  auto& counter = g_counters[(int)tag];
+
+  MemoryUsage r;
+  r.bytes = counter.bytes.load(memory_order_relaxed);
+  r.peak = counter.peak.load(memory_order_relaxed);
+  return r;
+}
+
+char const* getMemoryTagName(MemoryTag tag)
+{
+  switch(tag)
+  {
+  case MemoryTag::Meshes: return "Meshes";
+  case MemoryTag::Textures: return "Textures";
+  case MemoryTag::Sounds: return "Sounds";
+  case MemoryTag::Entities: return "Entities";
+  case MemoryTag::Physics: return "Physics";
+  case MemoryTag::Transient: return "Transient";
+  case MemoryTag::GpuTextures: return "GPU textures";
+  case MemoryTag::GpuBuffers: return "GPU buffers";
+  case MemoryTag::GpuTargets: return "GPU targets";
+  case MemoryTag::Count: break;
+  }
+
+  return "?";
+}
+
+string dumpMemoryUsage()
+{
+  string r;
+  int64_t cpu = 0;
+  int64_t gpu = 0;
+
+  for(int i = 0; i < TAG_COUNT; ++i)
+  {
+    auto const tag = (MemoryTag)i;
+    auto const usage = getMemoryUsage(tag);
+
+    (isGpu(tag) ? gpu : cpu) += usage.bytes;
+
+    char line[256];
+    snprintf(line, sizeof line, "%s: %.2f MB (peak %.2f MB)\n", getMemoryTagName(tag), toMegabytes(usage.bytes), toMegabytes(usage.peak));
+    r += line;
+  }
+
+  char line[256];
+  snprintf(line, sizeof line, "Total: %.2f MB CPU, %.2f MB GPU\n", toMegabytes(cpu), toMegabytes(gpu));
+  r += line;
+
+#ifdef __EMSCRIPTEN__
+  // everything else included: what must fit in TOTAL_MEMORY
+  snprintf(line, sizeof line, "Heap: %.2f MB used, of %.2f MB\n", toMegabytes(mallinfo().uordblks), toMegabytes(emscripten_get_heap_size()));
+  r += line;
+#endif
+
+  return r;
+}
+
+TrackedMemory::TrackedMemory(MemoryTag tag, int64_t bytes) : m_tag(tag)
+{
+  set(bytes);
+}
+
+TrackedMemory::TrackedMemory(TrackedMemory const& other) : m_tag(other.m_tag)
+{
+  set(other.m_bytes);
+}
+
+TrackedMemory::TrackedMemory(TrackedMemory&& other) : m_tag(other.m_tag), m_bytes(other.m_bytes)
+{
+  other.m_bytes = 0;
+}
+
+TrackedMemory::~TrackedMemory()
+{
+  set(0);
+}
+
+TrackedMemory& TrackedMemory::operator = (TrackedMemory const& other)
+{
+  if(this != &other)
+  {
+    set(0);
+    m_tag = other.m_tag;
+    set(other.m_bytes);
+  }
+
+  return *this;
+}
+
+TrackedMemory& TrackedMemory::operator = (TrackedMemory&& other)
+{
+  if(this != &other)
+  {
+    set(0);
+    m_tag = other.m_tag;
+    m_bytes = other.m_bytes;
+    other.m_bytes = 0;
+  }
+
+  return *this;
+}
+
+void TrackedMemory::set(int64_t bytes)
+{
+  if(bytes != m_bytes)
+    trackMemory(m_tag, bytes - m_bytes);
+
+  m_bytes = bytes;
+}
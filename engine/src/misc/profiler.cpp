@@ -0,0 +1,170 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Profiler: per-thread event buffers, and the Chrome trace-event writer.
+
+#include "base/profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio> // snprintf
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+struct Event
+{
+  char const* name;
+  double begin; // us
+  double end;
+};
+
+// Each thread records into a buffer of its own: the lock is only ever
+// contended when the capture stops.
+struct ThreadBuffer
+{
+  mutex lock;
+  vector<Event> events;
+  string name;
+  int id;
+};
+
+struct Profiler
+{
+  atomic<bool> capturing { false };
+
+  mutex lock;
+  vector<unique_ptr<ThreadBuffer>> threads; // never freed: a thread might still use it
+
+  ThreadBuffer* getThreadBuffer()
+  {
+    static thread_local ThreadBuffer* buffer;
+
+    if(!buffer)
+    {
+      lock_guard<mutex> guard(lock);
+      threads.push_back(make_unique<ThreadBuffer>());
+      buffer = threads.back().get();
+      buffer->id = (int)threads.size();
+    }
+
+    return buffer;
+  }
+};
+
+Profiler g_profiler;
+
+double getTimeUs()
+{
+  static auto const start = chrono::steady_clock::now();
+  return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+void appendEscaped(string& r, char const* text)
+{
+  for(auto p = text; *p; ++p)
+  {
+    if(*p == '"' || *p == '\\')
+      r += '\\';
+
+    r += *p;
+  }
+}
+}
+
+ProfileScope::ProfileScope(char const* name) :
+  m_name(name),
+  m_begin(g_profiler.capturing ? getTimeUs() : -1)
+{
+}
+
+ProfileScope::~ProfileScope()
+{
+  if(m_begin < 0 || !g_profiler.capturing)
+    return;
+
+  auto const end = getTimeUs();
+  auto buffer = g_profiler.getThreadBuffer();
+
+  lock_guard<mutex> guard(buffer->lock);
+  buffer->events.push_back({ m_name, m_begin, end });
+}
+
+void setProfilerThreadName(char const* name)
+{
+  auto buffer = g_profiler.getThreadBuffer();
+
+  lock_guard<mutex> guard(buffer->lock);
+  buffer->name = name;
+}
+
+void startProfiling()
+{
+  lock_guard<mutex> guard(g_profiler.lock);
+
+  for(auto& thread : g_profiler.threads)
+  {
+    lock_guard<mutex> threadGuard(thread->lock);
+    thread->events.clear();
+  }
+
+  g_profiler.capturing = true;
+}
+
+string stopProfiling()
+{
+  g_profiler.capturing = false;
+
+  string r = "{\"traceEvents\":[\n";
+  bool first = true;
+
+  auto separate = [&] ()
+    {
+      if(!first)
+        r += ",\n";
+
+      first = false;
+    };
+
+  lock_guard<mutex> guard(g_profiler.lock);
+
+  for(auto& thread : g_profiler.threads)
+  {
+    lock_guard<mutex> threadGuard(thread->lock);
+
+    char buf[256];
+
+    if(!thread->name.empty())
+    {
+      separate();
+      snprintf(buf, sizeof buf, "{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"", thread->id);
+      r += buf;
+      appendEscaped(r, thread->name.c_str());
+      r += "\"}}";
+    }
+
+    for(auto& event : thread->events)
+    {
+      separate();
+      r += "{\"ph\":\"X\",\"pid\":1,\"name\":\"";
+      appendEscaped(r, event.name);
+      snprintf(buf, sizeof buf, "\",\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", thread->id, event.begin, event.end - event.begin);
+      r += buf;
+    }
+
+    thread->events.clear();
+  }
+
+  r += "\n]}\n";
+  return r;
+}
+
+bool isProfiling()
+{
+  return g_profiler.capturing;
+}
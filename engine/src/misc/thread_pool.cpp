@@ -0,0 +1,349 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Work-stealing thread pool
+
+#include "base/thread_pool.h"
+#include "base/profiler.h"
+
+#include <algorithm> // max, min
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// per pool, on the web: a few pools can live at once (e.g loading while
+// the music streams).
+auto const WEB_MAX_THREADS = 3;
+
+// a range of iterations of a 'parallelFor', or a task given to 'run'
+struct Job
+{
+  function<void(int)> const* f;
+  int begin;
+  int end;
+
+  function<void()> task;
+
+  JobCounter* counter; // decremented once completed, can be null
+  char const* name; // of the profiling scope
+};
+
+struct Queue
+{
+  mutex lock;
+  deque<Job> jobs;
+};
+}
+
+struct ThreadPool::Impl
+{
+  Impl(int threadCount)
+  {
+    if(threadCount < 0)
+      threadCount = max(0, (int)thread::hardware_concurrency() - 1);
+
+#if defined(__EMSCRIPTEN_PTHREADS__)
+    // a worker can only start once the page gets back to its event loop, so
+    // a job waited for on the main thread would never run: those started
+    // with the page must do (see PTHREAD_POOL_SIZE in scripts/wasm-make).
+    threadCount = min(threadCount, WEB_MAX_THREADS);
+#elif defined(__EMSCRIPTEN__)
+    threadCount = 0; // no threads in the browser, without SharedArrayBuffer
+#endif
+
+    queues.resize(threadCount);
+
+    for(auto& q : queues)
+      q.reset(new Queue);
+
+    for(int i = 0; i < threadCount; ++i)
+      threads.push_back(thread([this, i] () { workerMain(i); }));
+  }
+
+  ~Impl()
+  {
+    {
+      lock_guard<mutex> guard(wakeLock);
+      quit = true;
+    }
+
+    wake.notify_all();
+
+    for(auto& t : threads)
+      t.join();
+  }
+
+  void workerMain(int self)
+  {
+    setProfilerThreadName("worker");
+
+    while(1)
+    {
+      Job job;
+
+      if(popOrSteal(self, job))
+      {
+        run(job);
+        continue;
+      }
+
+      unique_lock<mutex> guard(wakeLock);
+      wake.wait(guard, [&] () { return quit || pending > 0; });
+
+      // drain the queues before leaving
+      if(quit && pending == 0)
+        return;
+    }
+  }
+
+  // own queue first (most recent job), then the oldest job of the others
+  bool popOrSteal(int self, Job& job)
+  {
+    auto const N = (int)queues.size();
+
+    for(int k = 0; k < N; ++k)
+    {
+      auto& q = *queues[(self + k) % N];
+      lock_guard<mutex> guard(q.lock);
+
+      if(q.jobs.empty())
+        continue;
+
+      if(k == 0)
+      {
+        job = q.jobs.back();
+        q.jobs.pop_back();
+      }
+      else
+      {
+        job = q.jobs.front();
+        q.jobs.pop_front();
+      }
+
+      --pending;
+      return true;
+    }
+
+    return false;
+  }
+
+  // A job of 'counter', from any queue: a waiting thread only helps with
+  // what it waits for, so it can't get stuck in a long unrelated task.
+  bool popCounted(JobCounter const* counter, Job& job)
+  {
+    for(auto& queue : queues)
+    {
+      auto& q = *queue;
+      lock_guard<mutex> guard(q.lock);
+
+      for(auto i = q.jobs.begin(); i != q.jobs.end(); ++i)
+      {
+        if(i->counter != counter)
+          continue;
+
+        job = move(*i);
+        q.jobs.erase(i);
+        --pending;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool popPinned(Job& job)
+  {
+    lock_guard<mutex> guard(pinned.lock);
+
+    if(pinned.jobs.empty())
+      return false;
+
+    job = move(pinned.jobs.front());
+    pinned.jobs.pop_front();
+    return true;
+  }
+
+  static void run(Job const& job)
+  {
+    {
+      PROFILE_SCOPE(job.name);
+
+      if(job.task)
+      {
+        job.task();
+      }
+      else
+      {
+        for(int i = job.begin; i < job.end; ++i)
+          (*job.f)(i);
+      }
+    }
+
+    if(job.counter)
+      --job.counter->pending;
+  }
+
+  // help, until all the jobs of 'counter' are done
+  void wait(JobCounter& counter, bool withPinned)
+  {
+    while(counter.pending > 0)
+    {
+      Job job;
+
+      if((withPinned && popPinned(job)) || popCounted(&counter, job))
+        run(job);
+      else
+        this_thread::yield();
+    }
+  }
+
+  void parallelFor(int count, function<void(int)> const& f)
+  {
+    if(count <= 0)
+      return;
+
+    auto const N = (int)queues.size();
+
+    if(N == 0)
+    {
+      for(int i = 0; i < count; ++i)
+        f(i);
+
+      return;
+    }
+
+    // a few jobs per thread, so fast workers can steal from slow ones
+    auto const jobCount = min(count, (N + 1) * 4);
+    JobCounter counter;
+    counter.pending = jobCount;
+
+    for(int j = 0; j < jobCount; ++j)
+    {
+      Job job {};
+      job.f = &f;
+      job.begin = (int)((int64_t)count * j / jobCount);
+      job.end = (int)((int64_t)count * (j + 1) / jobCount);
+      job.counter = &counter;
+      job.name = "ThreadPool::parallelFor";
+
+      auto& q = *queues[j % N];
+      lock_guard<mutex> guard(q.lock);
+      q.jobs.push_back(job);
+    }
+
+    {
+      lock_guard<mutex> guard(wakeLock);
+      pending += jobCount;
+    }
+
+    wake.notify_all();
+
+    wait(counter, false);
+  }
+
+  void runTask(function<void()> task, JobCounter* counter, char const* name)
+  {
+    Job job {};
+    job.task = move(task);
+    job.counter = counter;
+    job.name = name;
+
+    if(counter)
+      ++counter->pending;
+
+    auto const N = (int)queues.size();
+
+    if(N == 0)
+    {
+      run(job);
+      return;
+    }
+
+    {
+      auto& q = *queues[nextQueue++ % (unsigned)N];
+      lock_guard<mutex> guard(q.lock);
+      q.jobs.push_back(move(job));
+    }
+
+    {
+      lock_guard<mutex> guard(wakeLock);
+      pending++;
+    }
+
+    wake.notify_one();
+  }
+
+  void runPinned(function<void()> task, JobCounter* counter, char const* name)
+  {
+    Job job {};
+    job.task = move(task);
+    job.counter = counter;
+    job.name = name;
+
+    if(counter)
+      ++counter->pending;
+
+    lock_guard<mutex> guard(pinned.lock);
+    pinned.jobs.push_back(move(job));
+  }
+
+  vector<unique_ptr<Queue>> queues;
+  Queue pinned; // for the thread calling 'waitPinned', see 'runPinned'
+  vector<thread> threads;
+
+  mutex wakeLock;
+  condition_variable wake;
+  atomic<int> pending { 0 }; // jobs in the queues
+  bool quit = false;
+  atomic<unsigned> nextQueue { 0 }; // for 'runTask', called from any thread
+};
+
+ThreadPool::ThreadPool(int threadCount) : m_impl(new Impl(threadCount))
+{
+}
+
+ThreadPool::~ThreadPool() = default;
+
+void ThreadPool::parallelFor(int count, function<void(int)> const& f)
+{
+  m_impl->parallelFor(count, f);
+}
+
+void ThreadPool::run(function<void()> task, JobCounter* counter, char const* name)
+{
+  m_impl->runTask(move(task), counter, name);
+}
+
+void ThreadPool::runPinned(function<void()> task, JobCounter* counter, char const* name)
+{
+  m_impl->runPinned(move(task), counter, name);
+}
+
+void ThreadPool::wait(JobCounter& counter)
+{
+  m_impl->wait(counter, false);
+}
+
+void ThreadPool::waitPinned(JobCounter& counter)
+{
+  m_impl->wait(counter, true);
+}
+
+int ThreadPool::getThreadCount() const
+{
+  return (int)m_impl->threads.size();
+}
+
+ThreadPool& getSharedThreadPool()
+{
+  static ThreadPool pool;
+  return pool;
+}
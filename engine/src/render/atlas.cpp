@@ -0,0 +1,284 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "atlas.h"
+
+#include "base/util.h" // clamp
+
+#include <algorithm> // sort, min, max
+#include <cstring> // memcmp, memcpy
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+// Texels repeated around each tile: the bilinear filtering, and the first
+// mipmaps, don't reach the neighbors.
+auto const PADDING = 4;
+
+// the tiles start on block boundaries: the compressed formats don't mix them
+auto const ALIGNMENT = 4;
+
+int alignUp(int value)
+{
+  return (value + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+bool samePixels(PictureView a, PictureView b)
+{
+  if(a.dim.width != b.dim.width || a.dim.height != b.dim.height)
+    return false;
+
+  for(int y = 0; y < a.dim.height; ++y)
+    if(memcmp(a.pixels + y * a.stride * 4, b.pixels + y * b.stride * 4, a.dim.width * 4))
+      return false;
+
+  return true;
+}
+
+// Shelf packing, tallest first. Returns false if it doesn't fit in 'side' x 'side'.
+bool packShelves(vector<Size2i> const& sizes, int side, vector<Vector2i>& positions)
+{
+  vector<int> order(sizes.size());
+
+  for(int i = 0; i < (int)order.size(); ++i)
+    order[i] = i;
+
+  stable_sort(order.begin(), order.end(), [&] (int a, int b) { return sizes[a].height > sizes[b].height; });
+
+  positions.resize(sizes.size());
+
+  int x = 0;
+  int y = 0;
+  int shelfHeight = 0;
+
+  for(auto i : order)
+  {
+    auto const width = alignUp(sizes[i].width + PADDING * 2);
+    auto const height = alignUp(sizes[i].height + PADDING * 2);
+
+    if(width > side)
+      return false;
+
+    if(x + width > side)
+    {
+      x = 0;
+      y += shelfHeight;
+      shelfHeight = 0;
+    }
+
+    if(y + height > side)
+      return false;
+
+    positions[i] = Vector2i(x + PADDING, y + PADDING);
+    x += width;
+    shelfHeight = max(shelfHeight, height);
+  }
+
+  return true;
+}
+
+// Copies 'src' at 'pos', and its edges around it
+void blitPadded(Picture& dst, Vector2i pos, PictureView src)
+{
+  for(int y = -PADDING; y < src.dim.height + PADDING; ++y)
+  {
+    auto const srcY = clamp(y, 0, src.dim.height - 1);
+
+    for(int x = -PADDING; x < src.dim.width + PADDING; ++x)
+    {
+      auto const srcX = clamp(x, 0, src.dim.width - 1);
+      auto const dstX = pos.x + x;
+      auto const dstY = pos.y + y;
+
+      if(dstX < 0 || dstY < 0 || dstX >= dst.dim.width || dstY >= dst.dim.height)
+        continue;
+
+      memcpy(&dst.pixels[(dstY * dst.stride + dstX) * 4], src.pixels + (srcY * src.stride + srcX) * 4, 4);
+    }
+  }
+}
+}
+
+TextureAtlas::Tile const* TextureAtlas::find(string const& path) const
+{
+  for(auto& tile : tiles)
+    if(tile.path == path)
+      return &tile;
+
+  return nullptr;
+}
+
+Vector2f TextureAtlas::remap(Tile const& tile, Vector2f uv) const
+{
+  auto const size = pages[tile.page].size;
+  return Vector2f(
+    (tile.pos.x + uv.x * tile.size.width) / size.width,
+    (tile.pos.y + uv.y * tile.size.height) / size.height);
+}
+
+string serializeAtlas(TextureAtlas const& atlas)
+{
+  ostringstream ss;
+
+  for(auto& page : atlas.pages)
+    ss << "page " << page.path << " " << page.size.width << " " << page.size.height << "\n";
+
+  for(auto& tile : atlas.tiles)
+    ss << "tile " << tile.path << " " << tile.page << " " << tile.pos.x << " " << tile.pos.y << " " << tile.size.width << " " << tile.size.height << "\n";
+
+  return ss.str();
+}
+
+TextureAtlas deserializeAtlas(string const& data)
+{
+  TextureAtlas r;
+  istringstream ss(data);
+  string line;
+
+  while(getline(ss, line))
+  {
+    if(line.empty())
+      continue;
+
+    istringstream fields(line);
+    string kind;
+    fields >> kind;
+
+    if(kind == "page")
+    {
+      TextureAtlas::Page page;
+      fields >> page.path >> page.size.width >> page.size.height;
+
+      if(!fields || page.size.width <= 0 || page.size.height <= 0)
+        throw runtime_error("Invalid atlas page: '" + line + "'");
+
+      r.pages.push_back(page);
+    }
+    else if(kind == "tile")
+    {
+      TextureAtlas::Tile tile;
+      fields >> tile.path >> tile.page >> tile.pos.x >> tile.pos.y >> tile.size.width >> tile.size.height;
+
+      if(!fields || tile.page < 0 || tile.page >= (int)r.pages.size())
+        throw runtime_error("Invalid atlas tile: '" + line + "'");
+
+      auto const pageSize = r.pages[tile.page].size;
+
+      if(tile.pos.x < 0 || tile.pos.y < 0 || tile.size.width <= 0 || tile.size.height <= 0 ||
+         tile.pos.x + tile.size.width > pageSize.width || tile.pos.y + tile.size.height > pageSize.height)
+        throw runtime_error("Invalid atlas tile: '" + line + "'");
+
+      r.tiles.push_back(tile);
+    }
+    else
+    {
+      throw runtime_error("Invalid atlas line: '" + line + "'");
+    }
+  }
+
+  return r;
+}
+
+bool hasDiffuseInTile(SingleRenderMesh const& single)
+{
+  // the half floats are a bit off
+  auto const epsilon = 1.0f / 1024;
+
+  for(auto& packed : single.vertices)
+  {
+    auto const v = unpackVertex(packed);
+
+    if(v.diffuse_u < -epsilon || v.diffuse_u > 1 + epsilon || v.diffuse_v < -epsilon || v.diffuse_v > 1 + epsilon)
+      return false;
+  }
+
+  return true;
+}
+
+void remapDiffuse(SingleRenderMesh& single, TextureAtlas const& atlas, TextureAtlas::Tile const& tile)
+{
+  for(auto& packed : single.vertices)
+  {
+    auto v = unpackVertex(packed);
+    auto const uv = atlas.remap(tile, Vector2f(clamp(v.diffuse_u, 0.0f, 1.0f), clamp(v.diffuse_v, 0.0f, 1.0f)));
+    v.diffuse_u = uv.x;
+    v.diffuse_v = uv.y;
+    packed.diffuse[0] = packVertex(v).diffuse[0];
+    packed.diffuse[1] = packVertex(v).diffuse[1];
+  }
+}
+
+void remapLightmap(SingleRenderMesh& single, TextureAtlas const& atlas, TextureAtlas::Tile const& tile)
+{
+  for(auto& packed : single.vertices)
+  {
+    auto v = unpackVertex(packed);
+    auto const uv = atlas.remap(tile, Vector2f(v.lightmap_u, v.lightmap_v));
+    v.lightmap_u = uv.x;
+    v.lightmap_v = uv.y;
+    packed.lightmap[0] = packVertex(v).lightmap[0];
+    packed.lightmap[1] = packVertex(v).lightmap[1];
+  }
+}
+
+bool packAtlasPage(vector<PictureView> const& pictures, int maxSize, Picture& page, vector<Vector2i>& positions)
+{
+  // the first of each distinct picture gets a place
+  vector<int> original(pictures.size());
+  vector<Size2i> sizes;
+  vector<int> unique;
+
+  for(int i = 0; i < (int)pictures.size(); ++i)
+  {
+    original[i] = i;
+
+    for(auto j : unique)
+    {
+      if(samePixels(pictures[i], pictures[j]))
+      {
+        original[i] = j;
+        break;
+      }
+    }
+
+    if(original[i] == i)
+    {
+      unique.push_back(i);
+      sizes.push_back(pictures[i].dim);
+    }
+  }
+
+  vector<Vector2i> uniquePositions;
+  int side = 16;
+
+  while(side < maxSize && !packShelves(sizes, side, uniquePositions))
+    side *= 2;
+
+  if(side > maxSize || !packShelves(sizes, side, uniquePositions))
+    return false;
+
+  page = Picture {};
+  page.dim = Size2i(side, side);
+  page.stride = side;
+  page.pixels.assign(side * side * 4, 0xff); // opaque: no alpha of its own
+
+  map<int, Vector2i> positionOf;
+
+  for(int k = 0; k < (int)unique.size(); ++k)
+  {
+    blitPadded(page, uniquePositions[k], pictures[unique[k]]);
+    positionOf[unique[k]] = uniquePositions[k];
+  }
+
+  positions.resize(pictures.size());
+
+  for(int i = 0; i < (int)pictures.size(); ++i)
+    positions[i] = positionOf[original[i]];
+
+  return true;
+}
@@ -0,0 +1,66 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Texture atlases of the props (e.g the sprites): the meshcooker packs
+// their small textures into a few pages, so they're all drawn with the
+// same bindings. The display remaps the UVs when loading a model.
+
+#pragma once
+
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "base/geom.h"
+#include "picture.h"
+#include "rendermesh.h"
+
+struct TextureAtlas
+{
+  struct Page
+  {
+    string path; // of the PNG
+    Size2i size;
+  };
+
+  // the texels of a texture on its page, padding excluded
+  struct Tile
+  {
+    string path; // of the texture it replaces
+    int page;
+    Vector2i pos;
+    Size2i size;
+  };
+
+  vector<Page> pages;
+  vector<Tile> tiles;
+
+  // null if 'path' isn't in the atlas
+  Tile const* find(string const& path) const;
+
+  // 'uv', in [0;1] on the texture of 'tile', on its page
+  Vector2f remap(Tile const& tile, Vector2f uv) const;
+};
+
+// The index of the atlas, next to its pages ("atlas.txt"):
+// one line per page, then one per tile.
+string serializeAtlas(TextureAtlas const& atlas);
+TextureAtlas deserializeAtlas(string const& data);
+
+// Packs 'pictures' on a page of at most 'maxSize' x 'maxSize' texels,
+// each with a border of its edge texels repeated, for the filtering and
+// the mipmaps. Identical pictures share their place.
+// Returns false if they don't fit.
+bool packAtlasPage(vector<PictureView> const& pictures, int maxSize, Picture& page, vector<Vector2i>& positions);
+
+// Whether the diffuse UVs of 'single' stay in [0;1]: wrapping ones can't
+// use a tile.
+bool hasDiffuseInTile(SingleRenderMesh const& single);
+
+// Moves the diffuse, or lightmap, UVs of 'single' to 'tile'.
+// Only the UVs change: the normals aren't encoded again.
+void remapDiffuse(SingleRenderMesh& single, TextureAtlas const& atlas, TextureAtlas::Tile const& tile);
+void remapLightmap(SingleRenderMesh& single, TextureAtlas const& atlas, TextureAtlas::Tile const& tile);
@@ -6,11 +6,15 @@
 
 #pragma once
 
+#include <functional>
 #include <stdint.h>
 
 #include "base/geom.h"
+#include "base/resource.h"
 #include "base/span.h"
 
+struct ThreadPool;
+
 struct Display
 {
   virtual ~Display() = default;
@@ -18,17 +22,81 @@ struct Display
   virtual void setFullscreen(bool fs) = 0;
   virtual void setHdr(bool enable) = 0;
   virtual void setFsaa(bool enable) = 0;
+
+  // Draws the depth of the scene first, so the lighting only runs once per
+  // pixel. On by default.
+  virtual void setDepthPrepass(bool enable) = 0;
+
+  // Skips the actors hidden behind the opaque geometry, as told by the
+  // occlusion queries of their bounding boxes, one frame late. On by default.
+  virtual void setOcclusionCulling(bool enable) = 0;
+
+  // Scales the offscreen render target between 'minScale' and 'maxScale'
+  // (of each dimension), to keep the GPU time of a frame under 'targetGpuMs'.
+  // The HDR resolve upscales it. Zero disables it.
+  virtual void setDynamicResolution(float targetGpuMs, float minScale, float maxScale) = 0;
   virtual void setCaption(const char* caption) = 0;
   virtual void loadModel(int modelId, const char* path) = 0;
+
+  // Same as 'loadModel' for each model.
+  // Files are read and decoded on 'pool', the upload happens on the calling thread.
+  virtual void loadModels(Span<const Resource> models, ThreadPool& pool) = 0;
+
+  // Same as 'loadModel', without blocking: the first call starts reading and
+  // decoding the file on 'pool', the first call after that uploads it.
+  // Returns true once the model is loaded: call it again until then (e.g
+  // once per frame). Throws if the file can't be loaded.
+  virtual bool loadModelInBackground(int modelId, const char* path, ThreadPool& pool) = 0;
+
+  // Frees the GPU memory of the model: it draws nothing until loaded again.
+  virtual void unloadModel(int modelId) = 0;
+
+  // Above 'bytes' of model textures and vertices, the least recently drawn
+  // models are evicted, and reloaded when drawn again. Zero means no limit.
+  virtual void setMemoryBudget(int64_t bytes) = 0;
   virtual void setCamera(Vector3f pos, Quaternion dir) = 0;
   virtual void setAmbientLight(float ambientLight) = 0;
   virtual void readPixels(Span<uint8_t> dstRgbPixels) = 0;
+
+  // RGBA rows of 'size.width' pixels, bottom row first.
+  // Only valid during the call.
+  using CaptureCallback = std::function<void(Span<const uint8_t> pixels, Size2i size)>;
+
+  // Asynchronous readback, for video capture: starts reading the frame
+  // just drawn, without waiting for the GPU. Calls 'onFrame' for each
+  // previous frame whose readback completed since, oldest first.
+  virtual void captureFrame(CaptureCallback const& onFrame) = 0;
+
+  // Waits for all the pending readbacks, and calls 'onFrame' for each.
+  virtual void flushCaptures(CaptureCallback const& onFrame) = 0;
+
+  struct PassTiming
+  {
+    char const* name;
+    float ms;
+  };
+
+  // Smoothed GPU time of each render pass, a few frames behind.
+  // Empty if the driver can't measure it.
+  virtual Span<const PassTiming> getGpuTimings() = 0;
   virtual void enableGrab(bool enable) = 0;
 
+  // whether presenting a frame waits for the vertical refresh
+  virtual bool isVsynced() = 0;
+
+  // The context can only be current on one thread at a time: the one which
+  // created the display, unless released (e.g for a render thread).
+  virtual void acquireContext() = 0;
+  virtual void releaseContext() = 0;
+
   // draw functions
   virtual void beginDraw() = 0;
   virtual void endDraw() = 0;
   virtual void drawActor(Rect3f where, Quaternion orientation, int modelId, bool blinking, int actionIdx, float frame) = 0;
+
+  // Many unrotated copies of 'modelId' (e.g particles), drawn as one batch:
+  // no occlusion query, nor level of detail, per copy.
+  virtual void drawParticles(int modelId, Span<const Rect3f> where) = 0;
   virtual void drawText(Vector2f pos, char const* text) = 0;
 };
 
@@ -0,0 +1,482 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Display capture format:
+// header: "DCAP", version (1 byte), resolution (2 x int32)
+// then for each call: its opcode (1 byte), followed by its arguments.
+// Integers and floats are 32-bit, little endian. Strings are prefixed
+// with their length.
+
+#include "display_capture.h"
+
+#include <cstring> // memcpy, memcmp, strlen
+#include <stdexcept>
+
+#include "base/resource.h"
+
+namespace
+{
+auto const MAGIC = "DCAP";
+uint8_t const VERSION = 1;
+
+// the values are part of the file format
+enum Opcode : uint8_t
+{
+  OP_SET_HDR = 1,
+  OP_SET_FSAA = 2,
+  OP_SET_DEPTH_PREPASS = 3,
+  OP_SET_OCCLUSION_CULLING = 4,
+  OP_SET_DYNAMIC_RESOLUTION = 5,
+  OP_SET_MEMORY_BUDGET = 6,
+  OP_LOAD_MODEL = 7,
+  OP_UNLOAD_MODEL = 8,
+  OP_SET_CAMERA = 9,
+  OP_SET_AMBIENT_LIGHT = 10,
+  OP_BEGIN_DRAW = 11,
+  OP_END_DRAW = 12,
+  OP_DRAW_ACTOR = 13,
+  OP_DRAW_PARTICLES = 14,
+  OP_DRAW_TEXT = 15,
+};
+
+struct Writer
+{
+  vector<uint8_t> data;
+
+  void op(Opcode value)
+  {
+    data.push_back(value);
+  }
+
+  void raw(void const* src, int len)
+  {
+    auto bytes = (uint8_t const*)src;
+    data.insert(data.end(), bytes, bytes + len);
+  }
+
+  void i32(int32_t value) { raw(&value, 4); }
+  void f32(float value) { raw(&value, 4); }
+  void vec(Vector3f v) { f32(v.x); f32(v.y); f32(v.z); }
+  void quat(Quaternion q) { vec(q.v); f32(q.s); }
+
+  void rect(Rect3f r)
+  {
+    vec(r.pos);
+    f32(r.size.cx);
+    f32(r.size.cy);
+    f32(r.size.cz);
+  }
+
+  void str(char const* s)
+  {
+    auto const len = (int)strlen(s);
+    i32(len);
+    raw(s, len);
+  }
+};
+
+struct Reader
+{
+  Span<const uint8_t> data;
+  int pos;
+
+  bool atEnd() const { return pos >= data.len; }
+
+  void raw(void* dst, int len)
+  {
+    if(len < 0 || len > data.len - pos)
+      throw runtime_error("Truncated display capture");
+
+    memcpy(dst, data.data + pos, len);
+    pos += len;
+  }
+
+  uint8_t u8() { uint8_t r; raw(&r, 1); return r; }
+  int32_t i32() { int32_t r; raw(&r, 4); return r; }
+  float f32() { float r; raw(&r, 4); return r; }
+
+  Vector3f vec()
+  {
+    Vector3f r;
+    r.x = f32();
+    r.y = f32();
+    r.z = f32();
+    return r;
+  }
+
+  Quaternion quat()
+  {
+    Quaternion r;
+    r.v = vec();
+    r.s = f32();
+    return r;
+  }
+
+  Rect3f rect()
+  {
+    Rect3f r;
+    r.pos = vec();
+    r.size.cx = f32();
+    r.size.cy = f32();
+    r.size.cz = f32();
+    return r;
+  }
+
+  string str()
+  {
+    auto const len = i32();
+
+    if(len < 0 || len > data.len - pos)
+      throw runtime_error("Truncated display capture");
+
+    string r((char const*)data.data + pos, len);
+    pos += len;
+    return r;
+  }
+};
+
+struct CaptureDisplay : Display
+{
+  CaptureDisplay(unique_ptr<Display> inner, Size2i resolution, CaptureSink sink) :
+    m_inner(move(inner)),
+    m_sink(sink)
+  {
+    m_out.raw(MAGIC, 4);
+    m_out.raw(&VERSION, 1);
+    m_out.i32(resolution.width);
+    m_out.i32(resolution.height);
+    flush();
+  }
+
+  // the calls after the last frame
+  ~CaptureDisplay()
+  {
+    flush();
+  }
+
+  void setHdr(bool enable) override
+  {
+    m_out.op(OP_SET_HDR);
+    m_out.i32(enable);
+    m_inner->setHdr(enable);
+  }
+
+  void setFsaa(bool enable) override
+  {
+    m_out.op(OP_SET_FSAA);
+    m_out.i32(enable);
+    m_inner->setFsaa(enable);
+  }
+
+  void setDepthPrepass(bool enable) override
+  {
+    m_out.op(OP_SET_DEPTH_PREPASS);
+    m_out.i32(enable);
+    m_inner->setDepthPrepass(enable);
+  }
+
+  void setOcclusionCulling(bool enable) override
+  {
+    m_out.op(OP_SET_OCCLUSION_CULLING);
+    m_out.i32(enable);
+    m_inner->setOcclusionCulling(enable);
+  }
+
+  void setDynamicResolution(float targetGpuMs, float minScale, float maxScale) override
+  {
+    m_out.op(OP_SET_DYNAMIC_RESOLUTION);
+    m_out.f32(targetGpuMs);
+    m_out.f32(minScale);
+    m_out.f32(maxScale);
+    m_inner->setDynamicResolution(targetGpuMs, minScale, maxScale);
+  }
+
+  void setMemoryBudget(int64_t bytes) override
+  {
+    m_out.op(OP_SET_MEMORY_BUDGET);
+    m_out.raw(&bytes, 8);
+    m_inner->setMemoryBudget(bytes);
+  }
+
+  void loadModel(int modelId, const char* path) override
+  {
+    recordLoad(modelId, path);
+    m_inner->loadModel(modelId, path);
+  }
+
+  void loadModels(Span<const Resource> models, ThreadPool& pool) override
+  {
+    for(auto& res : models)
+      recordLoad(res.id, res.path);
+
+    m_inner->loadModels(models, pool);
+  }
+
+  // recorded once loaded: the replay doesn't need to wait
+  bool loadModelInBackground(int modelId, const char* path, ThreadPool& pool) override
+  {
+    if(!m_inner->loadModelInBackground(modelId, path, pool))
+      return false;
+
+    recordLoad(modelId, path);
+    return true;
+  }
+
+  void unloadModel(int modelId) override
+  {
+    m_out.op(OP_UNLOAD_MODEL);
+    m_out.i32(modelId);
+    m_inner->unloadModel(modelId);
+  }
+
+  void setCamera(Vector3f pos, Quaternion dir) override
+  {
+    m_out.op(OP_SET_CAMERA);
+    m_out.vec(pos);
+    m_out.quat(dir);
+    m_inner->setCamera(pos, dir);
+  }
+
+  void setAmbientLight(float ambientLight) override
+  {
+    m_out.op(OP_SET_AMBIENT_LIGHT);
+    m_out.f32(ambientLight);
+    m_inner->setAmbientLight(ambientLight);
+  }
+
+  void beginDraw() override
+  {
+    m_out.op(OP_BEGIN_DRAW);
+    m_inner->beginDraw();
+  }
+
+  void endDraw() override
+  {
+    m_out.op(OP_END_DRAW);
+    m_inner->endDraw();
+
+    // one write per frame
+    flush();
+  }
+
+  void drawActor(Rect3f where, Quaternion orientation, int modelId, bool blinking, int actionIdx, float frame) override
+  {
+    m_out.op(OP_DRAW_ACTOR);
+    m_out.rect(where);
+    m_out.quat(orientation);
+    m_out.i32(modelId);
+    m_out.i32(blinking);
+    m_out.i32(actionIdx);
+    m_out.f32(frame);
+    m_inner->drawActor(where, orientation, modelId, blinking, actionIdx, frame);
+  }
+
+  void drawParticles(int modelId, Span<const Rect3f> where) override
+  {
+    m_out.op(OP_DRAW_PARTICLES);
+    m_out.i32(modelId);
+    m_out.i32(where.len);
+
+    for(auto& rect : where)
+      m_out.rect(rect);
+
+    m_inner->drawParticles(modelId, where);
+  }
+
+  void drawText(Vector2f pos, char const* text) override
+  {
+    m_out.op(OP_DRAW_TEXT);
+    m_out.f32(pos.x);
+    m_out.f32(pos.y);
+    m_out.str(text);
+    m_inner->drawText(pos, text);
+  }
+
+  // not part of the picture: only forwarded
+  void setFullscreen(bool fs) override { m_inner->setFullscreen(fs); }
+  void setCaption(const char* caption) override { m_inner->setCaption(caption); }
+  void readPixels(Span<uint8_t> dstRgbPixels) override { m_inner->readPixels(dstRgbPixels); }
+  void captureFrame(CaptureCallback const& onFrame) override { m_inner->captureFrame(onFrame); }
+  void flushCaptures(CaptureCallback const& onFrame) override { m_inner->flushCaptures(onFrame); }
+  Span<const PassTiming> getGpuTimings() override { return m_inner->getGpuTimings(); }
+  void enableGrab(bool enable) override { m_inner->enableGrab(enable); }
+  bool isVsynced() override { return m_inner->isVsynced(); }
+  void acquireContext() override { m_inner->acquireContext(); }
+  void releaseContext() override { m_inner->releaseContext(); }
+
+private:
+  void recordLoad(int modelId, const char* path)
+  {
+    m_out.op(OP_LOAD_MODEL);
+    m_out.i32(modelId);
+    m_out.str(path);
+  }
+
+  void flush()
+  {
+    m_sink({ m_out.data.data(), (int)m_out.data.size() });
+    m_out.data.clear();
+  }
+
+  unique_ptr<Display> const m_inner;
+  CaptureSink const m_sink;
+  Writer m_out;
+};
+}
+
+Display* createCaptureDisplay(unique_ptr<Display> inner, Size2i resolution, CaptureSink sink)
+{
+  return new CaptureDisplay(move(inner), resolution, sink);
+}
+
+DisplayCaptureReader::DisplayCaptureReader(vector<uint8_t> data) :
+  m_data(move(data))
+{
+  Reader in { { m_data.data(), (int)m_data.size() }, 0 };
+
+  char magic[4];
+  in.raw(magic, 4);
+
+  if(memcmp(magic, MAGIC, 4))
+    throw runtime_error("Not a display capture");
+
+  if(in.u8() != VERSION)
+    throw runtime_error("Unsupported display capture version");
+
+  resolution.width = in.i32();
+  resolution.height = in.i32();
+
+  m_start = m_pos = in.pos;
+}
+
+bool DisplayCaptureReader::playFrame(Display* display)
+{
+  Reader in { { m_data.data(), (int)m_data.size() }, m_pos };
+
+  if(in.atEnd())
+    return false;
+
+  while(!in.atEnd())
+  {
+    auto const op = in.u8();
+
+    switch(op)
+    {
+    case OP_SET_HDR:
+      display->setHdr(in.i32());
+      break;
+    case OP_SET_FSAA:
+      display->setFsaa(in.i32());
+      break;
+    case OP_SET_DEPTH_PREPASS:
+      display->setDepthPrepass(in.i32());
+      break;
+    case OP_SET_OCCLUSION_CULLING:
+      display->setOcclusionCulling(in.i32());
+      break;
+    case OP_SET_DYNAMIC_RESOLUTION:
+      {
+        auto const targetGpuMs = in.f32();
+        auto const minScale = in.f32();
+        auto const maxScale = in.f32();
+        display->setDynamicResolution(targetGpuMs, minScale, maxScale);
+        break;
+      }
+    case OP_SET_MEMORY_BUDGET:
+      {
+        int64_t bytes;
+        in.raw(&bytes, 8);
+        display->setMemoryBudget(bytes);
+        break;
+      }
+    case OP_LOAD_MODEL:
+      {
+        auto const id = in.i32();
+        auto const path = in.str();
+        auto i = m_loaded.find(id);
+
+        if(i == m_loaded.end() || i->second != path)
+        {
+          display->loadModel(id, path.c_str());
+          m_loaded[id] = path;
+        }
+
+        break;
+      }
+    case OP_UNLOAD_MODEL:
+      {
+        auto const id = in.i32();
+        display->unloadModel(id);
+        m_loaded.erase(id);
+        break;
+      }
+    case OP_SET_CAMERA:
+      {
+        auto const pos = in.vec();
+        auto const dir = in.quat();
+        display->setCamera(pos, dir);
+        break;
+      }
+    case OP_SET_AMBIENT_LIGHT:
+      display->setAmbientLight(in.f32());
+      break;
+    case OP_BEGIN_DRAW:
+      display->beginDraw();
+      break;
+    case OP_END_DRAW:
+      display->endDraw();
+      m_pos = in.pos;
+      return true;
+    case OP_DRAW_ACTOR:
+      {
+        auto const where = in.rect();
+        auto const orientation = in.quat();
+        auto const modelId = in.i32();
+        auto const blinking = in.i32() != 0;
+        auto const actionIdx = in.i32();
+        auto const frame = in.f32();
+        display->drawActor(where, orientation, modelId, blinking, actionIdx, frame);
+        break;
+      }
+    case OP_DRAW_PARTICLES:
+      {
+        auto const modelId = in.i32();
+        auto const count = in.i32();
+
+        if(count < 0 || count > (in.data.len - in.pos) / 24)
+          throw runtime_error("Truncated display capture");
+
+        m_particles.resize(count);
+
+        for(auto& rect : m_particles)
+          rect = in.rect();
+
+        display->drawParticles(modelId, m_particles);
+        break;
+      }
+    case OP_DRAW_TEXT:
+      {
+        Vector2f pos;
+        pos.x = in.f32();
+        pos.y = in.f32();
+        auto const text = in.str();
+        display->drawText(pos, text.c_str());
+        break;
+      }
+    default:
+      throw runtime_error("Invalid display capture opcode: " + to_string(op));
+    }
+  }
+
+  // the calls after the last frame
+  m_pos = in.pos;
+  return false;
+}
+
+void DisplayCaptureReader::rewind()
+{
+  m_pos = m_start;
+}
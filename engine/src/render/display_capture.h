@@ -0,0 +1,56 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Display capture: the calls which make the picture (the models loaded,
+// the render settings, the camera and the draws of each frame), recorded
+// so they can be played again on a real display, without the game.
+// See 'gpu_replay.exe'.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "base/geom.h"
+#include "base/span.h"
+#include "display.h"
+
+// Receives the encoded calls: the header, then a whole frame at a time.
+using CaptureSink = function<void(Span<const uint8_t> data)>;
+
+// Forwards every call to 'inner', and records the ones which make the
+// picture to 'sink'. 'resolution' is the one of 'inner'.
+Display* createCaptureDisplay(unique_ptr<Display> inner, Size2i resolution, CaptureSink sink);
+
+// Plays a capture on a display, one frame at a time.
+struct DisplayCaptureReader
+{
+  // throws if 'data' isn't a display capture
+  explicit DisplayCaptureReader(vector<uint8_t> data);
+
+  Size2i resolution;
+
+  // Plays the calls up to the next 'endDraw', included.
+  // Returns false at the end of the capture, once the calls after the last
+  // frame are played. Throws if the capture is truncated.
+  bool playFrame(Display* display);
+
+  // Back to the first frame. The models already loaded, from the same
+  // path, aren't loaded again.
+  void rewind();
+
+private:
+  vector<uint8_t> m_data;
+  int m_start; // the first call, after the header
+  int m_pos;
+  map<int, string> m_loaded; // model id -> path
+  vector<Rect3f> m_particles; // reused by 'playFrame'
+};
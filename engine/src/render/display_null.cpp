@@ -0,0 +1,57 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Headless display: accepts everything, draws nothing.
+// Doesn't need a window nor a GPU (e.g build farms, benchmarks).
+
+#include "display.h"
+
+#include <cstring> // memset
+
+namespace
+{
+struct NullDisplay : Display
+{
+  void setFullscreen(bool) override {}
+  void setHdr(bool) override {}
+  void setFsaa(bool) override {}
+  void setDepthPrepass(bool) override {}
+  void setOcclusionCulling(bool) override {}
+  void setDynamicResolution(float, float, float) override {}
+  void setCaption(const char*) override {}
+  void loadModel(int, const char*) override {}
+  void loadModels(Span<const Resource>, ThreadPool&) override {}
+  bool loadModelInBackground(int, const char*, ThreadPool&) override { return true; }
+  void unloadModel(int) override {}
+  void setMemoryBudget(int64_t) override {}
+  void setCamera(Vector3f, Quaternion) override {}
+  void setAmbientLight(float) override {}
+  void enableGrab(bool) override {}
+
+  void readPixels(Span<uint8_t> dstRgbPixels) override
+  {
+    memset(dstRgbPixels.data, 0, dstRgbPixels.len);
+  }
+
+  void captureFrame(CaptureCallback const&) override {}
+  void flushCaptures(CaptureCallback const&) override {}
+  Span<const PassTiming> getGpuTimings() override { return {}; }
+  bool isVsynced() override { return false; }
+  void acquireContext() override {}
+  void releaseContext() override {}
+
+  void beginDraw() override {}
+  void endDraw() override {}
+  void drawActor(Rect3f, Quaternion, int, bool, int, float) override {}
+  void drawParticles(int, Span<const Rect3f>) override {}
+  void drawText(Vector2f, char const*) override {}
+};
+}
+
+Display* createNullDisplay()
+{
+  return new NullDisplay;
+}
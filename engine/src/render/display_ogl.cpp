@@ -8,9 +8,18 @@
 
 #include "display.h"
 
+#include <algorithm> // stable_sort
 #include <cassert>
+#include <cmath> // tan
+#include <cstddef> // offsetof
 #include <cstdio>
+#include <cstring> // strcmp, strlen, memcpy
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
 #include <stdexcept>
+#include <string>
 #include <vector>
 using namespace std;
 
@@ -18,44 +27,106 @@ using namespace std;
 #include "SDL.h" // SDL_INIT_VIDEO
 
 #include "base/geom.h"
+#include "base/memory.h"
+#include "base/profiler.h"
 #include "base/scene.h"
 #include "base/span.h"
+#include "base/thread_pool.h"
 #include "base/util.h"
+#include "atlas.h"
+#include "draw_order.h"
 #include "matrix4.h"
+#include "misc/file.h"
 #include "picture.h"
 #include "rendermesh.h"
+#include "resolution_scaler.h"
+#include "texture.h"
 
 extern const Span<uint8_t> MeshVertexShaderCode;
 extern const Span<uint8_t> MeshFragmentShaderCode;
+extern const Span<uint8_t> DepthVertexShaderCode;
+extern const Span<uint8_t> DepthFragmentShaderCode;
 extern const Span<uint8_t> HdrVertexShaderCode;
 extern const Span<uint8_t> HdrFragmentShaderCode;
 extern const Span<uint8_t> BloomVertexShaderCode;
 extern const Span<uint8_t> BloomFragmentShaderCode;
 extern RenderMesh boxModel();
 
+// Checks for errors after each GL call (make CHECK_GL=0|1).
+// Off by default with NDEBUG: polling 'glGetError' syncs with the driver.
+#ifndef CHECK_GL
 #ifdef NDEBUG
-#define SAFE_GL(a) a
+#define CHECK_GL 0
 #else
+#define CHECK_GL 1
+#endif
+#endif
+
+#if CHECK_GL
 #define SAFE_GL(a) \
   do { a; ensureGl(# a, __LINE__); } while (0)
+#else
+#define SAFE_GL(a) a
 #endif
 
 namespace
 {
+#if CHECK_GL
+// With KHR_debug, the driver reports the errors through a callback,
+// called from within the failing call: no need to poll.
+bool g_hasDebugOutput = false;
+string g_debugError; // first one since the last check
+
+void APIENTRY onDebugMessage(GLenum, GLenum type, GLuint, GLenum, GLsizei, const GLchar* message, const void*)
+{
+  auto const GL_DEBUG_TYPE_ERROR_KHR = 0x824C;
+
+  if(type == GL_DEBUG_TYPE_ERROR_KHR && g_debugError.empty())
+    g_debugError = message;
+}
+
 void ensureGl(char const* expr, int line)
 {
-  auto const errorCode = glGetError();
+  string message;
 
-  if(errorCode == GL_NO_ERROR)
-    return;
+  if(g_hasDebugOutput)
+  {
+    if(g_debugError.empty())
+      return;
+
+    message = "Message: " + g_debugError + "\n";
+    g_debugError.clear();
+  }
+  else
+  {
+    auto const errorCode = glGetError();
+
+    if(errorCode == GL_NO_ERROR)
+      return;
+
+    message = "Code: " + to_string(errorCode) + "\n";
+  }
 
   string ss;
   ss += "OpenGL error\n";
   ss += "Expr: " + string(expr) + "\n";
   ss += "Line: " + to_string(line) + "\n";
-  ss += "Code: " + to_string(errorCode) + "\n";
+  ss += message;
   throw runtime_error(ss);
 }
+#endif
+
+// for the errors that are expected, and handled
+void clearGlErrors()
+{
+  while(glGetError() != GL_NO_ERROR)
+  {
+  }
+
+#if CHECK_GL
+  g_debugError.clear();
+#endif
+}
 
 GLuint safeGetUniformLocation(GLuint programId, const char* name)
 {
@@ -119,6 +190,9 @@ GLuint linkShaders(vector<GLuint> ids)
   for(auto id : ids)
     glAttachShader(ProgramID, id);
 
+  // for the program cache
+  glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
   glLinkProgram(ProgramID);
 
   // Check the program
@@ -141,6 +215,50 @@ GLuint linkShaders(vector<GLuint> ids)
   return ProgramID;
 }
 
+bool hasExtension(char const* name)
+{
+  GLint count = 0;
+  SAFE_GL(glGetIntegerv(GL_NUM_EXTENSIONS, &count));
+
+  for(int i = 0; i < count; ++i)
+    if(!strcmp((char const*)glGetStringi(GL_EXTENSIONS, i), name))
+      return true;
+
+  return false;
+}
+
+// including the mipmaps
+int64_t getTextureBytes(Texture const& tex)
+{
+  if(tex.format == TextureFormat::Rgba8 && tex.levels.size() == 1)
+    return int64_t(getImageBytes(tex.format, tex.dim)) * 4 / 3;
+
+  int64_t r = 0;
+
+  for(auto& level : tex.levels)
+    r += level.size();
+
+  return r;
+}
+
+GLenum getGlFormat(TextureFormat format)
+{
+  // from EXT_texture_compression_s3tc
+  auto const GL_COMPRESSED_RGB_S3TC_DXT1_EXT = 0x83F0;
+  auto const GL_COMPRESSED_RGBA_S3TC_DXT5_EXT = 0x83F3;
+
+  switch(format)
+  {
+  case TextureFormat::Bc1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+  case TextureFormat::Bc3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+  case TextureFormat::Etc2Rgb: return GL_COMPRESSED_RGB8_ETC2;
+  case TextureFormat::Etc2Rgba: return GL_COMPRESSED_RGBA8_ETC2_EAC;
+  case TextureFormat::Rgba8: return GL_RGBA;
+  }
+
+  throw runtime_error("Unknown texture format");
+}
+
 GLuint uploadTextureToGPU(PictureView pic)
 {
   GLuint texture;
@@ -159,14 +277,242 @@ GLuint uploadTextureToGPU(PictureView pic)
   return texture;
 }
 
+// Block compressed levels are uploaded as is.
+GLuint uploadTextureToGPU(Texture const& tex)
+{
+  GLuint texture;
+
+  glGenTextures(1, &texture);
+
+  glBindTexture(GL_TEXTURE_2D, texture);
+
+  for(int i = 0; i < (int)tex.levels.size(); ++i)
+  {
+    auto const width = max(1, tex.dim.width >> i);
+    auto const height = max(1, tex.dim.height >> i);
+    auto& level = tex.levels[i];
+
+    if(tex.format == TextureFormat::Rgba8)
+      SAFE_GL(glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.data()));
+    else
+      SAFE_GL(glCompressedTexImage2D(GL_TEXTURE_2D, i, getGlFormat(tex.format), width, height, 0, (GLsizei)level.size(), level.data()));
+  }
+
+  if(tex.format == TextureFormat::Rgba8 && tex.levels.size() == 1)
+    SAFE_GL(glGenerateMipmap(GL_TEXTURE_2D));
+  else
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)tex.levels.size() - 1);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return texture;
+}
+
+// The levels up to this size are uploaded right away, and sampled
+// until the larger ones arrive.
+auto const PLACEHOLDER_MAX_SIZE = 32;
+
+// Allocates all the levels, but only fills the placeholder ones.
+// 'firstResident': the larger levels, below it, are left to 'uploadTextureLevel'.
+GLuint allocateTexture(Texture const& tex, int& firstResident)
+{
+  auto const levelCount = (int)tex.levels.size();
+
+  // mipmaps generated by the driver: no placeholder
+  if(levelCount <= 1)
+  {
+    firstResident = 0;
+    return uploadTextureToGPU(tex);
+  }
+
+  GLuint texture;
+
+  glGenTextures(1, &texture);
+
+  glBindTexture(GL_TEXTURE_2D, texture);
+
+  auto const internalFormat = tex.format == TextureFormat::Rgba8 ? GL_RGBA8 : getGlFormat(tex.format);
+  SAFE_GL(glTexStorage2D(GL_TEXTURE_2D, levelCount, internalFormat, tex.dim.width, tex.dim.height));
+
+  firstResident = levelCount - 1;
+
+  while(firstResident > 0 && max(tex.dim.width, tex.dim.height) >> (firstResident - 1) <= PLACEHOLDER_MAX_SIZE)
+    --firstResident;
+
+  for(int i = levelCount - 1; i >= firstResident; --i)
+  {
+    auto const width = max(1, tex.dim.width >> i);
+    auto const height = max(1, tex.dim.height >> i);
+    auto& level = tex.levels[i];
+
+    if(tex.format == TextureFormat::Rgba8)
+      SAFE_GL(glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, level.data()));
+    else
+      SAFE_GL(glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, width, height, internalFormat, (GLsizei)level.size(), level.data()));
+  }
+
+  // the missing levels aren't sampled
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstResident);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return texture;
+}
+
+// Fills a level of a texture from 'allocateTexture', and starts sampling it.
+// The levels must arrive from the smallest to the largest.
+// 'pixels': an offset in the bound GL_PIXEL_UNPACK_BUFFER.
+void uploadTextureLevel(GLuint texture, Texture const& tex, int i, intptr_t pixels)
+{
+  auto const width = max(1, tex.dim.width >> i);
+  auto const height = max(1, tex.dim.height >> i);
+  auto const data = (void const*)pixels;
+
+  glBindTexture(GL_TEXTURE_2D, texture);
+
+  if(tex.format == TextureFormat::Rgba8)
+    SAFE_GL(glTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data));
+  else
+    SAFE_GL(glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, width, height, getGlFormat(tex.format), (GLsizei)tex.levels[i].size(), data));
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, i);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
 int loadTexture(const char* path)
 {
   auto pic = loadPicture(path);
   return uploadTextureToGPU(pic);
 }
 
+// FNV-1a
+uint64_t hashBytes(uint64_t hash, void const* data, size_t len)
+{
+  auto bytes = (uint8_t const*)data;
+
+  for(size_t i = 0; i < len; ++i)
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+
+  return hash;
+}
+
+// Linked programs are cached on disk, in the driver's own binary format,
+// keyed by the driver and the sources: any change misses the cache.
+// Empty if there's no cache (e.g WebGL has no program binaries).
+string getProgramCachePath(Span<uint8_t> vsCode, Span<uint8_t> fsCode)
+{
+#ifdef __EMSCRIPTEN__
+  (void)vsCode;
+  (void)fsCode;
+  return "";
+#else
+  GLint formatCount = 0;
+  SAFE_GL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount));
+
+  if(formatCount <= 0)
+    return "";
+
+  static string const dir = [] ()
+    {
+      auto path = SDL_GetPrefPath("coiil", "coiil");
+
+      if(!path)
+        return string();
+
+      auto r = string(path);
+      SDL_free(path);
+      return r;
+    } ();
+
+  if(dir.empty())
+    return "";
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+
+  for(auto name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+  {
+    auto const str = (char const*)glGetString(name);
+    hash = hashBytes(hash, str, strlen(str) + 1);
+  }
+
+  hash = hashBytes(hash, vsCode.data, vsCode.len);
+  hash = hashBytes(hash, fsCode.data, fsCode.len);
+
+  char name[64];
+  snprintf(name, sizeof name, "program-%016llx.bin", (unsigned long long)hash);
+  return dir + name;
+#endif
+}
+
+// Returns 0 if the driver rejects the binary (e.g it was updated).
+GLuint loadProgramBinary(string const& data)
+{
+  GLenum format;
+
+  if(data.size() <= sizeof format)
+    return 0;
+
+  memcpy(&format, data.data(), sizeof format);
+
+  auto const progId = glCreateProgram();
+  glProgramBinary(progId, format, data.data() + sizeof format, GLsizei(data.size() - sizeof format));
+
+  // an unknown format is reported as an error
+  clearGlErrors();
+
+  GLint linked = GL_FALSE;
+  SAFE_GL(glGetProgramiv(progId, GL_LINK_STATUS, &linked));
+
+  if(!linked)
+  {
+    SAFE_GL(glDeleteProgram(progId));
+    return 0;
+  }
+
+  return progId;
+}
+
+// binary format, then binary
+string getProgramBinary(GLuint progId)
+{
+  GLint len = 0;
+  SAFE_GL(glGetProgramiv(progId, GL_PROGRAM_BINARY_LENGTH, &len));
+
+  if(len <= 0)
+    return "";
+
+  GLenum format;
+  string data(sizeof format + len, 0);
+  SAFE_GL(glGetProgramBinary(progId, len, nullptr, &format, &data[sizeof format]));
+  memcpy(&data[0], &format, sizeof format);
+
+  return data;
+}
+
 GLuint loadShaders(Span<uint8_t> vsCode, Span<uint8_t> fsCode)
 {
+  auto const cachePath = getProgramCachePath(vsCode, fsCode);
+
+  if(!cachePath.empty() && File::exists(cachePath))
+  {
+    if(auto const progId = loadProgramBinary(File::read(cachePath)))
+    {
+      printf("[display] loaded cached program\n");
+      return progId;
+    }
+
+    printf("[display] cached program rejected by the driver\n");
+  }
+
   auto const vertexId = compileShader(vsCode, GL_VERTEX_SHADER);
   auto const fragmentId = compileShader(fsCode, GL_FRAGMENT_SHADER);
 
@@ -175,33 +521,183 @@ GLuint loadShaders(Span<uint8_t> vsCode, Span<uint8_t> fsCode)
   SAFE_GL(glDeleteShader(vertexId));
   SAFE_GL(glDeleteShader(fragmentId));
 
+  if(!cachePath.empty())
+  {
+    auto const binary = getProgramBinary(progId);
+
+    try
+    {
+      if(!binary.empty())
+        File::write(cachePath, { (uint8_t const*)binary.data(), (int)binary.size() });
+    }
+    catch(exception const& e)
+    {
+      printf("[display] can't cache program: %s\n", e.what());
+    }
+  }
+
   return progId;
 }
 
-struct Camera
+bool isSameCamera(Camera const& a, Camera const& b)
+{
+  return a.pos.x == b.pos.x && a.pos.y == b.pos.y && a.pos.z == b.pos.z
+         && a.dir.v.x == b.dir.v.x && a.dir.v.y == b.dir.v.y && a.dir.v.z == b.dir.v.z
+         && a.dir.s == b.dir.s;
+}
+
+// vertical field of view of the cameras
+auto const FOVY = (float)((60.0f / 180) * PI);
+
+// An instance of a model, drawn by 'drawActor'
+struct ActorState
+{
+  Vector3f pos = Vector3f(0, 0, 0); // of the center of its bounds
+  int lod = 0; // see 'RenderMesh::selectLod'
+  int query = -1; // see 'OpenglDisplay::isOccluded'
+  bool occluded = false;
+};
+
+// shader attribute/uniform locations
+struct MeshShader
 {
-  Vector3f pos;
-  Quaternion dir;
-  bool valid = false;
+  GLuint programId;
+  GLint DiffuseTex;
+  GLint LightmapTex;
+  GLint positionLoc;
+  GLint uvDiffuseLoc;
+  GLint uvLightmapLoc;
+  GLint normalLoc;
+  GLint instanceMLoc;
+  GLint instanceFragOffsetLoc;
+
+  static auto constexpr INSTANCE_M_LOCATIONS = 4; // a mat4 takes one per column
+  static auto constexpr VIEW_BINDING = 0; // uniform buffer binding of 'ViewConstants'
 };
 
-struct DrawCommand
+int64_t getVertexBytes(RenderMesh const& mesh)
+{
+  int64_t r = 0;
+
+  for(auto& model : mesh.singleMeshes)
+    r += sizeof(model.vertices[0]) * model.vertices.size() + sizeof(model.indices[0]) * model.indices.size();
+
+  return r;
+}
+
+// what 'mesh' keeps on the CPU
+int64_t getMeshBytes(RenderMesh const& mesh)
+{
+  int64_t r = sizeof(mesh) + mesh.singleMeshes.capacity() * sizeof(mesh.singleMeshes[0]);
+
+  for(auto& model : mesh.singleMeshes)
+    r += sizeof(model.vertices[0]) * model.vertices.capacity() + sizeof(model.indices[0]) * model.indices.capacity();
+
+  return r;
+}
+
+// The 6 planes (ax + by + cz + d >= 0 inside) of the frustum of 'VP'
+struct Frustum
 {
-  SingleRenderMesh* pMesh;
-  Rect3f where;
-  Quaternion orientation;
-  Camera camera;
-  bool blinking;
-  bool depthtest;
+  Frustum() = default;
+
+  explicit Frustum(Matrix4f const& VP)
+  {
+    auto row = [&] (int i, float sign, float* r)
+      {
+        for(int col = 0; col < 4; ++col)
+          r[col] = VP[col][3] + sign * VP[col][i];
+      };
+
+    for(int i = 0; i < 3; ++i)
+    {
+      row(i, +1, planes[i * 2 + 0]);
+      row(i, -1, planes[i * 2 + 1]);
+    }
+  }
+
+  // 'M' transforms the box [boxMin; boxMax] to world space
+  bool touches(Matrix4f const& M, Vector3f boxMin, Vector3f boxMax) const
+  {
+    // world space bounding box of the transformed box: center, half extents
+    auto const localCenter = (boxMin + boxMax) * 0.5;
+    auto const localHalf = (boxMax - boxMin) * 0.5;
+
+    float center[3];
+    float half[3];
+
+    for(int row = 0; row < 3; ++row)
+    {
+      center[row] = M[0][row] * localCenter.x + M[1][row] * localCenter.y + M[2][row] * localCenter.z + M[3][row];
+      half[row] = abs(M[0][row]) * localHalf.x + abs(M[1][row]) * localHalf.y + abs(M[2][row]) * localHalf.z;
+    }
+
+    for(auto& p : planes)
+    {
+      auto const dist = p[0] * center[0] + p[1] * center[1] + p[2] * center[2] + p[3];
+      auto const radius = abs(p[0]) * half[0] + abs(p[1]) * half[1] + abs(p[2]) * half[2];
+
+      if(dist < -radius)
+        return false;
+    }
+
+    return true;
+  }
+
+  float planes[6][4];
 };
 
-void uploadVerticesToGPU(RenderMesh& mesh)
+// Records in the bound vertex array the layout of the vertices of the
+// bound GL_ARRAY_BUFFER. The instance attributes are only enabled: their
+// buffer is bound per draw.
+void setVertexLayout(MeshShader const& shader)
+{
+  SAFE_GL(glEnableVertexAttribArray(shader.positionLoc));
+  SAFE_GL(glEnableVertexAttribArray(shader.normalLoc));
+  SAFE_GL(glEnableVertexAttribArray(shader.uvDiffuseLoc));
+  SAFE_GL(glEnableVertexAttribArray(shader.uvLightmapLoc));
+
+  // the normal is decoded by the shader, the rest by the attribute fetch
+#define OFFSET(a) (void*)(&(((SingleRenderMesh::PackedVertex*)nullptr)->a))
+  SAFE_GL(glVertexAttribPointer(shader.positionLoc, 3, GL_FLOAT, GL_FALSE, sizeof(SingleRenderMesh::PackedVertex), OFFSET(x)));
+  SAFE_GL(glVertexAttribPointer(shader.normalLoc, 2, GL_SHORT, GL_TRUE, sizeof(SingleRenderMesh::PackedVertex), OFFSET(normal)));
+  SAFE_GL(glVertexAttribPointer(shader.uvDiffuseLoc, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(SingleRenderMesh::PackedVertex), OFFSET(diffuse)));
+  SAFE_GL(glVertexAttribPointer(shader.uvLightmapLoc, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(SingleRenderMesh::PackedVertex), OFFSET(lightmap)));
+#undef OFFSET
+
+  for(int i = 0; i < MeshShader::INSTANCE_M_LOCATIONS; ++i)
+  {
+    SAFE_GL(glEnableVertexAttribArray(shader.instanceMLoc + i));
+    SAFE_GL(glVertexAttribDivisor(shader.instanceMLoc + i, 1));
+  }
+
+  SAFE_GL(glEnableVertexAttribArray(shader.instanceFragOffsetLoc));
+  SAFE_GL(glVertexAttribDivisor(shader.instanceFragOffsetLoc, 1));
+}
+
+// Also records the vertex layout of each single mesh in its vertex array.
+void uploadVerticesToGPU(RenderMesh& mesh, MeshShader const& shader)
 {
+  GLint previousVertexArray;
+  SAFE_GL(glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray));
+
   for(auto& model : mesh.singleMeshes)
   {
+    SAFE_GL(glGenVertexArrays(1, &model.vertexArray));
+    SAFE_GL(glBindVertexArray(model.vertexArray));
+
     SAFE_GL(glGenBuffers(1, &model.buffer));
     SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, model.buffer));
     SAFE_GL(glBufferData(GL_ARRAY_BUFFER, sizeof(model.vertices[0]) * model.vertices.size(), model.vertices.data(), GL_STATIC_DRAW));
+
+    // part of the vertex array state
+    SAFE_GL(glGenBuffers(1, &model.indexBuffer));
+    SAFE_GL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.indexBuffer));
+    SAFE_GL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(model.indices[0]) * model.indices.size(), model.indices.data(), GL_STATIC_DRAW));
+
+    setVertexLayout(shader);
+
+    SAFE_GL(glBindVertexArray(previousVertexArray));
     SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
   }
 }
@@ -240,7 +736,10 @@ std::vector<RenderMesh> loadFontModels(const char* path, int COLS, int ROWS)
     sm.lightmap = lightmap;
 
     for(auto& v : vertices)
-      sm.vertices.push_back(v);
+    {
+      sm.indices.push_back(sm.vertices.size());
+      sm.vertices.push_back(packVertex(v));
+    }
 
     RenderMesh rm {};
     rm.singleMeshes.push_back(sm);
@@ -265,154 +764,453 @@ void printOpenGlVersion()
          notNull(sLangVersion));
 }
 
+#if CHECK_GL
+// Reports the errors through KHR_debug, if available.
+void enableDebugOutput()
+{
+  typedef void (APIENTRY * DebugMessageCallback)(GLDEBUGPROCKHR callback, const void* userParam);
+  auto const GL_DEBUG_OUTPUT_KHR = 0x92E0;
+  auto const GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR = 0x8242;
+
+  if(!hasExtension("GL_KHR_debug"))
+    return;
+
+  auto debugMessageCallback = (DebugMessageCallback)SDL_GL_GetProcAddress("glDebugMessageCallbackKHR");
+
+  if(!debugMessageCallback)
+    return;
+
+  SAFE_GL(glEnable(GL_DEBUG_OUTPUT_KHR));
+  SAFE_GL(glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR));
+  SAFE_GL(debugMessageCallback(&onDebugMessage, nullptr));
+  g_hasDebugOutput = true;
+
+  printf("[display] Checking OpenGL errors with KHR_debug\n");
+}
+#endif
+
 template<typename T>
 T blend(T a, T b, float alpha)
 {
   return a * (1 - alpha) + b * alpha;
 }
 
-struct PostProcessing
+// GPU time of the render passes, if the driver has timer queries.
+// The results are read a few frames later: the queries never stall.
+struct GpuTimer
 {
-  PostProcessing(Size2i resolution)
-    : m_resolution(resolution)
+  enum Pass
   {
-    {
-      m_hdrShader.programId = loadShaders(HdrVertexShaderCode, HdrFragmentShaderCode);
+    Scene,
+    BloomThreshold,
+    BloomBlur,
+    HdrResolve,
+    PassCount,
+  };
 
-      m_hdrShader.InputTex1 = safeGetUniformLocation(m_hdrShader.programId, "InputTex1");
-      m_hdrShader.InputTex2 = safeGetUniformLocation(m_hdrShader.programId, "InputTex2");
-      m_hdrShader.TimeLoc = safeGetUniformLocation(m_hdrShader.programId, "Time");
-      m_hdrShader.positionLoc = safeGetAttributeLocation(m_hdrShader.programId, "vertexPos_model");
-      m_hdrShader.uvLoc = safeGetAttributeLocation(m_hdrShader.programId, "vertexUV");
-    }
+  GpuTimer()
+  {
+    if(hasExtension("GL_EXT_disjoint_timer_query") || hasExtension("GL_EXT_disjoint_timer_query_webgl2"))
+      getQueryObjectui64v = (GetQueryObjectui64v)SDL_GL_GetProcAddress("glGetQueryObjectui64vEXT");
 
-    {
-      m_bloomShader.programId = loadShaders(BloomVertexShaderCode, BloomFragmentShaderCode);
+    if(!getQueryObjectui64v)
+      return;
 
-      m_bloomShader.InputTex = safeGetUniformLocation(m_bloomShader.programId, "InputTex");
-      m_bloomShader.IsThreshold = safeGetUniformLocation(m_bloomShader.programId, "IsThreshold");
-      m_bloomShader.positionLoc = safeGetAttributeLocation(m_bloomShader.programId, "vertexPos_model");
-      m_bloomShader.uvLoc = safeGetAttributeLocation(m_bloomShader.programId, "vertexUV");
-    }
+    for(auto& frame : m_queries)
+      SAFE_GL(glGenQueries(PassCount, frame.ids));
+  }
 
-    SAFE_GL(glGenBuffers(1, &m_hdrQuadVbo));
+  ~GpuTimer()
+  {
+    if(getQueryObjectui64v)
+      for(auto& frame : m_queries)
+        SAFE_GL(glDeleteQueries(PassCount, frame.ids));
+  }
 
-    {
-      SAFE_GL(glGenFramebuffers(1, &m_hdrFramebuffer));
-      SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, m_hdrFramebuffer));
+  // Only one pass can be timed at a time.
+  void begin(Pass pass)
+  {
+    if(!getQueryObjectui64v)
+      return;
 
-      // color buffer
-      {
-        SAFE_GL(glGenTextures(1, &m_hdrTexture));
-        SAFE_GL(glBindTexture(GL_TEXTURE_2D, m_hdrTexture));
-        SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, resolution.width, resolution.height, 0, GL_RGBA, GL_FLOAT, nullptr));
-        SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-        SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-        SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-        SAFE_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_hdrTexture, 0));
-      }
+    auto& frame = m_queries[m_frame % FRAMES_IN_FLIGHT];
+    SAFE_GL(glBeginQuery(GL_TIME_ELAPSED_EXT, frame.ids[pass]));
+    frame.issued[pass] = true;
+  }
+
+  void end()
+  {
+    if(getQueryObjectui64v)
+      SAFE_GL(glEndQuery(GL_TIME_ELAPSED_EXT));
+  }
+
+  // Collects the results of the oldest frame, whose queries are reused next.
+  void endFrame()
+  {
+    if(!getQueryObjectui64v)
+      return;
+
+    ++m_frame;
 
-      // depth buffer
+    // e.g the GPU changed frequency: the results in flight are meaningless
+    GLint disjoint = 0;
+    SAFE_GL(glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint));
+
+    auto& frame = m_queries[m_frame % FRAMES_IN_FLIGHT];
+
+    float frameMs = 0;
+    bool complete = !disjoint;
+
+    for(int pass = 0; pass < PassCount; ++pass)
+    {
+      if(!frame.issued[pass])
+        continue;
+
+      frame.issued[pass] = false;
+
+      GLuint available = 0;
+      SAFE_GL(glGetQueryObjectuiv(frame.ids[pass], GL_QUERY_RESULT_AVAILABLE, &available));
+
+      if(!available || disjoint)
       {
-        SAFE_GL(glGenTextures(1, &m_hdrDepthTexture));
-        SAFE_GL(glBindTexture(GL_TEXTURE_2D, m_hdrDepthTexture));
-        SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, resolution.width, resolution.height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL));
-        SAFE_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_hdrDepthTexture, 0));
+        complete = false;
+        continue;
       }
+
+      GLuint64 ns = 0;
+      getQueryObjectui64v(frame.ids[pass], GL_QUERY_RESULT, &ns);
+      frameMs += ns / 1000000.0f;
+
+      // a running average, over roughly the last second
+      auto& avg = m_averageMs[pass];
+      avg = blend(avg, ns / 1000000.0f, 0.02f);
+    }
+
+    for(int pass = 0; pass < PassCount; ++pass)
+      m_timings[pass] = { PASS_NAMES[pass], m_averageMs[pass] };
+
+    m_lastFrameMs = complete ? frameMs : -1;
+  }
+
+  // GPU time of all the passes of the oldest frame, unsmoothed.
+  // Negative if unknown.
+  float getLastFrameMs() const
+  {
+    return m_lastFrameMs;
+  }
+
+  // empty without timer queries
+  Span<const Display::PassTiming> getTimings() const
+  {
+    if(!getQueryObjectui64v)
+      return {};
+
+    return m_timings;
+  }
+
+private:
+  typedef void (APIENTRYP GetQueryObjectui64v)(GLuint id, GLenum pname, GLuint64* params);
+  GetQueryObjectui64v getQueryObjectui64v = nullptr;
+
+  static auto constexpr GL_TIME_ELAPSED_EXT = 0x88BF;
+  static auto constexpr GL_GPU_DISJOINT_EXT = 0x8FBB;
+
+  static auto constexpr FRAMES_IN_FLIGHT = 4;
+
+  static constexpr char const* PASS_NAMES[PassCount] = { "scene", "threshold", "blur", "hdr" };
+
+  struct FrameQueries
+  {
+    GLuint ids[PassCount] {};
+    bool issued[PassCount] {};
+  };
+
+  FrameQueries m_queries[FRAMES_IN_FLIGHT];
+  int m_frame = 0;
+  float m_averageMs[PassCount] {};
+  float m_lastFrameMs = -1;
+  Display::PassTiming m_timings[PassCount] {};
+};
+
+constexpr char const* GpuTimer::PASS_NAMES[];
+
+// For the data uploaded each frame (instances, text, view constants):
+// each upload is appended after the previous ones, until the buffer is full.
+// Then the storage is orphaned: the driver gives a new one, and keeps the
+// old one alive until the GPU is done with it. The writes never touch
+// what might be in use, so they need no synchronization, nor fences.
+// The draws read the data of a whole frame, through the offsets of its
+// pushes: these must all land in the same storage (see 'beginFrame').
+struct StreamBuffer
+{
+  StreamBuffer()
+  {
+    SAFE_GL(glGenBuffers(1, &id));
+  }
+
+  ~StreamBuffer()
+  {
+    SAFE_GL(glDeleteBuffers(1, &id));
+  }
+
+  // Before the first push of a frame, with an upper bound of the bytes it
+  // pushes, alignment padding included. Orphans the storage now, if needed:
+  // never between two pushes of the same frame.
+  void beginFrame(int bytes)
+  {
+    if(m_used + bytes > m_capacity)
+    {
+      SAFE_GL(glBindBuffer(GL_COPY_WRITE_BUFFER, id));
+      orphan(bytes);
+      SAFE_GL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    }
+
+    m_frameEnd = m_used + bytes;
+  }
+
+  // Returns the offset of the copy of 'data' in the buffer, a multiple of 'alignment'.
+  // Don't mix index data with the rest: WebGL forbids it.
+  int push(void const* data, int bytes, int alignment)
+  {
+    auto offset = (m_used + alignment - 1) / alignment * alignment;
+
+    // not bound to its real target: binding an index buffer would change
+    // the current vertex array
+    SAFE_GL(glBindBuffer(GL_COPY_WRITE_BUFFER, id));
+
+    // within a frame, the bound given to 'beginFrame' must hold
+    assert(m_frameEnd < 0 || offset + bytes <= m_frameEnd);
+
+    if(offset + bytes > m_capacity)
+    {
+      orphan(bytes);
+      offset = 0;
     }
 
-    for(int k = 0; k < 2; ++k)
+    if(bytes > 0)
     {
-      SAFE_GL(glGenFramebuffers(1, &m_bloomFramebuffer[k]));
-      SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, m_bloomFramebuffer[k]));
+#ifdef __EMSCRIPTEN__
+      // no buffer mapping in WebGL
+      SAFE_GL(glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data));
+#else
+      auto const flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+      auto const dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, bytes, flags);
 
-      // color buffer
-      {
-        SAFE_GL(glGenTextures(1, &m_bloomTexture[k]));
-        SAFE_GL(glBindTexture(GL_TEXTURE_2D, m_bloomTexture[k]));
-        SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, resolution.width, resolution.height, 0, GL_RGBA, GL_FLOAT, nullptr));
-        SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
-        SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
-        SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
-        SAFE_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_bloomTexture[k], 0));
-      }
+      if(!dst)
+        throw runtime_error("Can't map the stream buffer");
+
+      memcpy(dst, data, bytes);
+      SAFE_GL(glUnmapBuffer(GL_COPY_WRITE_BUFFER));
+#endif
     }
+
+    SAFE_GL(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+
+    m_used = offset + bytes;
+    return offset;
   }
 
-  ~PostProcessing()
+  GLuint id = 0;
+
+private:
+  // the buffer must be bound to GL_COPY_WRITE_BUFFER
+  void orphan(int bytes)
   {
-    SAFE_GL(glDeleteBuffers(1, &m_hdrQuadVbo));
-    SAFE_GL(glDeleteFramebuffers(1, &m_hdrFramebuffer));
+    m_capacity = max(INITIAL_CAPACITY, max(m_capacity, bytes * 2));
+    SAFE_GL(glBufferData(GL_COPY_WRITE_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW));
+    m_used = 0;
   }
 
-  void applyBloomFilter()
+  int m_capacity = 0;
+  int m_used = 0;
+  int m_frameEnd = -1; // see 'beginFrame'. -1: each push is used before the next one
+
+  static auto constexpr INITIAL_CAPACITY = 1024 * 1024;
+};
+
+struct PostProcessing
+{
+  PostProcessing(Size2i resolution)
+    : m_resolution(resolution)
   {
-    SAFE_GL(glViewport(0, 0, m_resolution.width, m_resolution.height));
+    {
+      m_hdrShader.programId = loadShaders(HdrVertexShaderCode, HdrFragmentShaderCode);
 
-    SAFE_GL(glUseProgram(m_bloomShader.programId));
-    SAFE_GL(glDisable(GL_DEPTH_TEST));
+      m_hdrShader.InputTex1 = safeGetUniformLocation(m_hdrShader.programId, "InputTex1");
+      m_hdrShader.InputTex2 = safeGetUniformLocation(m_hdrShader.programId, "InputTex2");
+      m_hdrShader.TimeLoc = safeGetUniformLocation(m_hdrShader.programId, "Time");
+      m_hdrShader.SceneUvScaleLoc = safeGetUniformLocation(m_hdrShader.programId, "SceneUvScale");
+      m_hdrShader.SceneUvMaxLoc = safeGetUniformLocation(m_hdrShader.programId, "SceneUvMax");
+      m_hdrShader.positionLoc = safeGetAttributeLocation(m_hdrShader.programId, "vertexPos_model");
+      m_hdrShader.uvLoc = safeGetAttributeLocation(m_hdrShader.programId, "vertexUV");
+    }
 
-    struct QuadVertex
     {
-      float x, y, u, v;
-    };
+      m_bloomShader.programId = loadShaders(BloomVertexShaderCode, BloomFragmentShaderCode);
 
-    static const QuadVertex screenQuad[] =
+      m_bloomShader.InputTex = safeGetUniformLocation(m_bloomShader.programId, "InputTex");
+      m_bloomShader.PassLoc = safeGetUniformLocation(m_bloomShader.programId, "Pass");
+      m_bloomShader.StepLoc = safeGetUniformLocation(m_bloomShader.programId, "Step");
+      m_bloomShader.UvScaleLoc = safeGetUniformLocation(m_bloomShader.programId, "UvScale");
+      m_bloomShader.positionLoc = safeGetAttributeLocation(m_bloomShader.programId, "vertexPos_model");
+      m_bloomShader.uvLoc = safeGetAttributeLocation(m_bloomShader.programId, "vertexUV");
+    }
+
+    // the screen quad, uploaded once for all the passes
     {
-      { -1, -1, 0, 0 },
-      { +1, +1, 1, 1 },
-      { -1, +1, 0, 1 },
+      static const QuadVertex screenQuad[] =
+      {
+        { -1, -1, 0, 0 },
+        { +1, +1, 1, 1 },
+        { -1, +1, 0, 1 },
 
-      { -1, -1, 0, 0 },
-      { +1, -1, 1, 0 },
-      { +1, +1, 1, 1 },
-    };
+        { -1, -1, 0, 0 },
+        { +1, -1, 1, 0 },
+        { +1, +1, 1, 1 },
+      };
 
-    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, m_hdrQuadVbo));
-    SAFE_GL(glBufferData(GL_ARRAY_BUFFER, sizeof screenQuad, screenQuad, GL_STATIC_DRAW));
+      SAFE_GL(glGenBuffers(1, &m_quadVbo));
+      SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, m_quadVbo));
+      SAFE_GL(glBufferData(GL_ARRAY_BUFFER, sizeof screenQuad, screenQuad, GL_STATIC_DRAW));
 
-    SAFE_GL(glEnableVertexAttribArray(m_bloomShader.positionLoc));
-    SAFE_GL(glEnableVertexAttribArray(m_bloomShader.uvLoc));
+      m_hdrVertexArray = createQuadVertexArray(m_hdrShader.positionLoc, m_hdrShader.uvLoc);
+      m_bloomVertexArray = createQuadVertexArray(m_bloomShader.positionLoc, m_bloomShader.uvLoc);
 
-#define OFFSET(a) (void*)(&(((QuadVertex*)nullptr)->a))
-    SAFE_GL(glVertexAttribPointer(m_bloomShader.positionLoc, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), OFFSET(x)));
-    SAFE_GL(glVertexAttribPointer(m_bloomShader.uvLoc, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), OFFSET(u)));
-#undef OFFSET
-    auto oneBlurringPass = [&] (GLuint inputTex, GLuint outputFramebuffer, bool isThreshold = false)
+      SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    }
+
+    createColorTarget(resolution, m_hdrFramebuffer, m_hdrTexture);
+
+    // depth buffer
+    {
+      SAFE_GL(glGenTextures(1, &m_hdrDepthTexture));
+      SAFE_GL(glBindTexture(GL_TEXTURE_2D, m_hdrDepthTexture));
+      SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, resolution.width, resolution.height, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL));
+      SAFE_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_hdrDepthTexture, 0));
+    }
+
+    // the bloom starts at half resolution
+    auto size = resolution;
+
+    // RGBA16F color, 24-bit depth + 8-bit stencil
+    int64_t targetBytes = int64_t(resolution.width) * resolution.height * (8 + 4);
+
+    for(auto& level : m_bloomLevels)
+    {
+      size = Size2i(max(1, size.width / 2), max(1, size.height / 2));
+      level.size = size;
+
+      for(int k = 0; k < 2; ++k)
+        createColorTarget(size, level.framebuffer[k], level.texture[k]);
+
+      targetBytes += int64_t(size.width) * size.height * 8 * 2;
+    }
+
+    m_targetMemory.set(targetBytes);
+  }
+
+  ~PostProcessing()
+  {
+    SAFE_GL(glDeleteVertexArrays(1, &m_hdrVertexArray));
+    SAFE_GL(glDeleteVertexArrays(1, &m_bloomVertexArray));
+    SAFE_GL(glDeleteBuffers(1, &m_quadVbo));
+    SAFE_GL(glDeleteFramebuffers(1, &m_hdrFramebuffer));
+    SAFE_GL(glDeleteTextures(1, &m_hdrTexture));
+    SAFE_GL(glDeleteTextures(1, &m_hdrDepthTexture));
+
+    for(auto& level : m_bloomLevels)
+    {
+      SAFE_GL(glDeleteFramebuffers(2, level.framebuffer));
+      SAFE_GL(glDeleteTextures(2, level.texture));
+    }
+  }
+
+  // Leaves the bloom in 'm_bloomLevels[0].texture[0]'.
+  // 'sceneSize': the part of the HDR buffer the scene was drawn to.
+  // Threshold at half resolution, then each level is a downsampling of the
+  // previous one, blurred by two separable passes. Last, each level is
+  // added to the one above it: the wide blurs of the small levels spread
+  // the bloom at little cost.
+  void applyBloomFilter(GpuTimer& timer, Size2i sceneSize)
+  {
+    PROFILE_SCOPE("PostProcessing::applyBloomFilter");
+
+    SAFE_GL(glUseProgram(m_bloomShader.programId));
+    SAFE_GL(glBindVertexArray(m_bloomVertexArray));
+    SAFE_GL(glDisable(GL_DEPTH_TEST));
+
+    // Texture Unit 0
+    SAFE_GL(glActiveTexture(GL_TEXTURE0));
+    SAFE_GL(glUniform1i(m_bloomShader.InputTex, 0));
+
+    auto pass = [&] (GLuint inputTex, GLuint outputFramebuffer, Size2i outputSize, BloomPass type, Vector2f step = Vector2f(0, 0))
       {
-        SAFE_GL(glUniform1i(m_bloomShader.IsThreshold, isThreshold));
+        auto const uvScale = type == BloomPass::Threshold ? getSceneUvScale(sceneSize) : Vector2f(1, 1);
 
-        // Texture Unit 0
-        SAFE_GL(glActiveTexture(GL_TEXTURE0));
+        SAFE_GL(glUniform1i(m_bloomShader.PassLoc, (int)type));
+        SAFE_GL(glUniform2f(m_bloomShader.UvScaleLoc, uvScale.x, uvScale.y));
+        SAFE_GL(glUniform2f(m_bloomShader.StepLoc, step.x, step.y));
         SAFE_GL(glBindTexture(GL_TEXTURE_2D, inputTex));
-        SAFE_GL(glUniform1i(m_bloomShader.InputTex, 0));
 
         SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer));
+        SAFE_GL(glViewport(0, 0, outputSize.width, outputSize.height));
         SAFE_GL(glDrawArrays(GL_TRIANGLES, 0, 6));
       };
 
-    oneBlurringPass(m_hdrTexture, m_bloomFramebuffer[0], true);
-    oneBlurringPass(m_bloomTexture[0], m_bloomFramebuffer[1]);
-    oneBlurringPass(m_bloomTexture[1], m_bloomFramebuffer[0]);
-    oneBlurringPass(m_bloomTexture[0], m_bloomFramebuffer[1]);
-    oneBlurringPass(m_bloomTexture[1], m_bloomFramebuffer[0]);
-    oneBlurringPass(m_bloomTexture[0], m_bloomFramebuffer[1]);
-    oneBlurringPass(m_bloomTexture[1], m_bloomFramebuffer[0]);
+    // the bilinear fetch between 4 texels averages them: downsamples
+    // are a single fetch
+    auto& top = m_bloomLevels[0];
+    timer.begin(GpuTimer::BloomThreshold);
+    pass(m_hdrTexture, top.framebuffer[0], top.size, BloomPass::Threshold);
+    timer.end();
 
-    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    timer.begin(GpuTimer::BloomBlur);
+
+    for(int i = 0; i < BLOOM_LEVELS; ++i)
+    {
+      auto& level = m_bloomLevels[i];
+
+      if(i > 0)
+        pass(m_bloomLevels[i - 1].texture[0], level.framebuffer[0], level.size, BloomPass::Copy);
+
+      auto const texel = Vector2f(1.0f / level.size.width, 1.0f / level.size.height);
+      pass(level.texture[0], level.framebuffer[1], level.size, BloomPass::Blur, Vector2f(texel.x, 0));
+      pass(level.texture[1], level.framebuffer[0], level.size, BloomPass::Blur, Vector2f(0, texel.y));
+    }
+
+    SAFE_GL(glBlendFunc(GL_ONE, GL_ONE));
+
+    for(int i = BLOOM_LEVELS - 1; i > 0; --i)
+    {
+      auto& above = m_bloomLevels[i - 1];
+      pass(m_bloomLevels[i].texture[0], above.framebuffer[0], above.size, BloomPass::Copy);
+    }
+
+    SAFE_GL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    timer.end();
   }
 
-  void drawHdrBuffer(Size2i screenSize)
+  // Upscales the scene, when drawn to a part of the HDR buffer.
+  void drawHdrBuffer(Size2i screenSize, Size2i sceneSize)
   {
+    PROFILE_SCOPE("PostProcessing::drawHdrBuffer");
+
     SAFE_GL(glViewport(0, 0, screenSize.width, screenSize.height));
 
     SAFE_GL(glUseProgram(m_hdrShader.programId));
+    SAFE_GL(glBindVertexArray(m_hdrVertexArray));
     SAFE_GL(glDisable(GL_DEPTH_TEST));
 
     SAFE_GL(glUniform1f(m_hdrShader.TimeLoc, SDL_GetTicks() * 0.001));
 
+    // the bilinear fetches must not reach the texels outside of the scene
+    {
+      auto const uvScale = getSceneUvScale(sceneSize);
+      auto const uvMax = Vector2f(uvScale.x - 0.5f / m_resolution.width, uvScale.y - 0.5f / m_resolution.height);
+      SAFE_GL(glUniform2f(m_hdrShader.SceneUvScaleLoc, uvScale.x, uvScale.y));
+      SAFE_GL(glUniform2f(m_hdrShader.SceneUvMaxLoc, uvMax.x, uvMax.y));
+    }
+
     // Texture Unit 0
     SAFE_GL(glActiveTexture(GL_TEXTURE0));
     SAFE_GL(glBindTexture(GL_TEXTURE_2D, m_hdrTexture));
@@ -420,38 +1218,54 @@ struct PostProcessing
 
     // Texture Unit 1
     SAFE_GL(glActiveTexture(GL_TEXTURE1));
-    SAFE_GL(glBindTexture(GL_TEXTURE_2D, m_bloomTexture[0]));
+    SAFE_GL(glBindTexture(GL_TEXTURE_2D, m_bloomLevels[0].texture[0]));
     SAFE_GL(glUniform1i(m_hdrShader.InputTex2, 1));
 
-    struct QuadVertex
-    {
-      float x, y, u, v;
-    };
+    SAFE_GL(glDrawArrays(GL_TRIANGLES, 0, 6));
+  }
 
-    static const QuadVertex screenQuad[] =
-    {
-      { -1, -1, 0, 0 },
-      { +1, +1, 1, 1 },
-      { -1, +1, 0, 1 },
+  Vector2f getSceneUvScale(Size2i sceneSize) const
+  {
+    return Vector2f(float(sceneSize.width) / m_resolution.width, float(sceneSize.height) / m_resolution.height);
+  }
 
-      { -1, -1, 0, 0 },
-      { +1, -1, 1, 0 },
-      { +1, +1, 1, 1 },
-    };
+  struct QuadVertex
+  {
+    float x, y, u, v;
+  };
 
-    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, m_hdrQuadVbo));
-    SAFE_GL(glBufferData(GL_ARRAY_BUFFER, sizeof screenQuad, screenQuad, GL_STATIC_DRAW));
+  // Expects 'm_quadVbo' to be bound.
+  static GLuint createQuadVertexArray(GLint positionLoc, GLint uvLoc)
+  {
+    GLuint r;
+    SAFE_GL(glGenVertexArrays(1, &r));
+    SAFE_GL(glBindVertexArray(r));
 
-    SAFE_GL(glEnableVertexAttribArray(m_hdrShader.positionLoc));
-    SAFE_GL(glEnableVertexAttribArray(m_hdrShader.uvLoc));
+    SAFE_GL(glEnableVertexAttribArray(positionLoc));
+    SAFE_GL(glEnableVertexAttribArray(uvLoc));
 
 #define OFFSET(a) (void*)(&(((QuadVertex*)nullptr)->a))
-    SAFE_GL(glVertexAttribPointer(m_hdrShader.positionLoc, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), OFFSET(x)));
-    SAFE_GL(glVertexAttribPointer(m_hdrShader.uvLoc, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), OFFSET(u)));
+    SAFE_GL(glVertexAttribPointer(positionLoc, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), OFFSET(x)));
+    SAFE_GL(glVertexAttribPointer(uvLoc, 2, GL_FLOAT, GL_FALSE, sizeof(QuadVertex), OFFSET(u)));
 #undef OFFSET
 
-    SAFE_GL(glDrawArrays(GL_TRIANGLES, 0, 6));
-    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    return r;
+  }
+
+  // Leaves 'framebuffer' bound.
+  static void createColorTarget(Size2i size, GLuint& framebuffer, GLuint& texture)
+  {
+    SAFE_GL(glGenFramebuffers(1, &framebuffer));
+    SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+
+    SAFE_GL(glGenTextures(1, &texture));
+    SAFE_GL(glBindTexture(GL_TEXTURE_2D, texture));
+    SAFE_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size.width, size.height, 0, GL_RGBA, GL_FLOAT, nullptr));
+    SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    SAFE_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    SAFE_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0));
   }
 
   struct HdrShader
@@ -460,17 +1274,38 @@ struct PostProcessing
     GLint InputTex1;
     GLint InputTex2;
     GLint TimeLoc;
+    GLint SceneUvScaleLoc;
+    GLint SceneUvMaxLoc;
     GLint positionLoc;
     GLint uvLoc;
   };
 
+  // values of the 'Pass' uniform of the bloom shader
+  enum class BloomPass
+  {
+    Copy = 0,
+    Threshold = 1,
+    Blur = 2,
+  };
+
   struct BloomShader
   {
     GLuint programId;
     GLint InputTex;
     GLint positionLoc;
     GLint uvLoc;
-    GLint IsThreshold;
+    GLint PassLoc;
+    GLint StepLoc;
+    GLint UvScaleLoc;
+  };
+
+  static auto constexpr BLOOM_LEVELS = 3;
+
+  struct BloomLevel
+  {
+    Size2i size;
+    GLuint framebuffer[2] {};
+    GLuint texture[2] {}; // [0]: the level, [1]: between the blur passes
   };
 
   const Size2i m_resolution;
@@ -481,10 +1316,13 @@ struct PostProcessing
   GLuint m_hdrTexture = 0;
   GLuint m_hdrDepthTexture = 0;
 
-  GLuint m_bloomFramebuffer[2] {};
-  GLuint m_bloomTexture[2] {};
+  BloomLevel m_bloomLevels[BLOOM_LEVELS];
+
+  GLuint m_quadVbo = 0;
+  GLuint m_hdrVertexArray = 0;
+  GLuint m_bloomVertexArray = 0;
 
-  GLuint m_hdrQuadVbo = 0;
+  TrackedMemory m_targetMemory { MemoryTag::GpuTargets };
 };
 
 struct OpenglDisplay : Display
@@ -504,6 +1342,11 @@ struct OpenglDisplay : Display
       SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
     }
 
+#if CHECK_GL
+    // some drivers only report the errors of debug contexts
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_DEBUG_FLAG);
+#endif
+
     m_window = SDL_CreateWindow(
       "",
       SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
@@ -514,6 +1357,8 @@ struct OpenglDisplay : Display
     if(!m_window)
       throw runtime_error(string("Can't create SDL window: ") + SDL_GetError());
 
+    m_screenHeight = resolution.height;
+
     // Create our opengl context and attach it to our window
     m_context = SDL_GL_CreateContext(m_window);
 
@@ -525,60 +1370,150 @@ struct OpenglDisplay : Display
 
     printOpenGlVersion();
 
+#if CHECK_GL
+    enableDebugOutput();
+#endif
+
     // This makes our buffer swap syncronized with the monitor's vertical refresh
-    SDL_GL_SetSwapInterval(1);
+    m_vsync = SDL_GL_SetSwapInterval(1) == 0;
 
-    // Create our unique vertex array
-    GLuint VertexArrayID;
-    SAFE_GL(glGenVertexArrays(1, &VertexArrayID));
-    SAFE_GL(glBindVertexArray(VertexArrayID));
+    // Bound when no other is: each mesh has its own, see
+    // 'uploadVerticesToGPU', so do the post-processing passes.
+    SAFE_GL(glGenVertexArrays(1, &m_vertexArray));
+    SAFE_GL(glBindVertexArray(m_vertexArray));
 
     glEnable(GL_BLEND);
     glEnable(GL_CULL_FACE);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    m_fontModel = loadFontModels("res/font.png", 16, 16);
-
-    for(auto& glyph : m_fontModel)
-    {
-      uploadVerticesToGPU(glyph);
-
-      // don't GL_REPEAT fonts
-      for(auto& single : glyph.singleMeshes)
-      {
-        glBindTexture(GL_TEXTURE_2D, single.diffuse);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-      }
-    }
-
     {
       m_meshShader.programId = loadShaders(MeshVertexShaderCode, MeshFragmentShaderCode);
 
-      m_meshShader.CameraPos = safeGetUniformLocation(m_meshShader.programId, "CameraPos");
-      m_meshShader.M = safeGetUniformLocation(m_meshShader.programId, "M");
-      m_meshShader.MVP = safeGetUniformLocation(m_meshShader.programId, "MVP");
       m_meshShader.DiffuseTex = safeGetUniformLocation(m_meshShader.programId, "DiffuseTex");
       m_meshShader.LightmapTex = safeGetUniformLocation(m_meshShader.programId, "LightmapTex");
-      m_meshShader.colorId = safeGetUniformLocation(m_meshShader.programId, "fragOffset");
-      m_meshShader.ambientLoc = safeGetUniformLocation(m_meshShader.programId, "ambientLight");
-      m_meshShader.LightPosLoc = safeGetUniformLocation(m_meshShader.programId, "LightPos");
       m_meshShader.positionLoc = safeGetAttributeLocation(m_meshShader.programId, "vertexPos_model");
       m_meshShader.uvDiffuseLoc = safeGetAttributeLocation(m_meshShader.programId, "vertexUV");
       m_meshShader.uvLightmapLoc = safeGetAttributeLocation(m_meshShader.programId, "vertexUV_lightmap");
       m_meshShader.normalLoc = safeGetAttributeLocation(m_meshShader.programId, "a_normal");
+      m_meshShader.instanceMLoc = safeGetAttributeLocation(m_meshShader.programId, "instanceM");
+      m_meshShader.instanceFragOffsetLoc = safeGetAttributeLocation(m_meshShader.programId, "instanceFragOffset");
+
+      auto const viewBlock = glGetUniformBlockIndex(m_meshShader.programId, "ViewConstants");
+
+      if(viewBlock == GL_INVALID_INDEX)
+        throw runtime_error("Can't get index for uniform block 'ViewConstants'");
+
+      SAFE_GL(glUniformBlockBinding(m_meshShader.programId, viewBlock, MeshShader::VIEW_BINDING));
+    }
+
+    // the attribute locations are fixed in both vertex shaders: the
+    // prepass uses the vertex arrays made for 'm_meshShader'
+    {
+      m_depthProgramId = loadShaders(DepthVertexShaderCode, DepthFragmentShaderCode);
+
+      auto const viewBlock = glGetUniformBlockIndex(m_depthProgramId, "ViewConstants");
+
+      if(viewBlock == GL_INVALID_INDEX)
+        throw runtime_error("Can't get index for uniform block 'ViewConstants' (depth prepass)");
+
+      SAFE_GL(glUniformBlockBinding(m_depthProgramId, viewBlock, MeshShader::VIEW_BINDING));
+    }
+
+    {
+      GLint alignment;
+      SAFE_GL(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+      m_uniformAlignment = alignment;
+      m_viewStride = (sizeof(ViewConstants) + alignment - 1) / alignment * alignment;
+    }
+
+    m_stream = make_unique<StreamBuffer>();
+    m_streamIndices = make_unique<StreamBuffer>();
+    m_streamPixels = make_unique<StreamBuffer>();
+
+    // the glyphs are only copied into 'm_textMesh': they stay on the CPU side
+    m_fontModel = loadFontModels("res/font.png", 16, 16);
+
+    {
+      auto& glyph = m_fontModel[0].singleMeshes[0];
+
+      // don't GL_REPEAT fonts
+      glBindTexture(GL_TEXTURE_2D, glyph.diffuse);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+      m_textMesh.singleMeshes.resize(1);
+
+      auto& text = m_textMesh.singleMeshes[0];
+      text.diffuse = glyph.diffuse;
+      text.lightmap = glyph.lightmap;
+
+      // the vertices and the indices are streamed, see 'uploadTextMesh'
+      SAFE_GL(glGenVertexArrays(1, &text.vertexArray));
+      SAFE_GL(glBindVertexArray(text.vertexArray));
+      SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, m_stream->id));
+      setVertexLayout(m_meshShader);
+      SAFE_GL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_streamIndices->id));
+      SAFE_GL(glBindVertexArray(m_vertexArray));
+      SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    }
+
+    // the bounding boxes of the occlusion queries
+    {
+      m_boxMesh = boxModel();
+
+      auto& box = m_boxMesh.singleMeshes[0];
+      box.boundsMin = Vector3f(-0.5, -0.5, -0.5);
+      box.boundsMax = Vector3f(0.5, 0.5, 0.5);
+      uploadVerticesToGPU(m_boxMesh, m_meshShader);
     }
 
+    if(hasExtension("GL_EXT_texture_compression_s3tc") || hasExtension("GL_WEBGL_compressed_texture_s3tc"))
+      m_cookedTextureExtensions.push_back("bc.tex");
+
+#ifdef __EMSCRIPTEN__
+    auto const etc2 = hasExtension("GL_WEBGL_compressed_texture_etc");
+#else
+    auto const etc2 = true; // core in GLES 3.0
+#endif
+
+    if(etc2)
+      m_cookedTextureExtensions.push_back("etc.tex");
+
+    m_cookedTextureExtensions.push_back("rgba.tex");
+
     m_postProcessing = make_unique<PostProcessing>(resolution);
+    m_gpuTimer = make_unique<GpuTimer>();
 
     printf("[display] init OK\n");
   }
 
   ~OpenglDisplay()
   {
+    // their tasks use this display
+    for(auto& load : m_backgroundLoads)
+      load.second->pool->wait(load.second->done);
+
     SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
 
     m_postProcessing.reset();
+    m_gpuTimer.reset();
+    m_stream.reset();
+    m_streamIndices.reset();
+    m_streamPixels.reset();
+
+    for(auto& capture : m_captures)
+    {
+      if(capture.fence)
+        glDeleteSync(capture.fence);
+
+      SAFE_GL(glDeleteBuffers(1, &capture.buffer));
+    }
+
+    for(auto& single : m_textMesh.singleMeshes)
+      SAFE_GL(glDeleteVertexArrays(1, &single.vertexArray));
+
+    for(auto& query : m_occlusionQueries)
+      SAFE_GL(glDeleteQueries(1, &query.id));
 
     SDL_GL_DeleteContext(m_context);
     SDL_DestroyWindow(m_window);
@@ -613,6 +1548,24 @@ struct OpenglDisplay : Display
     m_enableFsaa = enable;
   }
 
+  void setDepthPrepass(bool enable) override
+  {
+    m_enableDepthPrepass = enable;
+  }
+
+  void setOcclusionCulling(bool enable) override
+  {
+    m_enableOcclusionCulling = enable;
+  }
+
+  void setDynamicResolution(float targetGpuMs, float minScale, float maxScale) override
+  {
+    m_resolutionScaler.targetMs = targetGpuMs;
+    m_resolutionScaler.minScale = minScale;
+    m_resolutionScaler.maxScale = maxScale;
+    m_resolutionScaler.scale = maxScale;
+  }
+
   void setCaption(const char* caption) override
   {
     SDL_SetWindowTitle(m_window, caption);
@@ -620,113 +1573,798 @@ struct OpenglDisplay : Display
 
   void loadModel(int modelId, const char* path) override
   {
-    if((int)m_Models.size() <= modelId)
-      m_Models.resize(modelId + 1);
-
-    m_Models[modelId] = loadRenderMesh(path);
+    Resource const res { ResourceType::Model, modelId, path };
+    loadModels({ &res, 1 }, getSharedThreadPool());
+  }
 
-    int i = 0;
+  void loadModels(Span<const Resource> models, ThreadPool& pool) override
+  {
+    vector<ModelData> data(models.len);
 
-    for(auto& single : m_Models[modelId].singleMeshes)
-    {
-      single.diffuse = loadTexture(setExtension(path, to_string(i) + ".diffuse.png").c_str());
-      single.lightmap = loadTexture(setExtension(path, to_string(i) + ".lightmap.png").c_str());
-      ++i;
-    }
+    // no GL calls here: the workers don't have the context
+    pool.parallelFor(models.len, [&] (int i) { data[i] = readModel(models[i].path); });
+    readTextures(data, pool);
 
-    uploadVerticesToGPU(m_Models[modelId]);
+    for(int i = 0; i < models.len; ++i)
+      uploadModel(models[i].id, models[i].path, data[i]);
   }
 
-  void setCamera(Vector3f pos, Quaternion dir) override
+  bool loadModelInBackground(int modelId, const char* path, ThreadPool& pool) override
   {
-    auto cam = (Camera { pos, dir });
+    auto& load = m_backgroundLoads[modelId];
 
-    if(!m_camera.valid)
+    // started with another path: that one is dropped
+    if(load && load->path != path)
     {
-      m_camera = cam;
-      m_camera.valid = true;
+      load->pool->wait(load->done);
+      load.reset();
     }
 
-    // avoid big camera jumps
+    if(!load)
     {
-      auto delta = m_camera.pos - pos;
-
-      if(dotProduct(delta, delta) > 10)
-        m_camera = cam;
+      load = make_shared<BackgroundLoad>();
+      load->path = path;
+      load->pool = &pool;
+
+      auto task = [this, load] ()
+        {
+          try
+          {
+            vector<ModelData> data(1);
+            data[0] = readModel(load->path.c_str());
+
+            // what's on the GPU now might be gone by the upload
+            readTextures(data, *load->pool, true);
+            load->data = move(data[0]);
+          }
+          catch(exception const& e)
+          {
+            load->error = e.what();
+          }
+        };
+
+      pool.run(task, &load->done, "Display::loadModelInBackground");
     }
 
-    m_camera.pos = blend(m_camera.pos, cam.pos, 0.3);
-    m_camera.dir = cam.dir;
+    if(load->done.pending > 0)
+      return false;
+
+    auto const finished = move(load);
+    m_backgroundLoads.erase(modelId);
+
+    if(!finished->error.empty())
+      throw runtime_error(finished->error);
+
+    uploadModel(modelId, finished->path.c_str(), finished->data);
+    return true;
   }
 
-  void setAmbientLight(float ambientLight) override
+  // A model, read and decoded, ready for upload
+  struct ModelData
   {
-    m_ambientLight = ambientLight;
-  }
+    RenderMesh mesh;
 
-  void beginDraw() override
+    // two per single mesh: diffuse, then lightmap
+    vector<string> texturePaths;
+    vector<Texture> textures; // left empty if already on the GPU
+    vector<uint64_t> contents; // of 'textures', see 'hashTexture'
+  };
+
+  // A model read and decoded by a task of 'loadModelInBackground'
+  struct BackgroundLoad
   {
-    m_frameCount++;
-    m_drawCommands.clear();
-  }
+    string path;
+    ModelData data;
+    string error;
+    JobCounter done;
+    ThreadPool* pool;
+  };
 
-  void endDraw() override
+  // The mesh and the texture paths, see 'readTextures' for the textures.
+  // Can be called from several threads.
+  ModelData readModel(const char* path) const
   {
-    auto screenSize = getCurrentScreenSize();
+    ModelData r;
+    r.mesh = loadRenderMesh(path);
 
-    m_aspectRatio = float(screenSize.width) / screenSize.height;
+    // one lightmap atlas for all the single meshes: a single texture, bound once
+    auto const sharedLightmap = setExtension(path, "lightmap.png");
+    auto const hasSharedLightmap = File::exists(sharedLightmap);
+
+    for(int i = 0; i < (int)r.mesh.singleMeshes.size(); ++i)
+    {
+      r.texturePaths.push_back(setExtension(path, to_string(i) + ".diffuse.png"));
+      r.texturePaths.push_back(hasSharedLightmap ? sharedLightmap : setExtension(path, to_string(i) + ".lightmap.png"));
+    }
+
+    useAtlas(path, r);
+
+    return r;
+  }
+
+  // Moves the textures of 'model' found in the atlas of its directory
+  // (see the meshcooker's 'cookAtlas') to their pages, and its UVs with them.
+  static void useAtlas(string const& path, ModelData& model)
+  {
+    auto const atlasPath = dirName(path) + "/atlas.txt";
+
+    if(!File::exists(atlasPath))
+      return;
+
+    TextureAtlas atlas;
+
+    try
+    {
+      atlas = deserializeAtlas(File::read(atlasPath));
+    }
+    catch(exception const& e)
+    {
+      printf("[display] ignoring atlas '%s': %s\n", atlasPath.c_str(), e.what());
+      return;
+    }
+
+    for(int i = 0; i < (int)model.mesh.singleMeshes.size(); ++i)
+    {
+      auto& single = model.mesh.singleMeshes[i];
+
+      if(auto tile = atlas.find(model.texturePaths[i * 2 + 0]))
+      {
+        if(hasDiffuseInTile(single))
+        {
+          remapDiffuse(single, atlas, *tile);
+          model.texturePaths[i * 2 + 0] = atlas.pages[tile->page].path;
+        }
+      }
+
+      if(auto tile = atlas.find(model.texturePaths[i * 2 + 1]))
+      {
+        remapLightmap(single, atlas, *tile);
+        model.texturePaths[i * 2 + 1] = atlas.pages[tile->page].path;
+      }
+    }
+  }
+
+  // Decodes the textures of 'models' not already on the GPU, one job per
+  // texture on 'pool': the time goes with the largest texture, not with
+  // their sum. A texture used several times is decoded for its first use
+  // only, the others are left empty. The decoded ones are hashed there too.
+  // 'evenOnGpu': decodes the ones on the GPU too, without looking at the
+  // GPU state (e.g from a worker).
+  void readTextures(vector<ModelData>& models, ThreadPool& pool, bool evenOnGpu = false) const
+  {
+    struct Job
+    {
+      string const* path;
+      Texture* texture;
+      uint64_t* content;
+    };
+
+    vector<Job> jobs;
+    set<string> queued;
+
+    for(auto& model : models)
+    {
+      model.textures.resize(model.texturePaths.size());
+      model.contents.resize(model.texturePaths.size());
+
+      for(int i = 0; i < (int)model.texturePaths.size(); ++i)
+      {
+        auto& texturePath = model.texturePaths[i];
+
+        if((!evenOnGpu && m_texturePaths.count(texturePath)) || !queued.insert(texturePath).second)
+          continue;
+
+        jobs.push_back({ &texturePath, &model.textures[i], &model.contents[i] });
+      }
+    }
+
+    pool.parallelFor(jobs.size(), [&] (int i)
+      {
+        *jobs[i].texture = readTexture(*jobs[i].path);
+        *jobs[i].content = hashTexture(*jobs[i].texture);
+      });
+  }
+
+  // The cooked version of the PNG 'path', in a format the GPU can sample,
+  // with its mipmaps. The PNG itself if it wasn't cooked.
+  Texture readTexture(string const& path) const
+  {
+    for(auto& cooked : m_cookedTextureExtensions)
+    {
+      auto const cookedPath = setExtension(path, cooked);
+
+      if(!File::exists(cookedPath))
+        continue;
+
+      try
+      {
+        return deserializeTexture(File::map(cookedPath)->data);
+      }
+      catch(exception const& e)
+      {
+        printf("[display] ignoring cooked texture '%s': %s\n", cookedPath.c_str(), e.what());
+      }
+    }
+
+    return toTexture(loadPicture(path.c_str()));
+  }
+
+  // Replaces the model 'modelId': the textures it shares with the
+  // previous one aren't uploaded again.
+  void uploadModel(int modelId, const char* path, ModelData& data)
+  {
+    if((int)m_Models.size() <= modelId)
+    {
+      m_Models.resize(modelId + 1);
+      m_modelInfos.resize(modelId + 1);
+    }
+
+    auto& info = m_modelInfos[modelId];
+
+    // acquire first: shared textures stay alive
+    vector<string> previousTextures = move(info.textures);
+
+    for(int i = 0; i < (int)data.texturePaths.size(); ++i)
+      acquireTexture(data.texturePaths[i], move(data.textures[i]), data.contents[i]);
+
+    for(auto& texturePath : previousTextures)
+      releaseTexture(texturePath);
+
+    freeVertices(modelId);
+
+    m_Models[modelId] = move(data.mesh);
+    info.path = path;
+    info.textures = data.texturePaths;
+    info.vertexBytes = getVertexBytes(m_Models[modelId]);
+    info.lastDrawnFrame = m_frameCount;
+    info.resident = true;
+
+    auto getTexture = [&] (string const& texturePath) -> CachedTexture const&
+      {
+        return m_textures.at(m_texturePaths.at(texturePath).content);
+      };
+
+    int i = 0;
+
+    for(auto& single : m_Models[modelId].singleMeshes)
+    {
+      auto& diffuse = getTexture(data.texturePaths[i * 2 + 0]);
+      single.diffuse = diffuse.id;
+      single.translucent = diffuse.translucent;
+      single.lightmap = getTexture(data.texturePaths[i * 2 + 1]).id;
+      ++i;
+    }
+
+    uploadVerticesToGPU(m_Models[modelId], m_meshShader);
+    m_residentBytes += info.vertexBytes;
+    trackMemory(MemoryTag::GpuBuffers, info.vertexBytes);
+
+    // the vertices stay on the CPU too, along with the mesh
+    info.meshMemory.set(getMeshBytes(m_Models[modelId]));
+  }
+
+  void unloadModel(int modelId) override
+  {
+    if(modelId < 0 || modelId >= (int)m_Models.size())
+      return;
+
+    evictModel(modelId);
+    m_modelInfos[modelId].path.clear();
+  }
+
+  void setMemoryBudget(int64_t bytes) override
+  {
+    m_memoryBudget = bytes;
+    enforceMemoryBudget();
+  }
+
+  // The model stays known: its next 'drawActor' loads it again.
+  void evictModel(int modelId)
+  {
+    auto& info = m_modelInfos[modelId];
+
+    if(!info.resident)
+      return;
+
+    for(auto& texturePath : info.textures)
+      releaseTexture(texturePath);
+
+    info.textures.clear();
+
+    freeVertices(modelId);
+    m_Models[modelId] = {};
+    info.resident = false;
+  }
+
+  void freeVertices(int modelId)
+  {
+    for(auto& single : m_Models[modelId].singleMeshes)
+    {
+      SAFE_GL(glDeleteVertexArrays(1, &single.vertexArray));
+      SAFE_GL(glDeleteBuffers(1, &single.buffer));
+      SAFE_GL(glDeleteBuffers(1, &single.indexBuffer));
+    }
+
+    m_residentBytes -= m_modelInfos[modelId].vertexBytes;
+    trackMemory(MemoryTag::GpuBuffers, -m_modelInfos[modelId].vertexBytes);
+    m_modelInfos[modelId].vertexBytes = 0;
+    m_modelInfos[modelId].meshMemory.set(0);
+  }
+
+  // Evicts the least recently drawn models first.
+  // The ones drawn during the current frame are kept, whatever the budget.
+  void enforceMemoryBudget()
+  {
+    while(m_memoryBudget > 0 && m_residentBytes > m_memoryBudget)
+    {
+      int victim = -1;
+
+      for(int i = 0; i < (int)m_modelInfos.size(); ++i)
+      {
+        auto& info = m_modelInfos[i];
+
+        if(!info.resident || info.lastDrawnFrame >= m_frameCount)
+          continue;
+
+        if(victim < 0 || info.lastDrawnFrame < m_modelInfos[victim].lastDrawnFrame)
+          victim = i;
+      }
+
+      if(victim < 0)
+        break;
+
+      evictModel(victim);
+    }
+  }
+
+  // 'tex' and its hash 'content': only used if the texture isn't on the
+  // GPU yet, under this path or another one with the same pixels.
+  // Only its smallest levels are uploaded here, see 'uploadPendingTextures'.
+  void acquireTexture(string const& path, Texture&& tex, uint64_t content)
+  {
+    auto& texturePath = m_texturePaths[path];
+
+    if(texturePath.refs++ > 0)
+      return;
+
+    texturePath.content = content;
+
+    auto& texture = m_textures[content];
+
+    if(texture.refs++ == 0)
+    {
+      int firstResident;
+      texture.id = allocateTexture(tex, firstResident);
+      texture.bytes = getTextureBytes(tex);
+      texture.translucent = hasAlpha(tex);
+      m_residentBytes += texture.bytes;
+      trackMemory(MemoryTag::GpuTextures, texture.bytes);
+
+      if(firstResident > 0)
+      {
+        TrackedMemory pixels(MemoryTag::Textures, getTextureBytes(tex));
+        m_pendingTextures.push_back({ texture.id, move(tex), firstResident - 1, move(pixels) });
+      }
+    }
+  }
+
+  // Spreads the large texture levels over the frames: loading a room doesn't
+  // stall the rendering. Meanwhile, the smaller levels are sampled.
+  // The pixels are staged in a buffer, the driver copies them from there
+  // without blocking.
+  void uploadPendingTextures()
+  {
+    PROFILE_SCOPE("Display::uploadPendingTextures");
+
+    int64_t uploaded = 0;
+
+    while(!m_pendingTextures.empty())
+    {
+      auto& pending = m_pendingTextures.front();
+      auto& level = pending.tex.levels[pending.level];
+
+      if(uploaded > 0 && uploaded + (int64_t)level.size() > TEXTURE_UPLOAD_BUDGET)
+        break;
+
+      auto const offset = m_streamPixels->push(level.data(), (int)level.size(), 16);
+
+      SAFE_GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_streamPixels->id));
+      uploadTextureLevel(pending.id, pending.tex, pending.level, offset);
+      SAFE_GL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+
+      uploaded += level.size();
+
+      if(--pending.level < 0)
+        m_pendingTextures.pop_front();
+    }
+  }
+
+  void releaseTexture(string const& path)
+  {
+    auto j = m_texturePaths.find(path);
+    assert(j != m_texturePaths.end());
+
+    if(--j->second.refs > 0)
+      return;
+
+    auto const content = j->second.content;
+    m_texturePaths.erase(j);
+
+    auto i = m_textures.find(content);
+    assert(i != m_textures.end());
+
+    if(--i->second.refs > 0)
+      return;
+
+    auto const id = i->second.id;
+    auto isReleased = [id] (PendingTexture const& pending) { return pending.id == id; };
+    m_pendingTextures.erase(remove_if(m_pendingTextures.begin(), m_pendingTextures.end(), isReleased), m_pendingTextures.end());
+
+    SAFE_GL(glDeleteTextures(1, &i->second.id));
+    m_residentBytes -= i->second.bytes;
+    trackMemory(MemoryTag::GpuTextures, -i->second.bytes);
+    m_textures.erase(i);
+  }
+
+  void setCamera(Vector3f pos, Quaternion dir) override
+  {
+    // already interpolated between ticks, by the caller
+    m_camera = (Camera { pos, dir });
+    m_camera.valid = true;
+  }
+
+  void setAmbientLight(float ambientLight) override
+  {
+    m_ambientLight = ambientLight;
+  }
+
+  void beginDraw() override
+  {
+    m_frameCount++;
+    m_drawCommands.clear();
+    uploadPendingTextures();
+    m_textMesh.singleMeshes[0].vertices.clear();
+    m_textMesh.singleMeshes[0].indices.clear();
+  }
+
+  void endDraw() override
+  {
+    PROFILE_SCOPE("Display::endDraw");
+
+    auto screenSize = getCurrentScreenSize();
+
+    m_aspectRatio = float(screenSize.width) / screenSize.height;
+    m_screenHeight = screenSize.height;
+
+    // the text, the view constants and the instances of the frame
+    {
+      auto const commands = (int)m_drawCommands.size();
+      auto const vertexSize = (int)sizeof(m_textMesh.singleMeshes[0].vertices[0]);
+      auto const textBytes = vertexSize * ((int)m_textMesh.singleMeshes[0].vertices.size() + 1);
+      auto const viewBytes = commands * m_viewStride + m_uniformAlignment; // at most one view per command
+      auto const instanceBytes = commands * (int)sizeof(Instance) + (int)sizeof(float);
+      m_stream->beginFrame(textBytes + viewBytes + instanceBytes);
+    }
+
+    uploadTextMesh();
 
     if(m_enablePostProcessing)
     {
+      // the scene only covers a part of the HDR buffer, when scaled down
+      auto const full = m_postProcessing->m_resolution;
+      auto const scale = m_resolutionScaler.scale;
+      auto const sceneSize = Size2i(
+        clamp(int(full.width * scale + 0.5f), 1, full.width),
+        clamp(int(full.height * scale + 0.5f), 1, full.height));
+
       // draw to the HDR buffer
       SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, m_postProcessing->m_hdrFramebuffer));
-      executeAllDrawCommands(m_postProcessing->m_resolution);
+      m_gpuTimer->begin(GpuTimer::Scene);
+      executeAllDrawCommands(sceneSize);
+      m_gpuTimer->end();
 
       // draw to the bloom buffer
-      m_postProcessing->applyBloomFilter();
+      m_postProcessing->applyBloomFilter(*m_gpuTimer, sceneSize);
 
       // draw to screen
       SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
-      m_postProcessing->drawHdrBuffer(screenSize);
+      m_gpuTimer->begin(GpuTimer::HdrResolve);
+      m_postProcessing->drawHdrBuffer(screenSize, sceneSize);
+      m_gpuTimer->end();
     }
     else
     {
       SAFE_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+      m_gpuTimer->begin(GpuTimer::Scene);
       executeAllDrawCommands(screenSize);
+      m_gpuTimer->end();
     }
 
-    SDL_GL_SwapWindow(m_window);
+    m_gpuTimer->endFrame();
+    m_resolutionScaler.update(m_gpuTimer->getLastFrameMs());
+
+    {
+      PROFILE_SCOPE("SDL_GL_SwapWindow");
+      SDL_GL_SwapWindow(m_window);
+    }
+
+    enforceMemoryBudget();
   }
 
   void drawActor(Rect3f where, Quaternion orientation, int modelId, bool blinking, int actionIdx, float ratio) override
   {
     (void)actionIdx;
     (void)ratio;
-    auto& model = m_Models.at(modelId);
-    pushMesh(where, orientation, m_camera, model, blinking, true);
+
+    auto& model = useModel(modelId);
+    auto& actor = trackActor(modelId, where, orientation);
+
+    if(isOccluded(actor, model, where, orientation))
+      return;
+
+    pushMesh(where, orientation, m_camera, model, blinking, true, actor.lod);
+  }
+
+  // Consecutive commands of the same mesh: 'executeDrawCommands' makes
+  // them one instanced draw.
+  void drawParticles(int modelId, Span<const Rect3f> where) override
+  {
+    auto& model = useModel(modelId);
+    auto const orientation = Quaternion::rotation(Vector3f(1, 0, 0), 0);
+
+    for(auto& rect : where)
+      pushMesh(rect, orientation, m_camera, model, false, true);
+  }
+
+  // The model 'modelId', about to be drawn: loaded again if it was evicted
+  RenderMesh& useModel(int modelId)
+  {
+    auto& info = m_modelInfos.at(modelId);
+
+    // evicted by the budget
+    if(!info.resident && !info.path.empty())
+    {
+      auto path = info.path;
+      loadModel(modelId, path.c_str());
+    }
+
+    info.lastDrawnFrame = m_frameCount;
+
+    return m_Models.at(modelId);
+  }
+
+  // The state of an instance of the model 'modelId', drawn this frame.
+  // It continues the one of the nearest instance drawn in the previous
+  // frame: an instance is only known by its position.
+  ActorState& trackActor(int modelId, Rect3f where, Quaternion orientation)
+  {
+    auto& info = m_modelInfos[modelId];
+    auto& model = m_Models[modelId];
+
+    // the instances of the previous frame left unmatched are gone
+    if(info.actorFrame != m_frameCount)
+    {
+      releaseQueries(info.previousActors);
+      swap(info.actors, info.previousActors);
+      info.actors.clear();
+
+      if(info.actorFrame != m_frameCount - 1)
+        releaseQueries(info.previousActors);
+
+      info.actorFrame = m_frameCount;
+    }
+
+    Vector3f boundsMin, boundsMax;
+    getBounds(model, boundsMin, boundsMax);
+
+    auto const center = (boundsMin + boundsMax) * 0.5f;
+    auto const pos = where.pos + orientation.rotate(Vector3f(center.x * where.size.cx, center.y * where.size.cy, center.z * where.size.cz));
+
+    ActorState actor;
+    float previousDistance = MAX_ACTOR_MOVE;
+    int previous = -1;
+
+    for(int i = 0; i < (int)info.previousActors.size(); ++i)
+    {
+      auto const d = (float)magnitude(info.previousActors[i].pos - pos);
+
+      if(d < previousDistance)
+      {
+        previousDistance = d;
+        previous = i;
+      }
+    }
+
+    if(previous >= 0)
+    {
+      actor = info.previousActors[previous];
+      info.previousActors[previous] = info.previousActors.back();
+      info.previousActors.pop_back();
+    }
+
+    actor.pos = pos;
+
+    // see 'RenderMesh::selectLod'
+    if(!model.lodErrors.empty())
+    {
+      auto const distance = max(0.1f, (float)magnitude(pos - m_camera.pos));
+      auto const scale = max(where.size.cx, max(where.size.cy, where.size.cz));
+      auto const pixelsPerUnit = scale * m_screenHeight / (2 * tan(FOVY / 2) * distance);
+      actor.lod = model.selectLod(pixelsPerUnit, actor.lod);
+    }
+
+    info.actors.push_back(actor);
+    return info.actors.back();
+  }
+
+  // Whether the last occlusion query of 'actor' found it hidden: the result
+  // of the previous frame, or an older one while it's in flight. Queries
+  // again, unless one is in flight. The rooms are the occluders: they
+  // have visibility data instead.
+  bool isOccluded(ActorState& actor, RenderMesh const& model, Rect3f where, Quaternion orientation)
+  {
+    if(!m_enableOcclusionCulling || model.visibility.cellSize > 0)
+      return false;
+
+    if(actor.query < 0)
+      actor.query = allocateQuery();
+
+    auto& query = m_occlusionQueries[actor.query];
+
+    if(query.issued)
+    {
+      GLuint available = 0;
+      SAFE_GL(glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available));
+
+      if(!available)
+        return actor.occluded;
+
+      GLuint samples = 0;
+      SAFE_GL(glGetQueryObjectuiv(query.id, GL_QUERY_RESULT, &samples));
+      actor.occluded = !samples;
+      query.issued = false;
+    }
+    else
+    {
+      // not queried (e.g out of the frustum): nothing is known
+      actor.occluded = false;
+    }
+
+    // The box of the model, a bit larger: e.g the doors are flush with
+    // the walls. 'boxModel' spans [-0.5; 0.5].
+    Vector3f boundsMin, boundsMax;
+    getBounds(model, boundsMin, boundsMax);
+
+    auto const center = (boundsMin + boundsMax) * 0.5f;
+    auto const extent = boundsMax - boundsMin;
+
+    Rect3f box;
+    box.pos = where.pos + orientation.rotate(Vector3f(center.x * where.size.cx, center.y * where.size.cy, center.z * where.size.cz));
+    box.size.cx = abs(extent.x * where.size.cx) + OCCLUSION_BOX_MARGIN * 2;
+    box.size.cy = abs(extent.y * where.size.cy) + OCCLUSION_BOX_MARGIN * 2;
+    box.size.cz = abs(extent.z * where.size.cz) + OCCLUSION_BOX_MARGIN * 2;
+
+    // From inside, the box hides nothing: its faces are behind the camera,
+    // or clipped by the near plane.
+    auto const eye = orientation.conjugate().rotate(m_camera.pos - box.pos);
+    auto const nearMargin = 0.2f;
+
+    if(abs(eye.x) * 2 < box.size.cx + nearMargin && abs(eye.y) * 2 < box.size.cy + nearMargin && abs(eye.z) * 2 < box.size.cz + nearMargin)
+    {
+      actor.occluded = false;
+      return false;
+    }
+
+    m_drawCommands.push_back({ &m_boxMesh.singleMeshes[0], box, orientation, m_camera, false, true, 0, -1, nullptr, actor.query });
+    return actor.occluded;
+  }
+
+  // of all the single meshes of 'model', in model space
+  static void getBounds(RenderMesh const& model, Vector3f& boundsMin, Vector3f& boundsMax)
+  {
+    boundsMin = boundsMax = Vector3f(0, 0, 0);
+
+    for(int i = 0; i < (int)model.singleMeshes.size(); ++i)
+    {
+      auto& single = model.singleMeshes[i];
+      boundsMin = i ? Vector3f(min(boundsMin.x, single.boundsMin.x), min(boundsMin.y, single.boundsMin.y), min(boundsMin.z, single.boundsMin.z)) : single.boundsMin;
+      boundsMax = i ? Vector3f(max(boundsMax.x, single.boundsMax.x), max(boundsMax.y, single.boundsMax.y), max(boundsMax.z, single.boundsMax.z)) : single.boundsMax;
+    }
+  }
+
+  int allocateQuery()
+  {
+    if(m_freeOcclusionQueries.empty())
+    {
+      OcclusionQuery query;
+      SAFE_GL(glGenQueries(1, &query.id));
+      m_occlusionQueries.push_back(query);
+      return m_occlusionQueries.size() - 1;
+    }
+
+    auto const r = m_freeOcclusionQueries.back();
+    m_freeOcclusionQueries.pop_back();
+    return r;
+  }
+
+  // Frees the queries of 'actors', and clears it. A query in flight gets
+  // reused all the same: its result is dropped.
+  void releaseQueries(vector<ActorState>& actors)
+  {
+    for(auto& actor : actors)
+    {
+      if(actor.query < 0)
+        continue;
+
+      m_occlusionQueries[actor.query].issued = false;
+      m_freeOcclusionQueries.push_back(actor.query);
+    }
+
+    actors.clear();
   }
 
+  // All the text of the frame goes to 'm_textMesh', drawn with one command.
   void drawText(Vector2f pos, char const* text) override
   {
-    Rect3f rect;
-    rect.size.cx = 0.5;
-    rect.size.cy = 0;
-    rect.size.cz = 0.5;
-    rect.pos.x = pos.x - strlen(text) * rect.size.cx / 2;
-    rect.pos.y = 0;
-    rect.pos.z = pos.y;
+    auto& textMesh = m_textMesh.singleMeshes[0];
+
+    if(textMesh.indices.empty())
+    {
+      auto const cam = Camera { Vector3f(0, -10, 0), Quaternion::fromEuler(PI / 2, 0, 0) };
+      auto const identity = Quaternion::fromEuler(0, 0, 0);
+
+      m_drawCommands.push_back({ &textMesh, Rect3f(0, 0, 0, 1, 1, 1), identity, cam, false, false, 0, -1, &m_textRange });
+    }
 
-    auto cam = (Camera { Vector3f(0, -10, 0), Quaternion::fromEuler(PI / 2, 0, 0) });
-    auto orientation = Quaternion::fromEuler(0, 0, 0);
+    auto const charSize = 0.5f;
+    auto charPos = Vector3f(pos.x - strlen(text) * charSize / 2, 0, pos.y);
 
     while(*text)
     {
-      pushMesh(rect, orientation, cam, m_fontModel[*text], false, false);
-      rect.pos.x += rect.size.cx;
+      auto& glyph = m_fontModel[*text].singleMeshes[0];
+      auto const base = (uint32_t)textMesh.vertices.size();
+
+      for(auto v : glyph.vertices)
+      {
+        v.x = charPos.x + v.x * charSize;
+        v.y = charPos.y;
+        v.z = charPos.z + v.z * charSize;
+        textMesh.vertices.push_back(v);
+      }
+
+      for(auto i : glyph.indices)
+        textMesh.indices.push_back(base + i);
+
+      charPos.x += charSize;
       ++text;
     }
   }
 
+  // Sends the text of the frame, using the same buffers each frame.
+  void uploadTextMesh()
+  {
+    auto& textMesh = m_textMesh.singleMeshes[0];
+
+    if(textMesh.indices.empty())
+      return;
+
+    // No 'baseVertex' in GLES 3: the indices are moved along with the vertices.
+    auto const vertexSize = (int)sizeof(textMesh.vertices[0]);
+    auto const vertexOffset = m_stream->push(textMesh.vertices.data(), vertexSize * textMesh.vertices.size(), vertexSize);
+    auto const baseVertex = uint32_t(vertexOffset / vertexSize);
+
+    for(auto& i : textMesh.indices)
+      i += baseVertex;
+
+    auto const indexBytes = int(sizeof(textMesh.indices[0]) * textMesh.indices.size());
+    m_streamIndices->beginFrame(indexBytes + sizeof(textMesh.indices[0]));
+
+    auto const indexOffset = m_streamIndices->push(textMesh.indices.data(), indexBytes, sizeof(textMesh.indices[0]));
+
+    m_textRange.first = indexOffset / sizeof(textMesh.indices[0]);
+    m_textRange.count = textMesh.indices.size();
+  }
+
   void readPixels(Span<uint8_t> dstRgbPixels) override
   {
     int width, height;
@@ -749,6 +2387,94 @@ struct OpenglDisplay : Display
     }
   }
 
+  void captureFrame(CaptureCallback const& onFrame) override
+  {
+    while(deliverOldestCapture(onFrame, false))
+    {
+    }
+
+    // the ring is full: the GPU is more than a few frames late
+    if(m_captureCount == CAPTURE_RING_SIZE)
+      deliverOldestCapture(onFrame, true);
+
+    auto& capture = m_captures[(m_captureHead + m_captureCount) % CAPTURE_RING_SIZE];
+
+    int width, height;
+    SDL_GetWindowSize(m_window, &width, &height);
+
+    if(!capture.buffer)
+      SAFE_GL(glGenBuffers(1, &capture.buffer));
+
+    SAFE_GL(glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffer));
+
+    if(capture.size.width != width || capture.size.height != height)
+    {
+      capture.size = Size2i(width, height);
+      SAFE_GL(glBufferData(GL_PIXEL_PACK_BUFFER, width * height * 4, nullptr, GL_STREAM_READ));
+    }
+
+    // into the buffer: returns right away
+    SAFE_GL(glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+    SAFE_GL(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+    capture.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_captureCount++;
+  }
+
+  Span<const PassTiming> getGpuTimings() override
+  {
+    return m_gpuTimer->getTimings();
+  }
+
+  void flushCaptures(CaptureCallback const& onFrame) override
+  {
+    while(deliverOldestCapture(onFrame, true))
+    {
+    }
+  }
+
+  // Returns false if there's no pending capture, or if (not waiting) the
+  // oldest one isn't complete yet.
+  bool deliverOldestCapture(CaptureCallback const& onFrame, bool wait)
+  {
+    if(m_captureCount == 0)
+      return false;
+
+    auto& capture = m_captures[m_captureHead];
+
+    if(wait)
+    {
+      while(glClientWaitSync(capture.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000 * 1000) == GL_TIMEOUT_EXPIRED)
+      {
+      }
+    }
+    else if(glClientWaitSync(capture.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+      return false;
+    }
+
+    glDeleteSync(capture.fence);
+    capture.fence = nullptr;
+
+    auto const bytes = capture.size.width * capture.size.height * 4;
+
+    SAFE_GL(glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffer));
+    auto const pixels = (uint8_t const*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+
+    if(pixels)
+    {
+      onFrame({ pixels, bytes }, capture.size);
+      SAFE_GL(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+    }
+
+    SAFE_GL(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+    m_captureHead = (m_captureHead + 1) % CAPTURE_RING_SIZE;
+    m_captureCount--;
+
+    return true;
+  }
+
   void enableGrab(bool enable) override
   {
     SDL_SetRelativeMouseMode(enable ? SDL_TRUE : SDL_FALSE);
@@ -756,6 +2482,22 @@ struct OpenglDisplay : Display
     SDL_ShowCursor(enable ? 0 : 1);
   }
 
+  bool isVsynced() override
+  {
+    return m_vsync;
+  }
+
+  void acquireContext() override
+  {
+    if(SDL_GL_MakeCurrent(m_window, m_context))
+      throw runtime_error(string("Can't make the OpenGL context current: ") + SDL_GetError());
+  }
+
+  void releaseContext() override
+  {
+    SDL_GL_MakeCurrent(m_window, nullptr);
+  }
+
 private:
   Size2i getCurrentScreenSize()
   {
@@ -773,127 +2515,533 @@ private:
     SAFE_GL(glClearColor(0, 0, 0, 1));
     SAFE_GL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
 
+    SAFE_GL(glUniform1i(m_meshShader.DiffuseTex, 0));
+    SAFE_GL(glUniform1i(m_meshShader.LightmapTex, 1));
+
+    assignViews();
+    cullDrawCommands();
+
+    stable_sort(m_drawCommands.begin(), m_drawCommands.end(), &drawsBefore);
+
+    uploadViews();
+
+    // the per-instance data of all the commands, in one upload
+    m_instances.clear();
+
     for(auto& cmd : m_drawCommands)
-      executeDrawCommand(cmd);
+      m_instances.push_back(getInstance(cmd));
+
+    m_instanceOffset = m_stream->push(m_instances.data(), sizeof(Instance) * m_instances.size(), sizeof(float));
+
+    BoundState state;
+
+    // consecutive commands drawing the same thing make one instanced draw
+    auto executeBatches = [&] (int begin, int end, bool depthOnly)
+      {
+        for(int first = begin; first < end;)
+        {
+          int last = first + 1;
+
+          while(last < end && isSameBatch(m_drawCommands[first], m_drawCommands[last]))
+            ++last;
+
+          executeBatch(first, last - first, state, depthOnly);
+          first = last;
+        }
+      };
+
+    // see 'drawsBefore': opaque, translucent, then overlays
+    auto const findFirst = [&] (auto predicate)
+      {
+        return (int)(find_if(m_drawCommands.begin(), m_drawCommands.end(), predicate) - m_drawCommands.begin());
+      };
+
+    int const queriesBegin = findFirst([] (DrawCommand const& cmd) { return !cmd.depthtest || cmd.query >= 0 || cmd.pMesh->translucent; });
+    int const translucentBegin = findFirst([] (DrawCommand const& cmd) { return !cmd.depthtest || cmd.pMesh->translucent; });
+    int const overlayBegin = findFirst([] (DrawCommand const& cmd) { return !cmd.depthtest; });
+    int const count = m_drawCommands.size();
+
+    // the opaque ones don't need blending: it's only re-enabled after them
+    SAFE_GL(glDisable(GL_BLEND));
+
+    // Depth prepass, of the opaque commands: the lighting then only runs on
+    // the visible fragments, instead of on each overdrawn one.
+    if(m_enableDepthPrepass)
+    {
+      SAFE_GL(glUseProgram(m_depthProgramId));
+      SAFE_GL(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+      executeBatches(0, queriesBegin, true);
+      SAFE_GL(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+
+      SAFE_GL(glUseProgram(m_meshShader.programId));
+      SAFE_GL(glDepthMask(GL_FALSE));
+      SAFE_GL(glDepthFunc(GL_LEQUAL));
+    }
+
+    executeBatches(0, queriesBegin, false);
+
+    executeOcclusionQueries(queriesBegin, translucentBegin, state);
+
+    // translucent: tested against the opaque depths, without hiding each other
+    SAFE_GL(glEnable(GL_BLEND));
+    SAFE_GL(glDepthMask(GL_FALSE));
+    executeBatches(translucentBegin, overlayBegin, false);
+
+    executeBatches(overlayBegin, count, false);
+
+    SAFE_GL(glDepthMask(GL_TRUE));
+    SAFE_GL(glDepthFunc(GL_LESS));
+
+    SAFE_GL(glBindVertexArray(m_vertexArray));
 
     m_drawCommands.clear();
   }
 
-  void pushMesh(Rect3f where, Quaternion orientation, Camera const& camera, RenderMesh& model, bool blinking, bool depthtest)
+  void pushMesh(Rect3f where, Quaternion orientation, Camera const& camera, RenderMesh& model, bool blinking, bool depthtest, int lod = 0)
   {
+    // from the center of the drawn triangles: the cells of a room get
+    // sorted front to back
+    auto getDepth = [&] (Vector3f boundsMin, Vector3f boundsMax)
+      {
+        auto const center = (boundsMin + boundsMax) * 0.5f;
+        auto const scaled = Vector3f(center.x * where.size.cx, center.y * where.size.cy, center.z * where.size.cz);
+        auto const delta = where.pos + orientation.rotate(scaled) - camera.pos;
+        return dotProduct(delta, delta);
+      };
+
+    // Potentially visible set, if any: only the ranges of the cells seen from the camera cell.
+    // (only used by the room, which is never rotated)
+    if(depthtest && markVisibleCells(model.visibility, where, camera.pos))
+    {
+      for(auto& single : model.singleMeshes)
+      {
+        if(single.ranges.empty())
+        {
+          m_drawCommands.push_back({ &single, where, orientation, camera, blinking, depthtest, getDepth(single.boundsMin, single.boundsMax), -1, nullptr });
+          continue;
+        }
+
+        for(auto& range : single.ranges)
+          if(m_visibleCells[range.cell])
+            m_drawCommands.push_back({ &single, where, orientation, camera, blinking, depthtest, getDepth(range.boundsMin, range.boundsMax), -1, &range });
+      }
+
+      return;
+    }
+
     for(auto& single : model.singleMeshes)
-      m_drawCommands.push_back({ &single, where, orientation, camera, blinking, depthtest });
+    {
+      auto const range = single.lods.empty() ? nullptr : &single.lods[min(lod, (int)single.lods.size() - 1)];
+
+      // gone, at this level
+      if(range && range->count == 0)
+        continue;
+
+      m_drawCommands.push_back({ &single, where, orientation, camera, blinking, depthtest, getDepth(single.boundsMin, single.boundsMax), -1, range });
+    }
   }
 
-  void executeDrawCommand(const DrawCommand& cmd)
+  // Fills 'm_visibleCells' with the cells seen from 'eye'.
+  // Returns false if everything must be drawn (no data, or out of the grid).
+  bool markVisibleCells(RenderMesh::Visibility const& vis, Rect3f where, Vector3f eye)
   {
-    auto& model = *cmd.pMesh;
-    auto& where = cmd.where;
-    SAFE_GL(glUniform4f(m_meshShader.colorId, 0, 0, 0, 0));
-    SAFE_GL(glUniform3f(m_meshShader.LightPosLoc, cmd.camera.pos.x, cmd.camera.pos.y, cmd.camera.pos.z));
+    if(vis.cellSize <= 0)
+      return false;
+
+    // model space
+    auto const rel = eye - where.pos;
+    auto const cell = vis.getCell(Vector3f(rel.x / where.size.cx, rel.y / where.size.cy, rel.z / where.size.cz));
+
+    if(cell < 0)
+      return false;
+
+    m_visibleCells.assign(vis.visibleCells.size(), false);
+
+    for(auto seen : vis.visibleCells[cell])
+      m_visibleCells[seen] = true;
+
+    return true;
+  }
 
-    if(cmd.depthtest)
+  // Layout of the 'ViewConstants' uniform block (std140)
+  struct ViewConstants
+  {
+    Matrix4f VP = Matrix4f(0);
+    float cameraPos[4];
+    float lightPos[4];
+    float ambientLight[4];
+  };
+
+  // What stays the same for all the commands seen from the same camera,
+  // with the same depth test (usually two per frame: the scene and the text).
+  struct View
+  {
+    Camera camera;
+    bool depthtest;
+    ViewConstants constants;
+    Frustum frustum;
+  };
+
+  // Assigns its view to each command, and computes the constants of each view once.
+  void assignViews()
+  {
+    m_views.clear();
+
+    for(auto& cmd : m_drawCommands)
     {
-      SAFE_GL(glUniform3f(m_meshShader.ambientLoc, m_ambientLight, m_ambientLight, m_ambientLight));
-      glEnable(GL_DEPTH_TEST);
+      auto isIt = [&] (View const& view) { return view.depthtest == cmd.depthtest && isSameCamera(view.camera, cmd.camera); };
+      auto i = find_if(m_views.begin(), m_views.end(), isIt);
+
+      if(i == m_views.end())
+      {
+        View view;
+        view.camera = cmd.camera;
+        view.depthtest = cmd.depthtest;
+        view.constants = getViewConstants(view);
+        view.frustum = Frustum(view.constants.VP);
+        m_views.push_back(view);
+        i = m_views.end() - 1;
+      }
+
+      cmd.view = i - m_views.begin();
     }
-    else
+  }
+
+  // Removes the commands out of the frustum of their view.
+  // Overlays are always drawn.
+  void cullDrawCommands()
+  {
+    auto isHidden = [&] (DrawCommand const& cmd)
+      {
+        if(!cmd.depthtest)
+          return false;
+
+        auto& mesh = *cmd.pMesh;
+        auto const boundsMin = cmd.range ? cmd.range->boundsMin : mesh.boundsMin;
+        auto const boundsMax = cmd.range ? cmd.range->boundsMax : mesh.boundsMax;
+        return !m_views[cmd.view].frustum.touches(getModelMatrix(cmd), boundsMin, boundsMax);
+      };
+
+    m_drawCommands.erase(remove_if(m_drawCommands.begin(), m_drawCommands.end(), isHidden), m_drawCommands.end());
+  }
+
+  void uploadViews()
+  {
+    m_viewData.resize(m_views.size() * m_viewStride);
+
+    for(int i = 0; i < (int)m_views.size(); ++i)
+      memcpy(m_viewData.data() + i * m_viewStride, &m_views[i].constants, sizeof(ViewConstants));
+
+    m_viewOffset = m_stream->push(m_viewData.data(), m_viewData.size(), m_uniformAlignment);
+  }
+
+  ViewConstants getViewConstants(View const& view) const
+  {
+    auto& camera = view.camera;
+    auto const forward = camera.dir.rotate(Vector3f(1, 0, 0));
+    auto const up = camera.dir.rotate(Vector3f(0, 0, 1));
+
+    auto const target = camera.pos + forward;
+    auto const lookAt = ::lookAt(camera.pos, target, up);
+
+    static const float near_ = 0.1f;
+    static const float far_ = 100.0f;
+    const auto perspective = ::perspective(FOVY, m_aspectRatio, near_, far_);
+
+    // overlays are fully lit
+    auto const ambient = view.depthtest ? m_ambientLight : 1.0f;
+
+    ViewConstants r;
+    r.VP = perspective * lookAt;
+
+    // the light comes from the camera
+    for(auto dst : { r.cameraPos, r.lightPos })
     {
-      SAFE_GL(glUniform3f(m_meshShader.ambientLoc, 1.0, 1.0, 1.0));
-      glDisable(GL_DEPTH_TEST);
+      dst[0] = camera.pos.x;
+      dst[1] = camera.pos.y;
+      dst[2] = camera.pos.z;
+      dst[3] = 1;
+    }
+
+    r.ambientLight[0] = r.ambientLight[1] = r.ambientLight[2] = ambient;
+    r.ambientLight[3] = 0;
+
+    return r;
+  }
+
+  // Layout of the instance data in 'm_stream', one per draw command
+  struct Instance
+  {
+    Matrix4f M = Matrix4f(0);
+    float fragOffset[4];
+  };
+
+  static Matrix4f getModelMatrix(DrawCommand const& cmd)
+  {
+    return transform(cmd.where.pos, cmd.orientation, Vector3f(cmd.where.size.cx, cmd.where.size.cy, cmd.where.size.cz));
+  }
+
+  Instance getInstance(DrawCommand const& cmd) const
+  {
+    auto const flash = cmd.blinking && (m_frameCount / 4) % 2;
+
+    Instance r;
+    r.M = getModelMatrix(cmd);
+    r.fragOffset[0] = r.fragOffset[1] = r.fragOffset[2] = flash ? 10 : 0;
+    r.fragOffset[3] = 0;
+    return r;
+  }
+
+  static bool isSameBatch(DrawCommand const& a, DrawCommand const& b)
+  {
+    return a.pMesh == b.pMesh && a.range == b.range && a.view == b.view;
+  }
+
+  // What the previous batches left bound (-1: unknown).
+  // Consecutive batches often share it, thanks to the sorting.
+  struct BoundState
+  {
+    int depthtest = -1;
+    int view = -1;
+    int64_t diffuse = -1;
+    int64_t lightmap = -1;
+    int64_t vertexArray = -1;
+  };
+
+  // Draws the commands [first; first + count[, which only differ by their instance data.
+  // 'depthOnly': for the depth prepass, the textures aren't needed.
+  void executeBatch(int first, int count, BoundState& state, bool depthOnly)
+  {
+    auto& cmd = m_drawCommands[first];
+    auto& model = *cmd.pMesh;
+
+    if(cmd.depthtest != state.depthtest)
+    {
+      if(cmd.depthtest)
+        glEnable(GL_DEPTH_TEST);
+      else
+        glDisable(GL_DEPTH_TEST);
+
+      state.depthtest = cmd.depthtest;
     }
 
-    if(cmd.blinking)
+    if(cmd.view != state.view)
     {
-      if((m_frameCount / 4) % 2)
-        SAFE_GL(glUniform4f(m_meshShader.colorId, 10, 10, 10, 0));
+      SAFE_GL(glBindBufferRange(GL_UNIFORM_BUFFER, MeshShader::VIEW_BINDING, m_stream->id, m_viewOffset + cmd.view * m_viewStride, sizeof(ViewConstants)));
+      state.view = cmd.view;
     }
 
     // Texture Unit 0: Diffuse
-    SAFE_GL(glActiveTexture(GL_TEXTURE0));
-    SAFE_GL(glBindTexture(GL_TEXTURE_2D, model.diffuse));
-    SAFE_GL(glUniform1i(m_meshShader.DiffuseTex, 0));
+    if(!depthOnly && model.diffuse != state.diffuse)
+    {
+      SAFE_GL(glActiveTexture(GL_TEXTURE0));
+      SAFE_GL(glBindTexture(GL_TEXTURE_2D, model.diffuse));
+      state.diffuse = model.diffuse;
+    }
 
     // Texture Unit 1: Lightmap
-    SAFE_GL(glActiveTexture(GL_TEXTURE1));
-    SAFE_GL(glBindTexture(GL_TEXTURE_2D, model.lightmap));
-    SAFE_GL(glUniform1i(m_meshShader.LightmapTex, 1));
+    if(!depthOnly && model.lightmap != state.lightmap)
+    {
+      SAFE_GL(glActiveTexture(GL_TEXTURE1));
+      SAFE_GL(glBindTexture(GL_TEXTURE_2D, model.lightmap));
+      state.lightmap = model.lightmap;
+    }
 
-    auto const forward = cmd.camera.dir.rotate(Vector3f(1, 0, 0));
-    auto const up = cmd.camera.dir.rotate(Vector3f(0, 0, 1));
+    // holds the vertex layout, see 'uploadVerticesToGPU'
+    if(model.vertexArray != state.vertexArray)
+    {
+      SAFE_GL(glBindVertexArray(model.vertexArray));
+      state.vertexArray = model.vertexArray;
+    }
 
-    auto const target = cmd.camera.pos + forward;
-    auto const view = ::lookAt(cmd.camera.pos, target, up);
-    auto const pos = ::translate(where.pos);
-    auto const scale = ::scale(Vector3f(where.size.cx, where.size.cy, where.size.cz));
-    auto const rotate = quaternionToMatrix(cmd.orientation);
+    // No 'baseInstance' in GLES 3: point at the first instance of the batch.
+    // (part of the vertex array state)
+    {
+      SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, m_stream->id));
 
-    static const float fovy = (float)((60.0f / 180) * PI);
-    static const float near_ = 0.1f;
-    static const float far_ = 100.0f;
-    const auto perspective = ::perspective(fovy, m_aspectRatio, near_, far_);
+      auto const base = m_instanceOffset + first * sizeof(Instance);
 
-    auto MV = pos * rotate * scale;
-    auto MVP = perspective * view * MV;
+      for(int i = 0; i < MeshShader::INSTANCE_M_LOCATIONS; ++i)
+      {
+        auto const offset = base + offsetof(Instance, M) + i * sizeof(Matrix4f::col);
+        SAFE_GL(glVertexAttribPointer(m_meshShader.instanceMLoc + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offset));
+      }
 
-    SAFE_GL(glUniformMatrix4fv(m_meshShader.M, 1, GL_FALSE, &MV[0][0]));
-    SAFE_GL(glUniformMatrix4fv(m_meshShader.MVP, 1, GL_FALSE, &MVP[0][0]));
-    SAFE_GL(glUniform3f(m_meshShader.CameraPos, cmd.camera.pos.x, cmd.camera.pos.y, cmd.camera.pos.z));
+      auto const offset = base + offsetof(Instance, fragOffset);
+      SAFE_GL(glVertexAttribPointer(m_meshShader.instanceFragOffsetLoc, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)offset));
+    }
 
-    SAFE_GL(glBindBuffer(GL_ARRAY_BUFFER, model.buffer));
+    auto const firstIndex = cmd.range ? cmd.range->first : 0;
+    auto const indexCount = cmd.range ? cmd.range->count : (int)model.indices.size();
+    auto const indexOffset = (void*)(firstIndex * sizeof(model.indices[0]));
 
-    SAFE_GL(glEnableVertexAttribArray(m_meshShader.positionLoc));
-    SAFE_GL(glEnableVertexAttribArray(m_meshShader.normalLoc));
-    SAFE_GL(glEnableVertexAttribArray(m_meshShader.uvDiffuseLoc));
-    SAFE_GL(glEnableVertexAttribArray(m_meshShader.uvLightmapLoc));
+    SAFE_GL(glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, indexOffset, count));
+  }
 
-#define OFFSET(a) (void*)(&(((SingleRenderMesh::Vertex*)nullptr)->a))
-    SAFE_GL(glVertexAttribPointer(m_meshShader.positionLoc, 3, GL_FLOAT, GL_FALSE, sizeof(SingleRenderMesh::Vertex), OFFSET(x)));
-    SAFE_GL(glVertexAttribPointer(m_meshShader.normalLoc, 3, GL_FLOAT, GL_FALSE, sizeof(SingleRenderMesh::Vertex), OFFSET(nx)));
-    SAFE_GL(glVertexAttribPointer(m_meshShader.uvDiffuseLoc, 2, GL_FLOAT, GL_FALSE, sizeof(SingleRenderMesh::Vertex), OFFSET(diffuse_u)));
-    SAFE_GL(glVertexAttribPointer(m_meshShader.uvLightmapLoc, 2, GL_FLOAT, GL_FALSE, sizeof(SingleRenderMesh::Vertex), OFFSET(lightmap_u)));
-#undef OFFSET
+  // Draws the bounding box of each command of [begin; end[ for its
+  // occlusion query, against the opaque depths, without writing anything.
+  void executeOcclusionQueries(int begin, int end, BoundState& state)
+  {
+    if(begin == end)
+      return;
+
+    SAFE_GL(glUseProgram(m_depthProgramId));
+    SAFE_GL(glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE));
+    SAFE_GL(glDepthMask(GL_FALSE));
+
+    // seen from outside, the front faces are enough: whatever the winding
+    SAFE_GL(glDisable(GL_CULL_FACE));
+
+    for(int i = begin; i < end; ++i)
+    {
+      auto& query = m_occlusionQueries[m_drawCommands[i].query];
 
-    SAFE_GL(glDrawArrays(GL_TRIANGLES, 0, model.vertices.size()));
+      SAFE_GL(glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, query.id));
+      executeBatch(i, 1, state, true);
+      SAFE_GL(glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE));
+
+      query.issued = true;
+    }
+
+    SAFE_GL(glEnable(GL_CULL_FACE));
+    SAFE_GL(glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE));
+    SAFE_GL(glUseProgram(m_meshShader.programId));
   }
 
 private:
   SDL_Window* m_window;
   SDL_GLContext m_context;
+  bool m_vsync = false;
 
   Camera m_camera;
 
-  // shader attribute/uniform locations
-  struct MeshShader
-  {
-    GLuint programId;
-    GLint CameraPos;
-    GLint M;
-    GLint MVP;
-    GLint colorId;
-    GLint ambientLoc;
-    GLint DiffuseTex;
-    GLint LightmapTex;
-    GLint positionLoc;
-    GLint uvDiffuseLoc;
-    GLint uvLightmapLoc;
-    GLint normalLoc;
-    GLint LightPosLoc;
-  };
-
   MeshShader m_meshShader;
+  GLuint m_depthProgramId; // see 'executeAllDrawCommands'
+  GLuint m_vertexArray;
+
+  // all the data uploaded each frame, see 'StreamBuffer'
+  std::unique_ptr<StreamBuffer> m_stream;
+  std::unique_ptr<StreamBuffer> m_streamIndices; // WebGL wants them apart
+  int m_instanceOffset = 0; // in 'm_stream', of 'm_instances'
+  int m_viewOffset = 0; // in 'm_stream', of the 'ViewConstants' of 'm_views'
+  int m_uniformAlignment = 1;
+  vector<Instance> m_instances; // scratch, avoids allocations
+
+  int m_viewStride; // multiple of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+  vector<View> m_views; // of the current frame
+  vector<uint8_t> m_viewData; // scratch, avoids allocations
+  vector<bool> m_visibleCells; // scratch, see 'markVisibleCells'
 
   vector<RenderMesh> m_Models;
   vector<RenderMesh> m_fontModel;
+  RenderMesh m_textMesh; // all the glyphs of the frame, see 'drawText'
+  SingleRenderMesh::Range m_textRange {}; // where they are in the stream buffers
+
+  // Ring of pixel pack buffers, see 'captureFrame':
+  // the readback of a frame completes while the next ones are drawn.
+  struct PendingCapture
+  {
+    GLuint buffer = 0;
+    GLsync fence = nullptr;
+    Size2i size {};
+  };
+
+  static auto constexpr CAPTURE_RING_SIZE = 3;
+  PendingCapture m_captures[CAPTURE_RING_SIZE];
+  int m_captureHead = 0; // the oldest pending one
+  int m_captureCount = 0;
+
+  // residency of each model of 'm_Models'
+  struct ModelInfo
+  {
+    string path; // empty if unloaded
+    vector<string> textures; // paths
+    int64_t vertexBytes = 0;
+    TrackedMemory meshMemory { MemoryTag::Meshes };
+    int lastDrawnFrame = 0;
+    bool resident = false;
+
+    // each instance drawn, see 'trackActor'
+    vector<ActorState> actors; // this frame
+    vector<ActorState> previousActors;
+    int actorFrame = -1;
+  };
+
+  struct OcclusionQuery
+  {
+    GLuint id = 0;
+    bool issued = false; // its result is to be read
+  };
+
+  vector<OcclusionQuery> m_occlusionQueries;
+  vector<int> m_freeOcclusionQueries;
+  RenderMesh m_boxMesh; // see 'isOccluded'
+
+  vector<ModelInfo> m_modelInfos;
+  map<int, shared_ptr<BackgroundLoad>> m_backgroundLoads; // by model id
+
+  // Textures of the models, shared by content (see 'hashTexture'): the
+  // copies of an image under different paths are a single GL texture.
+  struct CachedTexture
+  {
+    GLuint id = 0;
+    int refs = 0; // paths
+    int64_t bytes = 0;
+    bool translucent = false; // has alpha, see 'hasAlpha'
+  };
+
+  map<uint64_t, CachedTexture> m_textures;
+
+  struct TexturePath
+  {
+    uint64_t content = 0;
+    int refs = 0; // models
+  };
+
+  map<string, TexturePath> m_texturePaths;
+
+  // The levels of the textures not fully on the GPU yet, see 'uploadPendingTextures'
+  struct PendingTexture
+  {
+    GLuint id;
+    Texture tex;
+    int level; // the next one to upload. The larger ones follow.
+    TrackedMemory pixels; // of 'tex', on the CPU until uploaded
+  };
+
+  deque<PendingTexture> m_pendingTextures;
+  std::unique_ptr<StreamBuffer> m_streamPixels; // staging, bound as GL_PIXEL_UNPACK_BUFFER
+
+  // farther in a frame, an instance is another one (see 'trackActor')
+  static auto constexpr MAX_ACTOR_MOVE = 1.0f;
+
+  // around the bounding box of an actor, for its occlusion query
+  static auto constexpr OCCLUSION_BOX_MARGIN = 0.05f;
+
+  // of texture levels, per frame. The first level of a frame always goes.
+  static auto constexpr TEXTURE_UPLOAD_BUDGET = 2 * 1024 * 1024;
+
+  // Of the cooked textures the GPU can sample, preferred first
+  // (e.g "bc.tex"), "rgba.tex" last. Desktop drivers often decode
+  // ETC2 in software.
+  vector<string> m_cookedTextureExtensions;
+
+  int64_t m_residentBytes = 0; // model textures and vertices
+  int64_t m_memoryBudget = 0; // no limit
 
   float m_aspectRatio = 1.0;
+  int m_screenHeight = 1; // in pixels, see 'trackActor'
   float m_ambientLight = 0;
   int m_frameCount = 0;
 
   bool m_enablePostProcessing = true;
   bool m_enableFsaa = false;
+  bool m_enableDepthPrepass = true;
+  bool m_enableOcclusionCulling = true;
 
   std::unique_ptr<PostProcessing> m_postProcessing;
+  ResolutionScaler m_resolutionScaler;
+  std::unique_ptr<GpuTimer> m_gpuTimer;
 
   std::vector<DrawCommand> m_drawCommands;
 };
@@ -0,0 +1,66 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// The draw commands of a frame, and the order they're executed in.
+
+#pragma once
+
+#include "base/geom.h"
+#include "rendermesh.h"
+
+struct Camera
+{
+  Vector3f pos;
+  Quaternion dir;
+  bool valid = false;
+};
+
+struct DrawCommand
+{
+  SingleRenderMesh* pMesh;
+  Rect3f where;
+  Quaternion orientation;
+  Camera camera;
+  bool blinking;
+  bool depthtest;
+  float depth; // squared distance to the camera
+  int view; // index in 'm_views', once the frame is over
+  SingleRenderMesh::Range const* range; // null: all the triangles
+  int query = -1; // the bounding box of an actor, for this occlusion query (see 'isOccluded')
+};
+
+// Opaque first: groups the commands sharing the same state, nearest first
+// (early depth rejection). Then the occlusion queries, once all the opaque
+// depths are there. Then the translucent ones, farthest first, for the
+// blending. Commands without depth test are overlays: they come last, in
+// submission order.
+inline bool drawsBefore(DrawCommand const& a, DrawCommand const& b)
+{
+  if(a.depthtest != b.depthtest)
+    return a.depthtest;
+
+  if(!a.depthtest)
+    return false;
+
+  auto const stage = [] (DrawCommand const& cmd) { return cmd.pMesh->translucent ? 2 : cmd.query >= 0 ? 1 : 0; };
+
+  if(stage(a) != stage(b))
+    return stage(a) < stage(b);
+
+  if(a.pMesh->translucent)
+    return a.depth > b.depth;
+
+  if(a.pMesh->diffuse != b.pMesh->diffuse)
+    return a.pMesh->diffuse < b.pMesh->diffuse;
+
+  if(a.pMesh->lightmap != b.pMesh->lightmap)
+    return a.pMesh->lightmap < b.pMesh->lightmap;
+
+  if(a.pMesh->buffer != b.pMesh->buffer)
+    return a.pMesh->buffer < b.pMesh->buffer;
+
+  return a.depth < b.depth;
+}
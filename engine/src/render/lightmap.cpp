@@ -0,0 +1,261 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "lightmap.h"
+
+#include <algorithm> // sort, min, max
+#include <cmath> // ceil, round, sqrt
+#include <stdexcept>
+
+#include "base/util.h" // clamp
+
+namespace
+{
+// empty texels around each chart: the bilinear fetches of a chart never
+// reach its neighbors
+auto const PADDING = 1;
+
+Vector3f getPos(SingleRenderMesh::PackedVertex const& v)
+{
+  return Vector3f(v.x, v.y, v.z);
+}
+
+// The triangle, laid flat: 'a' at the origin, 'b' on the x axis, 'c' above it.
+// In world units.
+struct FlatTriangle
+{
+  Vector2f corners[3];
+  Vector3f normal;
+};
+
+FlatTriangle flatten(Vector3f a, Vector3f b, Vector3f c)
+{
+  FlatTriangle r {};
+
+  auto const ab = b - a;
+  auto const ac = c - a;
+  auto const cross = crossProduct(ab, ac);
+
+  // degenerate: a point
+  if(dotProduct(cross, cross) < 1e-12 || dotProduct(ab, ab) < 1e-12)
+    return r;
+
+  r.normal = normalize(cross);
+
+  auto const x = normalize(ab);
+  auto const y = crossProduct(r.normal, x);
+
+  r.corners[1] = Vector2f(magnitude(ab), 0);
+  r.corners[2] = Vector2f(dotProduct(ac, x), dotProduct(ac, y));
+  return r;
+}
+
+// Shelf packing, tallest first. Returns false if it doesn't fit in 'side' x 'side'.
+bool packCharts(vector<LightmapAtlas::Chart>& charts, int side)
+{
+  vector<int> order(charts.size());
+
+  for(int i = 0; i < (int)order.size(); ++i)
+    order[i] = i;
+
+  sort(order.begin(), order.end(), [&] (int a, int b) { return charts[a].size.height > charts[b].size.height; });
+
+  int x = 0;
+  int y = 0;
+  int shelfHeight = 0;
+
+  for(auto i : order)
+  {
+    auto& chart = charts[i];
+
+    if(chart.size.width > side)
+      return false;
+
+    if(x + chart.size.width > side)
+    {
+      x = 0;
+      y += shelfHeight;
+      shelfHeight = 0;
+    }
+
+    if(y + chart.size.height > side)
+      return false;
+
+    chart.pos = Vector2i(x, y);
+    x += chart.size.width;
+    shelfHeight = max(shelfHeight, chart.size.height);
+  }
+
+  return true;
+}
+
+uint16_t toUnorm16(float f)
+{
+  return (uint16_t)round(clamp(f, 0.0f, 1.0f) * 65535.0f);
+}
+
+// Directions spread over the hemisphere around +z, denser near the pole
+// (cosine-weighted): the occlusion of grazing rays matters less.
+vector<Vector3f> getHemisphereDirections(int count)
+{
+  vector<Vector3f> r;
+
+  auto const goldenAngle = PI * (3 - sqrt(5.0f));
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto const radius = sqrt((i + 0.5f) / count);
+    auto const angle = i * goldenAngle;
+    r.push_back(Vector3f(radius * cos(angle), radius * sin(angle), sqrt(1 - radius * radius)));
+  }
+
+  return r;
+}
+}
+
+LightmapAtlas packLightmap(RenderMesh& mesh, float texelsPerUnit, int maxSize)
+{
+  struct Triangle
+  {
+    int single;
+    int first;
+    FlatTriangle flat;
+  };
+
+  vector<Triangle> triangles;
+
+  for(int s = 0; s < (int)mesh.singleMeshes.size(); ++s)
+  {
+    auto& vertices = mesh.singleMeshes[s].vertices;
+
+    for(int i = 0; i + 2 < (int)vertices.size(); i += 3)
+      triangles.push_back({ s, i, flatten(getPos(vertices[i]), getPos(vertices[i + 1]), getPos(vertices[i + 2])) });
+  }
+
+  LightmapAtlas r;
+
+  for(auto density = texelsPerUnit;; density *= 0.8f)
+  {
+    if(density < 1e-4)
+      throw runtime_error("Can't fit the lightmap charts");
+
+    r.charts.clear();
+
+    for(auto& t : triangles)
+    {
+      auto const& c = t.flat.corners;
+      auto const minX = min(0.0f, c[2].x);
+      auto const maxX = max(c[1].x, c[2].x);
+
+      LightmapAtlas::Chart chart;
+      chart.single = t.single;
+      chart.first = t.first;
+      chart.size = Size2i(
+        (int)ceil((maxX - minX) * density) + 1 + PADDING * 2,
+        (int)ceil(c[2].y * density) + 1 + PADDING * 2);
+
+      for(int k = 0; k < 3; ++k)
+        chart.corners[k] = Vector2f((c[k].x - minX) * density + PADDING + 0.5f, c[k].y * density + PADDING + 0.5f);
+
+      r.charts.push_back(chart);
+    }
+
+    int side = 16;
+
+    while(side < maxSize && !packCharts(r.charts, side))
+      side *= 2;
+
+    if(side <= maxSize && packCharts(r.charts, side))
+    {
+      r.size = Size2i(side, side);
+      break;
+    }
+  }
+
+  for(auto& chart : r.charts)
+  {
+    auto& vertices = mesh.singleMeshes[chart.single].vertices;
+
+    for(int k = 0; k < 3; ++k)
+    {
+      chart.corners[k] = chart.corners[k] + Vector2f(chart.pos.x, chart.pos.y);
+
+      auto& v = vertices[chart.first + k];
+      v.lightmap[0] = toUnorm16(chart.corners[k].x / r.size.width);
+      v.lightmap[1] = toUnorm16(chart.corners[k].y / r.size.height);
+    }
+  }
+
+  return r;
+}
+
+Picture bakeLightmap(RenderMesh const& mesh, LightmapAtlas const& atlas, function<bool(Vector3f a, Vector3f b)> const& lineOfSight, float range)
+{
+  static auto const RAYS = 16;
+  static auto const directions = getHemisphereDirections(RAYS);
+
+  Picture r;
+  r.dim = atlas.size;
+  r.stride = atlas.size.width;
+  r.pixels.assign(r.dim.width * r.dim.height * 4, 0xff);
+
+  for(auto& chart : atlas.charts)
+  {
+    auto& vertices = mesh.singleMeshes[chart.single].vertices;
+    Vector3f const pos[3] = { getPos(vertices[chart.first]), getPos(vertices[chart.first + 1]), getPos(vertices[chart.first + 2]) };
+
+    auto const normal = flatten(pos[0], pos[1], pos[2]).normal;
+
+    if(dotProduct(normal, normal) == 0)
+      continue;
+
+    // a frame around the normal, for the directions
+    auto const tangent = normalize(crossProduct(normal, fabs(normal.x) < 0.9f ? Vector3f(1, 0, 0) : Vector3f(0, 1, 0)));
+    auto const bitangent = crossProduct(normal, tangent);
+
+    auto const& c = chart.corners;
+    auto const e1 = c[1] - c[0];
+    auto const e2 = c[2] - c[0];
+    auto const det = e1.x * e2.y - e1.y * e2.x;
+
+    for(int y = chart.pos.y; y < chart.pos.y + chart.size.height; ++y)
+    {
+      for(int x = chart.pos.x; x < chart.pos.x + chart.size.width; ++x)
+      {
+        // barycentric coordinates of the texel center. The padding gets
+        // the edges of the triangle.
+        auto const d = Vector2f(x + 0.5f, y + 0.5f) - c[0];
+        auto u = clamp((d.x * e2.y - d.y * e2.x) / det, 0.0f, 1.0f);
+        auto v = clamp((e1.x * d.y - e1.y * d.x) / det, 0.0f, 1.0f);
+
+        if(u + v > 1)
+        {
+          auto const sum = u + v;
+          u /= sum;
+          v /= sum;
+        }
+
+        auto const origin = pos[0] + (pos[1] - pos[0]) * u + (pos[2] - pos[0]) * v + normal * 0.05f;
+
+        int visible = 0;
+
+        for(auto& dir : directions)
+        {
+          auto const world = tangent * dir.x + bitangent * dir.y + normal * dir.z;
+
+          if(lineOfSight(origin, origin + world * range))
+            ++visible;
+        }
+
+        auto const value = (uint8_t)(255 * visible / RAYS);
+        auto pel = &r.pixels[(x + y * r.stride) * 4];
+        pel[0] = pel[1] = pel[2] = value;
+      }
+    }
+  }
+
+  return r;
+}
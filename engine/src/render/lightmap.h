@@ -0,0 +1,44 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Lightmaps, baked by the meshcooker: each triangle gets a place of its own
+// in one atlas, shared by all the single meshes of a model.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+using namespace std;
+
+#include "base/geom.h"
+#include "picture.h"
+#include "rendermesh.h"
+
+struct LightmapAtlas
+{
+  Size2i size; // in texels
+
+  // one per triangle of the single meshes
+  struct Chart
+  {
+    int single;
+    int first; // first vertex of the triangle
+    Vector2f corners[3]; // in texels
+    Vector2i pos; // the texels of the chart, padding included
+    Size2i size;
+  };
+
+  vector<Chart> charts;
+};
+
+// Sets the lightmap UVs of 'mesh', whose single meshes must still be
+// triangle soups (i.e not indexed yet).
+// The density drops below 'texelsPerUnit' if the charts don't fit in 'maxSize'.
+LightmapAtlas packLightmap(RenderMesh& mesh, float texelsPerUnit, int maxSize);
+
+// Ambient occlusion: the fraction of the rays leaving each texel that
+// reach 'range' without being blocked. The texels out of the charts are white.
+Picture bakeLightmap(RenderMesh const& mesh, LightmapAtlas const& atlas, function<bool(Vector3f a, Vector3f b)> const& lineOfSight, float range);
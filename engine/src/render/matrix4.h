@@ -4,10 +4,28 @@
 // published by the Free Software Foundation, either version 3 of the
 // License, or (at your option) any later version.
 
-// Matrix 4x4 class for display
+// Matrix 4x4 class for display.
+// Column-major. The products use SSE, NEON or WASM SIMD when the compiler
+// targets them, and plain scalar code otherwise (or with MATRIX4_NO_SIMD).
 
 #pragma once
 
+#include <cassert>
+#include <cmath>
+
+#include "base/geom.h"
+
+#if !defined(MATRIX4_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+#include <xmmintrin.h>
+#define MATRIX4_SSE 1
+#elif !defined(MATRIX4_NO_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MATRIX4_NEON 1
+#elif !defined(MATRIX4_NO_SIMD) && defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define MATRIX4_WASM 1
+#endif
+
 struct Matrix4f
 {
   Matrix4f(float init)
@@ -45,15 +63,66 @@ struct Matrix4f
   col data[4];
 };
 
+// Each column of the result is a linear combination of the columns of 'A'.
 inline
 Matrix4f operator * (Matrix4f const& A, Matrix4f const& B)
 {
   Matrix4f r(0);
 
-  for(int row = 0; row < 4; ++row)
-    for(int col = 0; col < 4; ++col)
+#if MATRIX4_SSE
+  auto const a0 = _mm_loadu_ps(A.data[0].elements);
+  auto const a1 = _mm_loadu_ps(A.data[1].elements);
+  auto const a2 = _mm_loadu_ps(A.data[2].elements);
+  auto const a3 = _mm_loadu_ps(A.data[3].elements);
+
+  for(int col = 0; col < 4; ++col)
+  {
+    auto const b = B.data[col].elements;
+    auto sum = _mm_mul_ps(a0, _mm_set1_ps(b[0]));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(b[1])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(b[2])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(b[3])));
+    _mm_storeu_ps(r.data[col].elements, sum);
+  }
+
+#elif MATRIX4_NEON
+  auto const a0 = vld1q_f32(A.data[0].elements);
+  auto const a1 = vld1q_f32(A.data[1].elements);
+  auto const a2 = vld1q_f32(A.data[2].elements);
+  auto const a3 = vld1q_f32(A.data[3].elements);
+
+  for(int col = 0; col < 4; ++col)
+  {
+    auto const b = B.data[col].elements;
+    auto sum = vmulq_n_f32(a0, b[0]);
+    sum = vmlaq_n_f32(sum, a1, b[1]);
+    sum = vmlaq_n_f32(sum, a2, b[2]);
+    sum = vmlaq_n_f32(sum, a3, b[3]);
+    vst1q_f32(r.data[col].elements, sum);
+  }
+
+#elif MATRIX4_WASM
+  auto const a0 = wasm_v128_load(A.data[0].elements);
+  auto const a1 = wasm_v128_load(A.data[1].elements);
+  auto const a2 = wasm_v128_load(A.data[2].elements);
+  auto const a3 = wasm_v128_load(A.data[3].elements);
+
+  for(int col = 0; col < 4; ++col)
+  {
+    auto const b = B.data[col].elements;
+    auto sum = wasm_f32x4_mul(a0, wasm_f32x4_splat(b[0]));
+    sum = wasm_f32x4_add(sum, wasm_f32x4_mul(a1, wasm_f32x4_splat(b[1])));
+    sum = wasm_f32x4_add(sum, wasm_f32x4_mul(a2, wasm_f32x4_splat(b[2])));
+    sum = wasm_f32x4_add(sum, wasm_f32x4_mul(a3, wasm_f32x4_splat(b[3])));
+    wasm_v128_store(r.data[col].elements, sum);
+  }
+
+#else
+
+  for(int col = 0; col < 4; ++col)
+    for(int row = 0; row < 4; ++row)
     {
-      double sum = 0;
+      float sum = 0;
 
       for(int k = 0; k < 4; ++k)
         sum += A[k][row] * B[col][k];
@@ -61,6 +130,8 @@ Matrix4f operator * (Matrix4f const& A, Matrix4f const& B)
       r[col][row] = sum;
     }
 
+#endif
+
   return r;
 }
 
@@ -164,3 +235,20 @@ Matrix4f quaternionToMatrix(const Quaternion& q)
   return r;
 }
 
+// Same as 'translate(pos) * quaternionToMatrix(orientation) * scale(size)',
+// without the products.
+inline
+Matrix4f transform(Vector3f pos, Quaternion const& orientation, Vector3f size)
+{
+  auto r = quaternionToMatrix(orientation);
+  float const factors[] = { size.x, size.y, size.z };
+
+  for(int col = 0; col < 3; ++col)
+    for(int row = 0; row < 3; ++row)
+      r[col][row] *= factors[col];
+
+  r[3][0] = pos.x;
+  r[3][1] = pos.y;
+  r[3][2] = pos.z;
+  return r;
+}
@@ -12,9 +12,10 @@
 #include <map>
 #include <memory>
 #include <stdexcept>
+#include <cstdio> // fprintf
 #include <stdint.h>
 #include <string>
-#include <string.h>
+#include <string.h> // memcmp
 #include <vector>
 
 #include "misc/file.h"
@@ -51,17 +52,167 @@ String parseLine(String& stream)
 {
   String r = stream;
 
-  while(stream[0] != 0 && stream[0] != '\n')
+  while(stream.len > 0 && stream[0] != '\n')
     stream += 1;
 
   r.len = stream.data - r.data;
 
   // skip EOL
-  stream += 1;
+  if(stream.len > 0)
+    stream += 1;
+
+  return r;
+}
+
+// up to the next empty line
+int countLines(String stream)
+{
+  int r = 0;
+
+  while(stream.len > 0 && parseLine(stream).len > 0)
+    ++r;
 
   return r;
 }
 
+void skipSpaces(String& s)
+{
+  while(s.len > 0 && (s[0] == ' ' || s[0] == '\t' || s[0] == '\r'))
+    s += 1;
+}
+
+bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+// Decimal, with an optional exponent, as written by the exporter (Python's 'str').
+// Unlike 'strtof', doesn't depend on the locale.
+bool parseFloat(String& s, float& value)
+{
+  static const double powersOfTen[] =
+  {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+
+  skipSpaces(s);
+
+  bool negative = false;
+
+  if(s.len > 0 && (s[0] == '-' || s[0] == '+'))
+  {
+    negative = s[0] == '-';
+    s += 1;
+  }
+
+  uint64_t mantissa = 0;
+  int digits = 0; // significant ones, in 'mantissa'
+  int exponent = 0;
+  bool any = false;
+
+  for(; s.len > 0 && isDigit(s[0]); s += 1)
+  {
+    any = true;
+
+    if(digits < 19)
+    {
+      mantissa = mantissa * 10 + (s[0] - '0');
+      digits += mantissa > 0;
+    }
+    else
+      ++exponent;
+  }
+
+  if(s.len > 0 && s[0] == '.')
+  {
+    s += 1;
+
+    for(; s.len > 0 && isDigit(s[0]); s += 1)
+    {
+      any = true;
+
+      if(digits < 19)
+      {
+        mantissa = mantissa * 10 + (s[0] - '0');
+        digits += mantissa > 0;
+        --exponent;
+      }
+    }
+  }
+
+  if(!any)
+    return false;
+
+  if(s.len > 0 && (s[0] == 'e' || s[0] == 'E'))
+  {
+    s += 1;
+
+    bool negativeExponent = false;
+
+    if(s.len > 0 && (s[0] == '-' || s[0] == '+'))
+    {
+      negativeExponent = s[0] == '-';
+      s += 1;
+    }
+
+    if(s.len == 0 || !isDigit(s[0]))
+      return false;
+
+    int e = 0;
+
+    for(; s.len > 0 && isDigit(s[0]); s += 1)
+      e = min(e * 10 + (s[0] - '0'), 1000);
+
+    exponent += negativeExponent ? -e : e;
+  }
+
+  // the mantissa and the powers up to 1e22 are exact doubles:
+  // a single rounding, for the digits of the exporter
+  double r = (double)mantissa;
+
+  while(exponent > 22)
+  {
+    r *= 1e22;
+    exponent -= 22;
+  }
+
+  while(exponent < -22)
+  {
+    r /= 1e22;
+    exponent += 22;
+  }
+
+  r = exponent >= 0 ? r * powersOfTen[exponent] : r / powersOfTen[-exponent];
+
+  value = (float)(negative ? -r : r);
+  return true;
+}
+
+bool acceptChar(String& s, char c)
+{
+  skipSpaces(s);
+
+  if(s.len == 0 || s[0] != c)
+    return false;
+
+  s += 1;
+  return true;
+}
+
+// "x y z - nx ny nz - u v"
+bool parseVertex(String line, Mesh::Vertex& vertex)
+{
+  auto ok = parseFloat(line, vertex.x) && parseFloat(line, vertex.y) && parseFloat(line, vertex.z)
+    && acceptChar(line, '-')
+    && parseFloat(line, vertex.nx) && parseFloat(line, vertex.ny) && parseFloat(line, vertex.nz)
+    && acceptChar(line, '-')
+    && parseFloat(line, vertex.u) && parseFloat(line, vertex.v);
+
+  skipSpaces(line);
+  return ok && line.len == 0;
+}
+
 bool accept(String& line, String word)
 {
   if(!startsWith(line, word))
@@ -77,6 +228,9 @@ Mesh parseOneMesh(String& stream, String name)
 
   mesh.name.assign(name.begin(), name.end());
 
+  // almost all the lines are vertices
+  mesh.vertices.reserve(countLines(stream));
+
   while(stream.len)
   {
     auto line = parseLine(stream);
@@ -85,13 +239,8 @@ Mesh parseOneMesh(String& stream, String name)
       break;
 
     Mesh::Vertex vertex;
-    int count = sscanf(line.data,
-                       "%f %f %f - %f %f %f - %f %f",
-                       &vertex.x, &vertex.y, &vertex.z,
-                       &vertex.nx, &vertex.ny, &vertex.nz,
-                       &vertex.u, &vertex.v);
 
-    if(count == 8)
+    if(parseVertex(line, vertex))
     {
       mesh.vertices.push_back(vertex);
     }
@@ -113,6 +262,8 @@ Mesh parseOneMesh(String& stream, String name)
       throw runtime_error("Invalid line in mesh file: '" + string(line.begin(), line.end()) + "'");
   }
 
+  mesh.faces.reserve(mesh.vertices.size() / 3);
+
   for(int i = 0; i <= (int)mesh.vertices.size() - 3; i += 3)
     mesh.faces.push_back({ i, i + 1, i + 2 });
 
@@ -148,9 +299,9 @@ std::vector<Mesh> importMesh(char const* path)
   std::vector<Mesh> meshes;
   std::map<std::string, Material> materials;
 
-  auto s = File::read(path);
+  auto const file = File::map(path);
 
-  auto stream = String { s.data(), (int)s.size() };
+  auto stream = String { (char const*)file->data.data, file->data.len };
 
   while(stream.len > 0)
   {
@@ -1,6 +1,7 @@
 #include "misc/file.h"
 #include "picture.h"
 #include "png.h"
+#include <algorithm> // swap_ranges
 #include <cstring> // memcpy
 
 namespace
@@ -49,39 +50,46 @@ Picture addBorderToTiles(PictureView src, int cols, int rows)
   return dst;
 }
 
-Picture loadPicture(const char* path)
+Picture decodePicture(Span<const uint8_t> pngData)
 {
-  try
+  Picture pic;
+  pic.pixels = decodePng(pngData, pic.dim.width, pic.dim.height);
+  pic.stride = pic.dim.width;
+
+  auto const rowSize = 4 * pic.dim.width;
+
+  // from glTexImage2D doc:
+  // "The first element corresponds to the lower left corner of the texture image",
+  // (e.g (u,v) = (0,0))
+  // The rows are swapped in place: no second image.
+  for(int y = 0; y < pic.dim.height / 2; ++y)
   {
-    Picture pic;
-    auto pngDataBuf = File::read(path);
-    auto pngData = Span<const uint8_t>((uint8_t*)pngDataBuf.data(), (int)pngDataBuf.size());
-    pic.pixels = decodePng(pngData, pic.dim.width, pic.dim.height);
-    pic.stride = pic.dim.width * 4;
+    auto top = pic.pixels.data() + y * rowSize;
+    auto bottom = pic.pixels.data() + (pic.dim.height - 1 - y) * rowSize;
+    std::swap_ranges(top, top + rowSize, bottom);
+  }
 
-    auto const bpp = 4;
+  return pic;
+}
 
-    vector<uint8_t> img(pic.dim.width * pic.dim.height * bpp);
+std::vector<uint8_t> encodePicture(PictureView pic)
+{
+  auto const bpp = 4;
 
-    auto src = pic.pixels.data();
-    auto dst = img.data() + bpp * pic.dim.width * pic.dim.height;
+  // PNG rows are top first
+  std::vector<uint8_t> img(pic.dim.width * pic.dim.height * bpp);
 
-    // from glTexImage2D doc:
-    // "The first element corresponds to the lower left corner of the texture image",
-    // (e.g (u,v) = (0,0))
-    for(int y = 0; y < pic.dim.height; ++y)
-    {
-      dst -= bpp * pic.dim.width;
-      memcpy(dst, src, bpp * pic.dim.width);
-      src += pic.stride;
-    }
+  for(int y = 0; y < pic.dim.height; ++y)
+    memcpy(&img[(pic.dim.height - 1 - y) * pic.dim.width * bpp], pic.pixels + y * pic.stride * bpp, pic.dim.width * bpp);
 
-    Picture r;
-    r.dim = pic.dim;
-    r.stride = pic.dim.width;
-    r.pixels = std::move(img);
+  return encodePng({ img.data(), (int)img.size() }, pic.dim.width, pic.dim.height);
+}
 
-    return r;
+Picture loadPicture(const char* path)
+{
+  try
+  {
+    return decodePicture(File::map(path)->data);
   }
   catch(std::exception const& e)
   {
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "base/geom.h"
+#include "base/span.h"
 
 struct PictureView
 {
@@ -22,5 +23,12 @@ struct Picture
 };
 
 Picture addBorderToTiles(PictureView src, int cols, int rows);
+// bottom row first; throws on invalid data
+Picture decodePicture(Span<const uint8_t> pngData);
+
+// The reverse of 'decodePicture'.
+std::vector<uint8_t> encodePicture(PictureView pic);
+
+// falls back on a generated texture
 Picture loadPicture(const char* path);
 
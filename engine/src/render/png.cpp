@@ -23,11 +23,18 @@
 
 #include "base/span.h"
 #include "misc/decompress.h"
+#include <algorithm> // min
 #include <climits>
 #include <cstdint>
+#include <cstring> // memcpy, memmove
 #include <stdexcept>
 #include <vector>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PNG_SSE2 1
+#endif
+
 namespace
 {
 struct Info
@@ -170,6 +177,132 @@ void unFilterScanline(uint8_t* recon, const uint8_t* scanline, const uint8_t* pr
   }
 }
 
+#if PNG_SSE2
+__m128i load4(const uint8_t* p)
+{
+  int32_t v;
+  memcpy(&v, p, 4);
+  return _mm_cvtsi32_si128(v);
+}
+
+void store4(uint8_t* p, __m128i v)
+{
+  auto const i = _mm_cvtsi128_si32(v);
+  memcpy(p, &i, 4);
+}
+
+__m128i abs16(__m128i v)
+{
+  return _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v));
+}
+
+// 'unFilterScanline' for 4 bytes per pixel. Apart from 'Up', each pixel
+// depends on the one before it: the 4 channels are done together, one
+// pixel at a time.
+// 'recon' may be before 'scanline' in the same buffer: each pixel is read
+// before anything is written over it.
+void unFilterRgbaScanline(uint8_t* recon, const uint8_t* scanline, const uint8_t* precon, unsigned long filterType, size_t length)
+{
+  if(!precon) // first line: nothing above
+  {
+    unFilterScanline(recon, scanline, precon, 4, filterType, length);
+    return;
+  }
+
+  auto const zero = _mm_setzero_si128();
+
+  switch(filterType)
+  {
+  case 0:
+    memmove(recon, scanline, length);
+    break;
+  case 1:
+    {
+      auto a = zero;
+
+      for(size_t i = 0; i < length; i += 4)
+      {
+        a = _mm_add_epi8(a, load4(scanline + i));
+        store4(recon + i, a);
+      }
+
+      break;
+    }
+  case 2:
+    {
+      size_t i = 0;
+
+      for(; i + 16 <= length; i += 16)
+      {
+        auto const x = _mm_loadu_si128((const __m128i*)(scanline + i));
+        auto const b = _mm_loadu_si128((const __m128i*)(precon + i));
+        _mm_storeu_si128((__m128i*)(recon + i), _mm_add_epi8(x, b));
+      }
+
+      for(; i < length; i += 4)
+        store4(recon + i, _mm_add_epi8(load4(scanline + i), load4(precon + i)));
+
+      break;
+    }
+  case 3:
+    {
+      auto const one = _mm_set1_epi8(1);
+      auto a = zero;
+
+      for(size_t i = 0; i < length; i += 4)
+      {
+        auto const b = load4(precon + i);
+
+        // '_mm_avg_epu8' rounds up, the filter rounds down
+        auto const avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+        a = _mm_add_epi8(load4(scanline + i), avg);
+        store4(recon + i, a);
+      }
+
+      break;
+    }
+  case 4:
+    {
+      // 16-bit lanes: the distances don't fit in a byte
+      auto a = zero;
+      auto c = zero;
+
+      for(size_t i = 0; i < length; i += 4)
+      {
+        auto const b = _mm_unpacklo_epi8(load4(precon + i), zero);
+
+        // see 'paethPredictor', with p = a + b - c
+        auto const pa = abs16(_mm_sub_epi16(b, c));
+        auto const pb = abs16(_mm_sub_epi16(a, c));
+        auto const pc = abs16(_mm_sub_epi16(_mm_add_epi16(a, b), _mm_add_epi16(c, c)));
+
+        auto const notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+        auto const useC = _mm_cmpgt_epi16(pb, pc);
+        auto const bOrC = _mm_or_si128(_mm_and_si128(useC, c), _mm_andnot_si128(useC, b));
+        auto const predictor = _mm_or_si128(_mm_andnot_si128(notA, a), _mm_and_si128(notA, bOrC));
+
+        auto const x = _mm_add_epi8(load4(scanline + i), _mm_packus_epi16(predictor, predictor));
+        store4(recon + i, x);
+
+        a = _mm_unpacklo_epi8(x, zero);
+        c = b;
+      }
+
+      break;
+    }
+  default:
+    throw std::runtime_error("unexisting filter type given");
+  }
+}
+
+#else
+void unFilterRgbaScanline(uint8_t* recon, const uint8_t* scanline, const uint8_t* precon, unsigned long filterType, size_t length)
+{
+  unFilterScanline(recon, scanline, precon, 4, filterType, length);
+}
+
+#endif
+
 void setBitOfReversedStream(size_t& bitp, uint8_t* bits, unsigned long bit)
 {
   bits[bitp >> 3] |= (bit << (7 - (bitp & 0x7)));
@@ -231,11 +364,14 @@ Info decode(std::vector<uint8_t>& out, Span<const uint8_t> in)
 
   auto info = readPngHeader(in);
 
+  // only RGBA8 goes further: don't decompress the others for nothing
+  enforce(info.colorType == 6 && info.bitDepth == 8, "unsupported colorType/bitdepth");
+
   size_t pos = 33; // first byte of the first chunk after the header
-  std::vector<uint8_t> idat; // the data from idat chunks
+  std::vector<Span<const uint8_t>> idatChunks;
   bool IEND = false;
 
-  while(!IEND) // loop through the chunks, ignoring unknown chunks and stopping at IEND chunk. IDAT data is put at the start of the in buffer
+  while(!IEND) // loop through the chunks, ignoring unknown chunks and stopping at IEND chunk
   {
     enforce(pos + 8 < (size_t)in.len, "truncated chunk header");
 
@@ -247,7 +383,7 @@ Info decode(std::vector<uint8_t>& out, Span<const uint8_t> in)
 
     if(in[pos + 0] == 'I' && in[pos + 1] == 'D' && in[pos + 2] == 'A' && in[pos + 3] == 'T') // IDAT chunk, containing compressed image data
     {
-      idat.insert(idat.end(), &in[pos + 4], &in[pos + 4 + chunkLength]);
+      idatChunks.push_back({ &in[pos + 4], (int)chunkLength });
       pos += (4 + chunkLength);
     }
     else if(in[pos + 0] == 'I' && in[pos + 1] == 'E' && in[pos + 2] == 'N' && in[pos + 3] == 'D')
@@ -316,45 +452,55 @@ Info decode(std::vector<uint8_t>& out, Span<const uint8_t> in)
   }
 
   unsigned long bpp = getBpp(info);
-  auto scanlines = ::decompress(Span<const uint8_t> { idat.data(), (int)idat.size() });
-
   size_t bytewidth = (bpp + 7) / 8, outlength = (info.height * info.width * bpp + 7) / 8;
-  out.resize(outlength); // time to fill the out buffer
-  uint8_t* out_ = outlength ? &out[0] : 0; // use a regular pointer to the std::vector for faster code if compiled without optimization
 
-  if(info.interlaceMethod == 0) // no interlace, just filter
+  // a single IDAT chunk (the usual case) is decompressed where it is
+  std::vector<uint8_t> idat;
+  Span<const uint8_t> zlibData {};
+
+  if(idatChunks.size() == 1)
+  {
+    zlibData = idatChunks[0];
+  }
+  else
   {
-    size_t linestart = 0, linelength = (info.width * bpp + 7) / 8; // length in bytes of a scanline, excluding the filtertype byte
+    for(auto chunk : idatChunks)
+      idat.insert(idat.end(), chunk.data, chunk.data + chunk.len);
 
-    if(bpp >= 8) // byte per byte
-      for(unsigned long y = 0; y < info.height; y++)
-      {
-        unsigned long filterType = scanlines[linestart];
-        const uint8_t* prevline = (y == 0) ? 0 : &out_[(y - 1) * info.width * bytewidth];
-        unFilterScanline(&out_[linestart - y], &scanlines[linestart + 1], prevline, bytewidth, filterType, linelength);
+    zlibData = { idat.data(), (int)idat.size() };
+  }
 
-        linestart += (1 + linelength); // go to start of next scanline
-      }
+  if(info.interlaceMethod == 0) // no interlace, just filter
+  {
+    size_t linelength = info.width * bytewidth; // length in bytes of a scanline, excluding the filtertype byte
 
-    else // less than 8 bits per pixel, so fill it up bit per bit
-    {
-      std::vector<uint8_t> templine((info.width * bpp + 7) >> 3); // only used if bpp < 8
+    // Unfiltered in place: each line moves back over its filter byte, and
+    // those of the lines before it, to its final position.
+    out = ::decompress(zlibData, info.height * (1 + linelength));
+    enforce(out.size() >= info.height * (1 + linelength), "truncated image data");
 
-      for(size_t y = 0, obp = 0; y < info.height; y++)
-      {
-        unsigned long filterType = scanlines[linestart];
-        const uint8_t* prevline = (y == 0) ? 0 : &out_[(y - 1) * info.width * bytewidth];
-        unFilterScanline(&templine[0], &scanlines[linestart + 1], prevline, bytewidth, filterType, linelength);
+    uint8_t* out_ = out.data();
 
-        for(size_t bp = 0; bp < info.width * bpp;)
-          setBitOfReversedStream(obp, out_, readBitFromReversedStream(bp, &templine[0]));
+    for(unsigned long y = 0; y < info.height; y++)
+    {
+      auto const scanline = out_ + y * (1 + linelength);
+      auto const recon = out_ + y * linelength;
+      const uint8_t* prevline = (y == 0) ? 0 : recon - linelength;
 
-        linestart += (1 + linelength); // go to start of next scanline
-      }
+      if(bytewidth == 4)
+        unFilterRgbaScanline(recon, scanline + 1, prevline, scanline[0], linelength);
+      else
+        unFilterScanline(recon, scanline + 1, prevline, bytewidth, scanline[0], linelength);
     }
+
+    out.resize(outlength);
   }
   else // interlaceMethod is 1 (Adam7)
   {
+    auto const scanlines = ::decompress(zlibData);
+    out.resize(outlength);
+    uint8_t* out_ = outlength ? &out[0] : 0; // use a regular pointer to the std::vector for faster code if compiled without optimization
+
     size_t passw[7] = { (info.width + 7) / 8, (info.width + 3) / 8, (info.width + 3) / 4, (info.width + 1) / 4, (info.width + 1) / 2, (info.width + 0) / 2, (info.width + 0) / 1 };
     size_t passh[7] = { (info.height + 7) / 8, (info.height + 7) / 8, (info.height + 3) / 8, (info.height + 3) / 4, (info.height + 1) / 4, (info.height + 1) / 2, (info.height + 0) / 2 };
     size_t passstart[7] = { 0 };
@@ -363,14 +509,14 @@ Info decode(std::vector<uint8_t>& out, Span<const uint8_t> in)
     for(int i = 0; i < 6; i++)
       passstart[i + 1] = passstart[i] + passh[i] * ((passw[i] ? 1 : 0) + (passw[i] * bpp + 7) / 8);
 
+    enforce(scanlines.size() >= passstart[6] + passh[6] * ((passw[6] ? 1 : 0) + (passw[6] * bpp + 7) / 8), "truncated image data");
+
     std::vector<uint8_t> scanlineo((info.width * bpp + 7) / 8), scanlinen((info.width * bpp + 7) / 8); // "old" and "new" scanline
 
     for(int i = 0; i < 7; i++)
       adam7Pass(&out_[0], &scanlinen[0], &scanlineo[0], &scanlines[passstart[i]], info.width, pattern[i], pattern[i + 7], pattern[i + 14], pattern[i + 21], passw[i], passh[i], bpp);
   }
 
-  enforce(info.colorType == 6 && info.bitDepth == 8, "unsupported colorType/bitdepth");
-
   return info;
 }
 }
@@ -386,3 +532,122 @@ std::vector<uint8_t> decodePng(Span<const uint8_t> pngData, int& width, int& hei
   return r;
 }
 
+
+namespace
+{
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len)
+{
+  static uint32_t table[256];
+
+  if(!table[1])
+  {
+    for(uint32_t n = 0; n < 256; ++n)
+    {
+      uint32_t c = n;
+
+      for(int k = 0; k < 8; ++k)
+        c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+
+      table[n] = c;
+    }
+  }
+
+  crc = ~crc;
+
+  for(size_t i = 0; i < len; ++i)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+  return ~crc;
+}
+
+void write32bitInt(std::vector<uint8_t>& out, uint32_t value)
+{
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+void writeChunk(std::vector<uint8_t>& out, const char* type, std::vector<uint8_t> const& data)
+{
+  write32bitInt(out, data.size());
+
+  auto const start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+
+  write32bitInt(out, crc32(0, out.data() + start, out.size() - start));
+}
+
+// zlib stream of 'stored' deflate blocks: no compression
+std::vector<uint8_t> storeZlib(std::vector<uint8_t> const& data)
+{
+  std::vector<uint8_t> r = { 0x78, 0x01 };
+
+  size_t pos = 0;
+
+  do
+  {
+    auto const len = std::min<size_t>(data.size() - pos, 65535);
+    auto const last = pos + len == data.size();
+
+    r.push_back(last ? 1 : 0);
+    r.push_back(len & 0xff);
+    r.push_back(len >> 8);
+    r.push_back(~len & 0xff);
+    r.push_back((~len >> 8) & 0xff);
+    r.insert(r.end(), data.begin() + pos, data.begin() + pos + len);
+    pos += len;
+  }
+  while(pos < data.size());
+
+  uint32_t a = 1, b = 0;
+
+  for(auto byte : data)
+  {
+    a = (a + byte) % 65521;
+    b = (b + a) % 65521;
+  }
+
+  write32bitInt(r, (b << 16) | a);
+  return r;
+}
+}
+
+std::vector<uint8_t> encodePng(Span<const uint8_t> rgbaPixels, int width, int height)
+{
+  enforce(width > 0 && height > 0 && rgbaPixels.len == width * height * 4, "invalid picture size");
+
+  static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+  std::vector<uint8_t> r(signature, signature + sizeof signature);
+
+  {
+    std::vector<uint8_t> header;
+    write32bitInt(header, width);
+    write32bitInt(header, height);
+    header.push_back(8); // bit depth
+    header.push_back(6); // RGBA
+    header.push_back(0); // compression method
+    header.push_back(0); // filter method
+    header.push_back(0); // no interlace
+    writeChunk(r, "IHDR", header);
+  }
+
+  {
+    // each scanline starts with its filter type: 0, none
+    std::vector<uint8_t> scanlines;
+    scanlines.reserve((width * 4 + 1) * height);
+
+    for(int y = 0; y < height; ++y)
+    {
+      scanlines.push_back(0);
+      scanlines.insert(scanlines.end(), rgbaPixels.data + y * width * 4, rgbaPixels.data + (y + 1) * width * 4);
+    }
+
+    writeChunk(r, "IDAT", storeZlib(scanlines));
+  }
+
+  writeChunk(r, "IEND", {});
+
+  return r;
+}
@@ -6,3 +6,7 @@
 
 std::vector<uint8_t> decodePng(Span<const uint8_t> buffer, int& width, int& height);
 
+
+// Uncompressed (stored) PNG, e.g for the textures made by the meshcooker.
+// 'rgbaPixels': top row first, like the output of 'decodePng'.
+std::vector<uint8_t> encodePng(Span<const uint8_t> rgbaPixels, int width, int height);
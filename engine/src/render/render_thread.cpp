@@ -0,0 +1,220 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Render thread, and the hand-over of the display's context.
+
+#include "render_thread.h"
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "base/profiler.h"
+#include "display.h"
+
+struct RenderThread::Impl
+{
+  Impl(Display* display_, function<void()> drawFrame_, bool threaded) :
+    display(display_),
+    drawFrame(drawFrame_)
+  {
+#ifdef __EMSCRIPTEN__
+    threaded = false; // the WebGL context stays on the main thread
+#endif
+
+    if(!threaded)
+      return;
+
+    display->releaseContext();
+    worker = thread([this] () { renderMain(); });
+  }
+
+  ~Impl()
+  {
+    if(!worker.joinable())
+      return;
+
+    {
+      lock_guard<mutex> guard(lock);
+      quit = true;
+    }
+
+    wake.notify_all();
+    worker.join();
+
+    display->acquireContext();
+  }
+
+  void renderMain()
+  {
+    setProfilerThreadName("render");
+    display->acquireContext();
+
+    unique_lock<mutex> guard(lock);
+
+    while(1)
+    {
+      wake.wait(guard, [&] () { return quit || drawing || borrowed; });
+
+      if(borrowed)
+      {
+        // give the context to the thread in 'exclusive', until it's done
+        display->releaseContext();
+        released = true;
+        wake.notify_all();
+
+        wake.wait(guard, [&] () { return !borrowed; });
+
+        released = false;
+        display->acquireContext();
+        continue;
+      }
+
+      if(drawing)
+      {
+        guard.unlock();
+
+        try
+        {
+          PROFILE_SCOPE("RenderThread::drawFrame");
+          drawFrame();
+        }
+        catch(...)
+        {
+          lock_guard<mutex> errorGuard(errorLock);
+          error = current_exception();
+        }
+
+        guard.lock();
+        drawing = false;
+        wake.notify_all();
+        continue;
+      }
+
+      // 'drawing' is checked first: the last frame gets drawn
+      if(quit)
+        break;
+    }
+
+    display->releaseContext();
+  }
+
+  // errors of the render thread are thrown on the game thread
+  void rethrowError()
+  {
+    exception_ptr e;
+
+    {
+      lock_guard<mutex> guard(errorLock);
+      swap(e, error);
+    }
+
+    if(e)
+      rethrow_exception(e);
+  }
+
+  void submit(function<void()> const& swapFrames)
+  {
+    if(!worker.joinable())
+    {
+      swapFrames();
+      drawFrame();
+      return;
+    }
+
+    rethrowError();
+
+    {
+      unique_lock<mutex> guard(lock);
+      wake.wait(guard, [&] () { return !drawing; });
+
+      swapFrames();
+      drawing = true;
+    }
+
+    wake.notify_all();
+  }
+
+  void exclusive(function<void()> const& f)
+  {
+    if(!worker.joinable())
+    {
+      f();
+      return;
+    }
+
+    rethrowError();
+
+    {
+      unique_lock<mutex> guard(lock);
+      wake.wait(guard, [&] () { return !drawing; });
+
+      borrowed = true;
+      wake.notify_all();
+
+      wake.wait(guard, [&] () { return released; });
+    }
+
+    display->acquireContext();
+
+    try
+    {
+      f();
+    }
+    catch(...)
+    {
+      giveBack();
+      throw;
+    }
+
+    giveBack();
+  }
+
+  void giveBack()
+  {
+    display->releaseContext();
+
+    {
+      lock_guard<mutex> guard(lock);
+      borrowed = false;
+    }
+
+    wake.notify_all();
+  }
+
+  Display* const display;
+  function<void()> const drawFrame;
+
+  thread worker;
+
+  mutex lock;
+  condition_variable wake;
+  bool drawing = false; // a frame was submitted, and isn't drawn yet
+  bool borrowed = false; // requested by 'exclusive'
+  bool released = false; // the render thread doesn't hold the context
+  bool quit = false;
+
+  mutex errorLock;
+  exception_ptr error;
+};
+
+RenderThread::RenderThread(Display* display, function<void()> drawFrame, bool threaded) :
+  m_impl(make_unique<Impl>(display, drawFrame, threaded))
+{
+}
+
+RenderThread::~RenderThread() = default;
+
+void RenderThread::submit(function<void()> const& swapFrames)
+{
+  m_impl->submit(swapFrames);
+}
+
+void RenderThread::exclusive(function<void()> const& f)
+{
+  m_impl->exclusive(f);
+}
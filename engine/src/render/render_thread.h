@@ -0,0 +1,42 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Draws the frames on a thread of its own, while the next one is simulated.
+// The display's context belongs to the render thread: any other use of the
+// display must go through 'exclusive'.
+// Without threads (e.g in the browser), the frames are drawn right away.
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+using namespace std;
+
+struct Display;
+
+struct RenderThread
+{
+  // 'drawFrame' is called from the render thread, for each submitted frame.
+  // The display's context must be current on the calling thread.
+  RenderThread(Display* display, function<void()> drawFrame, bool threaded = true);
+
+  // Draws the last frame, if needed, and gives the context back.
+  ~RenderThread();
+
+  // Waits for the previous frame to be drawn, then calls 'swapFrames'
+  // (e.g to hand over the frame just built), and starts drawing.
+  void submit(function<void()> const& swapFrames);
+
+  // Waits for the frame being drawn, then calls 'f' from the calling
+  // thread, with the display's context current.
+  void exclusive(function<void()> const& f);
+
+  struct Impl;
+
+private:
+  unique_ptr<Impl> m_impl;
+};
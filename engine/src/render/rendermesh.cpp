@@ -8,8 +8,236 @@
 #include "base/util.h" // setExtension
 #include "misc/file.h"
 #include "rendermesh.h"
+#include <algorithm> // max
+#include <cmath> // floor, round, ldexp
+#include <cstdio>
 #include <stdexcept>
-#include <string.h> // strlen
+#include <string.h> // strlen, memcpy, memcmp
+
+namespace
+{
+auto const MESH_MAGIC = "MESH";
+uint32_t const MESH_VERSION = 5;
+
+auto const PVS_MAGIC = "PVS ";
+uint32_t const PVS_VERSION = 1;
+
+// see 'RenderMesh::selectLod'
+auto const MAX_LOD_ERROR_PIXELS = 1.0f;
+auto const LOD_HYSTERESIS = 1.25f;
+
+// native byte order: only read by the game built along with the meshcooker
+struct Writer
+{
+  string data;
+
+  template<typename T>
+  void pod(T const& value)
+  {
+    data.append((char const*)&value, sizeof value);
+  }
+};
+
+struct Reader
+{
+  Span<const uint8_t> data;
+  size_t pos = 0;
+
+  template<typename T>
+  T pod()
+  {
+    T value;
+
+    if(sizeof value > (size_t)data.len - pos)
+      throw runtime_error("Truncated data");
+
+    memcpy(&value, data.data + pos, sizeof value);
+    pos += sizeof value;
+    return value;
+  }
+
+  // count, then elements
+  template<typename T>
+  void array(vector<T>& v)
+  {
+    auto const count = pod<uint32_t>();
+
+    if(count > ((size_t)data.len - pos) / sizeof(T))
+      throw runtime_error("Truncated data");
+
+    v.resize(count);
+    memcpy(v.data(), data.data + pos, count * sizeof(T));
+    pos += count * sizeof(T);
+  }
+};
+
+// Of the vertices referenced by the indices [first; first + count[
+void computeBounds(SingleRenderMesh const& single, int first, int count, Vector3f& boundsMin, Vector3f& boundsMax)
+{
+  if(count <= 0)
+    return;
+
+  auto& v0 = single.vertices[single.indices[first]];
+  boundsMin = boundsMax = Vector3f(v0.x, v0.y, v0.z);
+
+  for(int i = first; i < first + count; ++i)
+  {
+    auto& v = single.vertices[single.indices[i]];
+    boundsMin.x = min(boundsMin.x, v.x);
+    boundsMin.y = min(boundsMin.y, v.y);
+    boundsMin.z = min(boundsMin.z, v.z);
+    boundsMax.x = max(boundsMax.x, v.x);
+    boundsMax.y = max(boundsMax.y, v.y);
+    boundsMax.z = max(boundsMax.z, v.z);
+  }
+}
+
+// IEEE 754 binary16, rounded to nearest.
+// Out of range values become infinities, tiny ones denormals or zeros.
+uint16_t toHalf(float f)
+{
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof bits);
+
+  uint32_t const sign = (bits >> 16) & 0x8000;
+  int const exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if(exponent >= 31)
+    return sign | 0x7c00;
+
+  if(exponent <= 0)
+  {
+    if(exponent < -10)
+      return sign;
+
+    mantissa |= 0x800000;
+    auto const shift = 14 - exponent;
+    auto const half = mantissa >> shift;
+    return sign | (half + ((mantissa >> (shift - 1)) & 1));
+  }
+
+  // a carry out of the mantissa correctly bumps the exponent
+  auto const half = sign | (exponent << 10) | (mantissa >> 13);
+  return half + ((mantissa >> 12) & 1);
+}
+
+float fromHalf(uint16_t half)
+{
+  int const exponent = (half >> 10) & 0x1f;
+  int const mantissa = half & 0x3ff;
+
+  float r;
+
+  if(exponent == 0)
+    r = ldexp((float)mantissa, -24);
+  else if(exponent == 31)
+    r = INFINITY;
+  else
+    r = ldexp((float)(mantissa | 0x400), exponent - 25);
+
+  return (half & 0x8000) ? -r : r;
+}
+
+int16_t toSnorm16(float f)
+{
+  return (int16_t)round(clamp(f, -1.0f, 1.0f) * 32767.0f);
+}
+
+float fromSnorm16(int16_t i)
+{
+  return max(i / 32767.0f, -1.0f);
+}
+
+uint16_t toUnorm16(float f)
+{
+  return (uint16_t)round(clamp(f, 0.0f, 1.0f) * 65535.0f);
+}
+
+float fromUnorm16(uint16_t i)
+{
+  return i / 65535.0f;
+}
+
+float signNotZero(float f)
+{
+  return f >= 0 ? 1.0f : -1.0f;
+}
+
+// Octahedral mapping of a unit vector to the [-1;1] square.
+// Must match 'decodeNormal' in the mesh vertex shader.
+void encodeNormal(Vector3f n, float& u, float& v)
+{
+  auto const l1 = abs(n.x) + abs(n.y) + abs(n.z);
+
+  if(l1 <= 0)
+  {
+    u = v = 0;
+    return;
+  }
+
+  u = n.x / l1;
+  v = n.y / l1;
+
+  if(n.z < 0)
+  {
+    auto const fu = (1 - abs(v)) * signNotZero(u);
+    auto const fv = (1 - abs(u)) * signNotZero(v);
+    u = fu;
+    v = fv;
+  }
+}
+
+Vector3f decodeNormal(float u, float v)
+{
+  auto n = Vector3f(u, v, 1 - abs(u) - abs(v));
+
+  if(n.z < 0)
+  {
+    n.x = (1 - abs(v)) * signNotZero(u);
+    n.y = (1 - abs(u)) * signNotZero(v);
+  }
+
+  return normalize(n);
+}
+}
+
+SingleRenderMesh::PackedVertex packVertex(SingleRenderMesh::Vertex const& v)
+{
+  SingleRenderMesh::PackedVertex r;
+  r.x = v.x;
+  r.y = v.y;
+  r.z = v.z;
+
+  float u, w;
+  encodeNormal(Vector3f(v.nx, v.ny, v.nz), u, w);
+  r.normal[0] = toSnorm16(u);
+  r.normal[1] = toSnorm16(w);
+
+  r.diffuse[0] = toHalf(v.diffuse_u);
+  r.diffuse[1] = toHalf(v.diffuse_v);
+  r.lightmap[0] = toUnorm16(v.lightmap_u);
+  r.lightmap[1] = toUnorm16(v.lightmap_v);
+  return r;
+}
+
+SingleRenderMesh::Vertex unpackVertex(SingleRenderMesh::PackedVertex const& v)
+{
+  auto const n = decodeNormal(fromSnorm16(v.normal[0]), fromSnorm16(v.normal[1]));
+
+  SingleRenderMesh::Vertex r;
+  r.x = v.x;
+  r.y = v.y;
+  r.z = v.z;
+  r.nx = n.x;
+  r.ny = n.y;
+  r.nz = n.z;
+  r.diffuse_u = fromHalf(v.diffuse[0]);
+  r.diffuse_v = fromHalf(v.diffuse[1]);
+  r.lightmap_u = fromUnorm16(v.lightmap[0]);
+  r.lightmap_v = fromUnorm16(v.lightmap[1]);
+  return r;
+}
 
 RenderMesh boxModel()
 {
@@ -65,55 +293,374 @@ RenderMesh boxModel()
   RenderMesh model;
   model.singleMeshes.resize(1);
 
+  for(auto& v : vertices)
+    model.singleMeshes[0].vertices.push_back(packVertex(v));
+
   for(auto idx : faces)
-    model.singleMeshes[0].vertices.push_back(vertices[idx]);
+    model.singleMeshes[0].indices.push_back(idx);
 
   return model;
 }
 
-static
-RenderMesh loadBinaryRenderMesh(string path)
+string serializeRenderMesh(RenderMesh const& mesh)
 {
-  auto fp = fopen(path.c_str(), "rb");
+  Writer w;
+  w.data.append(MESH_MAGIC, 4);
+  w.pod(MESH_VERSION);
+  w.pod((uint32_t)sizeof(SingleRenderMesh::PackedVertex));
+  w.pod((uint32_t)mesh.singleMeshes.size());
+  w.pod((uint32_t)mesh.lodErrors.size());
 
-  if(!fp)
-    throw runtime_error("Can't open model file: '" + path + "'");
+  for(auto error : mesh.lodErrors)
+    w.pod(error);
 
-  RenderMesh mesh;
+  for(auto& single : mesh.singleMeshes)
+  {
+    // of all the vertices: the indices aren't checked yet
+    Vector3f boundsMin(0, 0, 0);
+    Vector3f boundsMax(0, 0, 0);
+
+    for(int i = 0; i < (int)single.vertices.size(); ++i)
+    {
+      auto& v = single.vertices[i];
+      boundsMin = i ? Vector3f(min(boundsMin.x, v.x), min(boundsMin.y, v.y), min(boundsMin.z, v.z)) : Vector3f(v.x, v.y, v.z);
+      boundsMax = i ? Vector3f(max(boundsMax.x, v.x), max(boundsMax.y, v.y), max(boundsMax.z, v.z)) : Vector3f(v.x, v.y, v.z);
+    }
+
+    w.pod((uint32_t)single.vertices.size());
+    w.pod((uint32_t)single.indices.size());
+    w.pod(boundsMin);
+    w.pod(boundsMax);
 
-  while(1)
+    // one per level of the mesh: without its own, the full detail
+    for(int i = 0; i < (int)mesh.lodErrors.size(); ++i)
+    {
+      auto const lod = i < (int)single.lods.size() ? single.lods[i] : SingleRenderMesh::Range { -1, 0, (int)single.indices.size() };
+      w.pod((uint32_t)lod.first);
+      w.pod((uint32_t)lod.count);
+    }
+  }
+
+  for(auto& single : mesh.singleMeshes)
   {
-    int vertexCount = 0;
-    int n = fread(&vertexCount, 1, 4, fp);
+    w.data.append((char const*)single.vertices.data(), single.vertices.size() * sizeof(SingleRenderMesh::PackedVertex));
+    w.data.append((char const*)single.indices.data(), single.indices.size() * sizeof(uint32_t));
+  }
 
-    if(n == 0)
-      break;
+  return w.data;
+}
+
+RenderMeshView parseRenderMesh(Span<const uint8_t> data)
+{
+  Reader r { data };
+
+  if(data.len < 4 || memcmp(data.data, MESH_MAGIC, 4))
+    throw runtime_error("Not a render mesh");
+
+  r.pos = 4;
+
+  if(r.pod<uint32_t>() != MESH_VERSION)
+    throw runtime_error("Unsupported render mesh version");
+
+  if(r.pod<uint32_t>() != sizeof(SingleRenderMesh::PackedVertex))
+    throw runtime_error("Unsupported render mesh vertex format");
 
-    SingleRenderMesh single;
+  auto const singleCount = r.pod<uint32_t>();
 
-    for(int i = 0; i < vertexCount; ++i)
+  // each one has a header of 32 bytes, at least
+  if(singleCount > (uint32_t)data.len / 32)
+    throw runtime_error("Invalid render mesh");
+
+  RenderMeshView mesh;
+  mesh.singleMeshes.resize(singleCount);
+  r.array(mesh.lodErrors);
+
+  vector<uint32_t> vertexCounts(singleCount);
+  vector<uint32_t> indexCounts(singleCount);
+
+  for(int i = 0; i < (int)singleCount; ++i)
+  {
+    vertexCounts[i] = r.pod<uint32_t>();
+    indexCounts[i] = r.pod<uint32_t>();
+    mesh.singleMeshes[i].boundsMin = r.pod<Vector3f>();
+    mesh.singleMeshes[i].boundsMax = r.pod<Vector3f>();
+
+    for(int k = 0; k < (int)mesh.lodErrors.size(); ++k)
     {
-      SingleRenderMesh::Vertex vertex;
-      fread(&vertex, 1, sizeof vertex, fp);
+      SingleRenderMesh::Range lod { -1, 0, 0, mesh.singleMeshes[i].boundsMin, mesh.singleMeshes[i].boundsMax };
+      auto const first = r.pod<uint32_t>();
+      auto const count = r.pod<uint32_t>();
+
+      if(first > indexCounts[i] || count > indexCounts[i] - first || first % 3 || count % 3)
+        throw runtime_error("Invalid level of detail in render mesh");
 
-      single.vertices.push_back(vertex);
+      lod.first = first;
+      lod.count = count;
+      mesh.singleMeshes[i].lods.push_back(lod);
     }
+  }
+
+  // all the fields are 4 bytes: the arrays stay aligned
+  for(int i = 0; i < (int)singleCount; ++i)
+  {
+    auto& single = mesh.singleMeshes[i];
+
+    if(indexCounts[i] == 0 || indexCounts[i] % 3)
+      throw runtime_error("Invalid render mesh");
+
+    auto const remaining = (size_t)data.len - r.pos;
+
+    if(vertexCounts[i] > remaining / sizeof(SingleRenderMesh::PackedVertex))
+      throw runtime_error("Truncated data");
+
+    single.vertices = { (SingleRenderMesh::PackedVertex const*)(data.data + r.pos), (int)vertexCounts[i] };
+    r.pos += vertexCounts[i] * sizeof(SingleRenderMesh::PackedVertex);
+
+    if(indexCounts[i] > ((size_t)data.len - r.pos) / sizeof(uint32_t))
+      throw runtime_error("Truncated data");
+
+    single.indices = { (uint32_t const*)(data.data + r.pos), (int)indexCounts[i] };
+    r.pos += indexCounts[i] * sizeof(uint32_t);
+
+    for(auto idx : single.indices)
+      if(idx >= vertexCounts[i])
+        throw runtime_error("Invalid index in render mesh");
+  }
+
+  if(r.pos != (size_t)data.len)
+    throw runtime_error("Trailing data in render mesh");
+
+  return mesh;
+}
+
+RenderMesh deserializeRenderMesh(Span<const uint8_t> data)
+{
+  auto const view = parseRenderMesh(data);
 
-    assert(!single.vertices.empty());
+  RenderMesh mesh;
+  mesh.singleMeshes.resize(view.singleMeshes.size());
 
-    mesh.singleMeshes.push_back(single);
+  for(int i = 0; i < (int)view.singleMeshes.size(); ++i)
+  {
+    auto& src = view.singleMeshes[i];
+    auto& single = mesh.singleMeshes[i];
+    single.vertices.assign(src.vertices.begin(), src.vertices.end());
+    single.indices.assign(src.indices.begin(), src.indices.end());
+    single.boundsMin = src.boundsMin;
+    single.boundsMax = src.boundsMax;
+    single.lods = src.lods;
   }
 
-  fclose(fp);
+  mesh.lodErrors = view.lodErrors;
 
   return mesh;
 }
 
+RenderMesh deserializeRenderMesh(string const& data)
+{
+  return deserializeRenderMesh({ (uint8_t const*)data.data(), (int)data.size() });
+}
+
+
+int RenderMesh::Visibility::getCell(Vector3f pos) const
+{
+  if(cellSize <= 0)
+    return -1;
+
+  auto const rel = (pos - origin) * (1.0f / cellSize);
+  int const coords[] = { (int)floor(rel.x), (int)floor(rel.y), (int)floor(rel.z) };
+
+  for(int i = 0; i < 3; ++i)
+    if(coords[i] < 0 || coords[i] >= dims[i])
+      return -1;
+
+  return (coords[2] * dims[1] + coords[1]) * dims[0] + coords[0];
+}
+
+int RenderMesh::selectLod(float pixelsPerUnit, int previous) const
+{
+  int r = 0;
+
+  for(int i = 1; i < (int)lodErrors.size(); ++i)
+  {
+    // a margin to go coarser than 'previous', another to leave it
+    auto limit = MAX_LOD_ERROR_PIXELS;
+
+    if(i > previous)
+      limit /= LOD_HYSTERESIS;
+    else if(i == previous)
+      limit *= LOD_HYSTERESIS;
+
+    if(lodErrors[i] * pixelsPerUnit <= limit)
+      r = i;
+  }
+
+  return r;
+}
+
+string serializeVisibility(RenderMesh const& mesh)
+{
+  auto& vis = mesh.visibility;
+
+  Writer w;
+  w.data.append(PVS_MAGIC, 4);
+  w.pod(PVS_VERSION);
+
+  w.pod(vis.origin.x);
+  w.pod(vis.origin.y);
+  w.pod(vis.origin.z);
+  w.pod(vis.cellSize);
+
+  for(auto dim : vis.dims)
+    w.pod((int32_t)dim);
+
+  w.pod((uint32_t)mesh.singleMeshes.size());
+
+  for(auto& single : mesh.singleMeshes)
+  {
+    w.pod((uint32_t)single.ranges.size());
+
+    for(auto& range : single.ranges)
+    {
+      w.pod((int32_t)range.cell);
+      w.pod((int32_t)range.first);
+      w.pod((int32_t)range.count);
+    }
+  }
+
+  for(auto& cells : vis.visibleCells)
+  {
+    w.pod((uint32_t)cells.size());
+
+    for(auto cell : cells)
+      w.pod((int32_t)cell);
+  }
+
+  return w.data;
+}
+
+void deserializeVisibility(Span<const uint8_t> data, RenderMesh& mesh)
+{
+  Reader r { data };
+
+  if(data.len < 4 || memcmp(data.data, PVS_MAGIC, 4))
+    throw runtime_error("Not a visibility file");
+
+  r.pos = 4;
+
+  if(r.pod<uint32_t>() != PVS_VERSION)
+    throw runtime_error("Unsupported visibility version");
+
+  RenderMesh::Visibility vis;
+  vis.origin.x = r.pod<float>();
+  vis.origin.y = r.pod<float>();
+  vis.origin.z = r.pod<float>();
+  vis.cellSize = r.pod<float>();
+
+  int64_t cellCount = 1;
+
+  for(auto& dim : vis.dims)
+  {
+    dim = r.pod<int32_t>();
+
+    if(dim <= 0)
+      throw runtime_error("Invalid visibility grid");
+
+    cellCount *= dim;
+  }
+
+  if(!(vis.cellSize > 0) || cellCount > (int64_t)data.len)
+    throw runtime_error("Invalid visibility grid");
+
+  if(r.pod<uint32_t>() != mesh.singleMeshes.size())
+    throw runtime_error("Visibility data doesn't match the mesh");
+
+  vector<vector<SingleRenderMesh::Range>> ranges(mesh.singleMeshes.size());
+
+  for(int i = 0; i < (int)ranges.size(); ++i)
+  {
+    ranges[i].resize(r.pod<uint32_t>());
+
+    for(auto& range : ranges[i])
+    {
+      range.cell = r.pod<int32_t>();
+      range.first = r.pod<int32_t>();
+      range.count = r.pod<int32_t>();
+
+      if(range.cell < 0 || range.cell >= cellCount)
+        throw runtime_error("Invalid visibility cell");
+
+      if(range.first < 0 || range.count < 0 || range.first + range.count > (int)mesh.singleMeshes[i].indices.size())
+        throw runtime_error("Visibility data doesn't match the mesh");
+
+      if(range.first % 3 || range.count % 3)
+        throw runtime_error("Visibility data doesn't match the mesh");
+    }
+  }
+
+  vis.visibleCells.resize(cellCount);
+
+  for(auto& cells : vis.visibleCells)
+  {
+    cells.resize(r.pod<uint32_t>());
+
+    for(auto& cell : cells)
+    {
+      cell = r.pod<int32_t>();
+
+      if(cell < 0 || cell >= cellCount)
+        throw runtime_error("Invalid visibility cell");
+    }
+  }
+
+  if(r.pos != (size_t)data.len)
+    throw runtime_error("Trailing data in visibility file");
+
+  for(int i = 0; i < (int)ranges.size(); ++i)
+    mesh.singleMeshes[i].ranges = move(ranges[i]);
+
+  mesh.visibility = move(vis);
+}
+
+void deserializeVisibility(string const& data, RenderMesh& mesh)
+{
+  deserializeVisibility({ (uint8_t const*)data.data(), (int)data.size() }, mesh);
+}
+
 RenderMesh loadRenderMesh(string renderPath)
 {
   if(!File::exists(renderPath))
-    return boxModel();
+  {
+    auto box = boxModel();
+
+    for(auto& single : box.singleMeshes)
+      computeBounds(single, 0, single.indices.size(), single.boundsMin, single.boundsMax);
 
-  return loadBinaryRenderMesh(renderPath);
+    return box;
+  }
+
+  // the bounds of the single meshes are part of the file
+  auto mesh = deserializeRenderMesh(File::map(renderPath)->data);
+
+  // optional: without it, everything is drawn
+  auto const pvsPath = setExtension(renderPath, "pvs");
+
+  if(File::exists(pvsPath))
+  {
+    try
+    {
+      deserializeVisibility(File::map(pvsPath)->data, mesh);
+    }
+    catch(exception const& e)
+    {
+      fprintf(stderr, "WARNING: ignoring visibility '%s': %s\n", pvsPath.c_str(), e.what());
+    }
+  }
+
+  for(auto& single : mesh.singleMeshes)
+    for(auto& range : single.ranges)
+      computeBounds(single, range.first, range.count, range.boundsMin, range.boundsMax);
+
+  return mesh;
 }
 
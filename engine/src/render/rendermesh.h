@@ -12,16 +12,20 @@
 using namespace std;
 
 #include "base/geom.h"
+#include "base/span.h"
 
 struct SingleRenderMesh
 {
   uint32_t buffer = 0;
+  uint32_t indexBuffer = 0;
+  uint32_t vertexArray = 0;
 
   // textures
   int diffuse  {};
   int lightmap {};
+  bool translucent = false; // the diffuse has alpha: drawn blended, after the opaque meshes
 
-  // mesh data
+  // mesh data, as built by the meshcooker
   struct Vertex
   {
     float x, y, z; // position
@@ -30,13 +34,112 @@ struct SingleRenderMesh
     float lightmap_u, lightmap_v;
   };
 
-  vector<Vertex> vertices;
+  // mesh data, as stored and sent to the GPU (see 'packVertex')
+  struct PackedVertex
+  {
+    float x, y, z; // position
+    int16_t normal[2]; // octahedral encoding, normalized
+    uint16_t diffuse[2]; // half floats: diffuse UVs can wrap around
+    uint16_t lightmap[2]; // normalized, in [0;1]
+  };
+
+  static_assert(sizeof(PackedVertex) == 24, "PackedVertex must stay tightly packed");
+
+  vector<PackedVertex> vertices;
+  vector<uint32_t> indices; // triangle list
+
+  // bounds of the vertices, in model space
+  Vector3f boundsMin = Vector3f(0, 0, 0);
+  Vector3f boundsMax = Vector3f(0, 0, 0);
+
+  // The triangles of each visibility cell (see 'RenderMesh::Visibility'),
+  // as spans of 'indices'. Empty if the mesh has no visibility data.
+  struct Range
+  {
+    int cell; // in the visibility grid, -1 for a level of detail
+    int first;
+    int count;
+
+    Vector3f boundsMin = Vector3f(0, 0, 0);
+    Vector3f boundsMax = Vector3f(0, 0, 0);
+  };
+
+  vector<Range> ranges;
+
+  // The levels of detail (see 'RenderMesh::lodErrors'), as spans of
+  // 'indices': the full detail first, then coarser and coarser ones,
+  // using the same vertices. Empty: 'indices' is the full detail only.
+  vector<Range> lods;
 };
 
 struct RenderMesh
 {
   vector<SingleRenderMesh> singleMeshes;
+
+  // Potentially visible set, precomputed by the meshcooker.
+  // The model space is cut into a grid of cubic cells: for each cell,
+  // 'visibleCells' lists the cells whose geometry might be seen from it.
+  struct Visibility
+  {
+    Vector3f origin = Vector3f(0, 0, 0);
+    float cellSize = 0; // zero: no visibility data
+    int dims[3] {};
+    vector<vector<int>> visibleCells;
+
+    // -1 if 'pos' is out of the grid
+    int getCell(Vector3f pos) const;
+  };
+
+  Visibility visibility;
+
+  // Geometric error of each level of detail, in model units: the farthest
+  // a vertex moved. Zero for the first one, the full detail.
+  // Empty if the mesh has no levels.
+  vector<float> lodErrors;
+
+  // The coarsest level whose error covers at most a pixel, seen with
+  // 'pixelsPerUnit' (in model units, at the distance of the mesh).
+  // 'previous', the level of the last frame, is kept unless the error
+  // changed by a margin: a mesh at the limit doesn't switch each frame.
+  int selectLod(float pixelsPerUnit, int previous) const;
 };
 
+SingleRenderMesh::PackedVertex packVertex(SingleRenderMesh::Vertex const& v);
+SingleRenderMesh::Vertex unpackVertex(SingleRenderMesh::PackedVertex const& v);
+
+// Bounds included: the ones of the single meshes, and of their ranges.
 RenderMesh loadRenderMesh(string path);
 
+// The ".render" file: a header with the vertex format, the errors of the
+// levels of detail, the counts, the bounds and the levels of the single
+// meshes, then their vertices and indices, as sent to the GPU.
+string serializeRenderMesh(RenderMesh const& mesh);
+
+// The ".render" file, without copying: the arrays point into the file data.
+struct RenderMeshView
+{
+  struct Single
+  {
+    Span<const SingleRenderMesh::PackedVertex> vertices;
+    Span<const uint32_t> indices;
+    Vector3f boundsMin = Vector3f(0, 0, 0);
+    Vector3f boundsMax = Vector3f(0, 0, 0);
+    vector<SingleRenderMesh::Range> lods;
+  };
+
+  vector<Single> singleMeshes;
+  vector<float> lodErrors;
+};
+
+// 'data' must be 4-byte aligned (e.g from 'File::map').
+RenderMeshView parseRenderMesh(Span<const uint8_t> data);
+
+RenderMesh deserializeRenderMesh(Span<const uint8_t> data);
+RenderMesh deserializeRenderMesh(string const& data);
+
+// The ".pvs" file, next to the ".render" one: the ranges of the single
+// meshes, and the visibility.
+string serializeVisibility(RenderMesh const& mesh);
+void deserializeVisibility(Span<const uint8_t> data, RenderMesh& mesh);
+void deserializeVisibility(string const& data, RenderMesh& mesh);
+
@@ -0,0 +1,77 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Picks the scale of the offscreen render target from the measured GPU
+// frame time: the resolution drops when the GPU can't keep up, and comes
+// back when there's room again.
+
+#pragma once
+
+#include <cmath> // sqrt
+
+#include "base/util.h" // clamp
+
+struct ResolutionScaler
+{
+  // ms of GPU time per frame. Zero disables the scaling: 'scale' stays at 'maxScale'.
+  float targetMs = 0;
+
+  // of each dimension of the render target
+  float minScale = 0.5;
+  float maxScale = 1;
+
+  float scale = 1;
+
+  // 'gpuMs': GPU time of a recent frame, negative if unknown.
+  void update(float gpuMs)
+  {
+    if(targetMs <= 0)
+    {
+      scale = maxScale;
+      return;
+    }
+
+    scale = clamp(scale, minScale, maxScale);
+
+    if(gpuMs < 0)
+      return;
+
+    // the timings arrive a few frames late: the first ones after a change
+    // were rendered at the previous scale
+    if(++m_frames <= SETTLE_FRAMES)
+    {
+      m_averageMs = gpuMs;
+      return;
+    }
+
+    m_averageMs += (gpuMs - m_averageMs) * 0.2f;
+
+    if(m_frames < SETTLE_FRAMES + AVERAGE_FRAMES)
+      return;
+
+    // hysteresis: don't chase the noise around the target
+    if(m_averageMs <= targetMs && m_averageMs >= targetMs * 0.8f)
+      return;
+
+    // the cost goes with the pixel count, i.e the square of the scale.
+    // Coming down is faster than going back up.
+    float const ideal = m_averageMs > 0 ? scale * sqrt(targetMs * 0.9f / m_averageMs) : maxScale;
+    auto const next = clamp(clamp(ideal, scale - 0.2f, scale + 0.05f), minScale, maxScale);
+
+    if(next == scale)
+      return;
+
+    scale = next;
+    m_frames = 0;
+  }
+
+private:
+  static auto constexpr SETTLE_FRAMES = 6;
+  static auto constexpr AVERAGE_FRAMES = 10;
+
+  int m_frames = 0;
+  float m_averageMs = 0;
+};
@@ -10,50 +10,41 @@ out vec4 color;
 
 // Values that stay constant for the whole mesh
 uniform sampler2D InputTex;
-uniform bool IsThreshold;
+uniform int Pass; // 0: copy, 1: threshold, 2: blur
+uniform vec2 Step; // blur: one texel along the blur direction
 
-const float offset = 1.0 / 600.0;
+// 9-tap gaussian, in 5 fetches: a bilinear fetch between two texels
+// gets both, with the right weights.
+const float offsets[3] = float[](0.0, 1.3846153846, 3.2307692308);
+const float weights[3] = float[](0.2270270270, 0.3162162162, 0.0702702703);
 
 void main()
 {
-    if(IsThreshold)
-    {
-      color = texture(InputTex, UV.xy);
-      if(length(color.rgb) < 3.5)
-        color = vec4(0, 0, 0, 1);
-      return;
-    }
+  if(Pass == 1)
+  {
+    color = texture(InputTex, UV);
+
+    if(length(color.rgb) < 3.5)
+      color = vec4(0, 0, 0, 1);
+
+    return;
+  }
 
-    vec2 offsets[9] = vec2[](
-        vec2(-offset,  offset), // top-left
-        vec2( 0.0f,    offset), // top-center
-        vec2( offset,  offset), // top-right
-        vec2(-offset,  0.0f),   // center-left
-        vec2( 0.0f,    0.0f),   // center-center
-        vec2( offset,  0.0f),   // center-right
-        vec2(-offset, -offset), // bottom-left
-        vec2( 0.0f,   -offset), // bottom-center
-        vec2( offset, -offset)  // bottom-right
-    );
-
-    float kernel[9] = float[](
-        1.0, 2.0, 1.0,
-        2.0, 4.0, 2.0,
-        1.0, 2.0, 1.0
-    );
-
-    vec3 sampleTex[9];
-    for(int i = 0; i < 9; i++)
+  if(Pass == 2)
+  {
+    vec3 col = texture(InputTex, UV).rgb * weights[0];
+
+    for(int i = 1; i < 3; i++)
     {
-        sampleTex[i] = vec3(texture(InputTex, UV.xy + offsets[i]));
+      col += texture(InputTex, UV + Step * offsets[i]).rgb * weights[i];
+      col += texture(InputTex, UV - Step * offsets[i]).rgb * weights[i];
     }
-    vec3 col = vec3(0.0);
-    for(int i = 0; i < 9; i++)
-        col += sampleTex[i] * kernel[i];
-
-    col /= 16.0;
 
     color = vec4(col, 1.0);
+    return;
+  }
+
+  color = vec4(texture(InputTex, UV).rgb, 1.0);
 }
 
 // vim: syntax=glsl
@@ -10,10 +10,11 @@ out vec2 UV;
 // Values that stay constant for the whole mesh.
 uniform mat4 M;
 uniform mat4 MVP;
+uniform vec2 UvScale; // the part of the input to read
 
 void main()
 {
   gl_Position = vec4(vertexPos_model, 1, 1);
-  UV = vertexUV;
+  UV = vertexUV * UvScale;
 }
 // vim: syntax=glsl
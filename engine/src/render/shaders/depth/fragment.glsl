@@ -0,0 +1,11 @@
+#version 300 es
+
+precision mediump float;
+
+// Depth prepass: only the depth buffer is written.
+
+void main()
+{
+}
+
+// vim: syntax=glsl
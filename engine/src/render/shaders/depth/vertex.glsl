@@ -0,0 +1,27 @@
+#version 300 es
+
+// Depth prepass: same positions as the mesh vertex shader, nothing else.
+
+// Input vertex data, at the locations of the mesh vertex shader
+layout(location = 0) in vec4 vertexPos_model;
+
+// Per-instance data
+layout(location = 4) in mat4 instanceM;
+
+// Values that stay constant for the whole view (same block as the mesh shaders)
+layout(std140) uniform ViewConstants
+{
+  highp mat4 VP;
+  highp vec4 CameraPos;
+  highp vec4 LightPos;
+  highp vec4 ambientLight;
+};
+
+invariant gl_Position;
+
+void main()
+{
+  vec4 worldPos = instanceM * vertexPos_model;
+  gl_Position = VP * worldPos;
+}
+// vim: syntax=glsl
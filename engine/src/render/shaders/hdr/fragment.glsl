@@ -13,6 +13,10 @@ uniform sampler2D InputTex1;
 uniform sampler2D InputTex2;
 uniform float Time;
 
+// the part of InputTex1 the scene was drawn to
+uniform vec2 SceneUvScale;
+uniform vec2 SceneUvMax;
+
 void main()
 {
   const float gamma = 1.2;
@@ -23,7 +27,7 @@ void main()
   uv.x = UV.x + sin(UV.x * 20.0 + Time * 2.0) * 0.005;
   uv.y = UV.y + sin(UV.y * 20.0 + Time * 2.0) * 0.005;
 
-  vec3 hdrColor = texture(InputTex1, uv).rgb + texture(InputTex2, uv).rgb;
+  vec3 hdrColor = texture(InputTex1, min(uv * SceneUvScale, SceneUvMax)).rgb + texture(InputTex2, uv).rgb;
 
   // underwater blueish
   hdrColor.r *= 0.5;
@@ -7,37 +7,43 @@ in vec2 UV;
 in vec2 UV_lightmap;
 in vec3 vPos;
 in vec3 vNormal;
+in vec4 fragOffset;
 
 // Ouput data
 out vec4 color;
 
+// Values that stay constant for the whole view (same block in the vertex shader)
+layout(std140) uniform ViewConstants
+{
+  highp mat4 VP;
+  highp vec4 CameraPos;
+  highp vec4 LightPos;
+  highp vec4 ambientLight;
+};
+
 // Values that stay constant for the whole mesh
-uniform vec3 CameraPos;
-uniform vec4 fragOffset;
 uniform sampler2D DiffuseTex;
 uniform sampler2D LightmapTex;
-uniform vec3 ambientLight;
-uniform vec3 LightPos;
 
 void main()
 {
   vec3 lightColor = vec3(1,1,1);
-  vec3 lightDir = normalize(LightPos - vPos);
-  float lightDist = length(LightPos - vPos);
+  vec3 lightDir = normalize(LightPos.xyz - vPos);
+  float lightDist = length(LightPos.xyz - vPos);
   float attenuation = 10.0/(lightDist*lightDist*lightDist);
 
-  // ambient
-  vec3 ambient = texture(DiffuseTex, UV).rgb * ambientLight;
+  // ambient, shadowed by the baked occlusion
+  vec3 staticLight = texture(LightmapTex, UV_lightmap).rgb;
+  vec3 ambient = texture(DiffuseTex, UV).rgb * ambientLight.rgb * staticLight;
 
   // diffuse
   float diff = max(0.0, dot(lightDir, vNormal))*attenuation;
-  diff += length(texture(LightmapTex, UV_lightmap)) * 0.01;
   vec3 diffuse = lightColor * (diff * (texture(DiffuseTex, UV).rgb + fragOffset.rgb));
 
   // specular
   const float material_shininess = 128.0;
   const float material_specular = 0.4;
-  vec3 viewDir = normalize(CameraPos - vPos);
+  vec3 viewDir = normalize(CameraPos.xyz - vPos);
   vec3 halfwayDir = normalize((viewDir + lightDir) * 0.5);
   float angle = max(dot(vNormal, halfwayDir), 0.0);
   float spec = pow(angle, material_shininess);
@@ -1,28 +1,56 @@
 #version 300 es
 
-// Input vertex data, different for all executions of this shader
-in vec4 vertexPos_model;
-in vec2 vertexUV;
-in vec2 vertexUV_lightmap;
-in vec3 a_normal;
+// Input vertex data, different for all executions of this shader.
+// The locations are shared with the depth prepass, which uses the same
+// vertex arrays.
+layout(location = 0) in vec4 vertexPos_model;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec2 vertexUV_lightmap;
+layout(location = 3) in vec2 a_normal; // octahedral encoding
+
+// Per-instance data
+layout(location = 4) in mat4 instanceM; // 4 to 7
+layout(location = 8) in vec4 instanceFragOffset;
 
 // Output data; will be interpolated for each fragment
 out vec2 UV;
 out vec2 UV_lightmap;
 out vec3 vPos;
 out vec3 vNormal;
+out vec4 fragOffset;
+
+// Values that stay constant for the whole view (same block in the fragment shader)
+layout(std140) uniform ViewConstants
+{
+  highp mat4 VP;
+  highp vec4 CameraPos;
+  highp vec4 LightPos;
+  highp vec4 ambientLight;
+};
+
+// the depth prepass must produce exactly the same depths
+invariant gl_Position;
 
-// Values that stay constant for the whole mesh.
-uniform mat4 M;
-uniform mat4 MVP;
+// Must match 'encodeNormal' in rendermesh.cpp
+vec3 decodeNormal(vec2 e)
+{
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+
+  if(n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+
+  return normalize(n);
+}
 
 void main()
 {
-  gl_Position = MVP * vertexPos_model;
+  vec4 worldPos = instanceM * vertexPos_model;
+  gl_Position = VP * worldPos;
   UV = vertexUV;
   UV_lightmap = vertexUV_lightmap;
 
-  vPos = (M * vertexPos_model).xyz;
-  vNormal = normalize((M * vec4(a_normal, 0)).xyz);
+  vPos = worldPos.xyz;
+  vNormal = normalize((instanceM * vec4(decodeNormal(a_normal), 0)).xyz);
+  fragOffset = instanceFragOffset;
 }
 // vim: syntax=glsl
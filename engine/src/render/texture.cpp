@@ -0,0 +1,1041 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Block compression encoders (BC1/BC3, ETC2/EAC) and the texture container.
+// The encoders favor speed over quality: they run on every cook.
+
+#include "texture.h"
+#include <algorithm> // max, min, swap
+#include <cmath> // abs, pow
+#include <stdexcept>
+#include <string.h> // memcpy, memcmp
+
+namespace
+{
+auto const TEXTURE_MAGIC = "TEX ";
+uint32_t const TEXTURE_VERSION = 1;
+
+// native byte order: only read by the game built along with the meshcooker
+struct Writer
+{
+  string data;
+
+  template<typename T>
+  void pod(T const& value)
+  {
+    data.append((char const*)&value, sizeof value);
+  }
+};
+
+struct Reader
+{
+  Span<const uint8_t> data;
+  size_t pos = 0;
+
+  template<typename T>
+  T pod()
+  {
+    T value;
+
+    if(sizeof value > (size_t)data.len - pos)
+      throw runtime_error("Truncated data");
+
+    memcpy(&value, data.data + pos, sizeof value);
+    pos += sizeof value;
+    return value;
+  }
+
+  // count, then elements
+  template<typename T>
+  void array(vector<T>& v)
+  {
+    auto const count = pod<uint32_t>();
+
+    if(count > ((size_t)data.len - pos) / sizeof(T))
+      throw runtime_error("Truncated data");
+
+    v.resize(count);
+    memcpy(v.data(), data.data + pos, count * sizeof(T));
+    pos += count * sizeof(T);
+  }
+};
+
+int clamp255(int val)
+{
+  return max(0, min(255, val));
+}
+
+int square(int val)
+{
+  return val * val;
+}
+
+// 4x4 RGBA pixels, row major
+struct Block
+{
+  uint8_t pels[16][4];
+};
+
+struct Rgb
+{
+  int r, g, b;
+};
+
+int distance(Rgb a, uint8_t const* pel)
+{
+  return square(a.r - pel[0]) + square(a.g - pel[1]) + square(a.b - pel[2]);
+}
+
+// Partial blocks repeat the last row and column.
+Block fetchBlock(PictureView pic, int bx, int by)
+{
+  Block r;
+
+  for(int y = 0; y < 4; ++y)
+  {
+    for(int x = 0; x < 4; ++x)
+    {
+      auto const px = min(bx * 4 + x, pic.dim.width - 1);
+      auto const py = min(by * 4 + y, pic.dim.height - 1);
+      memcpy(r.pels[y * 4 + x], pic.pixels + (px + py * pic.stride) * 4, 4);
+    }
+  }
+
+  return r;
+}
+
+void storeBlock(Picture& pic, int bx, int by, Block const& block)
+{
+  for(int y = 0; y < 4; ++y)
+  {
+    for(int x = 0; x < 4; ++x)
+    {
+      auto const px = bx * 4 + x;
+      auto const py = by * 4 + y;
+
+      if(px < pic.dim.width && py < pic.dim.height)
+        memcpy(&pic.pixels[(px + py * pic.stride) * 4], block.pels[y * 4 + x], 4);
+    }
+  }
+}
+
+float srgbToLinear(uint8_t val)
+{
+  static auto const table = [] ()
+    {
+      vector<float> r(256);
+
+      for(int i = 0; i < 256; ++i)
+      {
+        auto const c = i / 255.0f;
+        r[i] = c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+      }
+
+      return r;
+    } ();
+
+  return table[val];
+}
+
+uint8_t linearToSrgb(float val)
+{
+  auto const c = val <= 0.0031308f ? val * 12.92f : 1.055f * pow(val, 1.0f / 2.4f) - 0.055f;
+  return clamp255(int(c * 255.0f + 0.5f));
+}
+
+// Box filtered: the next level is half the size, rounded down.
+// sRGB colors are averaged as light intensities, not as encoded values:
+// otherwise, contrasted details get darker at a distance.
+Picture downsample(PictureView src, bool srgb)
+{
+  Picture dst;
+  dst.dim.width = max(1, src.dim.width / 2);
+  dst.dim.height = max(1, src.dim.height / 2);
+  dst.stride = dst.dim.width;
+  dst.pixels.resize(dst.dim.width * dst.dim.height * 4);
+
+  for(int y = 0; y < dst.dim.height; ++y)
+  {
+    for(int x = 0; x < dst.dim.width; ++x)
+    {
+      auto const x0 = x * 2;
+      auto const y0 = y * 2;
+      auto const x1 = min(x0 + 1, src.dim.width - 1);
+      auto const y1 = min(y0 + 1, src.dim.height - 1);
+
+      for(int k = 0; k < 4; ++k)
+      {
+        auto pel = [&] (int px, int py) { return src.pixels[(px + py * src.stride) * 4 + k]; };
+        auto& out = dst.pixels[(x + y * dst.stride) * 4 + k];
+
+        // alpha is always linear
+        if(srgb && k < 3)
+          out = linearToSrgb((srgbToLinear(pel(x0, y0)) + srgbToLinear(pel(x1, y0)) + srgbToLinear(pel(x0, y1)) + srgbToLinear(pel(x1, y1))) * 0.25f);
+        else
+          out = (pel(x0, y0) + pel(x1, y0) + pel(x0, y1) + pel(x1, y1) + 2) / 4;
+      }
+    }
+  }
+
+  return dst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BC1/BC3
+
+uint16_t to565(float r, float g, float b)
+{
+  auto const r5 = clamp255(int(r + 0.5f)) * 31 / 255;
+  auto const g6 = clamp255(int(g + 0.5f)) * 63 / 255;
+  auto const b5 = clamp255(int(b + 0.5f)) * 31 / 255;
+  return (r5 << 11) | (g6 << 5) | b5;
+}
+
+Rgb from565(uint16_t c)
+{
+  auto const r5 = (c >> 11) & 31;
+  auto const g6 = (c >> 5) & 63;
+  auto const b5 = c & 31;
+  return { (r5 << 3) | (r5 >> 2), (g6 << 2) | (g6 >> 4), (b5 << 3) | (b5 >> 2) };
+}
+
+Rgb mix(Rgb a, Rgb b, int wa, int wb)
+{
+  auto const w = wa + wb;
+  return { (a.r * wa + b.r * wb) / w, (a.g * wa + b.g * wb) / w, (a.b * wa + b.b * wb) / w };
+}
+
+// The endpoints are the extremes of the block along its principal axis.
+// Always uses the four color mode: color0 > color1.
+void encodeBc1Colors(Block const& block, uint8_t* out)
+{
+  float mean[3] {};
+
+  for(auto& pel : block.pels)
+    for(int k = 0; k < 3; ++k)
+      mean[k] += pel[k] / 16.0f;
+
+  float cov[6] {};
+
+  for(auto& pel : block.pels)
+  {
+    auto const r = pel[0] - mean[0];
+    auto const g = pel[1] - mean[1];
+    auto const b = pel[2] - mean[2];
+    cov[0] += r * r;
+    cov[1] += r * g;
+    cov[2] += r * b;
+    cov[3] += g * g;
+    cov[4] += g * b;
+    cov[5] += b * b;
+  }
+
+  // power iteration
+  float axis[3] = { 1, 1, 1 };
+
+  for(int i = 0; i < 4; ++i)
+  {
+    float const next[3] =
+    {
+      cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+      cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+      cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+    };
+
+    auto const norm = max(abs(next[0]), max(abs(next[1]), abs(next[2])));
+
+    if(norm < 1e-6f)
+      break;
+
+    for(int k = 0; k < 3; ++k)
+      axis[k] = next[k] / norm;
+  }
+
+  int lo = 0, hi = 0;
+  float loDot = 1e30f, hiDot = -1e30f;
+
+  for(int i = 0; i < 16; ++i)
+  {
+    auto const pel = block.pels[i];
+    auto const dot = pel[0] * axis[0] + pel[1] * axis[1] + pel[2] * axis[2];
+
+    if(dot < loDot)
+    {
+      loDot = dot;
+      lo = i;
+    }
+
+    if(dot > hiDot)
+    {
+      hiDot = dot;
+      hi = i;
+    }
+  }
+
+  auto c0 = to565(block.pels[hi][0], block.pels[hi][1], block.pels[hi][2]);
+  auto c1 = to565(block.pels[lo][0], block.pels[lo][1], block.pels[lo][2]);
+
+  if(c0 < c1)
+    swap(c0, c1);
+
+  uint32_t indices = 0;
+
+  if(c0 != c1)
+  {
+    auto const e0 = from565(c0);
+    auto const e1 = from565(c1);
+    Rgb const palette[4] = { e0, e1, mix(e0, e1, 2, 1), mix(e0, e1, 1, 2) };
+
+    for(int i = 0; i < 16; ++i)
+    {
+      int best = 0;
+
+      for(int k = 1; k < 4; ++k)
+        if(distance(palette[k], block.pels[i]) < distance(palette[best], block.pels[i]))
+          best = k;
+
+      indices |= best << (i * 2);
+    }
+  }
+
+  out[0] = c0 & 0xff;
+  out[1] = c0 >> 8;
+  out[2] = c1 & 0xff;
+  out[3] = c1 >> 8;
+
+  for(int i = 0; i < 4; ++i)
+    out[4 + i] = indices >> (i * 8);
+}
+
+void decodeBc1Colors(uint8_t const* in, Block& block, bool alwaysFourColors)
+{
+  auto const c0 = uint16_t(in[0] | (in[1] << 8));
+  auto const c1 = uint16_t(in[2] | (in[3] << 8));
+  auto const e0 = from565(c0);
+  auto const e1 = from565(c1);
+
+  auto const fourColors = alwaysFourColors || c0 > c1;
+
+  Rgb const palette[4] =
+  {
+    e0,
+    e1,
+    fourColors ? mix(e0, e1, 2, 1) : mix(e0, e1, 1, 1),
+    fourColors ? mix(e0, e1, 1, 2) : Rgb { 0, 0, 0 },
+  };
+
+  auto const indices = uint32_t(in[4] | (in[5] << 8) | (in[6] << 16) | (uint32_t(in[7]) << 24));
+
+  for(int i = 0; i < 16; ++i)
+  {
+    auto const k = (indices >> (i * 2)) & 3;
+    block.pels[i][0] = palette[k].r;
+    block.pels[i][1] = palette[k].g;
+    block.pels[i][2] = palette[k].b;
+    block.pels[i][3] = (!fourColors && k == 3) ? 0 : 255;
+  }
+}
+
+// Always uses the eight alpha values mode: alpha0 > alpha1.
+void encodeBc3Alpha(Block const& block, uint8_t* out)
+{
+  int a0 = 0, a1 = 255;
+
+  for(auto& pel : block.pels)
+  {
+    a0 = max(a0, (int)pel[3]);
+    a1 = min(a1, (int)pel[3]);
+  }
+
+  uint64_t indices = 0;
+
+  if(a0 != a1)
+  {
+    int palette[8] = { a0, a1 };
+
+    for(int k = 1; k < 7; ++k)
+      palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+
+    for(int i = 0; i < 16; ++i)
+    {
+      uint64_t best = 0;
+
+      for(int k = 1; k < 8; ++k)
+        if(abs(palette[k] - block.pels[i][3]) < abs(palette[best] - block.pels[i][3]))
+          best = k;
+
+      indices |= best << (i * 3);
+    }
+  }
+
+  out[0] = a0;
+  out[1] = a1;
+
+  for(int i = 0; i < 6; ++i)
+    out[2 + i] = indices >> (i * 8);
+}
+
+void decodeBc3Alpha(uint8_t const* in, Block& block)
+{
+  int const a0 = in[0];
+  int const a1 = in[1];
+  int palette[8] = { a0, a1 };
+
+  if(a0 > a1)
+  {
+    for(int k = 1; k < 7; ++k)
+      palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+  }
+  else
+  {
+    for(int k = 1; k < 5; ++k)
+      palette[k + 1] = ((5 - k) * a0 + k * a1) / 5;
+
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t indices = 0;
+
+  for(int i = 0; i < 6; ++i)
+    indices |= uint64_t(in[2 + i]) << (i * 8);
+
+  for(int i = 0; i < 16; ++i)
+    block.pels[i][3] = palette[(indices >> (i * 3)) & 7];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ETC2/EAC
+// Colors only use the ETC1 compatible modes (individual and differential),
+// which are valid ETC2.
+
+int const ETC_MODIFIERS[8][2] =
+{
+  { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+  { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+int etcModifier(int table, int index)
+{
+  auto const mod = ETC_MODIFIERS[table][index & 1];
+  return index & 2 ? -mod : mod;
+}
+
+// row major index in the block, of the i-th pixel of an ETC block
+// (which are column major)
+int etcPixel(int i)
+{
+  return (i % 4) * 4 + i / 4;
+}
+
+// whether the block pixel 'i' (column major) is in the second sub-block
+bool inSecondSubBlock(int i, bool flip)
+{
+  return flip ? (i % 4) >= 2 : (i / 4) >= 2;
+}
+
+struct SubBlockFit
+{
+  int table = 0;
+  int error = 0;
+  int indices[16] {}; // only for the pixels of the sub-block
+};
+
+SubBlockFit fitSubBlock(Block const& block, bool flip, bool second, Rgb base)
+{
+  SubBlockFit best;
+  best.error = 0x7fffffff;
+
+  for(int table = 0; table < 8; ++table)
+  {
+    SubBlockFit fit;
+    fit.table = table;
+
+    for(int i = 0; i < 16; ++i)
+    {
+      if(inSecondSubBlock(i, flip) != second)
+        continue;
+
+      auto const pel = block.pels[etcPixel(i)];
+      int bestError = 0x7fffffff;
+
+      for(int k = 0; k < 4; ++k)
+      {
+        auto const mod = etcModifier(table, k);
+        auto const error = distance({ clamp255(base.r + mod), clamp255(base.g + mod), clamp255(base.b + mod) }, pel);
+
+        if(error < bestError)
+        {
+          bestError = error;
+          fit.indices[i] = k;
+        }
+      }
+
+      fit.error += bestError;
+    }
+
+    if(fit.error < best.error)
+      best = fit;
+  }
+
+  return best;
+}
+
+Rgb averageSubBlock(Block const& block, bool flip, bool second)
+{
+  int sum[3] {};
+
+  for(int i = 0; i < 16; ++i)
+  {
+    if(inSecondSubBlock(i, flip) != second)
+      continue;
+
+    for(int k = 0; k < 3; ++k)
+      sum[k] += block.pels[etcPixel(i)][k];
+  }
+
+  return { sum[0] / 8, sum[1] / 8, sum[2] / 8 };
+}
+
+int quantize(int val, int maxVal)
+{
+  return (val * maxVal + 127) / 255;
+}
+
+int expand4(int c)
+{
+  return (c << 4) | c;
+}
+
+int expand5(int c)
+{
+  return (c << 3) | (c >> 2);
+}
+
+// Tries both orientations, in both modes, and keeps the best.
+void encodeEtc2Colors(Block const& block, uint8_t* out)
+{
+  int bestError = 0x7fffffff;
+
+  for(int flip = 0; flip < 2; ++flip)
+  {
+    Rgb const avg[2] = { averageSubBlock(block, flip, false), averageSubBlock(block, flip, true) };
+
+    for(int diff = 0; diff < 2; ++diff)
+    {
+      auto const maxVal = diff ? 31 : 15;
+      Rgb quant[2];
+      Rgb base[2];
+
+      for(int s = 0; s < 2; ++s)
+      {
+        quant[s] = { quantize(avg[s].r, maxVal), quantize(avg[s].g, maxVal), quantize(avg[s].b, maxVal) };
+
+        if(diff)
+          base[s] = { expand5(quant[s].r), expand5(quant[s].g), expand5(quant[s].b) };
+        else
+          base[s] = { expand4(quant[s].r), expand4(quant[s].g), expand4(quant[s].b) };
+      }
+
+      Rgb const delta = { quant[1].r - quant[0].r, quant[1].g - quant[0].g, quant[1].b - quant[0].b };
+
+      if(diff)
+      {
+        auto outOfRange = [] (int d) { return d < -4 || d > 3; };
+
+        if(outOfRange(delta.r) || outOfRange(delta.g) || outOfRange(delta.b))
+          continue;
+      }
+
+      auto const fit0 = fitSubBlock(block, flip, false, base[0]);
+      auto const fit1 = fitSubBlock(block, flip, true, base[1]);
+
+      if(fit0.error + fit1.error >= bestError)
+        continue;
+
+      bestError = fit0.error + fit1.error;
+
+      if(diff)
+      {
+        out[0] = (quant[0].r << 3) | (delta.r & 7);
+        out[1] = (quant[0].g << 3) | (delta.g & 7);
+        out[2] = (quant[0].b << 3) | (delta.b & 7);
+      }
+      else
+      {
+        out[0] = (quant[0].r << 4) | quant[1].r;
+        out[1] = (quant[0].g << 4) | quant[1].g;
+        out[2] = (quant[0].b << 4) | quant[1].b;
+      }
+
+      out[3] = (fit0.table << 5) | (fit1.table << 2) | (diff << 1) | flip;
+
+      uint32_t indices = 0;
+
+      for(int i = 0; i < 16; ++i)
+      {
+        auto const k = inSecondSubBlock(i, flip) ? fit1.indices[i] : fit0.indices[i];
+        indices |= ((k >> 1) << (16 + i)) | ((k & 1) << i);
+      }
+
+      for(int i = 0; i < 4; ++i)
+        out[4 + i] = indices >> (24 - i * 8);
+    }
+  }
+}
+
+// Only decodes the modes 'encodeEtc2Colors' emits.
+void decodeEtc2Colors(uint8_t const* in, Block& block)
+{
+  auto const diff = (in[3] >> 1) & 1;
+  auto const flip = in[3] & 1;
+  int const tables[2] = { in[3] >> 5, (in[3] >> 2) & 7 };
+
+  Rgb base[2];
+
+  if(diff)
+  {
+    auto signExtend3 = [] (int d) { return d >= 4 ? d - 8 : d; };
+    int c0[3], c1[3];
+
+    for(int k = 0; k < 3; ++k)
+    {
+      c0[k] = in[k] >> 3;
+      c1[k] = c0[k] + signExtend3(in[k] & 7);
+
+      if(c1[k] < 0 || c1[k] > 31)
+        throw runtime_error("Unsupported ETC2 block mode");
+    }
+
+    base[0] = { expand5(c0[0]), expand5(c0[1]), expand5(c0[2]) };
+    base[1] = { expand5(c1[0]), expand5(c1[1]), expand5(c1[2]) };
+  }
+  else
+  {
+    base[0] = { expand4(in[0] >> 4), expand4(in[1] >> 4), expand4(in[2] >> 4) };
+    base[1] = { expand4(in[0] & 15), expand4(in[1] & 15), expand4(in[2] & 15) };
+  }
+
+  auto const indices = (uint32_t(in[4]) << 24) | (in[5] << 16) | (in[6] << 8) | in[7];
+
+  for(int i = 0; i < 16; ++i)
+  {
+    auto const s = inSecondSubBlock(i, flip) ? 1 : 0;
+    auto const k = (((indices >> (16 + i)) & 1) << 1) | ((indices >> i) & 1);
+    auto const mod = etcModifier(tables[s], k);
+    auto pel = block.pels[etcPixel(i)];
+    pel[0] = clamp255(base[s].r + mod);
+    pel[1] = clamp255(base[s].g + mod);
+    pel[2] = clamp255(base[s].b + mod);
+    pel[3] = 255;
+  }
+}
+
+int const EAC_MODIFIERS[16][8] =
+{
+  { -3, -6, -9, -15, 2, 5, 8, 14 },
+  { -3, -7, -10, -13, 2, 6, 9, 12 },
+  { -2, -5, -8, -13, 1, 4, 7, 12 },
+  { -2, -4, -6, -13, 1, 3, 5, 12 },
+  { -3, -6, -8, -12, 2, 5, 7, 11 },
+  { -3, -7, -9, -11, 2, 6, 8, 10 },
+  { -4, -7, -8, -11, 3, 6, 7, 10 },
+  { -3, -5, -8, -11, 2, 4, 7, 10 },
+  { -2, -6, -8, -10, 1, 5, 7, 9 },
+  { -2, -5, -8, -10, 1, 4, 7, 9 },
+  { -2, -4, -8, -10, 1, 3, 7, 9 },
+  { -2, -5, -7, -10, 1, 4, 6, 9 },
+  { -3, -4, -7, -10, 2, 3, 6, 9 },
+  { -1, -2, -3, -10, 0, 1, 2, 9 },
+  { -4, -6, -8, -9, 3, 5, 7, 8 },
+  { -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+void encodeEacAlpha(Block const& block, uint8_t* out)
+{
+  int lo = 255, hi = 0;
+
+  for(auto& pel : block.pels)
+  {
+    lo = min(lo, (int)pel[3]);
+    hi = max(hi, (int)pel[3]);
+  }
+
+  // constant: the modifier 0 of table 13
+  int bestBase = lo, bestMultiplier = 1, bestTable = 13;
+  uint64_t bestIndices = 0;
+
+  for(int i = 0; i < 16; ++i)
+    bestIndices |= uint64_t(4) << (45 - i * 3);
+
+  if(lo != hi)
+  {
+    int bestError = 0x7fffffff;
+
+    for(int table = 0; table < 16; ++table)
+    {
+      auto const modMin = EAC_MODIFIERS[table][3];
+      auto const modMax = EAC_MODIFIERS[table][7];
+      auto const guess = (hi - lo + (modMax - modMin) / 2) / (modMax - modMin);
+
+      for(int multiplier = max(1, guess - 1); multiplier <= min(15, guess + 1); ++multiplier)
+      {
+        auto const base = clamp255((hi + lo - (modMax + modMin) * multiplier + 1) / 2);
+        int error = 0;
+        uint64_t indices = 0;
+
+        for(int i = 0; i < 16; ++i)
+        {
+          auto const alpha = block.pels[etcPixel(i)][3];
+          int bestK = 0;
+          int bestPelError = 0x7fffffff;
+
+          for(int k = 0; k < 8; ++k)
+          {
+            auto const pelError = square(clamp255(base + EAC_MODIFIERS[table][k] * multiplier) - alpha);
+
+            if(pelError < bestPelError)
+            {
+              bestPelError = pelError;
+              bestK = k;
+            }
+          }
+
+          error += bestPelError;
+          indices |= uint64_t(bestK) << (45 - i * 3);
+        }
+
+        if(error < bestError)
+        {
+          bestError = error;
+          bestBase = base;
+          bestMultiplier = multiplier;
+          bestTable = table;
+          bestIndices = indices;
+        }
+      }
+    }
+  }
+
+  out[0] = bestBase;
+  out[1] = (bestMultiplier << 4) | bestTable;
+
+  for(int i = 0; i < 6; ++i)
+    out[2 + i] = bestIndices >> (40 - i * 8);
+}
+
+void decodeEacAlpha(uint8_t const* in, Block& block)
+{
+  int const base = in[0];
+  int const multiplier = in[1] >> 4;
+  int const table = in[1] & 15;
+
+  uint64_t indices = 0;
+
+  for(int i = 0; i < 6; ++i)
+    indices |= uint64_t(in[2 + i]) << (40 - i * 8);
+
+  for(int i = 0; i < 16; ++i)
+  {
+    auto const k = (indices >> (45 - i * 3)) & 7;
+    block.pels[etcPixel(i)][3] = clamp255(base + EAC_MODIFIERS[table][k] * multiplier);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int getBlockBytes(TextureFormat format)
+{
+  switch(format)
+  {
+  case TextureFormat::Bc1:
+  case TextureFormat::Etc2Rgb:
+    return 8;
+  case TextureFormat::Bc3:
+  case TextureFormat::Etc2Rgba:
+    return 16;
+  case TextureFormat::Rgba8:
+    break;
+  }
+
+  throw runtime_error("Not a block compressed format");
+}
+
+void encodeBlock(TextureFormat format, Block const& block, uint8_t* out)
+{
+  switch(format)
+  {
+  case TextureFormat::Bc1:
+    encodeBc1Colors(block, out);
+    break;
+  case TextureFormat::Bc3:
+    encodeBc3Alpha(block, out);
+    encodeBc1Colors(block, out + 8);
+    break;
+  case TextureFormat::Etc2Rgb:
+    encodeEtc2Colors(block, out);
+    break;
+  case TextureFormat::Etc2Rgba:
+    encodeEacAlpha(block, out);
+    encodeEtc2Colors(block, out + 8);
+    break;
+  case TextureFormat::Rgba8:
+    throw runtime_error("Not a block compressed format");
+  }
+}
+
+void decodeBlock(TextureFormat format, uint8_t const* in, Block& block)
+{
+  switch(format)
+  {
+  case TextureFormat::Bc1:
+    decodeBc1Colors(in, block, false);
+    break;
+  case TextureFormat::Bc3:
+    decodeBc1Colors(in + 8, block, true);
+    decodeBc3Alpha(in, block);
+    break;
+  case TextureFormat::Etc2Rgb:
+    decodeEtc2Colors(in, block);
+    break;
+  case TextureFormat::Etc2Rgba:
+    decodeEtc2Colors(in + 8, block);
+    decodeEacAlpha(in, block);
+    break;
+  case TextureFormat::Rgba8:
+    throw runtime_error("Not a block compressed format");
+  }
+}
+
+vector<uint8_t> encodeLevel(PictureView pic, TextureFormat format)
+{
+  if(format == TextureFormat::Rgba8)
+  {
+    vector<uint8_t> r(pic.dim.width * pic.dim.height * 4);
+
+    for(int y = 0; y < pic.dim.height; ++y)
+      memcpy(&r[y * pic.dim.width * 4], pic.pixels + y * pic.stride * 4, pic.dim.width * 4);
+
+    return r;
+  }
+
+  auto const blockBytes = getBlockBytes(format);
+  auto const cols = (pic.dim.width + 3) / 4;
+  auto const rows = (pic.dim.height + 3) / 4;
+
+  vector<uint8_t> r(cols * rows * blockBytes);
+
+  for(int by = 0; by < rows; ++by)
+    for(int bx = 0; bx < cols; ++bx)
+      encodeBlock(format, fetchBlock(pic, bx, by), &r[(bx + by * cols) * blockBytes]);
+
+  return r;
+}
+
+Size2i getLevelSize(Size2i dim, int level)
+{
+  return Size2i(max(1, dim.width >> level), max(1, dim.height >> level));
+}
+}
+
+int getImageBytes(TextureFormat format, Size2i dim)
+{
+  if(format == TextureFormat::Rgba8)
+    return dim.width * dim.height * 4;
+
+  return ((dim.width + 3) / 4) * ((dim.height + 3) / 4) * getBlockBytes(format);
+}
+
+Texture toTexture(Picture pic)
+{
+  Texture r;
+  r.dim = pic.dim;
+  r.levels.push_back(encodeLevel(pic, TextureFormat::Rgba8));
+  return r;
+}
+
+Texture compressTexture(PictureView pic, TextureFormat format, bool srgb)
+{
+  Texture r;
+  r.format = format;
+  r.dim = pic.dim;
+  r.levels.push_back(encodeLevel(pic, format));
+
+  Picture level;
+
+  for(auto src = pic; src.dim.width > 1 || src.dim.height > 1; src = level)
+  {
+    level = downsample(src, srgb);
+    r.levels.push_back(encodeLevel(level, format));
+  }
+
+  return r;
+}
+
+Picture decompressTexture(Texture const& tex, int level)
+{
+  if(level < 0 || level >= (int)tex.levels.size())
+    throw runtime_error("Invalid texture level");
+
+  Picture r;
+  r.dim = getLevelSize(tex.dim, level);
+  r.stride = r.dim.width;
+
+  auto& data = tex.levels[level];
+
+  if(tex.format == TextureFormat::Rgba8)
+  {
+    r.pixels = data;
+    return r;
+  }
+
+  r.pixels.resize(r.dim.width * r.dim.height * 4);
+
+  auto const blockBytes = getBlockBytes(tex.format);
+  auto const cols = (r.dim.width + 3) / 4;
+  auto const rows = (r.dim.height + 3) / 4;
+
+  for(int by = 0; by < rows; ++by)
+  {
+    for(int bx = 0; bx < cols; ++bx)
+    {
+      Block block;
+      decodeBlock(tex.format, &data[(bx + by * cols) * blockBytes], block);
+      storeBlock(r, bx, by, block);
+    }
+  }
+
+  return r;
+}
+
+bool hasAlpha(PictureView pic)
+{
+  for(int y = 0; y < pic.dim.height; ++y)
+    for(int x = 0; x < pic.dim.width; ++x)
+      if(pic.pixels[(x + y * pic.stride) * 4 + 3] != 255)
+        return true;
+
+  return false;
+}
+
+bool hasAlpha(Texture const& tex)
+{
+  switch(tex.format)
+  {
+  case TextureFormat::Bc1:
+  case TextureFormat::Etc2Rgb:
+    return false;
+  case TextureFormat::Bc3:
+  case TextureFormat::Etc2Rgba:
+    return true;
+  case TextureFormat::Rgba8:
+    break;
+  }
+
+  if(tex.levels.empty())
+    return false;
+
+  auto& pixels = tex.levels[0];
+
+  for(int i = 3; i < (int)pixels.size(); i += 4)
+    if(pixels[i] != 255)
+      return true;
+
+  return false;
+}
+
+uint64_t hashTexture(Texture const& tex)
+{
+  // FNV-1a
+  uint64_t hash = 0xcbf29ce484222325ull;
+
+  auto add = [&] (uint8_t const* bytes, size_t size)
+    {
+      for(size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    };
+
+  int32_t const header[] = { (int32_t)tex.format, tex.dim.width, tex.dim.height, (int32_t)tex.levels.size() };
+  add((uint8_t const*)header, sizeof header);
+
+  for(auto& level : tex.levels)
+    add(level.data(), level.size());
+
+  return hash;
+}
+
+// header: "TEX ", version, format, width, height
+// then level count, and for each: size, bytes
+string serializeTexture(Texture const& tex)
+{
+  Writer w;
+  w.data.append(TEXTURE_MAGIC, 4);
+  w.pod(TEXTURE_VERSION);
+  w.pod((uint32_t)tex.format);
+  w.pod((int32_t)tex.dim.width);
+  w.pod((int32_t)tex.dim.height);
+  w.pod((uint32_t)tex.levels.size());
+
+  for(auto& level : tex.levels)
+  {
+    w.pod((uint32_t)level.size());
+    w.data.append((char const*)level.data(), level.size());
+  }
+
+  return w.data;
+}
+
+Texture deserializeTexture(Span<const uint8_t> data)
+{
+  Reader r { data };
+
+  if(data.len < 4 || memcmp(data.data, TEXTURE_MAGIC, 4))
+    throw runtime_error("Not a texture file");
+
+  r.pos = 4;
+
+  if(r.pod<uint32_t>() != TEXTURE_VERSION)
+    throw runtime_error("Unsupported texture version");
+
+  Texture tex;
+
+  auto const format = r.pod<uint32_t>();
+
+  if(format > (uint32_t)TextureFormat::Etc2Rgba)
+    throw runtime_error("Invalid texture format");
+
+  tex.format = (TextureFormat)format;
+  tex.dim.width = r.pod<int32_t>();
+  tex.dim.height = r.pod<int32_t>();
+
+  if(tex.dim.width <= 0 || tex.dim.height <= 0 || tex.dim.width > 16384 || tex.dim.height > 16384)
+    throw runtime_error("Invalid texture size");
+
+  auto const levelCount = r.pod<uint32_t>();
+
+  if(levelCount == 0 || levelCount > 15)
+    throw runtime_error("Invalid texture level count");
+
+  tex.levels.resize(levelCount);
+
+  for(int i = 0; i < (int)levelCount; ++i)
+  {
+    r.array(tex.levels[i]);
+
+    if((int)tex.levels[i].size() != getImageBytes(tex.format, getLevelSize(tex.dim, i)))
+      throw runtime_error("Invalid texture level size");
+  }
+
+  if(r.pos != (size_t)data.len)
+    throw runtime_error("Trailing texture data");
+
+  return tex;
+}
+
+Texture deserializeTexture(string const& data)
+{
+  return deserializeTexture({ (uint8_t const*)data.data(), (int)data.size() });
+}
@@ -0,0 +1,65 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// GPU ready textures, possibly block compressed, as cooked by the meshcooker.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "base/span.h"
+#include "picture.h"
+
+enum class TextureFormat
+{
+  Rgba8,
+  Bc1, // opaque, 4 bits per pixel
+  Bc3, // with alpha, 8 bits per pixel
+  Etc2Rgb, // opaque, 4 bits per pixel
+  Etc2Rgba, // with alpha, 8 bits per pixel
+};
+
+struct Texture
+{
+  TextureFormat format = TextureFormat::Rgba8;
+  Size2i dim; // of level 0
+
+  // Level 0 first, bottom row first.
+  // A single Rgba8 level means the mipmaps are generated on upload.
+  vector<vector<uint8_t>> levels;
+};
+
+// Bytes of a 'dim' sized image in 'format'.
+// Partial blocks on the right and top are padded.
+int getImageBytes(TextureFormat format, Size2i dim);
+
+// uncompressed, single level
+Texture toTexture(Picture pic);
+
+// Encodes 'pic', and its whole mipmap chain, into 'format'.
+// 'srgb': whether 'pic' holds colors, rather than linear data (e.g lightmaps),
+// which changes how the mipmaps are filtered.
+Texture compressTexture(PictureView pic, TextureFormat format, bool srgb = true);
+
+// Decodes a level back to RGBA (e.g to check the encoders).
+Picture decompressTexture(Texture const& tex, int level);
+
+// whether any pixel isn't fully opaque
+bool hasAlpha(PictureView pic);
+
+// By format, for the compressed ones
+bool hasAlpha(Texture const& tex);
+
+// Of the format, the size and every level: identical textures get the
+// same hash, whatever their path (e.g the placeholders of the meshcooker).
+uint64_t hashTexture(Texture const& tex);
+
+string serializeTexture(Texture const& tex);
+Texture deserializeTexture(Span<const uint8_t> data);
+Texture deserializeTexture(string const& data);
@@ -0,0 +1,112 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Decides how many fixed-step ticks to run for each display frame.
+// After a stall, the catch-up is bounded: the ticks over budget are dropped,
+// and the game runs slower than the clock for a while, instead of spiraling.
+
+#pragma once
+
+#include <algorithm> // max
+#include <cmath> // ceil
+
+#include "base/util.h" // clamp
+
+struct TickScheduler
+{
+  // times are in ms
+  int timestep = 10; // of game time per tick
+
+  // between two display frames. 0: a frame is drawn after each tick
+  double framePeriod = 0;
+
+  // catch-up budget of a frame, in ticks, and in real time
+  int maxTicksPerFrame = 10;
+  int maxCatchUpTime = 50;
+
+  // counters, since 'start'
+  int lateTicks = 0; // run behind the clock, past the ticks of a normal frame
+  int droppedTicks = 0; // never run
+
+  void start(double now)
+  {
+    m_lastTime = now;
+    m_now = now;
+    m_due = 0;
+    lateTicks = 0;
+    droppedTicks = 0;
+  }
+
+  void beginFrame(double now)
+  {
+    m_now = now;
+    m_frameStart = now;
+    m_ticked = 0;
+    m_due = 0;
+
+    if(m_lastTime + timestep < now)
+      m_due = (int)ceil((now - m_lastTime) / timestep) - 1;
+
+    if(m_due > maxTicksPerFrame)
+      drop(m_due - maxTicksPerFrame);
+  }
+
+  // Whether to run one more tick in this frame.
+  // 'clock' is the real time, to check the catch-up budget.
+  bool nextTick(double clock)
+  {
+    if(m_due <= 0)
+      return false;
+
+    // the first one always runs: the game must move forward
+    if(m_ticked > 0 && clock - m_frameStart > maxCatchUpTime)
+    {
+      drop(m_due);
+      return false;
+    }
+
+    if(m_ticked >= getTicksPerFrame())
+      lateTicks++;
+
+    m_due--;
+    m_ticked++;
+    m_lastTime += timestep;
+    return true;
+  }
+
+  // time since the last tick, in ticks, in [0 .. 1]
+  float getTickFraction() const
+  {
+    return clamp(float((m_now - m_lastTime) / timestep), 0.0f, 1.0f);
+  }
+
+  // when the next tick is due
+  double getNextTickTime() const
+  {
+    return m_lastTime + timestep;
+  }
+
+private:
+  // how many ticks a frame runs, when on schedule
+  int getTicksPerFrame() const
+  {
+    return max(1, (int)ceil(framePeriod / timestep));
+  }
+
+  // skip 'n' due ticks: the game time falls behind the clock
+  void drop(int n)
+  {
+    m_lastTime += n * timestep;
+    m_due -= n;
+    droppedTicks += n;
+  }
+
+  double m_lastTime = 0;
+  double m_now = 0;
+  double m_frameStart = 0;
+  int m_due = 0; // still to run in this frame
+  int m_ticked = 0; // run in this frame
+};
@@ -0,0 +1,120 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/misc/archive.h"
+#include "engine/src/misc/file.h"
+#include "tests.h"
+#include <cstdio> // remove
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+Span<const uint8_t> toSpan(string const& s)
+{
+  return { (uint8_t const*)s.data(), (int)s.size() };
+}
+
+string makeArchive()
+{
+  string const a = "first file";
+  string const b = "second";
+  string const empty;
+
+  return serializeArchive({ { "res/a.txt", toSpan(a) }, { "res/b.bin", toSpan(b) }, { "res/empty", toSpan(empty) } });
+}
+}
+
+unittest("Archive: index round trip")
+{
+  auto const data = makeArchive();
+  auto const index = parseArchiveIndex(toSpan(data), data.size());
+
+  assertEquals(3u, index.size());
+
+  auto entry = findArchiveEntry(index, "res/b.bin");
+  assertTrue(entry != nullptr);
+  assertEquals(6u, entry->size);
+  assertEquals(0u, entry->offset % 16);
+  assertEquals("second", data.substr(entry->offset, entry->size));
+
+  assertTrue(findArchiveEntry(index, "res/empty") != nullptr);
+  assertTrue(findArchiveEntry(index, "res/c.txt") == nullptr);
+}
+
+unittest("Archive: invalid archives are rejected")
+{
+  auto const data = makeArchive();
+
+  assertThrown(parseArchiveIndex(toSpan("PACX" + data.substr(4)), data.size()));
+  assertThrown(parseArchiveIndex(toSpan(data.substr(0, 20)), data.size()));
+  assertThrown(parseArchiveIndex(toSpan(data), 20)); // entries out of it
+
+  string const s = "x";
+  assertThrown(serializeArchive({ { "res/a", toSpan(s) }, { "res/a", toSpan(s) } }));
+}
+
+unittest("Archive: mounted files are read before loose ones")
+{
+  auto const packPath = "archive_test.pack";
+  auto const loosePath = "archive_test_loose.txt";
+
+  auto const data = makeArchive();
+  File::write(packPath, toSpan(data));
+  File::write(loosePath, toSpan(string("loose")));
+
+  File::mount(packPath);
+
+  assertTrue(File::exists("res/a.txt"));
+  assertTrue(!File::exists("res/c.txt"));
+  assertEquals("first file", File::read("res/a.txt"));
+
+  {
+    auto const file = File::map("res/b.bin");
+    assertEquals("second", string((char const*)file->data.data, file->data.len));
+  }
+
+  assertEquals(0, File::map("res/empty")->data.len);
+
+  // not in the archive: from the disk
+  assertEquals("loose", File::read(loosePath));
+
+  File::unmountAll();
+  assertTrue(!File::exists("res/a.txt"));
+
+  remove(packPath);
+  remove(loosePath);
+}
+
+unittest("Archive: on-demand archives are mounted when needed")
+{
+  auto const packPath = "archive_test_on_demand.pack";
+
+  auto const data = makeArchive();
+  File::write(packPath, toSpan(data));
+
+  File::mountOnDemand(packPath, { "res/a", "res/b" });
+  File::mountOnDemand("archive_test_missing.pack", { "res/missing/" });
+
+  // natively, there's nothing to wait for
+  assertTrue(File::prefetch("res/a.txt"));
+  assertTrue(File::prefetch("other/file"));
+  assertEquals(0, (int)File::getFetchProgress().total);
+
+  assertEquals("first file", File::read("res/a.txt"));
+  assertTrue(File::exists("res/b.bin"));
+
+  // mounted as a whole
+  assertEquals(0, File::map("res/empty")->data.len);
+
+  assertTrue(!File::exists("res/missing/file"));
+
+  File::unmountAll();
+  assertTrue(!File::exists("res/a.txt"));
+
+  remove(packPath);
+}
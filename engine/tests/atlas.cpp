@@ -0,0 +1,124 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/render/atlas.h"
+#include "tests.h"
+#include <cmath> // fabs
+#include <stdexcept>
+using namespace std;
+
+namespace
+{
+Picture makeFlatPicture(int width, int height, uint8_t value)
+{
+  Picture pic;
+  pic.dim = Size2i(width, height);
+  pic.stride = width;
+  pic.pixels.assign(width * height * 4, value);
+  return pic;
+}
+
+int getTexel(Picture const& pic, int x, int y)
+{
+  return pic.pixels[(x + y * pic.stride) * 4];
+}
+
+bool overlap(Vector2i posA, Size2i a, Vector2i posB, Size2i b)
+{
+  return posA.x < posB.x + b.width && posB.x < posA.x + a.width
+         && posA.y < posB.y + b.height && posB.y < posA.y + a.height;
+}
+}
+
+unittest("Atlas: pack")
+{
+  auto a = makeFlatPicture(32, 16, 10);
+  auto b = makeFlatPicture(8, 8, 20);
+  auto c = makeFlatPicture(32, 16, 10); // same pixels as 'a'
+
+  Picture page;
+  vector<Vector2i> positions;
+  assertTrue(packAtlasPage({ a, b, c }, 1024, page, positions));
+
+  assertEquals(3, (int)positions.size());
+  assertTrue(page.dim.width <= 64);
+  assertTrue(!overlap(positions[0], a.dim, positions[1], b.dim));
+
+  // identical pictures share their place
+  assertEquals(positions[0].x, positions[2].x);
+  assertEquals(positions[0].y, positions[2].y);
+
+  // the texels, and the padding around them
+  assertEquals(10, getTexel(page, positions[0].x, positions[0].y));
+  assertEquals(20, getTexel(page, positions[1].x + 7, positions[1].y + 7));
+  assertEquals(20, getTexel(page, positions[1].x + 9, positions[1].y - 2));
+}
+
+unittest("Atlas: pack, too big")
+{
+  auto a = makeFlatPicture(64, 64, 0);
+
+  Picture page;
+  vector<Vector2i> positions;
+  assertTrue(!packAtlasPage({ a, a, a }, 64, page, positions));
+  assertTrue(packAtlasPage({ a }, 128, page, positions));
+}
+
+unittest("Atlas: serialization")
+{
+  TextureAtlas atlas;
+  atlas.pages.push_back({ "res/sprites/atlas-opaque.png", Size2i(256, 128) });
+  atlas.tiles.push_back({ "res/sprites/box.0.diffuse.png", 0, Vector2i(4, 8), Size2i(16, 32) });
+
+  auto const result = deserializeAtlas(serializeAtlas(atlas));
+
+  assertEquals(1, (int)result.pages.size());
+  assertEquals(string("res/sprites/atlas-opaque.png"), result.pages[0].path);
+  assertEquals(128, result.pages[0].size.height);
+
+  auto const tile = result.find("res/sprites/box.0.diffuse.png");
+  assertTrue(tile != nullptr);
+  assertEquals(8, tile->pos.y);
+  assertEquals(32, tile->size.height);
+  assertTrue(result.find("res/sprites/box.1.diffuse.png") == nullptr);
+
+  // out of its page
+  assertThrown(deserializeAtlas("page a.png 16 16\ntile b.png 0 8 8 16 16\n"));
+  assertThrown(deserializeAtlas("tile b.png 0 0 0 1 1\n"));
+}
+
+unittest("Atlas: remap")
+{
+  TextureAtlas atlas;
+  atlas.pages.push_back({ "page.png", Size2i(256, 256) });
+  atlas.tiles.push_back({ "tile.png", 0, Vector2i(64, 128), Size2i(32, 64) });
+
+  SingleRenderMesh single;
+  SingleRenderMesh::Vertex v {};
+  v.nz = 1;
+  v.diffuse_u = 0;
+  v.diffuse_v = 0;
+  single.vertices.push_back(packVertex(v));
+  v.diffuse_u = 1;
+  v.diffuse_v = 0.5;
+  single.vertices.push_back(packVertex(v));
+
+  assertTrue(hasDiffuseInTile(single));
+  remapDiffuse(single, atlas, atlas.tiles[0]);
+
+  auto const first = unpackVertex(single.vertices[0]);
+  auto const second = unpackVertex(single.vertices[1]);
+  assertTrue(fabs(first.diffuse_u - 0.25) < 0.001);
+  assertTrue(fabs(first.diffuse_v - 0.5) < 0.001);
+  assertTrue(fabs(second.diffuse_u - 0.375) < 0.001);
+  assertTrue(fabs(second.diffuse_v - 0.625) < 0.001);
+  assertTrue(fabs(second.nz - 1) < 0.01);
+
+  // wrapping UVs keep their own texture
+  v.diffuse_u = 3;
+  single.vertices.push_back(packVertex(v));
+  assertTrue(!hasDiffuseInTile(single));
+}
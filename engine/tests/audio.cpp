@@ -6,6 +6,7 @@
 
 #include "engine/src/audio/audio_channel.h"
 #include "engine/tests/tests.h"
+#include <cmath> // fabs
 
 struct DummySource : IAudioSource
 {
@@ -134,3 +135,77 @@ unittest("Audio: play channel until end, loop")
   assert(buffEquals(expected, buffer));
 }
 
+
+unittest("Audio: play channel, larger buffer")
+{
+  DummySound sound;
+  sound.length = 70;
+
+  AudioChannel v;
+  v.play(&sound);
+
+  float buffer[100] = { 0 };
+  v.mix(buffer);
+
+  for(int i = 0; i < 100; ++i)
+    assertEquals(i >= 70 ? 0.0f : i % 10 == 0 ? 1.0f : 2.0f, buffer[i]);
+
+  assertTrue(v.isDead());
+}
+
+unittest("Audio: mix with volume ramp")
+{
+  float input[10] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+  float output[10] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+
+  mixRamp(output, input, 10, 0, 1);
+
+  // per frame: the same volume on both channels
+  float expected[10] = { 1, 1, 1.2f, 1.2f, 1.4f, 1.4f, 1.6f, 1.6f, 1.8f, 1.8f };
+
+  for(int i = 0; i < 10; ++i)
+    assertTrue(fabs(expected[i] - output[i]) < 1e-6);
+}
+
+unittest("Audio: fade in")
+{
+  DummySound sound;
+  sound.length = 1000;
+
+  AudioChannel v;
+  v.play(&sound, 1);
+
+  float buffer[64] = { 0 };
+  v.mix(buffer);
+
+  // rising, from silence
+  assertEquals(0.0f, buffer[0]);
+  assertTrue(buffer[62] > buffer[2]);
+  assertTrue(buffer[62] < 2.0f);
+}
+
+#include "engine/src/audio/audio_telemetry.h"
+
+unittest("Audio: telemetry")
+{
+  AudioTelemetry telemetry(48000, 480); // 10ms
+
+  telemetry.record(1, -1);
+  telemetry.record(3, 10);
+  telemetry.record(12, 10); // too long
+  telemetry.record(2, 25); // late
+
+  auto stats = telemetry.read();
+  assertEquals(48000, stats.sampleRate);
+  assertEquals(10.0f, stats.budgetMs);
+  assertEquals(12.0f, stats.maxMixMs);
+  assertEquals(4, stats.callbacks);
+  assertEquals(1, stats.missedDeadlines);
+  assertEquals(1, stats.lateCallbacks);
+
+  // the maximum is since the previous read, the counters since the start
+  telemetry.record(2, 10);
+  stats = telemetry.read();
+  assertEquals(2.0f, stats.maxMixMs);
+  assertEquals(5, stats.callbacks);
+}
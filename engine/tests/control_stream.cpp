@@ -0,0 +1,62 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/misc/control_stream.h"
+#include "tests.h"
+#include <vector>
+using namespace std;
+
+unittest("ControlStream: round trip")
+{
+  vector<Control> controls(3);
+  controls[0].forward = true;
+  controls[0].use = true;
+  controls[1].look_horz = 0.25;
+  controls[1].look_vert = -1.5;
+  controls[2].debug = true;
+  controls[2].restart = true;
+
+  vector<uint8_t> data;
+  writeControlStreamHeader(data);
+
+  for(auto& c : controls)
+    writeControl(data, c);
+
+  auto const result = readControlStream({ data.data(), (int)data.size() });
+
+  assertEquals(3u, result.size());
+  assertTrue(result[0].forward && result[0].use && !result[0].backward);
+  assertEquals(0.25f, result[1].look_horz);
+  assertEquals(-1.5f, result[1].look_vert);
+  assertTrue(!result[1].forward);
+  assertTrue(result[2].debug && result[2].restart);
+  assertEquals(0.0f, result[2].look_horz);
+}
+
+unittest("ControlStream: idle ticks take two bytes")
+{
+  vector<uint8_t> data;
+  writeControlStreamHeader(data);
+  auto const headerSize = data.size();
+
+  writeControl(data, Control {});
+  assertEquals(headerSize + 2, data.size());
+}
+
+unittest("ControlStream: invalid streams are rejected")
+{
+  vector<uint8_t> data;
+  writeControlStreamHeader(data);
+  Control c {};
+  c.look_horz = 1;
+  writeControl(data, c);
+  data.pop_back();
+
+  assertThrown(readControlStream({ data.data(), (int)data.size() }));
+
+  uint8_t garbage[] = { 1, 2, 3, 4, 5, 6 };
+  assertThrown(readControlStream({ garbage, 6 }));
+}
@@ -44,3 +44,44 @@ unittest("Decompress: big")
   assertEquals(']', output[127]);
 }
 
+
+unittest("Decompress: stored block")
+{
+  const uint8_t input[] =
+  {
+    0x78, 0x01, 0x01, 0x07, 0x00, 0xF8, 0xFF, 0x73,
+    0x74, 0x6F, 0x72, 0x65, 0x64, 0x21, 0x0B, 0xEF,
+    0x02, 0xB3,
+  };
+
+  auto const output = decompress(input);
+  assertEquals("stored!", string(output.begin(), output.end()));
+}
+
+unittest("Decompress: overlapping matches")
+{
+  // "0123456789" 40 times: a match 10 bytes back, longer than the distance
+  const uint8_t input[] =
+  {
+    0x78, 0xDA, 0x33, 0x30, 0x34, 0x32, 0x36, 0x31,
+    0x35, 0x33, 0xB7, 0xB0, 0x34, 0x18, 0x65, 0x0D,
+    0x02, 0x16, 0x00, 0x37, 0xB0, 0x52, 0x09,
+  };
+
+  auto const output = decompress(input);
+  assertEquals(400u, output.size());
+
+  for(int i = 0; i < 400; ++i)
+    assertEquals('0' + i % 10, (int)output[i]);
+}
+
+unittest("Decompress: truncated data")
+{
+  const uint8_t input[] =
+  {
+    0x78, 0xDA, 0x33, 0x30, 0x34, 0x32, 0x36, 0x31,
+    0x35, 0x33,
+  };
+
+  assertThrown(decompress(input));
+}
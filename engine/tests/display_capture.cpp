@@ -0,0 +1,199 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "base/resource.h"
+#include "base/thread_pool.h"
+#include "engine/src/render/display_capture.h"
+#include "tests.h"
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+// Logs the calls which make the picture, one string each
+struct LogDisplay : Display
+{
+  vector<string> log;
+
+  void setHdr(bool enable) override { log.push_back("hdr " + to_string(enable)); }
+  void setFsaa(bool) override {}
+  void setDepthPrepass(bool) override {}
+  void setOcclusionCulling(bool enable) override { log.push_back("occlusion " + to_string(enable)); }
+  void setDynamicResolution(float, float, float) override {}
+  void setMemoryBudget(int64_t bytes) override { log.push_back("budget " + to_string(bytes)); }
+  void loadModel(int id, const char* path) override { log.push_back("load " + to_string(id) + " " + path); }
+
+  void loadModels(Span<const Resource> models, ThreadPool&) override
+  {
+    for(auto& res : models)
+      loadModel(res.id, res.path);
+  }
+
+  // done at the second call
+  bool loadModelInBackground(int id, const char* path, ThreadPool&) override
+  {
+    if(!pending.count(id))
+    {
+      pending.insert(id);
+      return false;
+    }
+
+    pending.erase(id);
+    loadModel(id, path);
+    return true;
+  }
+
+  set<int> pending;
+
+  void unloadModel(int id) override { log.push_back("unload " + to_string(id)); }
+  void setCamera(Vector3f pos, Quaternion dir) override { log.push_back("camera " + to_string(pos.x) + " " + to_string(dir.s)); }
+  void setAmbientLight(float) override {}
+  void beginDraw() override { log.push_back("begin"); }
+  void endDraw() override { log.push_back("end"); }
+
+  void drawActor(Rect3f where, Quaternion, int modelId, bool blinking, int actionIdx, float frame) override
+  {
+    log.push_back("actor " + to_string(where.size.cz) + " " + to_string(modelId) + " " + to_string(blinking) + " " + to_string(actionIdx) + " " + to_string(frame));
+  }
+
+  void drawParticles(int modelId, Span<const Rect3f> where) override
+  {
+    log.push_back("particles " + to_string(modelId) + " " + to_string(where.len) + " " + to_string(where[where.len - 1].pos.y));
+  }
+
+  void drawText(Vector2f pos, char const* text) override { log.push_back("text " + to_string(pos.y) + " " + text); }
+
+  // not recorded
+  void setFullscreen(bool) override { log.push_back("fullscreen"); }
+  void setCaption(const char*) override {}
+  void readPixels(Span<uint8_t>) override {}
+  void captureFrame(CaptureCallback const&) override {}
+  void flushCaptures(CaptureCallback const&) override {}
+  Span<const PassTiming> getGpuTimings() override { return {}; }
+  void enableGrab(bool) override {}
+  bool isVsynced() override { return false; }
+  void acquireContext() override {}
+  void releaseContext() override {}
+};
+
+// Two frames, and a model loaded in between
+void playSession(Display* display)
+{
+  ThreadPool pool(1);
+  Resource models[] = { { ResourceType::Model, 3, "res/a.mesh" } };
+
+  display->setHdr(true);
+  display->setMemoryBudget(int64_t(1) << 40);
+  display->loadModels(models, pool);
+  display->setFullscreen(true);
+
+  display->setCamera(Vector3f(1, 2, 3), Quaternion::rotation(Vector3f(0, 0, 1), 0));
+  display->beginDraw();
+  display->drawActor(Rect3f(0, 0, 0, 1, 1, 2), Quaternion(), 3, true, 4, 0.5);
+  display->drawText(Vector2f(0, -2), "PAUSE");
+  display->endDraw();
+
+  while(!display->loadModelInBackground(5, "res/b.mesh", pool))
+  {
+  }
+
+  display->setOcclusionCulling(false);
+
+  vector<Rect3f> particles { Rect3f(0, 0, 0, 1, 1, 1), Rect3f(0, 7, 0, 1, 1, 1) };
+  display->beginDraw();
+  display->drawParticles(5, particles);
+  display->endDraw();
+
+  display->unloadModel(5);
+}
+
+// Returns the capture, and the calls 'playSession' made, as recorded.
+vector<uint8_t> capture(vector<string>& calls)
+{
+  vector<uint8_t> data;
+  auto sink = [&] (Span<const uint8_t> bytes) { data.insert(data.end(), bytes.data, bytes.data + bytes.len); };
+
+  {
+    auto inner = make_unique<LogDisplay>();
+    auto const log = &inner->log;
+
+    unique_ptr<Display> display(createCaptureDisplay(move(inner), Size2i(320, 200), sink));
+    playSession(display.get());
+
+    calls = *log;
+  }
+
+  calls.erase(calls.begin() + 3); // "fullscreen": only forwarded
+  return data;
+}
+}
+
+unittest("DisplayCapture: replay")
+{
+  vector<string> recorded;
+  auto const data = capture(recorded);
+
+  DisplayCaptureReader reader(data);
+  assertEquals(320, reader.resolution.width);
+  assertEquals(200, reader.resolution.height);
+
+  LogDisplay replayed;
+  assertTrue(reader.playFrame(&replayed));
+  assertEquals(8, (int)replayed.log.size());
+  assertEquals(string("end"), replayed.log.back());
+
+  assertTrue(reader.playFrame(&replayed));
+
+  // the calls after the last frame
+  assertTrue(!reader.playFrame(&replayed));
+  assertTrue(!reader.playFrame(&replayed));
+
+  assertEquals((int)recorded.size(), (int)replayed.log.size());
+
+  for(int i = 0; i < (int)recorded.size(); ++i)
+    assertEquals(recorded[i], replayed.log[i]);
+}
+
+unittest("DisplayCapture: rewind doesn't load the same models again")
+{
+  vector<string> recorded;
+  auto const data = capture(recorded);
+
+  DisplayCaptureReader reader(data);
+  LogDisplay replayed;
+
+  while(reader.playFrame(&replayed))
+  {
+  }
+
+  replayed.log.clear();
+  reader.rewind();
+  assertTrue(reader.playFrame(&replayed));
+
+  // model 3 stayed loaded, model 5 was unloaded
+  for(auto& call : replayed.log)
+    assertTrue(call.find("load 3") == string::npos);
+
+  assertTrue(reader.playFrame(&replayed));
+  assertEquals(string("load 5 res/b.mesh"), replayed.log[replayed.log.size() - 5]);
+}
+
+unittest("DisplayCapture: invalid")
+{
+  vector<string> recorded;
+  auto const data = capture(recorded);
+
+  assertThrown(DisplayCaptureReader(vector<uint8_t>(data.begin(), data.begin() + 6)));
+  assertThrown(DisplayCaptureReader(vector<uint8_t>(10, 'x')));
+
+  // cut in the middle of the first frame
+  DisplayCaptureReader reader(vector<uint8_t>(data.begin(), data.begin() + 40));
+  LogDisplay replayed;
+  assertThrown(reader.playFrame(&replayed));
+}
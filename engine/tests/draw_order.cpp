@@ -0,0 +1,87 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/render/draw_order.h"
+#include "tests.h"
+#include <algorithm>
+
+namespace
+{
+DrawCommand command(SingleRenderMesh* mesh, float depth, bool depthtest = true)
+{
+  DrawCommand cmd {};
+  cmd.pMesh = mesh;
+  cmd.depthtest = depthtest;
+  cmd.depth = depth;
+  cmd.view = 0;
+  cmd.range = nullptr;
+  return cmd;
+}
+
+// the depths of the sorted commands, in drawing order
+vector<float> sortedDepths(vector<DrawCommand> cmds)
+{
+  stable_sort(cmds.begin(), cmds.end(), drawsBefore);
+
+  vector<float> r;
+
+  for(auto& cmd : cmds)
+    r.push_back(cmd.depth);
+
+  return r;
+}
+}
+
+unittest("DrawOrder: translucent meshes are drawn after the opaque ones, farthest first")
+{
+  SingleRenderMesh opaque;
+  SingleRenderMesh glass;
+  glass.translucent = true;
+
+  auto const r = sortedDepths({
+    command(&glass, 1),
+    command(&opaque, 4),
+    command(&glass, 3),
+    command(&opaque, 2),
+    command(&glass, 5),
+  });
+
+  assertEquals(vector<float>({ 2, 4, 5, 3, 1 }), r);
+}
+
+unittest("DrawOrder: opaque meshes are grouped by texture, then nearest first")
+{
+  SingleRenderMesh a;
+  a.diffuse = 1;
+  SingleRenderMesh b;
+  b.diffuse = 2;
+
+  auto const r = sortedDepths({
+    command(&b, 1),
+    command(&a, 4),
+    command(&b, 3),
+    command(&a, 2),
+  });
+
+  assertEquals(vector<float>({ 2, 4, 1, 3 }), r);
+}
+
+unittest("DrawOrder: overlays come last, in submission order")
+{
+  SingleRenderMesh opaque;
+  SingleRenderMesh glass;
+  glass.translucent = true;
+
+  auto const r = sortedDepths({
+    command(&opaque, 3, false),
+    command(&glass, 1),
+    command(&opaque, 1, false),
+    command(&opaque, 2),
+    command(&glass, 2, false),
+  });
+
+  assertEquals(vector<float>({ 2, 1, 3, 1, 2 }), r);
+}
@@ -0,0 +1,43 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/misc/file.h"
+#include "tests.h"
+#include <cstdio> // remove
+#include <string>
+using namespace std;
+
+unittest("File: map")
+{
+  auto const path = "file_test.bin";
+  const uint8_t bytes[] = { 1, 2, 3, 0, 255 };
+  File::write(path, bytes);
+
+  {
+    auto const file = File::map(path);
+    assertEquals(5, file->data.len);
+    assertEquals(3, (int)file->data.data[2]);
+    assertEquals(255, (int)file->data.data[4]);
+    assertEquals(File::read(path), string((char const*)file->data.data, file->data.len));
+  }
+
+  remove(path);
+}
+
+unittest("File: map an empty file")
+{
+  auto const path = "file_test.bin";
+  File::write(path, {});
+
+  assertEquals(0, File::map(path)->data.len);
+
+  remove(path);
+}
+
+unittest("File: map a missing file")
+{
+  assertThrown(File::map("file_test_missing.bin"));
+}
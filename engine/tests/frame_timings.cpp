@@ -0,0 +1,82 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/misc/frame_timings.h"
+#include "tests.h"
+#include <string>
+using namespace std;
+
+namespace
+{
+FrameTimings::Sample makeSample(float totalMs)
+{
+  FrameTimings::Sample r;
+  r.ms[FrameTimings::Total] = totalMs;
+  r.ms[FrameTimings::Simulation] = totalMs / 2;
+  return r;
+}
+}
+
+unittest("FrameTimings: percentiles")
+{
+  FrameTimings timings;
+
+  // 1 .. 100 ms, shuffled
+  for(int i = 0; i < 100; ++i)
+    timings.push(makeSample((i * 37) % 100 + 1));
+
+  auto const stats = timings.getStats(FrameTimings::Total);
+  assertEquals(50.0f, stats.p50);
+  assertEquals(95.0f, stats.p95);
+  assertEquals(99.0f, stats.p99);
+  assertEquals(100.0f, stats.max);
+
+  assertEquals(50.0f, timings.getStats(FrameTimings::Simulation).max);
+  assertEquals(0.0f, timings.getStats(FrameTimings::Swap).max);
+}
+
+unittest("FrameTimings: a single stutter shows")
+{
+  FrameTimings timings;
+
+  for(int i = 0; i < 99; ++i)
+    timings.push(makeSample(16));
+
+  timings.push(makeSample(250));
+
+  auto const stats = timings.getStats(FrameTimings::Total);
+  assertEquals(16.0f, stats.p99);
+  assertEquals(250.0f, stats.max);
+}
+
+unittest("FrameTimings: keeps the last frames only")
+{
+  FrameTimings timings(4);
+  assertEquals(0, timings.size());
+  assertEquals(0.0f, timings.getStats(FrameTimings::Total).max);
+
+  for(int i = 1; i <= 6; ++i)
+    timings.push(makeSample(i));
+
+  assertEquals(4, timings.size());
+  assertEquals(6.0f, timings.getStats(FrameTimings::Total).max);
+  assertEquals(4.0f, timings.getStats(FrameTimings::Total).p50);
+}
+
+unittest("FrameTimings: CSV, oldest first")
+{
+  FrameTimings timings(2);
+
+  for(int i = 1; i <= 3; ++i)
+    timings.push(makeSample(i));
+
+  auto const expected =
+    string("input,simulation,scene_draw,submit,swap,total\n") +
+    "0.000,1.000,0.000,0.000,0.000,2.000\n" +
+    "0.000,1.500,0.000,0.000,0.000,3.000\n";
+
+  assertEquals(expected, timings.toCsv());
+}
@@ -0,0 +1,90 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/misc/file.h"
+#include "engine/src/misc/frame_writer.h"
+#include "tests.h"
+#include <cstdio> // remove
+#include <thread> // yield
+#include <vector>
+using namespace std;
+
+unittest("FrameWriter: frames are written in order, top row first")
+{
+  auto const path = "frame_writer_test.rgba";
+
+  {
+    FrameWriter writer(path);
+
+    // the queue never fills up when pushing slower than the disk
+    for(uint8_t frame = 0; frame < 20; ++frame)
+    {
+      // one pixel wide, two rows: bottom row first
+      const uint8_t pixels[] = { 1, 1, 1, frame, 2, 2, 2, frame };
+
+      while(writer.getWrittenCount() < frame)
+        this_thread::yield();
+
+      assertTrue(writer.push(pixels, 1));
+    }
+  }
+
+  auto const data = File::read(path);
+  remove(path);
+
+  assertEquals(160u, data.size());
+
+  for(int frame = 0; frame < 20; ++frame)
+  {
+    assertEquals(2, (int)data[frame * 8 + 0]);
+    assertEquals(frame, (int)data[frame * 8 + 3]);
+    assertEquals(1, (int)data[frame * 8 + 4]);
+  }
+}
+
+#ifndef _WIN32 // POSIX shell commands
+
+unittest("FrameWriter: frames are piped into a command")
+{
+  auto const path = "frame_writer_test.rgba";
+
+  {
+    FrameWriter writer(string("cat > ") + path, true);
+    const uint8_t pixels[] = { 1, 2, 3, 4 };
+    assertTrue(writer.push(pixels, 1));
+  }
+
+  auto const data = File::read(path);
+  remove(path);
+
+  assertEquals(4u, data.size());
+  assertEquals(4, (int)data[3]);
+}
+
+unittest("FrameWriter: frames are dropped when the writer is late")
+{
+  int dropped;
+
+  {
+    // waits for the input to be closed: nothing gets written meanwhile
+    FrameWriter writer("sleep 1; cat > /dev/null", true);
+    vector<uint8_t> pixels(1024 * 1024 * 4);
+
+    for(int i = 0; i < 100; ++i)
+      writer.push(pixels, 1024);
+
+    dropped = writer.getDroppedCount();
+  }
+
+  assertTrue(dropped > 0);
+}
+
+#endif
+
+unittest("FrameWriter: unwritable file")
+{
+  assertThrown(FrameWriter("/nonexistent/dir/capture.rgba"));
+}
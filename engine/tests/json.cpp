@@ -6,6 +6,7 @@
 
 #include "engine/src/misc/json.h"
 #include "tests.h"
+#include <cstring> // strlen
 #include <vector>
 using namespace std;
 
@@ -23,10 +24,11 @@ bool jsonOk(string text)
   }
 }
 
+// the document points into 'text': string literals only
 static
-auto jsonParse(string text)
+auto jsonParse(const char* text)
 {
-  return json::parse(text.data(), text.size());
+  return json::parse(text, strlen(text));
 }
 
 unittest("Json parser: empty")
@@ -102,3 +104,34 @@ unittest("Json parser: returned value")
   }
 }
 
+
+unittest("Json parser: strings point into the text")
+{
+  auto const text = "{ \"name\" : \"hello\", \"escaped\" : \"a\\\"b\" }";
+  auto o = jsonParse(text);
+
+  auto const& name = o["name"].stringValue;
+  assertTrue(name.data > text && name.data < text + strlen(text));
+  assertEquals("hello", name);
+
+  // copied, without the backslash
+  assertEquals("a\"b", o["escaped"].stringValue);
+}
+
+unittest("Json parser: members are found whatever their order")
+{
+  auto o = jsonParse("{ \"z\": 1, \"a\": 2, \"m\": { \"y\": [ 3, 4, { \"x\": 5 } ] }, \"b\": 6, \"a\": 7 }");
+  assertEquals(4u, o.members.size());
+  assertEquals(1, (int)o["z"]);
+  assertEquals(6, (int)o["b"]);
+
+  // the last one wins
+  assertEquals(7, (int)o["a"]);
+
+  auto& y = o["m"]["y"];
+  assertEquals(3u, y.elements.size());
+  assertEquals(4, (int)y[1]);
+  assertEquals(5, (int)y[2]["x"]);
+
+  assertThrown(o["missing"]);
+}
@@ -0,0 +1,116 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/render/lightmap.h"
+#include "tests.h"
+
+namespace
+{
+void addTriangle(SingleRenderMesh& single, Vector3f a, Vector3f b, Vector3f c)
+{
+  for(auto p : { a, b, c })
+  {
+    SingleRenderMesh::Vertex v {};
+    v.x = p.x;
+    v.y = p.y;
+    v.z = p.z;
+    v.nz = 1;
+    single.vertices.push_back(packVertex(v));
+  }
+}
+
+// a 4x4 floor, in two single meshes
+RenderMesh createFloor()
+{
+  RenderMesh r;
+  r.singleMeshes.resize(2);
+  addTriangle(r.singleMeshes[0], Vector3f(0, 0, 0), Vector3f(4, 0, 0), Vector3f(4, 4, 0));
+  addTriangle(r.singleMeshes[1], Vector3f(0, 0, 0), Vector3f(4, 4, 0), Vector3f(0, 4, 0));
+  return r;
+}
+
+bool overlap(LightmapAtlas::Chart const& a, LightmapAtlas::Chart const& b)
+{
+  return a.pos.x < b.pos.x + b.size.width && b.pos.x < a.pos.x + a.size.width
+         && a.pos.y < b.pos.y + b.size.height && b.pos.y < a.pos.y + a.size.height;
+}
+}
+
+unittest("Lightmap: pack")
+{
+  auto mesh = createFloor();
+  auto const atlas = packLightmap(mesh, 4, 512);
+
+  assertEquals(2, (int)atlas.charts.size());
+  assertTrue(!overlap(atlas.charts[0], atlas.charts[1]));
+
+  for(auto& chart : atlas.charts)
+  {
+    assertTrue(chart.pos.x >= 0 && chart.pos.x + chart.size.width <= atlas.size.width);
+    assertTrue(chart.pos.y >= 0 && chart.pos.y + chart.size.height <= atlas.size.height);
+  }
+
+  // the UVs of each triangle are inside its chart
+  for(auto& chart : atlas.charts)
+  {
+    for(int k = 0; k < 3; ++k)
+    {
+      auto const v = unpackVertex(mesh.singleMeshes[chart.single].vertices[chart.first + k]);
+      auto const x = v.lightmap_u * atlas.size.width;
+      auto const y = v.lightmap_v * atlas.size.height;
+      assertTrue(x > chart.pos.x && x < chart.pos.x + chart.size.width);
+      assertTrue(y > chart.pos.y && y < chart.pos.y + chart.size.height);
+    }
+  }
+}
+
+unittest("Lightmap: pack, lower density when too big")
+{
+  auto mesh = createFloor();
+  auto const atlas = packLightmap(mesh, 100, 64);
+
+  assertTrue(atlas.size.width <= 64);
+  assertTrue(atlas.size.height <= 64);
+}
+
+unittest("Lightmap: bake")
+{
+  auto mesh = createFloor();
+  auto const atlas = packLightmap(mesh, 4, 512);
+
+  auto getTexel = [&] (Picture const& pic, Vector2f pos)
+    {
+      return (int)pic.pixels[((int)pos.x + (int)pos.y * pic.stride) * 4];
+    };
+
+  // nothing in the way
+  {
+    auto const pic = bakeLightmap(mesh, atlas, [] (Vector3f, Vector3f) { return true; }, 2);
+    assertEquals(atlas.size.width, pic.dim.width);
+    assertEquals(255, getTexel(pic, atlas.charts[0].corners[0]));
+  }
+
+  // a ceiling at z=1, over the half x < 2 of the floor
+  {
+    auto ceiling = [] (Vector3f a, Vector3f b)
+      {
+        if(b.z < 1)
+          return true;
+
+        auto const t = (1 - a.z) / (b.z - a.z);
+        return a.x + (b.x - a.x) * t >= 2;
+      };
+
+    auto const pic = bakeLightmap(mesh, atlas, ceiling, 2);
+
+    auto& chart = atlas.charts[1]; // (0, 0), (4, 4), (0, 4)
+    auto const underCeiling = getTexel(pic, chart.corners[2] * 0.9 + chart.corners[1] * 0.1);
+    auto const inTheOpen = getTexel(pic, chart.corners[1] * 0.9 + chart.corners[2] * 0.1);
+
+    assertTrue(underCeiling < 64);
+    assertTrue(inTheOpen > 128);
+  }
+}
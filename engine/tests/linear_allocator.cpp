@@ -0,0 +1,68 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "base/linear_allocator.h"
+#include "tests.h"
+#include <cstring> // strcmp
+using namespace std;
+
+unittest("LinearAllocator: strings")
+{
+  LinearAllocator allocator(16);
+
+  auto a = allocator.copy("hello");
+  auto b = allocator.format("%d frames, %.1f ms", 42, 1.5);
+  auto c = allocator.copy("abcdef", 3);
+
+  assertTrue(!strcmp("hello", a));
+  assertTrue(!strcmp("42 frames, 1.5 ms", b));
+  assertTrue(!strcmp("abc", c));
+}
+
+unittest("LinearAllocator: alignment")
+{
+  LinearAllocator allocator(64);
+  allocator.allocate(1, 1);
+
+  auto d = allocator.allocate<double>(3);
+  assertEquals(0, int((uintptr_t)d % alignof(double)));
+
+  auto big = allocator.allocate(1000);
+  assertEquals(0, int((uintptr_t)big % alignof(max_align_t)));
+}
+
+unittest("LinearAllocator: steady frames keep their memory")
+{
+  auto frame = [] (LinearAllocator& allocator)
+    {
+      allocator.reset();
+
+      for(int i = 0; i < 100; ++i)
+        allocator.format("line %d of the debug overlay", i);
+    };
+
+  auto const before = getMemoryUsage(MemoryTag::Transient).bytes;
+
+  {
+    LinearAllocator allocator(64);
+
+    // the first frame grows it, chunk after chunk
+    frame(allocator);
+    frame(allocator);
+
+    auto const capacity = allocator.getCapacity();
+    assertTrue(capacity >= 100 * 30);
+    assertEquals(before + capacity, getMemoryUsage(MemoryTag::Transient).bytes);
+
+    // then it fits in one chunk
+    for(int i = 0; i < 10; ++i)
+      frame(allocator);
+
+    assertEquals(capacity, allocator.getCapacity());
+  }
+
+  assertEquals(before, getMemoryUsage(MemoryTag::Transient).bytes);
+}
@@ -0,0 +1,84 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/render/matrix4.h"
+#include "tests.h"
+#include <cmath>
+
+namespace
+{
+Matrix4f referenceProduct(Matrix4f const& A, Matrix4f const& B)
+{
+  Matrix4f r(0);
+
+  for(int row = 0; row < 4; ++row)
+    for(int col = 0; col < 4; ++col)
+    {
+      double sum = 0;
+
+      for(int k = 0; k < 4; ++k)
+        sum += A[k][row] * B[col][k];
+
+      r[col][row] = sum;
+    }
+
+  return r;
+}
+
+Matrix4f makeMatrix(float seed)
+{
+  Matrix4f r(0);
+
+  for(int col = 0; col < 4; ++col)
+    for(int row = 0; row < 4; ++row)
+      r[col][row] = sin(seed + col * 4 + row) * 10;
+
+  return r;
+}
+
+float maxDifference(Matrix4f const& a, Matrix4f const& b)
+{
+  float r = 0;
+
+  for(int col = 0; col < 4; ++col)
+    for(int row = 0; row < 4; ++row)
+      r = fmax(r, fabs(a[col][row] - b[col][row]));
+
+  return r;
+}
+}
+
+unittest("Matrix4: product")
+{
+  for(int i = 0; i < 10; ++i)
+  {
+    auto const A = makeMatrix(i);
+    auto const B = makeMatrix(i * 7 + 3);
+    assertTrue(maxDifference(referenceProduct(A, B), A * B) < 1e-3);
+  }
+}
+
+unittest("Matrix4: transform")
+{
+  auto const pos = Vector3f(1, -2, 3);
+  auto const size = Vector3f(2, 3, 0.5);
+  auto const orientation = Quaternion::fromEuler(0.3, -1.2, 2.0);
+
+  auto const expected = translate(pos) * quaternionToMatrix(orientation) * scale(size);
+  assertTrue(maxDifference(expected, transform(pos, orientation, size)) < 1e-5);
+}
+
+unittest("Quaternion: rotate")
+{
+  auto const v = Vector3f(0.5, 2, -3);
+
+  for(auto q : { Quaternion::fromEuler(0.3, -1.2, 2.0), Quaternion::rotation(Vector3f(0, 0, 1), 1.0), Quaternion { Vector3f(1, 2, 3), 4 } })
+  {
+    auto const expected = (q * Quaternion { v, 0 } *q.conjugate()).v;
+    auto const delta = q.rotate(v) - expected;
+    assertTrue(dotProduct(delta, delta) < 1e-6);
+  }
+}
@@ -0,0 +1,43 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "base/memory.h"
+#include "tests.h"
+#include <utility> // move
+using namespace std;
+
+unittest("Memory: tracked bytes follow their owner")
+{
+  auto const before = getMemoryUsage(MemoryTag::Physics).bytes;
+
+  {
+    TrackedMemory a(MemoryTag::Physics, 100);
+    assertEquals(before + 100, getMemoryUsage(MemoryTag::Physics).bytes);
+
+    a.set(40);
+    assertEquals(before + 40, getMemoryUsage(MemoryTag::Physics).bytes);
+
+    TrackedMemory b(a);
+    assertEquals(before + 80, getMemoryUsage(MemoryTag::Physics).bytes);
+
+    TrackedMemory c(move(b));
+    assertEquals(0, (int)b.get());
+    assertEquals(before + 80, getMemoryUsage(MemoryTag::Physics).bytes);
+  }
+
+  assertEquals(before, getMemoryUsage(MemoryTag::Physics).bytes);
+}
+
+unittest("Memory: peak")
+{
+  auto const before = getMemoryUsage(MemoryTag::Sounds).bytes;
+
+  trackMemory(MemoryTag::Sounds, 1000);
+  trackMemory(MemoryTag::Sounds, -1000);
+
+  assertEquals(before, getMemoryUsage(MemoryTag::Sounds).bytes);
+  assertTrue(getMemoryUsage(MemoryTag::Sounds).peak >= before + 1000);
+}
@@ -0,0 +1,74 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/include/base/mesh.h"
+#include "engine/src/misc/file.h"
+#include "tests.h"
+#include <cstdio> // remove
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace
+{
+vector<Mesh> importText(string const& text)
+{
+  auto const path = "mesh_import_test.txt";
+  File::write(path, { (uint8_t const*)text.data(), (int)text.size() });
+
+  try
+  {
+    auto r = importMesh(path);
+    remove(path);
+    return r;
+  }
+  catch(...)
+  {
+    remove(path);
+    throw;
+  }
+}
+}
+
+unittest("MeshImport: vertices")
+{
+  auto const meshes = importText(
+    "material: \"Stone\"\n"
+    "diffuse: \"stone.png\"\n"
+    "\n"
+    "obj: \"Wall\"\n"
+    "material: \"Stone\"\n"
+    "1.5 -2 0.000125 - 0.0 -1.0 0.5 - 1e-05 2.5E+2\n"
+    "-0.5 3 4 - 1 0 0 - 0 1\n"
+    "+7 .25 8. - 0 1 0 - 0.1 0.2"); // no final EOL
+
+  assertEquals(1u, meshes.size());
+
+  auto& mesh = meshes[0];
+  assertEquals("Wall", mesh.name);
+  assertEquals("stone.png", mesh.material);
+  assertEquals(3u, mesh.vertices.size());
+  assertEquals(1u, mesh.faces.size());
+
+  assertEquals(1.5f, mesh.vertices[0].x);
+  assertEquals(-2.0f, mesh.vertices[0].y);
+  assertEquals(0.000125f, mesh.vertices[0].z);
+  assertEquals(-1.0f, mesh.vertices[0].ny);
+  assertEquals(1e-05f, mesh.vertices[0].u);
+  assertEquals(250.0f, mesh.vertices[0].v);
+  assertEquals(-0.5f, mesh.vertices[1].x);
+  assertEquals(7.0f, mesh.vertices[2].x);
+  assertEquals(0.25f, mesh.vertices[2].y);
+  assertEquals(8.0f, mesh.vertices[2].z);
+  assertEquals(0.1f, mesh.vertices[2].u);
+}
+
+unittest("MeshImport: invalid vertex lines are rejected")
+{
+  assertThrown(importText("obj: \"A\"\n1 2 3 - 4 5 6 - 7\n"));
+  assertThrown(importText("obj: \"A\"\n1 2 3 4 5 6 7 8\n"));
+  assertThrown(importText("obj: \"A\"\n1 2 3 - 4 5 6 - 7 x\n"));
+}
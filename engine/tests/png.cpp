@@ -6,6 +6,8 @@
 
 #include "engine/src/render/png.h"
 #include "tests.h"
+#include <algorithm> // min
+#include <cstdlib> // abs
 #include <vector>
 using namespace std;
 
@@ -57,3 +59,159 @@ unittest("PNG: simple")
   assertEquals(0xFF, (int)pic[bpp * (W * H - 1) + 3]);
 }
 
+
+unittest("PNG: encode")
+{
+  auto const W = 300;
+  auto const H = 257; // more than one stored block
+
+  vector<uint8_t> pixels(W * H * 4);
+
+  for(int i = 0; i < (int)pixels.size(); ++i)
+    pixels[i] = (i * 7 + i / 1000) & 0xff;
+
+  auto const png = encodePng({ pixels.data(), (int)pixels.size() }, W, H);
+
+  int width = 0, height = 0;
+  auto const decoded = decodePng({ png.data(), (int)png.size() }, width, height);
+  assertEquals(W, width);
+  assertEquals(H, height);
+  assertTrue(decoded == pixels);
+}
+
+namespace
+{
+void write32(vector<uint8_t>& out, uint32_t value)
+{
+  for(int shift = 24; shift >= 0; shift -= 8)
+    out.push_back((value >> shift) & 0xff);
+}
+
+// the CRC is ignored by the decoder
+void writeChunk(vector<uint8_t>& out, const char* type, vector<uint8_t> const& data)
+{
+  write32(out, data.size());
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  write32(out, 0);
+}
+
+int paeth(int a, int b, int c)
+{
+  auto const p = a + b - c;
+  auto const pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  return (pa <= pb && pa <= pc) ? a : pb <= pc ? b : c;
+}
+
+// Line 'y' uses the filter 'y % 5', the compressed data is split in
+// several IDAT chunks of 'idatSize' bytes.
+vector<uint8_t> encodeFiltered(vector<uint8_t> const& pixels, int width, int height, int idatSize)
+{
+  auto const bpp = 4;
+  auto const stride = width * bpp;
+
+  vector<uint8_t> scanlines;
+
+  for(int y = 0; y < height; ++y)
+  {
+    auto const filter = y % 5;
+    scanlines.push_back(filter);
+
+    for(int i = 0; i < stride; ++i)
+    {
+      int const x = pixels[y * stride + i];
+      int const a = i >= bpp ? pixels[y * stride + i - bpp] : 0;
+      int const b = y > 0 ? pixels[(y - 1) * stride + i] : 0;
+      int const c = i >= bpp && y > 0 ? pixels[(y - 1) * stride + i - bpp] : 0;
+
+      int const predictors[] = { 0, a, b, (a + b) / 2, paeth(a, b, c) };
+      scanlines.push_back((x - predictors[filter]) & 0xff);
+    }
+  }
+
+  // zlib, stored blocks. The adler32 is ignored by the decoder.
+  vector<uint8_t> zlib = { 0x78, 0x01 };
+
+  for(size_t pos = 0; pos < scanlines.size();)
+  {
+    auto const len = min<size_t>(scanlines.size() - pos, 65535);
+    pos += len;
+    zlib.push_back(pos == scanlines.size() ? 1 : 0);
+    zlib.push_back(len & 0xff);
+    zlib.push_back(len >> 8);
+    zlib.push_back(~len & 0xff);
+    zlib.push_back((~len >> 8) & 0xff);
+    zlib.insert(zlib.end(), scanlines.begin() + pos - len, scanlines.begin() + pos);
+  }
+
+  write32(zlib, 0);
+
+  vector<uint8_t> r = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+
+  vector<uint8_t> header;
+  write32(header, width);
+  write32(header, height);
+  header.insert(header.end(), { 8, 6, 0, 0, 0 });
+  writeChunk(r, "IHDR", header);
+
+  for(size_t pos = 0; pos < zlib.size(); pos += idatSize)
+  {
+    auto const end = min(zlib.size(), pos + idatSize);
+    writeChunk(r, "IDAT", vector<uint8_t>(zlib.begin() + pos, zlib.begin() + end));
+  }
+
+  writeChunk(r, "IEND", {});
+  return r;
+}
+
+vector<uint8_t> makePixels(int width, int height)
+{
+  vector<uint8_t> pixels(width * height * 4);
+
+  for(int i = 0; i < (int)pixels.size(); ++i)
+    pixels[i] = (i * 37 + (i * i) / 13) & 0xff;
+
+  return pixels;
+}
+}
+
+unittest("PNG: all the filter types")
+{
+  for(auto width : { 1, 3, 5, 37 })
+  {
+    auto const height = 11;
+    auto const pixels = makePixels(width, height);
+    auto const png = encodeFiltered(pixels, width, height, 1 << 20);
+
+    int w = 0, h = 0;
+    auto const decoded = decodePng({ png.data(), (int)png.size() }, w, h);
+    assertEquals(width, w);
+    assertEquals(height, h);
+    assertTrue(decoded == pixels);
+  }
+}
+
+unittest("PNG: several IDAT chunks")
+{
+  auto const width = 19;
+  auto const height = 7;
+  auto const pixels = makePixels(width, height);
+  auto const png = encodeFiltered(pixels, width, height, 50);
+
+  int w = 0, h = 0;
+  auto const decoded = decodePng({ png.data(), (int)png.size() }, w, h);
+  assertTrue(decoded == pixels);
+}
+
+unittest("PNG: truncated image data")
+{
+  auto const width = 8;
+  auto const height = 8;
+  auto png = encodeFiltered(makePixels(width, height), width, height, 1 << 20);
+
+  // claim more lines than there are
+  png[16 + 7] = 9;
+
+  int w = 0, h = 0;
+  assertThrown(decodePng({ png.data(), (int)png.size() }, w, h));
+}
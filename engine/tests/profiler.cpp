@@ -0,0 +1,64 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "base/profiler.h"
+#include "tests.h"
+#include <string>
+#include <thread>
+using namespace std;
+
+namespace
+{
+int countOf(string const& s, string const& what)
+{
+  int r = 0;
+
+  for(auto i = s.find(what); i != string::npos; i = s.find(what, i + 1))
+    ++r;
+
+  return r;
+}
+}
+
+unittest("Profiler: records the scopes of all threads")
+{
+  startProfiling();
+  assertTrue(isProfiling());
+
+  {
+    ProfileScope outer("test_outer");
+    ProfileScope inner("test_inner");
+  }
+
+  thread worker([] ()
+    {
+      setProfilerThreadName("test_worker");
+      ProfileScope scope("test_on_worker");
+    });
+  worker.join();
+
+  auto const trace = stopProfiling();
+  assertTrue(!isProfiling());
+
+  assertTrue(trace.find("{\"traceEvents\":[") == 0);
+  assertEquals(1, countOf(trace, "\"name\":\"test_outer\""));
+  assertEquals(1, countOf(trace, "\"name\":\"test_inner\""));
+  assertEquals(1, countOf(trace, "\"name\":\"test_on_worker\""));
+  assertEquals(1, countOf(trace, "\"args\":{\"name\":\"test_worker\"}"));
+}
+
+unittest("Profiler: nothing is recorded outside of a capture")
+{
+  {
+    ProfileScope scope("test_not_captured");
+  }
+
+  startProfiling();
+
+  auto const trace = stopProfiling();
+  assertEquals(0, countOf(trace, "test_not_captured"));
+  assertEquals(0, countOf(trace, "\"ph\":\"X\""));
+}
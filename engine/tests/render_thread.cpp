@@ -0,0 +1,168 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/render/display.h"
+#include "engine/src/render/render_thread.h"
+#include "tests.h"
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace
+{
+// Checks the context is current on one thread at most, and only used there.
+struct ContextDisplay : Display
+{
+  ContextDisplay()
+  {
+    owner = this_thread::get_id();
+  }
+
+  void acquireContext() override
+  {
+    lock_guard<mutex> guard(lock);
+
+    if(owner != thread::id())
+      errors++;
+
+    owner = this_thread::get_id();
+  }
+
+  void releaseContext() override
+  {
+    lock_guard<mutex> guard(lock);
+
+    if(owner != this_thread::get_id())
+      errors++;
+
+    owner = thread::id();
+  }
+
+  // the other calls must come from the owner
+  void use()
+  {
+    lock_guard<mutex> guard(lock);
+
+    if(owner != this_thread::get_id())
+      errors++;
+  }
+
+  void setFullscreen(bool) override { use(); }
+  void setHdr(bool) override { use(); }
+  void setFsaa(bool) override { use(); }
+  void setDepthPrepass(bool) override { use(); }
+  void setOcclusionCulling(bool) override { use(); }
+  void setDynamicResolution(float, float, float) override { use(); }
+  void setCaption(const char*) override { use(); }
+  void loadModel(int, const char*) override { use(); }
+  void loadModels(Span<const Resource>, ThreadPool&) override { use(); }
+  bool loadModelInBackground(int, const char*, ThreadPool&) override { use(); return true; }
+  void unloadModel(int) override { use(); }
+  void setMemoryBudget(int64_t) override { use(); }
+  void setCamera(Vector3f, Quaternion) override { use(); }
+  void setAmbientLight(float) override { use(); }
+  void readPixels(Span<uint8_t>) override { use(); }
+  void captureFrame(CaptureCallback const&) override { use(); }
+  void flushCaptures(CaptureCallback const&) override { use(); }
+  Span<const PassTiming> getGpuTimings() override { use(); return {}; }
+  void enableGrab(bool) override { use(); }
+  bool isVsynced() override { use(); return false; }
+  void beginDraw() override { use(); }
+  void endDraw() override { use(); }
+  void drawActor(Rect3f, Quaternion, int, bool, int, float) override { use(); }
+  void drawParticles(int, Span<const Rect3f>) override { use(); }
+  void drawText(Vector2f, char const*) override { use(); }
+
+  mutex lock;
+  thread::id owner;
+  int errors = 0;
+};
+}
+
+unittest("RenderThread: draws the frames in order")
+{
+  ContextDisplay display;
+  vector<int> drawn;
+  int building = 0;
+  int submitted = 0;
+
+  {
+    RenderThread renderThread(&display,
+                              [&] ()
+      {
+        display.beginDraw();
+        drawn.push_back(submitted);
+        display.endDraw();
+      });
+
+    for(int i = 0; i < 100; ++i)
+    {
+      building = i;
+      renderThread.submit([&] () { submitted = building; });
+    }
+  }
+
+  assertEquals(100, (int)drawn.size());
+
+  for(int i = 0; i < 100; ++i)
+    assertEquals(i, drawn[i]);
+
+  // given back on destruction
+  assertTrue(display.owner == this_thread::get_id());
+  assertEquals(0, display.errors);
+}
+
+unittest("RenderThread: exclusive runs on the caller, with the context")
+{
+  ContextDisplay display;
+  atomic<int> frames { 0 };
+  int loads = 0;
+
+  {
+    RenderThread renderThread(&display, [&] () { display.endDraw(); frames++; });
+
+    for(int i = 0; i < 50; ++i)
+    {
+      renderThread.submit([] () {});
+      renderThread.exclusive([&] () { display.loadModel(0, "model"); loads++; });
+    }
+  }
+
+  assertEquals(50, (int)frames);
+  assertEquals(50, loads);
+  assertEquals(0, display.errors);
+}
+
+unittest("RenderThread: render errors are thrown on the game thread")
+{
+  ContextDisplay display;
+  RenderThread renderThread(&display, [] () { throw runtime_error("lost context"); });
+
+  renderThread.submit([] () {});
+
+  // the error is seen once the frame is drawn
+  assertThrown(
+  {
+    renderThread.submit([] () {});
+    renderThread.submit([] () {});
+  });
+}
+
+unittest("RenderThread: without a thread, draws right away")
+{
+  ContextDisplay display;
+  int frames = 0;
+
+  RenderThread renderThread(&display, [&] () { display.endDraw(); frames++; }, false);
+  renderThread.submit([] () {});
+  assertEquals(1, frames);
+
+  renderThread.exclusive([&] () { display.setHdr(true); });
+  assertEquals(0, display.errors);
+}
@@ -0,0 +1,180 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/render/rendermesh.h"
+#include "tests.h"
+#include <cmath> // abs
+#include <stdexcept>
+using namespace std;
+
+namespace
+{
+// two cells side by side, one triangle in each
+RenderMesh makeMesh()
+{
+  RenderMesh mesh;
+  mesh.singleMeshes.resize(1);
+  mesh.singleMeshes[0].vertices.resize(6);
+  mesh.singleMeshes[0].indices = { 0, 1, 2, 3, 4, 5 };
+  mesh.singleMeshes[0].ranges.push_back({ 0, 0, 3 });
+  mesh.singleMeshes[0].ranges.push_back({ 1, 3, 3 });
+
+  auto& vis = mesh.visibility;
+  vis.origin = Vector3f(-1, 0, 0);
+  vis.cellSize = 2;
+  vis.dims[0] = 2;
+  vis.dims[1] = 1;
+  vis.dims[2] = 1;
+  vis.visibleCells = { { 0, 1 }, { 1 } };
+
+  return mesh;
+}
+}
+
+unittest("RenderMesh: visibility round trip")
+{
+  auto const data = serializeVisibility(makeMesh());
+
+  RenderMesh mesh;
+  mesh.singleMeshes.resize(1);
+  mesh.singleMeshes[0].indices.resize(6);
+  deserializeVisibility(data, mesh);
+
+  assertEquals(2, mesh.visibility.cellSize);
+  assertEquals(2u, mesh.singleMeshes[0].ranges.size());
+  assertEquals(1, mesh.singleMeshes[0].ranges[1].cell);
+  assertEquals(3, mesh.singleMeshes[0].ranges[1].first);
+  assertEquals(2u, mesh.visibility.visibleCells[0].size());
+  assertEquals(1u, mesh.visibility.visibleCells[1].size());
+}
+
+unittest("RenderMesh: visibility of another mesh is rejected")
+{
+  auto const data = serializeVisibility(makeMesh());
+
+  RenderMesh mesh;
+  mesh.singleMeshes.resize(1);
+  mesh.singleMeshes[0].indices.resize(3); // too short for the ranges
+
+  assertThrown(deserializeVisibility(data, mesh));
+  assertEquals(0, mesh.visibility.cellSize);
+}
+
+unittest("RenderMesh: visibility cell of a point")
+{
+  auto const vis = makeMesh().visibility;
+
+  assertEquals(0, vis.getCell(Vector3f(-0.5, 1, 1)));
+  assertEquals(1, vis.getCell(Vector3f(1.5, 1, 1)));
+  assertEquals(-1, vis.getCell(Vector3f(3.5, 1, 1)));
+  assertEquals(-1, vis.getCell(Vector3f(0, -1, 1)));
+}
+
+unittest("RenderMesh: packed vertex round trip")
+{
+  SingleRenderMesh::Vertex v {};
+  v.x = 1.5;
+  v.y = -200;
+  v.z = 3;
+  v.nx = 0.6;
+  v.ny = 0;
+  v.nz = -0.8;
+  v.diffuse_u = 4.25;
+  v.diffuse_v = -0.5;
+  v.lightmap_u = 0.25;
+  v.lightmap_v = 1;
+
+  auto const r = unpackVertex(packVertex(v));
+
+  assertEquals(1.5f, r.x);
+  assertEquals(-200.0f, r.y);
+  assertTrue(abs(r.nx - 0.6f) < 0.001);
+  assertTrue(abs(r.ny) < 0.001);
+  assertTrue(abs(r.nz + 0.8f) < 0.001);
+  assertEquals(4.25f, r.diffuse_u);
+  assertEquals(-0.5f, r.diffuse_v);
+  assertTrue(abs(r.lightmap_u - 0.25f) < 0.0001);
+  assertEquals(1.0f, r.lightmap_v);
+}
+
+unittest("RenderMesh: render mesh round trip")
+{
+  auto mesh = makeMesh();
+  mesh.singleMeshes[0].vertices[4].y = 7;
+
+  auto const r = deserializeRenderMesh(serializeRenderMesh(mesh));
+
+  assertEquals(1u, r.singleMeshes.size());
+  assertEquals(6u, r.singleMeshes[0].vertices.size());
+  assertEquals(7.0f, r.singleMeshes[0].vertices[4].y);
+  assertEquals(6u, r.singleMeshes[0].indices.size());
+  assertEquals(5u, r.singleMeshes[0].indices[5]);
+
+  assertThrown(deserializeRenderMesh("MESH"));
+
+  mesh.singleMeshes[0].indices[2] = 6; // out of the vertices
+  assertThrown(deserializeRenderMesh(serializeRenderMesh(mesh)));
+}
+
+unittest("RenderMesh: the parsed arrays point into the file")
+{
+  auto mesh = makeMesh();
+  mesh.singleMeshes[0].vertices[4].y = 7;
+  mesh.singleMeshes[0].vertices[5].x = -3;
+
+  auto const data = serializeRenderMesh(mesh);
+  auto const bytes = Span<const uint8_t>((uint8_t const*)data.data(), (int)data.size());
+  auto const view = parseRenderMesh(bytes);
+
+  assertEquals(1u, view.singleMeshes.size());
+
+  auto& single = view.singleMeshes[0];
+  assertEquals(6, single.vertices.len);
+  assertEquals(6, single.indices.len);
+  assertTrue((uint8_t const*)single.vertices.data > bytes.data);
+  assertTrue((uint8_t const*)(single.indices.data + single.indices.len) == bytes.data + bytes.len);
+  assertEquals(7.0f, single.boundsMax.y);
+  assertEquals(-3.0f, single.boundsMin.x);
+
+  assertThrown(parseRenderMesh(Span<const uint8_t>(bytes.data, bytes.len - 1)));
+}
+
+unittest("RenderMesh: levels of detail round trip")
+{
+  auto mesh = makeMesh();
+  mesh.lodErrors = { 0, 0.5 };
+  mesh.singleMeshes[0].lods = { { -1, 0, 3 }, { -1, 3, 3 } };
+
+  auto const r = deserializeRenderMesh(serializeRenderMesh(mesh));
+
+  assertEquals(2u, r.lodErrors.size());
+  assertEquals(0.5f, r.lodErrors[1]);
+  assertEquals(2u, r.singleMeshes[0].lods.size());
+  assertEquals(3, r.singleMeshes[0].lods[1].first);
+  assertEquals(3, r.singleMeshes[0].lods[1].count);
+
+  mesh.singleMeshes[0].lods[1].count = 6; // out of the indices
+  assertThrown(deserializeRenderMesh(serializeRenderMesh(mesh)));
+}
+
+unittest("RenderMesh: level of detail, with hysteresis")
+{
+  RenderMesh mesh;
+  assertEquals(0, mesh.selectLod(1, 0));
+
+  // errors of 1 and 4 units: at most a pixel at 1 and 0.25 pixels per unit
+  mesh.lodErrors = { 0, 1, 4 };
+  assertEquals(0, mesh.selectLod(10, 0));
+  assertEquals(2, mesh.selectLod(0.1, 0));
+
+  // going coarser takes a margin
+  assertEquals(0, mesh.selectLod(0.9, 0));
+  assertEquals(1, mesh.selectLod(0.7, 0));
+
+  // so does going finer
+  assertEquals(1, mesh.selectLod(1.1, 1));
+  assertEquals(0, mesh.selectLod(1.5, 1));
+}
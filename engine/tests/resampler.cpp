@@ -0,0 +1,133 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/audio/resampler.h"
+#include "engine/tests/tests.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+// stereo: a sine on the left, its opposite on the right
+struct SineSound : Sound
+{
+  SineSound(int rate_, double frequency, int frames) : rate(rate_)
+  {
+    for(int i = 0; i < frames; ++i)
+    {
+      auto const val = float(0.5 * sin(2 * M_PI * frequency * i / rate));
+      samples.push_back(val);
+      samples.push_back(-val);
+    }
+  }
+
+  struct Source : IAudioSource
+  {
+    Source(vector<float> const& samples_) : samples(samples_) {}
+
+    int read(Span<float> output) override
+    {
+      auto const n = min(output.len, int(samples.size()) - pos);
+
+      for(int i = 0; i < n; ++i)
+        output.data[i] = samples[pos + i];
+
+      pos += n;
+      return n;
+    }
+
+    vector<float> const& samples;
+    int pos = 0;
+  };
+
+  unique_ptr<IAudioSource> createSource() override
+  {
+    return make_unique<Source>(samples);
+  }
+
+  int getSampleRate() const override
+  {
+    return rate;
+  }
+
+  int const rate;
+  vector<float> samples;
+};
+
+vector<float> readAll(IAudioSource& source)
+{
+  vector<float> r;
+  float block[100];
+
+  while(auto const n = source.read(block))
+    r.insert(r.end(), block, block + n);
+
+  return r;
+}
+
+int countRisingZeroCrossings(vector<float> const& samples, int channel, int begin, int end)
+{
+  int r = 0;
+
+  for(int i = begin + 1; i < end; ++i)
+    if(samples[(i - 1) * 2 + channel] < 0 && samples[i * 2 + channel] >= 0)
+      ++r;
+
+  return r;
+}
+}
+
+unittest("Resampler: same rate plays as is")
+{
+  SineSound sound(48000, 1000, 480);
+  ResamplingSource source(&sound, sound.createSource(), 48000);
+
+  auto const output = readAll(source);
+  assertEquals(sound.samples.size(), output.size());
+  assertTrue(output == sound.samples);
+}
+
+unittest("Resampler: keeps the length")
+{
+  SineSound sound(22050, 440, 22050);
+  ResamplingSource source(&sound, sound.createSource(), 48000);
+
+  auto const frames = int(readAll(source).size() / 2);
+  assertTrue(abs(frames - 48000) <= 2);
+}
+
+unittest("Resampler: keeps the pitch and the volume, of both channels")
+{
+  SineSound sound(22050, 441, 22050);
+  ResamplingSource source(&sound, sound.createSource(), 48000);
+
+  auto const output = readAll(source);
+
+  // one second: away from the edges
+  auto const begin = 1000;
+  auto const end = 1000 + 48000 / 2;
+  assertEquals(441 / 2, countRisingZeroCrossings(output, 0, begin, end));
+
+  float peak = 0;
+
+  for(int i = begin; i < end; ++i)
+  {
+    peak = max(peak, output[i * 2]);
+    assertTrue(fabs(output[i * 2] + output[i * 2 + 1]) < 1e-5);
+  }
+
+  assertTrue(fabs(peak - 0.5f) < 0.01);
+}
+
+unittest("Resampler: downsampling")
+{
+  SineSound sound(48000, 1000, 48000);
+  ResamplingSource source(&sound, sound.createSource(), 22050);
+
+  auto const output = readAll(source);
+  assertTrue(abs(int(output.size() / 2) - 22050) <= 2);
+  assertEquals(500, countRisingZeroCrossings(output, 0, 100, 100 + 22050 / 2));
+}
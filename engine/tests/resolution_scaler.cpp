@@ -0,0 +1,70 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/render/resolution_scaler.h"
+#include "tests.h"
+
+namespace
+{
+// a GPU whose frame time is proportional to the pixel count
+void runFrames(ResolutionScaler& s, int count, float fullScaleMs)
+{
+  for(int i = 0; i < count; ++i)
+    s.update(fullScaleMs * s.scale * s.scale);
+}
+}
+
+unittest("ResolutionScaler: disabled")
+{
+  ResolutionScaler s;
+  s.maxScale = 0.75;
+  runFrames(s, 100, 50);
+  assertEquals(0.75f, s.scale);
+}
+
+unittest("ResolutionScaler: stays at full scale on a fast GPU")
+{
+  ResolutionScaler s;
+  s.targetMs = 16;
+  runFrames(s, 200, 5);
+  assertEquals(1.0f, s.scale);
+}
+
+unittest("ResolutionScaler: meets the target on a slow GPU")
+{
+  ResolutionScaler s;
+  s.targetMs = 16;
+  runFrames(s, 500, 32);
+
+  auto const ms = 32 * s.scale * s.scale;
+  assertTrue(ms <= 16);
+  assertTrue(ms >= 16 * 0.8);
+}
+
+unittest("ResolutionScaler: bounded")
+{
+  ResolutionScaler s;
+  s.targetMs = 16;
+  s.minScale = 0.6;
+  runFrames(s, 500, 1000);
+  assertEquals(0.6f, s.scale);
+
+  // and comes back up when the load goes away
+  runFrames(s, 1000, 4);
+  assertEquals(1.0f, s.scale);
+}
+
+unittest("ResolutionScaler: unknown timings")
+{
+  ResolutionScaler s;
+  s.targetMs = 16;
+  s.scale = 0.8;
+
+  for(int i = 0; i < 100; ++i)
+    s.update(-1);
+
+  assertEquals(0.8f, s.scale);
+}
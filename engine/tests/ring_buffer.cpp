@@ -0,0 +1,88 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/audio/ring_buffer.h"
+#include "tests.h"
+#include <thread>
+#include <vector>
+using namespace std;
+
+unittest("RingBuffer: first in, first out, across the end")
+{
+  RingBuffer<int> ring(5);
+  assertEquals(8, ring.capacity());
+
+  int out[8] {};
+
+  for(int round = 0; round < 5; ++round)
+  {
+    int const in[] = { round * 10 + 1, round * 10 + 2, round * 10 + 3, round * 10 + 4, round * 10 + 5 };
+    assertEquals(5, ring.write(in));
+    assertEquals(5, ring.readable());
+
+    assertEquals(5, ring.read(out));
+    assertEquals(round * 10 + 1, out[0]);
+    assertEquals(round * 10 + 5, out[4]);
+    assertEquals(0, ring.readable());
+  }
+}
+
+unittest("RingBuffer: full and empty")
+{
+  RingBuffer<int> ring(4);
+
+  int const in[] = { 1, 2, 3, 4, 5, 6 };
+  assertEquals(4, ring.write(in));
+  assertEquals(0, ring.writable());
+  assertEquals(0, ring.write(in));
+
+  int out[6] {};
+  assertEquals(4, ring.read(out));
+  assertEquals(4, out[3]);
+  assertEquals(0, ring.read(out));
+}
+
+unittest("RingBuffer: one producer thread, one consumer thread")
+{
+  auto const N = 7 * 10000;
+  RingBuffer<int> ring(64);
+
+  thread producer([&] ()
+    {
+      int next = 0;
+
+      while(next < N)
+      {
+        int block[7];
+
+        for(auto& val : block)
+          val = next++;
+
+        Span<const int> data = block;
+
+        while(data.len > 0)
+          data += ring.write(data);
+      }
+    });
+
+  vector<int> received;
+
+  while((int)received.size() < N)
+  {
+    int block[5];
+    auto const n = ring.read(block);
+    received.insert(received.end(), block, block + n);
+  }
+
+  producer.join();
+
+  bool inOrder = true;
+
+  for(int i = 0; i < N; ++i)
+    inOrder &= received[i] == i;
+
+  assertTrue(inOrder);
+}
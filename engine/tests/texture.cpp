@@ -0,0 +1,199 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/render/texture.h"
+#include "tests.h"
+#include <cstdlib> // abs
+#include <stdexcept>
+using namespace std;
+
+namespace
+{
+// smooth gradients, with a hard edge in the middle
+Picture makePicture(int width, int height, bool alpha)
+{
+  Picture pic;
+  pic.dim = Size2i(width, height);
+  pic.stride = width;
+  pic.pixels.resize(width * height * 4);
+
+  for(int y = 0; y < height; ++y)
+  {
+    for(int x = 0; x < width; ++x)
+    {
+      auto pel = &pic.pixels[(x + y * width) * 4];
+      pel[0] = x * 255 / width;
+      pel[1] = y * 255 / height;
+      pel[2] = x < width / 2 ? 40 : 200;
+      pel[3] = alpha ? (x + y) * 255 / (width + height) : 255;
+    }
+  }
+
+  return pic;
+}
+
+int maxError(Picture const& a, Picture const& b)
+{
+  int r = 0;
+
+  for(int i = 0; i < (int)a.pixels.size(); ++i)
+    r = max(r, abs(a.pixels[i] - b.pixels[i]));
+
+  return r;
+}
+
+int averageError(Picture const& a, Picture const& b)
+{
+  int sum = 0;
+
+  for(int i = 0; i < (int)a.pixels.size(); ++i)
+    sum += abs(a.pixels[i] - b.pixels[i]);
+
+  return sum / (int)a.pixels.size();
+}
+}
+
+unittest("Texture: image bytes")
+{
+  assertEquals(64 * 4, getImageBytes(TextureFormat::Rgba8, Size2i(8, 8)));
+  assertEquals(4 * 8, getImageBytes(TextureFormat::Bc1, Size2i(8, 8)));
+  assertEquals(4 * 16, getImageBytes(TextureFormat::Etc2Rgba, Size2i(8, 8)));
+
+  // partial blocks are padded
+  assertEquals(8, getImageBytes(TextureFormat::Etc2Rgb, Size2i(1, 1)));
+  assertEquals(6 * 16, getImageBytes(TextureFormat::Bc3, Size2i(9, 5)));
+}
+
+unittest("Texture: mipmap chain")
+{
+  auto pic = makePicture(16, 4, false);
+  auto const tex = compressTexture(pic, TextureFormat::Bc1);
+
+  // 16x4, 8x2, 4x1, 2x1, 1x1
+  assertEquals(5, (int)tex.levels.size());
+  assertEquals(getImageBytes(TextureFormat::Bc1, Size2i(2, 1)), (int)tex.levels[3].size());
+
+  auto const last = decompressTexture(tex, 4);
+  assertEquals(1, last.dim.width);
+  assertEquals(1, last.dim.height);
+}
+
+unittest("Texture: gamma correct mipmaps")
+{
+  // black and white stripes
+  auto pic = makePicture(4, 4, false);
+
+  for(int i = 0; i < 16; ++i)
+    for(int k = 0; k < 3; ++k)
+      pic.pixels[i * 4 + k] = (i % 2) ? 255 : 0;
+
+  auto const srgb = compressTexture(pic, TextureFormat::Rgba8);
+  auto const linear = compressTexture(pic, TextureFormat::Rgba8, false);
+
+  assertEquals(3, (int)srgb.levels.size());
+
+  // half the light, not half the encoded value
+  assertEquals(188, (int)srgb.levels[1][0]);
+  assertEquals(188, (int)srgb.levels[2][0]);
+  assertEquals(128, (int)linear.levels[1][0]);
+
+  // alpha stays linear
+  assertEquals(255, (int)srgb.levels[2][3]);
+}
+
+unittest("Texture: opaque formats roundtrip")
+{
+  auto pic = makePicture(32, 24, false);
+
+  for(auto format : { TextureFormat::Bc1, TextureFormat::Etc2Rgb })
+  {
+    auto result = decompressTexture(compressTexture(pic, format), 0);
+
+    assertEquals(32, result.dim.width);
+    assertEquals(24, result.dim.height);
+    assertTrue(averageError(pic, result) <= 4);
+    assertTrue(maxError(pic, result) <= 32);
+    assertTrue(!hasAlpha(result));
+  }
+}
+
+unittest("Texture: alpha formats roundtrip")
+{
+  auto pic = makePicture(32, 32, true);
+  assertTrue(hasAlpha(pic));
+
+  for(auto format : { TextureFormat::Bc3, TextureFormat::Etc2Rgba })
+  {
+    auto result = decompressTexture(compressTexture(pic, format), 0);
+
+    assertTrue(averageError(pic, result) <= 4);
+    assertTrue(maxError(pic, result) <= 32);
+
+    for(int i = 3; i < (int)pic.pixels.size(); i += 4)
+      assertTrue(abs(pic.pixels[i] - result.pixels[i]) <= 8);
+  }
+}
+
+unittest("Texture: flat colors are exact")
+{
+  auto pic = makePicture(8, 8, false);
+
+  for(auto& val : pic.pixels)
+    val = 255;
+
+  for(auto format : { TextureFormat::Bc1, TextureFormat::Bc3, TextureFormat::Etc2Rgb, TextureFormat::Etc2Rgba })
+    assertEquals(0, maxError(pic, decompressTexture(compressTexture(pic, format), 0)));
+}
+
+unittest("Texture: serialization")
+{
+  auto pic = makePicture(12, 8, true);
+  auto const tex = compressTexture(pic, TextureFormat::Etc2Rgba);
+  auto const data = serializeTexture(tex);
+  auto const loaded = deserializeTexture(data);
+
+  assertEquals((int)TextureFormat::Etc2Rgba, (int)loaded.format);
+  assertEquals(12, loaded.dim.width);
+  assertEquals(8, loaded.dim.height);
+  assertEquals((int)tex.levels.size(), (int)loaded.levels.size());
+  assertTrue(tex.levels == loaded.levels);
+
+  assertThrown(deserializeTexture(data.substr(0, data.size() - 1)));
+  assertThrown(deserializeTexture(data + "x"));
+  assertThrown(deserializeTexture("MESH" + data.substr(4)));
+}
+
+unittest("Texture: hasAlpha")
+{
+  Picture pic;
+  pic.dim = Size2i(4, 4);
+  pic.stride = 4;
+  pic.pixels.assign(4 * 4 * 4, 0xff);
+
+  assertTrue(!hasAlpha(toTexture(pic)));
+  assertTrue(!hasAlpha(compressTexture(pic, TextureFormat::Bc1)));
+  assertTrue(hasAlpha(compressTexture(pic, TextureFormat::Bc3)));
+
+  pic.pixels[4 * 5 + 3] = 0x80;
+  assertTrue(hasAlpha(toTexture(pic)));
+}
+
+unittest("Texture: hash")
+{
+  auto const pic = makePicture(8, 8, false);
+  auto const tex = toTexture(pic);
+
+  assertEquals(hashTexture(tex), hashTexture(toTexture(pic)));
+
+  auto other = tex;
+  other.levels[0][5] ^= 1;
+  assertTrue(hashTexture(tex) != hashTexture(other));
+
+  // same bytes, other format
+  other = tex;
+  other.format = TextureFormat::Bc3;
+  assertTrue(hashTexture(tex) != hashTexture(other));
+}
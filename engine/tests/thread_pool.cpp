@@ -0,0 +1,160 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "base/thread_pool.h"
+#include "tests.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace
+{
+vector<int> runAll(ThreadPool& pool, int count)
+{
+  vector<int> visits(count);
+  pool.parallelFor(count, [&] (int i) { visits[i]++; });
+  return visits;
+}
+}
+
+unittest("ThreadPool: visits each index once")
+{
+  ThreadPool pool(3);
+  assertEquals(vector<int>(1000, 1), runAll(pool, 1000));
+  assertEquals(vector<int>(7, 1), runAll(pool, 7));
+}
+
+unittest("ThreadPool: no work")
+{
+  ThreadPool pool(2);
+  assertEquals(vector<int>(), runAll(pool, 0));
+}
+
+unittest("ThreadPool: no workers runs on the caller")
+{
+  ThreadPool pool(0);
+  assertEquals(0, pool.getThreadCount());
+  assertEquals(vector<int>(100, 1), runAll(pool, 100));
+}
+
+unittest("ThreadPool: tasks run before the pool goes away")
+{
+  vector<int> done(10);
+
+  {
+    ThreadPool pool(2);
+
+    for(int i = 0; i < 10; ++i)
+      pool.run([&done, i] () { done[i] = 1; });
+  }
+
+  assertEquals(vector<int>(10, 1), done);
+}
+
+unittest("ThreadPool: without workers, tasks run right away")
+{
+  ThreadPool pool(0);
+  int done = 0;
+  pool.run([&] () { done = 1; });
+  assertEquals(1, done);
+}
+
+unittest("ThreadPool: wait for a counter")
+{
+  ThreadPool pool(2);
+  JobCounter counter;
+  vector<int> done(20);
+
+  for(int i = 0; i < 20; ++i)
+    pool.run([&done, i] () { done[i] = 1; }, &counter);
+
+  pool.wait(counter);
+  assertEquals(0, counter.pending.load());
+  assertEquals(vector<int>(20, 1), done);
+}
+
+unittest("ThreadPool: dependencies")
+{
+  ThreadPool pool(3);
+  vector<int> parts(8);
+  int sum = 0;
+
+  JobCounter partsDone;
+  JobCounter sumDone;
+
+  for(int i = 0; i < 8; ++i)
+    pool.run([&parts, i] () { parts[i] = i; }, &partsDone);
+
+  // waits for the others, on a worker
+  pool.run([&] ()
+    {
+      pool.wait(partsDone);
+
+      for(auto part : parts)
+        sum += part;
+    }, &sumDone);
+
+  pool.wait(sumDone);
+  assertEquals(28, sum);
+}
+
+unittest("ThreadPool: waiting doesn't run unrelated tasks")
+{
+  ThreadPool pool(1);
+  atomic<bool> started { false };
+  atomic<bool> release { false };
+  atomic<int> unrelated { 0 };
+
+  // keeps the only worker busy
+  pool.run([&] ()
+    {
+      started = true;
+
+      while(!release)
+        this_thread::yield();
+    });
+
+  while(!started)
+    this_thread::yield();
+
+  pool.run([&] () { unrelated = 1; });
+
+  // the caller runs its own ranges, and nothing else
+  assertEquals(vector<int>(10, 1), runAll(pool, 10));
+  assertEquals(0, unrelated.load());
+
+  release = true;
+}
+
+unittest("ThreadPool: pinned tasks run on the waiting thread")
+{
+  for(int threadCount : { 0, 2 })
+  {
+    ThreadPool pool(threadCount);
+    JobCounter counter;
+    atomic<int> elsewhere { 0 };
+    auto const self = this_thread::get_id();
+
+    for(int i = 0; i < 10; ++i)
+    {
+      pool.run([&] ()
+        {
+          pool.runPinned([&] () { elsewhere += this_thread::get_id() != self; }, &counter);
+        }, &counter);
+    }
+
+    pool.waitPinned(counter);
+    assertEquals(0, elsewhere.load());
+  }
+}
+
+unittest("ThreadPool: shared")
+{
+  auto& pool = getSharedThreadPool();
+  assertTrue(&pool == &getSharedThreadPool());
+  assertEquals(vector<int>(100, 1), runAll(pool, 100));
+}
@@ -0,0 +1,93 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/tick_scheduler.h"
+#include "tests.h"
+
+namespace
+{
+// runs the frame at 'now', the ticks taking 'tickCost' ms each
+int runFrame(TickScheduler& s, int now, int tickCost = 0)
+{
+  s.beginFrame(now);
+
+  int clock = now;
+  int ticks = 0;
+
+  while(s.nextTick(clock))
+  {
+    clock += tickCost;
+    ++ticks;
+  }
+
+  return ticks;
+}
+}
+
+unittest("TickScheduler: follows the clock")
+{
+  TickScheduler s;
+  s.start(1000);
+
+  assertEquals(0, runFrame(s, 1005));
+  assertEquals(1, runFrame(s, 1016));
+  assertEquals(0, runFrame(s, 1020));
+  assertEquals(2, runFrame(s, 1036));
+  assertEquals(0, s.droppedTicks);
+  assertEquals(1, s.lateTicks);
+
+  // drawn in-between the ticks
+  assertEquals(0.6f, s.getTickFraction());
+  assertEquals(1040.0, s.getNextTickTime());
+}
+
+unittest("TickScheduler: the ticks of a normal frame aren't late")
+{
+  TickScheduler s;
+  s.framePeriod = 25;
+  s.start(1000);
+
+  // a 25ms frame runs 2 or 3 ticks of 10ms
+  assertEquals(2, runFrame(s, 1025));
+  assertEquals(2, runFrame(s, 1050));
+  assertEquals(3, runFrame(s, 1075));
+  assertEquals(0, s.lateTicks);
+
+  // a stall: only the ticks past the 3 of a normal frame are late
+  assertEquals(5, runFrame(s, 1125));
+  assertEquals(2, s.lateTicks);
+}
+
+unittest("TickScheduler: bounded catch-up after a stall")
+{
+  TickScheduler s;
+  s.start(0);
+
+  // a 5 seconds stall
+  assertEquals(s.maxTicksPerFrame, runFrame(s, 5000));
+  assertTrue(s.droppedTicks > 0);
+  assertEquals(499, s.droppedTicks + s.maxTicksPerFrame);
+
+  // back on schedule
+  assertEquals(1, runFrame(s, 5010));
+  assertEquals(499, s.droppedTicks + s.maxTicksPerFrame);
+}
+
+unittest("TickScheduler: slow ticks don't spiral")
+{
+  TickScheduler s;
+  s.start(0);
+
+  // each tick costs more than it simulates
+  for(int frame = 1; frame <= 100; ++frame)
+  {
+    auto ticks = runFrame(s, frame * 100, 20);
+    assertTrue(ticks >= 1);
+    assertTrue(ticks * 20 <= s.maxCatchUpTime + 20);
+  }
+
+  assertTrue(s.droppedTicks > 0);
+}
@@ -0,0 +1,136 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "engine/src/audio/voice_manager.h"
+#include "engine/tests/tests.h"
+
+namespace
+{
+// plays 'length' samples of 'value'
+struct ConstantSound : Sound
+{
+  ConstantSound(float value_, int length_) : value(value_), length(length_) {}
+
+  struct Source : IAudioSource
+  {
+    Source(ConstantSound* sound_) : sound(sound_) {}
+
+    int read(Span<float> output) override
+    {
+      auto const n = min(output.len, sound->length - pos);
+
+      for(int i = 0; i < n; ++i)
+        output.data[i] = sound->value;
+
+      pos += n;
+      return n;
+    }
+
+    ConstantSound* const sound;
+    int pos = 0;
+  };
+
+  unique_ptr<IAudioSource> createSource() override
+  {
+    return make_unique<Source>(this);
+  }
+
+  float const value;
+  int const length;
+};
+}
+
+unittest("VoiceManager: mixes the voices")
+{
+  VoiceManager voices(4, 8);
+  ConstantSound a(1, 100);
+  ConstantSound b(10, 100);
+
+  assertTrue(voices.play(&a, 0));
+  assertTrue(voices.play(&b, 0));
+
+  float buffer[64] = { 0 };
+  voices.mix(buffer);
+
+  assertEquals(11.0f, buffer[0]);
+  assertEquals(11.0f, buffer[63]);
+  assertEquals(2, voices.playingCount());
+}
+
+unittest("VoiceManager: the least important voices are virtual")
+{
+  VoiceManager voices(1, 8);
+  ConstantSound low(1, 100);
+  ConstantSound high(10, 100);
+
+  voices.play(&low, 0);
+  voices.play(&high, 1);
+
+  float buffer[64] = { 0 };
+  voices.mix(buffer);
+
+  assertEquals(10.0f, buffer[0]);
+  assertTrue(voices.isAudible(&high));
+  assertTrue(!voices.isAudible(&low));
+  assertEquals(2, voices.playingCount());
+}
+
+unittest("VoiceManager: a virtual voice keeps its position")
+{
+  VoiceManager voices(1, 8);
+  ConstantSound low(1, 100);
+  ConstantSound high(10, 50);
+
+  voices.play(&low, 0);
+  voices.play(&high, 1);
+
+  float buffer[64] = { 0 };
+  voices.mix(buffer);
+
+  // 'high' ended: 'low' is audible again, 64 samples in
+  float next[64] = { 0 };
+  voices.mix(next);
+
+  for(int i = 0; i < 36; ++i)
+    assertEquals(1.0f, next[i]);
+
+  for(int i = 36; i < 64; ++i)
+    assertEquals(0.0f, next[i]);
+}
+
+unittest("VoiceManager: steals the oldest voice of the lowest priority")
+{
+  VoiceManager voices(2, 2);
+  ConstantSound first(1, 1000);
+  ConstantSound second(10, 1000);
+  ConstantSound third(100, 1000);
+
+  voices.play(&first, 0);
+  voices.play(&second, 0);
+  assertTrue(voices.play(&third, 0));
+
+  float buffer[8] = { 0 };
+  voices.mix(buffer);
+
+  assertEquals(110.0f, buffer[0]);
+  assertEquals(2, voices.playingCount());
+}
+
+unittest("VoiceManager: keeps the more important voices")
+{
+  VoiceManager voices(2, 2);
+  ConstantSound important(1, 1000);
+  ConstantSound crowd(100, 1000);
+
+  voices.play(&important, 2);
+  voices.play(&important, 2);
+  assertTrue(!voices.play(&crowd, 0));
+
+  float buffer[8] = { 0 };
+  voices.mix(buffer);
+
+  assertEquals(2.0f, buffer[0]);
+}
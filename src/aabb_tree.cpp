@@ -0,0 +1,292 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Dynamic AABB tree: insertion using the surface area heuristic,
+// AVL-like rotations to keep the tree balanced.
+// (Same approach as the dynamic tree in Box2D)
+
+#include "aabb_tree.h"
+#include <algorithm> // max
+
+namespace
+{
+float area(Box const& b)
+{
+  return 2.0f * (b.size.cx * b.size.cy + b.size.cy * b.size.cz + b.size.cz * b.size.cx);
+}
+
+bool contains(Box const& outer, Box const& inner)
+{
+  return inner.pos.x >= outer.pos.x
+         && inner.pos.y >= outer.pos.y
+         && inner.pos.z >= outer.pos.z
+         && inner.pos.x + inner.size.cx <= outer.pos.x + outer.size.cx
+         && inner.pos.y + inner.size.cy <= outer.pos.y + outer.size.cy
+         && inner.pos.z + inner.size.cz <= outer.pos.z + outer.size.cz;
+}
+
+Box enlarge(Box b, float margin)
+{
+  b.pos -= Vector(margin, margin, margin);
+  b.size.cx += margin * 2;
+  b.size.cy += margin * 2;
+  b.size.cz += margin * 2;
+  return b;
+}
+}
+
+int AabbTree::insert(Box box, void* userData)
+{
+  auto const id = allocateNode();
+  nodes[id].box = enlarge(box, margin);
+  nodes[id].userData = userData;
+  nodes[id].height = 0;
+  insertLeaf(id);
+  return id;
+}
+
+void AabbTree::remove(int proxy)
+{
+  assert(nodes[proxy].isLeaf());
+  removeLeaf(proxy);
+  freeNode(proxy);
+}
+
+bool AabbTree::update(int proxy, Box box)
+{
+  assert(nodes[proxy].isLeaf());
+
+  if(contains(nodes[proxy].box, box))
+    return false;
+
+  removeLeaf(proxy);
+  nodes[proxy].box = enlarge(box, margin);
+  insertLeaf(proxy);
+  return true;
+}
+
+int AabbTree::allocateNode()
+{
+  if(freeList == -1)
+  {
+    nodes.push_back({});
+    freeList = (int)nodes.size() - 1;
+    nodes[freeList].parent = -1;
+  }
+
+  auto const id = freeList;
+  freeList = nodes[id].parent; // 'parent' links the free list
+
+  auto& node = nodes[id];
+  node.userData = nullptr;
+  node.parent = -1;
+  node.child1 = -1;
+  node.child2 = -1;
+  node.height = 0;
+  return id;
+}
+
+void AabbTree::freeNode(int id)
+{
+  nodes[id].parent = freeList;
+  nodes[id].height = -1;
+  freeList = id;
+}
+
+void AabbTree::insertLeaf(int leaf)
+{
+  if(root == -1)
+  {
+    root = leaf;
+    nodes[root].parent = -1;
+    return;
+  }
+
+  // find the best sibling
+  auto const leafBox = nodes[leaf].box;
+  int index = root;
+
+  while(!nodes[index].isLeaf())
+  {
+    auto const child1 = nodes[index].child1;
+    auto const child2 = nodes[index].child2;
+
+    auto const nodeArea = area(nodes[index].box);
+    auto const combinedArea = area(unite(nodes[index].box, leafBox));
+
+    // cost of creating a new parent for this node and the new leaf
+    auto const cost = 2.0f * combinedArea;
+
+    // minimum cost of pushing the leaf further down the tree
+    auto const inheritanceCost = 2.0f * (combinedArea - nodeArea);
+
+    auto descendCost = [&] (int child)
+      {
+        auto const b = unite(leafBox, nodes[child].box);
+
+        if(nodes[child].isLeaf())
+          return area(b) + inheritanceCost;
+
+        return area(b) - area(nodes[child].box) + inheritanceCost;
+      };
+
+    auto const cost1 = descendCost(child1);
+    auto const cost2 = descendCost(child2);
+
+    if(cost < cost1 && cost < cost2)
+      break;
+
+    index = cost1 < cost2 ? child1 : child2;
+  }
+
+  auto const sibling = index;
+
+  // create a new parent
+  auto const oldParent = nodes[sibling].parent;
+  auto const newParent = allocateNode();
+  nodes[newParent].parent = oldParent;
+  nodes[newParent].box = unite(leafBox, nodes[sibling].box);
+  nodes[newParent].height = nodes[sibling].height + 1;
+  nodes[newParent].child1 = sibling;
+  nodes[newParent].child2 = leaf;
+  nodes[sibling].parent = newParent;
+  nodes[leaf].parent = newParent;
+
+  if(oldParent == -1)
+  {
+    root = newParent;
+  }
+  else
+  {
+    if(nodes[oldParent].child1 == sibling)
+      nodes[oldParent].child1 = newParent;
+    else
+      nodes[oldParent].child2 = newParent;
+  }
+
+  fixUpwards(nodes[leaf].parent);
+}
+
+void AabbTree::removeLeaf(int leaf)
+{
+  if(leaf == root)
+  {
+    root = -1;
+    return;
+  }
+
+  auto const parent = nodes[leaf].parent;
+  auto const grandParent = nodes[parent].parent;
+  auto const sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+  if(grandParent == -1)
+  {
+    root = sibling;
+    nodes[sibling].parent = -1;
+    freeNode(parent);
+    return;
+  }
+
+  // destroy the parent and connect the sibling to the grand parent
+  if(nodes[grandParent].child1 == parent)
+    nodes[grandParent].child1 = sibling;
+  else
+    nodes[grandParent].child2 = sibling;
+
+  nodes[sibling].parent = grandParent;
+  freeNode(parent);
+
+  fixUpwards(grandParent);
+}
+
+// walk back up the tree, fixing heights and boxes
+void AabbTree::fixUpwards(int index)
+{
+  while(index != -1)
+  {
+    index = balance(index);
+
+    auto const child1 = nodes[index].child1;
+    auto const child2 = nodes[index].child2;
+
+    nodes[index].height = 1 + max(nodes[child1].height, nodes[child2].height);
+    nodes[index].box = unite(nodes[child1].box, nodes[child2].box);
+
+    index = nodes[index].parent;
+  }
+}
+
+// Performs a left or right rotation if node A is imbalanced.
+// Returns the new root index of this subtree.
+int AabbTree::balance(int iA)
+{
+  auto& A = nodes[iA];
+
+  if(A.isLeaf() || A.height < 2)
+    return iA;
+
+  auto const iB = A.child1;
+  auto const iC = A.child2;
+
+  auto const delta = nodes[iC].height - nodes[iB].height;
+
+  if(delta >= -1 && delta <= 1)
+    return iA;
+
+  // rotate the higher child up
+  auto const iUp = delta > 0 ? iC : iB;
+  auto const iOther = delta > 0 ? iB : iC;
+
+  auto const iF = nodes[iUp].child1;
+  auto const iG = nodes[iUp].child2;
+
+  // swap A and Up
+  nodes[iUp].child1 = iA;
+  nodes[iUp].parent = A.parent;
+  A.parent = iUp;
+
+  if(nodes[iUp].parent != -1)
+  {
+    auto& upParent = nodes[nodes[iUp].parent];
+
+    if(upParent.child1 == iA)
+      upParent.child1 = iUp;
+    else
+      upParent.child2 = iUp;
+  }
+  else
+  {
+    root = iUp;
+  }
+
+  // the higher grand child stays below 'Up', the other one goes to A
+  auto const keepF = nodes[iF].height > nodes[iG].height;
+  auto const iKeep = keepF ? iF : iG;
+  auto const iMove = keepF ? iG : iF;
+
+  nodes[iUp].child2 = iKeep;
+
+  if(delta > 0)
+  {
+    A.child2 = iMove;
+    A.child1 = iOther;
+  }
+  else
+  {
+    A.child1 = iMove;
+    A.child2 = iOther;
+  }
+
+  nodes[iMove].parent = iA;
+
+  A.box = unite(nodes[A.child1].box, nodes[A.child2].box);
+  A.height = 1 + max(nodes[A.child1].height, nodes[A.child2].height);
+
+  nodes[iUp].box = unite(A.box, nodes[iKeep].box);
+  nodes[iUp].height = 1 + max(A.height, nodes[iKeep].height);
+
+  return iUp;
+}
@@ -0,0 +1,109 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Dynamic AABB tree: boxes can be inserted, moved and removed at any time.
+// Leaves store 'fat' boxes (enlarged by a margin), so that small moves
+// don't require any change to the tree.
+
+#pragma once
+
+#include "bvh.h" // boxesTouch, unite
+#include "vec.h"
+#include <cassert>
+#include <vector>
+
+using namespace std;
+
+struct AabbTree
+{
+  AabbTree(float margin_ = 0.25) : margin(margin_)
+  {
+  }
+
+  // returns a proxy id, stable until 'remove'
+  int insert(Box box, void* userData);
+  void remove(int proxy);
+
+  // Updates the box of a proxy.
+  // Returns false if the new box still fits inside the fat box,
+  // in which case the tree is left untouched.
+  bool update(int proxy, Box box);
+
+  void* getUserData(int proxy) const
+  {
+    return nodes[proxy].userData;
+  }
+
+  Box const& getFatBox(int proxy) const
+  {
+    return nodes[proxy].box;
+  }
+
+  // Calls 'onProxy(proxy)' for each proxy whose fat box touches 'box'.
+  template<typename Lambda>
+  void query(Box const& box, Lambda onProxy) const
+  {
+    if(root == -1)
+      return;
+
+    int stack[256];
+    int sp = 0;
+    stack[sp++] = root;
+
+    while(sp > 0)
+    {
+      auto const id = stack[--sp];
+      auto& node = nodes[id];
+
+      if(!boxesTouch(node.box, box))
+        continue;
+
+      if(node.isLeaf())
+      {
+        onProxy(id);
+      }
+      else
+      {
+        assert(sp + 2 <= 256);
+        stack[sp++] = node.child1;
+        stack[sp++] = node.child2;
+      }
+    }
+  }
+
+  int getHeight() const
+  {
+    return root == -1 ? 0 : nodes[root].height;
+  }
+
+private:
+  struct Node
+  {
+    Box box;
+    void* userData;
+    int parent;
+    int child1;
+    int child2;
+    int height; // leaf: 0, free node: -1
+
+    bool isLeaf() const
+    {
+      return child1 == -1;
+    }
+  };
+
+  int allocateNode();
+  void freeNode(int id);
+  void insertLeaf(int leaf);
+  void removeLeaf(int leaf);
+  int balance(int id);
+  void fixUpwards(int id);
+
+  float const margin;
+  int root = -1;
+  int freeList = -1;
+  vector<Node> nodes;
+};
@@ -0,0 +1,64 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Retained actors, diffed against what was last sent.
+
+#include "actor_proxies.h"
+
+static
+bool isSameVector(Vector3f a, Vector3f b)
+{
+  return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+bool isSameActor(Actor const& a, Actor const& b)
+{
+  return isSameVector(a.pos, b.pos)
+         && isSameVector(a.orientation.v, b.orientation.v)
+         && a.orientation.s == b.orientation.s
+         && a.model == b.model
+         && a.action == b.action
+         && a.ratio == b.ratio
+         && a.scale.cx == b.scale.cx && a.scale.cy == b.scale.cy && a.scale.cz == b.scale.cz
+         && a.effect == b.effect
+         && a.focus == b.focus
+         && isSameVector(a.motion, b.motion);
+}
+
+void ActorProxies::update(View* view, vector<Actor> const& actors)
+{
+  auto const count = (int)actors.size();
+
+  while((int)m_ids.size() > count)
+  {
+    view->removeProxy(m_ids.back());
+    m_ids.pop_back();
+    m_actors.pop_back();
+  }
+
+  for(int i = 0; i < count; ++i)
+  {
+    if(i >= (int)m_ids.size())
+    {
+      m_ids.push_back(view->addProxy(actors[i]));
+      m_actors.push_back(actors[i]);
+    }
+    else if(!isSameActor(m_actors[i], actors[i]))
+    {
+      view->updateProxy(m_ids[i], actors[i]);
+      m_actors[i] = actors[i];
+    }
+  }
+}
+
+void ActorProxies::clear(View* view)
+{
+  for(auto id : m_ids)
+    view->removeProxy(id);
+
+  m_ids.clear();
+  m_actors.clear();
+}
@@ -0,0 +1,30 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// The retained actors of one thing (e.g an entity): only what changed
+// since the last update is sent to the view.
+
+#pragma once
+
+#include "base/view.h"
+#include <vector>
+
+using namespace std;
+
+struct ActorProxies
+{
+  // 'actors': everything the thing draws now
+  void update(View* view, vector<Actor> const& actors);
+
+  // removes them all from the view
+  void clear(View* view);
+
+private:
+  vector<int> m_ids;
+  vector<Actor> m_actors; // as last sent
+};
+
+bool isSameActor(Actor const& a, Actor const& b);
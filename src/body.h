@@ -9,8 +9,8 @@
 
 #pragma once
 
+#include "slot_map.h"
 #include "vec.h"
-#include <functional>
 
 using namespace std;
 
@@ -21,6 +21,14 @@ struct Body
 
   bool solid = false;
   bool pusher = false; // push and crush?
+
+  // Static volume, which reports the bodies entering and leaving it,
+  // instead of colliding (see 'onTriggerEnter'). Must not move.
+  bool trigger = false;
+
+  // Once in the physics, teleport with 'IPhysicsProbe::teleport': the
+  // queries only see a 'pos' written directly after the body's next move,
+  // or the next 'checkForOverlaps'.
   Vector pos;
 
   // shape used for collision detection
@@ -30,11 +38,22 @@ struct Body
   int collisionGroup = 1;
   int collidesWith = 0xFFFF;
 
-  // the body we rest on (if any)
-  Body* ground = nullptr;
+  // The body we rest on, if any: its 'physicsHandle'.
+  // Goes stale when that body leaves the physics (see 'IPhysics::getGround').
+  SlotHandle ground;
+
+  // set by the physics, while the body is part of it
+  SlotHandle physicsHandle;
 
   // only called if (this->collidesWith & other->collisionGroup)
-  function<void(Body*)> onCollision = [] (Body*) {};
+  virtual void onCollision(Body* /*other*/) {}
+
+  // Triggers only, same filter as 'onCollision'.
+  // Called by 'checkForOverlaps', for the bodies which moved.
+  // A body leaving the physics exits the triggers it was in, right away.
+  // A trigger leaving the physics is silent.
+  virtual void onTriggerEnter(Body* /*other*/) {}
+  virtual void onTriggerExit(Body* /*other*/) {}
 
   Box getBox() const
   {
@@ -0,0 +1,128 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Bounding volume hierarchy over static boxes: construction.
+// Median split along the longest axis of the centroids.
+
+#include "bvh.h"
+#include <algorithm>
+
+namespace
+{
+auto const MAX_LEAF_SIZE = 2;
+
+Vector center(Box const& box)
+{
+  return box.pos + Vector(box.size) * 0.5;
+}
+
+float axisValue(Vector v, int axis)
+{
+  return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+}
+
+struct Builder
+{
+  vector<Box> const& boxes;
+  vector<Bvh::Node>& nodes;
+  vector<int>& indices;
+
+  void build(int first, int count)
+  {
+    auto const nodeIndex = (int)nodes.size();
+    nodes.push_back({});
+
+    Box box = boxes[indices[first]];
+    auto lo = center(box);
+    auto hi = lo;
+
+    for(int i = first; i < first + count; ++i)
+    {
+      auto const& b = boxes[indices[i]];
+      box = unite(box, b);
+
+      auto c = center(b);
+      lo = Vector(min(lo.x, c.x), min(lo.y, c.y), min(lo.z, c.z));
+      hi = Vector(max(hi.x, c.x), max(hi.y, c.y), max(hi.z, c.z));
+    }
+
+    nodes[nodeIndex].box = box;
+
+    if(count <= MAX_LEAF_SIZE)
+    {
+      nodes[nodeIndex].first = first;
+      nodes[nodeIndex].count = count;
+      return;
+    }
+
+    auto const extent = hi - lo;
+    int axis = 0;
+
+    if(extent.y > axisValue(extent, axis))
+      axis = 1;
+
+    if(extent.z > axisValue(extent, axis))
+      axis = 2;
+
+    auto byCenter = [&] (int a, int b)
+      {
+        return axisValue(center(boxes[a]), axis) < axisValue(center(boxes[b]), axis);
+      };
+
+    auto const half = count / 2;
+    nth_element(indices.begin() + first, indices.begin() + first + half, indices.begin() + first + count, byCenter);
+
+    build(first, half);
+
+    auto const right = (int)nodes.size();
+    build(first + half, count - half);
+
+    nodes[nodeIndex].first = right;
+    nodes[nodeIndex].count = 0;
+  }
+};
+}
+
+Box unite(Box const& a, Box const& b)
+{
+  auto const x0 = min(a.pos.x, b.pos.x);
+  auto const y0 = min(a.pos.y, b.pos.y);
+  auto const z0 = min(a.pos.z, b.pos.z);
+  auto const x1 = max(a.pos.x + a.size.cx, b.pos.x + b.size.cx);
+  auto const y1 = max(a.pos.y + a.size.cy, b.pos.y + b.size.cy);
+  auto const z1 = max(a.pos.z + a.size.cz, b.pos.z + b.size.cz);
+  return Box(x0, y0, z0, x1 - x0, y1 - y0, z1 - z0);
+}
+
+Box sweptBox(Box const& box, Vector delta, float margin)
+{
+  auto end = box;
+  end.pos += delta;
+
+  auto r = unite(box, end);
+  r.pos -= Vector(margin, margin, margin);
+  r.size.cx += margin * 2;
+  r.size.cy += margin * 2;
+  r.size.cz += margin * 2;
+  return r;
+}
+
+void Bvh::build(vector<Box> const& boxes)
+{
+  nodes.clear();
+  indices.resize(boxes.size());
+
+  for(int i = 0; i < (int)boxes.size(); ++i)
+    indices[i] = i;
+
+  if(boxes.empty())
+    return;
+
+  nodes.reserve(boxes.size() * 2);
+
+  Builder builder { boxes, nodes, indices };
+  builder.build(0, (int)boxes.size());
+}
@@ -0,0 +1,86 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Bounding volume hierarchy over static boxes.
+// Built once (e.g at level load), then queried with boxes.
+
+#pragma once
+
+#include "vec.h"
+#include <vector>
+
+using namespace std;
+
+// Inclusive version of 'overlaps': touching boxes are considered intersecting.
+inline bool boxesTouch(Box const& a, Box const& b)
+{
+  if(a.pos.x > b.pos.x + b.size.cx || b.pos.x > a.pos.x + a.size.cx)
+    return false;
+
+  if(a.pos.y > b.pos.y + b.size.cy || b.pos.y > a.pos.y + a.size.cy)
+    return false;
+
+  if(a.pos.z > b.pos.z + b.size.cz || b.pos.z > a.pos.z + a.size.cz)
+    return false;
+
+  return true;
+}
+
+// Smallest box containing both 'a' and 'b'
+Box unite(Box const& a, Box const& b);
+
+// Box covering a box swept by 'delta', enlarged by 'margin' on every side.
+Box sweptBox(Box const& box, Vector delta, float margin);
+
+struct Bvh
+{
+  // 'boxes[i]' is the bounding box of the i-th primitive.
+  void build(vector<Box> const& boxes);
+
+  // Calls 'onPrimitive(i)' for the primitives of each leaf touching 'box'.
+  // This is conservative: every primitive touching 'box' is reported,
+  // and some of its leaf neighbours might be reported too.
+  template<typename Lambda>
+  void query(Box const& box, Lambda onPrimitive) const
+  {
+    if(nodes.empty())
+      return;
+
+    int stack[64];
+    int sp = 0;
+    stack[sp++] = 0;
+
+    while(sp > 0)
+    {
+      auto& node = nodes[stack[--sp]];
+
+      if(!boxesTouch(node.box, box))
+        continue;
+
+      if(node.count > 0)
+      {
+        for(int i = 0; i < node.count; ++i)
+          onPrimitive(indices[node.first + i]);
+      }
+      else
+      {
+        // left child immediately follows its parent
+        stack[sp++] = node.first;
+        stack[sp++] = int(&node - nodes.data()) + 1;
+      }
+    }
+  }
+
+  struct Node
+  {
+    Box box;
+    int first; // leaf: first index in 'indices'. Inner node: right child.
+    int count; // number of primitives, zero for inner nodes
+  };
+
+  vector<Node> nodes;
+  vector<int> indices;
+};
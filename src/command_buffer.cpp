@@ -0,0 +1,187 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Deferred game/physics commands, for parallel entity ticks.
+
+#include "command_buffer.h"
+#include <cstring> // memcpy
+
+CommandBuffer::CommandBuffer(IGame* game, IPhysicsProbe* physics, mutex* readLock) :
+  m_game(game),
+  m_physics(physics),
+  m_readLock(readLock)
+{
+}
+
+void CommandBuffer::apply()
+{
+  for(auto& cmd : m_commands)
+  {
+    switch(cmd.type)
+    {
+    case Type::TextBox:
+      m_game->textBox(cmd.text);
+      break;
+    case Type::PlaySound:
+      m_game->playSound(cmd.value);
+      break;
+    case Type::SpawnEffect:
+      m_game->spawnEffect((EffectType)cmd.value, cmd.delta);
+      break;
+    case Type::Spawn:
+      m_game->spawn(cmd.entity);
+      break;
+    case Type::Despawn:
+      m_game->despawn(cmd.entity);
+      break;
+    case Type::PostEvent:
+      m_game->postEvent(*reinterpret_cast<const Event*>(cmd.event));
+      break;
+    case Type::EndLevel:
+      m_game->endLevel();
+      break;
+    case Type::RestartLevel:
+      m_game->restartLevel();
+      break;
+    case Type::WakeUpIn:
+      m_game->wakeUpIn(cmd.entity, cmd.value);
+      break;
+    case Type::MoveBody:
+      m_physics->moveBody(cmd.body, cmd.delta);
+      break;
+    case Type::StepSlideMove:
+      m_physics->stepSlideMove(cmd.body, cmd.delta, cmd.stepHeight);
+      break;
+    }
+  }
+
+  m_commands.clear();
+  m_texts.reset();
+}
+
+CommandBuffer::Command& CommandBuffer::push(Type type)
+{
+  m_commands.push_back({});
+  m_commands.back().type = type;
+  return m_commands.back();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IGame
+
+void CommandBuffer::textBox(char const* msg)
+{
+  push(Type::TextBox).text = m_texts.copy(msg);
+}
+
+void CommandBuffer::playSound(int id)
+{
+  push(Type::PlaySound).value = id;
+}
+
+void CommandBuffer::spawnEffect(EffectType type, Vector pos)
+{
+  auto& cmd = push(Type::SpawnEffect);
+  cmd.value = (int)type;
+  cmd.delta = pos;
+}
+
+void CommandBuffer::spawn(Entity* e)
+{
+  push(Type::Spawn).entity = e;
+}
+
+void CommandBuffer::despawn(Entity* e)
+{
+  push(Type::Despawn).entity = e;
+}
+
+void CommandBuffer::postEvent(const Event& event)
+{
+  memcpy(push(Type::PostEvent).event, &event, event.size);
+}
+
+int CommandBuffer::subscribeForEvents(IEventSink* sink, EventType type, int key)
+{
+  lock_guard<mutex> guard(*m_readLock);
+  return m_game->subscribeForEvents(sink, type, key);
+}
+
+void CommandBuffer::unsubscribeForEvents(int subscription)
+{
+  lock_guard<mutex> guard(*m_readLock);
+  m_game->unsubscribeForEvents(subscription);
+}
+
+Vector CommandBuffer::getPlayerPosition()
+{
+  lock_guard<mutex> guard(*m_readLock);
+  return m_game->getPlayerPosition();
+}
+
+void CommandBuffer::endLevel()
+{
+  push(Type::EndLevel);
+}
+
+void CommandBuffer::restartLevel()
+{
+  push(Type::RestartLevel);
+}
+
+void CommandBuffer::wakeUpIn(Entity* e, int subTicks)
+{
+  auto& cmd = push(Type::WakeUpIn);
+  cmd.entity = e;
+  cmd.value = subTicks;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IPhysicsProbe
+
+IPhysicsProbe::Trace CommandBuffer::moveBody(Body* body, Vector delta)
+{
+  auto& cmd = push(Type::MoveBody);
+  cmd.body = body;
+  cmd.delta = delta;
+
+  Trace r {};
+  r.fraction = 1.0;
+  r.blocker = nullptr;
+  return r;
+}
+
+void CommandBuffer::stepSlideMove(Body* body, Vector delta, float stepHeight)
+{
+  auto& cmd = push(Type::StepSlideMove);
+  cmd.body = body;
+  cmd.delta = delta;
+  cmd.stepHeight = stepHeight;
+}
+
+IPhysicsProbe::Trace CommandBuffer::traceBox(Box box, Vector delta, const Body* except) const
+{
+  lock_guard<mutex> guard(*m_readLock);
+  return m_physics->traceBox(box, delta, except);
+}
+
+IPhysicsProbe::Trace CommandBuffer::traceGround(const Body* body) const
+{
+  lock_guard<mutex> guard(*m_readLock);
+  return m_physics->traceGround(body);
+}
+
+void CommandBuffer::traceBoxes(Span<const TraceQuery> queries, Span<Trace> results) const
+{
+  lock_guard<mutex> guard(*m_readLock);
+  m_physics->traceBoxes(queries, results);
+}
+
+Body* CommandBuffer::getBodiesInBox(Box myRect, int collisionGroup, bool onlySolid, const Body* except) const
+{
+  lock_guard<mutex> guard(*m_readLock);
+  return m_physics->getBodiesInBox(myRect, collisionGroup, onlySolid, except);
+}
@@ -0,0 +1,84 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Game and physics, as seen by an entity ticking on a worker thread.
+// Writes (moves, spawns, events, sounds ...) are recorded, to be applied
+// later on the game thread, in a deterministic order.
+// Reads are forwarded, one thread at a time.
+
+#pragma once
+
+#include "base/linear_allocator.h"
+#include "entity.h"
+#include <mutex>
+#include <vector>
+
+struct CommandBuffer : IGame, IPhysicsProbe
+{
+  CommandBuffer(IGame* game, IPhysicsProbe* physics, mutex* readLock);
+
+  // replays, then forgets, the recorded commands
+  void apply();
+
+  // IGame
+  void textBox(char const* msg) override;
+  void playSound(int id) override;
+  void spawnEffect(EffectType type, Vector pos) override;
+  void spawn(Entity* e) override;
+  void despawn(Entity* e) override;
+  void postEvent(const Event& event) override;
+  int subscribeForEvents(IEventSink* sink, EventType type, int key) override;
+  void unsubscribeForEvents(int subscription) override;
+  Vector getPlayerPosition() override;
+  void endLevel() override;
+  void restartLevel() override;
+  void wakeUpIn(Entity* e, int subTicks) override;
+
+  // IPhysicsProbe
+  // Moves are assumed to succeed: the returned trace is always complete.
+  Trace moveBody(Body* body, Vector delta) override;
+  void stepSlideMove(Body* body, Vector delta, float stepHeight) override;
+  Trace traceBox(Box box, Vector delta, const Body* except) const override;
+  Trace traceGround(const Body* body) const override;
+  void traceBoxes(Span<const TraceQuery> queries, Span<Trace> results) const override;
+  Body* getBodiesInBox(Box myRect, int collisionGroup, bool onlySolid, const Body* except) const override;
+
+private:
+  enum class Type
+  {
+    TextBox,
+    PlaySound,
+    SpawnEffect,
+    Spawn,
+    Despawn,
+    PostEvent,
+    EndLevel,
+    RestartLevel,
+    WakeUpIn,
+    MoveBody,
+    StepSlideMove,
+  };
+
+  struct Command
+  {
+    Type type;
+    int value; // sound id, effect type, sub-ticks
+    Entity* entity;
+    Body* body;
+    Vector delta; // or the position of an effect
+    float stepHeight;
+    char const* text; // in 'm_texts'
+    alignas(Event) uint8_t event[MAX_EVENT_SIZE];
+  };
+
+  Command& push(Type type);
+
+  IGame* const m_game;
+  IPhysicsProbe* const m_physics;
+  mutex* const m_readLock;
+  vector<Command> m_commands;
+  LinearAllocator m_texts; // of 'm_commands', freed by 'apply'
+};
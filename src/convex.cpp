@@ -9,34 +9,34 @@
 #include "base/util.h" // clamp
 #include "convex.h"
 
-// Sweeps a box from A to B.
-// Returns the fraction of the move to the first intersection with the convex,
-// or 1.0 if there are no intersections.
-// Also returns the intersecting plane, if any.
-Trace Convex::trace(Vector A, Vector B, Vector boxSize) const
-{
-  Trace trace;
-  trace.fraction = 1;
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
-  Plane clipPlane;
+namespace
+{
+auto const epsilon = 1.0f / 128.0f;
 
+// Accumulates the entering/leaving fractions of a trace,
+// one plane at a time.
+struct Clipper
+{
   float enterBrush = -1;
   float leaveBrush = 1;
+  Plane clipPlane;
 
-  for(auto& plane : planes)
+  // returns false if the trace is completely outside the convex
+  bool clip(float distA, float distB, Plane const& plane)
   {
-    auto const radius = abs(boxSize.x * plane.N.x) + abs(boxSize.y * plane.N.y) + abs(boxSize.z * plane.N.z);
-    auto const epsilon = 1.0f / 128.0f;
-    auto const distA = plane.dist(A) - radius;
-    auto const distB = plane.dist(B) - radius;
-
     // trace is completely outside the convex
     if(distA > 0 && distB > 0)
-      return trace;
+      return false;
 
     // this plane is not crossed
     if(distA <= 0 && distB <= 0)
-      continue;
+      return true;
 
     // trace is entering the convex
     if(distA > 0 && distB <= 0)
@@ -61,14 +61,237 @@ Trace Convex::trace(Vector A, Vector B, Vector boxSize) const
       if(fraction < leaveBrush)
         leaveBrush = fraction;
     }
+
+    return true;
   }
 
-  if(enterBrush > -1 && enterBrush < leaveBrush)
+  Trace result() const
   {
-    trace.fraction = enterBrush;
-    trace.plane = clipPlane;
+    Trace trace;
+    trace.fraction = 1;
+
+    if(enterBrush > -1 && enterBrush < leaveBrush)
+    {
+      trace.fraction = enterBrush;
+      trace.plane = clipPlane;
+    }
+
+    return trace;
   }
+};
+}
 
-  return trace;
+// Sweeps a box from A to B.
+// Returns the fraction of the move to the first intersection with the convex,
+// or 1.0 if there are no intersections.
+// Also returns the intersecting plane, if any.
+Trace Convex::trace(Vector A, Vector B, Vector boxSize) const
+{
+  Clipper clipper;
+
+  for(auto& plane : planes)
+  {
+    auto const radius = abs(boxSize.x * plane.N.x) + abs(boxSize.y * plane.N.y) + abs(boxSize.z * plane.N.z);
+    auto const distA = plane.dist(A) - radius;
+    auto const distB = plane.dist(B) - radius;
+
+    if(!clipper.clip(distA, distB, plane))
+    {
+      Trace trace;
+      trace.fraction = 1;
+      return trace;
+    }
+  }
+
+  return clipper.result();
 }
 
+PackedConvex::PackedConvex(Convex const& convex)
+{
+  bounds = convex.bounds;
+  count = (int)convex.planes.size();
+  stride = (count + 3) & ~3;
+
+  // padding planes: never crossed (dist=-1 everywhere)
+  soa.assign(stride * 4, 0.0f);
+
+  for(int i = count; i < stride; ++i)
+    soa[stride * 3 + i] = 1.0f;
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto& plane = convex.planes[i];
+    soa[stride * 0 + i] = plane.N.x;
+    soa[stride * 1 + i] = plane.N.y;
+    soa[stride * 2 + i] = plane.N.z;
+    soa[stride * 3 + i] = plane.D;
+  }
+}
+
+// The distances of A and B to all the planes are computed first, 4 planes at
+// a time, using the same operations in the same order as 'Convex::trace'.
+// Then, the enter/leave fractions are accumulated by the scalar clipper.
+Trace PackedConvex::trace(Vector A, Vector B, Vector boxSize) const
+{
+  float distA[64];
+  float distB[64];
+
+  Trace noHit;
+  noHit.fraction = 1;
+
+  // huge brushes: fall back to the generic version
+  if(stride > 64)
+  {
+    Convex convex;
+
+    for(int i = 0; i < count; ++i)
+      convex.planes.push_back(Plane { Vector(soa[i], soa[stride + i], soa[stride * 2 + i]), soa[stride * 3 + i] });
+
+    return convex.trace(A, B, boxSize);
+  }
+
+  auto const nx = soa.data();
+  auto const ny = nx + stride;
+  auto const nz = ny + stride;
+  auto const d = nz + stride;
+
+#if defined(__SSE2__)
+  auto const signMask = _mm_set1_ps(-0.0f);
+  auto const zero = _mm_setzero_ps();
+
+  auto const ax = _mm_set1_ps(A.x), ay = _mm_set1_ps(A.y), az = _mm_set1_ps(A.z);
+  auto const bx = _mm_set1_ps(B.x), by = _mm_set1_ps(B.y), bz = _mm_set1_ps(B.z);
+  auto const hx = _mm_set1_ps(boxSize.x), hy = _mm_set1_ps(boxSize.y), hz = _mm_set1_ps(boxSize.z);
+
+  for(int i = 0; i < stride; i += 4)
+  {
+    auto const Nx = _mm_loadu_ps(nx + i);
+    auto const Ny = _mm_loadu_ps(ny + i);
+    auto const Nz = _mm_loadu_ps(nz + i);
+    auto const D = _mm_loadu_ps(d + i);
+
+    auto const rx = _mm_andnot_ps(signMask, _mm_mul_ps(hx, Nx));
+    auto const ry = _mm_andnot_ps(signMask, _mm_mul_ps(hy, Ny));
+    auto const rz = _mm_andnot_ps(signMask, _mm_mul_ps(hz, Nz));
+    auto const radius = _mm_add_ps(_mm_add_ps(rx, ry), rz);
+
+    auto const dotA = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, Nx), _mm_mul_ps(ay, Ny)), _mm_mul_ps(az, Nz));
+    auto const dotB = _mm_add_ps(_mm_add_ps(_mm_mul_ps(bx, Nx), _mm_mul_ps(by, Ny)), _mm_mul_ps(bz, Nz));
+
+    auto const dA = _mm_sub_ps(_mm_sub_ps(dotA, D), radius);
+    auto const dB = _mm_sub_ps(_mm_sub_ps(dotB, D), radius);
+
+    // trace is completely outside the convex
+    if(_mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(dA, zero), _mm_cmpgt_ps(dB, zero))))
+      return noHit;
+
+    _mm_storeu_ps(distA + i, dA);
+    _mm_storeu_ps(distB + i, dB);
+  }
+
+#elif defined(__ARM_NEON)
+  auto const zero = vdupq_n_f32(0);
+
+  for(int i = 0; i < stride; i += 4)
+  {
+    auto const Nx = vld1q_f32(nx + i);
+    auto const Ny = vld1q_f32(ny + i);
+    auto const Nz = vld1q_f32(nz + i);
+    auto const D = vld1q_f32(d + i);
+
+    auto const rx = vabsq_f32(vmulq_n_f32(Nx, boxSize.x));
+    auto const ry = vabsq_f32(vmulq_n_f32(Ny, boxSize.y));
+    auto const rz = vabsq_f32(vmulq_n_f32(Nz, boxSize.z));
+    auto const radius = vaddq_f32(vaddq_f32(rx, ry), rz);
+
+    auto const dotA = vaddq_f32(vaddq_f32(vmulq_n_f32(Nx, A.x), vmulq_n_f32(Ny, A.y)), vmulq_n_f32(Nz, A.z));
+    auto const dotB = vaddq_f32(vaddq_f32(vmulq_n_f32(Nx, B.x), vmulq_n_f32(Ny, B.y)), vmulq_n_f32(Nz, B.z));
+
+    auto const dA = vsubq_f32(vsubq_f32(dotA, D), radius);
+    auto const dB = vsubq_f32(vsubq_f32(dotB, D), radius);
+
+    // trace is completely outside the convex
+    auto const outside = vandq_u32(vcgtq_f32(dA, zero), vcgtq_f32(dB, zero));
+
+    if(vgetq_lane_u32(outside, 0) | vgetq_lane_u32(outside, 1) | vgetq_lane_u32(outside, 2) | vgetq_lane_u32(outside, 3))
+      return noHit;
+
+    vst1q_f32(distA + i, dA);
+    vst1q_f32(distB + i, dB);
+  }
+
+#else
+
+  for(int i = 0; i < count; ++i)
+  {
+    auto const radius = abs(boxSize.x * nx[i]) + abs(boxSize.y * ny[i]) + abs(boxSize.z * nz[i]);
+    distA[i] = ((A.x * nx[i] + A.y * ny[i] + A.z * nz[i]) - d[i]) - radius;
+    distB[i] = ((B.x * nx[i] + B.y * ny[i] + B.z * nz[i]) - d[i]) - radius;
+
+    // trace is completely outside the convex
+    if(distA[i] > 0 && distB[i] > 0)
+      return noHit;
+  }
+
+#endif
+
+  Clipper clipper;
+
+  for(int i = 0; i < count; ++i)
+  {
+    if(distA[i] <= 0 && distB[i] <= 0)
+      continue;
+
+    clipper.clip(distA[i], distB[i], Plane { Vector(nx[i], ny[i], nz[i]), d[i] });
+  }
+
+  return clipper.result();
+}
+
+Convex makeBoxConvex(Box const& box)
+{
+  Convex r;
+  r.planes.push_back(Plane { Vector(-1, 0, 0), -box.pos.x });
+  r.planes.push_back(Plane { Vector(+1, 0, 0), box.pos.x + box.size.cx });
+  r.planes.push_back(Plane { Vector(0, -1, 0), -box.pos.y });
+  r.planes.push_back(Plane { Vector(0, +1, 0), box.pos.y + box.size.cy });
+  r.planes.push_back(Plane { Vector(0, 0, -1), -box.pos.z });
+  r.planes.push_back(Plane { Vector(0, 0, +1), box.pos.z + box.size.cz });
+  r.bounds = box;
+  return r;
+}
+
+// Same as Convex::trace against 'makeBoxConvex(box)',
+// without building them: for axis-aligned planes, the dot products and the
+// radius reduce to one coordinate. The arithmetic is kept in the same order,
+// so the results are exactly the same.
+Trace traceThroughBox(Vector A, Vector B, Vector boxSize, Box const& box)
+{
+  Clipper clipper;
+
+  float const a[3] = { A.x, A.y, A.z };
+  float const b[3] = { B.x, B.y, B.z };
+  float const halfSize[3] = { boxSize.x, boxSize.y, boxSize.z };
+  float const lo[3] = { box.pos.x, box.pos.y, box.pos.z };
+  float const hi[3] = { box.pos.x + box.size.cx, box.pos.y + box.size.cy, box.pos.z + box.size.cz };
+
+  for(int axis = 0; axis < 3; ++axis)
+  {
+    Vector N(0, 0, 0);
+    auto& n = axis == 0 ? N.x : (axis == 1 ? N.y : N.z);
+
+    // negative side: N=-axis, D=-lo
+    n = -1;
+
+    if(!clipper.clip((-a[axis] + lo[axis]) - halfSize[axis], (-b[axis] + lo[axis]) - halfSize[axis], Plane { N, -lo[axis] }))
+      return Trace { 1, {} };
+
+    // positive side: N=+axis, D=hi
+    n = +1;
+
+    if(!clipper.clip((a[axis] - hi[axis]) - halfSize[axis], (b[axis] - hi[axis]) - halfSize[axis], Plane { N, hi[axis] }))
+      return Trace { 1, {} };
+  }
+
+  return clipper.result();
+}
@@ -9,11 +9,41 @@
 
 #pragma once
 #include "trace.h"
+#include "vec.h"
 #include <vector>
 
 struct Convex
 {
   std::vector<Plane> planes;
+
+  // Bounding box of the hull.
+  // Bevel planes go through edges of the hull, so they don't extend it.
+  Box bounds;
+
+  Trace trace(Vector A, Vector B, Vector boxSize) const;
+};
+
+// Same convex, with the planes stored as structure-of-arrays
+// (all normal X, then all normal Y, ...), padded to a multiple of 4,
+// so the trace can evaluate 4 planes per SIMD instruction.
+// Gives the same results as 'Convex::trace', bit for bit.
+struct PackedConvex
+{
+  PackedConvex() = default;
+  explicit PackedConvex(Convex const& convex);
+
   Trace trace(Vector A, Vector B, Vector boxSize) const;
+
+  Box bounds;
+  int count = 0; // number of actual planes
+  int stride = 0; // 'count' rounded up to a multiple of 4
+  std::vector<float> soa; // [ nx... | ny... | nz... | d... ]
 };
 
+// The 6 planes of an axis-aligned box: -X, +X, -Y, +Y, -Z, +Z.
+Convex makeBoxConvex(Box const& box);
+
+// Sweeps a box from A to B against an axis-aligned box.
+// Gives the same result as 'Convex::trace' on 'makeBoxConvex(box)'.
+Trace traceThroughBox(Vector A, Vector B, Vector boxSize, Box const& box);
+
@@ -18,6 +18,8 @@ struct Amulet : Entity
   {
     size = Size(1, 1, 1) * 0.5;
     solid = false;
+    tickPolicy = TickPolicy::OncePerTick;
+    parallelTick = true;
   }
 
   void onDraw(View* view) const override
@@ -30,8 +32,8 @@ struct Amulet : Entity
 
   void tick() override
   {
-    yaw += 0.002 * 0.1;
-    pitch += 0.003 * 0.1;
+    yaw += 0.002;
+    pitch += 0.003;
   }
 
   float yaw = 0;
@@ -42,4 +44,5 @@ struct Amulet : Entity
 #include "entity_factory.h"
 static auto const reg = registerEntity("amulet", [] (IEntityConfig*) -> unique_ptr<Entity> { return make_unique<Amulet>(); });
 static auto const reg2 = registerEntity("crate", [] (IEntityConfig*) -> unique_ptr<Entity> { return make_unique<Amulet>(); });
+static auto const reg3 = registerTickLoop<Amulet>("amulet");
 
@@ -29,12 +29,7 @@ struct CrumbleBlock : Entity
     view->sendActor(r);
   }
 
-  virtual void enter() override
-  {
-    Body::onCollision = [this] (Body* other) { touch(other); };
-  }
-
-  void touch(Body* other)
+  virtual void onCollision(Body* other) override
   {
     if(other->pos.z > pos.z + size.cz)
     {
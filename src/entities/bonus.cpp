@@ -28,6 +28,7 @@ struct EnergyCell : Entity
     solid = false;
     collisionGroup = 0;
     collidesWith = CG_PLAYER | CG_SOLIDPLAYER;
+    parallelTick = true;
   }
 
   virtual void onDraw(View* view) const override
@@ -48,7 +49,7 @@ struct EnergyCell : Entity
     pitch += 0.0039;
   }
 
-  void onCollide(Entity* other) override
+  void onCollision(Body* other) override
   {
     if(dead)
       return;
@@ -58,7 +59,7 @@ struct EnergyCell : Entity
       player->addEnergy(0.4);
       game->playSound(SND_BONUS);
       game->textBox("Got flashlight battery");
-      dead = true;
+      die();
     }
   }
 
@@ -78,4 +79,5 @@ std::unique_ptr<Entity> makeEnergyCell()
 
 #include "entity_factory.h"
 static auto const reg1 = registerEntity("bonus", [] (IEntityConfig*) { return makeEnergyCell(); });
+static auto const reg2 = registerTickLoop<EnergyCell>("bonus");
 
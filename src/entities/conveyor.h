@@ -23,12 +23,7 @@ struct Conveyor : Entity
     view->sendActor(r);
   }
 
-  virtual void enter() override
-  {
-    Body::onCollision = [this] (Body* other) { touch(other); };
-  }
-
-  void touch(Body* other)
+  virtual void onCollision(Body* other) override
   {
     // avoid infinite recursion
     // (if the conveyor pushes the player towards the conveyor)
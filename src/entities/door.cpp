@@ -17,21 +17,18 @@ struct Door : Entity, IEventSink
   {
     size = UnitSize * 2;
     solid = true;
+    tickPolicy = TickPolicy::Never;
   }
 
   void enter() override
   {
     pos -= UnitSize;
-    subscription = game->subscribeForEvents(this);
+    subscription = game->subscribeForEvents(this, TriggerEvent::TYPE, id);
   }
 
   void leave() override
   {
-    subscription.reset();
-  }
-
-  virtual void tick() override
-  {
+    game->unsubscribeForEvents(subscription);
   }
 
   virtual void onDraw(View* view) const override
@@ -47,25 +44,20 @@ struct Door : Entity, IEventSink
     view->sendActor(r);
   }
 
-  virtual void notify(const Event* evt) override
+  // only our own triggers get here
+  virtual void notify(const Event*) override
   {
     if(!solid)
       return;
 
-    if(auto trg = evt->as<TriggerEvent>())
-    {
-      if(trg->idx != id)
-        return;
-
-      game->playSound(SND_DOOR);
-      solid = false;
-    }
+    game->playSound(SND_DOOR);
+    solid = false;
   }
 
   bool state = false;
   int openingDelay = 0;
   const int id;
-  unique_ptr<Handle> subscription;
+  int subscription = 0;
 };
 
 unique_ptr<Entity> makeDoor(int id)
@@ -162,8 +154,6 @@ unique_ptr<Entity> makeAutoDoor()
 
 ///////////////////////////////////////////////////////////////////////////////
 
-#include "entities/explosion.h"
-
 struct BreakableDoor : Entity, Damageable
 {
   BreakableDoor()
@@ -171,6 +161,7 @@ struct BreakableDoor : Entity, Damageable
     size = UnitSize;
     solid = true;
     collisionGroup = CG_WALLS;
+    tickPolicy = TickPolicy::Timer;
   }
 
   virtual void onDraw(View* view) const override
@@ -184,24 +175,23 @@ struct BreakableDoor : Entity, Damageable
     view->sendActor(r);
   }
 
-  virtual void tick() override
+  virtual void onWakeUp() override
   {
-    decrement(blinking);
+    blinking = 0;
   }
 
   virtual void onDamage(int amount) override
   {
     blinking = 200;
+    game->wakeUpIn(this, blinking);
     life -= amount;
 
     if(life < 0)
     {
       game->playSound(SND_EXPLODE);
-      dead = true;
+      die();
 
-      auto explosion = makeExplosion();
-      explosion->pos = getCenter();
-      game->spawn(explosion.release());
+      game->spawnEffect(EffectType::Explosion, getCenter());
     }
     else
       game->playSound(SND_DAMAGE);
@@ -217,5 +207,6 @@ unique_ptr<Entity> makeBreakableDoor()
 
 #include "entity_factory.h"
 static auto const reg1 = registerEntity("auto_door", [] (IEntityConfig*) { return makeAutoDoor(); });
-static auto const reg2 = registerEntity("door", [] (IEntityConfig* args) { auto arg = args->getInt("0"); return makeDoor(arg); });
+static auto const reg2 = registerEntity("door", [] (IEntityConfig* args) { auto arg = args->getInt(0); return makeDoor(arg); });
+static auto const reg3 = registerTickLoop<AutoDoor>("auto_door");
 
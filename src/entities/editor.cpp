@@ -58,6 +58,11 @@ struct Editor : Player
   {
   }
 
+  std::unique_ptr<Player> clone() const override
+  {
+    return make_unique<Editor>(*this);
+  }
+
   void computeVelocity(Control c)
   {
     airMove(c);
@@ -146,3 +151,6 @@ std::unique_ptr<Player> makeEditor(Matrix& tiles)
   return make_unique<Editor>(tiles);
 }
 
+
+#include "entity_factory.h"
+static auto const reg = registerTickLoop<Editor>("editor");
@@ -1,7 +0,0 @@
-#pragma once
-
-#include "entity.h"
-#include <memory>
-
-std::unique_ptr<Entity> makeExplosion();
-
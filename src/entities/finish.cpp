@@ -20,8 +20,10 @@ struct FinishLine : Entity
   {
     size = Size(2, 2, 2);
     solid = false;
+    trigger = true;
     collisionGroup = 0; // dont' trigger other detectors
     collidesWith = CG_PLAYER | CG_SOLIDPLAYER;
+    parallelTick = true;
   }
 
   virtual void onDraw(View* view) const override
@@ -36,13 +38,30 @@ struct FinishLine : Entity
   virtual void tick() override
   {
     if(decrement(touchDelay))
+    {
       game->endLevel();
 
+      // still touched
+      if(inside > 0)
+        touch();
+    }
+
     yaw += 0.002;
     pitch += 0.003;
   }
 
-  virtual void onCollide(Entity*) override
+  virtual void onTriggerEnter(Body*) override
+  {
+    inside++;
+    touch();
+  }
+
+  virtual void onTriggerExit(Body*) override
+  {
+    inside--;
+  }
+
+  void touch()
   {
     if(touchDelay)
       return;
@@ -53,10 +72,12 @@ struct FinishLine : Entity
 
   int id = 0;
   int touchDelay = 0;
+  int inside = 0; // bodies overlapping us
   float yaw = 0;
   float pitch = 0;
 };
 
 #include "entity_factory.h"
 static auto const reg3_ = registerEntity("finish", [] (IEntityConfig*) -> unique_ptr<Entity> { return make_unique<FinishLine>(); });
+static auto const reg4_ = registerTickLoop<FinishLine>("finish");
 
@@ -54,7 +54,7 @@ struct Hero : Player, Damageable
     if(0) // hide debug box
       view->sendActor(r);
 
-    view->setCameraPos(pos + size * 0.5, orientation);
+    view->setCameraPos(pos + size * 0.5, orientation, Vector3f(0, 0, 0));
 
     if(control.debug)
       view->setAmbientLight(1.0);
@@ -84,6 +84,11 @@ struct Hero : Player, Damageable
     flashLight += amount;
   }
 
+  std::unique_ptr<Player> clone() const override
+  {
+    return make_unique<Hero>(*this);
+  }
+
   void computeVelocity(Control c)
   {
     airMove(c);
@@ -149,16 +154,14 @@ struct Hero : Player, Damageable
 
     if(decrement(respawnDelay))
     {
-      pos = respawnPoint;
+      physics->teleport(this, respawnPoint);
       life = 31;
       blinking = 2000;
     }
 
     computeVelocity(control);
 
-    physics->moveBody(this, Vector3f(0, 0, STAIR_CLIMB));
-    slideMove(physics, this, vel);
-    physics->moveBody(this, Vector3f(0, 0, -STAIR_CLIMB));
+    physics->stepSlideMove(this, vel, STAIR_CLIMB);
 
     decrement(debounceLanding);
     decrement(debounceUse);
@@ -178,7 +181,7 @@ struct Hero : Player, Damageable
     }
 
     if(control.restart)
-      onDamage(10000);
+      game->restartLevel();
 
     collisionGroup = CG_PLAYER;
 
@@ -235,3 +238,6 @@ std::unique_ptr<Player> makeHero()
   return make_unique<Hero>();
 }
 
+
+#include "entity_factory.h"
+static auto const reg = registerTickLoop<Hero>("hero");
@@ -20,7 +20,7 @@ void slideMove(IPhysicsProbe* physics, Body* body, Vector delta)
 
 bool isOnGround(IPhysicsProbe* physics, Body* body)
 {
-  return physics->traceBox(body->getBox(), Down * 0.1, body).fraction < 1.0;
+  return physics->traceGround(body).fraction < 1.0;
 }
 
 Vector vectorFromAngles(float alpha, float beta)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "entity.h"
+#include <memory>
 
 struct Player : Entity
 {
@@ -8,6 +9,9 @@ struct Player : Entity
   virtual float health() = 0;
   virtual void addUpgrade(int upgrade) = 0;
   virtual void addEnergy(float amount) = 0;
+
+  // an identical player, to be spawned again
+  virtual std::unique_ptr<Player> clone() const = 0;
 };
 
 enum
@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio> // snprintf
 
 #include "base/scene.h"
 #include "base/util.h"
@@ -23,6 +24,7 @@ struct Switch : Entity, Switchable
   {
     size = UnitSize;
     solid = true;
+    tickPolicy = TickPolicy::Timer;
   }
 
   virtual void onDraw(View* view) const override
@@ -37,9 +39,9 @@ struct Switch : Entity, Switchable
     view->sendActor(r);
   }
 
-  virtual void tick() override
+  virtual void onWakeUp() override
   {
-    blinking = max(0, blinking - 1);
+    blinking = 0;
   }
 
   virtual void enter() override
@@ -52,12 +54,11 @@ struct Switch : Entity, Switchable
       return;
 
     blinking = 1200;
+    game->wakeUpIn(this, blinking);
     state = !state;
     game->playSound(SND_SWITCH);
 
-    auto evt = make_unique<TriggerEvent>();
-    evt->idx = id;
-    game->postEvent(move(evt));
+    game->postEvent(TriggerEvent(id));
 
     static const char* color[] =
     {
@@ -66,8 +67,9 @@ struct Switch : Entity, Switchable
       "Blue",
       "Yellow",
     };
-    const auto msg = color[id] + string(" forcefields disabled");
-    game->textBox(msg.c_str());
+    char msg[64];
+    snprintf(msg, sizeof msg, "%s forcefields disabled", color[id]);
+    game->textBox(msg);
   }
 
   bool state = false;
@@ -86,8 +88,10 @@ struct DetectorSwitch : Entity
     id = id_;
     size = UnitSize;
     solid = false;
+    trigger = true;
     collisionGroup = 0; // dont' trigger other detectors
     collidesWith = CG_PLAYER | CG_SOLIDPLAYER;
+    tickPolicy = TickPolicy::Timer;
   }
 
   virtual void onDraw(View* view) const override
@@ -97,35 +101,46 @@ struct DetectorSwitch : Entity
     view->sendActor(r);
   }
 
-  virtual void tick() override
+  virtual void onWakeUp() override
   {
-    decrement(touchDelay);
+    touchDelay = 0;
+
+    // still touched
+    if(inside > 0)
+      touch();
   }
 
-  virtual void enter() override
+  virtual void onTriggerEnter(Body*) override
+  {
+    inside++;
+    touch();
+  }
+
+  virtual void onTriggerExit(Body*) override
   {
-    Body::onCollision =
-      [ = ] (Body*)
-      {
-        if(touchDelay)
-          return;
+    inside--;
+  }
 
-        game->playSound(SND_SWITCH);
+  void touch()
+  {
+    if(touchDelay)
+      return;
+
+    game->playSound(SND_SWITCH);
 
-        auto evt = make_unique<TriggerEvent>();
-        evt->idx = id;
-        game->postEvent(move(evt));
+    game->postEvent(TriggerEvent(id));
 
-        touchDelay = 1000;
-      };
+    touchDelay = 1000;
+    game->wakeUpIn(this, touchDelay);
   }
 
   int id = 0;
   int touchDelay = 0;
+  int inside = 0; // bodies overlapping us
 };
 
 #include "entity_factory.h"
 static auto const reg1 = registerEntity("switch",
-                                        [] (IEntityConfig* args) { auto arg = args->getInt("0"); return makeSwitch(arg); }
+                                        [] (IEntityConfig* args) { auto arg = args->getInt(0); return makeSwitch(arg); }
                                         );
 
@@ -2,8 +2,11 @@
 
 #include "game.h"
 
-struct TriggerEvent : Event
+// keyed by 'idx'
+struct TriggerEvent : EventOf<TriggerEvent, EventType::Trigger>
 {
-  int idx {};
+  TriggerEvent(int idx_) : EventOf(idx_), idx(idx_) {}
+
+  int idx;
 };
 
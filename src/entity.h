@@ -10,8 +10,10 @@
 
 #include "base/geom.h"
 #include "base/scene.h"
+#include "base/span.h"
 #include "base/view.h"
 #include "body.h"
+#include "entity_arena.h"
 #include "game.h"
 #include "physics_probe.h"
 
@@ -28,30 +30,57 @@ struct Switchable
   virtual void onSwitch() = 0;
 };
 
+// A game tick is split in sub-ticks, for the physics
+static auto constexpr SUB_TICKS = 10;
+
+// How often the game needs to call 'Entity::tick'
+enum class TickPolicy
+{
+  EverySubTick, // 'SUB_TICKS' times per game tick
+  OncePerTick,
+  Timer, // never, 'onWakeUp' is called when the delay given to 'IGame::wakeUpIn' expires
+  Never, // the entity only reacts to events and collisions
+};
+
 struct Entity : Body
 {
   virtual ~Entity() = default;
 
-  virtual void enter()
-  {
-    Body::onCollision =
-      [ = ] (Body* otherBody)
-      {
-        auto other = dynamic_cast<Entity*>(otherBody);
-        assert(other);
-        onCollide(other);
-      };
-  }
+  // from the current 'EntityArena', if any
+  static void* operator new(size_t size) { return allocateEntity(size); }
+  static void operator delete(void* p) { freeEntity(p); }
+
+  virtual void enter() {}
 
   virtual void leave() {}
 
   virtual void onDraw(View* view) const = 0;
   virtual void tick() {}
+  virtual void onWakeUp() {}
+
+  // Leaves the game at the end of the tick. Only the first call counts.
+  void die()
+  {
+    if(dead)
+      return;
 
-  virtual void onCollide(Entity* /*other*/) {}
+    dead = true;
+
+    // not spawned yet: the game drops it when it comes
+    if(game)
+      game->despawn(this);
+  }
 
-  bool dead = false;
+  TickPolicy tickPolicy = TickPolicy::EverySubTick;
+
+  // 'tick' only modifies this entity, and only talks to the outside
+  // through 'game' and 'physics': it can run on a worker thread
+  // (see 'CommandBuffer').
+  bool parallelTick = false;
+  bool dead = false; // see 'die'
   int blinking = 0;
+  Vector prevPos; // 'pos' at the start of the last tick (see 'Actor::motion')
+  SlotHandle gameHandle; // set by the game, while the entity is part of it
   IGame* game = nullptr;
   IPhysicsProbe* physics = nullptr;
 
@@ -61,3 +90,34 @@ struct Entity : Body
   }
 };
 
+// Number of calls to 'Entity::tick' per game tick
+inline int getTickCount(TickPolicy policy)
+{
+  switch(policy)
+  {
+  case TickPolicy::EverySubTick:
+    return SUB_TICKS;
+  case TickPolicy::OncePerTick:
+    return 1;
+  case TickPolicy::Timer:
+  case TickPolicy::Never:
+    break;
+  }
+
+  return 0;
+}
+
+// Ticks entities whose concrete type is 'T', with non-virtual calls to
+// 'T::tick' (see 'registerTickLoop').
+template<typename T>
+void tickAs(Span<Entity* const> entities)
+{
+  for(auto entity : entities)
+  {
+    auto e = static_cast<T*>(entity);
+    auto const count = getTickCount(e->tickPolicy);
+
+    for(int i = 0; i < count; ++i)
+      e->T::tick();
+  }
+}
@@ -0,0 +1,156 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Per-level entity allocator: one pool per entity size.
+
+#include "entity_arena.h"
+#include "base/memory.h"
+#include <cassert>
+#include <new> // bad_alloc
+
+namespace
+{
+// entities per chunk
+auto const CHUNK_SIZE = 32;
+
+thread_local EntityArena* g_currentArena;
+
+// Precedes each entity: tells where to give its memory back.
+// Keeps the entity aligned like 'operator new' would.
+struct alignas(alignof(max_align_t)) Header
+{
+  EntityArena::Pool* pool; // null for heap entities
+  size_t bytes; // heap entities only, for the accounting
+};
+}
+
+struct EntityArena::Pool
+{
+  Pool(size_t size_) : size(size_) {}
+
+  void* allocate()
+  {
+    if(freeList)
+    {
+      auto r = freeList;
+      freeList = *(void**)r;
+      ++liveCount;
+      return r;
+    }
+
+    if(chunks.empty() || used == CHUNK_SIZE)
+    {
+      chunks.push_back(make_unique<uint8_t[]>(slotSize() * CHUNK_SIZE));
+      memory.set(memory.get() + slotSize() * CHUNK_SIZE);
+      used = 0;
+    }
+
+    ++liveCount;
+    return chunks.back().get() + slotSize() * used++;
+  }
+
+  void free(void* p)
+  {
+    *(void**)p = freeList;
+    freeList = p;
+    --liveCount;
+  }
+
+  size_t slotSize() const
+  {
+    auto const align = alignof(max_align_t);
+    return (sizeof(Header) + size + align - 1) / align * align;
+  }
+
+  const size_t size;
+  vector<unique_ptr<uint8_t[]>> chunks;
+  int used = 0; // slots of the last chunk
+  void* freeList = nullptr;
+  int liveCount = 0;
+  TrackedMemory memory { MemoryTag::Entities }; // of the chunks
+};
+
+EntityArena::EntityArena() = default;
+
+EntityArena::~EntityArena()
+{
+  release();
+}
+
+void EntityArena::release()
+{
+  assert(getLiveCount() == 0);
+  m_pools.clear();
+}
+
+int EntityArena::getLiveCount() const
+{
+  int r = 0;
+
+  for(auto& pool : m_pools)
+    r += pool->liveCount;
+
+  return r;
+}
+
+EntityArena::Pool& EntityArena::getPool(size_t size)
+{
+  for(auto& pool : m_pools)
+    if(pool->size == size)
+      return *pool;
+
+  m_pools.push_back(make_unique<Pool>(size));
+  return *m_pools.back();
+}
+
+EntityArena::Scope::Scope(EntityArena* arena) : previous(g_currentArena)
+{
+  g_currentArena = arena;
+}
+
+EntityArena::Scope::~Scope()
+{
+  g_currentArena = previous;
+}
+
+void* allocateEntity(size_t size)
+{
+  Header* header;
+
+  if(g_currentArena)
+  {
+    auto& pool = g_currentArena->getPool(size);
+    header = (Header*)pool.allocate();
+    header->pool = &pool;
+  }
+  else
+  {
+    header = (Header*)::operator new(sizeof(Header) + size);
+    header->pool = nullptr;
+    header->bytes = sizeof(Header) + size;
+    trackMemory(MemoryTag::Entities, header->bytes);
+  }
+
+  return header + 1;
+}
+
+void freeEntity(void* p)
+{
+  if(!p)
+    return;
+
+  auto header = (Header*)p - 1;
+
+  if(header->pool)
+  {
+    header->pool->free(header);
+  }
+  else
+  {
+    trackMemory(MemoryTag::Entities, -(int64_t)header->bytes);
+    ::operator delete(header);
+  }
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Memory of the entities of a level.
+// While an arena is current on a thread (see 'Scope'), the entities
+// created on this thread are allocated from it. Entities of the same size
+// (hence, of the same type) are packed together.
+// Other entities (e.g created on worker threads) come from the heap.
+
+#pragma once
+
+#include <cstddef> // size_t
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+struct EntityArena
+{
+  EntityArena();
+  ~EntityArena();
+
+  // Frees the memory of all the entities at once.
+  // All the entities of the arena must have been destroyed.
+  void release();
+
+  // number of entities currently allocated from this arena
+  int getLiveCount() const;
+
+  struct Scope
+  {
+    Scope(EntityArena* arena);
+    ~Scope();
+
+    EntityArena* const previous;
+  };
+
+  struct Pool;
+
+private:
+  Pool& getPool(size_t size);
+
+  vector<unique_ptr<Pool>> m_pools;
+
+  friend void* allocateEntity(size_t size);
+};
+
+// used by 'Entity::operator new/delete'
+void* allocateEntity(size_t size);
+void freeEntity(void* p);
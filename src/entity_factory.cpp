@@ -8,33 +8,110 @@
 
 #include "entity.h"
 #include "entity_factory.h"
+#include <algorithm> // lower_bound
 #include <map>
 #include <stdexcept>
+#include <typeindex>
+#include <vector>
 
 using namespace std;
 
 namespace
 {
-map<string, CreationFunc> & g_registry()
+struct TickLoopEntry
 {
-  static map<string, CreationFunc> registry;
+  string name;
+  type_index type;
+  TickLoop loop;
+};
+
+struct Registry
+{
+  map<string, int> types; // index in 'funcs'
+  vector<CreationFunc> funcs;
+  vector<TickLoopEntry> tickLoops; // sorted by name
+};
+
+// Only written during static initialization.
+// Afterwards, it's read-only: several game worlds can use it concurrently.
+Registry& g_registry()
+{
+  static Registry registry;
   return registry;
 }
 }
 
 int registerEntity(string type, CreationFunc func)
 {
-  g_registry()[type] = func;
+  auto& registry = g_registry();
+  auto i = registry.types.find(type);
+
+  if(i != registry.types.end())
+  {
+    registry.funcs[i->second] = func;
+  }
+  else
+  {
+    registry.types[type] = (int)registry.funcs.size();
+    registry.funcs.push_back(func);
+  }
+
   return 0; // ignored
 }
 
-unique_ptr<Entity> createEntity(string name, IEntityConfig* args)
+int findEntityType(string name)
 {
-  auto i_func = g_registry().find(name);
+  auto const& registry = g_registry();
+  auto i = registry.types.find(name);
 
-  if(i_func == g_registry().end())
+  if(i == registry.types.end())
     throw runtime_error("unknown entity type: '" + name + "'");
 
-  return (*i_func).second(args);
+  return i->second;
+}
+
+unique_ptr<Entity> createEntity(int type, IEntityConfig* args)
+{
+  return g_registry().funcs[type](args);
+}
+
+unique_ptr<Entity> createEntity(string name, IEntityConfig* args)
+{
+  return createEntity(findEntityType(name), args);
+}
+
+int registerTickLoop(string name, type_info const& type, TickLoop loop)
+{
+  auto& loops = g_registry().tickLoops;
+  auto byName = [] (TickLoopEntry const& entry, string const& name) { return entry.name < name; };
+  auto i = lower_bound(loops.begin(), loops.end(), name, byName);
+
+  if(i != loops.end() && i->name == name)
+    *i = { name, type_index(type), loop };
+  else
+    loops.insert(i, { name, type_index(type), loop });
+
+  return 0; // ignored
 }
 
+int findTickLoop(Entity const& e)
+{
+  auto const& loops = g_registry().tickLoops;
+  auto const type = type_index(typeid(e));
+
+  for(int i = 0; i < (int)loops.size(); ++i)
+    if(loops[i].type == type)
+      return i;
+
+  return -1;
+}
+
+int getTickLoopCount()
+{
+  return (int)g_registry().tickLoops.size();
+}
+
+TickLoop getTickLoop(int index)
+{
+  return g_registry().tickLoops[index].loop;
+}
@@ -8,15 +8,19 @@
 
 #include <memory>
 #include <string>
+#include <typeinfo>
 
 using namespace std;
 
+#include "base/span.h"
+
 struct Entity;
 
+// positional arguments, e.g '4' in 'door(4)'
 struct IEntityConfig
 {
-  virtual string getString(const char* varName, string defaultValue = "") = 0;
-  virtual int getInt(const char* varName, int defaultValue = 0) = 0;
+  virtual string getString(int argIndex, string defaultValue = "") = 0;
+  virtual int getInt(int argIndex, int defaultValue = 0) = 0;
 };
 
 // e.g:
@@ -24,6 +28,32 @@ struct IEntityConfig
 // createEntity("door(4)");
 std::unique_ptr<Entity> createEntity(string name, IEntityConfig* config);
 
+// Returns the type id of 'name', to be used with 'createEntity'.
+// Ids aren't stable from one build to the next: don't store them.
+int findEntityType(string name);
+std::unique_ptr<Entity> createEntity(int type, IEntityConfig* config);
+
 using CreationFunc = unique_ptr<Entity>(*)(IEntityConfig* args);
 int registerEntity(string type, CreationFunc func);
 
+// Tick loops: one per concrete entity type, ticking all the entities of
+// this type in a row, without virtual calls.
+// The game runs them in a fixed order: by name.
+using TickLoop = void(*)(Span<Entity* const> entities);
+int registerTickLoop(string name, type_info const& type, TickLoop loop);
+
+template<typename T>
+void tickAs(Span<Entity* const> entities); // see entity.h
+
+// e.g: registerTickLoop<Amulet>("amulet");
+template<typename T>
+int registerTickLoop(string name)
+{
+  return registerTickLoop(name, typeid(T), &tickAs<T>);
+}
+
+// Index of the loop ticking 'e', in run order.
+// -1 if its type has none: it's ticked through the virtual 'Entity::tick'.
+int findTickLoop(Entity const& e);
+int getTickLoopCount();
+TickLoop getTickLoop(int index);
@@ -18,8 +18,7 @@ Span<const Resource> getResources();
 
 void preloadResources(View* view)
 {
-  for(auto res : getResources())
-    view->preload(res);
+  view->preloadAll(getResources());
 }
 
 Scene* createGame(View* view, vector<string> args)
@@ -27,16 +26,37 @@ Scene* createGame(View* view, vector<string> args)
   view->setTitle("C - O - I - I - L");
   preloadResources(view);
 
+  // game options
+  GameOptions options;
+
+  for(auto it = args.begin(); it != args.end();)
+  {
+    if(*it == "--parallel-ticks")
+    {
+      options.parallelTicks = true;
+      it = args.erase(it);
+    }
+    else if(*it == "--sync-load")
+    {
+      options.syncLoad = true;
+      it = args.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
   if(args.size() == 1)
   {
     int level = atoi(args[0].c_str());
 
     if(level == -1)
-      return createEndingState(view);
+      return createEndingState(view, options);
 
-    return createPlayingStateAtLevel(view, level);
+    return createPlayingStateAtLevel(view, level, options);
   }
 
-  return createSplashState(view);
+  return createSplashState(view, options);
 }
 
@@ -11,27 +11,60 @@
 #include "base/geom.h"
 #include "base/scene.h"
 #include "base/view.h"
-#include <functional>
+#include <climits> // INT_MIN
 #include <memory>
+#include <type_traits>
 
 typedef Matrix3<int> Matrix;
 typedef Vector3f Vector;
 
 struct Entity;
 
+// one per event class
+enum class EventType
+{
+  TouchLevelBoundary,
+  Trigger,
+};
+
+// subscribes to all the events of a type, whatever their key
+int const ANY_EVENT_KEY = INT_MIN;
+
+// biggest event class, in bytes
+int const MAX_EVENT_SIZE = 64;
+
+// An event is only delivered to the sinks subscribed to its type and key.
+// Events are posted by value, and copied as raw bytes when they need to be
+// kept: see 'EventOf'.
 struct Event
 {
-  // force a vtable so we can dynamic_cast events
-  virtual ~Event() = default;
+  Event(EventType type_, int size_, int key_) : type(type_), size(size_), key(key_) {}
 
   template<typename T>
   const T* as() const
   {
-    return dynamic_cast<const T*>(this);
+    return type == T::TYPE ? static_cast<const T*>(this) : nullptr;
+  }
+
+  EventType type;
+  int size; // of the full event, in bytes
+  int key;
+};
+
+// Base of the event classes.
+template<typename Derived, EventType Type>
+struct EventOf : Event
+{
+  static auto const TYPE = Type;
+
+  EventOf(int key = 0) : Event(Type, sizeof(Derived), key)
+  {
+    static_assert(sizeof(Derived) <= MAX_EVENT_SIZE, "Event too big");
+    static_assert(is_trivially_copyable<Derived>::value, "Events must be copyable as raw bytes");
   }
 };
 
-struct TouchLevelBoundary : Event
+struct TouchLevelBoundary : EventOf<TouchLevelBoundary, EventType::TouchLevelBoundary>
 {
   TouchLevelBoundary(int targetLevel_, Vector transform_)
   {
@@ -43,14 +76,15 @@ struct TouchLevelBoundary : Event
   Vector transform {};
 };
 
-struct IEventSink
+// visual effects, see 'ParticleSystem'
+enum class EffectType
 {
-  virtual void notify(const Event* evt) = 0;
+  Explosion,
 };
 
-struct Handle
+struct IEventSink
 {
-  virtual ~Handle() = default;
+  virtual void notify(const Event* evt) = 0;
 };
 
 struct IGame
@@ -60,12 +94,28 @@ struct IGame
   // visual
   virtual void textBox(char const* msg) = 0;
   virtual void playSound(int id) = 0;
+  virtual void spawnEffect(EffectType /*type*/, Vector /*pos*/) {}
 
   // logic
   virtual void spawn(Entity* e) = 0;
-  virtual void postEvent(unique_ptr<Event> event) = 0;
-  virtual unique_ptr<Handle> subscribeForEvents(IEventSink*) = 0;
+
+  // Removes 'e' from the game at the end of the tick (see 'Entity::die').
+  virtual void despawn(Entity* e) = 0;
+  virtual void postEvent(const Event& event) = 0;
+
+  // Returns a subscription id, to be given to 'unsubscribeForEvents'.
+  // Subscriptions end with the level.
+  virtual int subscribeForEvents(IEventSink* sink, EventType type, int key = ANY_EVENT_KEY) = 0;
+  virtual void unsubscribeForEvents(int subscription) = 0;
   virtual Vector getPlayerPosition() = 0;
+
+  // Calls 'e->onWakeUp()' in 'subTicks' sub-ticks (there are 10 per tick),
+  // replacing any previous wake-up of 'e'.
+  virtual void wakeUpIn(Entity* e, int subTicks) = 0;
   virtual void endLevel() {}
+
+  // Rewinds the level to how it was when the player entered it.
+  // Takes effect at the next tick.
+  virtual void restartLevel() {}
 };
 
@@ -0,0 +1,178 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+#include "particles.h"
+
+#include <cmath> // sqrt, cos, sin
+#include <stdexcept>
+
+#include "base/util.h" // unstableRemove
+#include "models.h"
+
+EmitterDesc const& getEmitterDesc(EffectType type)
+{
+  // sparks flying out of a broken door, fading in half a second
+  static EmitterDesc const explosion { MDL_RECT, 16, 3, 0.06f, 0.05f, 0.2f, 50 };
+
+  switch(type)
+  {
+  case EffectType::Explosion:
+    return explosion;
+  }
+
+  throw runtime_error("Unknown effect type");
+}
+
+void ParticleSystem::startEmitter(EmitterDesc const& desc, Vector pos)
+{
+  m_emitters.push_back({ desc, pos, desc.ticks });
+}
+
+void ParticleSystem::tick()
+{
+  for(auto& emitter : m_emitters)
+  {
+    auto& pool = getPool(emitter.desc.model);
+
+    for(int i = 0; i < emitter.desc.perTick; ++i)
+      pool.add(emitter.pos, randomDirection() * emitter.desc.speed, emitter.desc);
+
+    --emitter.ticksLeft;
+  }
+
+  unstableRemove(m_emitters, [] (Emitter const& e) { return e.ticksLeft <= 0; });
+
+  for(auto& pool : m_pools)
+    pool.tick();
+}
+
+void ParticleSystem::draw(View* view)
+{
+  for(auto& pool : m_pools)
+  {
+    if(pool.count() == 0)
+      continue;
+
+    m_drawn.resize(pool.count());
+
+    for(int i = 0; i < pool.count(); ++i)
+    {
+      auto& p = m_drawn[i];
+      p.pos = Vector(pool.x[i], pool.y[i], pool.z[i]);
+      p.size = pool.size[i] * (1 - pool.age[i] / (float)pool.lifetime[i]);
+      p.motion = Vector(pool.vx[i], pool.vy[i], pool.vz[i]);
+    }
+
+    view->sendParticles(pool.model, m_drawn);
+  }
+}
+
+void ParticleSystem::clear()
+{
+  m_emitters.clear();
+  m_pools.clear();
+}
+
+int ParticleSystem::getParticleCount() const
+{
+  int r = 0;
+
+  for(auto& pool : m_pools)
+    r += pool.count();
+
+  return r;
+}
+
+ParticleSystem::Pool& ParticleSystem::getPool(int model)
+{
+  for(auto& pool : m_pools)
+    if(pool.model == model)
+      return pool;
+
+  m_pools.push_back({});
+  m_pools.back().model = model;
+  return m_pools.back();
+}
+
+// uniform on the sphere, from a xorshift generator
+Vector ParticleSystem::randomDirection()
+{
+  auto next = [&] ()
+    {
+      m_seed ^= m_seed << 13;
+      m_seed ^= m_seed >> 17;
+      m_seed ^= m_seed << 5;
+      return (m_seed & 0xffffff) / float(0x1000000);
+    };
+
+  auto const z = next() * 2 - 1;
+  auto const angle = next() * 2 * PI;
+  auto const r = sqrt(1 - z * z);
+  return Vector(r * cos(angle), r * sin(angle), z);
+}
+
+void ParticleSystem::Pool::add(Vector pos, Vector vel, EmitterDesc const& desc)
+{
+  x.push_back(pos.x);
+  y.push_back(pos.y);
+  z.push_back(pos.z);
+  vx.push_back(vel.x);
+  vy.push_back(vel.y);
+  vz.push_back(vel.z);
+  size.push_back(desc.size);
+  drag.push_back(1 - desc.drag);
+  age.push_back(0);
+  lifetime.push_back(desc.lifetime);
+}
+
+void ParticleSystem::Pool::tick()
+{
+  int const n = count();
+
+  for(int i = 0; i < n; ++i)
+  {
+    vx[i] *= drag[i];
+    vy[i] *= drag[i];
+    vz[i] *= drag[i];
+  }
+
+  // the velocity is then the move of this tick: see 'Particle::motion'
+  for(int i = 0; i < n; ++i)
+  {
+    x[i] += vx[i];
+    y[i] += vy[i];
+    z[i] += vz[i];
+  }
+
+  for(int i = 0; i < n; ++i)
+    ++age[i];
+
+  // the dead ones are replaced by the last ones
+  int alive = n;
+
+  for(int i = 0; i < alive;)
+  {
+    if(age[i] < lifetime[i])
+    {
+      ++i;
+      continue;
+    }
+
+    --alive;
+
+    for(auto array : { &x, &y, &z, &vx, &vy, &vz, &size, &drag })
+      (*array)[i] = (*array)[alive];
+
+    age[i] = age[alive];
+    lifetime[i] = lifetime[alive];
+  }
+
+  for(auto array : { &x, &y, &z, &vx, &vy, &vz, &size, &drag })
+    array->resize(alive);
+
+  age.resize(alive);
+  lifetime.resize(alive);
+}
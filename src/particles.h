@@ -0,0 +1,77 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Particles: the visual effects (e.g explosions), without an entity, nor a
+// physics body, each. An effect starts emitters, which spawn particles for
+// a few ticks. The particles of a model live in flat arrays, one per
+// attribute, and are sent to the view as a single batch.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+#include "base/view.h"
+#include "game.h" // EffectType, Vector
+
+struct EmitterDesc
+{
+  int model;
+  int perTick; // particles spawned on each tick
+  int ticks; // how long it emits
+  float speed; // initial, in units per tick, in a random direction
+  float drag; // fraction of the speed lost on each tick
+  float size; // initial, shrinks to zero over the lifetime
+  int lifetime; // in ticks, of each particle
+};
+
+EmitterDesc const& getEmitterDesc(EffectType type);
+
+struct ParticleSystem
+{
+  void startEmitter(EmitterDesc const& desc, Vector pos);
+
+  // one game tick: emission, then motion
+  void tick();
+
+  // the particles, one batch per model
+  void draw(View* view);
+
+  void clear();
+
+  int getParticleCount() const;
+
+private:
+  struct Emitter
+  {
+    EmitterDesc desc;
+    Vector pos;
+    int ticksLeft;
+  };
+
+  // structure of arrays: the tick streams through each attribute
+  struct Pool
+  {
+    int model;
+    vector<float> x, y, z;
+    vector<float> vx, vy, vz;
+    vector<float> size, drag;
+    vector<int> age, lifetime;
+
+    void add(Vector pos, Vector vel, EmitterDesc const& desc);
+    void tick();
+    int count() const { return (int)age.size(); }
+  };
+
+  Pool& getPool(int model);
+  Vector randomDirection();
+
+  vector<Emitter> m_emitters;
+  vector<Pool> m_pools;
+  vector<Particle> m_drawn; // reused by 'draw'
+  uint32_t m_seed = 1; // deterministic: the same tick gives the same particles
+};
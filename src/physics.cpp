@@ -8,35 +8,170 @@
 // Only handles collision detection and moving.
 // Doesn't know about acceleration or velocity.
 
+#include "aabb_tree.h"
+#include "base/profiler.h"
 #include "base/util.h"
 #include "body.h"
 #include "convex.h"
 #include "physics.h"
-#include <algorithm> // find
+#include "slot_map.h"
+#include "static_world.h"
+#include "trigger_grid.h"
+#include <algorithm> // find, upper_bound
+#include <chrono>
 #include <memory>
 #include <vector>
 
 using namespace std;
 
+// length of the downward trace used to find the ground under a body
+static auto const GROUND_PROBE = 0.1f;
+
+// Bodies are also sorted into one tree per collision group bit,
+// for the bits used in 'collision_groups.h'.
+// A body changing its collision group is re-sorted at its next move,
+// or at the next 'checkForOverlaps'.
+static auto const GROUP_BUCKETS = 4;
+
+// Bodies that didn't move for this many ticks fall asleep.
+// They are woken up by any move, or by the contact of a moving body.
+static auto const SLEEP_TICKS = 60;
+
+// extra room for the small moves done by collision handlers
+// during a step move (e.g conveyors)
+static auto const STEP_MARGIN = 0.1f;
+
 struct Physics : IPhysics
 {
+  Physics() : m_world(make_shared<StaticWorld>())
+  {
+  }
+
   void addBody(Body* body) override
   {
-    m_bodies.push_back(body);
+    flushSweepRemovals();
+
+    body->physicsHandle = m_infos.add({});
+
+    auto const slot = body->physicsHandle.index;
+
+    if(slot >= (int)m_bodies.size())
+    {
+      m_bodies.resize(slot + 1);
+      m_boxes.resize(slot + 1);
+      m_groups.resize(slot + 1);
+      m_orders.resize(slot + 1);
+    }
+
+    m_bodies[slot] = body;
+    m_orders[slot] = m_nextOrder++;
+
+    if(body->trigger)
+    {
+      addTrigger(body);
+      return;
+    }
+
+    auto& info = getInfo(body);
+    info.proxy = m_tree.insert(body->getBox(), toUserData(slot));
+    info.lastBox = body->getBox();
+    info.lastSolid = body->solid;
+    info.triggersDirty = true;
+
+    for(auto& proxy : info.groupProxies)
+      proxy = -1;
+
+    refit(body);
+    invalidateGroundCaches(body->getBox());
+
+    // might be left over from another world (e.g the previous level)
+    body->ground = {};
+
+    auto byLeft = [&] (int a, int b) { return m_boxes[a].pos.x < m_boxes[b].pos.x; };
+    m_sweepList.insert(upper_bound(m_sweepList.begin(), m_sweepList.end(), slot, byLeft), slot);
   }
 
   void removeBody(Body* body) override
   {
-    auto isItTheOne =
-      [ = ] (Body* candidate) { return candidate == body; };
-    unstableRemove(m_bodies, isItTheOne);
+    if(body->trigger)
+    {
+      removeTrigger(body);
+      return;
+    }
+
+    invalidateGroundCaches(body->getBox());
+
+    setGround(body, nullptr);
+
+    auto& info = getInfo(body);
+    m_tree.remove(info.proxy);
+
+    for(int bit = 0; bit < GROUP_BUCKETS; ++bit)
+    {
+      if(info.groupProxies[bit] != -1)
+        m_groupTrees[bit].remove(info.groupProxies[bit]);
+    }
+
+    auto const slot = body->physicsHandle.index;
+    m_bodies[slot] = nullptr;
+
+    auto const contacts = move(info.contacts);
+
+    for(auto trigger : contacts)
+      eraseSorted(m_infos.getBySlot(trigger)->contacts, slot);
+
+    m_infos.remove(body->physicsHandle);
+    body->physicsHandle = {};
+
+    // the sweep list is cleaned up in one pass, before its next use
+    m_sweepRemovals.push_back(slot);
+
+    // last: the handlers might remove other bodies
+    for(auto trigger : contacts)
+    {
+      if(m_bodies[trigger])
+        m_bodies[trigger]->onTriggerExit(body);
+    }
   }
 
   Trace moveBody(Body* body, Vector delta) override
   {
+    PROFILE_SCOPE("Physics::moveBody");
+    Timer timer(this);
+    return moveBody(body, delta, nullptr);
+  }
+
+  void teleport(Body* body, Vector pos) override
+  {
+    Timer timer(this);
+
+    invalidateGroundCaches(body->getBox());
+    body->pos = pos;
+    invalidateGroundCaches(body->getBox());
+
+    refit(body);
+    wakeUp(body);
+  }
+
+  // What can block a move: gathered once, then traced against many times.
+  struct Candidates
+  {
+    vector<int> bodies; // slots, see 'm_bodies'
+    vector<int> brushes; // in 'm_world'
+  };
+
+  // 'candidates': if not null, the only things that can block the move.
+  Trace moveBody(Body* body, Vector delta, Candidates const* candidates)
+  {
+    // the body might have been teleported since its last move
+    refit(body);
+
+    if(delta.x || delta.y || delta.z)
+      wakeUp(body);
+
     auto rect = body->getBox();
 
-    auto const trace = traceBox(rect, delta, body);
+    auto const trace = traceBox(rect, delta, body, candidates);
 
     delta = delta * trace.fraction;
 
@@ -45,39 +180,157 @@ struct Physics : IPhysics
     if(trace.blocker)
       collideBodies(*body, *trace.blocker);
 
+    if(delta.x || delta.y || delta.z)
+      invalidateGroundCaches(unite(body->getBox(), rect));
+
     body->pos += delta;
+    refit(body);
 
     if(body->pusher)
     {
-      for(auto otherBody : m_bodies)
-      {
-        // skip ourselves
-        if(otherBody == body)
-          continue;
+      // move stacked bodies
+      vector<Body*> carried;
 
-        // move stacked bodies
-        // push potential non-solid bodies
-        if(otherBody->ground == body || overlaps(rect, otherBody->getBox()))
-          moveBody(otherBody, delta);
-      }
+      for(auto rider : getInfo(body).riders)
+        carried.push_back(m_bodies[rider]);
+
+      // push potential non-solid bodies
+      auto onCandidate = [&] (int proxy)
+        {
+          auto const slot = toSlot(m_tree.getUserData(proxy));
+          auto otherBody = m_bodies[slot];
+
+          // skip ourselves
+          if(otherBody == body)
+            return;
+
+          if(overlaps(rect, m_boxes[slot]) && otherBody->ground != body->physicsHandle)
+            carried.push_back(otherBody);
+        };
+
+      m_tree.query(rect, onCandidate);
+
+      // keep a deterministic order, whatever the layout of the tree
+      auto byOrder = [&] (Body* a, Body* b) { return getOrder(a) < getOrder(b); };
+      sort(carried.begin(), carried.end(), byOrder);
+
+      m_stats.pushed += (int)carried.size();
+
+      for(auto otherBody : carried)
+        moveBody(otherBody, delta);
     }
 
     // update ground
     if(!body->pusher)
     {
-      auto const trace = traceBox(rect, Down * 0.1, body);
+      auto const trace = traceGround(body, candidates);
 
       if(trace.fraction < 1.0)
-        body->ground = trace.blocker;
+        setGround(body, trace.blocker);
     }
 
     return trace;
   }
 
+  // Same as: moveBody(up), slideMove(delta), moveBody(down).
+  // The bodies and brushes that can be touched along the way are gathered only once.
+  void stepSlideMove(Body* body, Vector delta, float stepHeight) override
+  {
+    Timer timer(this);
+    Candidates const* candidates = nullptr;
+
+    // pushers move other bodies around: don't cache anything
+    if(!body->pusher)
+    {
+      // sliding never moves further than 'delta', whatever the direction
+      auto const reach = magnitude(delta) + GROUND_PROBE + STEP_MARGIN;
+
+      auto region = body->getBox();
+      region.pos -= Vector(reach, reach, reach + stepHeight);
+      region.size.cx += reach * 2;
+      region.size.cy += reach * 2;
+      region.size.cz += (reach + stepHeight) * 2;
+
+      gather(region, m_stepCandidates);
+      candidates = &m_stepCandidates;
+    }
+
+    moveBody(body, Up * stepHeight, candidates);
+
+    // same as 'slideMove'
+    for(int i = 0; i < 5; ++i)
+    {
+      auto tr = moveBody(body, delta, candidates);
+
+      if(tr.fraction == 1.0)
+        break;
+
+      // remove from 'delta' the fraction of the move that succeeded
+      auto const actual = tr.fraction * delta;
+      delta -= actual;
+
+      // remove from 'delta' its component along the collision normal
+      delta -= dotProduct(delta, tr.plane.N) * tr.plane.N;
+    }
+
+    moveBody(body, Down * stepHeight, candidates);
+  }
+
+  Trace traceGround(const Body* body) const override
+  {
+    Timer timer(this);
+    return traceGround(body, nullptr);
+  }
+
+  // Ground traces are cached per body, and reused as long as nothing
+  // moves near the body (see 'invalidateGroundCaches').
+  Trace traceGround(const Body* body, Candidates const* candidates) const
+  {
+    auto& cache = getInfo(body).groundCache;
+    auto const box = body->getBox();
+
+    if(cache.valid && sameBox(cache.box, box))
+    {
+      // solidity can change at any time
+      if(!cache.trace.blocker || cache.trace.blocker->solid)
+        return cache.trace;
+    }
+
+    cache.trace = traceBox(box, Down * GROUND_PROBE, body, candidates);
+    cache.box = box;
+    cache.valid = true;
+
+    return cache.trace;
+  }
+
+  // Something appeared, disappeared or moved inside 'region':
+  // the ground traces of the bodies right above it can't be trusted anymore.
+  void invalidateGroundCaches(Box region) const
+  {
+    region.size.cz += GROUND_PROBE;
+
+    auto onCandidate = [&] (int proxy)
+      {
+        auto const slot = toSlot(m_tree.getUserData(proxy));
+        m_infos.getBySlot(slot)->groundCache.valid = false;
+      };
+
+    m_tree.query(region, onCandidate);
+  }
+
   Trace traceBox(Box rect, Vector delta, const Body* except) const override
   {
+    Timer timer(this);
+    return traceBox(rect, delta, except, nullptr);
+  }
+
+  Trace traceBox(Box rect, Vector delta, const Body* except, Candidates const* candidates) const
+  {
+    if(candidates)
+      return traceBoxThroughCandidates(rect, delta, except, *candidates);
+
     auto traceBodies = traceBoxThroughBodies(rect, delta, except);
-    auto traceEdifice = traceBoxThroughEdifice(rect, delta);
+    auto traceEdifice = toTrace(m_world->trace(rect, delta));
 
     if(traceBodies.fraction < traceEdifice.fraction)
       return traceBodies;
@@ -85,17 +338,78 @@ struct Physics : IPhysics
       return traceEdifice;
   }
 
-  Trace traceBoxThroughEdifice(Box box, Vector delta) const
+  static Trace toTrace(::Trace const& t)
   {
-    auto t = m_traceEdifice(box, delta);
     Trace r {};
     r.fraction = t.fraction;
     r.plane = t.plane;
     return r;
   }
 
+  void traceBoxes(Span<const TraceQuery> queries, Span<Trace> results) const override
+  {
+    if(queries.len == 0)
+      return;
+
+    Timer timer(this);
+
+    // gather candidate bodies and brushes once for the whole batch
+    auto region = sweptBox(queries[0].box, queries[0].delta, 0);
+
+    for(auto& q : queries)
+      region = unite(region, sweptBox(q.box, q.delta, 0));
+
+    gather(region, m_candidates);
+
+    for(int i = 0; i < queries.len; ++i)
+    {
+      auto& q = queries[i];
+      results[i] = traceBoxThroughCandidates(q.box, q.delta, q.except, m_candidates);
+    }
+  }
+
   Trace traceBoxThroughBodies(Box box, Vector delta, const Body* except) const
   {
+    gatherBodies(sweptBox(box, delta, 0), m_candidates.bodies);
+    return traceBoxThroughBodies(box, delta, except, m_candidates.bodies);
+  }
+
+  // fills 'result' with everything that might touch 'region'
+  void gather(Box region, Candidates& result) const
+  {
+    gatherBodies(region, result.bodies);
+    m_world->gather(region, result.brushes);
+  }
+
+  // fills 'result' with the slots of the bodies whose fat box touches 'region'
+  void gatherBodies(Box region, vector<int>& result) const
+  {
+    result.clear();
+
+    auto onCandidate = [&] (int proxy)
+      {
+        result.push_back(toSlot(m_tree.getUserData(proxy)));
+      };
+
+    m_tree.query(region, onCandidate);
+  }
+
+  Trace traceBoxThroughCandidates(Box box, Vector delta, const Body* except, Candidates const& candidates) const
+  {
+    auto traceBodies = traceBoxThroughBodies(box, delta, except, candidates.bodies);
+    auto traceEdifice = toTrace(m_world->traceCandidates(box, delta, candidates.brushes));
+
+    if(traceBodies.fraction < traceEdifice.fraction)
+      return traceBodies;
+    else
+      return traceEdifice;
+  }
+
+  Trace traceBoxThroughBodies(Box box, Vector delta, const Body* except, vector<int> const& candidates) const
+  {
+    m_stats.traces++;
+    m_stats.bodies += (int)candidates.size();
+
     auto const halfSize = Vector3f(box.size.cx, box.size.cy, box.size.cz) * 0.5;
 
     auto const A = box.pos + halfSize;
@@ -103,55 +417,261 @@ struct Physics : IPhysics
 
     Trace r {};
     r.fraction = 1.0;
+    r.blocker = nullptr;
 
-    Convex b;
-    b.planes.resize(6);
+    int blockerOrder = 0;
 
-    for(auto other : m_bodies)
+    for(auto slot : candidates)
     {
+      auto const other = m_bodies[slot];
+
       if(other == except)
         continue;
 
+      // checked here, as solidity can change after the gathering
       if(!other->solid)
         continue;
 
-      b.planes[0] = Plane { Vector3f(-1, 0, 0), -other->pos.x };
-      b.planes[1] = Plane { Vector3f(+1, 0, 0), other->pos.x + other->size.cx };
-      b.planes[2] = Plane { Vector3f(0, -1, 0), -other->pos.y };
-      b.planes[3] = Plane { Vector3f(0, +1, 0), other->pos.y + other->size.cy };
-      b.planes[4] = Plane { Vector3f(0, 0, -1), -other->pos.z };
-      b.planes[5] = Plane { Vector3f(0, 0, +1), other->pos.z + other->size.cz };
+      auto tr = traceThroughBox(A, B, halfSize, m_boxes[slot]);
 
-      auto tr = b.trace(A, B, halfSize);
+      // on ties, the oldest body wins, whatever the order of the tree
+      auto const order = m_orders[slot];
 
-      if(tr.fraction < r.fraction)
+      if(tr.fraction < r.fraction || (tr.fraction == r.fraction && r.blocker && order < blockerOrder))
       {
         r.fraction = tr.fraction;
         r.plane = tr.plane;
         r.blocker = other;
+        blockerOrder = order;
       }
     }
 
     return r;
   }
 
+  // Sort and sweep along the X axis.
+  // Bodies barely move from one tick to the next, so the list
+  // from the previous pass is almost sorted: repairing it is near-linear.
   void checkForOverlaps() override
   {
-    for(auto p : allPairs((int)m_bodies.size()))
+    Timer timer(this);
+
+    flushSweepRemovals();
+
+    // every live body is in the sweep list
+    for(auto slot : m_sweepList)
+    {
+      auto const body = m_bodies[slot];
+      auto& info = *m_infos.getBySlot(slot);
+      auto const box = body->getBox();
+
+      // teleported bodies wake up too
+      if(!sameBox(box, info.lastBox))
+      {
+        invalidateGroundCaches(info.lastBox);
+        invalidateGroundCaches(box);
+        info.lastBox = box;
+        info.idleTicks = 0;
+        info.triggersDirty = true;
+      }
+      else if(info.idleTicks < SLEEP_TICKS)
+      {
+        info.idleTicks++;
+      }
+
+      if(body->solid != info.lastSolid)
+      {
+        invalidateGroundCaches(box);
+        info.lastSolid = body->solid;
+      }
+
+      // the flat arrays catch up with the teleports
+      refit(body);
+
+      if(info.triggersDirty)
+        updateTriggers(slot);
+    }
+
+    sortSweepList();
+
+    auto const count = (int)m_sweepList.size();
+
+    // the boxes in sweep order: the inner loop reads them contiguously
+    m_sweepBoxes.resize(count);
+    m_sweepAsleep.resize(count);
+
+    for(int i = 0; i < count; ++i)
+    {
+      m_sweepBoxes[i] = m_boxes[m_sweepList[i]];
+      m_sweepAsleep[i] = m_infos.getBySlot(m_sweepList[i])->idleTicks >= SLEEP_TICKS;
+    }
+
+    for(int i = 0; i < count; ++i)
+    {
+      auto const rect = m_sweepBoxes[i];
+      auto const right = rect.pos.x + rect.size.cx;
+
+      for(int j = i + 1; j < count; ++j)
+      {
+        auto const& other = m_sweepBoxes[j];
+
+        if(other.pos.x > right)
+          break;
+
+        // nothing new can happen between two sleeping bodies
+        if(m_sweepAsleep[i] && m_sweepAsleep[j])
+          continue;
+
+        if(overlaps(rect, other))
+          collideBodies(*m_bodies[m_sweepList[i]], *m_bodies[m_sweepList[j]]);
+      }
+    }
+
+    // last: the handlers might move bodies
+    for(auto& event : m_triggerEvents)
+    {
+      if(event.enter)
+        event.trigger->onTriggerEnter(event.other);
+      else
+        event.trigger->onTriggerExit(event.other);
+    }
+
+    m_triggerEvents.clear();
+  }
+
+  // Triggers stay out of the trees and of the sweep list: nothing collides
+  // with them, only 'updateTriggers' finds them.
+  void addTrigger(Body* body)
+  {
+    auto const slot = body->physicsHandle.index;
+    auto const box = body->getBox();
+
+    auto& info = getInfo(body);
+    info.proxy = -1;
+
+    for(auto& proxy : info.groupProxies)
+      proxy = -1;
+
+    m_boxes[slot] = box;
+    m_groups[slot] = body->collisionGroup;
+    m_triggers.insert(slot, box);
+
+    // the bodies already inside enter at the next 'checkForOverlaps'
+    auto onCandidate = [&] (int proxy)
+      {
+        auto const other = toSlot(m_tree.getUserData(proxy));
+        m_infos.getBySlot(other)->triggersDirty = true;
+      };
+
+    m_tree.query(box, onCandidate);
+  }
+
+  void removeTrigger(Body* body)
+  {
+    auto const slot = body->physicsHandle.index;
+    m_triggers.remove(slot);
+
+    for(auto other : getInfo(body).contacts)
+      eraseSorted(m_infos.getBySlot(other)->contacts, slot);
+
+    m_bodies[slot] = nullptr;
+    m_infos.remove(body->physicsHandle);
+    body->physicsHandle = {};
+  }
+
+  // Compares the triggers a body overlaps with the ones it overlapped:
+  // queues the enter and exit events.
+  // Only called for the bodies which moved: the triggers never do.
+  void updateTriggers(int slot)
+  {
+    auto& info = *m_infos.getBySlot(slot);
+    auto const body = m_bodies[slot];
+    info.triggersDirty = false;
+
+    auto& hits = m_triggerHits;
+    m_triggers.query(m_boxes[slot], hits);
+
+    auto ignores = [&] (int trigger) { return !(m_bodies[trigger]->collidesWith & m_groups[slot]); };
+    hits.erase(remove_if(hits.begin(), hits.end(), ignores), hits.end());
+
+    for(auto trigger : info.contacts)
     {
-      auto& me = *m_bodies[p.first];
-      auto& other = *m_bodies[p.second];
+      if(binary_search(hits.begin(), hits.end(), trigger))
+        continue;
 
-      auto rect = me.getBox();
-      auto otherBox = other.getBox();
+      eraseSorted(m_infos.getBySlot(trigger)->contacts, slot);
+      m_triggerEvents.push_back({ m_bodies[trigger], body, false });
+    }
 
-      if(overlaps(rect, otherBox))
-        collideBodies(me, other);
+    for(auto trigger : hits)
+    {
+      if(binary_search(info.contacts.begin(), info.contacts.end(), trigger))
+        continue;
+
+      insertSorted(m_infos.getBySlot(trigger)->contacts, slot);
+      m_triggerEvents.push_back({ m_bodies[trigger], body, true });
+    }
+
+    info.contacts.swap(hits);
+  }
+
+  static void insertSorted(vector<int>& list, int value)
+  {
+    list.insert(lower_bound(list.begin(), list.end(), value), value);
+  }
+
+  static void eraseSorted(vector<int>& list, int value)
+  {
+    auto i = lower_bound(list.begin(), list.end(), value);
+
+    if(i != list.end() && *i == value)
+      list.erase(i);
+  }
+
+  void flushSweepRemovals()
+  {
+    if(m_sweepRemovals.empty())
+      return;
+
+    sort(m_sweepRemovals.begin(), m_sweepRemovals.end());
+
+    auto isRemoved = [&] (int slot) { return binary_search(m_sweepRemovals.begin(), m_sweepRemovals.end(), slot); };
+    m_sweepList.erase(remove_if(m_sweepList.begin(), m_sweepList.end(), isRemoved), m_sweepList.end());
+
+    m_sweepRemovals.clear();
+  }
+
+  // insertion sort: linear on an already sorted list
+  void sortSweepList()
+  {
+    for(int i = 1; i < (int)m_sweepList.size(); ++i)
+    {
+      auto const slot = m_sweepList[i];
+      auto const left = m_boxes[slot].pos.x;
+      int j = i;
+
+      while(j > 0 && m_boxes[m_sweepList[j - 1]].pos.x > left)
+      {
+        m_sweepList[j] = m_sweepList[j - 1];
+        --j;
+      }
+
+      m_sweepList[j] = slot;
     }
   }
 
   void collideBodies(Body& me, Body& other)
   {
+    // bodies on the move wake up the ones they touch
+    auto const meMoving = getInfo(&me).idleTicks == 0;
+    auto const otherMoving = getInfo(&other).idleTicks == 0;
+
+    if(meMoving)
+      wakeUp(&other);
+
+    if(otherMoving)
+      wakeUp(&me);
+
     if(other.collidesWith & me.collisionGroup)
       other.onCollision(&me);
 
@@ -159,36 +679,270 @@ struct Physics : IPhysics
       me.onCollision(&other);
   }
 
-  void setEdifice(function<::Trace(Box, Vector)> trace) override
+  Body* getGround(const Body* body) const override
+  {
+    if(!m_infos.get(body->ground))
+      return nullptr;
+
+    return m_bodies[body->ground.index];
+  }
+
+  void setStaticWorld(shared_ptr<const StaticWorld> world) override
   {
-    m_traceEdifice = trace;
+    m_world = move(world);
+
+    for(auto& info : m_infos.values)
+      info.groundCache.valid = false;
+  }
+
+  PhysicsStats getStats() const override
+  {
+    auto r = m_stats;
+    r.brushes = m_world->stats.brushes;
+    r.planes = m_world->stats.planes;
+    return r;
+  }
+
+  void resetStats() override
+  {
+    m_stats = {};
+    m_world->stats = {};
   }
 
   Body* getBodiesInBox(Box myBox, int collisionGroup, bool onlySolid, const Body* except) const override
   {
-    for(auto& body : m_bodies)
+    Timer timer(this);
+
+    Body* r = nullptr;
+    int bestOrder = 0;
+
+    // several matches: the oldest body wins, whatever the order of the trees
+    auto check = [&] (int slot)
+      {
+        if(r && m_orders[slot] >= bestOrder)
+          return;
+
+        if(!(m_groups[slot] & collisionGroup))
+          return;
+
+        if(!overlaps(m_boxes[slot], myBox))
+          return;
+
+        auto const body = m_bodies[slot];
+
+        if(body == except)
+          return;
+
+        if(onlySolid && !body->solid)
+          return;
+
+        r = body;
+        bestOrder = m_orders[slot];
+      };
+
+    // groups without a bucket: look at every body
+    if(collisionGroup & ~((1 << GROUP_BUCKETS) - 1))
     {
-      if(onlySolid && !body->solid)
-        continue;
+      m_tree.query(myBox, [&] (int proxy) { check(toSlot(m_tree.getUserData(proxy))); });
+      return r;
+    }
 
-      if(body == except)
+    for(int bit = 0; bit < GROUP_BUCKETS; ++bit)
+    {
+      if(!(collisionGroup & (1 << bit)))
         continue;
 
-      if(!(body->collisionGroup & collisionGroup))
-        continue;
+      auto& tree = m_groupTrees[bit];
+      tree.query(myBox, [&] (int proxy) { check(toSlot(tree.getUserData(proxy))); });
+    }
+
+    return r;
+  }
 
-      auto rect = body->getBox();
+private:
+  // Measures the time spent in the physics.
+  // Nested calls (e.g from collision handlers) are only counted once.
+  struct Timer
+  {
+    Timer(Physics const* physics_) : physics(physics_)
+    {
+      if(physics->m_timerDepth++ == 0)
+        start = chrono::steady_clock::now();
+    }
 
-      if(overlaps(rect, myBox))
-        return body;
+    ~Timer()
+    {
+      if(--physics->m_timerDepth == 0)
+      {
+        auto const elapsed = chrono::steady_clock::now() - start;
+        physics->m_stats.microseconds += (int)chrono::duration_cast<chrono::microseconds>(elapsed).count();
+      }
     }
 
-    return nullptr;
+    Physics const* const physics;
+    chrono::steady_clock::time_point start;
+  };
+
+  // Updates the trees, and the flat arrays, after a move, a teleport, or a
+  // collision group change.
+  void refit(Body* body)
+  {
+    assert(!body->trigger); // triggers don't move
+
+    auto& info = getInfo(body);
+    auto const box = body->getBox();
+    auto const slot = body->physicsHandle.index;
+
+    m_boxes[slot] = box;
+    m_groups[slot] = body->collisionGroup;
+
+    m_tree.update(info.proxy, box);
+
+    for(int bit = 0; bit < GROUP_BUCKETS; ++bit)
+    {
+      auto& tree = m_groupTrees[bit];
+      auto& proxy = info.groupProxies[bit];
+      bool const member = body->collisionGroup & (1 << bit);
+
+      if(member && proxy == -1)
+      {
+        proxy = tree.insert(box, toUserData(slot));
+      }
+      else if(!member && proxy != -1)
+      {
+        tree.remove(proxy);
+        proxy = -1;
+      }
+      else if(member)
+      {
+        tree.update(proxy, box);
+      }
+    }
   }
 
-private:
-  vector<Body*> m_bodies;
-  function<::Trace(Box, Vector)> m_traceEdifice;
+  void wakeUp(Body* body)
+  {
+    getInfo(body).idleTicks = 0;
+  }
+
+  static bool sameBox(Box const& a, Box const& b)
+  {
+    return a.pos.x == b.pos.x && a.pos.y == b.pos.y && a.pos.z == b.pos.z
+           && a.size.cx == b.size.cx && a.size.cy == b.size.cy && a.size.cz == b.size.cz;
+  }
+
+  // keeps the 'riders' lists in sync with 'Body::ground'
+  void setGround(Body* body, Body* ground)
+  {
+    auto const handle = ground ? ground->physicsHandle : SlotHandle();
+
+    if(body->ground == handle)
+      return;
+
+    // a stale handle: its riders went with it
+    if(auto info = m_infos.get(body->ground))
+    {
+      auto& riders = info->riders;
+      riders.erase(find(riders.begin(), riders.end(), body->physicsHandle.index));
+    }
+
+    body->ground = handle;
+
+    if(ground)
+      getInfo(ground).riders.push_back(body->physicsHandle.index);
+  }
+
+  // the trees only know the slots
+  static void* toUserData(int slot)
+  {
+    return (void*)(intptr_t)slot;
+  }
+
+  static int toSlot(void* userData)
+  {
+    return (int)(intptr_t)userData;
+  }
+
+  int getOrder(const Body* body) const
+  {
+    return m_orders[body->physicsHandle.index];
+  }
+
+  struct BodyInfo
+  {
+    int proxy; // in 'm_tree'
+    vector<int> riders; // slots of the bodies whose ground is this body
+    int groupProxies[GROUP_BUCKETS]; // in 'm_groupTrees', -1 if not a member
+
+    // sleeping: bodies asleep don't get checked against each other
+    Box lastBox; // at the previous 'checkForOverlaps'
+    bool lastSolid;
+    int idleTicks = 0;
+
+    // For a trigger, the bodies inside. For the others, the triggers they're
+    // in. Slots, sorted.
+    vector<int> contacts;
+    bool triggersDirty = false; // to check at the next 'checkForOverlaps'
+
+    struct GroundCache
+    {
+      bool valid = false;
+      Box box; // box of the body when the trace was done
+      Trace trace;
+    };
+
+    mutable GroundCache groundCache;
+  };
+
+  BodyInfo& getInfo(const Body* body)
+  {
+    auto info = m_infos.get(body->physicsHandle);
+    assert(info);
+    return *info;
+  }
+
+  BodyInfo const& getInfo(const Body* body) const
+  {
+    auto info = m_infos.get(body->physicsHandle);
+    assert(info);
+    return *info;
+  }
+
+  mutable Candidates m_candidates; // scratch lists, avoid allocations
+  Candidates m_stepCandidates;
+  SlotMap<BodyInfo> m_infos; // see 'Body::physicsHandle'
+
+  // What the scans and the traces read, in flat arrays, by slot (the index
+  // of 'Body::physicsHandle'), rather than from the entities, scattered in
+  // memory. Synced by 'refit': on each move, and for all the bodies in
+  // 'checkForOverlaps' (teleports, collision group changes).
+  // Solidity is still read from the bodies: entities toggle it at any time.
+  vector<Body*> m_bodies; // null for a free slot
+  vector<Box> m_boxes;
+  vector<int> m_groups; // 'Body::collisionGroup'
+  vector<int> m_orders; // insertion order, used to break ties
+
+  AabbTree m_tree;
+  AabbTree m_groupTrees[GROUP_BUCKETS]; // bodies, by collision group bit
+  int m_nextOrder = 0;
+  vector<int> m_sweepList; // slots of the same bodies, sorted by 'pos.x'
+  vector<int> m_sweepRemovals; // still in 'm_sweepList'
+  vector<Box> m_sweepBoxes; // for each body of 'm_sweepList'
+  vector<bool> m_sweepAsleep; // for each body of 'm_sweepList'
+
+  struct TriggerEvent
+  {
+    Body* trigger;
+    Body* other;
+    bool enter; // or exit
+  };
+
+  TriggerGrid m_triggers; // slots of the triggers
+  vector<int> m_triggerHits; // scratch list, see 'updateTriggers'
+  vector<TriggerEvent> m_triggerEvents; // fired at the end of 'checkForOverlaps'
+  shared_ptr<const StaticWorld> m_world; // never null
+  mutable PhysicsStats m_stats;
+  mutable int m_timerDepth = 0;
 };
 
 unique_ptr<IPhysics> createPhysics()
@@ -12,6 +12,19 @@
 #include "physics_probe.h"
 #include <memory>
 
+struct StaticWorld;
+
+// What the physics did since the last 'resetStats'
+struct PhysicsStats
+{
+  int traces = 0; // box traces, through bodies and brushes
+  int bodies = 0; // candidate bodies traced against
+  int brushes = 0; // brushes traced against
+  int planes = 0; // planes of these brushes
+  int pushed = 0; // bodies moved by pushers
+  int microseconds = 0; // time spent inside the physics
+};
+
 struct IPhysics : IPhysicsProbe
 {
   virtual ~IPhysics() = default;
@@ -20,7 +33,15 @@ struct IPhysics : IPhysicsProbe
   virtual void addBody(Body* body) = 0;
   virtual void removeBody(Body* body) = 0;
   virtual void checkForOverlaps() = 0;
-  virtual void setEdifice(function<::Trace(Box, Vector)> isSolid) = 0;
+
+  // What 'body' rests on. Null if nothing, or if it left the physics.
+  virtual Body* getGround(const Body* body) const = 0;
+
+  // 'world' can be shared, e.g with the level cache: a restart reuses it.
+  virtual void setStaticWorld(shared_ptr<const StaticWorld> world) = 0;
+
+  virtual PhysicsStats getStats() const = 0;
+  virtual void resetStats() = 0;
 };
 
 unique_ptr<IPhysics> createPhysics();
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "base/span.h"
 #include "body.h"
 #include "trace.h"
 
@@ -15,10 +16,45 @@ struct IPhysicsProbe
 {
   struct Trace : public ::Trace
   {
+    // Only valid until the next body leaves the physics: use it, don't keep it
+    // (see 'Body::ground' for a reference which survives).
     Body* blocker;
   };
+  struct TraceQuery
+  {
+    Box box;
+    Vector delta;
+    const Body* except;
+  };
+
   virtual Trace moveBody(Body* body, Vector delta) = 0;
+
+  // Puts 'body' at 'pos', without tracing the way there.
+  virtual void teleport(Body* body, Vector pos)
+  {
+    body->pos = pos;
+    moveBody(body, Vector(0, 0, 0)); // catches up with the new position
+  }
   virtual Trace traceBox(Box box, Vector delta, const Body* except) const = 0;
+
+  // Traces 'body' a little bit downwards, looking for something to rest on.
+  virtual Trace traceGround(const Body* body) const
+  {
+    return traceBox(body->getBox(), Down * 0.1, body);
+  }
+
+  // Climbs 'stepHeight', slides along 'delta', then goes back down 'stepHeight'.
+  // This is how walking characters get over stairs.
+  virtual void stepSlideMove(Body* body, Vector delta, float stepHeight) = 0;
+
+  // Same as calling 'traceBox' for each query: 'results[i]' receives the
+  // trace of 'queries[i]'. Implementations can share work between queries.
+  virtual void traceBoxes(Span<const TraceQuery> queries, Span<Trace> results) const
+  {
+    for(int i = 0; i < queries.len; ++i)
+      results[i] = traceBox(queries[i].box, queries[i].delta, queries[i].except);
+  }
+
   virtual Body* getBodiesInBox(Box myRect, int collisionGroup, bool onlySolid = false, const Body* except = nullptr) const = 0;
 };
 
@@ -9,22 +9,24 @@
 #include "models.h"
 #include "sounds.h"
 
+// The priority of a sound: 2 for the player's state, 1 for the actions,
+// 0 for the crowds (e.g the crumbling blocks).
 static const Resource resources[] =
 {
-  { ResourceType::Sound, SND_PAUSE, "res/sounds/pause.ogg" },
-  { ResourceType::Sound, SND_START, "res/sounds/start.ogg" },
-  { ResourceType::Sound, SND_FIRE, "res/sounds/fire.ogg" },
-  { ResourceType::Sound, SND_JUMP, "res/sounds/jump.ogg" },
-  { ResourceType::Sound, SND_LAND, "res/sounds/land.ogg" },
-  { ResourceType::Sound, SND_SWITCH, "res/sounds/switch.ogg" },
-  { ResourceType::Sound, SND_DOOR, "res/sounds/door.ogg" },
-  { ResourceType::Sound, SND_HURT, "res/sounds/hurt.ogg" },
-  { ResourceType::Sound, SND_DIE, "res/sounds/die.ogg" },
-  { ResourceType::Sound, SND_BONUS, "res/sounds/bonus.ogg" },
-  { ResourceType::Sound, SND_DAMAGE, "res/sounds/damage.ogg" },
-  { ResourceType::Sound, SND_EXPLODE, "res/sounds/explode.ogg" },
-  { ResourceType::Sound, SND_DISAPPEAR, "res/sounds/disappear.ogg" },
-  { ResourceType::Sound, SND_TELEPORT, "res/sounds/teleport.ogg" },
+  { ResourceType::Sound, SND_PAUSE, "res/sounds/pause.ogg", 2 },
+  { ResourceType::Sound, SND_START, "res/sounds/start.ogg", 2 },
+  { ResourceType::Sound, SND_FIRE, "res/sounds/fire.ogg", 1 },
+  { ResourceType::Sound, SND_JUMP, "res/sounds/jump.ogg", 1 },
+  { ResourceType::Sound, SND_LAND, "res/sounds/land.ogg", 1 },
+  { ResourceType::Sound, SND_SWITCH, "res/sounds/switch.ogg", 1 },
+  { ResourceType::Sound, SND_DOOR, "res/sounds/door.ogg", 1 },
+  { ResourceType::Sound, SND_HURT, "res/sounds/hurt.ogg", 2 },
+  { ResourceType::Sound, SND_DIE, "res/sounds/die.ogg", 2 },
+  { ResourceType::Sound, SND_BONUS, "res/sounds/bonus.ogg", 1 },
+  { ResourceType::Sound, SND_DAMAGE, "res/sounds/damage.ogg", 0 },
+  { ResourceType::Sound, SND_EXPLODE, "res/sounds/explode.ogg", 1 },
+  { ResourceType::Sound, SND_DISAPPEAR, "res/sounds/disappear.ogg", 0 },
+  { ResourceType::Sound, SND_TELEPORT, "res/sounds/teleport.ogg", 2 },
 
   { ResourceType::Model, MDL_SPLASH, "res/sprites/splash.render" },
   { ResourceType::Model, MDL_DOOR, "res/sprites/door.render" },
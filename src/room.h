@@ -9,29 +9,64 @@
 #pragma once
 
 #include "base/geom.h"
-#include <map>
 #include <string>
 #include <vector>
 
 using namespace std;
 
 #include "base/mesh.h"
+#include "bvh.h"
 #include "convex.h"
 
 struct Room
 {
   Vector3i start;
 
-  struct Thing
+  // What to spawn in the room, parsed once and for all when building it:
+  // spawning is a loop over 'spawns', without any string work.
+  struct SpawnTable
   {
-    Vector pos;
-    string name;
-    map<string, string> config;
+    struct Arg
+    {
+      string text;
+      int value; // 'text', as an int
+    };
+
+    struct Spawn
+    {
+      Vector pos;
+      int type; // in 'types'
+      int firstArg; // in 'args'
+      int argCount;
+    };
+
+    vector<string> types; // entity type names
+    vector<Spawn> spawns;
+    vector<Arg> args;
   };
 
-  vector<Thing> things;
+  SpawnTable spawnTable;
   vector<Convex> colliders;
+
+  // acceleration structure over 'colliders'
+  Bvh collidersTree;
 };
 
+struct ThreadPool;
+
 Room loadRoom(const char* filename);
 
+// Builds a room from the meshes exported from blender.
+// The brushes are independent: they're built on the workers of 'pool'
+// (null means the shared one), and kept in the order of 'meshes'.
+Room buildRoom(vector<Mesh> const& meshes, ThreadPool* pool = nullptr);
+
+// Binary "cooked" rooms, produced by the meshcooker.
+// Same content as the result of 'buildRoom', ready to use.
+string serializeRoom(Room const& room);
+Room deserializeRoom(string const& data);
+
+// Returns false if there's no usable cooked room at 'path'.
+bool loadCookedRoom(string path, Room& room);
+void saveCookedRoom(string path, Room const& room);
+
@@ -0,0 +1,260 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Binary format for cooked rooms.
+// Everything is stored in native byte order, as it's only meant to be read
+// by the game built along with the meshcooker.
+//
+// header: "ROOM", version
+// start: 3 x int32
+// spawn table: type count, type names, spawn count, spawns,
+//   arg count, then for each: text, value
+// brushes: count, then for each: bounds, plane count, planes
+// BVH: node count, nodes, index count, indices
+
+#include "room.h"
+#include "static_world.h"
+#include <cstdio>
+#include <cstring> // memcpy
+#include <functional>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+auto const MAGIC = "ROOM";
+uint32_t const VERSION = 2;
+
+struct Writer
+{
+  string data;
+
+  void raw(void const* p, size_t len)
+  {
+    data.append((char const*)p, len);
+  }
+
+  template<typename T>
+  void pod(T const& value)
+  {
+    raw(&value, sizeof value);
+  }
+
+  void str(string const& s)
+  {
+    pod((uint32_t)s.size());
+    raw(s.data(), s.size());
+  }
+};
+
+struct Reader
+{
+  string const& data;
+  size_t pos = 0;
+
+  void raw(void* p, size_t len)
+  {
+    if(len > data.size() - pos)
+      throw runtime_error("Truncated cooked room");
+
+    memcpy(p, data.data() + pos, len);
+    pos += len;
+  }
+
+  template<typename T>
+  T pod()
+  {
+    T value;
+    raw(&value, sizeof value);
+    return value;
+  }
+
+  string str()
+  {
+    string s;
+    s.resize(pod<uint32_t>());
+    raw(&s[0], s.size());
+    return s;
+  }
+
+  template<typename T>
+  void array(vector<T>& v)
+  {
+    v.resize(pod<uint32_t>());
+    raw(v.data(), v.size() * sizeof(T));
+  }
+};
+}
+
+string serializeRoom(Room const& room)
+{
+  Writer w;
+  w.raw(MAGIC, 4);
+  w.pod(VERSION);
+
+  w.pod((int32_t)room.start.x);
+  w.pod((int32_t)room.start.y);
+  w.pod((int32_t)room.start.z);
+
+  auto& table = room.spawnTable;
+  w.pod((uint32_t)table.types.size());
+
+  for(auto& type : table.types)
+    w.str(type);
+
+  w.pod((uint32_t)table.spawns.size());
+  w.raw(table.spawns.data(), table.spawns.size() * sizeof(Room::SpawnTable::Spawn));
+  w.pod((uint32_t)table.args.size());
+
+  for(auto& arg : table.args)
+  {
+    w.str(arg.text);
+    w.pod((int32_t)arg.value);
+  }
+
+  w.pod((uint32_t)room.colliders.size());
+
+  for(auto& brush : room.colliders)
+  {
+    w.pod(brush.bounds);
+    w.pod((uint32_t)brush.planes.size());
+    w.raw(brush.planes.data(), brush.planes.size() * sizeof(Plane));
+  }
+
+  auto& tree = room.collidersTree;
+  w.pod((uint32_t)tree.nodes.size());
+  w.raw(tree.nodes.data(), tree.nodes.size() * sizeof(Bvh::Node));
+  w.pod((uint32_t)tree.indices.size());
+  w.raw(tree.indices.data(), tree.indices.size() * sizeof(int));
+
+  return w.data;
+}
+
+Room deserializeRoom(string const& data)
+{
+  Reader r { data };
+
+  char magic[4];
+  r.raw(magic, 4);
+
+  if(memcmp(magic, MAGIC, 4))
+    throw runtime_error("Not a cooked room");
+
+  if(r.pod<uint32_t>() != VERSION)
+    throw runtime_error("Unsupported cooked room version");
+
+  Room room;
+
+  room.start.x = r.pod<int32_t>();
+  room.start.y = r.pod<int32_t>();
+  room.start.z = r.pod<int32_t>();
+
+  auto& table = room.spawnTable;
+  table.types.resize(r.pod<uint32_t>());
+
+  for(auto& type : table.types)
+    type = r.str();
+
+  r.array(table.spawns);
+  table.args.resize(r.pod<uint32_t>());
+
+  for(auto& arg : table.args)
+  {
+    arg.text = r.str();
+    arg.value = r.pod<int32_t>();
+  }
+
+  for(auto& spawn : table.spawns)
+  {
+    if(spawn.type < 0 || spawn.type >= (int)table.types.size())
+      throw runtime_error("Invalid spawn type in cooked room");
+
+    if(spawn.firstArg < 0 || spawn.argCount < 0 || spawn.firstArg + spawn.argCount > (int)table.args.size())
+      throw runtime_error("Invalid spawn args in cooked room");
+  }
+
+  room.colliders.resize(r.pod<uint32_t>());
+
+  for(auto& brush : room.colliders)
+  {
+    brush.bounds = r.pod<Box>();
+    r.array(brush.planes);
+  }
+
+  r.array(room.collidersTree.nodes);
+  r.array(room.collidersTree.indices);
+
+  if(r.pos != data.size())
+    throw runtime_error("Trailing data in cooked room");
+
+  return room;
+}
+
+bool loadCookedRoom(string path, Room& room)
+{
+  FILE* fp = fopen(path.c_str(), "rb");
+
+  if(!fp)
+    return false;
+
+  fseek(fp, 0, SEEK_END);
+  auto const size = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  string data;
+  data.resize(size);
+  auto const len = fread(&data[0], 1, data.size(), fp);
+  fclose(fp);
+
+  if(len != data.size())
+    return false;
+
+  try
+  {
+    room = deserializeRoom(data);
+  }
+  catch(exception const& e)
+  {
+    fprintf(stderr, "WARNING: ignoring cooked room '%s': %s\n", path.c_str(), e.what());
+    return false;
+  }
+
+  return true;
+}
+
+void saveCookedRoom(string path, Room const& room)
+{
+  FILE* fp = fopen(path.c_str(), "wb");
+
+  if(!fp)
+    throw runtime_error("Can't open file '" + path + "' for writing");
+
+  auto const data = serializeRoom(room);
+  fwrite(data.data(), 1, data.size(), fp);
+  fclose(fp);
+}
+
+// Called by the meshcooker.
+// Returns the line of sight test used to precompute the room's visibility:
+// the collision brushes are the occluders.
+function<bool(Vector3f, Vector3f)> cookRoom(vector<Mesh> const& meshes, string path)
+{
+  auto room = buildRoom(meshes);
+  saveCookedRoom(path, room);
+
+  auto world = make_shared<StaticWorld>(room.colliders, move(room.collidersTree));
+
+  return [world] (Vector3f a, Vector3f b)
+         {
+           auto const POINT = 1.0f / 128.0f;
+
+           Box box;
+           box.pos = a - Vector(POINT, POINT, POINT) * 0.5;
+           box.size = Size(POINT, POINT, POINT);
+
+           return world->trace(box, b - a).fraction >= 1.0;
+         };
+}
@@ -7,6 +7,9 @@
 // Loader for rooms (levels)
 
 #include "base/mesh.h"
+#include "base/profiler.h"
+#include "base/thread_pool.h"
+#include "base/util.h" // setExtension
 #include "room.h"
 #include <algorithm>
 #include <map>
@@ -22,7 +25,7 @@ static bool startsWith(string s, string prefix)
   return s.substr(0, prefix.size()) == prefix;
 }
 
-static Vector3f computeNormal(Mesh& mesh, int i1, int i2, int i3)
+static Vector3f computeNormal(Mesh const& mesh, int i1, int i2, int i3)
 {
   auto A = toVector3f(mesh.vertices[i1]);
   auto B = toVector3f(mesh.vertices[i2]);
@@ -51,7 +54,56 @@ static bool operator < (Vector3f a, Vector3f b)
 }
 
 static
-void bevelSharpEdges(Mesh& mesh, Convex& brush)
+bool isAxisAligned(Vector3f N)
+{
+  auto const tolerance = 1.0e-5f;
+  auto isZero = [&] (float val) { return abs(val) < tolerance; };
+
+  int zeroes = 0;
+
+  if(isZero(N.x))
+    ++zeroes;
+
+  if(isZero(N.y))
+    ++zeroes;
+
+  if(isZero(N.z))
+    ++zeroes;
+
+  return zeroes == 2;
+}
+
+// Merges coplanar planes (e.g the two triangles of a quad),
+// keeping the first one.
+static
+void weldPlanes(Convex& brush)
+{
+  auto const normalTolerance = 1.0e-4f;
+  auto const distTolerance = 1.0e-3f;
+
+  auto isSame = [&] (Plane const& a, Plane const& b)
+    {
+      return dotProduct(a.N, b.N) > 1.0f - normalTolerance && abs(a.D - b.D) < distTolerance;
+    };
+
+  vector<Plane> welded;
+
+  for(auto& plane : brush.planes)
+  {
+    bool duplicate = false;
+
+    for(auto& other : welded)
+      duplicate = duplicate || isSame(plane, other);
+
+    if(!duplicate)
+      welded.push_back(plane);
+  }
+
+  brush.planes = move(welded);
+}
+
+static
+void bevelSharpEdges(Mesh const& mesh, Convex& brush)
 {
   struct EdgeId
   {
@@ -106,12 +158,32 @@ void bevelSharpEdges(Mesh& mesh, Convex& brush)
     if(dotProduct(N1, N2) > 0)
       continue;
 
+    // Between two axis-aligned faces, the bevel doesn't clip anything:
+    // the faces, pushed out by the box radius, already meet at the right place.
+    if(isAxisAligned(N1) && isAxisAligned(N2))
+      continue;
+
     auto N3 = normalize(N1 + N2);
     auto D = dotProduct(N3, e.first.v1);
     brush.planes.push_back(Plane { N3, D });
   }
 }
 
+static
+Box computeBoundingBox(Mesh const& mesh)
+{
+  auto lo = toVector3f(mesh.vertices[0]);
+  auto hi = lo;
+
+  for(auto& v : mesh.vertices)
+  {
+    lo = Vector3f(min(lo.x, v.x), min(lo.y, v.y), min(lo.z, v.z));
+    hi = Vector3f(max(hi.x, v.x), max(hi.y, v.y), max(hi.z, v.z));
+  }
+
+  return Box(lo.x, lo.y, lo.z, hi.x - lo.x, hi.y - lo.y, hi.z - lo.z);
+}
+
 static
 vector<string> parseCall(string content)
 {
@@ -197,30 +269,69 @@ vector<string> parseCall(string content)
   return r;
 }
 
+// e.g "door(4)"
 static
-map<string, string> parseFormula(string formula, string& name)
+void addSpawn(Room::SpawnTable& table, Vector pos, string formula)
 {
-  map<string, string> r;
+  auto const words = parseCall(formula);
 
-  auto words = parseCall(formula);
-  name = words[0];
-  words.erase(words.begin());
+  Room::SpawnTable::Spawn spawn;
+  spawn.pos = pos;
+  spawn.firstArg = (int)table.args.size();
+  spawn.argCount = (int)words.size() - 1;
 
-  int i = 0;
+  auto const i = find(table.types.begin(), table.types.end(), words[0]);
+  spawn.type = int(i - table.types.begin());
 
-  for(auto& varValue : words)
-    r[to_string(i++)] = varValue;
+  if(i == table.types.end())
+    table.types.push_back(words[0]);
 
-  return r;
+  for(int k = 1; k < (int)words.size(); ++k)
+    table.args.push_back({ words[k], atoi(words[k].c_str()) });
+
+  table.spawns.push_back(spawn);
 }
 
 Room loadRoom(const char* filename)
+{
+  // use the cooked version, if the meshcooker produced one
+  Room r;
+
+  if(loadCookedRoom(setExtension(filename, "collision"), r))
+    return r;
+
+  return buildRoom(importMesh(filename));
+}
+
+static
+Convex buildBrush(Mesh const& mesh)
+{
+  PROFILE_SCOPE("buildBrush");
+
+  Convex brush;
+  brush.bounds = computeBoundingBox(mesh);
+
+  for(auto& face : mesh.faces)
+  {
+    auto const N = computeNormal(mesh, face.i1, face.i2, face.i3);
+    auto A = toVector3f(mesh.vertices[face.i1]);
+    auto const D = dotProduct(N, A);
+    brush.planes.push_back(Plane { N, D });
+  }
+
+  bevelSharpEdges(mesh, brush);
+  weldPlanes(brush);
+
+  return brush;
+}
+
+Room buildRoom(vector<Mesh> const& meshes, ThreadPool* pool)
 {
   Room r;
 
   r.start = Vector3i(0, 0, 2);
 
-  auto meshes = importMesh(filename);
+  vector<Mesh const*> brushMeshes;
 
   for(auto& mesh : meshes)
   {
@@ -253,26 +364,26 @@ Room loadRoom(const char* filename)
 
       pos = pos * (1.0 / mesh.vertices.size());
       // auto const pos = toVector3f(mesh.vertices[mesh.faces[0].i1]);
-      string typeName;
-      auto const config = parseFormula(name.substr(2), typeName);
-      r.things.push_back({ pos, typeName, config });
+      addSpawn(r.spawnTable, pos, name.substr(2));
       continue;
     }
 
-    Convex brush;
+    brushMeshes.push_back(&mesh);
+  }
 
-    for(auto& face : mesh.faces)
-    {
-      auto const N = computeNormal(mesh, face.i1, face.i2, face.i3);
-      auto A = toVector3f(mesh.vertices[face.i1]);
-      auto const D = dotProduct(N, A);
-      brush.planes.push_back(Plane { N, D });
-    }
+  if(!pool)
+    pool = &getSharedThreadPool();
 
-    bevelSharpEdges(mesh, brush);
+  // each worker writes its own slots: same order as a serial build
+  r.colliders.resize(brushMeshes.size());
+  pool->parallelFor((int)brushMeshes.size(), [&] (int i) { r.colliders[i] = buildBrush(*brushMeshes[i]); });
 
-    r.colliders.push_back(brush);
-  }
+  vector<Box> bounds;
+
+  for(auto& brush : r.colliders)
+    bounds.push_back(brush.bounds);
+
+  r.collidersTree.build(bounds);
 
   return r;
 }
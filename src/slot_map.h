@@ -0,0 +1,131 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Slot map: values stored densely, addressed by handles.
+// A handle stays valid as long as its value lives, and is detected as stale
+// afterwards, even if its slot got reused: slots have a generation counter.
+// Adding and removing are O(1). Removing moves the last value into the hole,
+// so the order of 'values' is unspecified.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+struct SlotHandle
+{
+  int index = -1;
+  uint32_t generation = 0;
+};
+
+inline bool operator==(SlotHandle a, SlotHandle b)
+{
+  return a.index == b.index && a.generation == b.generation;
+}
+
+inline bool operator!=(SlotHandle a, SlotHandle b)
+{
+  return !(a == b);
+}
+
+template<typename T>
+struct SlotMap
+{
+  SlotHandle add(T value)
+  {
+    int index;
+
+    if(m_freeSlots.empty())
+    {
+      index = (int)m_slots.size();
+      m_slots.push_back({});
+    }
+    else
+    {
+      index = m_freeSlots.back();
+      m_freeSlots.pop_back();
+    }
+
+    auto& slot = m_slots[index];
+    slot.dense = (int)values.size();
+    values.push_back(move(value));
+    m_denseToSlot.push_back(index);
+
+    return { index, slot.generation };
+  }
+
+  void remove(SlotHandle h)
+  {
+    assert(get(h));
+
+    auto& slot = m_slots[h.index];
+    auto const last = (int)values.size() - 1;
+
+    if(slot.dense != last)
+    {
+      values[slot.dense] = move(values[last]);
+      m_denseToSlot[slot.dense] = m_denseToSlot[last];
+      m_slots[m_denseToSlot[slot.dense]].dense = slot.dense;
+    }
+
+    values.pop_back();
+    m_denseToSlot.pop_back();
+
+    slot.dense = -1;
+    slot.generation++;
+    m_freeSlots.push_back(h.index);
+  }
+
+  // null if the value was removed
+  T* get(SlotHandle h)
+  {
+    if(h.index < 0 || h.index >= (int)m_slots.size())
+      return nullptr;
+
+    auto& slot = m_slots[h.index];
+
+    if(slot.generation != h.generation || slot.dense < 0)
+      return nullptr;
+
+    return &values[slot.dense];
+  }
+
+  T const* get(SlotHandle h) const
+  {
+    return const_cast<SlotMap*>(this)->get(h);
+  }
+
+  // By 'SlotHandle::index', whatever the generation: null if the slot is free
+  T* getBySlot(int index)
+  {
+    if(index < 0 || index >= (int)m_slots.size() || m_slots[index].dense < 0)
+      return nullptr;
+
+    return &values[m_slots[index].dense];
+  }
+
+  T const* getBySlot(int index) const
+  {
+    return const_cast<SlotMap*>(this)->getBySlot(index);
+  }
+
+  // Pointers and references to the values are invalidated by 'add' and 'remove'.
+  vector<T> values;
+
+private:
+  struct Slot
+  {
+    int dense = -1; // in 'values'
+    uint32_t generation = 0;
+  };
+
+  vector<Slot> m_slots;
+  vector<int> m_denseToSlot;
+  vector<int> m_freeSlots;
+};
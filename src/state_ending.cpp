@@ -26,7 +26,7 @@ T blend(T a, T b, float alpha)
 
 struct EndingState : Scene
 {
-  EndingState(View* view_) : view(view_)
+  EndingState(View* view_, GameOptions const& options_) : view(view_), options(options_)
   {
     view->setAmbientLight(LIGHT_ON);
   }
@@ -70,7 +70,7 @@ struct EndingState : Scene
         if(delay < -FADE_TIME / 2)
         {
           activated = false;
-          return createSplashState(view);
+          return createSplashState(view, options);
         }
       }
     }
@@ -84,13 +84,14 @@ struct EndingState : Scene
 
 private:
   View* const view;
+  GameOptions const options;
   bool activated = false;
   int delay = 0;
   int time = 0;
 };
 
-Scene* createEndingState(View* view)
+Scene* createEndingState(View* view, GameOptions const& options)
 {
-  return new EndingState(view);
+  return new EndingState(view, options);
 }
 
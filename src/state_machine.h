@@ -3,8 +3,21 @@
 #include "base/scene.h"
 #include "base/view.h"
 
-Scene* createSplashState(View* view);
-Scene* createPlayingState(View* view);
-Scene* createEndingState(View* view);
-Scene* createPlayingStateAtLevel(View* view, int level);
+// command line options, kept from one state to the next
+struct GameOptions
+{
+  // tick the entities that allow it on worker threads
+  bool parallelTicks = false;
+
+  // block the game while loading levels, instead of loading them in the
+  // background. The number of ticks spent loading then doesn't depend on
+  // the speed of the machine: needed for tick-exact replays, forced by the
+  // engine when recording or replaying input.
+  bool syncLoad = false;
+};
+
+Scene* createSplashState(View* view, GameOptions const& options);
+Scene* createPlayingState(View* view, GameOptions const& options);
+Scene* createEndingState(View* view, GameOptions const& options);
+Scene* createPlayingStateAtLevel(View* view, int level, GameOptions const& options);
 
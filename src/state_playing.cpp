@@ -7,48 +7,93 @@
 // Game logic
 
 #include <algorithm>
-#include <list>
-#include <map>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
 
+#include "base/profiler.h"
 #include "base/scene.h"
+#include "base/thread_pool.h"
 #include "base/util.h"
 
+#include "actor_proxies.h"
+#include "command_buffer.h"
 #include "entities/editor.h"
 #include "entities/hero.h"
 #include "entities/player.h"
 #include "entity_factory.h"
 #include "game.h"
 #include "models.h"
+#include "particles.h"
 #include "physics.h"
 #include "room.h"
 #include "state_machine.h"
-#include "variable.h"
+#include "static_world.h"
+#include "timing_wheel.h"
 
 using namespace std;
 
-struct EntityConfigImpl : IEntityConfig
+// the args of one spawn, in the spawn table
+struct SpawnConfig : IEntityConfig
 {
-  string getString(const char* varName, string defaultValue) override
+  string getString(int argIndex, string defaultValue) override
   {
-    auto i = values.find(varName);
+    if(argIndex < 0 || argIndex >= count)
+      return defaultValue;
+
+    return args[argIndex].text;
+  }
 
-    if(i == values.end())
+  int getInt(int argIndex, int defaultValue) override
+  {
+    if(argIndex < 0 || argIndex >= count)
       return defaultValue;
 
-    return i->second;
+    return args[argIndex].value;
   }
 
-  int getInt(const char* varName, int defaultValue) override
+  Room::SpawnTable::Arg const* args;
+  int count;
+};
+
+// What an entity draws: its actors are kept, to be diffed against the last
+// ones. They move along with it: the actors, and the camera, are tagged with
+// the move of its last tick, so the display can interpolate.
+struct RecordingView : View
+{
+  RecordingView(View* view_, Vector3f motion_) : view(view_), motion(motion_) {}
+
+  void setTitle(char const* gameTitle) override { view->setTitle(gameTitle); }
+  void preload(Resource res) override { view->preload(res); }
+  void preloadAll(Span<const Resource> resources) override { view->preloadAll(resources); }
+  bool preloadInBackground(Resource res) override { return view->preloadInBackground(res); }
+  void textBox(char const* msg) override { view->textBox(msg); }
+  void playMusic(int id) override { view->playMusic(id); }
+  void stopMusic() override { view->stopMusic(); }
+  void playSound(int id) override { view->playSound(id); }
+  void setAmbientLight(float amount) override { view->setAmbientLight(amount); }
+  void sendDebugText(char const* text) override { view->sendDebugText(text); }
+  void sendCounter(char const* name, int value) override { view->sendCounter(name, value); }
+
+  void setCameraPos(Vector3f pos, Quaternion orientation, Vector3f) override
   {
-    auto i = values.find(varName);
+    view->setCameraPos(pos, orientation, motion);
+  }
 
-    if(i == values.end())
-      return defaultValue;
+  int addProxy(Actor const& actor) override { return view->addProxy(actor); }
+  void updateProxy(int proxy, Actor const& actor) override { view->updateProxy(proxy, actor); }
+  void removeProxy(int proxy) override { view->removeProxy(proxy); }
 
-    return atoi(i->second.c_str());
+  void sendActor(Actor const& actor) override
+  {
+    actors.push_back(actor);
+    actors.back().motion = motion;
   }
 
-  map<string, string> values;
+  View* const view;
+  Vector3f const motion;
+  vector<Actor> actors;
 };
 
 static
@@ -57,13 +102,22 @@ void spawnEntities(Room const& room, IGame* game, int levelIdx)
   // avoid collisions between static entities from different rooms
   int id = levelIdx * 1000;
 
-  for(auto& spawner : room.things)
+  auto& table = room.spawnTable;
+
+  // the only name lookups: one per type
+  vector<int> types;
+
+  for(auto& name : table.types)
+    types.push_back(findEntityType(name));
+
+  for(auto& spawn : table.spawns)
   {
-    EntityConfigImpl config;
-    config.values = spawner.config;
+    SpawnConfig config;
+    config.args = table.args.data() + spawn.firstArg;
+    config.count = spawn.argCount;
 
-    auto entity = createEntity(spawner.name, &config);
-    entity->pos = spawner.pos;
+    auto entity = createEntity(types[spawn.type], &config);
+    entity->pos = spawn.pos;
     game->spawn(entity.release());
 
     ++id;
@@ -72,17 +126,26 @@ void spawnEntities(Room const& room, IGame* game, int levelIdx)
 
 struct GameState : Scene, private IGame
 {
-  GameState(View* view) :
-    m_view(view)
+  GameState(View* view, GameOptions const& options) :
+    m_view(view),
+    m_options(options),
+    m_loader(options.syncLoad ? 0 : 1)
   {
     m_shouldLoadLevel = true;
     resetPhysics();
   }
 
+  ~GameState()
+  {
+    clearProxies();
+  }
+
   void resetPhysics()
   {
     m_physics = createPhysics();
-    m_physics->setEdifice(bind(&GameState::traceEdifice, this, placeholders::_1, placeholders::_2));
+
+    // they point to the old physics
+    m_commandBuffers.clear();
   }
 
   ////////////////////////////////////////////////////////////////
@@ -90,23 +153,45 @@ struct GameState : Scene, private IGame
 
   Scene* tick(Control c) override
   {
+    PROFILE_SCOPE("GameState::tick");
+
     if(m_shouldLoadLevel)
     {
-      loadLevel(m_level);
+      // nothing to simulate until the level is there
+      if(!updateLoading())
+        return this;
+
       m_shouldLoadLevel = false;
     }
 
-    m_player->think(c);
+    m_mustRedraw = true;
 
-    for(auto& e : m_entities)
+    if(m_shouldRestartLevel)
     {
-      for(int i = 0; i < 10; ++i)
-        e->tick();
+      restoreSnapshot();
+      m_shouldRestartLevel = false;
     }
 
+    // whatever gets spawned during the tick belongs to the level
+    EntityArena::Scope arenaScope(&m_arena);
+
+    m_physics->resetStats();
+
+    m_player->think(c);
+
+    for(auto& e : m_entities.values)
+      e->prevPos = e->pos;
+
+    tickEntities();
+    m_particles.tick();
+
     m_physics->checkForOverlaps();
     removeDeadThings();
 
+    m_physicsStats = m_physics->getStats();
+    m_view->sendCounter("traces", m_physicsStats.traces);
+    m_view->sendCounter("pushed", m_physicsStats.pushed);
+
     m_debug = c.debug;
 
     if(c.debug && m_debugFirstTime)
@@ -116,98 +201,428 @@ struct GameState : Scene, private IGame
     }
 
     if(m_won)
-      return createEndingState(m_view);
+      return createEndingState(m_view, m_options);
 
     return this;
   }
 
   void draw() override
   {
+    PROFILE_SCOPE("GameState::draw");
+
     if(m_shouldLoadLevel)
+    {
+      clearProxies();
       return;
+    }
 
-    m_view->sendActor(Actor(Vector(0, 0, 0), MDL_ROOMS));
-
-    for(auto& entity : m_entities)
+    // what the entities draw only changes when they tick
+    if(m_mustRedraw)
     {
-      entity->onDraw(m_view);
+      redraw();
+      m_mustRedraw = false;
+    }
+
+    // they all move on each tick: sent on each frame instead of retained
+    m_particles.draw(m_view);
 
-      if(m_debug)
+    if(m_debug)
+    {
+      for(auto& entity : m_entities.values)
         m_view->sendActor(getDebugActor(entity.get()));
+
+      sendPhysicsStats();
     }
+  }
 
-    m_view->sendActor(Actor(Vector3f(10, 10, 10), MDL_SPLASH));
+  // Sends what changed since the last redraw, as proxies.
+  void redraw()
+  {
+    ++m_redrawCount;
+
+    m_worldProxies.update(m_view, { Actor(Vector(0, 0, 0), MDL_ROOMS), Actor(Vector3f(10, 10, 10), MDL_SPLASH) });
+
+    for(auto& entity : m_entities.values)
+    {
+      RecordingView view(m_view, entity->pos - entity->prevPos);
+      entity->onDraw(&view);
+
+      auto& drawn = m_proxies[entity.get()];
+      drawn.proxies.update(m_view, view.actors);
+      drawn.redrawCount = m_redrawCount;
+    }
+
+    // the entities gone since the last redraw
+    for(auto i = m_proxies.begin(); i != m_proxies.end();)
+    {
+      if(i->second.redrawCount == m_redrawCount)
+      {
+        ++i;
+        continue;
+      }
+
+      i->second.proxies.clear(m_view);
+      i = m_proxies.erase(i);
+    }
   }
 
-  void removeDeadThings()
+  void clearProxies()
+  {
+    for(auto& drawn : m_proxies)
+      drawn.second.proxies.clear(m_view);
+
+    m_proxies.clear();
+    m_worldProxies.clear(m_view);
+    m_mustRedraw = true;
+  }
+
+  void tickEntities()
   {
-    for(auto& entity : m_entities)
+    updateTickGroups();
+
+    if(m_threadPool)
+      tickEntitiesInParallel();
+
+    int parallelIdx = 0;
+
+    // one type after the other, in a fixed order
+    for(auto& group : m_tickGroups)
     {
-      if(entity->dead)
+      PROFILE_SCOPE("Entity::tick");
+
+      if(m_threadPool)
+      {
+        // already ticked: apply their writes, as if they just ticked here
+        for(int i = 0; i < (int)group.parallel.size(); ++i)
+          m_commandBuffers[parallelIdx++]->apply();
+      }
+      else
       {
-        entity->leave();
-        m_physics->removeBody(entity.get());
+        group.loop(group.parallel);
       }
+
+      group.loop(group.serial);
+    }
+
+    auto onExpired = [&] (Entity* e)
+      {
+        m_wakeUps.erase(e);
+        e->onWakeUp();
+      };
+
+    for(int i = 0; i < SUB_TICKS; ++i)
+      m_timers.advance(onExpired);
+  }
+
+  // Sorts the entities by concrete type, keeping the order of 'm_entities'
+  // within a type.
+  void updateTickGroups()
+  {
+    if(!m_tickGroupsDirty)
+      return;
+
+    if(m_tickGroups.empty())
+    {
+      for(int i = 0; i < getTickLoopCount(); ++i)
+        m_tickGroups.push_back({ getTickLoop(i), {}, {} });
+
+      m_tickGroups.push_back({ &tickVirtual, {}, {} });
+    }
+
+    for(auto& group : m_tickGroups)
+    {
+      group.serial.clear();
+      group.parallel.clear();
+    }
+
+    for(auto& e : m_entities.values)
+    {
+      auto const idx = findTickLoop(*e);
+      auto& group = idx >= 0 ? m_tickGroups[idx] : m_tickGroups.back();
+
+      if(e->parallelTick)
+        group.parallel.push_back(e.get());
+      else
+        group.serial.push_back(e.get());
     }
 
-    unstableRemove(m_entities, &isDead);
+    m_tickGroupsDirty = false;
+  }
+
+  // The loop of the types which didn't register one.
+  static void tickVirtual(Span<Entity* const> entities)
+  {
+    for(auto e : entities)
+    {
+      auto const count = getTickCount(e->tickPolicy);
+
+      for(int i = 0; i < count; ++i)
+        e->tick();
+    }
+  }
+
+  // Ticks the 'parallelTick' entities on the workers.
+  // Their writes are recorded, one command buffer per entity,
+  // and applied later, in the order of 'm_tickGroups'.
+  void tickEntitiesInParallel()
+  {
+    m_parallelEntities.clear();
+
+    for(auto& group : m_tickGroups)
+      for(auto e : group.parallel)
+        m_parallelEntities.push_back({ e, group.loop });
+
+    while(m_commandBuffers.size() < m_parallelEntities.size())
+      m_commandBuffers.push_back(make_unique<CommandBuffer>(static_cast<IGame*>(this), m_physics.get(), &m_readLock));
+
+    auto tickOne = [&] (int i)
+      {
+        auto e = m_parallelEntities[i].entity;
+        auto buffer = m_commandBuffers[i].get();
+
+        e->game = buffer;
+        e->physics = buffer;
+        m_parallelEntities[i].loop({ &e, 1 });
+        e->game = this;
+        e->physics = m_physics.get();
+      };
+
+    m_threadPool->parallelFor((int)m_parallelEntities.size(), tickOne);
+  }
+
+  void cancelWakeUp(Entity* e)
+  {
+    auto i = m_wakeUps.find(e);
+
+    if(i == m_wakeUps.end())
+      return;
+
+    m_timers.cancel(e, i->second);
+    m_wakeUps.erase(i);
+  }
+
+  void sendPhysicsStats()
+  {
+    auto& s = m_physicsStats;
+    char text[256];
+
+    snprintf(text, sizeof text, "Physics: %.2f ms, %d traces, %d pushed", s.microseconds / 1000.0, s.traces, s.pushed);
+    m_view->sendDebugText(text);
+
+    snprintf(text, sizeof text, "Candidates: %d bodies, %d brushes, %d planes", s.bodies, s.brushes, s.planes);
+    m_view->sendDebugText(text);
+  }
+
+  // Only visits the entities which died during the tick.
+  void removeDeadThings()
+  {
+    for(auto entity : m_deaths)
+    {
+      // died before being spawned: see below
+      if(!m_entities.get(entity->gameHandle))
+        continue;
+
+      cancelWakeUp(entity);
+      entity->leave();
+      m_physics->removeBody(entity);
+      m_entities.remove(entity->gameHandle);
+    }
+
+    if(!m_deaths.empty() || !m_spawned.empty())
+      m_tickGroupsDirty = true;
+
+    m_deaths.clear();
 
     for(auto& spawned : m_spawned)
     {
+      if(spawned->dead)
+        continue;
+
       spawned->game = this;
       spawned->physics = m_physics.get();
       spawned->enter();
+      spawned->prevPos = spawned->pos;
 
       m_physics->addBody(spawned.get());
-      m_entities.push_back(move(spawned));
+      auto const entity = spawned.get();
+      entity->gameHandle = m_entities.add(move(spawned));
     }
 
     m_spawned.clear();
   }
 
-  static bool isDead(unique_ptr<Entity> const& e)
+  // What the loader thread produces: everything but the entities.
+  // Read-only once 'done': a level can be entered several times.
+  struct PendingLoad
   {
-    return e->dead;
+    atomic<bool> done { false };
+    Room room;
+    shared_ptr<const StaticWorld> world; // shared with the physics
+    string error;
+  };
+
+  // Returns true once the level is loaded.
+  // Reading and building the room happens on the loader thread, reading
+  // and decoding its model on the workers of the view. The display upload
+  // and the spawning happen here.
+  bool updateLoading()
+  {
+    if(!m_pendingLoad)
+      m_pendingLoad = requestLevel(m_level);
+
+    char filename[256];
+    snprintf(filename, sizeof filename, "res/rooms/%02d/mesh.render", m_level);
+    auto const modelLoaded = m_view->preloadInBackground(Resource { ResourceType::Model, MDL_ROOMS, filename });
+
+    if(!m_pendingLoad->done || !modelLoaded)
+      return false;
+
+    auto load = move(m_pendingLoad);
+
+    if(!load->error.empty())
+    {
+      forgetLevel(m_level);
+      throw runtime_error(load->error);
+    }
+
+    finishLoading(m_level, load);
+
+    return true;
   }
 
-  void loadLevel(int levelIdx)
+  // Returns the level from the cache, starting to load it if needed.
+  shared_ptr<PendingLoad> requestLevel(int levelIdx)
   {
+    auto& cache = m_levelCache;
+
+    // failed loads don't keep a place in the cache
+    auto failed = [] (pair<int, shared_ptr<PendingLoad>> const& entry) { return entry.second->done && !entry.second->error.empty(); };
+    cache.erase(remove_if(cache.begin(), cache.end(), failed), cache.end());
+
+    for(int i = 0; i < (int)cache.size(); ++i)
     {
-      char filename[256];
-      sprintf(filename, "res/rooms/%02d/mesh.render", levelIdx);
-      m_view->preload(Resource { ResourceType::Model, MDL_ROOMS, filename });
+      if(cache[i].first == levelIdx)
+      {
+        rotate(cache.begin(), cache.begin() + i, cache.begin() + i + 1);
+        return cache.front().second;
+      }
     }
 
+    // shared: it might outlive this state, if we quit during the loading
+    auto load = make_shared<PendingLoad>();
+
+    cache.insert(cache.begin(), { levelIdx, load });
+
+    if((int)cache.size() > LEVEL_CACHE_SIZE)
+      cache.pop_back();
+
+    auto const path = getRoomPath(levelIdx);
+
+    auto task = [load, path] ()
+      {
+        PROFILE_SCOPE("loadLevel");
+
+        try
+        {
+          load->room = loadRoom(path.c_str());
+          load->world = make_shared<StaticWorld>(load->room.colliders, move(load->room.collidersTree));
+        }
+        catch(exception const& e)
+        {
+          load->error = e.what();
+        }
+
+        load->done = true;
+      };
+
+    m_loader.run(task);
+
+    return load;
+  }
+
+  static string getRoomPath(int levelIdx)
+  {
+    char filename[256];
+    snprintf(filename, sizeof filename, "res/rooms/%02d/mesh.mesh", levelIdx);
+    return filename;
+  }
+
+  void forgetLevel(int levelIdx)
+  {
+    auto isIt = [&] (pair<int, shared_ptr<PendingLoad>> const& entry) { return entry.first == levelIdx; };
+    m_levelCache.erase(remove_if(m_levelCache.begin(), m_levelCache.end(), isIt), m_levelCache.end());
+  }
+
+  void finishLoading(int levelIdx, shared_ptr<PendingLoad> load)
+  {
+    PROFILE_SCOPE("finishLoading");
+
+    leaveLevel();
+
+    if(!m_player)
+      m_player = makeHero().release();
+
+    auto& start = load->room.start;
+    m_player->pos = Vector(start.x, start.y, start.z) - m_player->size * 0.5;
+
+    // everything else is rebuilt from the room, kept in memory
+    m_snapshot.levelIdx = levelIdx;
+    m_snapshot.load = move(load);
+    m_snapshot.player = m_player->clone();
+    m_snapshot.player->ground = {}; // from the previous level
+
+    enterLevel();
+
+    m_view->playMusic(levelIdx);
+  }
+
+  // Back to the level entry, without touching the disk nor the display.
+  void restoreSnapshot()
+  {
+    leaveLevel();
+
+    delete m_player;
+    m_player = m_snapshot.player->clone().release();
+
+    enterLevel();
+  }
+
+  // Destroys everything but the player.
+  void leaveLevel()
+  {
     if(m_player)
     {
-      for(auto& entity : m_entities)
+      for(auto& entity : m_entities.values)
         if(m_player == entity.get())
           entity.release();
     }
 
     resetPhysics();
 
-    m_entities.clear();
+    m_entities = {};
+    m_deaths.clear();
+    m_tickGroupsDirty = true;
     m_spawned.clear();
-    assert(m_listeners.empty());
-
-    {
-      char filename[256];
-      snprintf(filename, sizeof filename, "res/rooms/%02d/mesh.mesh", levelIdx);
-
-      auto level = loadRoom(filename);
-      world = level.colliders;
-
-      if(!m_player)
-        m_player = makeHero().release();
+    m_particles.clear();
+    m_arena.release();
+    m_timers.clear();
+    m_wakeUps.clear();
+    m_channels.clear();
+    m_subscriptions.clear();
+  }
 
-      m_player->pos = Vector(level.start.x, level.start.y, level.start.z) - m_player->size * 0.5;
+  // Spawns the entities of the snapshot level, and the player.
+  void enterLevel()
+  {
+    auto& load = *m_snapshot.load;
+    m_physics->setStaticWorld(load.world);
 
-      spawnEntities(level, this, levelIdx);
+    {
+      // the player outlives the level: it's not part of the arena
+      EntityArena::Scope arenaScope(&m_arena);
+      spawnEntities(load.room, this, m_snapshot.levelIdx);
     }
 
-    m_view->playMusic(levelIdx);
-
     spawn(m_player);
   }
 
@@ -218,10 +633,26 @@ struct GameState : Scene, private IGame
     m_level++;
   }
 
+  void restartLevel() override
+  {
+    m_shouldRestartLevel = true;
+  }
+
   int m_level = 1;
   bool m_shouldLoadLevel = false;
+  bool m_shouldRestartLevel = false;
   bool m_won = false;
 
+  // The level, as the player entered it
+  struct Snapshot
+  {
+    int levelIdx = 0;
+    shared_ptr<PendingLoad> load; // room and static world, shared with the level cache
+    unique_ptr<Player> player; // never spawned, cloned on restore
+  };
+
+  Snapshot m_snapshot;
+
   ////////////////////////////////////////////////////////////////
   // IGame: game, as seen by the entities
 
@@ -235,19 +666,71 @@ struct GameState : Scene, private IGame
     m_spawned.push_back(unique(e));
   }
 
-  void postEvent(unique_ptr<Event> event) override
+  void despawn(Entity* e) override
   {
-    for(auto& listener : m_listeners)
-      listener->notify(event.get());
+    m_deaths.push_back(e);
   }
 
-  unique_ptr<Handle> subscribeForEvents(IEventSink* sink) override
+  void spawnEffect(EffectType type, Vector pos) override
   {
-    auto it = m_listeners.insert(m_listeners.begin(), sink);
+    m_particles.startEmitter(getEmitterDesc(type), pos);
+  }
 
-    auto unsubscribe = [ = ] () { m_listeners.erase(it); };
+  void postEvent(const Event& event) override
+  {
+    notifyChannel(getChannel(event.type, event.key), event);
+
+    if(event.key != ANY_EVENT_KEY)
+      notifyChannel(getChannel(event.type, ANY_EVENT_KEY), event);
+  }
+
+  int subscribeForEvents(IEventSink* sink, EventType type, int key) override
+  {
+    auto const channel = getChannel(type, key);
+    auto const id = m_nextSubscription++;
+
+    m_channels[channel].push_back({ id, sink });
+    m_subscriptions[id] = channel;
 
-    return make_unique<HandleWithDeleter>(unsubscribe);
+    return id;
+  }
+
+  void unsubscribeForEvents(int id) override
+  {
+    auto i = m_subscriptions.find(id);
+
+    if(i == m_subscriptions.end())
+      return;
+
+    auto& listeners = m_channels[i->second];
+
+    for(auto j = listeners.begin(); j != listeners.end(); ++j)
+    {
+      if(j->id == id)
+      {
+        listeners.erase(j);
+        break;
+      }
+    }
+
+    m_subscriptions.erase(i);
+  }
+
+  static uint64_t getChannel(EventType type, int key)
+  {
+    return (uint64_t(type) << 32) | uint32_t(key);
+  }
+
+  // sinks must not (un)subscribe from 'notify'
+  void notifyChannel(uint64_t channel, const Event& event)
+  {
+    auto i = m_channels.find(channel);
+
+    if(i == m_channels.end())
+      return;
+
+    for(auto& listener : i->second)
+      listener.sink->notify(&event);
   }
 
   Vector getPlayerPosition() override
@@ -255,65 +738,115 @@ struct GameState : Scene, private IGame
     return m_player->pos;
   }
 
+  void wakeUpIn(Entity* e, int subTicks) override
+  {
+    cancelWakeUp(e);
+    m_wakeUps[e] = m_timers.schedule(e, max(1, subTicks));
+  }
+
   void textBox(char const* msg) override
   {
     m_view->textBox(msg);
   }
 
   Player* m_player = nullptr;
+  EntityArena m_arena; // must outlive the entities
   uvector<Entity> m_spawned;
   View* const m_view;
+  GameOptions const m_options;
   unique_ptr<IPhysics> m_physics;
 
-  list<IEventSink*> m_listeners;
+  struct Subscription
+  {
+    int id;
+    IEventSink* sink;
+  };
+
+  // subscribers, by event type and key
+  unordered_map<uint64_t, vector<Subscription>> m_channels;
+  unordered_map<int, uint64_t> m_subscriptions; // channel of each subscription
+  int m_nextSubscription = 1;
 
-  vector<Convex> world;
   bool m_debug;
+  PhysicsStats m_physicsStats; // of the last tick
   bool m_debugFirstTime = true;
 
-  uvector<Entity> m_entities;
+  // retained actors, see 'redraw'
+  struct DrawnEntity
+  {
+    ActorProxies proxies;
+    int64_t redrawCount;
+  };
+
+  unordered_map<Entity const*, DrawnEntity> m_proxies;
+  ActorProxies m_worldProxies;
+  int64_t m_redrawCount = 0;
+  bool m_mustRedraw = true;
 
-  // static stuff
+  SlotMap<unique_ptr<Entity>> m_entities; // see 'Entity::gameHandle'
+  vector<Entity*> m_deaths; // since the last 'removeDeadThings'
+  ParticleSystem m_particles;
 
-  static Actor getDebugActor(Entity* entity)
+  // The entities to tick, by concrete type (see 'registerTickLoop').
+  struct TickGroup
   {
-    auto rect = entity->getBox();
-    auto r = Actor(rect.pos, MDL_RECT);
-    r.scale = rect.size;
-    return r;
-  }
+    TickLoop loop;
+    vector<Entity*> serial;
+    vector<Entity*> parallel; // 'parallelTick'
+  };
+
+  vector<TickGroup> m_tickGroups; // the registered loops in order, then 'tickVirtual'
+  bool m_tickGroupsDirty = true;
+
+  // wake-ups of 'TickPolicy::Timer' entities, in sub-ticks
+  TimingWheel<Entity*> m_timers;
+  unordered_map<Entity*, int64_t> m_wakeUps; // deadline of each scheduled entity
+
+  // parallel ticks (opt-in)
+  ThreadPool* m_threadPool = nullptr; // null means serial ticks
 
-  Trace traceEdifice(Box box, Vector delta) const
+  struct ParallelTick
   {
-    Trace r {};
-    r.fraction = 1.0;
+    Entity* entity;
+    TickLoop loop;
+  };
 
-    for(auto& brush : world)
-    {
-      auto const halfSize = Vector3f(box.size.cx, box.size.cy, box.size.cz) * 0.5;
-      auto const pos = box.pos + halfSize;
-      auto t = brush.trace(pos, pos + delta, halfSize);
+  vector<ParallelTick> m_parallelEntities;
+  uvector<CommandBuffer> m_commandBuffers;
+  mutex m_readLock; // one entity at a time reads the world
 
-      if(t.fraction < r.fraction)
-      {
-        r.fraction = t.fraction;
-        r.plane = t.plane;
-      }
-    }
+  // level loading
+  ThreadPool m_loader; // a single worker, none when loading synchronously
+  shared_ptr<PendingLoad> m_pendingLoad; // null when not loading
+
+  // Levels recently played, most recently used first.
+  static auto const LEVEL_CACHE_SIZE = 3;
+  vector<pair<int, shared_ptr<PendingLoad>>> m_levelCache;
+
+  // static stuff
 
+  static Actor getDebugActor(Entity* entity)
+  {
+    auto rect = entity->getBox();
+    auto r = Actor(rect.pos, MDL_RECT);
+    r.scale = rect.size;
     return r;
   }
 };
 
-Scene* createPlayingStateAtLevel(View* view, int level)
+Scene* createPlayingStateAtLevel(View* view, int level, GameOptions const& options)
 {
-  auto gameState = make_unique<GameState>(view);
+  auto gameState = make_unique<GameState>(view, options);
   gameState->m_level = level;
+
+  if(options.parallelTicks)
+    gameState->m_threadPool = &getSharedThreadPool();
+
   return gameState.release();
 }
 
-Scene* createPlayingState(View* view)
+Scene* createPlayingState(View* view, GameOptions const& options)
 {
-  return createPlayingStateAtLevel(view, 1);
+  return createPlayingStateAtLevel(view, 1, options);
 }
 
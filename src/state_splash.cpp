@@ -26,7 +26,7 @@ T blend(T a, T b, float alpha)
 
 struct SplashState : Scene
 {
-  SplashState(View* view_) : view(view_)
+  SplashState(View* view_, GameOptions const& options_) : view(view_), options(options_)
   {
     view->setAmbientLight(LIGHT_ON);
   }
@@ -57,7 +57,7 @@ struct SplashState : Scene
       view->setAmbientLight(light);
 
       if(time > FADE_TIME * 3 / 2)
-        return createPlayingState(view);
+        return createPlayingState(view, options);
     }
 
     return this;
@@ -66,18 +66,19 @@ struct SplashState : Scene
   void draw() override
   {
     const auto t = time * 0.001;
-    view->setCameraPos(Vector3f(0, 0, 0), Quaternion::fromEuler(0, 0, 0));
+    view->setCameraPos(Vector3f(0, 0, 0), Quaternion::fromEuler(0, 0, 0), Vector3f(0, 0, 0));
     view->sendActor(Actor(Vector3f(1.5, 0, -t * t * 8), MDL_SPLASH));
   }
 
 private:
   View* const view;
+  GameOptions const options;
   bool activated = false;
   int time = 0;
 };
 
-Scene* createSplashState(View* view)
+Scene* createSplashState(View* view, GameOptions const& options)
 {
-  return new SplashState(view);
+  return new SplashState(view, options);
 }
 
@@ -0,0 +1,137 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Static collision world: packed brushes + bounding volume hierarchy.
+
+#include "static_world.h"
+
+namespace
+{
+// brushes closer than this to a swept box are traced too
+auto const TRACE_MARGIN = 1.0f / 64.0f;
+
+vector<PackedConvex> pack(vector<Convex> const& brushes)
+{
+  vector<PackedConvex> r;
+  r.reserve(brushes.size());
+
+  for(auto& brush : brushes)
+    r.push_back(PackedConvex(brush));
+
+  return r;
+}
+
+vector<Box> getBounds(vector<Convex> const& brushes)
+{
+  vector<Box> r;
+  r.reserve(brushes.size());
+
+  for(auto& brush : brushes)
+    r.push_back(brush.bounds);
+
+  return r;
+}
+
+int64_t getBytes(StaticWorld const& world)
+{
+  int64_t r = world.brushes.capacity() * sizeof(PackedConvex);
+
+  for(auto& brush : world.brushes)
+    r += brush.soa.capacity() * sizeof(float);
+
+  r += world.tree.nodes.capacity() * sizeof(Bvh::Node);
+  r += world.tree.indices.capacity() * sizeof(int);
+
+  return r;
+}
+
+struct BrushTracer
+{
+  vector<PackedConvex> const& brushes;
+  StaticWorld::Stats& stats;
+  Box swept;
+  Vector pos;
+  Vector delta;
+  Vector halfSize;
+  Trace r;
+
+  BrushTracer(StaticWorld const& world, Box box, Vector delta_) :
+    brushes(world.brushes),
+    stats(world.stats),
+    delta(delta_)
+  {
+    stats.traces++;
+
+    halfSize = Vector3f(box.size.cx, box.size.cy, box.size.cz) * 0.5;
+    pos = box.pos + halfSize;
+    swept = sweptBox(box, delta, TRACE_MARGIN);
+    r = {};
+    r.fraction = 1.0;
+  }
+
+  void operator () (int i)
+  {
+    // BVH leaves can hold several brushes: check each one
+    if(!boxesTouch(brushes[i].bounds, swept))
+      return;
+
+    stats.brushes++;
+    stats.planes += brushes[i].count;
+
+    auto t = brushes[i].trace(pos, pos + delta, halfSize);
+
+    if(t.fraction < r.fraction)
+    {
+      r.fraction = t.fraction;
+      r.plane = t.plane;
+    }
+  }
+};
+}
+
+StaticWorld::StaticWorld(vector<Convex> const& brushes_, Bvh tree_) :
+  brushes(pack(brushes_)),
+  tree(move(tree_))
+{
+  memory.set(getBytes(*this));
+}
+
+StaticWorld::StaticWorld(vector<Convex> const& brushes_) :
+  brushes(pack(brushes_))
+{
+  tree.build(getBounds(brushes_));
+  memory.set(getBytes(*this));
+}
+
+Trace StaticWorld::trace(Box box, Vector delta) const
+{
+  // only brushes touching the swept box can stop the move
+  BrushTracer tracer(*this, box, delta);
+  tree.query(tracer.swept, [&] (int i) { tracer(i); });
+  return tracer.r;
+}
+
+void StaticWorld::gather(Box region, vector<int>& result) const
+{
+  result.clear();
+
+  region.pos -= Vector(TRACE_MARGIN, TRACE_MARGIN, TRACE_MARGIN);
+  region.size.cx += TRACE_MARGIN * 2;
+  region.size.cy += TRACE_MARGIN * 2;
+  region.size.cz += TRACE_MARGIN * 2;
+
+  tree.query(region, [&] (int i) { result.push_back(i); });
+}
+
+Trace StaticWorld::traceCandidates(Box box, Vector delta, vector<int> const& candidates) const
+{
+  BrushTracer tracer(*this, box, delta);
+
+  for(auto i : candidates)
+    tracer(i);
+
+  return tracer.r;
+}
@@ -0,0 +1,53 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// The part of the physical world that never moves: the brushes of the room.
+// Read-only once built, but for the stats: shared by the physics which
+// traces bodies through it, and by the level cache.
+
+#pragma once
+
+#include "base/memory.h"
+#include "bvh.h"
+#include "convex.h"
+#include <vector>
+
+using namespace std;
+
+struct StaticWorld
+{
+  StaticWorld() = default;
+
+  // 'tree' must have been built from the bounds of 'brushes'.
+  StaticWorld(vector<Convex> const& brushes, Bvh tree);
+
+  // Builds the tree.
+  explicit StaticWorld(vector<Convex> const& brushes);
+
+  // Sweeps 'box' by 'delta' through all the brushes.
+  Trace trace(Box box, Vector delta) const;
+
+  // fills 'result' with the brushes that might touch 'region'
+  void gather(Box region, vector<int>& result) const;
+
+  // Same as 'trace', only considering the brushes in 'candidates'.
+  // 'candidates' must come from a 'gather' covering the swept box.
+  Trace traceCandidates(Box box, Vector delta, vector<int> const& candidates) const;
+
+  vector<PackedConvex> brushes;
+  Bvh tree;
+
+  TrackedMemory memory { MemoryTag::Physics }; // of the brushes and the tree
+
+  struct Stats
+  {
+    int traces = 0;
+    int brushes = 0; // brushes traced against
+    int planes = 0; // planes of these brushes
+  };
+
+  mutable Stats stats;
+};
@@ -0,0 +1,97 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Timing wheel: schedules values to expire after a given number of ticks.
+// Scheduling and cancelling are O(1), advancing is O(values in the slot).
+// Delays longer than the wheel simply stay in their slot for several turns.
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+template<typename T>
+struct TimingWheel
+{
+  // Returns the tick at which 'value' will expire.
+  // 'delay' is in ticks, and must be positive.
+  int64_t schedule(T value, int delay)
+  {
+    assert(delay > 0);
+    auto const deadline = now + delay;
+    slots[deadline % SLOTS].push_back({ value, deadline });
+    return deadline;
+  }
+
+  // 'deadline': as returned by 'schedule'
+  void cancel(T value, int64_t deadline)
+  {
+    auto& slot = slots[deadline % SLOTS];
+
+    for(auto& entry : slot)
+    {
+      if(entry.value == value && entry.deadline == deadline)
+      {
+        entry = slot.back();
+        slot.pop_back();
+        return;
+      }
+    }
+  }
+
+  // Advances by one tick, then calls 'onExpired(value)' for each value
+  // reaching its deadline. 'onExpired' can schedule new values.
+  template<typename Lambda>
+  void advance(Lambda onExpired)
+  {
+    ++now;
+
+    auto& slot = slots[now % SLOTS];
+
+    expired.clear();
+
+    for(int i = 0; i < (int)slot.size();)
+    {
+      if(slot[i].deadline == now)
+      {
+        expired.push_back(slot[i]);
+        slot[i] = slot.back();
+        slot.pop_back();
+      }
+      else
+      {
+        ++i;
+      }
+    }
+
+    // 'onExpired' might modify the slots
+    for(int i = 0; i < (int)expired.size(); ++i)
+      onExpired(expired[i].value);
+  }
+
+  void clear()
+  {
+    for(auto& slot : slots)
+      slot.clear();
+  }
+
+  int64_t now = 0;
+
+private:
+  static auto const SLOTS = 256;
+
+  struct Entry
+  {
+    T value;
+    int64_t deadline;
+  };
+
+  vector<Entry> slots[SLOTS];
+  vector<Entry> expired;
+};
@@ -0,0 +1,94 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Uniform grid of static boxes
+
+#include "trigger_grid.h"
+#include <algorithm> // find, sort, unique
+#include <cassert>
+#include <cmath> // floor
+
+void TriggerGrid::insert(int id, Box box)
+{
+  assert(id >= 0);
+
+  if(id >= (int)boxes.size())
+  {
+    boxes.resize(id + 1);
+    used.resize(id + 1);
+  }
+
+  assert(!used[id]);
+  boxes[id] = box;
+  used[id] = true;
+  ++count;
+
+  forEachCell(getCells(box), [&] (uint64_t key) { cells[key].push_back(id); });
+}
+
+void TriggerGrid::remove(int id)
+{
+  assert(used[id]);
+  used[id] = false;
+  --count;
+
+  auto removeFromCell = [&] (uint64_t key)
+    {
+      auto i = cells.find(key);
+      auto& ids = i->second;
+      ids.erase(find(ids.begin(), ids.end(), id));
+
+      if(ids.empty())
+        cells.erase(i);
+    };
+
+  forEachCell(getCells(boxes[id]), removeFromCell);
+}
+
+void TriggerGrid::query(Box box, vector<int>& result) const
+{
+  result.clear();
+
+  if(cells.empty())
+    return;
+
+  auto visitCell = [&] (uint64_t key)
+    {
+      auto i = cells.find(key);
+
+      if(i == cells.end())
+        return;
+
+      for(auto id : i->second)
+        if(overlaps(boxes[id], box))
+          result.push_back(id);
+    };
+
+  forEachCell(getCells(box), visitCell);
+
+  // boxes spanning several cells were found several times
+  sort(result.begin(), result.end());
+  result.erase(unique(result.begin(), result.end()), result.end());
+}
+
+TriggerGrid::CellRange TriggerGrid::getCells(Box box) const
+{
+  CellRange r;
+  r.x0 = (int)floor(box.pos.x / cellSize);
+  r.y0 = (int)floor(box.pos.y / cellSize);
+  r.z0 = (int)floor(box.pos.z / cellSize);
+  r.x1 = (int)floor((box.pos.x + box.size.cx) / cellSize);
+  r.y1 = (int)floor((box.pos.y + box.size.cy) / cellSize);
+  r.z1 = (int)floor((box.pos.z + box.size.cz) / cellSize);
+  return r;
+}
+
+uint64_t TriggerGrid::cellKey(int x, int y, int z)
+{
+  // 21 bits per axis: ±1 million cells
+  auto const mask = (uint64_t(1) << 21) - 1;
+  return ((uint64_t)x & mask) | (((uint64_t)y & mask) << 21) | (((uint64_t)z & mask) << 42);
+}
@@ -0,0 +1,61 @@
+// Copyright (C) 2018 - Sebastien Alaiwan
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Affero General Public License as
+// published by the Free Software Foundation, either version 3 of the
+// License, or (at your option) any later version.
+
+// Static boxes (the trigger volumes), bucketed in a uniform grid.
+// A query only visits the cells it covers: its cost doesn't depend on the
+// number of boxes elsewhere in the level.
+
+#pragma once
+
+#include "vec.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+struct TriggerGrid
+{
+  TriggerGrid(float cellSize_ = 4) : cellSize(cellSize_)
+  {
+  }
+
+  // 'id': small positive integer, chosen by the caller (e.g a slot)
+  void insert(int id, Box box);
+  void remove(int id);
+
+  // Replaces 'result' with the ids of the boxes overlapping 'box',
+  // sorted, once each.
+  void query(Box box, vector<int>& result) const;
+
+  int size() const { return count; }
+
+private:
+  struct CellRange
+  {
+    int x0, y0, z0;
+    int x1, y1, z1; // included
+  };
+
+  CellRange getCells(Box box) const;
+
+  static uint64_t cellKey(int x, int y, int z);
+
+  template<typename Lambda>
+  static void forEachCell(CellRange const& cells, Lambda onCell)
+  {
+    for(int z = cells.z0; z <= cells.z1; ++z)
+      for(int y = cells.y0; y <= cells.y1; ++y)
+        for(int x = cells.x0; x <= cells.x1; ++x)
+          onCell(cellKey(x, y, z));
+  }
+
+  float const cellSize;
+  unordered_map<uint64_t, vector<int>> cells; // ids of the boxes touching each cell
+  vector<Box> boxes; // by id
+  vector<bool> used; // by id
+  int count = 0;
+};
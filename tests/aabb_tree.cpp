@@ -0,0 +1,57 @@
+#include "engine/tests/tests.h"
+#include "src/aabb_tree.h"
+#include <algorithm>
+
+static
+vector<int> queryAll(AabbTree const& tree, Box box)
+{
+  vector<int> r;
+  tree.query(box, [&] (int proxy) { r.push_back((int)(intptr_t)tree.getUserData(proxy)); });
+  sort(r.begin(), r.end());
+  return r;
+}
+
+unittest("AabbTree: insert, move and remove")
+{
+  AabbTree tree(0.1);
+
+  vector<int> proxies;
+  vector<Box> boxes;
+
+  for(int i = 0; i < 100; ++i)
+  {
+    auto box = Box((i * 37) % 50, (i * 11) % 20, i % 3, 1, 1, 1);
+    boxes.push_back(box);
+    proxies.push_back(tree.insert(box, (void*)(intptr_t)i));
+  }
+
+  // move half of the boxes far away
+  for(int i = 0; i < 100; i += 2)
+  {
+    boxes[i].pos.z += 100;
+    tree.update(proxies[i], boxes[i]);
+  }
+
+  // small moves stay inside the fat boxes
+  assertEquals(false, tree.update(proxies[1], Box(boxes[1].pos.x + 0.05, boxes[1].pos.y, boxes[1].pos.z, 1, 1, 1)));
+
+  for(int i = 0; i < 100; i += 5)
+    tree.remove(proxies[i]);
+
+  auto const query = Box(0, 0, 0, 25, 20, 3);
+  vector<int> expected;
+
+  for(int i = 0; i < 100; ++i)
+    if(i % 5 && boxesTouch(boxes[i], query))
+      expected.push_back(i);
+
+  auto const actual = queryAll(tree, query);
+
+  // fat boxes might report a few more candidates, never less
+  assertTrue(includes(actual.begin(), actual.end(), expected.begin(), expected.end()));
+
+  for(auto i : actual)
+    assertTrue(i % 2 && i % 5);
+
+  assertTrue(tree.getHeight() < 16);
+}
@@ -0,0 +1,90 @@
+#include "engine/tests/tests.h"
+#include "src/actor_proxies.h"
+#include <map>
+
+namespace
+{
+// keeps the retained actors, and counts the messages
+struct ProxyView : View
+{
+  void setTitle(char const*) override {}
+  void preload(Resource) override {}
+  void textBox(char const*) override {}
+  void playMusic(int) override {}
+  void stopMusic() override {}
+  void playSound(int) override {}
+  void setCameraPos(Vector3f, Quaternion, Vector3f) override {}
+  void setAmbientLight(float) override {}
+  void sendActor(Actor const&) override {}
+  void sendDebugText(char const*) override {}
+
+  int addProxy(Actor const& actor) override
+  {
+    ++messages;
+    proxies[nextId] = actor;
+    return nextId++;
+  }
+
+  void updateProxy(int proxy, Actor const& actor) override
+  {
+    ++messages;
+    proxies.at(proxy) = actor;
+  }
+
+  void removeProxy(int proxy) override
+  {
+    ++messages;
+    proxies.erase(proxy);
+  }
+
+  map<int, Actor> proxies;
+  int nextId = 0;
+  int messages = 0;
+};
+}
+
+unittest("ActorProxies: only the changes are sent")
+{
+  ProxyView view;
+  ActorProxies proxies;
+
+  auto a = Actor(Vector3f(1, 2, 3), 7);
+  auto b = Actor(Vector3f(4, 5, 6), 8);
+
+  proxies.update(&view, { a, b });
+  assertEquals(2, (int)view.proxies.size());
+  assertEquals(2, view.messages);
+
+  // nothing changed
+  proxies.update(&view, { a, b });
+  assertEquals(2, view.messages);
+
+  b.action = 1;
+  proxies.update(&view, { a, b });
+  assertEquals(3, view.messages);
+  assertEquals(1, view.proxies.at(1).action);
+
+  // not drawn anymore
+  proxies.update(&view, { a });
+  assertEquals(1, (int)view.proxies.size());
+  assertEquals(7, view.proxies.at(0).model);
+
+  proxies.clear(&view);
+  assertEquals(0, (int)view.proxies.size());
+}
+
+unittest("ActorProxies: the motion is part of the actor")
+{
+  ProxyView view;
+  ActorProxies proxies;
+
+  auto a = Actor(Vector3f(1, 2, 3), 7);
+  a.motion = Vector3f(0, 0, 1);
+  proxies.update(&view, { a });
+
+  // stopped moving: must be sent again
+  a.motion = Vector3f(0, 0, 0);
+  proxies.update(&view, { a });
+  assertEquals(2, view.messages);
+  assertEquals(0.0f, view.proxies.at(0).motion.z);
+}
@@ -0,0 +1,71 @@
+#include "engine/tests/tests.h"
+#include "src/bvh.h"
+#include <algorithm>
+
+static
+vector<Box> makeGrid(int n)
+{
+  vector<Box> r;
+
+  for(int x = 0; x < n; ++x)
+    for(int y = 0; y < n; ++y)
+      r.push_back(Box(x * 2, y * 2, (x * y) % 3, 1, 1, 1 + x % 2));
+
+  return r;
+}
+
+static
+vector<int> queryAll(Bvh const& bvh, Box box)
+{
+  vector<int> r;
+  bvh.query(box, [&] (int i) { r.push_back(i); });
+  sort(r.begin(), r.end());
+  return r;
+}
+
+unittest("Bvh: empty")
+{
+  Bvh bvh;
+  bvh.build({});
+  assertEquals(0u, queryAll(bvh, Box(0, 0, 0, 100, 100, 100)).size());
+}
+
+unittest("Bvh: query reports at least all primitives found by brute force")
+{
+  auto const boxes = makeGrid(10);
+
+  Bvh bvh;
+  bvh.build(boxes);
+
+  vector<Box> queries =
+  {
+    Box(0, 0, 0, 100, 100, 100),
+    Box(3.5, 3.5, 0, 0.2, 0.2, 0.2),
+    Box(4, 4, 0, 3, 1, 1),
+    Box(-10, -10, -10, 1, 1, 1),
+    Box(7, 0, -1, 0.5, 20, 5),
+  };
+
+  for(auto& q : queries)
+  {
+    vector<int> expected;
+
+    for(int i = 0; i < (int)boxes.size(); ++i)
+      if(boxesTouch(boxes[i], q))
+        expected.push_back(i);
+
+    auto const actual = queryAll(bvh, q);
+    assertTrue(includes(actual.begin(), actual.end(), expected.begin(), expected.end()));
+    assertTrue(actual.size() <= expected.size() * 2 + 2);
+  }
+}
+
+unittest("Bvh: swept box covers start and end positions")
+{
+  auto r = sweptBox(Box(1, 1, 1, 1, 1, 1), Vector(-2, 0, 3), 0);
+  assertEquals(-1.0f, r.pos.x);
+  assertEquals(1.0f, r.pos.z);
+  assertEquals(3.0f, r.size.cx);
+  assertEquals(1.0f, r.size.cy);
+  assertEquals(4.0f, r.size.cz);
+}
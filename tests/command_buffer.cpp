@@ -0,0 +1,99 @@
+#include "engine/tests/tests.h"
+#include "src/body.h"
+#include "src/command_buffer.h"
+#include "src/entities/trigger.h"
+#include "src/physics.h"
+#include <memory>
+#include <mutex>
+
+namespace
+{
+struct RecordingGame : IGame
+{
+  void playSound(int id) override { sounds.push_back(id); }
+  void spawnEffect(EffectType, Vector pos) override { effects.push_back(pos); }
+  void spawn(Entity*) override {}
+  void despawn(Entity*) override {}
+  void postEvent(const Event& event) override
+  {
+    if(auto trigger = event.as<TriggerEvent>())
+      triggers.push_back(trigger->idx);
+  }
+  int subscribeForEvents(IEventSink*, EventType, int) override { return 0; }
+  void unsubscribeForEvents(int) override {}
+  Vector getPlayerPosition() override { return Vector(0, 0, 0); }
+  void textBox(char const*) override {}
+  void wakeUpIn(Entity*, int) override {}
+
+  vector<int> sounds;
+  vector<int> triggers;
+  vector<Vector> effects;
+};
+}
+
+unittest("CommandBuffer: writes are deferred until applied, in order")
+{
+  RecordingGame game;
+  auto physics = createPhysics();
+  mutex readLock;
+
+  Body body;
+  body.pos = Vector(0, 0, 0);
+  body.size = Size(1, 1, 1);
+  physics->addBody(&body);
+
+  CommandBuffer buffer(&game, physics.get(), &readLock);
+  buffer.playSound(3);
+  buffer.moveBody(&body, Vector(1, 0, 0));
+  buffer.playSound(5);
+  buffer.moveBody(&body, Vector(0, 2, 0));
+
+  assertEquals(0, (int)game.sounds.size());
+  assertEquals(0.0f, body.pos.x);
+
+  buffer.apply();
+
+  assertEquals(vector<int>({ 3, 5 }), game.sounds);
+  assertEquals(1.0f, body.pos.x);
+  assertEquals(2.0f, body.pos.y);
+
+  // applied commands are forgotten
+  buffer.apply();
+  assertEquals(2, (int)game.sounds.size());
+}
+
+unittest("CommandBuffer: deferred events are copies")
+{
+  RecordingGame game;
+  auto physics = createPhysics();
+  mutex readLock;
+
+  CommandBuffer buffer(&game, physics.get(), &readLock);
+
+  {
+    TriggerEvent event(7);
+    buffer.postEvent(event);
+    event.idx = 8;
+  }
+
+  buffer.postEvent(TriggerEvent(9));
+  assertEquals(0, (int)game.triggers.size());
+
+  buffer.apply();
+  assertEquals(vector<int>({ 7, 9 }), game.triggers);
+}
+
+unittest("CommandBuffer: deferred effects")
+{
+  RecordingGame game;
+  auto physics = createPhysics();
+  mutex readLock;
+
+  CommandBuffer buffer(&game, physics.get(), &readLock);
+  buffer.spawnEffect(EffectType::Explosion, Vector(1, 2, 3));
+  assertEquals(0, (int)game.effects.size());
+
+  buffer.apply();
+  assertEquals(1, (int)game.effects.size());
+  assertEquals(2.0f, game.effects[0].y);
+}
@@ -1,47 +1,9 @@
 #include <algorithm>
 
 #include "entities/bonus.h"
-#include "entities/explosion.h"
 
 #include "engine/tests/tests.h"
 
-static Actor getActor(Entity* entity)
-{
-  struct FakeView : View
-  {
-    virtual void setTitle(char const*) {}
-    virtual void preload(Resource) {}
-    virtual void textBox(char const*) {}
-    virtual void playMusic(int) {}
-    virtual void stopMusic() {}
-    virtual void playSound(int) {}
-    virtual void setCameraPos(Vector3f, Quaternion) {}
-    virtual void setAmbientLight(float) {}
-
-    // adds a displayable object to the current frame
-    virtual void sendActor(Actor const& actor) { this->actor = actor; }
-
-    Actor actor;
-  };
-  FakeView fakeView;
-  entity->onDraw(&fakeView);
-  return fakeView.actor;
-}
-
-unittest("Entity: explosion")
-{
-  auto explosion = makeExplosion();
-
-  assert(!explosion->dead);
-  assertEquals(0, getActor(explosion.get()).ratio);
-
-  for(int i = 0; i < 10000; ++i)
-    explosion->tick();
-
-  assert(explosion->dead);
-  assertEquals(100, int(getActor(explosion.get()).ratio * 100));
-}
-
 #include "entities/player.h"
 
 struct NullPlayer : Player
@@ -68,11 +30,13 @@ struct NullGame : IGame
 {
   virtual void playSound(int) {}
   virtual void spawn(Entity*) {}
-  virtual void postEvent(unique_ptr<Event>) {}
-  virtual unique_ptr<Handle> subscribeForEvents(IEventSink*) { return nullptr; }
-  virtual void unsubscribeForEvents(IEventSink*) {}
+  virtual void despawn(Entity*) {}
+  virtual void postEvent(const Event&) {}
+  virtual int subscribeForEvents(IEventSink*, EventType, int) { return 0; }
+  virtual void unsubscribeForEvents(int) {}
   virtual Vector3f getPlayerPosition() { return Vector3f(0, 0, 0); }
   virtual void textBox(char const*) {}
+  virtual void wakeUpIn(Entity*, int) {}
 };
 
 struct NullPhysicsProbe : IPhysicsProbe
@@ -111,6 +75,13 @@ struct NullPhysicsProbe : IPhysicsProbe
     return r;
   }
 
+  void stepSlideMove(Body* body, Vector delta, float stepHeight) override
+  {
+    moveBody(body, Up * stepHeight);
+    moveBody(body, delta);
+    moveBody(body, Down * stepHeight);
+  }
+
   Body* getBodiesInBox(Box, int, bool, const Body*) const override
   {
     return nullptr;
@@ -122,3 +93,110 @@ bool nearlyEquals(float expected, float actual)
   return abs(expected - actual) < 0.01;
 }
 
+
+#include "entities/hero.h"
+#include "entity_factory.h"
+
+struct NoArgs : IEntityConfig
+{
+  string getString(int, string defaultValue) override { return defaultValue; }
+  int getInt(int, int defaultValue) override { return defaultValue; }
+};
+
+struct CountingEntity : Entity
+{
+  int ticks = 0;
+
+  void tick() override { ++ticks; }
+  void onDraw(View*) const override {}
+};
+
+unittest("Entity: tick loops run by type, in name order")
+{
+  NoArgs args;
+  auto amulet = createEntity("amulet", &args);
+  auto crate = createEntity("crate", &args);
+  auto platform = createEntity("moving_platform", &args);
+  auto hero = makeHero();
+
+  assertTrue(findTickLoop(*amulet) >= 0);
+  assertEquals(findTickLoop(*amulet), findTickLoop(*crate));
+  assertTrue(findTickLoop(*amulet) < findTickLoop(*hero));
+  assertTrue(findTickLoop(*hero) < findTickLoop(*platform));
+
+  // no loop: ticked through 'Entity::tick'
+  assertEquals(-1, findTickLoop(CountingEntity()));
+}
+
+unittest("Entity: tick loops follow the tick policy")
+{
+  CountingEntity entities[3];
+  entities[1].tickPolicy = TickPolicy::OncePerTick;
+  entities[2].tickPolicy = TickPolicy::Timer;
+
+  Entity* all[] = { &entities[0], &entities[1], &entities[2] };
+  tickAs<CountingEntity>(all);
+
+  assertEquals(SUB_TICKS, entities[0].ticks);
+  assertEquals(1, entities[1].ticks);
+  assertEquals(0, entities[2].ticks);
+}
+
+struct EndLevelCounter : NullGame
+{
+  void endLevel() override { ++count; }
+
+  int count = 0;
+};
+
+unittest("Entity: a finish line ends the level again while touched")
+{
+  NoArgs args;
+  EndLevelCounter game;
+  auto finish = createEntity("finish", &args);
+  finish->game = &game;
+
+  auto runTicks = [&] (int n)
+    {
+      for(int i = 0; i < n; ++i)
+        finish->tick();
+    };
+
+  Body hero;
+  finish->onTriggerEnter(&hero);
+  runTicks(1000);
+  assertEquals(1, game.count);
+
+  // staying inside
+  runTicks(1000);
+  assertEquals(2, game.count);
+
+  // left during the delay
+  finish->onTriggerExit(&hero);
+  runTicks(3000);
+  assertEquals(3, game.count);
+}
+
+struct DespawnCounter : NullGame
+{
+  void despawn(Entity*) override { ++count; }
+
+  int count = 0;
+};
+
+unittest("Entity: dying despawns the entity once")
+{
+  DespawnCounter game;
+  CountingEntity entity;
+
+  // not spawned yet: nobody to tell
+  entity.die();
+  assertTrue(entity.dead);
+  assertEquals(0, game.count);
+
+  CountingEntity spawned;
+  spawned.game = &game;
+  spawned.die();
+  spawned.die();
+  assertEquals(1, game.count);
+}
@@ -0,0 +1,56 @@
+#include "engine/tests/tests.h"
+#include "src/entity.h"
+#include <memory>
+
+namespace
+{
+struct SmallThing : Entity
+{
+  void onDraw(View*) const override {}
+};
+
+struct BigThing : Entity
+{
+  void onDraw(View*) const override {}
+  char payload[200];
+};
+}
+
+unittest("EntityArena: entities created in a scope come from the arena")
+{
+  EntityArena arena;
+
+  {
+    EntityArena::Scope scope(&arena);
+    auto a = make_unique<SmallThing>();
+    auto b = make_unique<BigThing>();
+    auto c = make_unique<SmallThing>();
+    assertEquals(3, arena.getLiveCount());
+  }
+
+  assertEquals(0, arena.getLiveCount());
+
+  auto outside = make_unique<SmallThing>();
+  assertEquals(0, arena.getLiveCount());
+
+  arena.release();
+}
+
+unittest("EntityArena: same-type entities are packed, freed slots are reused")
+{
+  EntityArena arena;
+  EntityArena::Scope scope(&arena);
+
+  auto a = make_unique<SmallThing>();
+  auto b = make_unique<SmallThing>();
+  auto c = make_unique<SmallThing>();
+
+  auto const stride = (char*)c.get() - (char*)b.get();
+  assertEquals(stride, (char*)b.get() - (char*)a.get());
+  assertTrue(stride < (int)sizeof(SmallThing) + 64);
+
+  auto const freed = b.get();
+  b.reset();
+  auto d = make_unique<SmallThing>();
+  assertTrue(d.get() == freed);
+}
@@ -0,0 +1,89 @@
+#include "engine/tests/tests.h"
+#include "src/particles.h"
+
+namespace
+{
+struct ParticleView : View
+{
+  void setTitle(char const*) override {}
+  void preload(Resource) override {}
+  void textBox(char const*) override {}
+  void playMusic(int) override {}
+  void stopMusic() override {}
+  void playSound(int) override {}
+  void setCameraPos(Vector3f, Quaternion, Vector3f) override {}
+  void setAmbientLight(float) override {}
+  void sendActor(Actor const&) override { ++actors; }
+  int addProxy(Actor const&) override { return 0; }
+  void updateProxy(int, Actor const&) override {}
+  void removeProxy(int) override {}
+  void sendDebugText(char const*) override {}
+
+  void sendParticles(int model, Span<const Particle> particles) override
+  {
+    batches.push_back(model);
+    drawn.insert(drawn.end(), particles.begin(), particles.end());
+  }
+
+  int actors = 0;
+  vector<int> batches;
+  vector<Particle> drawn;
+};
+
+EmitterDesc const desc { 3, 4, 2, 0.5f, 0, 1, 10 };
+}
+
+unittest("Particles: emitters spawn for their duration")
+{
+  ParticleSystem particles;
+  particles.startEmitter(desc, Vector(10, 0, 0));
+
+  particles.tick();
+  assertEquals(4, particles.getParticleCount());
+
+  particles.tick();
+  assertEquals(8, particles.getParticleCount());
+
+  particles.tick();
+  assertEquals(8, particles.getParticleCount());
+
+  // the first ones have lived 10 ticks
+  for(int i = 0; i < 7; ++i)
+    particles.tick();
+
+  assertEquals(4, particles.getParticleCount());
+
+  particles.tick();
+  assertEquals(0, particles.getParticleCount());
+}
+
+unittest("Particles: one batch per model")
+{
+  ParticleSystem particles;
+  particles.startEmitter(desc, Vector(10, 0, 0));
+  particles.startEmitter(desc, Vector(0, 0, 0));
+
+  auto other = desc;
+  other.model = 5;
+  particles.startEmitter(other, Vector(0, 0, 0));
+
+  particles.tick();
+
+  ParticleView view;
+  particles.draw(&view);
+
+  assertEquals(0, view.actors);
+  assertEquals(vector<int>({ 3, 5 }), view.batches);
+  assertEquals(12, (int)view.drawn.size());
+
+  // moving away from their emitter, at its speed
+  for(auto& p : view.drawn)
+  {
+    assertTrue(abs(magnitude(p.motion) - 0.5) < 0.001);
+    assertTrue(abs(magnitude(p.pos - (p.pos.x > 5 ? Vector(10, 0, 0) : Vector(0, 0, 0))) - 0.5) < 0.001);
+    assertTrue(p.size < 1);
+  }
+
+  particles.clear();
+  assertEquals(0, particles.getParticleCount());
+}
@@ -1,6 +1,8 @@
 #include "engine/tests/tests.h"
+#include "base/util.h" // allPairs
 #include "src/body.h"
 #include "src/physics.h"
+#include "src/static_world.h"
 #include <cmath>
 #include <memory>
 
@@ -37,47 +39,31 @@ void assertNearlyEqualsFunc(Vector expected, Vector actual, const char* file, in
 
 ///////////////////////////////////////////////////////////////////////////////
 
+// vertical walls at x=0 and y=0
 static
-::Trace traceEdifice(Box rect, Vector delta)
+unique_ptr<StaticWorld> makeWalls()
 {
-  ::Trace r {};
-  r.fraction = 1.0;
-
-  auto const x0 = 0;
-  auto const y0 = 0;
-  auto const targetX = rect.pos.x + delta.x;
-  auto const targetY = rect.pos.y + delta.y;
-
-  if(targetX < 0)
-  {
-    auto const fraction = abs(rect.pos.x - x0) / abs(delta.x);
-
-    if(fraction < r.fraction)
-    {
-      r.fraction = fraction;
-      r.plane.N = Vector3f(1, 0, 0);
-    }
-  }
+  vector<Convex> brushes;
+  brushes.push_back(makeBoxConvex(Box(-1000, -1000, -1000, 1000, 2000, 2000)));
+  brushes.push_back(makeBoxConvex(Box(-1000, -1000, -1000, 2000, 1000, 2000)));
+  return make_unique<StaticWorld>(brushes);
+}
 
-  if(targetY < 0)
+struct CountingBody : Body
+{
+  void onCollision(Body*) override
   {
-    auto const fraction = abs(rect.pos.y - y0) / abs(delta.y);
-
-    if(fraction < r.fraction)
-    {
-      r.fraction = fraction;
-      r.plane.N = Vector3f(0, 1, 0);
-    }
+    collisions++;
   }
 
-  return r;
-}
+  int collisions = 0;
+};
 
 struct Fixture
 {
   Fixture() : physics(createPhysics())
   {
-    physics->setEdifice(&traceEdifice);
+    physics->setStaticWorld(makeWalls());
     physics->addBody(&mover);
   }
 
@@ -159,3 +145,481 @@ unittest("Physics: slide up-left move, horizontally blocked by vertical wall at
   assertNearlyEquals(Vector(0, 30, 0), fix.mover.pos);
 }
 
+unittest("Physics: checkForOverlaps reports each overlapping pair once")
+{
+  auto physics = createPhysics();
+  physics->setStaticWorld(makeWalls());
+
+  CountingBody bodies[20];
+
+  for(int i = 0; i < 20; ++i)
+  {
+    bodies[i].pos = Vector((i * 7) % 10, (i % 3) * 0.5, 0);
+    physics->addBody(&bodies[i]);
+  }
+
+  // move a few bodies around, so the broadphase has to catch up
+  bodies[3].pos.x = 50;
+  bodies[4].pos.x = 50.5;
+  physics->moveBody(&bodies[5], Vector(-3, 0, 0));
+
+  int expected[20] {};
+
+  for(auto p : allPairs(20))
+  {
+    if(overlaps(bodies[p.first].getBox(), bodies[p.second].getBox()))
+    {
+      expected[p.first]++;
+      expected[p.second]++;
+    }
+  }
+
+  physics->checkForOverlaps();
+
+  for(int i = 0; i < 20; ++i)
+    assertEquals(expected[i], bodies[i].collisions);
+
+  assertEquals(1, bodies[3].collisions);
+}
+
+unittest("Physics: batched traces give the same results as single traces")
+{
+  Fixture fix;
+  fix.mover.pos = Vector(5, 5, 0);
+
+  Body blockers[4];
+
+  for(int i = 0; i < 4; ++i)
+  {
+    blockers[i].pos = Vector(10 + i * 3, 5, 0);
+    blockers[i].solid = true;
+    fix.physics->addBody(&blockers[i]);
+  }
+
+  IPhysicsProbe::TraceQuery queries[] =
+  {
+    { fix.mover.getBox(), Vector(20, 0, 0), &fix.mover },
+    { fix.mover.getBox(), Vector(-20, 0, 0), &fix.mover },
+    { blockers[1].getBox(), Vector(10, 0, 0), &blockers[1] },
+    { Box(10.5, 0, 0, 1, 1, 1), Vector(0, 10, 0), nullptr },
+  };
+
+  IPhysicsProbe::Trace results[4];
+  fix.physics->traceBoxes(queries, results);
+
+  for(int i = 0; i < 4; ++i)
+  {
+    auto expected = fix.physics->traceBox(queries[i].box, queries[i].delta, queries[i].except);
+    assertEquals(expected.fraction, results[i].fraction);
+    assertTrue(expected.blocker == results[i].blocker);
+  }
+
+  assertTrue(results[0].blocker == &blockers[0]);
+  assertTrue(results[2].blocker == &blockers[2]);
+  assertTrue(results[3].blocker == &blockers[0]);
+}
+
+unittest("Physics: step move gives the same result as separate moves")
+{
+  struct World
+  {
+    Fixture fix;
+    Body blockers[3];
+
+    World()
+    {
+      fix.mover.pos = Vector(5, 5, 0.1);
+
+      // a low step, a wall, and a far away body
+      blockers[0].pos = Vector(7, 4, 0);
+      blockers[0].size = Size(3, 3, 0.2);
+      blockers[1].pos = Vector(11, 0, 0);
+      blockers[1].size = Size(1, 20, 5);
+      blockers[2].pos = Vector(50, 50, 50);
+
+      for(auto& b : blockers)
+      {
+        b.solid = true;
+        fix.physics->addBody(&b);
+      }
+    }
+  };
+
+  World separate;
+  World combined;
+
+  auto const stepHeight = 0.5f;
+
+  for(auto delta : { Vector(3, 1, 0), Vector(4, 2, 0), Vector(-1, 0, -1) })
+  {
+    separate.fix.physics->moveBody(&separate.fix.mover, Up * stepHeight);
+    slideMove(separate.fix.physics.get(), &separate.fix.mover, delta);
+    separate.fix.physics->moveBody(&separate.fix.mover, Down * stepHeight);
+
+    combined.fix.physics->stepSlideMove(&combined.fix.mover, delta, stepHeight);
+
+    assertEquals(separate.fix.mover.pos.x, combined.fix.mover.pos.x);
+    assertEquals(separate.fix.mover.pos.y, combined.fix.mover.pos.y);
+    assertEquals(separate.fix.mover.pos.z, combined.fix.mover.pos.z);
+    assertTrue(separate.fix.physics->getGround(&separate.fix.mover) == &separate.blockers[0]);
+    assertTrue(combined.fix.physics->getGround(&combined.fix.mover) == &combined.blockers[0]);
+  }
+}
+
+unittest("Physics: pushers carry the bodies resting on them")
+{
+  Fixture fix;
+
+  Body platform;
+  platform.pos = Vector(10, 10, 0);
+  platform.size = Size(2, 2, 1);
+  platform.solid = true;
+  platform.pusher = true;
+  fix.physics->addBody(&platform);
+
+  Body faraway;
+  faraway.pos = Vector(30, 30, 1);
+  fix.physics->addBody(&faraway);
+
+  // land on the platform
+  fix.mover.pos = Vector(10.5, 10.5, 1.05);
+  fix.physics->moveBody(&fix.mover, Down * 0.04);
+  assertTrue(fix.physics->getGround(&fix.mover) == &platform);
+
+  fix.physics->moveBody(&platform, Vector(3, 1, 0));
+  assertNearlyEquals(Vector(13.5, 11.5, 0), fix.mover.pos);
+  assertNearlyEquals(Vector(30, 30, 0), faraway.pos);
+
+  // removing the platform leaves nothing dangling
+  fix.physics->removeBody(&platform);
+  assertTrue(fix.physics->getGround(&fix.mover) == nullptr);
+
+  // not even once its slot is reused
+  Body newcomer;
+  newcomer.pos = Vector(40, 40, 0);
+  fix.physics->addBody(&newcomer);
+  assertTrue(fix.physics->getGround(&fix.mover) == nullptr);
+}
+
+unittest("Physics: getBodiesInBox only finds bodies of the requested groups")
+{
+  Fixture fix;
+
+  Body walls[10];
+
+  for(int i = 0; i < 10; ++i)
+  {
+    walls[i].pos = Vector(i, 0, 0);
+    walls[i].collisionGroup = 0b0010;
+    fix.physics->addBody(&walls[i]);
+  }
+
+  Body player;
+  player.pos = Vector(5, 0, 0);
+  player.collisionGroup = 0b1000;
+  fix.physics->addBody(&player);
+
+  auto const box = Box(4.5, 0, 0, 1, 1, 1);
+  assertTrue(fix.physics->getBodiesInBox(box, 0b1000) == &player);
+  assertTrue(fix.physics->getBodiesInBox(box, 0b1000, false, &player) == nullptr);
+  assertTrue(fix.physics->getBodiesInBox(box, 0b0100) == nullptr);
+  assertTrue(fix.physics->getBodiesInBox(box, 0b0010) != nullptr);
+  assertTrue(fix.physics->getBodiesInBox(box, -1) != nullptr);
+
+  // group changes are picked up by the next move
+  player.collisionGroup = 0b0100;
+  fix.physics->moveBody(&player, Vector(0, 0, 0));
+  assertTrue(fix.physics->getBodiesInBox(box, 0b1000) == nullptr);
+  assertTrue(fix.physics->getBodiesInBox(box, 0b0100) == &player);
+}
+
+unittest("Physics: queries see a teleport right away")
+{
+  Fixture fix;
+
+  Body body;
+  body.pos = Vector(10, 10, 0);
+  body.solid = true;
+  fix.physics->addBody(&body);
+
+  auto const there = Box(30, 30, 0, 1, 1, 1);
+  assertTrue(fix.physics->getBodiesInBox(there, -1, false, &fix.mover) == nullptr);
+  assertTrue(fix.physics->traceBox(Box(7, 10, 0, 1, 1, 1), Vector(5, 0, 0), &fix.mover).fraction < 1.0f);
+
+  fix.physics->teleport(&body, Vector(30, 30, 0));
+  assertTrue(fix.physics->getBodiesInBox(there, -1, false, &fix.mover) == &body);
+  assertTrue(fix.physics->getBodiesInBox(Box(10, 10, 0, 1, 1, 1), -1, false, &fix.mover) == nullptr);
+  assertEquals(1.0f, fix.physics->traceBox(Box(7, 10, 0, 1, 1, 1), Vector(5, 0, 0), &fix.mover).fraction);
+}
+
+unittest("Physics: getBodiesInBox returns the oldest of several matches")
+{
+  Fixture fix;
+
+  Body bodies[32];
+
+  for(int i = 0; i < 32; ++i)
+  {
+    bodies[i].pos = Vector(10 + (i * 7) % 5 * 0.1, 10 + (i * 3) % 4 * 0.1, 0);
+    bodies[i].collisionGroup = i % 2 ? 0b0010 : 0b0001;
+    fix.physics->addBody(&bodies[i]);
+  }
+
+  // reshape the trees
+  for(int i = 31; i >= 0; i -= 3)
+    fix.physics->moveBody(&bodies[i], Vector(0.05, 0.05, 0));
+
+  auto const box = Box(10, 10, 0, 2, 2, 1);
+  assertTrue(fix.physics->getBodiesInBox(box, -1) == &bodies[0]);
+  assertTrue(fix.physics->getBodiesInBox(box, 0b0011) == &bodies[0]);
+  assertTrue(fix.physics->getBodiesInBox(box, 0b0010) == &bodies[1]);
+  assertTrue(fix.physics->getBodiesInBox(box, 0b0011, false, &bodies[0]) == &bodies[1]);
+}
+
+unittest("Physics: sleeping bodies stop colliding with each other")
+{
+  Fixture fix;
+  fix.mover.pos = Vector(100, 100, 100);
+
+  Body a;
+  a.pos = Vector(0, 0, 0);
+  fix.physics->addBody(&a);
+
+  CountingBody b;
+  b.pos = Vector(0.5, 0, 0);
+  fix.physics->addBody(&b);
+
+  auto& collisions = b.collisions;
+
+  for(int i = 0; i < 1000; ++i)
+    fix.physics->checkForOverlaps();
+
+  auto const collisionsBeforeSleep = collisions;
+  assertTrue(collisionsBeforeSleep > 0);
+  assertTrue(collisionsBeforeSleep < 1000);
+
+  // a teleport wakes 'a' up, which wakes 'b' up
+  a.pos.y = 0.1;
+  fix.physics->checkForOverlaps();
+  fix.physics->checkForOverlaps();
+  assertEquals(collisionsBeforeSleep + 2, collisions);
+}
+
+unittest("Physics: a moving body wakes up the sleeping ones it touches")
+{
+  Fixture fix;
+  fix.mover.pos = Vector(100, 100, 100);
+
+  Body sleeper;
+  sleeper.pos = Vector(0, 0, 0);
+  fix.physics->addBody(&sleeper);
+
+  CountingBody neighbour;
+  neighbour.pos = Vector(0.5, 0, 0);
+  fix.physics->addBody(&neighbour);
+
+  for(int i = 0; i < 1000; ++i)
+    fix.physics->checkForOverlaps();
+
+  auto const collisionsBeforeSleep = neighbour.collisions;
+
+  // touches 'sleeper', not 'neighbour'
+  Body mover;
+  mover.pos = Vector(-0.7, 0, 0);
+  fix.physics->addBody(&mover);
+
+  for(int i = 0; i < 3; ++i)
+  {
+    fix.physics->moveBody(&mover, Vector(0, 0.01, 0));
+    fix.physics->checkForOverlaps();
+  }
+
+  // awake, 'sleeper' collides with 'neighbour' again
+  assertTrue(neighbour.collisions > collisionsBeforeSleep);
+}
+
+unittest("Physics: a static world shared by two physics")
+{
+  shared_ptr<const StaticWorld> walls = makeWalls();
+
+  for(int i = 0; i < 2; ++i)
+  {
+    // e.g a level restart
+    auto physics = createPhysics();
+    physics->setStaticWorld(walls);
+
+    Body mover;
+    mover.pos = Vector(10, 10, 0);
+    physics->addBody(&mover);
+    physics->moveBody(&mover, Vector(-20, 0, 0));
+    assertNearlyEquals(Vector(0, 10, 0), mover.pos);
+  }
+
+  assertEquals(1, (int)walls.use_count());
+}
+
+unittest("Physics: ground traces are reused until something moves nearby")
+{
+  auto walls = makeWalls();
+  auto& edificeTraces = walls->stats.traces;
+
+  auto physics = createPhysics();
+  physics->setStaticWorld(move(walls));
+
+  Body crate;
+  crate.pos = Vector(10, 10, 1.05);
+  physics->addBody(&crate);
+
+  Body floor;
+  floor.pos = Vector(10, 10, 0);
+  floor.solid = true;
+  physics->addBody(&floor);
+
+  for(int i = 0; i < 10; ++i)
+    assertTrue(physics->traceGround(&crate).blocker == &floor);
+
+  assertEquals(1, edificeTraces);
+
+  // a far away move changes nothing
+  Body other;
+  other.pos = Vector(50, 50, 0);
+  physics->addBody(&other);
+  physics->moveBody(&other, Vector(1, 0, 0));
+  edificeTraces = 0;
+  physics->traceGround(&crate);
+  assertEquals(0, edificeTraces);
+
+  // the floor goes away from under the crate
+  physics->moveBody(&floor, Vector(5, 0, 0));
+  assertTrue(physics->traceGround(&crate).fraction == 1.0);
+
+  // the floor comes back
+  physics->moveBody(&floor, Vector(-5, 0, 0));
+  assertTrue(physics->traceGround(&crate).blocker == &floor);
+
+  // the floor stops being solid
+  floor.solid = false;
+  assertTrue(physics->traceGround(&crate).fraction == 1.0);
+}
+
+unittest("Physics: stats count the work done since the last reset")
+{
+  Fixture fix;
+  fix.mover.pos = Vector(10, 10, 0);
+
+  fix.physics->moveBody(&fix.mover, Vector(-20, 0, 0));
+
+  auto stats = fix.physics->getStats();
+  assertTrue(stats.traces > 0);
+  assertTrue(stats.brushes > 0);
+  assertEquals(stats.brushes * 6, stats.planes);
+
+  fix.physics->resetStats();
+  stats = fix.physics->getStats();
+  assertEquals(0, stats.traces);
+  assertEquals(0, stats.brushes);
+}
+
+unittest("Physics: a removed body can be added back")
+{
+  Fixture fix;
+  fix.mover.pos = Vector(100, 100, 100);
+
+  CountingBody a;
+  a.pos = Vector(0, 0, 0);
+  fix.physics->addBody(&a);
+
+  Body b;
+  b.pos = Vector(0.5, 0, 0);
+  fix.physics->addBody(&b);
+
+  fix.physics->removeBody(&a);
+  fix.physics->addBody(&a);
+  fix.physics->checkForOverlaps();
+  assertEquals(1, a.collisions);
+
+  fix.physics->removeBody(&b);
+  fix.physics->checkForOverlaps();
+  assertEquals(1, a.collisions);
+  assertTrue(fix.physics->getBodiesInBox(b.getBox(), -1, false, &a) == nullptr);
+}
+
+struct CountingTrigger : Body
+{
+  CountingTrigger()
+  {
+    trigger = true;
+    collidesWith = 2;
+    size = Size(2, 2, 2);
+  }
+
+  void onCollision(Body*) override { collisions++; }
+  void onTriggerEnter(Body*) override { enters++; }
+  void onTriggerExit(Body*) override { exits++; }
+
+  int collisions = 0;
+  int enters = 0;
+  int exits = 0;
+};
+
+unittest("Physics: triggers report the bodies entering and leaving")
+{
+  auto physics = createPhysics();
+  physics->setStaticWorld(makeWalls());
+
+  Body inside;
+  inside.collisionGroup = 2;
+  inside.pos = Vector(10.5, 10.5, 0);
+  physics->addBody(&inside);
+
+  CountingTrigger trigger;
+  trigger.pos = Vector(10, 10, 0);
+  physics->addBody(&trigger);
+
+  Body mover;
+  mover.collisionGroup = 2;
+  mover.pos = Vector(5, 10.5, 0);
+  physics->addBody(&mover);
+
+  Body ignored; // not in 'collidesWith'
+  ignored.collisionGroup = 1;
+  ignored.pos = Vector(5, 10.5, 2);
+  physics->addBody(&ignored);
+
+  // the body already inside enters once
+  physics->checkForOverlaps();
+  physics->checkForOverlaps();
+  assertEquals(1, trigger.enters);
+
+  physics->moveBody(&mover, Vector(5, 0, 0));
+  physics->moveBody(&ignored, Vector(5, 0, 0));
+  physics->checkForOverlaps();
+  assertEquals(2, trigger.enters);
+
+  // moving inside the trigger isn't an event
+  physics->moveBody(&mover, Vector(0.5, 0, 0));
+  physics->checkForOverlaps();
+  assertEquals(2, trigger.enters);
+  assertEquals(0, trigger.exits);
+
+  // a teleport is a move too
+  mover.pos = Vector(30, 30, 0);
+  physics->checkForOverlaps();
+  assertEquals(1, trigger.exits);
+
+  // triggers don't collide
+  assertEquals(0, trigger.collisions);
+
+  // a body leaving the physics exits, a trigger leaving it is silent
+  physics->removeBody(&inside);
+  assertEquals(2, trigger.exits);
+
+  mover.pos = Vector(10.5, 10.5, 0);
+  physics->checkForOverlaps();
+  assertEquals(3, trigger.enters);
+
+  physics->removeBody(&trigger);
+  physics->removeBody(&mover);
+  physics->checkForOverlaps();
+  assertEquals(2, trigger.exits);
+}
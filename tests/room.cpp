@@ -0,0 +1,161 @@
+#include "base/thread_pool.h"
+#include "engine/tests/tests.h"
+#include "src/room.h"
+
+// axis-aligned box, as exported from blender: one triangle per 3 vertices
+static
+Mesh makeBoxMesh(string name, Vector3f lo, Vector3f hi)
+{
+  Mesh mesh;
+  mesh.name = name;
+
+  auto corner = [&] (int i)
+    {
+      return Vector3f(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z);
+    };
+
+  // counter-clockwise quads, seen from outside
+  int const quads[6][4] =
+  {
+    { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, // -z, +z
+    { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, // -y, +y
+    { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, // -x, +x
+  };
+
+  auto addVertex = [&] (int i)
+    {
+      auto v = corner(i);
+      mesh.vertices.push_back({ v.x, v.y, v.z, 0, 0, 0, 0, 0 });
+    };
+
+  for(auto& q : quads)
+  {
+    for(int k : { 0, 1, 2, 0, 2, 3 })
+      addVertex(q[k]);
+  }
+
+  for(int i = 0; i < (int)mesh.vertices.size(); i += 3)
+    mesh.faces.push_back({ i, i + 1, i + 2 });
+
+  return mesh;
+}
+
+static
+vector<Mesh> makeTestRoom()
+{
+  vector<Mesh> meshes;
+  meshes.push_back(makeBoxMesh("floor", Vector3f(-10, -10, -1), Vector3f(10, 10, 0)));
+  meshes.push_back(makeBoxMesh("wall", Vector3f(5, -10, 0), Vector3f(6, 10, 4)));
+  meshes.push_back(makeBoxMesh("f.start", Vector3f(1, 2, 3), Vector3f(2, 3, 4)));
+  meshes.push_back(makeBoxMesh("f.door(4)", Vector3f(0, 0, 0), Vector3f(2, 2, 2)));
+  return meshes;
+}
+
+unittest("Room: build brushes from meshes")
+{
+  auto room = buildRoom(makeTestRoom());
+
+  assertEquals(2u, room.colliders.size());
+  auto& table = room.spawnTable;
+  assertEquals(1u, table.spawns.size());
+  assertEquals(string("door"), table.types[table.spawns[0].type]);
+  assertEquals(1, table.spawns[0].argCount);
+  assertEquals(string("4"), table.args[table.spawns[0].firstArg].text);
+  assertEquals(4, table.args[table.spawns[0].firstArg].value);
+  assertEquals(1, room.start.x);
+
+  // 12 triangles, welded into 6 planes, no useless bevel
+  assertEquals(6u, room.colliders[0].planes.size());
+
+  auto& wall = room.colliders[1];
+  assertEquals(5.0f, wall.bounds.pos.x);
+  assertEquals(4.0f, wall.bounds.size.cz);
+
+  // falling on the floor
+  auto t = room.colliders[0].trace(Vector3f(0, 0, 5), Vector3f(0, 0, -5), Vector3f(0.5, 0.5, 0.5));
+  assertTrue(t.fraction > 0.44 && t.fraction < 0.45);
+  assertEquals(1.0f, t.plane.N.z);
+}
+
+unittest("Room: cooked rooms are the same as built ones")
+{
+  auto const room = buildRoom(makeTestRoom());
+  auto const cooked = deserializeRoom(serializeRoom(room));
+
+  assertEquals(room.start.z, cooked.start.z);
+  auto& builtSpawns = room.spawnTable;
+  auto& cookedSpawns = cooked.spawnTable;
+  assertTrue(builtSpawns.types == cookedSpawns.types);
+  assertEquals(builtSpawns.spawns.size(), cookedSpawns.spawns.size());
+  assertEquals(builtSpawns.spawns[0].type, cookedSpawns.spawns[0].type);
+  assertEquals(builtSpawns.spawns[0].pos.x, cookedSpawns.spawns[0].pos.x);
+  assertEquals(builtSpawns.spawns[0].argCount, cookedSpawns.spawns[0].argCount);
+  assertEquals(builtSpawns.args.size(), cookedSpawns.args.size());
+  assertEquals(builtSpawns.args[0].text, cookedSpawns.args[0].text);
+  assertEquals(builtSpawns.args[0].value, cookedSpawns.args[0].value);
+  assertEquals(room.colliders.size(), cooked.colliders.size());
+
+  for(int i = 0; i < (int)room.colliders.size(); ++i)
+  {
+    auto& a = room.colliders[i];
+    auto& b = cooked.colliders[i];
+    assertEquals(a.planes.size(), b.planes.size());
+    assertEquals(a.bounds.size.cx, b.bounds.size.cx);
+
+    for(int k = 0; k < (int)a.planes.size(); ++k)
+    {
+      assertEquals(a.planes[k].D, b.planes[k].D);
+      assertEquals(a.planes[k].N.y, b.planes[k].N.y);
+    }
+  }
+
+  assertEquals(room.collidersTree.nodes.size(), cooked.collidersTree.nodes.size());
+  assertEquals(room.collidersTree.indices, cooked.collidersTree.indices);
+}
+
+unittest("Room: reject corrupted cooked rooms")
+{
+  auto data = serializeRoom(buildRoom(makeTestRoom()));
+
+  assertThrown(deserializeRoom(data.substr(0, data.size() - 3)));
+  assertThrown(deserializeRoom("JUNK" + data.substr(4)));
+}
+
+unittest("Room: sloped brushes keep their bevels")
+{
+  auto box = makeBoxMesh("ramp", Vector3f(0, 0, 0), Vector3f(4, 4, 1));
+
+  // lift the top at x=+4, turning the box into a ramp
+  for(auto& v : box.vertices)
+    if(v.x > 3 && v.z > 0.5)
+      v.z = 3;
+
+  auto room = buildRoom({ box });
+
+  auto& ramp = room.colliders[0];
+  assertTrue(ramp.planes.size() > 6);
+}
+
+unittest("Room: brushes built in parallel keep the order of the meshes")
+{
+  vector<Mesh> meshes;
+
+  for(int i = 0; i < 40; ++i)
+    meshes.push_back(makeBoxMesh("wall", Vector3f(i * 2, 0, 0), Vector3f(i * 2 + 1, 1 + i, 1)));
+
+  ThreadPool serial(0);
+  ThreadPool workers(4);
+
+  auto const a = buildRoom(meshes, &serial);
+  auto const b = buildRoom(meshes, &workers);
+
+  assertEquals(40u, b.colliders.size());
+
+  for(int i = 0; i < 40; ++i)
+  {
+    assertEquals(float(i * 2), b.colliders[i].bounds.pos.x);
+    assertEquals(a.colliders[i].planes.size(), b.colliders[i].planes.size());
+  }
+
+  assertEquals(a.collidersTree.indices, b.collidersTree.indices);
+}
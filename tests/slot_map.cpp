@@ -0,0 +1,54 @@
+#include "engine/tests/tests.h"
+#include "src/slot_map.h"
+
+unittest("SlotMap: handles find their values")
+{
+  SlotMap<int> map;
+  auto a = map.add(10);
+  auto b = map.add(20);
+  auto c = map.add(30);
+
+  assertEquals(10, *map.get(a));
+  assertEquals(20, *map.get(b));
+  assertEquals(30, *map.get(c));
+  assertEquals(3, (int)map.values.size());
+
+  map.remove(a);
+
+  assertTrue(map.get(a) == nullptr);
+  assertEquals(20, *map.get(b));
+  assertEquals(30, *map.get(c));
+  assertEquals(2, (int)map.values.size());
+}
+
+unittest("SlotMap: stale handles don't see the values reusing their slot")
+{
+  SlotMap<int> map;
+  auto a = map.add(10);
+  map.remove(a);
+
+  auto b = map.add(20);
+  assertEquals(a.index, b.index);
+  assertTrue(map.get(a) == nullptr);
+  assertEquals(20, *map.get(b));
+
+  assertTrue(map.get(SlotHandle {}) == nullptr);
+}
+
+unittest("SlotMap: access by slot index")
+{
+  SlotMap<int> map;
+  auto a = map.add(10);
+  auto b = map.add(20);
+  map.remove(a);
+
+  assertTrue(map.getBySlot(a.index) == nullptr);
+  assertEquals(20, *map.getBySlot(b.index));
+  assertTrue(map.getBySlot(-1) == nullptr);
+  assertTrue(map.getBySlot(100) == nullptr);
+
+  // whatever the generation
+  auto c = map.add(30);
+  assertEquals(30, *map.getBySlot(a.index));
+  assertEquals(a.index, c.index);
+}
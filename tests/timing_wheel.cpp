@@ -0,0 +1,63 @@
+#include "engine/tests/tests.h"
+#include "src/timing_wheel.h"
+
+static
+vector<int> advance(TimingWheel<int>& wheel, int ticks)
+{
+  vector<int> r;
+
+  for(int i = 0; i < ticks; ++i)
+    wheel.advance([&] (int value) { r.push_back(value); });
+
+  return r;
+}
+
+unittest("TimingWheel: values expire after their delay")
+{
+  TimingWheel<int> wheel;
+  wheel.schedule(1, 3);
+  wheel.schedule(2, 1);
+
+  assertEquals(vector<int>({ 2 }), advance(wheel, 1));
+  assertEquals(vector<int>(), advance(wheel, 1));
+  assertEquals(vector<int>({ 1 }), advance(wheel, 1));
+  assertEquals(vector<int>(), advance(wheel, 10));
+}
+
+unittest("TimingWheel: delays longer than the wheel")
+{
+  TimingWheel<int> wheel;
+  wheel.schedule(7, 1000);
+
+  assertEquals(vector<int>(), advance(wheel, 999));
+  assertEquals(vector<int>({ 7 }), advance(wheel, 1));
+}
+
+unittest("TimingWheel: cancel")
+{
+  TimingWheel<int> wheel;
+  auto deadline = wheel.schedule(1, 5);
+  wheel.schedule(2, 5);
+  wheel.cancel(1, deadline);
+
+  assertEquals(vector<int>({ 2 }), advance(wheel, 5));
+}
+
+unittest("TimingWheel: rescheduling from the callback")
+{
+  TimingWheel<int> wheel;
+  wheel.schedule(1, 2);
+
+  int count = 0;
+
+  for(int i = 0; i < 10; ++i)
+  {
+    wheel.advance([&] (int value)
+      {
+        ++count;
+        wheel.schedule(value, 2);
+      });
+  }
+
+  assertEquals(5, count);
+}
@@ -94,3 +94,72 @@ unittest("Convex: trace point down through sloped floor using small steps")
   assertEquals(true, pos.z > 0.0f);
 }
 
+unittest("Convex: traceThroughBox matches the trace through the equivalent convex")
+{
+  auto const box = Box(1, 2, 3, 2, 1, 0.5);
+
+  auto const b = makeBoxConvex(box);
+
+  int hits = 0;
+
+  for(int i = 0; i < 1000; ++i)
+  {
+    auto coord = [&] (int k) { return ((i * 7919 + k * 104729) % 1000) * 0.006f; };
+    auto const A = Vector3f(coord(1), coord(2), coord(3));
+    auto const B = Vector3f(coord(4), coord(5), coord(6));
+    auto const halfSize = Vector3f(0.25, 0.5, 0.125);
+
+    auto expected = b.trace(A, B, halfSize);
+    auto actual = traceThroughBox(A, B, halfSize, box);
+
+    assertEquals(expected.fraction, actual.fraction);
+
+    if(expected.fraction < 1)
+    {
+      assertTrue(dotProduct(expected.plane.N, actual.plane.N) == 1.0f);
+      assertEquals(expected.plane.D, actual.plane.D);
+      ++hits;
+    }
+  }
+
+  assertTrue(hits > 10);
+}
+
+unittest("Convex: packed convex gives the same results as the generic one")
+{
+  Convex brush;
+
+  // a slanted box, with a bevel, a bit less than 4 planes per SIMD lane
+  brush.planes.push_back(Plane { normalize(Vector3f(1, 0.2, 0)), 2 });
+  brush.planes.push_back(Plane { normalize(Vector3f(-1, 0, 0)), 1 });
+  brush.planes.push_back(Plane { Vector3f(0, 1, 0), 2 });
+  brush.planes.push_back(Plane { Vector3f(0, -1, 0), 1 });
+  brush.planes.push_back(Plane { normalize(Vector3f(0, 0.3, 1)), 1.5 });
+  brush.planes.push_back(Plane { Vector3f(0, 0, -1), 1 });
+  brush.planes.push_back(Plane { normalize(Vector3f(1, 1, 0)), 2.5 });
+
+  PackedConvex packed(brush);
+  assertEquals(8, packed.stride);
+
+  int hits = 0;
+
+  for(int i = 0; i < 1000; ++i)
+  {
+    auto coord = [&] (int k) { return ((i * 7919 + k * 104729) % 1000) * 0.008f - 4; };
+    auto const A = Vector3f(coord(1), coord(2), coord(3));
+    auto const B = Vector3f(coord(4), coord(5), coord(6));
+
+    auto expected = brush.trace(A, B, HalfSize);
+    auto actual = packed.trace(A, B, HalfSize);
+
+    assertEquals(expected.fraction, actual.fraction);
+
+    if(expected.fraction < 1)
+    {
+      assertEquals(expected.plane.D, actual.plane.D);
+      ++hits;
+    }
+  }
+
+  assertTrue(hits > 10);
+}
@@ -0,0 +1,40 @@
+#include "engine/tests/tests.h"
+#include "src/trigger_grid.h"
+
+unittest("TriggerGrid: queries match brute force")
+{
+  TriggerGrid grid(4);
+  vector<Box> boxes;
+
+  for(int i = 0; i < 100; ++i)
+  {
+    // some span several cells, some are at negative coordinates
+    auto box = Box((i * 37) % 50 - 25, (i * 11) % 20 - 10, i % 3, 1 + i % 7, 1, 1 + i % 2);
+    boxes.push_back(box);
+    grid.insert(i, box);
+  }
+
+  for(int i = 0; i < 100; i += 5)
+    grid.remove(i);
+
+  assertEquals(80, grid.size());
+
+  vector<int> actual;
+
+  for(int k = 0; k < 20; ++k)
+  {
+    auto const query = Box(k * 3 - 30, (k * 7) % 20 - 10, 0, 2.5, 2.5, 3);
+
+    vector<int> expected;
+
+    for(int i = 0; i < 100; ++i)
+      if(i % 5 && overlaps(boxes[i], query))
+        expected.push_back(i);
+
+    grid.query(query, actual);
+    assertEquals(expected.size(), actual.size());
+
+    for(int i = 0; i < (int)expected.size(); ++i)
+      assertEquals(expected[i], actual[i]);
+  }
+}